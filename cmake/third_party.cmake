@@ -5,6 +5,7 @@ endif()
 
 if(WITH_ZLIB)
   include(zlib)
+  add_definitions(-DWITH_ZLIB)
 endif()
 include(protobuf)
 include(googletest)
@@ -24,6 +24,7 @@ limitations under the License.
 #include "oneflow/core/framework/shut_down_util.h"
 #include "oneflow/core/device/cuda_util.h"
 #include "oneflow/core/common/mem_util.h"
+#include "oneflow/core/transport/transport.h"
 
 #ifdef WITH_CUDA
 #include <cuda.h>
@@ -57,6 +58,29 @@ void RegisterCudaDeviceProperties(py::module& m) {
 
 #endif  // WITH_CUDA
 
+#ifdef __linux__
+
+Maybe<py::dict> GetTransportStats() {
+  const TransportStats stats = JUST(SingletonMaybe<Transport>())->GetStats();
+  py::dict ret;
+  ret["elapsed_seconds"] = stats.elapsed_seconds;
+  ret["send_num"] = stats.send_num;
+  ret["send_bytes"] = stats.send_bytes;
+  ret["recv_num"] = stats.recv_num;
+  ret["recv_bytes"] = stats.recv_bytes;
+  ret["avg_send_latency_us"] = stats.avg_send_latency_us;
+  ret["avg_recv_latency_us"] = stats.avg_recv_latency_us;
+  ret["in_flight_send_num"] = stats.in_flight_send_num;
+  ret["max_in_flight_send_num"] = stats.max_in_flight_send_num;
+  ret["in_flight_recv_num"] = stats.in_flight_recv_num;
+  ret["max_in_flight_recv_num"] = stats.max_in_flight_recv_num;
+  ret["coalesced_send_num"] = stats.coalesced_send_num;
+  ret["coalesced_buffer_num"] = stats.coalesced_buffer_num;
+  return ret;
+}
+
+#endif  // __linux__
+
 Maybe<void> SwitchToShuttingDownPhase(EnvGlobalObjectsScope* env, bool is_normal_exit) {
   JUST(env->init_is_normal_exit(is_normal_exit));
   SetShuttingDown(true);
@@ -115,6 +139,9 @@ ONEFLOW_API_PYBIND11_MODULE("", m) {
   m.def("GetGraphDebugOnlyUserPyStack", &GetGraphDebugOnlyUserPyStack);
   m.def("InitPythonPathsToBeKeptAndFilteredForDebugging",
         &InitPythonPathsToBeKeptAndFilteredForDebugging);
+#ifdef __linux__
+  m.def("GetTransportStats", &GetTransportStats);
+#endif  // __linux__
 }
 
 }  // namespace oneflow
@@ -0,0 +1,50 @@
+/*
+Copyright 2020 The OneFlow Authors. All rights reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+#include <pybind11/pybind11.h>
+#include "oneflow/api/python/of_api_registry.h"
+#include "oneflow/core/boxing/boxing_cost_model.h"
+
+namespace py = pybind11;
+
+namespace oneflow {
+
+namespace {
+
+py::list GetEagerBoxingStats() {
+  py::list ret;
+  for (const auto& stats : GetEagerBoxingRouteStats()) {
+    py::dict route;
+    route["boxing_routing"] = stats.boxing_routing;
+    route["nd_sbp_routing"] = stats.nd_sbp_routing;
+    route["placement_routing"] = stats.placement_routing;
+    route["hop_num"] = stats.hop_num;
+    route["call_num"] = stats.call_num;
+    route["logical_elem_cnt"] = stats.logical_elem_cnt;
+    route["estimated_cost"] = stats.estimated_cost;
+    route["elapsed_us"] = stats.elapsed_us;
+    ret.append(route);
+  }
+  return ret;
+}
+
+}  // namespace
+
+ONEFLOW_API_PYBIND11_MODULE("", m) {
+  m.def("GetEagerBoxingStats", &GetEagerBoxingStats);
+  m.def("ResetEagerBoxingStats", &ResetEagerBoxingRouteStats);
+}
+
+}  // namespace oneflow
@@ -118,6 +118,12 @@ Maybe<void> SbpConstructor::InitSbpGraph(const OpGraph& op_graph, const Job& job
 }
 
 Maybe<void> SbpConstructor::FindBestSbpSignature() {
+  auto deadline = std::chrono::steady_clock::time_point::max();
+  if (search_time_limit_ > 0) {
+    deadline = std::chrono::steady_clock::now()
+               + std::chrono::duration_cast<std::chrono::steady_clock::duration>(
+                   std::chrono::duration<double>(search_time_limit_));
+  }
   double ori_cost = sbp_graph_.ComputeCost();
   LOG(INFO) << "Initial cost: " << ori_cost;
   int elimination_num = sbp_graph_.NodeAndEdgeEliminations();
@@ -130,13 +136,21 @@ Maybe<void> SbpConstructor::FindBestSbpSignature() {
 
   int32_t step = 1;
   while (true) {
-    sbp_graph_.GreedyStrategy(/*nbh_num=*/4);
+    if (enable_scalable_search_) {
+      sbp_graph_.ParallelGreedyStrategy(/*nbh_num=*/4, deadline);
+    } else {
+      sbp_graph_.GreedyStrategy(/*nbh_num=*/4);
+    }
     double curr_memory = sbp_graph_.GetMemory();
     double total_weighted_cost = sbp_graph_.ComputeWeightedCost();
     LOG(INFO) << "The " << step << "-th try, memory ratio: " << kMemoryRatio
               << ", memory: " << curr_memory << ", total cost: " << total_weighted_cost
               << ", time cost: " << (total_weighted_cost - kMemoryRatio * curr_memory);
     if (ams != AutoMemoryStrategy::kAdaptiveAutoMemory) { break; }
+    if (std::chrono::steady_clock::now() > deadline) {
+      LOG(INFO) << "Auto parallel runs out of the time limit " << search_time_limit_ << "s";
+      break;
+    }
     if (curr_memory < available_memory_ || kMemoryRatio >= kMaxMemoryRatio) { break; }
     if (curr_memory > available_memory_ * kImpossibleRatio) {
       kMemoryRatio = kMaxMemoryRatio;
@@ -316,6 +330,7 @@ Maybe<void> SbpConstructor::InitComputationCost(const OpGraph& op_graph) {
 // Init copy cost and memory for edges
 Maybe<void> SbpConstructor::InitCopyAndMemoryCost(const OpGraph& op_graph) {
   bool nccl_not_use_compute_stream = !nccl_use_compute_stream_;
+  CopyCostCache copy_cost_cache;
   // Compute copy cost for sbp edges
   op_graph.ForEachNode([&](OpNode* op_node) {
     // get corresponding sbp node consumer
@@ -339,8 +354,11 @@ Maybe<void> SbpConstructor::InitCopyAndMemoryCost(const OpGraph& op_graph) {
     }
     // Find all those cases with wait time
     // Do not skip edges carrying no lbi
-    sbp_node_consumer->InitCopyAndMemoryCost(use_sbp_collector_, nccl_not_use_compute_stream);
+    sbp_node_consumer->InitCopyAndMemoryCost(use_sbp_collector_, nccl_not_use_compute_stream,
+                                             &copy_cost_cache);
   });
+  VLOG(3) << "Copy cost cache hit: " << copy_cost_cache.hit_num()
+          << ", miss: " << copy_cost_cache.miss_num();
   return Maybe<void>::Ok();
 }
 
@@ -39,6 +39,8 @@ class SbpConstructor final {
   SbpConstructor(const OpGraph& op_graph, Job* job)
       : cost_ratio_(job->job_conf().auto_parallel_computation_cost_ratio()),
         enable_trunk_algo_(job->job_conf().enable_auto_parallel_trunk_algo()),
+        enable_scalable_search_(job->job_conf().enable_auto_parallel_scalable_search()),
+        search_time_limit_(job->job_conf().auto_parallel_search_time_limit()),
         use_sbp_collector_(!Singleton<ResourceDesc, ForSession>::Get()
                                 ->resource()
                                 .disable_group_boxing_by_dst_parallel()
@@ -73,6 +75,8 @@ class SbpConstructor final {
 
   double cost_ratio_;
   bool enable_trunk_algo_;
+  bool enable_scalable_search_;
+  double search_time_limit_;
   bool use_sbp_collector_;
   SbpGraph sbp_graph_;
   const OpGraph* op_graph_;
@@ -322,7 +322,8 @@ double SbpEdge::GetMinWeightedCost() {
 
 // Assemble copy cost
 void SbpEdge::InitCopyAndMemoryCost(const std::string& ibn, bool use_sbp_collector,
-                                    bool nccl_not_use_compute_stream) {
+                                    bool nccl_not_use_compute_stream,
+                                    CopyCostCache* copy_cost_cache) {
   std::vector<int64_t> consumer_nd_sbp_sig2memory;
   if (nccl_not_use_compute_stream) {
     in_memory_support_ = true;
@@ -366,6 +367,8 @@ void SbpEdge::InitCopyAndMemoryCost(const std::string& ibn, bool use_sbp_collect
         *CHECK_JUST(producer->op().GetParallelDesc4BnInOp(producer_lbn));
     const ParallelDesc& consumer_parallel_desc =
         *CHECK_JUST(consumer->op().GetParallelDesc4BnInOp(ibn));
+    Symbol<ParallelDesc> producer_parallel_desc_symbol = SymbolOf(producer_parallel_desc);
+    Symbol<ParallelDesc> consumer_parallel_desc_symbol = SymbolOf(consumer_parallel_desc);
 
     // Need to be careful, the logical blob description should be independent to current
     // SbpParallel. Use producer or op_node?
@@ -394,9 +397,9 @@ void SbpEdge::InitCopyAndMemoryCost(const std::string& ibn, bool use_sbp_collect
         const NdSbp& sbp_consumer = consumer_sbp_bn_in_op2sbp_parallel.at(ibn);
 
         // compute copy cost for a specific logical blob
-        double curr_edge_cost = CHECK_JUST(ComputeCopyCostWithMiddleNodes(
-            sbp_producer, sbp_consumer, logical_blob_desc, producer_parallel_desc,
-            consumer_parallel_desc, require_same_sbp));
+        double curr_edge_cost = CHECK_JUST(copy_cost_cache->ComputeCopyCostWithMiddleNodes(
+            sbp_producer, sbp_consumer, logical_blob_desc, producer_parallel_desc_symbol,
+            consumer_parallel_desc_symbol, require_same_sbp));
         if (curr_edge_cost < GetValidMaxCopyCost()) {
           cost4sbp_id_producer[sbp_id_consumer] +=
               CHECK_JUST(producer->op().GetOpTimeShape())->elem_cnt() * curr_edge_cost;
@@ -87,7 +87,7 @@ class SbpEdge final {
 
   // Assemble copy and partial cost
   void InitCopyAndMemoryCost(const std::string& ibn, bool use_sbp_collector,
-                             bool nccl_not_use_compute_stream);
+                             bool nccl_not_use_compute_stream, CopyCostCache* copy_cost_cache);
   // Assemble memory cost
   void InitializeMemory(const HashMap<LogicalBlobId, int32_t>& lbi2id,
                         const std::vector<int32_t>& id2count,
@@ -21,6 +21,7 @@ limitations under the License.
 #include "oneflow/core/auto_parallel/sbp_edge.h"
 #include "oneflow/core/auto_parallel/sbp_node.h"
 #include "oneflow/core/auto_parallel/algorithm_util.h"
+#include "oneflow/core/thread/thread_manager.h"
 
 namespace oneflow {
 namespace auto_parallel {
@@ -30,6 +31,9 @@ namespace auto_parallel {
 
 namespace {
 static const int32_t kMinNodeInGraphForMerging = 4;
+// Do not split the graph into regions smaller than this, otherwise most of the nodes would be on
+// the boundaries.
+static const int32_t kMinNodeInRegion = 64;
 }  // anonymous namespace
 
 // Generate a node
@@ -322,9 +326,25 @@ double SbpGraph::GreedyStrategy(bool for_node) const {
 }
 
 double SbpGraph::GreedyStrategy(int32_t nbh_num) const {
+  std::vector<int32_t> all_node_list_ids(node_list_.size());
+  for (int32_t node_list_id = 0; node_list_id < node_list_.size(); node_list_id++) {
+    all_node_list_ids[node_list_id] = node_list_id;
+  }
+  return GreedyStrategy(nbh_num, all_node_list_ids, /*node_list_id2region=*/{}, /*region_id=*/-1,
+                        std::chrono::steady_clock::time_point::max());
+}
+
+double SbpGraph::GreedyStrategy(int32_t nbh_num, const std::vector<int32_t>& start_node_list_ids,
+                                const std::vector<int32_t>& node_list_id2region,
+                                int32_t region_id,
+                                const std::chrono::steady_clock::time_point& deadline) const {
   // nbh_num is the maximum number of neighborhood to adjust sbp strategy in each step
   // Total Cost Reduce & Cost Reduce for one loop
   double total_cost_reduction = 0, cost_reduction = 0;
+  // Whether the sbp signature of a node could be adjusted
+  auto IsAdjustable = [&](int32_t node_list_id) {
+    return region_id < 0 || node_list_id2region[node_list_id] == region_id;
+  };
   // A global buffer to store part of the one ring neighborhood.
   std::vector<int32_t> nbh_id2node_list_id;
   // Not accept a number lower than 1
@@ -334,12 +354,14 @@ double SbpGraph::GreedyStrategy(int32_t nbh_num) const {
   // store all the node_list_id whose corresponding nodes will be visited
   // We can use unordered_map to do this but vector is faster
   std::vector<int32_t> pre_visit_node_list(node_list_.size() + 1);
-  for (int32_t nbh_id = 0; nbh_id < node_list_.size(); nbh_id++) {
-    pre_visit_node_list[nbh_id] = nbh_id;
-  }
-  int32_t head = 0, tail = node_list_.size();
   // whether a node_list_id is in pre_visit_node_list
-  std::vector<bool> pre_visit_tags(node_list_.size(), true);
+  std::vector<bool> pre_visit_tags(node_list_.size(), false);
+  int32_t head = 0, tail = 0;
+  for (int32_t node_list_id : start_node_list_ids) {
+    if (pre_visit_tags[node_list_id] || !IsAdjustable(node_list_id)) { continue; }
+    pre_visit_node_list[tail++] = node_list_id;
+    pre_visit_tags[node_list_id] = true;
+  }
   int32_t step = 0;
   // 1 ring neighborhood buffer
   std::vector<int32_t> nbh_1ring(nbh_num);
@@ -349,6 +371,8 @@ double SbpGraph::GreedyStrategy(int32_t nbh_num) const {
   std::vector<int32_t> nbh_1ring_buffer;
 
   while (head != tail && step < node_list_.size()) {
+    // Keep the current strategy, which is the best one so far, if running out of time.
+    if (std::chrono::steady_clock::now() > deadline) { break; }
     auto* this_node = node_list_[pre_visit_node_list[head]];
     if (nbh_num <= 1) {
       // Greedy strategy on nodes, here we use nbh_1ring to store the nbh_id2node_list_id
@@ -360,6 +384,12 @@ double SbpGraph::GreedyStrategy(int32_t nbh_num) const {
     } else {
       // Use GreedyStrategy on the one ring neighborhood of this node.
       this_node->OneRingNeighborhood(nbh_1ring);
+      // Fix the sbp signature of the nodes in the other regions
+      if (region_id >= 0) {
+        nbh_1ring.erase(std::remove_if(nbh_1ring.begin(), nbh_1ring.end(),
+                                       [&](int32_t id) { return !IsAdjustable(id); }),
+                        nbh_1ring.end());
+      }
       // store the original sbp signature of the 1-ring neighborhood for comparison
       original_sbp_sig_id.resize(nbh_1ring.size());
       for (int32_t nbh_id = 0; nbh_id < nbh_1ring.size(); nbh_id++) {
@@ -398,7 +428,7 @@ double SbpGraph::GreedyStrategy(int32_t nbh_num) const {
                                                            node_list_, node_tags);
           for (int32_t nbh_node_list_id : nbh_2ring) {
             // Put them into the pre-visited node list
-            if (!pre_visit_tags[nbh_node_list_id]) {
+            if (!pre_visit_tags[nbh_node_list_id] && IsAdjustable(nbh_node_list_id)) {
               pre_visit_node_list[tail] = nbh_node_list_id;
               pre_visit_tags[nbh_node_list_id] = true;
               tail++;
@@ -421,6 +451,82 @@ double SbpGraph::GreedyStrategy(int32_t nbh_num) const {
   return total_cost_reduction;
 }
 
+double SbpGraph::ParallelGreedyStrategy(
+    int32_t nbh_num, const std::chrono::steady_clock::time_point& deadline) const {
+  int32_t thread_num =
+      Singleton<ThreadPool>::Get() == nullptr ? 1 : Singleton<ThreadPool>::Get()->thread_num();
+  int32_t region_num =
+      std::max(1, std::min<int32_t>(thread_num, node_list_.size() / kMinNodeInRegion));
+  std::vector<std::vector<int32_t>> region2node_list_ids;
+  std::vector<int32_t> node_list_id2region;
+  std::vector<int32_t> boundary_node_list_ids;
+  SplitRegions(region_num, &region2node_list_ids, &node_list_id2region, &boundary_node_list_ids);
+  // The nodes inside a region only connect to the nodes in the same region or on the boundaries,
+  // which are fixed at this stage. So the regions could be adjusted in parallel.
+  std::vector<double> region2cost_reduction(region_num, 0);
+  MultiThreadLoop(region_num, [&](size_t region_id) {
+    region2cost_reduction[region_id] =
+        GreedyStrategy(nbh_num, region2node_list_ids[region_id], node_list_id2region, region_id,
+                       deadline);
+  });
+  double total_cost_reduction = 0;
+  for (double cost_reduction : region2cost_reduction) { total_cost_reduction += cost_reduction; }
+  // Stitch the regions together. The changes on the boundaries spread into the regions.
+  total_cost_reduction += GreedyStrategy(nbh_num, boundary_node_list_ids,
+                                         /*node_list_id2region=*/{}, /*region_id=*/-1, deadline);
+  return total_cost_reduction;
+}
+
+void SbpGraph::SplitRegions(int32_t region_num,
+                            std::vector<std::vector<int32_t>>* region2node_list_ids,
+                            std::vector<int32_t>* node_list_id2region,
+                            std::vector<int32_t>* boundary_node_list_ids) const {
+  int32_t node_num = node_list_.size();
+  // Breadth-first order of each weakly connected component, which keeps the adjacent nodes close
+  std::vector<int32_t> order2node_list_id;
+  order2node_list_id.reserve(node_num);
+  std::vector<bool> visited(node_num, false);
+  std::vector<int32_t> nbh_1ring;
+  for (int32_t root = 0; root < node_num; root++) {
+    if (visited[root]) { continue; }
+    visited[root] = true;
+    order2node_list_id.push_back(root);
+    for (int32_t order = order2node_list_id.size() - 1; order < order2node_list_id.size();
+         order++) {
+      node_list_[order2node_list_id[order]]->OneRingNeighborhood(nbh_1ring);
+      for (int32_t nbh_node_list_id : nbh_1ring) {
+        if (!visited[nbh_node_list_id]) {
+          visited[nbh_node_list_id] = true;
+          order2node_list_id.push_back(nbh_node_list_id);
+        }
+      }
+    }
+  }
+  // Cut the order into regions with the same size
+  std::vector<int32_t> node_list_id2order_region(node_num);
+  for (int32_t order = 0; order < node_num; order++) {
+    node_list_id2order_region[order2node_list_id[order]] =
+        static_cast<int64_t>(order) * region_num / node_num;
+  }
+  // Move the nodes adjacent to the other regions onto the boundaries
+  region2node_list_ids->assign(region_num, {});
+  node_list_id2region->assign(node_num, -1);
+  boundary_node_list_ids->clear();
+  for (int32_t node_list_id : order2node_list_id) {
+    int32_t region_id = node_list_id2order_region[node_list_id];
+    node_list_[node_list_id]->OneRingNeighborhood(nbh_1ring);
+    bool is_boundary = std::any_of(nbh_1ring.begin(), nbh_1ring.end(), [&](int32_t id) {
+      return node_list_id2order_region[id] != region_id;
+    });
+    if (is_boundary) {
+      boundary_node_list_ids->push_back(node_list_id);
+    } else {
+      (*node_list_id2region)[node_list_id] = region_id;
+      (*region2node_list_ids)[region_id].push_back(node_list_id);
+    }
+  }
+}
+
 void SbpGraph::DfsAddNbhCost(std::vector<int32_t>& nbh_id2node_list_id,
                              std::unordered_map<int32_t, int32_t>& node_list_id2nbh_id,
                              std::vector<int32_t>& order2nbh_id, std::vector<int32_t>& nbh_id2order,
@@ -17,6 +17,7 @@ limitations under the License.
 #define ONEFLOW_CORE_AUTO_PARALLEL_SBP_GRAPH_H_
 
 #include <algorithm>
+#include <chrono>
 #include <unordered_map>
 #include "oneflow/core/auto_parallel/binary_set.h"
 #include "oneflow/core/auto_parallel/sbp_node.h"
@@ -69,6 +70,11 @@ class SbpGraph final {
   double GreedyStrategy(bool for_node) const;
   // Use greedy strategy on the one ring neighborhood with the maximum number of points nbh_num.
   double GreedyStrategy(int32_t nbh_num = 4) const;
+  // Split the nodes into regions of the weakly connected components and use
+  // GreedyStrategy(nbh_num) on the regions in parallel, then adjust the nodes on the boundaries of
+  // the regions. Stop at the deadline and keep the best strategy found so far.
+  double ParallelGreedyStrategy(int32_t nbh_num,
+                                const std::chrono::steady_clock::time_point& deadline) const;
 
   // Find one strategy with finite cost for adjustment
   Maybe<void> Find1Strategy4Greedy() const;
@@ -127,6 +133,18 @@ class SbpGraph final {
   // Select two nodes and merge them
   int32_t PickAndMerge();
 
+  // Use greedy strategy starting from the nodes in start_node_list_ids. Only the nodes with
+  // node_list_id2region[node_list_id] == region_id can be adjusted if region_id >= 0.
+  double GreedyStrategy(int32_t nbh_num, const std::vector<int32_t>& start_node_list_ids,
+                        const std::vector<int32_t>& node_list_id2region, int32_t region_id,
+                        const std::chrono::steady_clock::time_point& deadline) const;
+  // Split the nodes into at most region_num regions along the breadth-first order of each weakly
+  // connected component. A node is assigned to a region if all its neighbors are in the same
+  // region, otherwise it is a boundary node with region -1.
+  void SplitRegions(int32_t region_num, std::vector<std::vector<int32_t>>* region2node_list_ids,
+                    std::vector<int32_t>* node_list_id2region,
+                    std::vector<int32_t>* boundary_node_list_ids) const;
+
   void DfsAddNbhCost(std::vector<int32_t>& nbh_id2node_list_id,
                      std::unordered_map<int32_t, int32_t>& node_list_id2nbh_id,
                      std::vector<int32_t>& order2nbh_id, std::vector<int32_t>& nbh_id2order,
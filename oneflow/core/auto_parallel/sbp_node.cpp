@@ -712,7 +712,8 @@ void SbpNode::DropAvailWaitTime(double curr_trunk_cost) {
 }
 
 // Assemble copy cost and partial memory cost for all the incoming edges
-void SbpNode::InitCopyAndMemoryCost(bool use_sbp_collector, bool nccl_not_use_compute_stream) {
+void SbpNode::InitCopyAndMemoryCost(bool use_sbp_collector, bool nccl_not_use_compute_stream,
+                                    CopyCostCache* copy_cost_cache) {
   for (SbpEdge* this_edge : edges_in_) {
     const auto* sbp_node_producer = this_edge->start_node_;
     OpNode* producer = sbp_node_producer->op_node_;
@@ -722,7 +723,8 @@ void SbpNode::InitCopyAndMemoryCost(bool use_sbp_collector, bool nccl_not_use_co
     // look through input blobs
     for (const std::string& ibn : op_node_->op().input_bns()) {
       if (producer->op().op_name() == op_node_->SrcNode4Ibn(ibn).op().op_name()) {
-        this_edge->InitCopyAndMemoryCost(ibn, use_sbp_collector, nccl_not_use_compute_stream);
+        this_edge->InitCopyAndMemoryCost(ibn, use_sbp_collector, nccl_not_use_compute_stream,
+                                         copy_cost_cache);
       }
     }
     // Add Wait time
@@ -33,6 +33,7 @@ namespace oneflow {
 namespace auto_parallel {
 
 class SbpEdge;
+class CopyCostCache;
 
 // A node structure to deal with the SBP strategy.
 // Please see SbpGraph for the whole algorithm and introduction.
@@ -131,7 +132,8 @@ class SbpNode final {
   void SetTrunkWaitTime(double trunk_wait_time);
 
   // Assemble copy cost and partial memory cost for all the incoming edges
-  void InitCopyAndMemoryCost(bool use_sbp_collector, bool nccl_not_use_compute_stream);
+  void InitCopyAndMemoryCost(bool use_sbp_collector, bool nccl_not_use_compute_stream,
+                             CopyCostCache* copy_cost_cache);
   // Assemble memory cost
   void InitializeMemory(bool is_reusable, const HashMap<LogicalBlobId, int32_t>& lbi2id,
                         const std::vector<int32_t>& id2count, bool nccl_use_compute_stream);
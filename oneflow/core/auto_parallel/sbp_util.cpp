@@ -17,6 +17,8 @@ limitations under the License.
 #include <memory>
 #include "oneflow/core/auto_parallel/sbp_util.h"
 #include "oneflow/core/common/data_type.h"
+#include "oneflow/core/common/hash.h"
+#include "oneflow/core/framework/sbp_infer_util.h"
 #include "oneflow/core/job/sbp_parallel.h"
 #include "oneflow/core/graph/boxing/hierarchical_sub_task_graph_builder_impl.h"
 
@@ -36,5 +38,39 @@ bool RequireSameSbp(const OpNode* consumer, const std::string& ibn) {
           || logical_blob_desc.data_type() == DataType::kTensorBuffer);
 }
 
+Maybe<double> CopyCostCache::ComputeCopyCostWithMiddleNodes(
+    const NdSbp& producer_sbp_parallel, const NdSbp& consumer_sbp_parallel,
+    const BlobDesc& logical_blob_desc, Symbol<ParallelDesc> producer_parallel_desc,
+    Symbol<ParallelDesc> consumer_parallel_desc, bool requires_same_sbp) {
+  Key key{producer_sbp_parallel,         consumer_sbp_parallel,
+          logical_blob_desc.shape(),     logical_blob_desc.data_type(),
+          producer_parallel_desc,        consumer_parallel_desc,
+          requires_same_sbp};
+  auto it = key2cost_.find(key);
+  if (it != key2cost_.end()) {
+    hit_num_++;
+    return it->second;
+  }
+  double cost = JUST(oneflow::ComputeCopyCostWithMiddleNodes(
+      producer_sbp_parallel, consumer_sbp_parallel, logical_blob_desc, *producer_parallel_desc,
+      *consumer_parallel_desc, requires_same_sbp));
+  key2cost_.emplace(std::move(key), cost);
+  return cost;
+}
+
+bool CopyCostCache::Key::operator==(const Key& other) const {
+  return producer_parallel_desc == other.producer_parallel_desc
+         && consumer_parallel_desc == other.consumer_parallel_desc
+         && requires_same_sbp == other.requires_same_sbp && data_type == other.data_type
+         && shape == other.shape && producer_sbp_parallel == other.producer_sbp_parallel
+         && consumer_sbp_parallel == other.consumer_sbp_parallel;
+}
+
+size_t CopyCostCache::KeyHash::operator()(const Key& key) const {
+  return Hash(key.producer_sbp_parallel, key.consumer_sbp_parallel, key.shape,
+              static_cast<int32_t>(key.data_type), key.producer_parallel_desc,
+              key.consumer_parallel_desc, key.requires_same_sbp);
+}
+
 }  // namespace auto_parallel
 }  // namespace oneflow
@@ -16,6 +16,7 @@ limitations under the License.
 #ifndef ONEFLOW_CORE_AUTO_PARALLEL_SBP_UTIL_H_
 #define ONEFLOW_CORE_AUTO_PARALLEL_SBP_UTIL_H_
 
+#include "oneflow/core/common/symbol.h"
 #include "oneflow/core/graph/op_graph.h"
 
 namespace oneflow {
@@ -24,6 +25,46 @@ namespace auto_parallel {
 // Judge whether we need the same SBP for both producer and consumer
 bool RequireSameSbp(const OpNode* consumer, const std::string& ibn);
 
+// Memoize the copy cost between the sbp of a producer and a consumer. The copy cost only depends on
+// the sbp, the shape and data type of the logical blob and the placements, so the repeated blocks
+// in a model, such as the layers of a transformer, share most of the entries.
+class CopyCostCache final {
+ public:
+  OF_DISALLOW_COPY_AND_MOVE(CopyCostCache);
+  CopyCostCache() = default;
+  ~CopyCostCache() = default;
+
+  // Same as ComputeCopyCostWithMiddleNodes()
+  Maybe<double> ComputeCopyCostWithMiddleNodes(const NdSbp& producer_sbp_parallel,
+                                               const NdSbp& consumer_sbp_parallel,
+                                               const BlobDesc& logical_blob_desc,
+                                               Symbol<ParallelDesc> producer_parallel_desc,
+                                               Symbol<ParallelDesc> consumer_parallel_desc,
+                                               bool requires_same_sbp);
+
+  int64_t hit_num() const { return hit_num_; }
+  int64_t miss_num() const { return key2cost_.size(); }
+
+ private:
+  struct Key {
+    NdSbp producer_sbp_parallel;
+    NdSbp consumer_sbp_parallel;
+    Shape shape;
+    DataType data_type;
+    Symbol<ParallelDesc> producer_parallel_desc;
+    Symbol<ParallelDesc> consumer_parallel_desc;
+    bool requires_same_sbp;
+
+    bool operator==(const Key& other) const;
+  };
+  struct KeyHash {
+    size_t operator()(const Key& key) const;
+  };
+
+  HashMap<Key, double, KeyHash> key2cost_;
+  int64_t hit_num_ = 0;
+};
+
 }  // namespace auto_parallel
 }  // namespace oneflow
 
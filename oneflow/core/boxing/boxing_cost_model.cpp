@@ -0,0 +1,154 @@
+/*
+Copyright 2020 The OneFlow Authors. All rights reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+#include <mutex>
+#include "oneflow/core/boxing/boxing_cost_model.h"
+#include "oneflow/core/common/env_var/eager.h"
+#include "oneflow/core/job/parallel_desc.h"
+#include "oneflow/core/job/sbp_parallel.h"
+
+namespace oneflow {
+
+namespace {
+
+// Naive boxing sends every piece point to point, which overlaps the transfers of different ranks
+// much worse than a collective moving the same amount of data.
+constexpr double kNaiveBoxingTransferWeight = 2;
+
+double LocalElemCnt(Symbol<PlacedNdSbp> placed_nd_sbp, int64_t logical_elem_cnt) {
+  const Shape& hierarchy = *placed_nd_sbp->placement()->hierarchy();
+  const NdSbp& nd_sbp = *placed_nd_sbp->nd_sbp();
+  double elem_cnt = logical_elem_cnt;
+  for (int64_t i = 0; i < nd_sbp.sbp_parallel_size() && i < hierarchy.NumAxes(); ++i) {
+    if (nd_sbp.sbp_parallel(i).has_split_parallel()) { elem_cnt /= hierarchy.At(i); }
+  }
+  return elem_cnt;
+}
+
+// Elements received per rank when one hierarchy dimension of size `parallel_num` changes from
+// `in` to `out`, relative to the local size of the output.
+double SbpTransferRatio(const SbpParallel& in, const SbpParallel& out, int64_t parallel_num) {
+  if (in == out || in.has_broadcast_parallel() || out.has_partial_sum_parallel()) { return 0; }
+  const double n = parallel_num;
+  // all-to-all or all-gather
+  if (in.has_split_parallel()) { return (n - 1) / n; }
+  // all-reduce
+  if (out.has_broadcast_parallel()) { return 2 * (n - 1) / n; }
+  // reduce-scatter
+  return n - 1;
+}
+
+double EstimateHopElemCnt(const std::string& boxing_name, Symbol<PlacedNdSbp> in,
+                          Symbol<PlacedNdSbp> out, int64_t logical_elem_cnt) {
+  if (in == out) { return 0; }
+  // (un)flattening only reinterprets the hierarchy of the same devices
+  if (boxing_name == "flatten-hierarchy" || boxing_name == "unflatten-hierarchy") { return 0; }
+  const double weight = boxing_name.rfind("naive-", 0) == 0 ? kNaiveBoxingTransferWeight : 1;
+  const double out_local_elem_cnt = weight * LocalElemCnt(out, logical_elem_cnt);
+  const NdSbp& in_nd_sbp = *in->nd_sbp();
+  const NdSbp& out_nd_sbp = *out->nd_sbp();
+  if (in->placement() != out->placement()
+      || in_nd_sbp.sbp_parallel_size() != out_nd_sbp.sbp_parallel_size()) {
+    // every output rank fetches its whole local piece, from another device or over pcie
+    return out_local_elem_cnt;
+  }
+  const Shape& hierarchy = *out->placement()->hierarchy();
+  double ratio = 0;
+  for (int64_t i = 0; i < out_nd_sbp.sbp_parallel_size() && i < hierarchy.NumAxes(); ++i) {
+    ratio += SbpTransferRatio(in_nd_sbp.sbp_parallel(i), out_nd_sbp.sbp_parallel(i),
+                              hierarchy.At(i));
+  }
+  return ratio * out_local_elem_cnt;
+}
+
+struct RouteStatsTable {
+  std::mutex mutex;
+  HashMap<BoxingInterpreterStatus, EagerBoxingRouteStats> status2stats;
+};
+
+RouteStatsTable* MutRouteStatsTable() {
+  static RouteStatsTable table;
+  return &table;
+}
+
+}  // namespace
+
+Maybe<BoxingCost> EstimateBoxingCost(const BoxingInterpreterStatus& status) {
+  const auto& boxing_names = *status.sorted_boxing_names();
+  const auto& mid_placed_nd_sbp = *status.mid_placed_nd_sbp();
+  // pipelined routes carry a leading "pipelined" tag which is not a hop
+  CHECK_GE_OR_RETURN(boxing_names.size(), mid_placed_nd_sbp.size() + 1)
+      << Error::RuntimeError() << "boxing route " << status.boxing_routing()
+      << " has fewer boxing names than hops";
+  const int64_t logical_elem_cnt = status.logical_shape().elem_cnt();
+  BoxingCost boxing_cost;
+  Symbol<PlacedNdSbp> in = status.src_placed_nd_sbp();
+  size_t name_idx = boxing_names.size() - mid_placed_nd_sbp.size() - 1;
+  for (size_t i = 0; i <= mid_placed_nd_sbp.size(); ++i, ++name_idx) {
+    Symbol<PlacedNdSbp> out =
+        i < mid_placed_nd_sbp.size() ? mid_placed_nd_sbp.at(i) : status.dst_placed_nd_sbp();
+    const std::string& boxing_name = boxing_names.at(name_idx);
+    if (boxing_name != "identity") {
+      boxing_cost.hop_num += 1;
+      boxing_cost.elem_cnt += EstimateHopElemCnt(boxing_name, in, out, logical_elem_cnt);
+    }
+    in = out;
+  }
+  boxing_cost.cost = boxing_cost.elem_cnt
+                     + boxing_cost.hop_num * EnvInteger<ONEFLOW_EAGER_BOXING_COST_HOP_ELEM_CNT>();
+  return boxing_cost;
+}
+
+bool IsEagerBoxingRouteStatsEnabled() {
+  static const bool enabled = EnvBool<ONEFLOW_EAGER_BOXING_ENABLE_STATS>();
+  return enabled;
+}
+
+Maybe<void> RecordEagerBoxingRouteStats(const BoxingInterpreterStatus& status, double elapsed_us) {
+  const auto& boxing_cost = JUST(EstimateBoxingCost(status));
+  auto* table = MutRouteStatsTable();
+  std::unique_lock<std::mutex> lock(table->mutex);
+  auto iter = table->status2stats.find(status);
+  if (iter == table->status2stats.end()) {
+    EagerBoxingRouteStats stats;
+    stats.boxing_routing = status.boxing_routing();
+    stats.nd_sbp_routing = status.nd_sbp_routing();
+    stats.placement_routing = status.placement_routing();
+    stats.hop_num = boxing_cost->hop_num;
+    iter = table->status2stats.emplace(status, stats).first;
+  }
+  iter->second.call_num += 1;
+  iter->second.logical_elem_cnt += status.logical_shape().elem_cnt();
+  iter->second.estimated_cost += boxing_cost->cost;
+  iter->second.elapsed_us += elapsed_us;
+  return Maybe<void>::Ok();
+}
+
+std::vector<EagerBoxingRouteStats> GetEagerBoxingRouteStats() {
+  auto* table = MutRouteStatsTable();
+  std::unique_lock<std::mutex> lock(table->mutex);
+  std::vector<EagerBoxingRouteStats> ret;
+  ret.reserve(table->status2stats.size());
+  for (const auto& pair : table->status2stats) { ret.emplace_back(pair.second); }
+  return ret;
+}
+
+void ResetEagerBoxingRouteStats() {
+  auto* table = MutRouteStatsTable();
+  std::unique_lock<std::mutex> lock(table->mutex);
+  table->status2stats.clear();
+}
+
+}  // namespace oneflow
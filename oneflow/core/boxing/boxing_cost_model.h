@@ -0,0 +1,55 @@
+/*
+Copyright 2020 The OneFlow Authors. All rights reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+#ifndef ONEFLOW_CORE_BOXING_BOXING_COST_MODEL_H_
+#define ONEFLOW_CORE_BOXING_BOXING_COST_MODEL_H_
+
+#include "oneflow/core/boxing/boxing_interpreter_status.h"
+
+namespace oneflow {
+
+// The cost model counts the elements received by the busiest rank of every hop, which is what
+// bounds the hop on a bandwidth-limited link, and charges each hop a fixed latency of
+// ONEFLOW_EAGER_BOXING_COST_HOP_ELEM_CNT elements. Local hops (e.g. B -> S, S -> P or identity)
+// move nothing, and point-to-point naive boxing weighs more than collectives.
+struct BoxingCost {
+  int64_t hop_num = 0;
+  double elem_cnt = 0;
+  double cost = 0;
+};
+
+Maybe<BoxingCost> EstimateBoxingCost(const BoxingInterpreterStatus& status);
+
+// Accumulated timing of one boxing route, recorded when ONEFLOW_EAGER_BOXING_ENABLE_STATS is set.
+// Comparing elapsed_us against estimated_cost across routes calibrates the cost model.
+struct EagerBoxingRouteStats {
+  std::string boxing_routing;
+  std::string nd_sbp_routing;
+  std::string placement_routing;
+  int64_t hop_num = 0;
+  int64_t call_num = 0;
+  int64_t logical_elem_cnt = 0;
+  double estimated_cost = 0;
+  double elapsed_us = 0;
+};
+
+bool IsEagerBoxingRouteStatsEnabled();
+Maybe<void> RecordEagerBoxingRouteStats(const BoxingInterpreterStatus& status, double elapsed_us);
+std::vector<EagerBoxingRouteStats> GetEagerBoxingRouteStats();
+void ResetEagerBoxingRouteStats();
+
+}  // namespace oneflow
+
+#endif  // ONEFLOW_CORE_BOXING_BOXING_COST_MODEL_H_
@@ -0,0 +1,97 @@
+/*
+Copyright 2020 The OneFlow Authors. All rights reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+#include "gtest/gtest.h"
+#include "oneflow/core/boxing/boxing_cost_model.h"
+#include "oneflow/core/common/env_var/eager.h"
+#include "oneflow/core/job/parallel_desc.h"
+#include "oneflow/core/job/sbp_parallel.h"
+#include "oneflow/core/control/ctrl_bootstrap.pb.h"
+
+namespace oneflow {
+
+namespace test {
+
+namespace {
+
+struct GlobaProcessCtxScope final {
+  GlobaProcessCtxScope(int64_t node_size, int64_t world_size) {
+    Singleton<ProcessCtx>::New();
+    auto* ctx = Singleton<ProcessCtx>::Get();
+    for (int i = 0; i < world_size; ++i) { ctx->mutable_ctrl_addr()->Add(); }
+    ctx->set_rank(0);
+    ctx->set_node_size(node_size);
+  }
+  ~GlobaProcessCtxScope() { Singleton<ProcessCtx>::Delete(); }
+};
+
+Symbol<PlacedNdSbp> Make1n4dPlacedNdSbp(const std::string& sbp) {
+  ParallelConf parallel_conf;
+  parallel_conf.set_device_tag("cpu");
+  parallel_conf.add_device_name("0:0-3");
+  NdSbp nd_sbp;
+  if (sbp == "B") {
+    nd_sbp.add_sbp_parallel()->mutable_broadcast_parallel();
+  } else if (sbp == "P") {
+    nd_sbp.add_sbp_parallel()->mutable_partial_sum_parallel();
+  } else {
+    nd_sbp.add_sbp_parallel()->mutable_split_parallel()->set_axis(sbp == "S(0)" ? 0 : 1);
+  }
+  return CHECK_JUST(PlacedNdSbp::New(SymbolOf(nd_sbp), SymbolOf(ParallelDesc(parallel_conf))));
+}
+
+std::shared_ptr<BoxingInterpreterStatus> MakeStatus(const std::string& boxing_name,
+                                                    const std::string& in,
+                                                    const std::string& out) {
+  return CHECK_JUST(MakeBoxingInterpreterStatus(boxing_name, Shape({64, 64}),
+                                                Make1n4dPlacedNdSbp(in), Make1n4dPlacedNdSbp(out)));
+}
+
+}  // namespace
+
+TEST(BoxingCostModel, one_hop) {
+  GlobaProcessCtxScope scope(1, 4);
+  const int64_t hop_elem_cnt = EnvInteger<ONEFLOW_EAGER_BOXING_COST_HOP_ELEM_CNT>();
+  const auto& all_gather = CHECK_JUST(EstimateBoxingCost(*MakeStatus("ccl-s-to-b", "S(0)", "B")));
+  ASSERT_EQ(all_gather->hop_num, 1);
+  ASSERT_DOUBLE_EQ(all_gather->elem_cnt, 64 * 64 * 3 / 4);
+  ASSERT_DOUBLE_EQ(all_gather->cost, 64 * 64 * 3 / 4 + hop_elem_cnt);
+  const auto& all_reduce = CHECK_JUST(EstimateBoxingCost(*MakeStatus("ccl-p-to-b", "P", "B")));
+  ASSERT_DOUBLE_EQ(all_reduce->elem_cnt, 2 * 64 * 64 * 3 / 4);
+  const auto& reduce_scatter =
+      CHECK_JUST(EstimateBoxingCost(*MakeStatus("ccl-p-to-s", "P", "S(0)")));
+  ASSERT_DOUBLE_EQ(reduce_scatter->elem_cnt, 64 * 64 * 3 / 4);
+  const auto& naive = CHECK_JUST(EstimateBoxingCost(*MakeStatus("naive-s-to-b", "S(0)", "B")));
+  ASSERT_GT(naive->elem_cnt, all_gather->elem_cnt);
+  const auto& local = CHECK_JUST(EstimateBoxingCost(*MakeStatus("symmetric-b-to-s", "B", "S(1)")));
+  ASSERT_EQ(local->hop_num, 1);
+  ASSERT_DOUBLE_EQ(local->elem_cnt, 0);
+  const auto& identity = CHECK_JUST(EstimateBoxingCost(*MakeStatus("identity", "B", "B")));
+  ASSERT_EQ(identity->hop_num, 0);
+  ASSERT_DOUBLE_EQ(identity->cost, 0);
+}
+
+TEST(BoxingCostModel, multi_hop) {
+  GlobaProcessCtxScope scope(1, 4);
+  const auto& status = CHECK_JUST(MakeComposedBoxingInterpreterStatus(
+      MakeStatus("ccl-s-to-s", "S(1)", "S(0)"), MakeStatus("ccl-s-to-b", "S(0)", "B")));
+  const auto& cost = CHECK_JUST(EstimateBoxingCost(*status));
+  ASSERT_EQ(cost->hop_num, 2);
+  ASSERT_DOUBLE_EQ(cost->elem_cnt, 64 * 16 * 3 / 4 + 64 * 64 * 3 / 4);
+}
+
+}  // namespace test
+
+}  // namespace oneflow
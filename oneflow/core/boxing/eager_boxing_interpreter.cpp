@@ -13,6 +13,7 @@ WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
 See the License for the specific language governing permissions and
 limitations under the License.
 */
+#include <chrono>
 #include <typeinfo>
 #include "oneflow/core/common/container_util.h"
 #include "oneflow/core/common/registry_error.h"
@@ -21,6 +22,8 @@ limitations under the License.
 #include "oneflow/core/framework/to_string.h"
 #include "oneflow/core/boxing/eager_boxing_interpreter_mgr.h"
 #include "oneflow/core/framework/nd_sbp.h"
+#include "oneflow/core/boxing/boxing_cost_model.h"
+#include "oneflow/core/vm/vm_util.h"
 
 namespace oneflow {
 
@@ -30,6 +33,22 @@ Maybe<void> CheckEagerBoxingDataType(DataType val) {
       << Error::RuntimeError() << "invalid boxing data type " << ToString(val);
   return Maybe<void>::Ok();
 }
+
+// The depth of the nested Interpret calls on this thread, e.g. 2 inside the chunks of a
+// pipelined route.
+class InterpretDepthGuard final {
+ public:
+  InterpretDepthGuard() { ++*MutDepth(); }
+  ~InterpretDepthGuard() { --*MutDepth(); }
+
+  bool is_outermost() const { return *MutDepth() == 1; }
+
+ private:
+  static int64_t* MutDepth() {
+    static thread_local int64_t depth = 0;
+    return &depth;
+  }
+};
 }  // namespace
 
 Maybe<one::Tensor> EagerBoxingInterpreter::Interpret(const std::shared_ptr<one::Tensor>& input,
@@ -39,8 +58,20 @@ Maybe<one::Tensor> EagerBoxingInterpreter::Interpret(const std::shared_ptr<one::
                                                      Symbol<ParallelDesc> out_parallel_desc) const {
   JUST(CheckEagerBoxingDataType(input->dtype()->data_type()));
   DisableCheckGlobalTensorMetaScope disable_meta_check;
+  InterpretDepthGuard depth_guard;
+  const auto start = std::chrono::steady_clock::now();
   const auto& tensor =
       JUST(InterpretImpl(input, in_nd_sbp, out_nd_sbp, in_parallel_desc, out_parallel_desc));
+  // Only the outermost route is recorded. Waiting inside the routes it is made of would also
+  // serialize the chunks of a pipelined route.
+  if (unlikely(IsEagerBoxingRouteStatsEnabled()) && depth_guard.is_outermost()) {
+    // wait for the vm so that the device time of the route is included
+    JUST(vm::CurrentRankSync());
+    const double elapsed_us =
+        std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - start)
+            .count();
+    JUST(RecordEagerBoxingRouteStats(*JUST(boxing_interpreter_status()), elapsed_us));
+  }
   const auto& tensor_nd_sbp = JUST(tensor->nd_sbp());
   const auto& tensor_placement = JUST(tensor->parallel_desc());
   CHECK_OR_RETURN(tensor_nd_sbp == out_nd_sbp)
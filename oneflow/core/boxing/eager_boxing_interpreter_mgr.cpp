@@ -19,6 +19,11 @@ limitations under the License.
 #include "oneflow/core/framework/nd_sbp.h"
 #include "oneflow/core/boxing/eager_boxing_interpreter_mgr.h"
 #include "oneflow/core/boxing/boxing_dividor_util.h"
+#include "oneflow/core/boxing/pipelined_eager_boxing_interpreter.h"
+#include "oneflow/core/boxing/boxing_cost_model.h"
+#include "oneflow/core/common/balanced_splitter.h"
+#include "oneflow/core/common/container_util.h"
+#include "oneflow/core/common/env_var/eager.h"
 
 namespace oneflow {
 
@@ -129,36 +134,47 @@ Maybe<BoxingExprIf> GenericBoxingExpr() {
          | JUST(BoxingExpr(JUST(InFirstDeviceAndAllBroadcast()), lhs_boxing, rhs_boxing));
 }
 
+// The top level alternatives of the core boxing expression, in priority order.
+Maybe<std::vector<std::shared_ptr<BoxingExprIf>>> RawCoreBoxingExprCandidates() {
+  return std::make_shared<std::vector<std::shared_ptr<BoxingExprIf>>>(
+      std::vector<std::shared_ptr<BoxingExprIf>>{
+          JUST(BoxingExpr("identity")),
+          JUST(BoxingExpr("copy-h2d")),
+          JUST(BoxingExpr("copy-d2h")),
+          JUST(BoxingExpr("ccl-p-to-b")),
+          JUST(BoxingExpr("ccl-s-to-s")),
+          JUST(SymmetricOneDimSxToBBoxingExpr()),
+          JUST(SymmetricOneDimPToSxBoxingExpr()),
+          JUST(BoxingExpr("symmetric-b-to-p")),
+          JUST(BoxingExpr("symmetric-b-to-s")),
+          JUST(BoxingExpr("symmetric-s-to-p")),
+          JUST(SymmetricOneDimXToBBoxingExpr()),
+          JUST(ASymmetricOneDimXToBBoxingExpr()),
+          JUST(BoxingExpr("naive-1-to-1")),
+          JUST(OneToNBoxingExpr()),
+          JUST(NToOneBoxingExpr()),
+          JUST(BoxingExpr("naive-s-to-s")),
+          JUST(BoxingExpr("naive-s-to-b")),
+          JUST(BoxingExpr("naive-b-to-s")),
+          JUST(BoxingExpr("naive-p-to-b")),
+          JUST(BoxingExpr("naive-p-to-s")),
+          JUST(BoxingExpr("naive-s-to-p")),
+          JUST(BoxingExpr("nd-sbp-dim-reduce")),
+          JUST(SymmetricNDimToNDimBoxingExpr()),
+          JUST(BoxingExpr("generic-symmetric-nd-sbp-to-nd-sbp")),
+          JUST(SymmetricOneDimToNDimBoxingExpr()),
+          JUST(SymmetricNDimToOneDimBoxingExpr()),
+          JUST(GenericBoxingExpr()),
+      });
+}
+
+static constexpr auto* CoreBoxingExprCandidates =
+    DECORATE(&RawCoreBoxingExprCandidates, ThreadLocalCached);
+
 Maybe<BoxingExprIf> RawMainBoxingExpr() {
-  // clang-format off
-  const auto& core = JUST(BoxingExpr("identity"))
-                     | JUST(BoxingExpr("copy-h2d"))
-                     | JUST(BoxingExpr("copy-d2h"))
-                     | JUST(BoxingExpr("ccl-p-to-b"))
-                     | JUST(BoxingExpr("ccl-s-to-s"))
-                     | JUST(SymmetricOneDimSxToBBoxingExpr())
-                     | JUST(SymmetricOneDimPToSxBoxingExpr())
-                     | JUST(BoxingExpr("symmetric-b-to-p"))
-                     | JUST(BoxingExpr("symmetric-b-to-s"))
-                     | JUST(BoxingExpr("symmetric-s-to-p"))
-                     | JUST(SymmetricOneDimXToBBoxingExpr())
-                     | JUST(ASymmetricOneDimXToBBoxingExpr())
-                     | JUST(BoxingExpr("naive-1-to-1"))
-                     | JUST(OneToNBoxingExpr())
-                     | JUST(NToOneBoxingExpr())
-                     | JUST(BoxingExpr("naive-s-to-s"))
-                     | JUST(BoxingExpr("naive-s-to-b"))
-                     | JUST(BoxingExpr("naive-b-to-s"))
-                     | JUST(BoxingExpr("naive-p-to-b"))
-                     | JUST(BoxingExpr("naive-p-to-s"))
-                     | JUST(BoxingExpr("naive-s-to-p"))
-                     | JUST(BoxingExpr("nd-sbp-dim-reduce"))
-                     | JUST(SymmetricNDimToNDimBoxingExpr())
-                     | JUST(BoxingExpr("generic-symmetric-nd-sbp-to-nd-sbp"))
-                     | JUST(SymmetricOneDimToNDimBoxingExpr())
-                     | JUST(SymmetricNDimToOneDimBoxingExpr())
-                     | JUST(GenericBoxingExpr());
-  // clang-format on
+  const auto& candidates = *JUST(CoreBoxingExprCandidates());
+  std::shared_ptr<BoxingExprIf> core = candidates.front();
+  for (size_t i = 1; i < candidates.size(); ++i) { core = core | candidates.at(i); }
   return core | JUST(OptionalCudaCopy(core)) | JUST(OptionalCpuCopy(core));
 }
 
@@ -166,14 +182,38 @@ Maybe<BoxingExprIf> RawMainBoxingExpr() {
 
 static constexpr auto* MainBoxingExpr = DECORATE(&RawMainBoxingExpr, ThreadLocalCached);
 
-Maybe<EagerBoxingInterpreter> GetBoxingInterpreter(Symbol<NdSbp> in_nd_sbp,
-                                                   Symbol<NdSbp> out_nd_sbp,
-                                                   Symbol<ParallelDesc> in_parallel_desc,
-                                                   Symbol<ParallelDesc> out_parallel_desc,
-                                                   const Shape& logical_shape) {
+// Picks the core candidate route with the lowest estimated cost. Ties keep the priority order, so
+// the result only differs from the main boxing expression when another route is strictly cheaper.
+// Routes through a device copy stay a last resort of the main boxing expression. The result is
+// not cached here, the interpreter built from it is cached per exact shape.
+Maybe<BoxingExprIf> SelectBoxingExpr(Symbol<PlacedNdSbp> in, Symbol<PlacedNdSbp> out,
+                                     const Shape& logical_shape) {
+  if (!EnvBool<ONEFLOW_EAGER_BOXING_ENABLE_COST_MODEL>()) { return JUST(MainBoxingExpr()); }
+  const auto& candidates = *JUST(CoreBoxingExprCandidates());
+  Optional<size_t> best_idx;
+  double best_cost = 0;
+  for (size_t i = 0; i < candidates.size(); ++i) {
+    const auto& status = TRY(candidates.at(i)->Check(in, out, logical_shape));
+    if (!status.IsOk()) { continue; }
+    const double cost = JUST(EstimateBoxingCost(*JUST(status)))->cost;
+    if (!best_idx.has_value() || cost < best_cost) {
+      best_idx = i;
+      best_cost = cost;
+    }
+  }
+  // no route applies, let the main boxing expression report it
+  if (!best_idx.has_value()) { return JUST(MainBoxingExpr()); }
+  return JUST(VectorAt(candidates, JUST(best_idx)));
+}
+
+Maybe<EagerBoxingInterpreter> GetNaiveBoxingInterpreter(Symbol<NdSbp> in_nd_sbp,
+                                                        Symbol<NdSbp> out_nd_sbp,
+                                                        Symbol<ParallelDesc> in_parallel_desc,
+                                                        Symbol<ParallelDesc> out_parallel_desc,
+                                                        const Shape& logical_shape) {
   const auto& in = JUST(PlacedNdSbp::New(in_nd_sbp, in_parallel_desc));
   const auto& out = JUST(PlacedNdSbp::New(out_nd_sbp, out_parallel_desc));
-  const auto& main_boxing_expr = JUST(MainBoxingExpr());
+  const auto& main_boxing_expr = JUST(SelectBoxingExpr(in, out, logical_shape));
   const auto& status = TRY(main_boxing_expr->Check(in, out, logical_shape));
   if (status.IsOk()) {
     const auto& boxing_func = JUST(main_boxing_expr->GetBoxingFunction(in, out, logical_shape));
@@ -188,6 +228,55 @@ Maybe<EagerBoxingInterpreter> GetBoxingInterpreter(Symbol<NdSbp> in_nd_sbp,
                               << ", to_placement: " << *JUST(PlacementToString(out_parallel_desc));
 }
 
+static constexpr auto* CachedGetNaiveBoxingInterpreter =
+    DECORATE(&GetNaiveBoxingInterpreter, ThreadLocalCachedCopiable);
+
+Maybe<BoxingInterpreterStatus> MakePipelinedBoxingInterpreterStatus(
+    const BoxingInterpreterStatus& status) {
+  std::vector<std::string> boxing_names{"pipelined"};
+  boxing_names.insert(boxing_names.end(), status.sorted_boxing_names()->begin(),
+                      status.sorted_boxing_names()->end());
+  return std::make_shared<BoxingInterpreterStatus>(
+      SymbolOf(boxing_names), status.logical_shape(), status.src_placed_nd_sbp(),
+      status.mid_placed_nd_sbp(), status.dst_placed_nd_sbp());
+}
+
+// Large tensors are boxed chunk by chunk so that multi-hop boxing chains overlap the transfers
+// of adjacent chunks and never materialize a full-size intermediate tensor.
+Maybe<EagerBoxingInterpreter> GetBoxingInterpreter(Symbol<NdSbp> in_nd_sbp,
+                                                   Symbol<NdSbp> out_nd_sbp,
+                                                   Symbol<ParallelDesc> in_parallel_desc,
+                                                   Symbol<ParallelDesc> out_parallel_desc,
+                                                   const Shape& logical_shape) {
+  const auto& interpreter = JUST(CachedGetNaiveBoxingInterpreter(
+      in_nd_sbp, out_nd_sbp, in_parallel_desc, out_parallel_desc, logical_shape));
+  if (in_parallel_desc != out_parallel_desc) { return interpreter; }
+  const int64_t chunk_axis = GetPipelinedBoxingChunkAxis(in_nd_sbp, out_nd_sbp, logical_shape);
+  if (chunk_axis < 0) { return interpreter; }
+  const int64_t chunk_num = GetPipelinedBoxingChunkNum(logical_shape, chunk_axis);
+  if (chunk_num <= 1) { return interpreter; }
+  const BalancedSplitter bs(logical_shape.At(chunk_axis), chunk_num);
+  std::vector<std::shared_ptr<EagerBoxingInterpreter>> chunk_interpreters;
+  chunk_interpreters.reserve(chunk_num);
+  Shape chunk_shape(logical_shape);
+  for (int64_t i = 0; i < chunk_num; ++i) {
+    chunk_shape.Set(chunk_axis, bs.At(i).size());
+    const auto& chunk_interpreter = TRY(CachedGetNaiveBoxingInterpreter(
+        in_nd_sbp, out_nd_sbp, in_parallel_desc, out_parallel_desc, chunk_shape));
+    // some boxing methods depend on divisibility, keep the whole-tensor route in that case
+    if (!chunk_interpreter.IsOk()) {
+      VLOG(2) << "no eager boxing route for chunk shape " << chunk_shape.ToString()
+              << ", boxing the whole tensor of shape " << logical_shape.ToString();
+      return interpreter;
+    }
+    chunk_interpreters.emplace_back(JUST(chunk_interpreter));
+  }
+  const auto& status =
+      JUST(MakePipelinedBoxingInterpreterStatus(*JUST(interpreter->boxing_interpreter_status())));
+  return std::shared_ptr<EagerBoxingInterpreter>(
+      new PipelinedEagerBoxingInterpreter(chunk_axis, chunk_interpreters, interpreter, status));
+}
+
 static constexpr auto* CachedGetBoxingInterpreter =
     DECORATE(&GetBoxingInterpreter, ThreadLocalCachedCopiable);
 
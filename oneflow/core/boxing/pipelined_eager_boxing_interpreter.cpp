@@ -0,0 +1,120 @@
+/*
+Copyright 2020 The OneFlow Authors. All rights reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+#include "oneflow/core/boxing/pipelined_eager_boxing_interpreter.h"
+#include "oneflow/core/common/balanced_splitter.h"
+#include "oneflow/core/common/container_util.h"
+#include "oneflow/core/common/env_var/eager.h"
+#include "oneflow/core/framework/nd_sbp.h"
+#include "oneflow/core/functional/functional.h"
+
+namespace oneflow {
+
+namespace {
+
+bool IsSplitAlongAxis(Symbol<NdSbp> nd_sbp, int64_t axis) {
+  for (const auto& sbp_parallel : nd_sbp->sbp_parallel()) {
+    if (sbp_parallel.has_split_parallel() && sbp_parallel.split_parallel().axis() == axis) {
+      return true;
+    }
+  }
+  return false;
+}
+
+}  // namespace
+
+int64_t GetPipelinedBoxingChunkAxis(Symbol<NdSbp> in_nd_sbp, Symbol<NdSbp> out_nd_sbp,
+                                    const Shape& logical_shape) {
+  const int64_t chunk_elem_cnt = EnvInteger<ONEFLOW_EAGER_BOXING_PIPELINE_CHUNK_ELEM_CNT>();
+  if (chunk_elem_cnt <= 0 || logical_shape.elem_cnt() < 2 * chunk_elem_cnt) { return -1; }
+  int64_t chunk_axis = -1;
+  for (int64_t axis = 0; axis < logical_shape.NumAxes(); ++axis) {
+    if (IsSplitAlongAxis(in_nd_sbp, axis) || IsSplitAlongAxis(out_nd_sbp, axis)) { continue; }
+    if (logical_shape.At(axis) < 2) { continue; }
+    // prefer the longest axis, and the outermost one among equals for contiguous chunks
+    if (chunk_axis < 0 || logical_shape.At(axis) > logical_shape.At(chunk_axis)) {
+      chunk_axis = axis;
+    }
+  }
+  return chunk_axis;
+}
+
+int64_t GetPipelinedBoxingChunkNum(const Shape& logical_shape, int64_t chunk_axis) {
+  const int64_t chunk_elem_cnt = EnvInteger<ONEFLOW_EAGER_BOXING_PIPELINE_CHUNK_ELEM_CNT>();
+  if (chunk_elem_cnt <= 0) { return 1; }
+  const int64_t chunk_num = (logical_shape.elem_cnt() + chunk_elem_cnt - 1) / chunk_elem_cnt;
+  return std::min(chunk_num, logical_shape.At(chunk_axis));
+}
+
+Maybe<one::Tensor> PipelinedEagerBoxingInterpreter::InterpretImpl(
+    const std::shared_ptr<one::Tensor>& input, Symbol<NdSbp> in_nd_sbp, Symbol<NdSbp> out_nd_sbp,
+    Symbol<ParallelDesc> in_parallel_desc, Symbol<ParallelDesc> out_parallel_desc) const {
+  CHECK_OR_RETURN(in_parallel_desc == out_parallel_desc)
+      << Error::RuntimeError() << "pipelined boxing requires identical in and out placements";
+  const auto& parallel_id = JUST(GetParallelId4CurrentProcessCtx(in_parallel_desc));
+  if (!parallel_id->has_value()) {
+    return JUST(whole_interpreter_->Interpret(input, in_nd_sbp, out_nd_sbp, in_parallel_desc,
+                                              out_parallel_desc));
+  }
+  const auto& in_sbp_list = JUST(GetSbpList(in_nd_sbp));
+  const auto& out_sbp_list = JUST(GetSbpList(out_nd_sbp));
+  const auto& local_tensor = JUST(input->cur_rank_phy_tensor());
+  const int64_t axis_dim = input->shape()->At(chunk_axis_);
+  CHECK_EQ_OR_RETURN(local_tensor->shape()->At(chunk_axis_), axis_dim)
+      << Error::RuntimeError() << "pipelined boxing chunk axis " << chunk_axis_
+      << " must not be split";
+
+  const int64_t num_axes = local_tensor->shape()->NumAxes();
+  std::vector<int64_t> in_start(num_axes, 0);
+  std::vector<int64_t> in_stop(local_tensor->shape()->begin(), local_tensor->shape()->end());
+  std::vector<int64_t> step(num_axes, 1);
+  std::vector<int64_t> out_start(num_axes, 0);
+  std::vector<int64_t> out_stop;
+  Shape chunk_shape(*input->shape());
+  std::shared_ptr<one::Tensor> local_output;
+  const BalancedSplitter bs(axis_dim, chunk_interpreters_.size());
+  for (int64_t i = 0; i < chunk_interpreters_.size(); ++i) {
+    const Range range = bs.At(i);
+    in_start[chunk_axis_] = range.begin();
+    in_stop[chunk_axis_] = range.end();
+    chunk_shape.Set(chunk_axis_, range.size());
+    std::shared_ptr<one::Tensor> chunk = JUST(one::functional::Slice(
+        local_tensor, in_start, in_stop, step, /*enable_view_slice=*/false));
+    chunk = JUST(one::functional::LocalToGlobal(chunk, in_parallel_desc, *in_sbp_list, chunk_shape,
+                                                input->dtype(), /* sync_data */ false,
+                                                /*copy=*/false));
+    const auto& chunk_interpreter = JUST(VectorAt(chunk_interpreters_, i));
+    chunk = JUST(chunk_interpreter->Interpret(chunk, in_nd_sbp, out_nd_sbp, in_parallel_desc,
+                                              out_parallel_desc));
+    const auto& local_chunk = JUST(chunk->cur_rank_phy_tensor());
+    if (!local_output) {
+      Shape local_output_shape(*local_chunk->shape());
+      local_output_shape.Set(chunk_axis_, axis_dim);
+      local_output = JUST(one::functional::Empty(local_output_shape, local_chunk->dtype(),
+                                                 JUST(local_chunk->device()),
+                                                 /*requires_grad=*/false, /*pin_memory=*/false));
+      out_stop.assign(local_output_shape.begin(), local_output_shape.end());
+    }
+    out_start[chunk_axis_] = range.begin();
+    out_stop[chunk_axis_] = range.end();
+    JUST(one::functional::SliceUpdate(local_output, local_chunk, out_start, out_stop, step,
+                                      /*inplace=*/true));
+  }
+  return JUST(one::functional::LocalToGlobal(local_output, out_parallel_desc, *out_sbp_list,
+                                             *input->shape(), input->dtype(),
+                                             /* sync_data */ false, /*copy=*/false));
+}
+
+}  // namespace oneflow
@@ -0,0 +1,72 @@
+/*
+Copyright 2020 The OneFlow Authors. All rights reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+#ifndef ONEFLOW_CORE_BOXING_PIPELINED_EAGER_BOXING_INTERPRETER_H_
+#define ONEFLOW_CORE_BOXING_PIPELINED_EAGER_BOXING_INTERPRETER_H_
+
+#include "oneflow/core/boxing/eager_boxing_interpreter.h"
+
+namespace oneflow {
+
+// Returns the axis along which a tensor of `logical_shape` is cut into pipelined boxing chunks, or
+// -1 if it is too small to be worth pipelining or every axis is split by `in_nd_sbp` or
+// `out_nd_sbp`. Along such an axis the local tensor of every rank has the full logical extent, so
+// a chunk of the global tensor is exactly the same slice of each local tensor.
+int64_t GetPipelinedBoxingChunkAxis(Symbol<NdSbp> in_nd_sbp, Symbol<NdSbp> out_nd_sbp,
+                                    const Shape& logical_shape);
+
+// Returns the number of chunks `logical_shape` is cut into along `chunk_axis`.
+int64_t GetPipelinedBoxingChunkNum(const Shape& logical_shape, int64_t chunk_axis);
+
+// Streams a large global tensor through a boxing chain chunk by chunk. Each chunk is sliced out of
+// the local tensor, boxed by the interpreter chosen for its chunk shape and written back into the
+// local output. Since every step is dispatched to the vm asynchronously, slicing chunk i + 1
+// overlaps the transfer of chunk i, and the intermediate tensors of multi-hop chains (e.g.
+// S(0) -> B -> S(1)) are chunk sized instead of fully materialized.
+class PipelinedEagerBoxingInterpreter final : public EagerBoxingInterpreter {
+ public:
+  PipelinedEagerBoxingInterpreter(
+      int64_t chunk_axis,
+      const std::vector<std::shared_ptr<EagerBoxingInterpreter>>& chunk_interpreters,
+      const std::shared_ptr<EagerBoxingInterpreter>& whole_interpreter,
+      const std::shared_ptr<BoxingInterpreterStatus>& boxing_interpreter_status)
+      : chunk_axis_(chunk_axis),
+        chunk_interpreters_(chunk_interpreters),
+        whole_interpreter_(whole_interpreter),
+        boxing_interpreter_status_(boxing_interpreter_status) {}
+  PipelinedEagerBoxingInterpreter(const PipelinedEagerBoxingInterpreter&) = delete;
+  PipelinedEagerBoxingInterpreter(PipelinedEagerBoxingInterpreter&&) = delete;
+  ~PipelinedEagerBoxingInterpreter() override = default;
+
+  Maybe<BoxingInterpreterStatus> boxing_interpreter_status() const override {
+    return boxing_interpreter_status_;
+  }
+
+ private:
+  Maybe<one::Tensor> InterpretImpl(const std::shared_ptr<one::Tensor>& input,
+                                   Symbol<NdSbp> in_nd_sbp, Symbol<NdSbp> out_nd_sbp,
+                                   Symbol<ParallelDesc> in_parallel_desc,
+                                   Symbol<ParallelDesc> out_parallel_desc) const override;
+
+  const int64_t chunk_axis_;
+  const std::vector<std::shared_ptr<EagerBoxingInterpreter>> chunk_interpreters_;
+  // used on ranks outside the placement, which hold no data to slice
+  const std::shared_ptr<EagerBoxingInterpreter> whole_interpreter_;
+  const std::shared_ptr<BoxingInterpreterStatus> boxing_interpreter_status_;
+};
+
+}  // namespace oneflow
+
+#endif  // ONEFLOW_CORE_BOXING_PIPELINED_EAGER_BOXING_INTERPRETER_H_
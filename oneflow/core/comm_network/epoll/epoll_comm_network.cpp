@@ -17,12 +17,16 @@ limitations under the License.
 
 #include "oneflow/core/comm_network/epoll/epoll_comm_network.h"
 #include "glog/logging.h"
+#include "oneflow/core/common/balanced_splitter.h"
+#include "oneflow/core/common/env_var/comm_net.h"
 #include "oneflow/core/control/ctrl_client.h"
 #include "oneflow/core/control/global_process_ctx.h"
 #include "oneflow/core/job/resource_desc.h"
 #include "oneflow/core/job/env_desc.h"
 #include "oneflow/core/job/global_for.h"
 #include <netinet/tcp.h>
+#include <climits>
+#include <fstream>
 
 namespace oneflow {
 
@@ -30,6 +34,18 @@ namespace {
 
 static const int32_t kInvlidPort = 0;
 
+// Sent by the connecting side right after connect.
+struct ConnHandshake {
+  int64_t machine_id;
+  int64_t conn_id;
+};
+
+// Replaces the read_id handed to the peer, so that ReadDone fires once all stripes are in.
+struct StripedReadContext {
+  void* read_id;
+  std::atomic<int64_t> done_stripe_cnt;
+};
+
 sockaddr_in GetSockAddr(const std::string& addr, uint16_t port) {
   sockaddr_in sa;
   sa.sin_family = AF_INET;
@@ -39,7 +55,7 @@ sockaddr_in GetSockAddr(const std::string& addr, uint16_t port) {
   return sa;
 }
 
-int SockListen(int listen_sockfd, int32_t* listen_port, int32_t total_machine_num) {
+int SockListen(int listen_sockfd, int32_t* listen_port, int32_t backlog) {
   // System designated available port if listen_port == kInvlidPort, otherwise, the configured port
   // is used.
   sockaddr_in sa = GetSockAddr("0.0.0.0", *listen_port);
@@ -59,7 +75,7 @@ int SockListen(int listen_sockfd, int32_t* listen_port, int32_t total_machine_nu
     }
   }
   if (bind_result == 0) {
-    PCHECK(listen(listen_sockfd, total_machine_num) == 0);
+    PCHECK(listen(listen_sockfd, backlog) == 0);
     LOG(INFO) << "CommNet:Epoll listening on "
               << "0.0.0.0:" + std::to_string(*listen_port);
   } else {
@@ -82,6 +98,23 @@ uint16_t PullPort(int64_t machine_id) {
   return port;
 }
 
+std::string GenShmRingKey(const std::string& field, int64_t src_machine_id,
+                          int64_t dst_machine_id) {
+  return "EpollShmRing/" + field + "/" + std::to_string(src_machine_id) + "-"
+         + std::to_string(dst_machine_id);
+}
+
+// Processes in different containers may share the boot id but not /dev/shm, which opening the
+// ring catches.
+std::string GetHostId() {
+  char hostname[HOST_NAME_MAX + 1] = {0};
+  PCHECK(gethostname(hostname, HOST_NAME_MAX) == 0);
+  std::string boot_id;
+  std::ifstream boot_id_file("/proc/sys/kernel/random/boot_id");
+  std::getline(boot_id_file, boot_id);
+  return std::string(hostname) + "/" + boot_id;
+}
+
 }  // namespace
 
 EpollCommNet::~EpollCommNet() {
@@ -89,7 +122,10 @@ EpollCommNet::~EpollCommNet() {
     VLOG(1) << "CommNet Thread " << i << " finish";
     pollers_[i]->Stop();
   }
+  shm_ring_read_chan_.Close();
+  if (shm_ring_reader_.joinable()) { shm_ring_reader_.join(); }
   OF_ENV_BARRIER();
+  for (const auto& key : shm_ring_keys_) { Singleton<CtrlClient>::Get()->ClearKV(key); }
   for (IOEventPoller* poller : pollers_) { delete poller; }
   for (auto& pair : sockfd2helper_) { delete pair.second; }
 }
@@ -115,6 +151,90 @@ void EpollCommNet::SendSocketMsg(int64_t dst_machine_id, const SocketMsg& msg) {
   GetSocketHelper(dst_machine_id)->AsyncWrite(msg);
 }
 
+void EpollCommNet::SendPayload(int64_t dst_machine_id, const RequestReadMsg& request_read_msg) {
+  if (machine_id2send_ring_.at(dst_machine_id)) {
+    SendPayloadThroughShmRing(dst_machine_id, request_read_msg);
+    return;
+  }
+  auto src_mem_desc = static_cast<const SocketMemDesc*>(request_read_msg.src_token);
+  const size_t byte_size = src_mem_desc->byte_size;
+  const int64_t stripe_num = std::max<int64_t>(
+      std::min<int64_t>(byte_size / min_stripe_size_, conn_num_per_peer_), 1);
+  const int64_t first_conn_id = next_payload_conn_id_.fetch_add(1, std::memory_order_relaxed);
+  BalancedSplitter bs(byte_size, stripe_num);
+  FOR_RANGE(int64_t, i, 0, stripe_num) {
+    SocketMsg msg;
+    msg.msg_type = SocketMsgType::kRequestRead;
+    msg.request_read_msg = request_read_msg;
+    msg.request_read_msg.offset = bs.At(i).begin();
+    msg.request_read_msg.size = bs.At(i).size();
+    msg.request_read_msg.stripe_num = stripe_num;
+    GetSocketHelper(dst_machine_id, (first_conn_id + i) % conn_num_per_peer_)->AsyncWrite(msg);
+  }
+}
+
+void EpollCommNet::SendPayloadThroughShmRing(int64_t dst_machine_id,
+                                             const RequestReadMsg& request_read_msg) {
+  ShmPayloadRing* ring = machine_id2send_ring_.at(dst_machine_id).get();
+  auto src_mem_desc = static_cast<const SocketMemDesc*>(request_read_msg.src_token);
+  const size_t byte_size = src_mem_desc->byte_size;
+  // Stripes are a fraction of the ring, so that the peer drains one while the next is copied in,
+  // and no larger than the socket stripes, so that one never holds up the ring reader for long.
+  const size_t stripe_size =
+      std::max<size_t>(std::min<size_t>(ring->capacity() / 4, min_stripe_size_), 1);
+  const int64_t stripe_num =
+      std::max<int64_t>((byte_size + stripe_size - 1) / stripe_size, 1);
+  BalancedSplitter bs(byte_size, stripe_num);
+  FOR_RANGE(int64_t, i, 0, stripe_num) {
+    SocketMsg msg;
+    msg.msg_type = SocketMsgType::kRequestRead;
+    msg.request_read_msg = request_read_msg;
+    msg.request_read_msg.offset = bs.At(i).begin();
+    msg.request_read_msg.size = bs.At(i).size();
+    msg.request_read_msg.stripe_num = stripe_num;
+    msg.request_read_msg.src_machine_id = GlobalProcessCtx::Rank();
+    const char* stripe_ptr =
+        static_cast<const char*>(src_mem_desc->mem_ptr) + msg.request_read_msg.offset;
+    const bool pushed =
+        ring->TryPush(stripe_ptr, msg.request_read_msg.size, [&](uint64_t ring_pos) {
+          msg.request_read_msg.in_shm_ring = true;
+          msg.request_read_msg.ring_pos = ring_pos;
+          // ring positions must reach the peer in push order, so they all use connection 0
+          GetSocketHelper(dst_machine_id)->AsyncWrite(msg);
+        });
+    if (pushed) {
+      shm_ring_stripe_num_.fetch_add(1, std::memory_order_relaxed);
+    } else {
+      // the peer has not drained the ring yet, send the bytes over the sockets instead of waiting
+      msg.request_read_msg.in_shm_ring = false;
+      const int64_t conn_id = next_payload_conn_id_.fetch_add(1, std::memory_order_relaxed);
+      GetSocketHelper(dst_machine_id, conn_id % conn_num_per_peer_)->AsyncWrite(msg);
+      shm_ring_fallback_stripe_num_.fetch_add(1, std::memory_order_relaxed);
+    }
+  }
+}
+
+void EpollCommNet::ReadShmRingStripe(const RequestReadMsg& msg) {
+  CHECK_EQ(shm_ring_read_chan_.Send(msg), kChannelStatusSuccess);
+}
+
+void EpollCommNet::PopShmRingStripe(const RequestReadMsg& msg) {
+  auto dst_mem_desc = static_cast<const SocketMemDesc*>(msg.dst_token);
+  CHECK_LE(msg.offset + msg.size, dst_mem_desc->byte_size);
+  ShmPayloadRing* ring = machine_id2recv_ring_.at(msg.src_machine_id).get();
+  CHECK_NOTNULL(ring);
+  ring->Pop(msg.ring_pos, msg.size, reinterpret_cast<char*>(dst_mem_desc->mem_ptr) + msg.offset);
+  StripeReadDone(msg.read_id, msg.stripe_num);
+}
+
+void EpollCommNet::StripeReadDone(void* striped_read_id, int64_t stripe_num) {
+  auto* ctx = static_cast<StripedReadContext*>(striped_read_id);
+  if (ctx->done_stripe_cnt.fetch_add(1, std::memory_order_acq_rel) + 1 == stripe_num) {
+    ReadDone(ctx->read_id);
+    delete ctx;
+  }
+}
+
 SocketMemDesc* EpollCommNet::NewMemDesc(void* ptr, size_t byte_size) {
   SocketMemDesc* mem_desc = new SocketMemDesc;
   mem_desc->mem_ptr = ptr;
@@ -123,9 +243,16 @@ SocketMemDesc* EpollCommNet::NewMemDesc(void* ptr, size_t byte_size) {
 }
 
 EpollCommNet::EpollCommNet() : CommNetIf() {
+  conn_num_per_peer_ = EnvInteger<ONEFLOW_COMM_NET_EPOLL_CONNECTIONS_PER_PEER>();
+  CHECK_GE(conn_num_per_peer_, 1);
+  min_stripe_size_ = std::max<int64_t>(EnvInteger<ONEFLOW_COMM_NET_EPOLL_MIN_STRIPE_SIZE>(), 1);
+  next_payload_conn_id_ = 0;
+  shm_ring_stripe_num_ = 0;
+  shm_ring_fallback_stripe_num_ = 0;
   pollers_.resize(Singleton<ResourceDesc, ForSession>::Get()->CommNetWorkerNum(), nullptr);
   for (size_t i = 0; i < pollers_.size(); ++i) { pollers_[i] = new IOEventPoller; }
   InitSockets();
+  InitShmRings();
   for (IOEventPoller* poller : pollers_) { poller->Start(); }
 }
 
@@ -133,8 +260,10 @@ void EpollCommNet::InitSockets() {
   int64_t this_machine_id = GlobalProcessCtx::Rank();
   auto this_machine = Singleton<ResourceDesc, ForSession>::Get()->machine(this_machine_id);
   int64_t total_machine_num = Singleton<ResourceDesc, ForSession>::Get()->process_ranks().size();
-  machine_id2sockfd_.assign(total_machine_num, -1);
+  machine_id2sockfds_.assign(total_machine_num, std::vector<int>(conn_num_per_peer_, -1));
   sockfd2helper_.clear();
+  // Connections are created peer by peer, so round-robin also spreads the connections of one
+  // peer over different pollers.
   size_t poller_idx = 0;
   auto NewSocketHelper = [&](int sockfd) {
     IOEventPoller* poller = pollers_[poller_idx];
@@ -152,7 +281,8 @@ void EpollCommNet::InitSockets() {
       this_listen_port = Singleton<EnvDesc>::Get()->data_port();
     }
   }
-  CHECK_EQ(SockListen(listen_sockfd, &this_listen_port, total_machine_num), 0);
+  CHECK_EQ(SockListen(listen_sockfd, &this_listen_port, total_machine_num * conn_num_per_peer_),
+           0);
   CHECK_NE(this_listen_port, 0);
   PushPort(this_machine_id, this_listen_port);
   int32_t src_machine_count = 0;
@@ -166,42 +296,132 @@ void EpollCommNet::InitSockets() {
     uint16_t peer_port = PullPort(peer_id);
     auto peer_machine = Singleton<ResourceDesc, ForSession>::Get()->machine(peer_id);
     sockaddr_in peer_sockaddr = GetSockAddr(peer_machine.addr(), peer_port);
-    int sockfd = socket(AF_INET, SOCK_STREAM, 0);
-    const int val = 1;
-    PCHECK(setsockopt(sockfd, IPPROTO_TCP, TCP_NODELAY, (char*)&val, sizeof(int)) == 0);
-    PCHECK(connect(sockfd, reinterpret_cast<sockaddr*>(&peer_sockaddr), sizeof(peer_sockaddr))
-           == 0);
-    ssize_t n = write(sockfd, &this_machine_id, sizeof(int64_t));
-    PCHECK(n == sizeof(int64_t));
-    CHECK(sockfd2helper_.emplace(sockfd, NewSocketHelper(sockfd)).second);
-    machine_id2sockfd_[peer_id] = sockfd;
+    FOR_RANGE(int64_t, conn_id, 0, conn_num_per_peer_) {
+      int sockfd = socket(AF_INET, SOCK_STREAM, 0);
+      const int val = 1;
+      PCHECK(setsockopt(sockfd, IPPROTO_TCP, TCP_NODELAY, (char*)&val, sizeof(int)) == 0);
+      PCHECK(connect(sockfd, reinterpret_cast<sockaddr*>(&peer_sockaddr), sizeof(peer_sockaddr))
+             == 0);
+      ConnHandshake handshake{this_machine_id, conn_id};
+      ssize_t n = write(sockfd, &handshake, sizeof(handshake));
+      PCHECK(n == sizeof(handshake));
+      CHECK(sockfd2helper_.emplace(sockfd, NewSocketHelper(sockfd)).second);
+      machine_id2sockfds_[peer_id][conn_id] = sockfd;
+    }
   }
 
   // accept
-  HashSet<int64_t> processed_ranks;
-  FOR_RANGE(int32_t, idx, 0, src_machine_count) {
+  FOR_RANGE(int64_t, idx, 0, src_machine_count * conn_num_per_peer_) {
     sockaddr_in peer_sockaddr;
     socklen_t len = sizeof(peer_sockaddr);
     int sockfd = accept(listen_sockfd, reinterpret_cast<sockaddr*>(&peer_sockaddr), &len);
     PCHECK(sockfd != -1);
-    int64_t peer_rank;
-    ssize_t n = read(sockfd, &peer_rank, sizeof(int64_t));
-    PCHECK(n == sizeof(int64_t));
+    ConnHandshake handshake{};
+    ssize_t n = read(sockfd, &handshake, sizeof(handshake));
+    PCHECK(n == sizeof(handshake));
+    CHECK_GE(handshake.conn_id, 0);
+    CHECK_LT(handshake.conn_id, conn_num_per_peer_);
+    int& peer_sockfd = machine_id2sockfds_.at(handshake.machine_id).at(handshake.conn_id);
+    CHECK_EQ(peer_sockfd, -1);
     CHECK(sockfd2helper_.emplace(sockfd, NewSocketHelper(sockfd)).second);
-    CHECK(processed_ranks.emplace(peer_rank).second);
-    machine_id2sockfd_[peer_rank] = sockfd;
+    peer_sockfd = sockfd;
   }
   PCHECK(close(listen_sockfd) == 0);
   ClearPort(this_machine_id);
 
   // useful log
   FOR_RANGE(int64_t, machine_id, 0, total_machine_num) {
-    VLOG(2) << "machine " << machine_id << " sockfd " << machine_id2sockfd_[machine_id];
+    VLOG(2) << "machine " << machine_id << " sockfds "
+            << fmt::format("{}", fmt::join(machine_id2sockfds_[machine_id], ","));
+  }
+}
+
+void EpollCommNet::InitShmRings() {
+  const int64_t this_machine_id = GlobalProcessCtx::Rank();
+  machine_id2send_ring_.assign(machine_id2sockfds_.size(), nullptr);
+  machine_id2recv_ring_.assign(machine_id2sockfds_.size(), nullptr);
+  // Every rank takes part in each exchange below even if rings are disabled, since peers block on
+  // its keys; an empty host id matches no peer.
+  const int64_t ring_size = EnvInteger<ONEFLOW_COMM_NET_EPOLL_SHM_RING_SIZE>();
+  const std::string host_id = ring_size > 0 ? GetHostId() : "";
+  auto* ctrl_client = Singleton<CtrlClient>::Get();
+  auto PushKVs = [&](const std::vector<std::string>& keys, const std::vector<std::string>& vals) {
+    ctrl_client->PushKVs(keys, vals);
+    shm_ring_keys_.insert(shm_ring_keys_.end(), keys.begin(), keys.end());
+  };
+  const std::vector<int64_t> peers(peer_machine_id().begin(), peer_machine_id().end());
+
+  // find the peers on this host
+  PushKVs({GenShmRingKey("host", this_machine_id, this_machine_id)}, {host_id});
+  std::vector<std::string> keys;
+  std::vector<std::string> vals;
+  for (int64_t peer_id : peers) { keys.push_back(GenShmRingKey("host", peer_id, peer_id)); }
+  ctrl_client->PullKVs(keys, &vals);
+  std::vector<int64_t> local_peers;
+  FOR_RANGE(size_t, i, 0, peers.size()) {
+    if (!host_id.empty() && vals.at(i) == host_id) { local_peers.push_back(peers.at(i)); }
+  }
+  if (local_peers.empty()) { return; }
+
+  // create the ring to each local peer and open the ring from it
+  keys.clear();
+  vals.clear();
+  for (int64_t peer_id : local_peers) {
+    const auto& ring = TRY(ShmPayloadRing::Create(ring_size));
+    if (ring.IsOk()) { machine_id2send_ring_.at(peer_id) = CHECK_JUST(ring); }
+    keys.push_back(GenShmRingKey("name", this_machine_id, peer_id));
+    vals.push_back(ring.IsOk() ? CHECK_JUST(ring)->name() : "");
+  }
+  PushKVs(keys, vals);
+  keys.clear();
+  for (int64_t peer_id : local_peers) {
+    keys.push_back(GenShmRingKey("name", peer_id, this_machine_id));
+  }
+  ctrl_client->PullKVs(keys, &vals);
+  FOR_RANGE(size_t, i, 0, local_peers.size()) {
+    if (vals.at(i).empty()) { continue; }
+    const auto& ring = TRY(ShmPayloadRing::Open(vals.at(i)));
+    if (ring.IsOk()) { machine_id2recv_ring_.at(local_peers.at(i)) = CHECK_JUST(ring); }
+  }
+
+  // only send through the rings the peers managed to open
+  keys.clear();
+  vals.clear();
+  for (int64_t peer_id : local_peers) {
+    keys.push_back(GenShmRingKey("opened", peer_id, this_machine_id));
+    vals.push_back(machine_id2recv_ring_.at(peer_id) ? "1" : "0");
+  }
+  PushKVs(keys, vals);
+  keys.clear();
+  for (int64_t peer_id : local_peers) {
+    keys.push_back(GenShmRingKey("opened", this_machine_id, peer_id));
+  }
+  ctrl_client->PullKVs(keys, &vals);
+  FOR_RANGE(size_t, i, 0, local_peers.size()) {
+    auto& ring = machine_id2send_ring_.at(local_peers.at(i));
+    if (!ring) { continue; }
+    CHECK_JUST(ring->Unlink());
+    if (vals.at(i) != "1") { ring.reset(); }
+  }
+  const auto CountRings = [](const std::vector<std::shared_ptr<ShmPayloadRing>>& rings) {
+    return std::count_if(rings.begin(), rings.end(), [](const auto& ring) { return !!ring; });
+  };
+  const int64_t recv_ring_num = CountRings(machine_id2recv_ring_);
+  LOG(INFO) << "CommNet:Epoll shared memory rings to " << CountRings(machine_id2send_ring_)
+            << " and from " << recv_ring_num << " of " << local_peers.size()
+            << " peers on this host";
+  if (recv_ring_num > 0) {
+    shm_ring_reader_ = std::thread([this]() {
+      RequestReadMsg msg;
+      while (shm_ring_read_chan_.Receive(&msg) == kChannelStatusSuccess) {
+        PopShmRingStripe(msg);
+      }
+    });
   }
 }
 
-SocketHelper* EpollCommNet::GetSocketHelper(int64_t machine_id) {
-  int sockfd = machine_id2sockfd_.at(machine_id);
+SocketHelper* EpollCommNet::GetSocketHelper(int64_t machine_id, int64_t conn_id) {
+  int sockfd = machine_id2sockfds_.at(machine_id).at(conn_id);
   return sockfd2helper_.at(sockfd);
 }
 
@@ -211,7 +431,7 @@ void EpollCommNet::DoRead(void* read_id, int64_t src_machine_id, void* src_token
   msg.request_write_msg.src_token = src_token;
   msg.request_write_msg.dst_machine_id = GlobalProcessCtx::Rank();
   msg.request_write_msg.dst_token = dst_token;
-  msg.request_write_msg.read_id = read_id;
+  msg.request_write_msg.read_id = new StripedReadContext{read_id, {0}};
   GetSocketHelper(src_machine_id)->AsyncWrite(msg);
 }
 
@@ -21,6 +21,7 @@ limitations under the License.
 #include "oneflow/core/comm_network/comm_network.h"
 #include "oneflow/core/comm_network/epoll/socket_helper.h"
 #include "oneflow/core/comm_network/epoll/socket_memory_desc.h"
+#include "oneflow/core/comm_network/epoll/shm_payload_ring.h"
 
 namespace oneflow {
 
@@ -32,6 +33,18 @@ class EpollCommNet final : public CommNetIf<SocketMemDesc> {
   void SendActorMsg(int64_t dst_machine_id, const ActorMsg& msg) override;
   void SendSocketMsg(int64_t dst_machine_id, const SocketMsg& msg);
   void SendTransportMsg(int64_t dst_machine_id, const TransportMsg& msg);
+  // Sends the bytes of `msg.src_token` as RequestRead messages striped over the connections to
+  // `dst_machine_id`; fills in offset, size and stripe_num of each stripe.
+  void SendPayload(int64_t dst_machine_id, const RequestReadMsg& msg);
+  // Called by the reader for each received stripe of a striped read.
+  void StripeReadDone(void* striped_read_id, int64_t stripe_num);
+  // Called by the reader for a stripe left in the shared memory ring of a peer on the same host;
+  // the stripe is copied out on the ring reader thread, off the socket readers.
+  void ReadShmRingStripe(const RequestReadMsg& msg);
+  // Stripes sent to peers on this host through the shared memory rings, and those sent over the
+  // sockets instead because a ring was full.
+  int64_t shm_ring_stripe_num() const { return shm_ring_stripe_num_; }
+  int64_t shm_ring_fallback_stripe_num() const { return shm_ring_fallback_stripe_num_; }
 
  private:
   SocketMemDesc* NewMemDesc(void* ptr, size_t byte_size) override;
@@ -39,12 +52,30 @@ class EpollCommNet final : public CommNetIf<SocketMemDesc> {
   friend class Singleton<EpollCommNet>;
   EpollCommNet();
   void InitSockets();
-  SocketHelper* GetSocketHelper(int64_t machine_id);
+  // Sets up a shared memory ring in each direction with every peer on the same host.
+  void InitShmRings();
+  void SendPayloadThroughShmRing(int64_t dst_machine_id, const RequestReadMsg& msg);
+  void PopShmRingStripe(const RequestReadMsg& msg);
+  // Connection 0 carries all control messages so that their order is kept; payload stripes may
+  // use any connection.
+  SocketHelper* GetSocketHelper(int64_t machine_id, int64_t conn_id = 0);
   void DoRead(void* read_id, int64_t src_machine_id, void* src_token, void* dst_token) override;
 
   std::vector<IOEventPoller*> pollers_;
-  std::vector<int> machine_id2sockfd_;
+  int64_t conn_num_per_peer_;
+  size_t min_stripe_size_;
+  std::atomic<int64_t> next_payload_conn_id_;
+  std::vector<std::vector<int>> machine_id2sockfds_;
   HashMap<int, SocketHelper*> sockfd2helper_;
+  // null for peers on other hosts
+  std::vector<std::shared_ptr<ShmPayloadRing>> machine_id2send_ring_;
+  std::vector<std::shared_ptr<ShmPayloadRing>> machine_id2recv_ring_;
+  std::vector<std::string> shm_ring_keys_;
+  std::atomic<int64_t> shm_ring_stripe_num_;
+  std::atomic<int64_t> shm_ring_fallback_stripe_num_;
+  // stripes to pop, in the order their positions arrived on connection 0
+  Channel<RequestReadMsg> shm_ring_read_chan_;
+  std::thread shm_ring_reader_;
 };
 
 }  // namespace oneflow
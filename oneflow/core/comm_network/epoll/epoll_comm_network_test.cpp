@@ -0,0 +1,149 @@
+/*
+Copyright 2020 The OneFlow Authors. All rights reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+#if defined(RPC_BACKEND_GRPC) && defined(__linux__)
+
+#include <gtest/gtest.h>
+#include "oneflow/core/comm_network/epoll/epoll_comm_network.h"
+#include "oneflow/core/common/blocking_counter.h"
+#include "oneflow/core/control/ctrl_client.h"
+#include "oneflow/core/control/global_process_ctx.h"
+#include "oneflow/core/control/multi_process_test_util.h"
+
+namespace oneflow {
+
+namespace test {
+
+namespace {
+
+char ByteAt(int64_t rank, size_t buffer_idx, size_t offset) {
+  return static_cast<char>(rank * 131 + buffer_idx * 31 + offset * 7 + 3);
+}
+
+std::string TokenKey(int64_t rank, size_t buffer_idx) {
+  return "EpollCommNetTest/" + std::to_string(rank) + "/" + std::to_string(buffer_idx);
+}
+
+// Every rank of a world of 2 reads `iter_num` times each buffer of `byte_sizes` from the other
+// one through the env's EpollCommNet, all reads of all buffers in flight at once, and checks
+// the bytes and that every read completes exactly once.
+void TestReadsFromPeer(int64_t rank, const std::vector<size_t>& byte_sizes, int64_t iter_num) {
+  auto* comm_net = Singleton<EpollCommNet>::Get();
+  auto* ctrl_client = Singleton<CtrlClient>::Get();
+  const int64_t peer = 1 - rank;
+  std::vector<std::vector<char>> src_buffers;
+  std::vector<void*> src_tokens;
+  FOR_RANGE(size_t, i, 0, byte_sizes.size()) {
+    src_buffers.emplace_back(byte_sizes.at(i));
+    FOR_RANGE(size_t, j, 0, byte_sizes.at(i)) { src_buffers.back()[j] = ByteAt(rank, i, j); }
+    src_tokens.push_back(comm_net->RegisterMemory(src_buffers.back().data(), byte_sizes.at(i)));
+    ctrl_client->PushKV(TokenKey(rank, i),
+                        std::to_string(reinterpret_cast<uintptr_t>(src_tokens.back())));
+  }
+  std::vector<void*> peer_src_tokens;
+  FOR_RANGE(size_t, i, 0, byte_sizes.size()) {
+    std::string token;
+    ctrl_client->PullKV(TokenKey(peer, i), &token);
+    peer_src_tokens.push_back(reinterpret_cast<void*>(std::stoull(token)));
+  }
+
+  std::vector<std::vector<char>> dst_buffers;
+  std::vector<void*> dst_tokens;
+  std::vector<void*> actor_read_ids;
+  for (size_t byte_size : byte_sizes) {
+    FOR_RANGE(int64_t, iter, 0, iter_num) {
+      dst_buffers.emplace_back(byte_size, 0);
+      dst_tokens.push_back(comm_net->RegisterMemory(dst_buffers.back().data(), byte_size));
+      actor_read_ids.push_back(comm_net->NewActorReadId());
+    }
+  }
+  BlockingCounter done_cnt(dst_buffers.size());
+  std::vector<std::atomic<int64_t>> done_cnts(dst_buffers.size());
+  FOR_RANGE(size_t, i, 0, dst_buffers.size()) {
+    done_cnts.at(i) = 0;
+    comm_net->Read(actor_read_ids.at(i), peer, peer_src_tokens.at(i / iter_num),
+                   dst_tokens.at(i));
+    comm_net->AddReadCallBack(actor_read_ids.at(i), [&, i]() {
+      done_cnts.at(i).fetch_add(1);
+      done_cnt.Decrease();
+    });
+  }
+  done_cnt.WaitForeverUntilCntEqualZero();
+  FOR_RANGE(size_t, i, 0, dst_buffers.size()) {
+    EXPECT_EQ(done_cnts.at(i).load(), 1);
+    const size_t buffer_idx = i / iter_num;
+    const auto& dst = dst_buffers.at(i);
+    size_t mismatch_cnt = 0;
+    FOR_RANGE(size_t, j, 0, dst.size()) {
+      if (dst[j] != ByteAt(peer, buffer_idx, j)) { ++mismatch_cnt; }
+    }
+    EXPECT_EQ(mismatch_cnt, 0) << "buffer " << buffer_idx << " of " << dst.size() << " bytes";
+  }
+  // The peer may still be reading the source buffers.
+  OF_ENV_BARRIER();
+  for (void* id : actor_read_ids) { comm_net->DeleteActorReadId(id); }
+  for (void* token : dst_tokens) { comm_net->UnRegisterMemory(token); }
+  for (void* token : src_tokens) { comm_net->UnRegisterMemory(token); }
+  FOR_RANGE(size_t, i, 0, byte_sizes.size()) { ctrl_client->ClearKV(TokenKey(rank, i)); }
+}
+
+}  // namespace
+
+TEST(EpollCommNet, striped_reads) {
+  // Payloads of at least 4 stripes of 4KiB go over all 4 connections, smaller ones over fewer.
+  ScopedEnvs envs({{"ONEFLOW_COMM_NET_EPOLL_CONNECTIONS_PER_PEER", "4"},
+                   {"ONEFLOW_COMM_NET_EPOLL_MIN_STRIPE_SIZE", "4096"},
+                   {"ONEFLOW_COMM_NET_EPOLL_SHM_RING_SIZE", "0"}});
+  RunInMultiProcessEnv(2, [](int64_t rank) {
+    TestReadsFromPeer(rank, {1, 4095, 3 * 4096 + 1, 4 * 4096 + 3, 8 * 1024 * 1024 + 5}, 8);
+  });
+}
+
+TEST(EpollCommNet, single_connection_reads) {
+  ScopedEnvs envs({{"ONEFLOW_COMM_NET_EPOLL_CONNECTIONS_PER_PEER", "1"},
+                   {"ONEFLOW_COMM_NET_EPOLL_SHM_RING_SIZE", "0"}});
+  RunInMultiProcessEnv(2, [](int64_t rank) {
+    TestReadsFromPeer(rank, {1, 4 * 4096 + 3, 2 * 1024 * 1024 + 5}, 4);
+  });
+}
+
+TEST(EpollCommNet, shm_ring_reads) {
+  // Both ranks are on this host, so payloads go through the rings in stripes of 64KiB.
+  ScopedEnvs envs({{"ONEFLOW_COMM_NET_EPOLL_MIN_STRIPE_SIZE", "65536"},
+                   {"ONEFLOW_COMM_NET_EPOLL_SHM_RING_SIZE", "1048576"}});
+  RunInMultiProcessEnv(2, [](int64_t rank) {
+    TestReadsFromPeer(rank, {1, 4095, 3 * 65536 + 1, 2 * 1024 * 1024 + 5}, 4);
+    EXPECT_GT(Singleton<EpollCommNet>::Get()->shm_ring_stripe_num(), 0);
+  });
+}
+
+TEST(EpollCommNet, full_shm_ring_falls_back_to_sockets) {
+  // The ring holds 4 stripes of 1KiB, far fewer than a read of 256KiB is cut into, so most
+  // stripes find it full and go over the sockets.
+  ScopedEnvs envs({{"ONEFLOW_COMM_NET_EPOLL_CONNECTIONS_PER_PEER", "2"},
+                   {"ONEFLOW_COMM_NET_EPOLL_SHM_RING_SIZE", "4096"}});
+  RunInMultiProcessEnv(2, [](int64_t rank) {
+    TestReadsFromPeer(rank, {1, 3 * 1024 + 1, 256 * 1024 + 5}, 4);
+    auto* comm_net = Singleton<EpollCommNet>::Get();
+    EXPECT_GT(comm_net->shm_ring_stripe_num(), 0);
+    EXPECT_GT(comm_net->shm_ring_fallback_stripe_num(), 0);
+  });
+}
+
+}  // namespace test
+
+}  // namespace oneflow
+
+#endif  // RPC_BACKEND_GRPC && __linux__
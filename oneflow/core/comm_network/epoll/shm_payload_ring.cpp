@@ -0,0 +1,73 @@
+/*
+Copyright 2020 The OneFlow Authors. All rights reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+#ifdef __linux__
+
+#include "oneflow/core/comm_network/epoll/shm_payload_ring.h"
+#include <cstring>
+#include "glog/logging.h"
+
+namespace oneflow {
+
+static_assert(std::atomic<uint64_t>::is_always_lock_free,
+              "the ring header is shared by processes and must be lock free");
+
+ShmPayloadRing::ShmPayloadRing(const std::shared_ptr<ipc::SharedMemory>& shm)
+    : shm_(shm),
+      header_(reinterpret_cast<Header*>(shm->mut_buf())),
+      data_(shm->mut_buf() + sizeof(Header)),
+      capacity_(shm->size() - sizeof(Header)),
+      produced_(0) {}
+
+Maybe<ShmPayloadRing> ShmPayloadRing::Create(size_t capacity) {
+  CHECK_GT_OR_RETURN(capacity, 0) << Error::RuntimeError() << "empty shared memory payload ring";
+  const auto& shm = JUST(ipc::SharedMemory::Open(sizeof(Header) + capacity, /*create=*/true));
+  // the shared memory is zero-filled, which is a valid empty header
+  return std::shared_ptr<ShmPayloadRing>(new ShmPayloadRing(shm));
+}
+
+Maybe<ShmPayloadRing> ShmPayloadRing::Open(const std::string& name) {
+  const auto& shm = JUST(ipc::SharedMemory::Open(name, /*create=*/false));
+  CHECK_GT_OR_RETURN(shm->size(), sizeof(Header))
+      << Error::RuntimeError() << "shared memory payload ring " << name << " is too small";
+  return std::shared_ptr<ShmPayloadRing>(new ShmPayloadRing(shm));
+}
+
+bool ShmPayloadRing::TryPush(const char* data, size_t size,
+                             const std::function<void(uint64_t)>& OnPushed) {
+  if (size > capacity_) { return false; }
+  std::unique_lock<std::mutex> lock(push_mutex_);
+  uint64_t pos = produced_;
+  const size_t tail_room = capacity_ - pos % capacity_;
+  if (size > tail_room) { pos += tail_room; }
+  if (pos + size - header_->consumed.load(std::memory_order_acquire) > capacity_) {
+    return false;
+  }
+  std::memcpy(data_ + pos % capacity_, data, size);
+  produced_ = pos + size;
+  OnPushed(pos);
+  return true;
+}
+
+void ShmPayloadRing::Pop(uint64_t pos, size_t size, char* dst) {
+  CHECK_GE(pos, header_->consumed.load(std::memory_order_relaxed));
+  CHECK_LE(pos % capacity_ + size, capacity_);
+  std::memcpy(dst, data_ + pos % capacity_, size);
+  header_->consumed.store(pos + size, std::memory_order_release);
+}
+
+}  // namespace oneflow
+
+#endif  // __linux__
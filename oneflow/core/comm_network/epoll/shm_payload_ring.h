@@ -0,0 +1,76 @@
+/*
+Copyright 2020 The OneFlow Authors. All rights reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+#ifndef ONEFLOW_CORE_COMM_NETWORK_EPOLL_SHM_PAYLOAD_RING_H_
+#define ONEFLOW_CORE_COMM_NETWORK_EPOLL_SHM_PAYLOAD_RING_H_
+
+#ifdef __linux__
+
+#include <atomic>
+#include <functional>
+#include <mutex>
+#include "oneflow/core/common/maybe.h"
+#include "oneflow/core/ipc/shared_memory.h"
+
+namespace oneflow {
+
+// A byte ring in shared memory carrying payloads from one process to another on the same host.
+// The producer copies a payload in and passes its position to the consumer through the usual
+// socket message; the consumer copies it out and publishes how far it has consumed in the ring
+// header, so releasing space needs no message. Positions grow monotonically and a payload never
+// wraps around the end of the ring.
+class ShmPayloadRing final {
+ public:
+  OF_DISALLOW_COPY_AND_MOVE(ShmPayloadRing);
+  ~ShmPayloadRing() = default;
+
+  // Creates the ring as producer.
+  static Maybe<ShmPayloadRing> Create(size_t capacity);
+  // Opens the ring created by the peer as consumer.
+  static Maybe<ShmPayloadRing> Open(const std::string& name);
+
+  const std::string& name() const { return shm_->name(); }
+  size_t capacity() const { return capacity_; }
+  // The name may be unlinked once the consumer has opened the ring.
+  Maybe<void> Unlink() { return shm_->Unlink(); }
+
+  // Copies `size` bytes into the ring and calls `OnPushed` with their position while still holding
+  // the producer lock, so that positions reach the consumer in order. Returns false without
+  // blocking if the ring has no room.
+  bool TryPush(const char* data, size_t size, const std::function<void(uint64_t)>& OnPushed);
+  // Copies the payload at `pos` out and releases it. Payloads must be popped in push order.
+  void Pop(uint64_t pos, size_t size, char* dst);
+
+ private:
+  struct alignas(64) Header {
+    std::atomic<uint64_t> consumed;
+  };
+
+  explicit ShmPayloadRing(const std::shared_ptr<ipc::SharedMemory>& shm);
+
+  std::shared_ptr<ipc::SharedMemory> shm_;
+  Header* header_;
+  char* data_;
+  size_t capacity_;
+  // producer only
+  std::mutex push_mutex_;
+  uint64_t produced_;
+};
+
+}  // namespace oneflow
+
+#endif  // __linux__
+
+#endif  // ONEFLOW_CORE_COMM_NETWORK_EPOLL_SHM_PAYLOAD_RING_H_
@@ -0,0 +1,104 @@
+/*
+Copyright 2020 The OneFlow Authors. All rights reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+#ifdef __linux__
+
+#include <gtest/gtest.h>
+#include <condition_variable>
+#include <cstring>
+#include <deque>
+#include <thread>
+#include "oneflow/core/comm_network/epoll/shm_payload_ring.h"
+
+namespace oneflow {
+
+namespace test {
+
+TEST(ShmPayloadRing, push_and_pop) {
+  const auto& producer = CHECK_JUST(ShmPayloadRing::Create(1024));
+  const auto& consumer = CHECK_JUST(ShmPayloadRing::Open(producer->name()));
+  CHECK_JUST(producer->Unlink());
+  ASSERT_EQ(consumer->capacity(), producer->capacity());
+  const size_t capacity = producer->capacity();
+
+  std::vector<char> src(capacity);
+  for (size_t i = 0; i < capacity; ++i) { src[i] = static_cast<char>(i * 7); }
+  std::vector<uint64_t> positions;
+  const auto& Push = [&](size_t size) {
+    return producer->TryPush(src.data(), size, [&](uint64_t pos) { positions.push_back(pos); });
+  };
+  ASSERT_TRUE(Push(capacity / 2));
+  ASSERT_TRUE(Push(capacity / 4));
+  // does not fit before the end of the ring, and the head is still in use
+  ASSERT_FALSE(Push(capacity / 2));
+  ASSERT_FALSE(Push(capacity + 1));
+  ASSERT_EQ(positions, (std::vector<uint64_t>{0, capacity / 2}));
+
+  std::vector<char> dst(capacity);
+  consumer->Pop(positions.at(0), capacity / 2, dst.data());
+  ASSERT_EQ(std::memcmp(dst.data(), src.data(), capacity / 2), 0);
+  // the payload skips the tail of the ring and lands at the head
+  ASSERT_TRUE(Push(capacity / 2));
+  ASSERT_EQ(positions.at(2), capacity);
+  consumer->Pop(positions.at(1), capacity / 4, dst.data());
+  consumer->Pop(positions.at(2), capacity / 2, dst.data());
+  ASSERT_EQ(std::memcmp(dst.data(), src.data(), capacity / 2), 0);
+}
+
+TEST(ShmPayloadRing, concurrent_producer_and_consumer) {
+  const auto& producer = CHECK_JUST(ShmPayloadRing::Create(4096));
+  const auto& consumer = CHECK_JUST(ShmPayloadRing::Open(producer->name()));
+  CHECK_JUST(producer->Unlink());
+  constexpr int64_t kMsgNum = 10000;
+  std::mutex mutex;
+  std::condition_variable cond;
+  std::deque<std::pair<uint64_t, size_t>> queue;
+
+  std::thread consumer_thread([&]() {
+    std::vector<char> dst(1024);
+    for (int64_t i = 0; i < kMsgNum; ++i) {
+      std::pair<uint64_t, size_t> msg;
+      {
+        std::unique_lock<std::mutex> lock(mutex);
+        cond.wait(lock, [&]() { return !queue.empty(); });
+        msg = queue.front();
+        queue.pop_front();
+      }
+      consumer->Pop(msg.first, msg.second, dst.data());
+      for (size_t j = 0; j < msg.second; ++j) {
+        ASSERT_EQ(dst[j], static_cast<char>(i + j));
+      }
+    }
+  });
+  std::vector<char> src(1024);
+  for (int64_t i = 0; i < kMsgNum; ++i) {
+    const size_t size = (i * 131) % src.size();
+    for (size_t j = 0; j < size; ++j) { src[j] = static_cast<char>(i + j); }
+    while (!producer->TryPush(src.data(), size, [&](uint64_t pos) {
+      std::unique_lock<std::mutex> lock(mutex);
+      queue.emplace_back(pos, size);
+      cond.notify_one();
+    })) {
+      std::this_thread::yield();
+    }
+  }
+  consumer_thread.join();
+}
+
+}  // namespace test
+
+}  // namespace oneflow
+
+#endif  // __linux__
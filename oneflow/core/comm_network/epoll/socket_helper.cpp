@@ -24,7 +24,8 @@ SocketHelper::SocketHelper(int sockfd, IOEventPoller* poller) {
   write_helper_ = new SocketWriteHelper(sockfd, poller);
   poller->AddFd(
       sockfd, [this]() { read_helper_->NotifyMeSocketReadable(); },
-      [this]() { write_helper_->NotifyMeSocketWriteable(); });
+      [this]() { write_helper_->NotifyMeSocketWriteable(); },
+      [this]() { write_helper_->NotifyMeSocketError(); });
 }
 
 SocketHelper::~SocketHelper() {
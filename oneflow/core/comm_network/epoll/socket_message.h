@@ -58,6 +58,16 @@ struct RequestReadMsg {
   void* src_token;
   void* dst_token;
   void* read_id;
+  // A payload may be striped over several connections to the same peer; each stripe carries
+  // bytes [offset, offset + size) of the memory and the total stripe count.
+  size_t offset;
+  size_t size;
+  int64_t stripe_num;
+  // Between processes on the same host the bytes of a stripe may be left at `ring_pos` of the
+  // shared memory ring of `src_machine_id` instead of following the message.
+  int64_t src_machine_id;
+  bool in_shm_ring;
+  uint64_t ring_pos;
 };
 
 struct SocketMsg {
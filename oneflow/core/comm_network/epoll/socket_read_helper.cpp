@@ -83,26 +83,32 @@ void SocketReadHelper::SetStatusWhenMsgHeadDone() {
 
 void SocketReadHelper::SetStatusWhenMsgBodyDone() {
   if (cur_msg_.msg_type == SocketMsgType::kRequestRead) {
-    Singleton<EpollCommNet>::Get()->ReadDone(cur_msg_.request_read_msg.read_id);
+    Singleton<EpollCommNet>::Get()->StripeReadDone(cur_msg_.request_read_msg.read_id,
+                                                   cur_msg_.request_read_msg.stripe_num);
   }
   SwitchToMsgHeadReadHandle();
 }
 
 void SocketReadHelper::SetStatusWhenRequestWriteMsgHeadDone() {
-  SocketMsg msg_to_send;
-  msg_to_send.msg_type = SocketMsgType::kRequestRead;
-  msg_to_send.request_read_msg.src_token = cur_msg_.request_write_msg.src_token;
-  msg_to_send.request_read_msg.dst_token = cur_msg_.request_write_msg.dst_token;
-  msg_to_send.request_read_msg.read_id = cur_msg_.request_write_msg.read_id;
-  Singleton<EpollCommNet>::Get()->SendSocketMsg(cur_msg_.request_write_msg.dst_machine_id,
-                                                msg_to_send);
+  RequestReadMsg request_read_msg{};
+  request_read_msg.src_token = cur_msg_.request_write_msg.src_token;
+  request_read_msg.dst_token = cur_msg_.request_write_msg.dst_token;
+  request_read_msg.read_id = cur_msg_.request_write_msg.read_id;
+  Singleton<EpollCommNet>::Get()->SendPayload(cur_msg_.request_write_msg.dst_machine_id,
+                                              request_read_msg);
   SwitchToMsgHeadReadHandle();
 }
 
 void SocketReadHelper::SetStatusWhenRequestReadMsgHeadDone() {
+  if (cur_msg_.request_read_msg.in_shm_ring) {
+    Singleton<EpollCommNet>::Get()->ReadShmRingStripe(cur_msg_.request_read_msg);
+    SwitchToMsgHeadReadHandle();
+    return;
+  }
   auto mem_desc = static_cast<const SocketMemDesc*>(cur_msg_.request_read_msg.dst_token);
-  read_ptr_ = reinterpret_cast<char*>(mem_desc->mem_ptr);
-  read_size_ = mem_desc->byte_size;
+  CHECK_LE(cur_msg_.request_read_msg.offset + cur_msg_.request_read_msg.size, mem_desc->byte_size);
+  read_ptr_ = reinterpret_cast<char*>(mem_desc->mem_ptr) + cur_msg_.request_read_msg.offset;
+  read_size_ = cur_msg_.request_read_msg.size;
   cur_read_handle_ = &SocketReadHelper::MsgBodyReadHandle;
 }
 
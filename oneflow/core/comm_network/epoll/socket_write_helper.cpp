@@ -17,11 +17,51 @@ limitations under the License.
 
 #include "oneflow/core/comm_network/epoll/socket_write_helper.h"
 #include "oneflow/core/comm_network/epoll/socket_memory_desc.h"
+#include "oneflow/core/common/env_var/comm_net.h"
 
+#include <cstring>
 #include <sys/eventfd.h>
+#include <sys/uio.h>
+#include <linux/errqueue.h>
 
 namespace oneflow {
 
+namespace {
+
+constexpr size_t kMaxBatchMsgNum = 32;
+
+#ifdef MSG_ZEROCOPY
+constexpr int kZeroCopyFlag = MSG_ZEROCOPY;
+#else
+constexpr int kZeroCopyFlag = 0;
+#endif  // MSG_ZEROCOPY
+
+size_t MsgBodySize(const SocketMsg& msg) {
+  if (msg.msg_type == SocketMsgType::kRequestRead && !msg.request_read_msg.in_shm_ring) {
+    return msg.request_read_msg.size;
+  }
+  return 0;
+}
+
+const char* MsgBodyPtr(const SocketMsg& msg) {
+  CHECK(msg.msg_type == SocketMsgType::kRequestRead);
+  auto src_mem_desc = static_cast<const SocketMemDesc*>(msg.request_read_msg.src_token);
+  return reinterpret_cast<const char*>(src_mem_desc->mem_ptr) + msg.request_read_msg.offset;
+}
+
+bool TryEnableZeroCopy(int sockfd) {
+#ifdef SO_ZEROCOPY
+  const int val = 1;
+  if (setsockopt(sockfd, SOL_SOCKET, SO_ZEROCOPY, &val, sizeof(val)) == 0) { return true; }
+  LOG(WARNING) << "CommNet:Epoll SO_ZEROCOPY is not supported, errno: " << errno;
+#else
+  LOG(WARNING) << "CommNet:Epoll SO_ZEROCOPY is not available on this platform";
+#endif  // SO_ZEROCOPY
+  return false;
+}
+
+}  // namespace
+
 SocketWriteHelper::~SocketWriteHelper() {
   delete cur_msg_queue_;
   cur_msg_queue_ = nullptr;
@@ -38,11 +78,12 @@ SocketWriteHelper::SocketWriteHelper(int sockfd, IOEventPoller* poller) {
   PCHECK(queue_not_empty_fd_ != -1);
   poller->AddFdWithOnlyReadHandler(queue_not_empty_fd_,
                                    std::bind(&SocketWriteHelper::ProcessQueueNotEmptyEvent, this));
+  zerocopy_enabled_ =
+      EnvBool<ONEFLOW_COMM_NET_EPOLL_ENABLE_ZEROCOPY>() && TryEnableZeroCopy(sockfd_);
+  zerocopy_threshold_ = EnvInteger<ONEFLOW_COMM_NET_EPOLL_ZEROCOPY_THRESHOLD>();
   cur_msg_queue_ = new std::queue<SocketMsg>;
   pending_msg_queue_ = new std::queue<SocketMsg>;
-  cur_write_handle_ = &SocketWriteHelper::InitMsgWriteHandle;
-  write_ptr_ = nullptr;
-  write_size_ = 0;
+  batch_written_size_ = 0;
 }
 
 void SocketWriteHelper::AsyncWrite(const SocketMsg& msg) {
@@ -55,6 +96,38 @@ void SocketWriteHelper::AsyncWrite(const SocketMsg& msg) {
 
 void SocketWriteHelper::NotifyMeSocketWriteable() { WriteUntilMsgQueueEmptyOrSocketNotWriteable(); }
 
+void SocketWriteHelper::NotifyMeSocketError() {
+  // The only errors expected on the queue are MSG_ZEROCOPY completions. They carry no state we
+  // need: a body buffer is reused only after the reader has acked receiving all of its bytes.
+  char control[128];
+  while (true) {
+    msghdr msg{};
+    msg.msg_control = control;
+    msg.msg_controllen = sizeof(control);
+    ssize_t n = recvmsg(sockfd_, &msg, MSG_ERRQUEUE);
+    if (n == -1) {
+      PCHECK(errno == EAGAIN || errno == EWOULDBLOCK) << "sockfd: " << sockfd_;
+      break;
+    }
+    for (cmsghdr* cm = CMSG_FIRSTHDR(&msg); cm != nullptr; cm = CMSG_NXTHDR(&msg, cm)) {
+      auto err = reinterpret_cast<const sock_extended_err*>(CMSG_DATA(cm));
+#ifdef SO_EE_ORIGIN_ZEROCOPY
+      CHECK(err->ee_errno == 0 && err->ee_origin == SO_EE_ORIGIN_ZEROCOPY)
+          << "sockfd: " << sockfd_ << ", errno: " << err->ee_errno;
+#else
+      LOG(FATAL) << "sockfd: " << sockfd_ << ", errno: " << err->ee_errno;
+#endif  // SO_EE_ORIGIN_ZEROCOPY
+    }
+  }
+  // Errors of the connection itself, such as ECONNRESET, are not queued but pending on the
+  // socket. EPOLLERR stays raised until they are read, so they can not be skipped.
+  int sock_err = 0;
+  socklen_t sock_err_len = sizeof(sock_err);
+  PCHECK(getsockopt(sockfd_, SOL_SOCKET, SO_ERROR, &sock_err, &sock_err_len) == 0)
+      << "sockfd: " << sockfd_;
+  CHECK_EQ(sock_err, 0) << "sockfd: " << sockfd_ << ", error: " << std::strerror(sock_err);
+}
+
 void SocketWriteHelper::SendQueueNotEmptyEvent() {
   uint64_t event_num = 1;
   PCHECK(write(queue_not_empty_fd_, &event_num, 8) == 8);
@@ -67,41 +140,67 @@ void SocketWriteHelper::ProcessQueueNotEmptyEvent() {
 }
 
 void SocketWriteHelper::WriteUntilMsgQueueEmptyOrSocketNotWriteable() {
-  while ((this->*cur_write_handle_)()) {}
+  while (true) {
+    FillBatch();
+    if (batch_.empty() || !WriteBatch()) { return; }
+  }
 }
 
-bool SocketWriteHelper::InitMsgWriteHandle() {
-  if (cur_msg_queue_->empty()) {
-    {
-      std::unique_lock<std::mutex> lck(pending_msg_queue_mtx_);
-      std::swap(cur_msg_queue_, pending_msg_queue_);
+void SocketWriteHelper::FillBatch() {
+  while (batch_.size() < kMaxBatchMsgNum) {
+    if (cur_msg_queue_->empty()) {
+      {
+        std::unique_lock<std::mutex> lck(pending_msg_queue_mtx_);
+        std::swap(cur_msg_queue_, pending_msg_queue_);
+      }
+      if (cur_msg_queue_->empty()) { return; }
     }
-    if (cur_msg_queue_->empty()) { return false; }
+    batch_.push_back(cur_msg_queue_->front());
+    cur_msg_queue_->pop();
   }
-  cur_msg_ = cur_msg_queue_->front();
-  cur_msg_queue_->pop();
-  write_ptr_ = reinterpret_cast<const char*>(&cur_msg_);
-  write_size_ = sizeof(cur_msg_);
-  cur_write_handle_ = &SocketWriteHelper::MsgHeadWriteHandle;
-  return true;
-}
-
-bool SocketWriteHelper::MsgHeadWriteHandle() {
-  return DoCurWrite(&SocketWriteHelper::SetStatusWhenMsgHeadDone);
 }
 
-bool SocketWriteHelper::MsgBodyWriteHandle() {
-  return DoCurWrite(&SocketWriteHelper::SetStatusWhenMsgBodyDone);
-}
-
-bool SocketWriteHelper::DoCurWrite(void (SocketWriteHelper::*set_cur_write_done)()) {
-  ssize_t n = write(sockfd_, write_ptr_, write_size_);
-  if (n == write_size_) {
-    (this->*set_cur_write_done)();
-    return true;
-  } else if (n >= 0) {
-    write_ptr_ += n;
-    write_size_ -= n;
+bool SocketWriteHelper::WriteBatch() {
+  iovec iov[2 * kMaxBatchMsgNum];
+  size_t iov_num = 0;
+  int flags = 0;
+  size_t skip_size = batch_written_size_;
+  for (const SocketMsg& msg : batch_) {
+    const size_t body_size = MsgBodySize(msg);
+    const bool zerocopy_body = zerocopy_enabled_ && body_size >= zerocopy_threshold_;
+    if (skip_size < sizeof(SocketMsg)) {
+      iov[iov_num].iov_base = const_cast<char*>(reinterpret_cast<const char*>(&msg)) + skip_size;
+      iov[iov_num].iov_len = sizeof(SocketMsg) - skip_size;
+      ++iov_num;
+      skip_size = 0;
+      // Headers live in batch_ and are gone once written, so they must never be sent zero-copy;
+      // end the batch here and send a large body on its own in the next call.
+      if (zerocopy_body) { break; }
+    } else {
+      skip_size -= sizeof(SocketMsg);
+    }
+    if (body_size > 0) {
+      iov[iov_num].iov_base = const_cast<char*>(MsgBodyPtr(msg)) + skip_size;
+      iov[iov_num].iov_len = body_size - skip_size;
+      ++iov_num;
+      if (zerocopy_body) {
+        CHECK_EQ(iov_num, 1);
+        flags |= kZeroCopyFlag;
+        break;
+      }
+    }
+    skip_size = 0;
+  }
+  msghdr msg{};
+  msg.msg_iov = iov;
+  msg.msg_iovlen = iov_num;
+  ssize_t n = sendmsg(sockfd_, &msg, flags);
+  if (n == -1 && errno == ENOBUFS && (flags & kZeroCopyFlag) != 0) {
+    // Out of optmem for pinning pages, fall back to a copying send.
+    n = sendmsg(sockfd_, &msg, 0);
+  }
+  if (n >= 0) {
+    ConsumeBatch(n);
     return true;
   } else {
     CHECK_EQ(n, -1);
@@ -110,40 +209,21 @@ bool SocketWriteHelper::DoCurWrite(void (SocketWriteHelper::*set_cur_write_done)
   }
 }
 
-void SocketWriteHelper::SetStatusWhenMsgHeadDone() {
-  switch (cur_msg_.msg_type) {
-#define MAKE_ENTRY(x, y) \
-  case SocketMsgType::k##x: return SetStatusWhen##x##MsgHeadDone();
-    OF_PP_FOR_EACH_TUPLE(MAKE_ENTRY, SOCKET_MSG_TYPE_SEQ);
-#undef MAKE_ENTRY
-    default: UNIMPLEMENTED();
+void SocketWriteHelper::ConsumeBatch(size_t written_size) {
+  while (written_size > 0) {
+    CHECK(!batch_.empty());
+    const size_t msg_size = sizeof(SocketMsg) + MsgBodySize(batch_.front());
+    const size_t remain_size = msg_size - batch_written_size_;
+    if (written_size < remain_size) {
+      batch_written_size_ += written_size;
+      return;
+    }
+    written_size -= remain_size;
+    batch_.pop_front();
+    batch_written_size_ = 0;
   }
 }
 
-void SocketWriteHelper::SetStatusWhenMsgBodyDone() {
-  cur_write_handle_ = &SocketWriteHelper::InitMsgWriteHandle;
-}
-
-void SocketWriteHelper::SetStatusWhenRequestWriteMsgHeadDone() {
-  cur_write_handle_ = &SocketWriteHelper::InitMsgWriteHandle;
-}
-
-void SocketWriteHelper::SetStatusWhenRequestReadMsgHeadDone() {
-  const void* src_token = cur_msg_.request_read_msg.src_token;
-  auto src_mem_desc = static_cast<const SocketMemDesc*>(src_token);
-  write_ptr_ = reinterpret_cast<const char*>(src_mem_desc->mem_ptr);
-  write_size_ = src_mem_desc->byte_size;
-  cur_write_handle_ = &SocketWriteHelper::MsgBodyWriteHandle;
-}
-
-void SocketWriteHelper::SetStatusWhenActorMsgHeadDone() {
-  cur_write_handle_ = &SocketWriteHelper::InitMsgWriteHandle;
-}
-
-void SocketWriteHelper::SetStatusWhenTransportMsgHeadDone() {
-  cur_write_handle_ = &SocketWriteHelper::InitMsgWriteHandle;
-}
-
 }  // namespace oneflow
 
 #endif  // __linux__
@@ -34,36 +34,32 @@ class SocketWriteHelper final {
   void AsyncWrite(const SocketMsg& msg);
 
   void NotifyMeSocketWriteable();
+  void NotifyMeSocketError();
 
  private:
   void SendQueueNotEmptyEvent();
   void ProcessQueueNotEmptyEvent();
 
   void WriteUntilMsgQueueEmptyOrSocketNotWriteable();
-  bool InitMsgWriteHandle();
-  bool MsgHeadWriteHandle();
-  bool MsgBodyWriteHandle();
-
-  bool DoCurWrite(void (SocketWriteHelper::*set_cur_write_done)());
-  void SetStatusWhenMsgHeadDone();
-  void SetStatusWhenMsgBodyDone();
-
-#define MAKE_ENTRY(x, y) void SetStatusWhen##x##MsgHeadDone();
-  OF_PP_FOR_EACH_TUPLE(MAKE_ENTRY, SOCKET_MSG_TYPE_SEQ);
-#undef MAKE_ENTRY
+  void FillBatch();
+  bool WriteBatch();
+  void ConsumeBatch(size_t written_size);
 
   int sockfd_;
   int queue_not_empty_fd_;
+  bool zerocopy_enabled_;
+  size_t zerocopy_threshold_;
 
   std::queue<SocketMsg>* cur_msg_queue_;
 
   std::mutex pending_msg_queue_mtx_;
   std::queue<SocketMsg>* pending_msg_queue_;
 
-  SocketMsg cur_msg_;
-  bool (SocketWriteHelper::*cur_write_handle_)();
-  const char* write_ptr_;
-  size_t write_size_;
+  // Messages being written by one sendmsg: the headers and RequestRead bodies of all of them are
+  // gathered into a single iovec. `batch_written_size_` counts bytes of batch_.front() already
+  // on the wire.
+  std::deque<SocketMsg> batch_;
+  size_t batch_written_size_;
 };
 
 }  // namespace oneflow
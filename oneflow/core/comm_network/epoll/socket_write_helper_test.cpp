@@ -0,0 +1,256 @@
+/*
+Copyright 2020 The OneFlow Authors. All rights reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+#ifdef __linux__
+
+#include <gtest/gtest.h>
+#include <netinet/tcp.h>
+#include "oneflow/core/comm_network/epoll/io_event_poller.h"
+#include "oneflow/core/comm_network/epoll/socket_memory_desc.h"
+#include "oneflow/core/comm_network/epoll/socket_write_helper.h"
+#include "oneflow/core/common/balanced_splitter.h"
+
+namespace oneflow {
+
+namespace test {
+
+namespace {
+
+void RecvAll(int fd, void* ptr, size_t size) {
+  char* cur = static_cast<char*>(ptr);
+  while (size > 0) {
+    ssize_t n = recv(fd, cur, size, 0);
+    PCHECK(n > 0);
+    cur += n;
+    size -= n;
+  }
+}
+
+void NewLoopbackConnection(int* write_fd, int* read_fd) {
+  int listen_fd = socket(AF_INET, SOCK_STREAM, 0);
+  PCHECK(listen_fd != -1);
+  sockaddr_in sa{};
+  sa.sin_family = AF_INET;
+  sa.sin_port = 0;
+  sa.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+  PCHECK(bind(listen_fd, reinterpret_cast<sockaddr*>(&sa), sizeof(sa)) == 0);
+  PCHECK(listen(listen_fd, 1) == 0);
+  socklen_t len = sizeof(sa);
+  PCHECK(getsockname(listen_fd, reinterpret_cast<sockaddr*>(&sa), &len) == 0);
+  *write_fd = socket(AF_INET, SOCK_STREAM, 0);
+  const int val = 1;
+  PCHECK(setsockopt(*write_fd, IPPROTO_TCP, TCP_NODELAY, &val, sizeof(int)) == 0);
+  PCHECK(connect(*write_fd, reinterpret_cast<sockaddr*>(&sa), sizeof(sa)) == 0);
+  *read_fd = accept(listen_fd, nullptr, nullptr);
+  PCHECK(*read_fd != -1);
+  PCHECK(close(listen_fd) == 0);
+}
+
+// `conn_num` loopback connections written by SocketWriteHelpers on `poller_num` pollers, the
+// way EpollCommNet connects to one peer. The reading ends are left blocking for the test.
+class LoopbackConnections final {
+ public:
+  OF_DISALLOW_COPY_AND_MOVE(LoopbackConnections);
+  LoopbackConnections(int64_t conn_num, int64_t poller_num) {
+    FOR_RANGE(int64_t, i, 0, poller_num) { pollers_.emplace_back(new IOEventPoller); }
+    FOR_RANGE(int64_t, i, 0, conn_num) {
+      int write_fd = -1;
+      int read_fd = -1;
+      NewLoopbackConnection(&write_fd, &read_fd);
+      IOEventPoller* poller = pollers_.at(i % poller_num).get();
+      SocketWriteHelper* writer = new SocketWriteHelper(write_fd, poller);
+      poller->AddFd(
+          write_fd, []() {}, [writer]() { writer->NotifyMeSocketWriteable(); },
+          [writer]() { writer->NotifyMeSocketError(); });
+      writers_.emplace_back(writer);
+      read_fds_.push_back(read_fd);
+    }
+    for (auto& poller : pollers_) { poller->Start(); }
+  }
+  ~LoopbackConnections() {
+    for (auto& poller : pollers_) { poller->Stop(); }
+    writers_.clear();
+    pollers_.clear();
+    for (int fd : read_fds_) { PCHECK(close(fd) == 0); }
+  }
+
+  int64_t conn_num() const { return writers_.size(); }
+  SocketWriteHelper* writer(int64_t i) { return writers_.at(i).get(); }
+  int read_fd(int64_t i) const { return read_fds_.at(i); }
+
+ private:
+  std::vector<std::unique_ptr<IOEventPoller>> pollers_;
+  std::vector<std::unique_ptr<SocketWriteHelper>> writers_;
+  std::vector<int> read_fds_;
+};
+
+SocketMsg NewRequestReadMsg(SocketMemDesc* src, size_t offset, size_t size, void* read_id) {
+  SocketMsg msg{};
+  msg.msg_type = SocketMsgType::kRequestRead;
+  msg.request_read_msg.src_token = src;
+  msg.request_read_msg.read_id = read_id;
+  msg.request_read_msg.offset = offset;
+  msg.request_read_msg.size = size;
+  msg.request_read_msg.stripe_num = 1;
+  return msg;
+}
+
+// Sends `iter_num` copies of a `byte_size` buffer striped over all connections and returns the
+// achieved bandwidth in GB/s.
+double TestStripedTransfer(LoopbackConnections* conns, size_t byte_size, int64_t iter_num) {
+  std::vector<char> src(byte_size);
+  std::vector<char> dst(byte_size, 0);
+  FOR_RANGE(size_t, i, 0, byte_size) { src[i] = static_cast<char>(i * 7 + 3); }
+  SocketMemDesc src_desc{src.data(), byte_size};
+  BalancedSplitter bs(byte_size, conns->conn_num());
+  std::vector<std::thread> readers;
+  FOR_RANGE(int64_t, conn_id, 0, conns->conn_num()) {
+    readers.emplace_back([&, conn_id]() {
+      FOR_RANGE(int64_t, iter, 0, iter_num) {
+        SocketMsg msg{};
+        RecvAll(conns->read_fd(conn_id), &msg, sizeof(msg));
+        CHECK(msg.msg_type == SocketMsgType::kRequestRead);
+        CHECK_EQ(msg.request_read_msg.read_id, reinterpret_cast<void*>(iter));
+        RecvAll(conns->read_fd(conn_id), dst.data() + msg.request_read_msg.offset,
+                msg.request_read_msg.size);
+      }
+    });
+  }
+  const auto start = std::chrono::steady_clock::now();
+  FOR_RANGE(int64_t, iter, 0, iter_num) {
+    FOR_RANGE(int64_t, conn_id, 0, conns->conn_num()) {
+      conns->writer(conn_id)->AsyncWrite(NewRequestReadMsg(
+          &src_desc, bs.At(conn_id).begin(), bs.At(conn_id).size(), reinterpret_cast<void*>(iter)));
+    }
+  }
+  for (auto& reader : readers) { reader.join(); }
+  const std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+  EXPECT_EQ(src, dst);
+  return byte_size * iter_num / elapsed.count() / 1e9;
+}
+
+// The bandwidth and latency tests only log their results and take a while.
+bool IsBenchmarkEnabled() { return std::getenv("ONEFLOW_TEST_COMM_NET_BENCHMARK") != nullptr; }
+
+}  // namespace
+
+TEST(SocketWriteHelper, batched_msg_order) {
+  LoopbackConnections conns(1, 1);
+  const int64_t msg_num = 20000;
+  std::vector<char> src(1000);
+  FOR_RANGE(size_t, i, 0, src.size()) { src[i] = static_cast<char>(i); }
+  SocketMemDesc src_desc{src.data(), src.size()};
+  std::thread reader([&]() {
+    std::vector<char> body(src.size());
+    FOR_RANGE(int64_t, i, 0, msg_num) {
+      SocketMsg msg{};
+      RecvAll(conns.read_fd(0), &msg, sizeof(msg));
+      if (i % 3 == 0) {
+        ASSERT_TRUE(msg.msg_type == SocketMsgType::kRequestRead);
+        ASSERT_EQ(msg.request_read_msg.read_id, reinterpret_cast<void*>(i));
+        const size_t size = msg.request_read_msg.size;
+        RecvAll(conns.read_fd(0), body.data(), size);
+        ASSERT_TRUE(std::equal(body.begin(), body.begin() + size,
+                               src.begin() + msg.request_read_msg.offset));
+      } else {
+        ASSERT_TRUE(msg.msg_type == SocketMsgType::kRequestWrite);
+        ASSERT_EQ(msg.request_write_msg.read_id, reinterpret_cast<void*>(i));
+      }
+    }
+  });
+  FOR_RANGE(int64_t, i, 0, msg_num) {
+    if (i % 3 == 0) {
+      const size_t offset = i % src.size();
+      conns.writer(0)->AsyncWrite(
+          NewRequestReadMsg(&src_desc, offset, src.size() - offset, reinterpret_cast<void*>(i)));
+    } else {
+      SocketMsg msg{};
+      msg.msg_type = SocketMsgType::kRequestWrite;
+      msg.request_write_msg.read_id = reinterpret_cast<void*>(i);
+      conns.writer(0)->AsyncWrite(msg);
+    }
+  }
+  reader.join();
+}
+
+TEST(SocketWriteHelper, striped_bandwidth) {
+  if (!IsBenchmarkEnabled()) { GTEST_SKIP() << "set ONEFLOW_TEST_COMM_NET_BENCHMARK to run"; }
+  const size_t byte_size = 64 * 1024 * 1024;
+  for (int64_t conn_num : {1, 2, 4}) {
+    LoopbackConnections conns(conn_num, std::min<int64_t>(conn_num, 4));
+    TestStripedTransfer(&conns, byte_size, 1);
+    const double bandwidth = TestStripedTransfer(&conns, byte_size, 8);
+    LOG(INFO) << "connections: " << conn_num << ", bandwidth: " << bandwidth << " GB/s";
+  }
+}
+
+TEST(SocketWriteHelper, zerocopy) {
+  setenv("ONEFLOW_COMM_NET_EPOLL_ENABLE_ZEROCOPY", "1", 1);
+  setenv("ONEFLOW_COMM_NET_EPOLL_ZEROCOPY_THRESHOLD", "4096", 1);
+  {
+    LoopbackConnections conns(2, 2);
+    TestStripedTransfer(&conns, 3 * 1024 * 1024 + 17, 16);
+  }
+  unsetenv("ONEFLOW_COMM_NET_EPOLL_ENABLE_ZEROCOPY");
+  unsetenv("ONEFLOW_COMM_NET_EPOLL_ZEROCOPY_THRESHOLD");
+}
+
+TEST(SocketWriteHelper, small_msg_latency) {
+  if (!IsBenchmarkEnabled()) { GTEST_SKIP() << "set ONEFLOW_TEST_COMM_NET_BENCHMARK to run"; }
+  LoopbackConnections conns(1, 1);
+  const int64_t msg_num = 2000;
+  std::atomic<int64_t> received_cnt(0);
+  std::thread reader([&]() {
+    FOR_RANGE(int64_t, i, 0, msg_num) {
+      SocketMsg msg{};
+      RecvAll(conns.read_fd(0), &msg, sizeof(msg));
+      received_cnt.store(i + 1, std::memory_order_release);
+    }
+  });
+  const auto start = std::chrono::steady_clock::now();
+  FOR_RANGE(int64_t, i, 0, msg_num) {
+    SocketMsg msg{};
+    msg.msg_type = SocketMsgType::kRequestWrite;
+    conns.writer(0)->AsyncWrite(msg);
+    while (received_cnt.load(std::memory_order_acquire) <= i) {}
+  }
+  const std::chrono::duration<double, std::micro> elapsed =
+      std::chrono::steady_clock::now() - start;
+  reader.join();
+  LOG(INFO) << "small message one-way latency: " << elapsed.count() / msg_num << " us";
+}
+
+TEST(SocketWriteHelper, socket_error) {
+  ::testing::FLAGS_gtest_death_test_style = "threadsafe";
+  EXPECT_DEATH(
+      {
+        LoopbackConnections conns(1, 1);
+        // Closing with a zero linger resets the connection, which leaves ECONNRESET pending on
+        // the writing end instead of a queued error.
+        linger reset{};
+        reset.l_onoff = 1;
+        PCHECK(setsockopt(conns.read_fd(0), SOL_SOCKET, SO_LINGER, &reset, sizeof(reset)) == 0);
+        PCHECK(close(conns.read_fd(0)) == 0);
+        // The poller of the writer fails on the EPOLLERR.
+        while (true) { std::this_thread::sleep_for(std::chrono::milliseconds(10)); }
+      },
+      "Connection reset by peer");
+}
+
+}  // namespace test
+
+}  // namespace oneflow
+
+#endif  // __linux__
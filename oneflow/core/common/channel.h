@@ -31,6 +31,8 @@ class Channel final {
 
   template<typename U>
   ChannelStatus Send(U&& item);
+  template<typename InputIt>
+  ChannelStatus SendMany(InputIt first, InputIt last);
   ChannelStatus Receive(T* item);
   ChannelStatus ReceiveMany(std::queue<T>* items);
   void Close();
@@ -56,6 +58,21 @@ ChannelStatus Channel<T>::Send(U&& item) {
   return kChannelStatusSuccess;
 }
 
+template<typename T>
+template<typename InputIt>
+ChannelStatus Channel<T>::SendMany(InputIt first, InputIt last) {
+  if (first == last) { return kChannelStatusSuccess; }
+  bool notify;
+  {
+    std::unique_lock<std::mutex> lock(mutex_);
+    if (is_closed_) { return kChannelStatusErrorClosed; }
+    notify = queue_.empty();
+    for (auto it = first; it != last; ++it) { queue_.push(*it); }
+  }
+  if (notify) { cond_.notify_one(); }
+  return kChannelStatusSuccess;
+}
+
 template<typename T>
 ChannelStatus Channel<T>::Receive(T* item) {
   std::unique_lock<std::mutex> lock(mutex_);
@@ -71,9 +88,13 @@ ChannelStatus Channel<T>::ReceiveMany(std::queue<T>* items) {
   std::unique_lock<std::mutex> lock(mutex_);
   cond_.wait(lock, [this]() { return (!queue_.empty()) || is_closed_; });
   if (queue_.empty()) { return kChannelStatusErrorClosed; }
-  while (!queue_.empty()) {
-    items->push(std::move(queue_.front()));
-    queue_.pop();
+  if (items->empty()) {
+    items->swap(queue_);
+  } else {
+    while (!queue_.empty()) {
+      items->push(std::move(queue_.front()));
+      queue_.pop();
+    }
   }
   return kChannelStatusSuccess;
 }
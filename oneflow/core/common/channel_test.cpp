@@ -60,4 +60,40 @@ TEST(Channel, 30sender40receiver) {
   }
 }
 
+TEST(Channel, send_many_keeps_order) {
+  Channel<int> channel;
+  int sender_num = 8;
+  int batch_num = 100;
+  int batch_size = 16;
+  std::vector<std::thread> senders;
+  for (int i = 0; i < sender_num; ++i) {
+    senders.emplace_back([&channel, i, batch_num, batch_size]() {
+      std::vector<int> batch(batch_size);
+      for (int j = 0; j < batch_num; ++j) {
+        for (int k = 0; k < batch_size; ++k) {
+          batch[k] = i * batch_num * batch_size + j * batch_size + k;
+        }
+        ASSERT_EQ(channel.SendMany(batch.begin(), batch.end()), kChannelStatusSuccess);
+      }
+    });
+  }
+  std::vector<int> last(sender_num, -1);
+  int received = 0;
+  std::queue<int> items;
+  while (received < sender_num * batch_num * batch_size) {
+    ASSERT_EQ(channel.ReceiveMany(&items), kChannelStatusSuccess);
+    while (!items.empty()) {
+      int item = items.front();
+      items.pop();
+      int sender = item / (batch_num * batch_size);
+      ASSERT_GT(item, last[sender]);
+      last[sender] = item;
+      received += 1;
+    }
+  }
+  for (std::thread& this_thread : senders) { this_thread.join(); }
+  channel.Close();
+  ASSERT_EQ(channel.ReceiveMany(&items), kChannelStatusErrorClosed);
+}
+
 }  // namespace oneflow
@@ -24,6 +24,11 @@ DEFINE_ENV_INTEGER(ONEFLOW_RPC_BOOTSTRAP_SERVER_SLEEP_SECONDS, 20);
 DEFINE_ENV_INTEGER(ONEFLOW_RPC_BOOTSTRAP_SERVER_MAX_RETRY_TIMES, 3);
 DEFINE_ENV_INTEGER(ONEFLOW_RPC_CLIENT_SLEEP_SECONDS, 5);
 DEFINE_ENV_INTEGER(ONEFLOW_RPC_CLIENT_MAX_RETRY_TIMES, 6);
+// Global barriers go through a combining tree of this fanout; values below 2 fall back to the
+// rank-0 barrier.
+DEFINE_ENV_INTEGER(ONEFLOW_CTRL_BARRIER_TREE_FANOUT, 8);
+// Number of control servers KV keys are sharded onto by hash; 0 means every rank's server.
+DEFINE_ENV_INTEGER(ONEFLOW_CTRL_KV_SHARD_NUM, 0);
 
 }  // namespace oneflow
 #endif  // ONEFLOW_CORE_COMMON_ENV_VAR_BOOTSTRAP_H_
@@ -0,0 +1,35 @@
+/*
+Copyright 2020 The OneFlow Authors. All rights reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+#ifndef ONEFLOW_CORE_COMMON_ENV_VAR_COMM_NET_H_
+#define ONEFLOW_CORE_COMMON_ENV_VAR_COMM_NET_H_
+
+#include "oneflow/core/common/env_var/env_var.h"
+
+namespace oneflow {
+
+DEFINE_ENV_INTEGER(ONEFLOW_COMM_NET_EPOLL_CONNECTIONS_PER_PEER, 4);
+DEFINE_ENV_INTEGER(ONEFLOW_COMM_NET_EPOLL_MIN_STRIPE_SIZE, 512 * 1024);
+DEFINE_ENV_BOOL(ONEFLOW_COMM_NET_EPOLL_ENABLE_ZEROCOPY, false);
+DEFINE_ENV_INTEGER(ONEFLOW_COMM_NET_EPOLL_ZEROCOPY_THRESHOLD, 64 * 1024);
+// If positive, payloads to a peer on the same host go through a shared memory ring of this many
+// bytes instead of the sockets. Each local peer takes a ring per direction in /dev/shm, so it is
+// off by default.
+DEFINE_ENV_INTEGER(ONEFLOW_COMM_NET_EPOLL_SHM_RING_SIZE, 0);
+// Transport sends of at most this many bytes to a remote machine are coalesced; 0 disables it.
+DEFINE_ENV_INTEGER(ONEFLOW_TRANSPORT_COALESCE_MAX_MSG_SIZE, 4096);
+
+}  // namespace oneflow
+#endif  // ONEFLOW_CORE_COMMON_ENV_VAR_COMM_NET_H_
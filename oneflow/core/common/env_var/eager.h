@@ -28,5 +28,23 @@ DEFINE_THREAD_LOCAL_ENV_BOOL(ONEFLOW_EAGER_ENABLE_LOCAL_INFER_CACHE, true);
 // infer cache in op interpret.
 DEFINE_THREAD_LOCAL_ENV_INTEGER(ONEFLOW_EAGER_TENSOR_INFER_CACHE_SIZE, 128 * 1024);
 
+// NOTE: use env variable 'ONEFLOW_EAGER_BOXING_PIPELINE_CHUNK_ELEM_CNT' indicate the number of
+// elements per chunk when eager boxing streams a large tensor chunk by chunk. Tensors smaller than
+// two chunks are boxed as a whole, and a non-positive value disables pipelined boxing.
+DEFINE_ENV_INTEGER(ONEFLOW_EAGER_BOXING_PIPELINE_CHUNK_ELEM_CNT, 16 * 1024 * 1024);
+
+// NOTE: use env variable 'ONEFLOW_EAGER_BOXING_ENABLE_COST_MODEL' indicate whether eager boxing
+// picks the cheapest candidate route by estimated cost instead of the first one that applies.
+DEFINE_ENV_BOOL(ONEFLOW_EAGER_BOXING_ENABLE_COST_MODEL, true);
+
+// NOTE: use env variable 'ONEFLOW_EAGER_BOXING_COST_HOP_ELEM_CNT' indicate the fixed cost of one
+// boxing hop in the eager boxing cost model, measured in transferred elements.
+DEFINE_ENV_INTEGER(ONEFLOW_EAGER_BOXING_COST_HOP_ELEM_CNT, 32 * 1024);
+
+// NOTE: use env variable 'ONEFLOW_EAGER_BOXING_ENABLE_STATS' indicate whether eager boxing
+// records per-route timing. Each boxing call then waits for the vm to finish, so enable it only
+// when calibrating the cost model.
+DEFINE_ENV_BOOL(ONEFLOW_EAGER_BOXING_ENABLE_STATS, false);
+
 }  // namespace oneflow
 #endif  // ONEFLOW_CORE_COMMON_ENV_VAR_EAGER_H_
@@ -0,0 +1,53 @@
+/*
+Copyright 2020 The OneFlow Authors. All rights reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+#include "oneflow/core/control/barrier_tree.h"
+#include <algorithm>
+#include "glog/logging.h"
+
+namespace oneflow {
+
+int64_t GetBarrierTreeParent(int64_t rank, int64_t fanout) {
+  CHECK_GT(rank, 0);
+  return (rank - 1) / fanout;
+}
+
+int64_t GetBarrierTreeChildrenNum(int64_t rank, int64_t world_size, int64_t fanout) {
+  const int64_t first_child = rank * fanout + 1;
+  return std::max<int64_t>(0, std::min<int64_t>(fanout, world_size - first_child));
+}
+
+void TreeBarrier(const std::string& barrier_name, int64_t rank, int64_t world_size,
+                 int64_t fanout, const BarrierAtFn& BarrierAt) {
+  CHECK_GE(fanout, 2);
+  CHECK_GE(rank, 0);
+  CHECK_LT(rank, world_size);
+  const std::string up_name = barrier_name + "/up";
+  const std::string down_name = barrier_name + "/down";
+  const int64_t children_num = GetBarrierTreeChildrenNum(rank, world_size, fanout);
+  // Gather the whole subtree at this rank's server before reporting to the parent.
+  if (children_num > 0) { BarrierAt(rank, up_name, children_num + 1); }
+  if (rank > 0) {
+    const int64_t parent = GetBarrierTreeParent(rank, fanout);
+    const int32_t parent_group_num = GetBarrierTreeChildrenNum(parent, world_size, fanout) + 1;
+    BarrierAt(parent, up_name, parent_group_num);
+    // The parent only enters its down barrier once the root has seen every rank.
+    BarrierAt(parent, down_name, parent_group_num);
+  }
+  // Release the children, which are waiting in the down barrier hosted by this rank.
+  if (children_num > 0) { BarrierAt(rank, down_name, children_num + 1); }
+}
+
+}  // namespace oneflow
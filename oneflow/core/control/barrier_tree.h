@@ -0,0 +1,40 @@
+/*
+Copyright 2020 The OneFlow Authors. All rights reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+#ifndef ONEFLOW_CORE_CONTROL_BARRIER_TREE_H_
+#define ONEFLOW_CORE_CONTROL_BARRIER_TREE_H_
+
+#include <cstdint>
+#include <functional>
+#include <string>
+
+namespace oneflow {
+
+// BarrierAt(owner_rank, name, num) blocks until `num` callers have entered the barrier `name`
+// hosted by the control server of `owner_rank`.
+using BarrierAtFn = std::function<void(int64_t, const std::string&, int32_t)>;
+
+int64_t GetBarrierTreeParent(int64_t rank, int64_t fanout);
+int64_t GetBarrierTreeChildrenNum(int64_t rank, int64_t world_size, int64_t fanout);
+
+// Combining-tree barrier over ranks [0, world_size) rooted at rank 0. Every rank only talks to
+// its own control server and to its parent's, so no server serves more than `fanout + 1`
+// callers per phase and the barrier completes in 2 * log_fanout(world_size) round trips.
+void TreeBarrier(const std::string& barrier_name, int64_t rank, int64_t world_size,
+                 int64_t fanout, const BarrierAtFn& BarrierAt);
+
+}  // namespace oneflow
+
+#endif  // ONEFLOW_CORE_CONTROL_BARRIER_TREE_H_
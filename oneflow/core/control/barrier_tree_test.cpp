@@ -0,0 +1,103 @@
+/*
+Copyright 2020 The OneFlow Authors. All rights reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+#include "gtest/gtest.h"
+#include <atomic>
+#include <thread>
+#include "oneflow/core/control/barrier_tree.h"
+#include "oneflow/core/rpc/include/local.h"
+
+namespace oneflow {
+namespace test {
+
+namespace {
+
+std::unique_ptr<LocalCtrlClient> NewLocalCtrlClient() {
+  ProcessCtx process_ctx;
+  process_ctx.add_ctrl_addr()->set_host("localhost");
+  process_ctx.set_rank(0);
+  process_ctx.set_node_size(1);
+  return std::make_unique<LocalCtrlClient>(process_ctx);
+}
+
+}  // namespace
+
+TEST(BarrierTree, topology) {
+  const int64_t world_size = 27;
+  const int64_t fanout = 4;
+  int64_t children_num_sum = 0;
+  for (int64_t rank = 0; rank < world_size; ++rank) {
+    const int64_t children_num = GetBarrierTreeChildrenNum(rank, world_size, fanout);
+    ASSERT_LE(children_num, fanout);
+    children_num_sum += children_num;
+    if (rank > 0) { ASSERT_LT(GetBarrierTreeParent(rank, fanout), rank); }
+  }
+  ASSERT_EQ(children_num_sum, world_size - 1);
+  ASSERT_EQ(GetBarrierTreeChildrenNum(0, world_size, fanout), 4);
+  ASSERT_EQ(GetBarrierTreeChildrenNum(6, world_size, fanout), 2);
+  ASSERT_EQ(GetBarrierTreeChildrenNum(7, world_size, fanout), 0);
+  ASSERT_EQ(GetBarrierTreeParent(26, fanout), 6);
+}
+
+TEST(BarrierTree, local_ctrl_client) {
+  auto client = NewLocalCtrlClient();
+  // Every rank's control server is emulated by a name prefix on the shared local client.
+  const auto BarrierAt = [&](int64_t owner_rank, const std::string& name, int32_t num) {
+    client->Barrier(std::to_string(owner_rank) + "/" + name, num);
+  };
+  const int64_t world_size = 37;
+  const int64_t fanout = 3;
+  const int64_t round_num = 5;
+  std::atomic<int64_t> arrived_num(0);
+  std::atomic<bool> released_early(false);
+  std::vector<std::thread> threads;
+  for (int64_t rank = 0; rank < world_size; ++rank) {
+    threads.emplace_back([&, rank]() {
+      for (int64_t round = 0; round < round_num; ++round) {
+        arrived_num += 1;
+        TreeBarrier("round_" + std::to_string(round), rank, world_size, fanout, BarrierAt);
+        if (arrived_num < (round + 1) * world_size) { released_early = true; }
+      }
+    });
+  }
+  for (auto& thread : threads) { thread.join(); }
+  ASSERT_FALSE(released_early);
+  ASSERT_EQ(arrived_num, round_num * world_size);
+}
+
+TEST(LocalCtrlClient, push_pull_kvs) {
+  auto client = NewLocalCtrlClient();
+  const int64_t key_num = 16;
+  std::vector<std::string> keys;
+  std::vector<std::string> vals;
+  for (int64_t i = 0; i < key_num; ++i) {
+    keys.emplace_back("key_" + std::to_string(i));
+    vals.emplace_back("val_" + std::to_string(i));
+  }
+  std::vector<std::string> pulled;
+  // The pull blocks until the second half of the keys shows up.
+  std::thread puller([&]() { client->PullKVs(keys, &pulled); });
+  client->PushKVs(std::vector<std::string>(keys.begin(), keys.begin() + key_num / 2),
+                  std::vector<std::string>(vals.begin(), vals.begin() + key_num / 2));
+  for (int64_t i = key_num / 2; i < key_num; ++i) { client->PushKV(keys.at(i), vals.at(i)); }
+  puller.join();
+  ASSERT_EQ(pulled, vals);
+  std::string val;
+  client->PullKV(keys.at(3), &val);
+  ASSERT_EQ(val, vals.at(3));
+}
+
+}  // namespace test
+}  // namespace oneflow
@@ -86,6 +86,16 @@ void GrpcCtrlClient::PushMasterKV(const std::string& k, const PbMessage& msg) {
   rpc_client_.PushMasterKV(k, msg);
 }
 
+void GrpcCtrlClient::PushKVs(const std::vector<std::string>& keys,
+                             const std::vector<std::string>& vals) {
+  rpc_client_.PushKVs(keys, vals);
+}
+
+void GrpcCtrlClient::PullKVs(const std::vector<std::string>& keys,
+                             std::vector<std::string>* vals) {
+  rpc_client_.PullKVs(keys, vals);
+}
+
 void GrpcCtrlClient::ClearKV(const std::string& k) { rpc_client_.ClearKV(k); }
 
 void GrpcCtrlClient::ClearMasterKV(const std::string& k) { rpc_client_.ClearMasterKV(k); }
@@ -0,0 +1,108 @@
+/*
+Copyright 2020 The OneFlow Authors. All rights reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+#ifndef ONEFLOW_CORE_CONTROL_MULTI_PROCESS_TEST_UTIL_H_
+#define ONEFLOW_CORE_CONTROL_MULTI_PROCESS_TEST_UTIL_H_
+
+#if defined(RPC_BACKEND_GRPC) && defined(__linux__)
+
+#include <gtest/gtest.h>
+#include <sys/types.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#include <cstdlib>
+#include <functional>
+#include <initializer_list>
+#include <memory>
+#include <string>
+#include <vector>
+#include "oneflow/core/control/ctrl_util.h"
+#include "oneflow/core/job/env.pb.h"
+#include "oneflow/core/job/env_global_objects_scope.h"
+
+namespace oneflow {
+
+namespace test {
+
+// Sets environment variables for the ranks forked by the test and restores them after.
+class ScopedEnvs final {
+ public:
+  explicit ScopedEnvs(std::initializer_list<std::pair<std::string, std::string>> envs) {
+    for (const auto& pair : envs) {
+      const char* old_val = std::getenv(pair.first.c_str());
+      old_envs_.emplace_back(pair.first, old_val == nullptr ? nullptr : new std::string(old_val));
+      PCHECK(setenv(pair.first.c_str(), pair.second.c_str(), 1) == 0);
+    }
+  }
+  ~ScopedEnvs() {
+    for (const auto& pair : old_envs_) {
+      if (pair.second) {
+        PCHECK(setenv(pair.first.c_str(), pair.second->c_str(), 1) == 0);
+      } else {
+        PCHECK(unsetenv(pair.first.c_str()) == 0);
+      }
+    }
+  }
+
+ private:
+  std::vector<std::pair<std::string, std::unique_ptr<std::string>>> old_envs_;
+};
+
+// Runs `func(rank)` in `world_size` forked processes on this host. Each one runs inside its own
+// EnvGlobalObjectsScope of rank `rank`, bootstrapped over gRPC like a multi-client job, so the
+// control plane, CommNet and Transport of the env are the real ones. Environment variables set
+// before the call are seen by all ranks. Expects every rank to exit without a failed check or
+// assertion.
+inline void RunInMultiProcessEnv(int64_t world_size, const std::function<void(int64_t)>& func) {
+  const int master_port = CtrlUtil().FindAvailablePort();
+  ASSERT_NE(master_port, -1);
+  std::vector<pid_t> pids;
+  for (int64_t rank = 0; rank < world_size; ++rank) {
+    const pid_t pid = fork();
+    PCHECK(pid != -1);
+    if (pid == 0) {
+      {
+        EnvProto env_proto;
+        auto* machine = env_proto.add_machine();
+        machine->set_id(0);
+        machine->set_addr("127.0.0.1");
+        env_proto.set_ctrl_port(master_port);
+        auto* bootstrap_conf = env_proto.mutable_ctrl_bootstrap_conf();
+        bootstrap_conf->mutable_master_addr()->set_host("127.0.0.1");
+        bootstrap_conf->mutable_master_addr()->set_port(master_port);
+        bootstrap_conf->set_rank(rank);
+        bootstrap_conf->set_world_size(world_size);
+        EnvGlobalObjectsScope scope(env_proto);
+        func(rank);
+      }
+      _exit(::testing::Test::HasFailure() ? 1 : 0);
+    }
+    pids.push_back(pid);
+  }
+  for (int64_t rank = 0; rank < world_size; ++rank) {
+    int status = 0;
+    PCHECK(waitpid(pids.at(rank), &status, 0) == pids.at(rank));
+    EXPECT_TRUE(WIFEXITED(status) && WEXITSTATUS(status) == 0)
+        << "rank " << rank << " failed, status: " << status;
+  }
+}
+
+}  // namespace test
+
+}  // namespace oneflow
+
+#endif  // RPC_BACKEND_GRPC && __linux__
+
+#endif  // ONEFLOW_CORE_CONTROL_MULTI_PROCESS_TEST_UTIL_H_
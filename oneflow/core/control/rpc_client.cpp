@@ -14,6 +14,7 @@ See the License for the specific language governing permissions and
 limitations under the License.
 */
 #include "oneflow/core/control/rpc_client.h"
+#include "oneflow/core/control/barrier_tree.h"
 #include "oneflow/core/control/global_process_ctx.h"
 #include "oneflow/core/job/env_desc.h"
 #include "oneflow/core/common/env_var/bootstrap.h"
@@ -33,6 +34,16 @@ int64_t rpc_client_sleep_seconds() {
   return rpc_client_sleep_seconds;
 }
 
+int64_t ctrl_barrier_tree_fanout() {
+  static const int64_t ctrl_barrier_tree_fanout = EnvInteger<ONEFLOW_CTRL_BARRIER_TREE_FANOUT>();
+  return ctrl_barrier_tree_fanout;
+}
+
+int64_t ctrl_kv_shard_num() {
+  static const int64_t ctrl_kv_shard_num = EnvInteger<ONEFLOW_CTRL_KV_SHARD_NUM>();
+  return ctrl_kv_shard_num;
+}
+
 #define GRPC_CHECK(x) CHECK_EQ(x.error_code(), grpc::StatusCode::OK)
 
 template<CtrlMethod ctrl_method>
@@ -61,10 +72,21 @@ void RpcClient::Barrier(const std::string& barrier_name) {
 }
 
 void RpcClient::Barrier(const std::string& barrier_name, int32_t barrier_num) {
-  ClientCall<CtrlMethod::kBarrier> call;
-  call.mut_request()->set_name(barrier_name);
-  call.mut_request()->set_num(barrier_num);
-  call(GetMasterStub());
+  const auto BarrierAt = [&](int64_t rank, const std::string& name, int32_t num) {
+    ClientCall<CtrlMethod::kBarrier> call;
+    call.mut_request()->set_name(name);
+    call.mut_request()->set_num(num);
+    call(GetStubAt(rank));
+  };
+  const int64_t world_size = GetStubSize();
+  const int64_t fanout = ctrl_barrier_tree_fanout();
+  // NOTE: Only a barrier joined by every rank has a known set of participants. Sub-group
+  // barriers and groups that fit under a single tree node still go through the master.
+  if (fanout >= 2 && barrier_num == world_size && world_size > fanout + 1) {
+    TreeBarrier(barrier_name, GlobalProcessCtx::Rank(), world_size, fanout, BarrierAt);
+  } else {
+    BarrierAt(0, barrier_name, barrier_num);
+  }
 }
 
 TryLockResult RpcClient::TryLock(const std::string& name) {
@@ -120,6 +142,35 @@ void RpcClient::PushMasterKV(const std::string& k, const PbMessage& msg) {
   PushMasterKV(k, [&](std::string* o) { msg.SerializeToString(o); });
 }
 
+void RpcClient::PushKVs(const std::vector<std::string>& keys,
+                        const std::vector<std::string>& vals) {
+  CHECK_EQ(keys.size(), vals.size());
+  std::map<int64_t, ClientCall<CtrlMethod::kPushKVs>> rank2call;
+  for (size_t i = 0; i < keys.size(); ++i) {
+    auto* request = rank2call[GetResponsibleRank(keys[i])].mut_request();
+    request->add_key(keys[i]);
+    request->add_val(vals[i]);
+  }
+  for (auto& pair : rank2call) { pair.second(GetStubAt(pair.first)); }
+}
+
+void RpcClient::PullKVs(const std::vector<std::string>& keys, std::vector<std::string>* vals) {
+  vals->resize(keys.size());
+  std::map<int64_t, std::pair<ClientCall<CtrlMethod::kPullKVs>, std::vector<size_t>>> rank2call;
+  for (size_t i = 0; i < keys.size(); ++i) {
+    auto& call7indices = rank2call[GetResponsibleRank(keys[i])];
+    call7indices.first.mut_request()->add_key(keys[i]);
+    call7indices.second.emplace_back(i);
+  }
+  for (auto& pair : rank2call) {
+    auto& call = pair.second.first;
+    const std::vector<size_t>& indices = pair.second.second;
+    call(GetStubAt(pair.first));
+    CHECK_EQ(call.response().val_size(), indices.size());
+    for (size_t i = 0; i < indices.size(); ++i) { vals->at(indices[i]) = call.response().val(i); }
+  }
+}
+
 void RpcClient::ClearKV(const std::string& k) {
   ClientCall<CtrlMethod::kClearKV> call;
   call.mut_request()->set_key(k);
@@ -215,9 +266,16 @@ void RpcClient::LoadServer(const LoadServerRequest& request, CtrlService::Stub*
 CtrlService::Stub* RpcClient::GetThisStub() { return stubs_[GlobalProcessCtx::Rank()].get(); }
 
 CtrlService::Stub* RpcClient::GetResponsibleStub(const std::string& key) {
-  int64_t machine_id =
-      (std::hash<std::string>{}(key)) % Singleton<EnvDesc>::Get()->TotalMachineNum();
-  return stubs_[machine_id].get();
+  return stubs_[GetResponsibleRank(key)].get();
+}
+
+int64_t RpcClient::GetResponsibleRank(const std::string& key) {
+  const int64_t world_size = Singleton<EnvDesc>::Get()->TotalMachineNum();
+  int64_t shard_num = ctrl_kv_shard_num();
+  if (shard_num <= 0 || shard_num > world_size) { shard_num = world_size; }
+  const int64_t shard_id = (std::hash<std::string>{}(key)) % shard_num;
+  // Spread the shards evenly over the ranks so that they land on different nodes.
+  return shard_id * world_size / shard_num;
 }
 
 }  // namespace oneflow
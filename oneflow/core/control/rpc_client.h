@@ -45,6 +45,9 @@ class RpcClient {
     PushKV(k, std::to_string(v));
   }
 
+  void PushKVs(const std::vector<std::string>& keys, const std::vector<std::string>& vals);
+  void PullKVs(const std::vector<std::string>& keys, std::vector<std::string>* vals);
+
   void ClearKV(const std::string& k);
   void ClearMasterKV(const std::string& k);
 
@@ -71,6 +74,7 @@ class RpcClient {
   CtrlService::Stub* GetMasterStub() { return stubs_[0].get(); }
   CtrlService::Stub* GetThisStub();
   CtrlService::Stub* GetResponsibleStub(const std::string& key);
+  int64_t GetResponsibleRank(const std::string& key);
   CtrlService::Stub* GetStubAt(int64_t i) { return stubs_[i].get(); };
   size_t GetStubSize() { return stubs_.size(); };
   void ReserveStubsOfSize(int64_t n) { stubs_.reserve(n); };
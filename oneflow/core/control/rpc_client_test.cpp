@@ -0,0 +1,105 @@
+/*
+Copyright 2020 The OneFlow Authors. All rights reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+#if defined(RPC_BACKEND_GRPC) && defined(__linux__)
+
+#include <gtest/gtest.h>
+#include <sys/mman.h>
+#include <atomic>
+#include "oneflow/core/control/ctrl_client.h"
+#include "oneflow/core/control/multi_process_test_util.h"
+
+namespace oneflow {
+
+namespace test {
+
+namespace {
+
+std::string KVKey(int64_t rank, int64_t i) {
+  return "RpcClientTest/" + std::to_string(rank) + "/" + std::to_string(i);
+}
+
+std::string KVVal(int64_t rank, int64_t i) {
+  return std::string(i * 97 + 1, static_cast<char>('a' + (rank + i) % 26));
+}
+
+// Runs `round_num` global barriers and a batched KV exchange in a world of `world_size` forked
+// ranks. The ranks count their arrivals at each barrier in memory shared by all of them, so a
+// rank released before every rank has arrived is caught.
+void TestBarriersAndKVs(int64_t world_size, int64_t round_num, int64_t key_num) {
+  void* shm = mmap(nullptr, sizeof(std::atomic<int64_t>) * 2, PROT_READ | PROT_WRITE,
+                   MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+  PCHECK(shm != MAP_FAILED);
+  auto* arrived_num = new (shm) std::atomic<int64_t>(0);
+  auto* released_early_num = new (arrived_num + 1) std::atomic<int64_t>(0);
+  ASSERT_TRUE(arrived_num->is_lock_free());
+  RunInMultiProcessEnv(world_size, [&](int64_t rank) {
+    auto* ctrl_client = Singleton<CtrlClient>::Get();
+    for (int64_t round = 0; round < round_num; ++round) {
+      *arrived_num += 1;
+      ctrl_client->Barrier("RpcClientTest/round_" + std::to_string(round));
+      if (*arrived_num < (round + 1) * world_size) { *released_early_num += 1; }
+    }
+
+    std::vector<std::string> keys;
+    std::vector<std::string> vals;
+    for (int64_t i = 0; i < key_num; ++i) {
+      keys.emplace_back(KVKey(rank, i));
+      vals.emplace_back(KVVal(rank, i));
+    }
+    ctrl_client->PushKVs(keys, vals);
+    // Every rank pulls the keys of all ranks in one batch, which blocks until they are pushed.
+    std::vector<std::string> all_keys;
+    for (int64_t peer = 0; peer < world_size; ++peer) {
+      for (int64_t i = 0; i < key_num; ++i) { all_keys.emplace_back(KVKey(peer, i)); }
+    }
+    std::vector<std::string> pulled;
+    ctrl_client->PullKVs(all_keys, &pulled);
+    ASSERT_EQ(pulled.size(), all_keys.size());
+    for (int64_t peer = 0; peer < world_size; ++peer) {
+      for (int64_t i = 0; i < key_num; ++i) {
+        ASSERT_EQ(pulled.at(peer * key_num + i), KVVal(peer, i)) << KVKey(peer, i);
+      }
+    }
+    std::string val;
+    ctrl_client->PullKV(KVKey((rank + 1) % world_size, 0), &val);
+    ASSERT_EQ(val, KVVal((rank + 1) % world_size, 0));
+    ctrl_client->Barrier("RpcClientTest/pulled");
+    for (const std::string& key : keys) { ctrl_client->ClearKV(key); }
+  });
+  ASSERT_EQ(*arrived_num, round_num * world_size);
+  ASSERT_EQ(*released_early_num, 0);
+  PCHECK(munmap(shm, sizeof(std::atomic<int64_t>) * 2) == 0);
+}
+
+}  // namespace
+
+TEST(RpcClient, tree_barrier_and_kvs) {
+  // A world larger than fanout + 1 runs the global barriers as a tree.
+  ScopedEnvs envs({{"ONEFLOW_CTRL_BARRIER_TREE_FANOUT", "2"}});
+  TestBarriersAndKVs(5, 4, 16);
+}
+
+TEST(RpcClient, master_barrier_and_sharded_kvs) {
+  // A world of the default fanout + 1 or less runs the global barriers on the master.
+  ScopedEnvs envs({{"ONEFLOW_CTRL_KV_SHARD_NUM", "2"}});
+  TestBarriersAndKVs(3, 4, 16);
+}
+
+}  // namespace test
+
+}  // namespace oneflow
+
+#endif  // RPC_BACKEND_GRPC && __linux__
@@ -129,26 +129,25 @@ void RpcServer::Init() {
   });
 
   Add([this](CtrlCall<CtrlMethod::kPushKV>* call) {
-    const std::string& k = call->request().key();
-    const std::string& v = call->request().val();
-    CHECK(kv_.emplace(k, v).second);
+    OnKVPushed(call->request().key(), call->request().val());
+    call->SendResponse();
+    EnqueueRequest<CtrlMethod::kPushKV>();
+  });
 
-    auto pending_kv_calls_it = pending_kv_calls_.find(k);
-    if (pending_kv_calls_it != pending_kv_calls_.end()) {
-      for (auto pending_call : pending_kv_calls_it->second) {
-        pending_call->mut_response()->set_val(v);
-        pending_call->SendResponse();
-      }
-      pending_kv_calls_.erase(pending_kv_calls_it);
+  Add([this](CtrlCall<CtrlMethod::kPushKVs>* call) {
+    CHECK_EQ(call->request().key_size(), call->request().val_size());
+    for (int64_t i = 0; i < call->request().key_size(); ++i) {
+      OnKVPushed(call->request().key(i), call->request().val(i));
     }
     call->SendResponse();
-    EnqueueRequest<CtrlMethod::kPushKV>();
+    EnqueueRequest<CtrlMethod::kPushKVs>();
   });
 
   Add([this](CtrlCall<CtrlMethod::kClearKV>* call) {
     const std::string& k = call->request().key();
     CHECK_EQ(kv_.erase(k), 1);
     CHECK(pending_kv_calls_.find(k) == pending_kv_calls_.end());
+    CHECK(pending_kvs_calls_.find(k) == pending_kvs_calls_.end());
     call->SendResponse();
     EnqueueRequest<CtrlMethod::kClearKV>();
   });
@@ -165,11 +164,29 @@ void RpcServer::Init() {
     EnqueueRequest<CtrlMethod::kPullKV>();
   });
 
+  Add([this](CtrlCall<CtrlMethod::kPullKVs>* call) {
+    int64_t missing_num = 0;
+    for (const std::string& k : call->request().key()) {
+      if (kv_.find(k) == kv_.end()) {
+        pending_kvs_calls_[k].emplace_back(call);
+        missing_num += 1;
+      }
+    }
+    if (missing_num == 0) {
+      SendPullKVsResponse(call);
+    } else {
+      CHECK(pending_kvs_call2missing_num_.emplace(call, missing_num).second);
+    }
+    EnqueueRequest<CtrlMethod::kPullKVs>();
+  });
+
   Add([this](CtrlCall<CtrlMethod::kClear>* call) {
     name2lock_status_.clear();
     kv_.clear();
     CHECK(pending_kv_calls_.empty()) << "size(): " << pending_kv_calls_.size()
                                      << ", begin()->key: " << pending_kv_calls_.begin()->first;
+    CHECK(pending_kvs_calls_.empty()) << "size(): " << pending_kvs_calls_.size()
+                                      << ", begin()->key: " << pending_kvs_calls_.begin()->first;
     call->SendResponse();
     EnqueueRequest<CtrlMethod::kClear>();
   });
@@ -189,4 +206,38 @@ void RpcServer::Init() {
   });
 }
 
+void RpcServer::OnKVPushed(const std::string& k, const std::string& v) {
+  CHECK(kv_.emplace(k, v).second);
+
+  auto pending_kv_calls_it = pending_kv_calls_.find(k);
+  if (pending_kv_calls_it != pending_kv_calls_.end()) {
+    for (auto pending_call : pending_kv_calls_it->second) {
+      pending_call->mut_response()->set_val(v);
+      pending_call->SendResponse();
+    }
+    pending_kv_calls_.erase(pending_kv_calls_it);
+  }
+
+  auto pending_kvs_calls_it = pending_kvs_calls_.find(k);
+  if (pending_kvs_calls_it != pending_kvs_calls_.end()) {
+    for (auto pending_call : pending_kvs_calls_it->second) {
+      auto missing_num_it = pending_kvs_call2missing_num_.find(pending_call);
+      CHECK(missing_num_it != pending_kvs_call2missing_num_.end());
+      missing_num_it->second -= 1;
+      if (missing_num_it->second == 0) {
+        pending_kvs_call2missing_num_.erase(missing_num_it);
+        SendPullKVsResponse(pending_call);
+      }
+    }
+    pending_kvs_calls_.erase(pending_kvs_calls_it);
+  }
+}
+
+void RpcServer::SendPullKVsResponse(CtrlCall<CtrlMethod::kPullKVs>* call) {
+  for (const std::string& k : call->request().key()) {
+    *call->mut_response()->add_val() = kv_.at(k);
+  }
+  call->SendResponse();
+}
+
 }  // namespace oneflow
@@ -67,6 +67,9 @@ class RpcServer {
 
   virtual void OnLoadServer(CtrlCall<CtrlMethod::kLoadServer>* call) = 0;
 
+  void OnKVPushed(const std::string& k, const std::string& v);
+  void SendPullKVsResponse(CtrlCall<CtrlMethod::kPullKVs>* call);
+
   struct helper {
     helper(RpcServer* s) : s_(s) {}
     template<typename T, typename V>
@@ -88,9 +91,11 @@ class RpcServer {
   HashMap<std::string, std::pair<std::list<CtrlCallIf*>, int32_t>> barrier_calls_;
   // TryLock, NotifyDone, WaitUntilDone
   HashMap<std::string, void*> name2lock_status_;
-  // PushKV, ClearKV, PullKV
+  // PushKV, ClearKV, PullKV, PushKVs, PullKVs
   HashMap<std::string, std::string> kv_;
   HashMap<std::string, std::list<CtrlCall<CtrlMethod::kPullKV>*>> pending_kv_calls_;
+  HashMap<std::string, std::list<CtrlCall<CtrlMethod::kPullKVs>*>> pending_kvs_calls_;
+  HashMap<CtrlCall<CtrlMethod::kPullKVs>*, int64_t> pending_kvs_call2missing_num_;
   // IncreaseCount, EraseCount
   HashMap<std::string, int32_t> count_;
 };
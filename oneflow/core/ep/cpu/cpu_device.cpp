@@ -18,11 +18,44 @@ limitations under the License.
 #include "oneflow/core/ep/cpu/cpu_event.h"
 #include "oneflow/core/ep/cpu/cpu_stream.h"
 #include "oneflow/core/ep/include/device_manager_registry.h"
+#include "oneflow/core/hardware/node_device_descriptor_manager.h"
+#ifdef __linux__
+#include <sys/mman.h>
+#endif  // __linux__
 
 namespace oneflow {
 
 namespace ep {
 
+namespace {
+
+constexpr size_t kHugePageSize = 2 * 1024 * 1024;
+
+// Binds the memory policy of the calling thread to a numa node in its scope, so that pages first
+// touched inside it are placed on that node.
+class NumaMemoryAffinityGuard final {
+ public:
+  OF_DISALLOW_COPY_AND_MOVE(NumaMemoryAffinityGuard);
+  explicit NumaMemoryAffinityGuard(const AllocationOptions& options) {
+    if (!options.HasNumaNodeAffinity()) { return; }
+    auto node_device_desc_mgr = Singleton<hardware::NodeDeviceDescriptorManager>::Get();
+    if (node_device_desc_mgr == nullptr) { return; }
+    topology_ = node_device_desc_mgr->GetLocalNodeDeviceDescriptor()->Topology();
+    saved_affinity_ = topology_->GetMemoryAffinity();
+    if (!saved_affinity_) { return; }
+    topology_->SetMemoryAffinityByNumaNode(options.GetNumaNodeAffinity());
+  }
+  ~NumaMemoryAffinityGuard() {
+    if (saved_affinity_) { topology_->SetMemoryAffinity(saved_affinity_); }
+  }
+
+ private:
+  std::shared_ptr<const hardware::TopologyDescriptor> topology_;
+  std::shared_ptr<const hardware::TopologyMemoryAffinityDescriptor> saved_affinity_;
+};
+
+}  // namespace
+
 void CpuDevice::SetAsActiveDevice() {}
 
 Stream* CpuDevice::CreateStream() { return new CpuStream(this); }
@@ -38,6 +71,7 @@ void CpuDevice::DestroyEvents(Event** events, size_t count) {
 }
 
 Maybe<void> CpuDevice::Alloc(const AllocationOptions& options, void** ptr, size_t size) {
+  NumaMemoryAffinityGuard numa_guard(options);
   if (options.HasPinnedDevice()) {
     auto device =
         this->device_manager()->registry()->GetDevice(options.GetPinnedDeviceType(),    // NOLINT
@@ -45,11 +79,18 @@ Maybe<void> CpuDevice::Alloc(const AllocationOptions& options, void** ptr, size_
     CHECK_OR_RETURN(device);
     JUST(device->AllocPinned(options, ptr, size));
   } else {
-    *ptr = aligned_alloc(kMaxAlignmentRequirement, RoundUp(size, kMaxAlignmentRequirement));
+    const size_t alignment = options.HasHugePageHint() ? kHugePageSize : kMaxAlignmentRequirement;
+    const size_t aligned_size = RoundUp(size, alignment);
+    *ptr = aligned_alloc(alignment, aligned_size);
     if (*ptr == nullptr) {
       return Error::RuntimeError()
              << "CPU can't allocate memory. Tried to allocate " << FormatMemSize(size);
     }
+#if defined(__linux__) && defined(MADV_HUGEPAGE)
+    // NOTE: advice only, transparent huge pages may be disabled on this host.
+    if (options.HasHugePageHint()) { madvise(*ptr, aligned_size, MADV_HUGEPAGE); }
+#endif  // defined(__linux__) && defined(MADV_HUGEPAGE)
+    if (options.IsFirstTouchDeferred()) { return Maybe<void>::Ok(); }
   }
   memset(*ptr, 0, size);
   return Maybe<void>::Ok();
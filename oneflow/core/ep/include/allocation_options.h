@@ -28,7 +28,9 @@ class AllocationOptions {
   AllocationOptions()
       : pinned_device_type_(DeviceType::kInvalidDevice),
         pinned_device_index_{},
-        numa_node_affinity_(-1) {}
+        numa_node_affinity_(-1),
+        huge_page_hint_(false),
+        first_touch_deferred_(false) {}
   ~AllocationOptions() = default;
 
   bool HasPinnedDevice() const { return pinned_device_type_ != DeviceType::kInvalidDevice; }
@@ -63,10 +65,23 @@ class AllocationOptions {
 
   void ClearNumaNodeAffinity() { numa_node_affinity_ = -1; }
 
+  // Only meaningful for unpinned host memory, the backing pages are advised to be huge pages.
+  bool HasHugePageHint() const { return huge_page_hint_; }
+
+  void SetHugePageHint() { huge_page_hint_ = true; }
+
+  // Only meaningful for unpinned host memory, the allocation is neither touched nor zero filled
+  // and the caller is responsible for the first touch.
+  bool IsFirstTouchDeferred() const { return first_touch_deferred_; }
+
+  void SetFirstTouchDeferred() { first_touch_deferred_ = true; }
+
  private:
   DeviceType pinned_device_type_;
   size_t pinned_device_index_;
   int32_t numa_node_affinity_;
+  bool huge_page_hint_;
+  bool first_touch_deferred_;
 };
 
 }  // namespace ep
@@ -433,24 +433,50 @@ Maybe<void> NNGraph::CompilePlanForRuntime() {
     sub_compile_tc->Count("[GraphCompile]" + name_ + " GenMemAndLightPlanLog", 1, true);
   }
   compile_tc->Count("[GraphCompile]" + name_ + " CompilePlan", 0);
+  // NOTE: Each rank only keeps a compact plan of its own tasks, whose kernel confs and op
+  // attributes are materialized lazily when constructing the actors.
   if (GlobalProcessCtx::WorldSize() > 1) {
-    std::string plan_name = "plan:" + job_name();
+    auto GetPlanName = [&](int64_t rank) {
+      return "plan:" + job_name() + ":rank:" + std::to_string(rank);
+    };
     if (GlobalProcessCtx::IsThisProcessMaster()) {
-      // TODO(chengcheng): split plan for each rank.
-      Singleton<CtrlClient>::Get()->PushKV(plan_name, plan_);
+      Plan this_rank_plan;
+      for (int64_t rank = 0; rank < GlobalProcessCtx::WorldSize(); ++rank) {
+        if (rank == GlobalProcessCtx::Rank()) {
+          PlanUtil::GenCompactPlan4Rank(plan_, rank, &this_rank_plan);
+          continue;
+        }
+        Plan rank_plan;
+        PlanUtil::GenCompactPlan4Rank(plan_, rank, &rank_plan);
+        std::string compressed_plan;
+        PlanUtil::CompressPlan(rank_plan, &compressed_plan);
+        VLOG(1) << "nn.Graph " << name_ << " plan of rank " << rank << ": "
+                << rank_plan.ByteSizeLong() << " bytes, compressed to " << compressed_plan.size()
+                << " bytes";
+        Singleton<CtrlClient>::Get()->PushKV(GetPlanName(rank), compressed_plan);
+      }
+      plan_.Swap(&this_rank_plan);
     } else {
-      Singleton<CtrlClient>::Get()->PullKV(plan_name, &plan_);
+      std::string compressed_plan;
+      Singleton<CtrlClient>::Get()->PullKV(GetPlanName(GlobalProcessCtx::Rank()), &compressed_plan);
+      PlanUtil::DecompressPlan(compressed_plan, &plan_);
     }
     OF_SESSION_BARRIER();
     // NOTE(zwx): After barrier plan is synchronized between all ranks,
     //     then it can be cleared for saving mem.
     if (GlobalProcessCtx::IsThisProcessMaster()) {
-      Singleton<CtrlClient>::Get()->ClearKV(plan_name);
+      for (int64_t rank = 0; rank < GlobalProcessCtx::WorldSize(); ++rank) {
+        if (rank != GlobalProcessCtx::Rank()) {
+          Singleton<CtrlClient>::Get()->ClearKV(GetPlanName(rank));
+        }
+      }
     }
+  } else {
+    Plan compact_plan;
+    PlanUtil::GenCompactPlan4Rank(plan_, GlobalProcessCtx::Rank(), &compact_plan);
+    plan_.Swap(&compact_plan);
   }
   compile_tc->Count("[GraphCompile]" + name_ + " SyncPlan", 0, true);
-  // NOTE(chengcheng): recovery op_attr
-  PlanUtil::PopulateOpAttribute(&plan_, plan_.job_id2op_attribute_ref_table());
   return Maybe<void>::Ok();
 }
 
@@ -200,6 +200,22 @@ Maybe<one::UserOpExpr> RankGroupAndDeviceType2ReduceScatterOpExpr(Symbol<RankGro
 auto* CachedRankGroupAndDeviceType2ReduceScatterOpExpr =
     DECORATE(&RankGroupAndDeviceType2ReduceScatterOpExpr, ThreadLocal);
 
+Maybe<one::UserOpExpr> RankGroupAndDeviceType2CompressedAllReduceOpExpr(
+    Symbol<RankGroup> rank_group, DeviceType device_type, bool has_error, bool has_q) {
+  CHECK_OR_RETURN(JUST(CheckCclKernelRegistered("gradient_compressed_all_reduce", device_type)))
+      << OF_KERNEL_NOT_SUPPORT_ERROR("CompressedAllReduce", device_type);
+  const auto& parallel_desc = JUST(RankGroup::GetDefaultParallelDesc(device_type, rank_group));
+  auto builder = one::OpBuilder("gradient_compressed_all_reduce").Input("in");
+  if (has_error) { builder.Input("error"); }
+  if (has_q) { builder.Input("q"); }
+  return builder.Output("out")
+      .Attr<std::string>("parallel_conf", PbMessage2TxtString(parallel_desc->parallel_conf()))
+      .Build();
+}
+
+auto* CachedRankGroupAndDeviceType2CompressedAllReduceOpExpr =
+    DECORATE(&RankGroupAndDeviceType2CompressedAllReduceOpExpr, ThreadLocal);
+
 #undef OF_KERNEL_NOT_SUPPORT_ERROR
 
 }  // namespace
@@ -282,6 +298,26 @@ class LocalAllReduceFunctor {
   }
 };
 
+class LocalCompressedAllReduceFunctor {
+ public:
+  LocalCompressedAllReduceFunctor() = default;
+  Maybe<Tensor> operator()(const std::shared_ptr<one::Tensor>& x, const std::string& method,
+                           const Optional<one::Tensor>& error, const Optional<one::Tensor>& q,
+                           float top_k_ratio) const {
+    const auto& device = JUST(x->device());
+    CHECK_EQ_OR_RETURN(device->device_id(), GlobalProcessCtx::LocalRank());
+    const auto& rank_group = JUST(RankGroupScope::CurrentRankGroup());
+    std::shared_ptr<OpExpr> op_expr = JUST(CachedRankGroupAndDeviceType2CompressedAllReduceOpExpr(
+        rank_group, device->enum_type(), error.has_value(), q.has_value()));
+    TensorTuple inputs{x};
+    if (error) { inputs.emplace_back(JUST(error)); }
+    if (q) { inputs.emplace_back(JUST(q)); }
+    auto& attrs = THREAD_CACHED_MUTABLE_ATTR_MAP("method", "top_k_ratio");
+    attrs.SetAllAttrs(method, top_k_ratio);
+    return OpInterpUtil::Dispatch<Tensor>(*op_expr, inputs, attrs);
+  }
+};
+
 class GlobalAllReduceFunctor {
  public:
   GlobalAllReduceFunctor() = default;
@@ -539,6 +575,7 @@ ONEFLOW_FUNCTION_LIBRARY(m) {
   m.add_functor<impl::CommBroadcastFunctor>("CommBroadcast");
   m.add_functor<impl::CommBroadcastTensorsFunctor>("CommBroadcastTensors");
   m.add_functor<impl::LocalAllReduceFunctor>("LocalAllReduce");
+  m.add_functor<impl::LocalCompressedAllReduceFunctor>("LocalCompressedAllReduce");
   m.add_functor<impl::LocalAllGatherFunctor>("LocalAllGather");
   m.add_functor<impl::LocalReduceScatterFunctor>("LocalReduceScatter");
   m.add_functor<impl::GlobalAllReduceFunctor>("GlobalAllReduce");
@@ -32,13 +32,28 @@ using namespace boxing::collective;
 
 namespace {
 
-void NcclInitCollectiveNode(CollectiveBoxingGenericTaskNode* node,
-                            const ParallelDesc& parallel_desc, int64_t parallel_id,
-                            const std::string& name, const LogicalBlobId& lbi,
-                            const BlobDesc& logical_blob_desc, OpType op_type, int64_t root) {
+bool IsCollectiveBoxingDevice(const ParallelDesc& parallel_desc) {
+  if (parallel_desc.device_type() == DeviceType::kCUDA) {
+    return true;
+  } else if (parallel_desc.device_type() == DeviceType::kCPU) {
+    // The cpu backend runs one rank per process.
+    return Singleton<ResourceDesc, ForSession>::Get()
+               ->collective_boxing_conf()
+               .cpu_enable_collective_boxing()
+           && parallel_desc.sorted_machine_ids().size() == parallel_desc.parallel_num();
+  } else {
+    return false;
+  }
+}
+
+void InitCollectiveNode(CollectiveBoxingGenericTaskNode* node, const ParallelDesc& parallel_desc,
+                        int64_t parallel_id, const std::string& name, const LogicalBlobId& lbi,
+                        const BlobDesc& logical_blob_desc, OpType op_type, int64_t root) {
+  const DeviceType device_type = parallel_desc.device_type();
+  CHECK(device_type == DeviceType::kCUDA || device_type == DeviceType::kCPU);
   OperatorConf op_conf;
   op_conf.set_name(name);
-  op_conf.set_device_tag(*CHECK_JUST(DeviceTag4DeviceType(DeviceType::kCUDA)));
+  op_conf.set_device_tag(*CHECK_JUST(DeviceTag4DeviceType(device_type)));
   CollectiveBoxingGenericOpConf* conf = op_conf.mutable_collective_boxing_generic_conf();
   *conf->mutable_lbi() = lbi;
   RankDesc* rank_desc = conf->mutable_rank_desc();
@@ -59,13 +74,20 @@ void NcclInitCollectiveNode(CollectiveBoxingGenericTaskNode* node,
   } else {
     CHECK_EQ(root, -1);
   }
-  op_desc->set_backend(Backend::kBackendNCCL);
   rank_desc->set_rank(parallel_id);
 
   const int64_t machine_id = CHECK_JUST(parallel_desc.MachineId4ParallelId(parallel_id));
-  const int64_t device_index = CHECK_JUST(parallel_desc.DeviceId4ParallelId(parallel_id));
-  const int64_t thrd_id = EncodeStreamIdToInt64(
-      GenerateNamedTaskStreamId(machine_id, DeviceType::kCUDA, device_index, "NCCL"));
+  int64_t thrd_id = -1;
+  if (device_type == DeviceType::kCUDA) {
+    op_desc->set_backend(Backend::kBackendNCCL);
+    const int64_t device_index = CHECK_JUST(parallel_desc.DeviceId4ParallelId(parallel_id));
+    thrd_id = EncodeStreamIdToInt64(
+        GenerateNamedTaskStreamId(machine_id, DeviceType::kCUDA, device_index, "NCCL"));
+  } else {
+    op_desc->set_backend(Backend::kBackendCPU);
+    thrd_id = EncodeStreamIdToInt64(
+        GenerateNamedTaskStreamId(machine_id, DeviceType::kCPU, 0, "CPU_COLLECTIVE_BOXING"));
+  }
   node->Init(machine_id, thrd_id, lbi, op_conf);
 }
 
@@ -101,15 +123,14 @@ class NcclCollectiveBoxingAllReduceSubTskGphBuilder final : public SubTskGphBuil
       const SbpParallel& out_sbp_parallel, const Shape& time_shape) const override {
     if (out_parallel_desc.Equals(in_parallel_desc)
         && !SubTskGphBuilderUtil::BlobHasDynamicShape(logical_blob_desc)
-        && out_parallel_desc.device_type() == DeviceType::kCUDA
-        && out_parallel_desc.parallel_num() > 1
+        && IsCollectiveBoxingDevice(out_parallel_desc) && out_parallel_desc.parallel_num() > 1
         && SubTskGphBuilderUtil::IsBoxingP2B(in_sbp_parallel, out_sbp_parallel)) {
       const std::string op_name = "System-Boxing-NcclCollectiveBoxingAllReduce-" + NewUniqueId();
       FOR_RANGE(int64_t, i, 0, in_parallel_desc.parallel_num()) {
         TaskNode* in_node = sorted_in_tasks.at(i);
         auto* collective_node = ctx->task_graph()->NewNode<CollectiveBoxingGenericTaskNode>();
-        NcclInitCollectiveNode(collective_node, in_parallel_desc, i, op_name, lbi,
-                               logical_blob_desc, OpType::kOpTypeAllReduce, -1);
+        InitCollectiveNode(collective_node, in_parallel_desc, i, op_name, lbi, logical_blob_desc,
+                           OpType::kOpTypeAllReduce, -1);
         ctx->task_graph()->ConnectWithLbi(in_node, collective_node, lbi);
         sorted_out_tasks->emplace_back(collective_node);
       }
@@ -135,7 +156,7 @@ class NcclCollectiveBoxingReduceScatterSubTskGphBuilder final : public SubTskGph
       const SbpParallel& out_sbp_parallel, const Shape& time_shape) const override {
     if (out_parallel_desc.Equals(in_parallel_desc)
         && !SubTskGphBuilderUtil::BlobHasDynamicShape(logical_blob_desc)
-        && out_parallel_desc.device_type() == DeviceType::kCUDA
+        && IsCollectiveBoxingDevice(out_parallel_desc)
         && out_parallel_desc.parallel_num() > 1 && logical_blob_desc.shape().NumAxes() > 0
         && logical_blob_desc.shape().At(0) % out_parallel_desc.parallel_num() == 0
         && SubTskGphBuilderUtil::IsBoxingP2S(in_sbp_parallel, out_sbp_parallel)
@@ -145,8 +166,8 @@ class NcclCollectiveBoxingReduceScatterSubTskGphBuilder final : public SubTskGph
       FOR_RANGE(int64_t, i, 0, in_parallel_desc.parallel_num()) {
         TaskNode* in_node = sorted_in_tasks.at(i);
         auto* collective_node = ctx->task_graph()->NewNode<CollectiveBoxingGenericTaskNode>();
-        NcclInitCollectiveNode(collective_node, in_parallel_desc, i, op_name, lbi,
-                               logical_blob_desc, OpType::kOpTypeReduceScatter, -1);
+        InitCollectiveNode(collective_node, in_parallel_desc, i, op_name, lbi, logical_blob_desc,
+                           OpType::kOpTypeReduceScatter, -1);
         ctx->task_graph()->ConnectWithLbi(in_node, collective_node, lbi);
         sorted_out_tasks->emplace_back(collective_node);
       }
@@ -196,7 +217,7 @@ class NcclCollectiveBoxingP2SNoncontinuousSubTskGphBuilder final : public SubTsk
         ctx->task_graph()->ConnectWithLbi(in_node, pack_node, lbi);
 
         auto* collective_node = ctx->task_graph()->NewNode<CollectiveBoxingGenericTaskNode>();
-        NcclInitCollectiveNode(
+        InitCollectiveNode(
             collective_node, in_parallel_desc, i, op_name, lbi,
             BlobDesc({logical_blob_desc.shape().elem_cnt()}, logical_blob_desc.data_type()),
             OpType::kOpTypeReduceScatter, -1);
@@ -233,7 +254,7 @@ class NcclCollectiveBoxingAllGatherSubTskGphBuilder final : public SubTskGphBuil
     if (out_parallel_desc.EqualsIgnoringDeviceType(in_parallel_desc)
         && !SubTskGphBuilderUtil::BlobHasDynamicShape(logical_blob_desc)
         && SubTskGphBuilderUtil::IsDeviceTypeCPUOrCUDA(in_parallel_desc)
-        && out_parallel_desc.device_type() == DeviceType::kCUDA
+        && IsCollectiveBoxingDevice(out_parallel_desc)
         && out_parallel_desc.parallel_num() > 1 && logical_blob_desc.shape().NumAxes() > 0
         && logical_blob_desc.shape().At(0) % out_parallel_desc.parallel_num() == 0
         && SubTskGphBuilderUtil::IsBoxingS2B(in_sbp_parallel, out_sbp_parallel)
@@ -244,8 +265,8 @@ class NcclCollectiveBoxingAllGatherSubTskGphBuilder final : public SubTskGphBuil
         TaskNode* in_node_proxy =
             ctx->task_graph()->GetProxyNode(in_node, lbi, out_parallel_desc, i);
         auto* collective_node = ctx->task_graph()->NewNode<CollectiveBoxingGenericTaskNode>();
-        NcclInitCollectiveNode(collective_node, out_parallel_desc, i, op_name, lbi,
-                               logical_blob_desc, OpType::kOpTypeAllGather, -1);
+        InitCollectiveNode(collective_node, out_parallel_desc, i, op_name, lbi, logical_blob_desc,
+                           OpType::kOpTypeAllGather, -1);
         ctx->task_graph()->ConnectWithLbi(in_node_proxy, collective_node, lbi);
         sorted_out_tasks->emplace_back(collective_node);
       }
@@ -295,7 +316,7 @@ class NcclCollectiveBoxingS2BNoncontinuousSubTskGphBuilder final : public SubTsk
                         out_sbp_parallel, in_parallel_desc.parallel_num());
         ctx->task_graph()->ConnectWithLbi(in_node_proxy, pack_node, lbi);
         auto* collective_node = ctx->task_graph()->NewNode<CollectiveBoxingGenericTaskNode>();
-        NcclInitCollectiveNode(
+        InitCollectiveNode(
             collective_node, out_parallel_desc, i, op_name, lbi,
             BlobDesc({logical_blob_desc.shape().elem_cnt()}, logical_blob_desc.data_type()),
             OpType::kOpTypeAllGather, -1);
@@ -329,8 +350,8 @@ class NcclCollectiveBoxingReduceSubTskGphBuilder final : public SubTskGphBuilder
       const BlobDesc& logical_blob_desc, const SbpParallel& in_sbp_parallel,
       const SbpParallel& out_sbp_parallel, const Shape& time_shape) const override {
     if (in_parallel_desc.parallel_num() > 1 && out_parallel_desc.parallel_num() == 1
-        && in_parallel_desc.device_type() == DeviceType::kCUDA
-        && out_parallel_desc.device_type() == DeviceType::kCUDA
+        && out_parallel_desc.device_type() == in_parallel_desc.device_type()
+        && IsCollectiveBoxingDevice(in_parallel_desc)
         && !SubTskGphBuilderUtil::BlobHasDynamicShape(logical_blob_desc)
         && in_sbp_parallel.has_partial_sum_parallel()) {
       const int64_t root_parallel_id = FindRootParallelId(in_parallel_desc, out_parallel_desc);
@@ -341,8 +362,8 @@ class NcclCollectiveBoxingReduceSubTskGphBuilder final : public SubTskGphBuilder
       FOR_RANGE(int64_t, i, 0, in_parallel_desc.parallel_num()) {
         TaskNode* in_node = sorted_in_tasks.at(i);
         auto* collective_node = ctx->task_graph()->NewNode<CollectiveBoxingGenericTaskNode>();
-        NcclInitCollectiveNode(collective_node, in_parallel_desc, i, op_name, lbi,
-                               logical_blob_desc, OpType::kOpTypeReduce, root_parallel_id);
+        InitCollectiveNode(collective_node, in_parallel_desc, i, op_name, lbi, logical_blob_desc,
+                           OpType::kOpTypeReduce, root_parallel_id);
         ctx->task_graph()->ConnectWithLbi(in_node, collective_node, lbi);
         if (i == root_parallel_id) {
           sorted_out_tasks->emplace_back(collective_node);
@@ -403,8 +424,8 @@ class CollectiveBoxingScatterThenNcclAllGatherSubTskGphBuilder final : public Su
             ctx->task_graph()->GetProxyNode(slice_node, lbi, out_parallel_desc, out_id);
         // allgather
         auto* collective_node = ctx->task_graph()->NewNode<CollectiveBoxingGenericTaskNode>();
-        NcclInitCollectiveNode(collective_node, out_parallel_desc, out_id, op_name, lbi,
-                               logical_blob_desc, OpType::kOpTypeAllGather, -1);
+        InitCollectiveNode(collective_node, out_parallel_desc, out_id, op_name, lbi,
+                           logical_blob_desc, OpType::kOpTypeAllGather, -1);
         ctx->task_graph()->ConnectWithLbi(slice_node_proxy, collective_node, lbi);
         sorted_out_tasks->emplace_back(collective_node);
       }
@@ -430,24 +451,24 @@ class NcclCollectiveBoxingBroadcastSubTskGphBuilder final : public SubTskGphBuil
       const BlobDesc& logical_blob_desc, const SbpParallel& in_sbp_parallel,
       const SbpParallel& out_sbp_parallel, const Shape& time_shape) const override {
     if (in_parallel_desc.parallel_num() == 1 && out_parallel_desc.parallel_num() > 1
-        && (in_parallel_desc.device_type() == DeviceType::kCUDA
+        && IsCollectiveBoxingDevice(out_parallel_desc)
+        && (in_parallel_desc.device_type() == out_parallel_desc.device_type()
             || (in_parallel_desc.device_type() == DeviceType::kCPU
+                && out_parallel_desc.device_type() == DeviceType::kCUDA
                 && logical_blob_desc.shape().elem_cnt() >= 1024))
-        && out_parallel_desc.device_type() == DeviceType::kCUDA
         && !SubTskGphBuilderUtil::BlobHasDynamicShape(logical_blob_desc)
         && out_sbp_parallel.has_broadcast_parallel()) {
       TaskNode* gpu_in_node = nullptr;
       int64_t root_parallel_id = -1;
-      if (in_parallel_desc.device_type() == DeviceType::kCPU) {
+      if (in_parallel_desc.device_type() == out_parallel_desc.device_type()) {
+        root_parallel_id = FindRootParallelId(out_parallel_desc, in_parallel_desc);
+        gpu_in_node = sorted_in_tasks.front();
+      } else if (in_parallel_desc.device_type() == DeviceType::kCPU) {
         auto* cpu_in_node = sorted_in_tasks.front();
         root_parallel_id =
             SubTskGphBuilderUtil::FindNearestSrcParallelId(out_parallel_desc, in_parallel_desc, 0);
         gpu_in_node =
             ctx->task_graph()->GetProxyNode(cpu_in_node, lbi, out_parallel_desc, root_parallel_id);
-
-      } else if (in_parallel_desc.device_type() == DeviceType::kCUDA) {
-        root_parallel_id = FindRootParallelId(out_parallel_desc, in_parallel_desc);
-        gpu_in_node = sorted_in_tasks.front();
       } else {
         return Error::BoxingNotSupportedError();
       }
@@ -456,8 +477,8 @@ class NcclCollectiveBoxingBroadcastSubTskGphBuilder final : public SubTskGphBuil
       const std::string op_name = "System-Boxing-NcclCollectiveBoxingBroadcast-" + NewUniqueId();
       FOR_RANGE(int64_t, i, 0, out_parallel_desc.parallel_num()) {
         auto* collective_node = ctx->task_graph()->NewNode<CollectiveBoxingGenericTaskNode>();
-        NcclInitCollectiveNode(collective_node, out_parallel_desc, i, op_name, lbi,
-                               logical_blob_desc, OpType::kOpTypeBroadcast, root_parallel_id);
+        InitCollectiveNode(collective_node, out_parallel_desc, i, op_name, lbi, logical_blob_desc,
+                           OpType::kOpTypeBroadcast, root_parallel_id);
         if (i == root_parallel_id) {
           ctx->task_graph()->ConnectWithLbi(gpu_in_node, collective_node, lbi);
         } else {
@@ -516,8 +537,8 @@ class NcclCollectiveBoxingAll2AllSubTskGphBuilder final : public SubTskGphBuilde
         ctx->task_graph()->ConnectWithLbi(in_node, pack_node, lbi);
 
         auto* collective_node = ctx->task_graph()->NewNode<CollectiveBoxingGenericTaskNode>();
-        NcclInitCollectiveNode(collective_node, out_parallel_desc, i, op_name, lbi,
-                               logical_blob_desc, OpType::kOpTypeAll2All, -1);
+        InitCollectiveNode(collective_node, out_parallel_desc, i, op_name, lbi, logical_blob_desc,
+                           OpType::kOpTypeAll2All, -1);
         ctx->task_graph()->ConnectWithLbi(pack_node, collective_node, lbi);
 
         CollectiveBoxingUnpackTaskNode* unpack_node =
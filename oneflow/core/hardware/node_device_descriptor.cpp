@@ -69,6 +69,20 @@ class DummyTopologyDescriptor : public TopologyDescriptor {
     return std::make_shared<const DummyMemoryAffinityDescriptor>();
   }
 
+  size_t NumaNodeCount() const override { return 0; }
+
+  std::vector<int64_t> GetNumaNodesOfProcessCPUBinding() const override { return {}; }
+
+  std::shared_ptr<const TopologyCPUAffinityDescriptor> GetCPUAffinityByNumaNode(
+      int64_t numa_node) const override {
+    return std::make_shared<const DummyCPUAffinityDescriptor>();
+  }
+
+  std::shared_ptr<const TopologyMemoryAffinityDescriptor> GetMemoryAffinityByNumaNode(
+      int64_t numa_node) const override {
+    return std::make_shared<const DummyMemoryAffinityDescriptor>();
+  }
+
   void SetCPUAffinity(
       const std::shared_ptr<const TopologyCPUAffinityDescriptor>& affinity) const override {}
 
@@ -144,6 +158,43 @@ class HWLocTopologyDescriptor : public TopologyDescriptor {
         hwloc_bitmap_dup(non_io_ancestor->cpuset), HWLOC_MEMBIND_BIND);
   }
 
+  size_t NumaNodeCount() const override {
+    const int count = hwloc_get_nbobjs_by_type(topology_, HWLOC_OBJ_NUMANODE);
+    return count > 0 ? static_cast<size_t>(count) : 0;
+  }
+
+  std::vector<int64_t> GetNumaNodesOfProcessCPUBinding() const override {
+    std::vector<int64_t> numa_nodes;
+    hwloc_bitmap_t set = hwloc_bitmap_alloc();
+    if (hwloc_get_cpubind(topology_, set, HWLOC_CPUBIND_PROCESS) == 0) {
+      const int64_t numa_node_count = NumaNodeCount();
+      for (int64_t i = 0; i < numa_node_count; ++i) {
+        hwloc_obj_t node = GetNumaNodeObj(i);
+        if (node == nullptr || node->cpuset == nullptr) { continue; }
+        if (hwloc_bitmap_intersects(node->cpuset, set)) { numa_nodes.push_back(i); }
+      }
+    }
+    hwloc_bitmap_free(set);
+    return numa_nodes;
+  }
+
+  std::shared_ptr<const TopologyCPUAffinityDescriptor> GetCPUAffinityByNumaNode(
+      int64_t numa_node) const override {
+    hwloc_obj_t node = GetNumaNodeObj(numa_node);
+    if (node == nullptr) { return nullptr; }
+    if (node->cpuset == nullptr) { return nullptr; }
+    return std::make_shared<const HWLocCPUAffinityDescriptor>(hwloc_bitmap_dup(node->cpuset));
+  }
+
+  std::shared_ptr<const TopologyMemoryAffinityDescriptor> GetMemoryAffinityByNumaNode(
+      int64_t numa_node) const override {
+    hwloc_obj_t node = GetNumaNodeObj(numa_node);
+    if (node == nullptr) { return nullptr; }
+    if (node->cpuset == nullptr) { return nullptr; }
+    return std::make_shared<const HWLocMemoryAffinityDescriptor>(hwloc_bitmap_dup(node->cpuset),
+                                                                 HWLOC_MEMBIND_BIND);
+  }
+
   void SetCPUAffinity(
       const std::shared_ptr<const TopologyCPUAffinityDescriptor>& affinity) const override {
     auto hwloc_affinity = std::dynamic_pointer_cast<const HWLocCPUAffinityDescriptor>(affinity);
@@ -206,6 +257,11 @@ class HWLocTopologyDescriptor : public TopologyDescriptor {
     return non_io_ancestor;
   }
 
+  hwloc_obj_t GetNumaNodeObj(int64_t numa_node) const {
+    if (numa_node < 0) { return nullptr; }
+    return hwloc_get_obj_by_type(topology_, HWLOC_OBJ_NUMANODE, static_cast<unsigned>(numa_node));
+  }
+
   explicit HWLocTopologyDescriptor(hwloc_topology_t topology) : topology_(topology) {}
   hwloc_topology_t topology_{};
 };
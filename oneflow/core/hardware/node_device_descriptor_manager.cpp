@@ -45,12 +45,17 @@ NodeDeviceDescriptorManager::NodeDeviceDescriptorManager() {
     local->Serialize(&serialized_local_node);
     Singleton<CtrlClient>::Get()->PushKV(MakeNodeDeviceDescriptorRpcKey(impl_->rank),
                                          serialized_local_node);
+    std::vector<int64_t> ranks;
+    std::vector<std::string> keys;
     for (int64_t i = 0; i < impl_->nodes.size(); ++i) {
       if (i == impl_->rank) { continue; }
-      Singleton<CtrlClient>::Get()->PullKV(
-          MakeNodeDeviceDescriptorRpcKey(i), [&](const std::string& serialized) {
-            impl_->nodes.at(i) = NodeDeviceDescriptor::Deserialize(serialized);
-          });
+      ranks.emplace_back(i);
+      keys.emplace_back(MakeNodeDeviceDescriptorRpcKey(i));
+    }
+    std::vector<std::string> serialized_nodes;
+    Singleton<CtrlClient>::Get()->PullKVs(keys, &serialized_nodes);
+    for (size_t i = 0; i < ranks.size(); ++i) {
+      impl_->nodes.at(ranks.at(i)) = NodeDeviceDescriptor::Deserialize(serialized_nodes.at(i));
     }
   }
 }
@@ -28,6 +28,14 @@ void TopologyDescriptor::SetMemoryAffinityByPCIBusID(const std::string& bus_id)
   SetMemoryAffinity(GetMemoryAffinityByPCIBusID(bus_id));
 }
 
+void TopologyDescriptor::SetCPUAffinityByNumaNode(int64_t numa_node) const {
+  SetCPUAffinity(GetCPUAffinityByNumaNode(numa_node));
+}
+
+void TopologyDescriptor::SetMemoryAffinityByNumaNode(int64_t numa_node) const {
+  SetMemoryAffinity(GetMemoryAffinityByNumaNode(numa_node));
+}
+
 }  // namespace hardware
 
 }  // namespace oneflow
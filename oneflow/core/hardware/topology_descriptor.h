@@ -18,6 +18,7 @@ limitations under the License.
 
 #include <string>
 #include <memory>
+#include <vector>
 #include "oneflow/core/common/util.h"
 
 namespace oneflow {
@@ -50,12 +51,22 @@ class TopologyDescriptor {
       const std::string& bus_id) const = 0;
   virtual std::shared_ptr<const TopologyMemoryAffinityDescriptor> GetMemoryAffinityByPCIBusID(
       const std::string& bus_id) const = 0;
+  virtual size_t NumaNodeCount() const = 0;
+  // The numa nodes holding at least one cpu this process may run on, after its cpu affinity and
+  // cgroup cpuset.
+  virtual std::vector<int64_t> GetNumaNodesOfProcessCPUBinding() const = 0;
+  virtual std::shared_ptr<const TopologyCPUAffinityDescriptor> GetCPUAffinityByNumaNode(
+      int64_t numa_node) const = 0;
+  virtual std::shared_ptr<const TopologyMemoryAffinityDescriptor> GetMemoryAffinityByNumaNode(
+      int64_t numa_node) const = 0;
   virtual void SetCPUAffinity(
       const std::shared_ptr<const TopologyCPUAffinityDescriptor>& affinity) const = 0;
   virtual void SetMemoryAffinity(
       const std::shared_ptr<const TopologyMemoryAffinityDescriptor>& affinity) const = 0;
   virtual void SetCPUAffinityByPCIBusID(const std::string& bus_id) const;
   virtual void SetMemoryAffinityByPCIBusID(const std::string& bus_id) const;
+  virtual void SetCPUAffinityByNumaNode(int64_t numa_node) const;
+  virtual void SetMemoryAffinityByNumaNode(int64_t numa_node) const;
 };
 
 }  // namespace hardware
@@ -0,0 +1,357 @@
+/*
+Copyright 2020 The OneFlow Authors. All rights reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+#include "oneflow/core/job/collective_boxing/cpu_executor_backend.h"
+#include "oneflow/core/job/collective_boxing/request_store.h"
+#include "oneflow/core/graph/boxing/collective_boxing_util.h"
+#include "oneflow/core/job/resource_desc.h"
+#include "oneflow/core/job/global_for.h"
+#include "oneflow/core/job/parallel_desc.h"
+#include "oneflow/core/control/global_process_ctx.h"
+#include "oneflow/core/common/channel.h"
+#include "oneflow/core/thread/thread_global_id.h"
+#include "oneflow/user/kernels/collective_communication/include/communication_context.h"
+#include "oneflow/user/kernels/collective_communication/include/all_reduce.h"
+#include "oneflow/user/kernels/collective_communication/include/all_gather.h"
+#include "oneflow/user/kernels/collective_communication/include/reduce_scatter.h"
+#include "oneflow/user/kernels/collective_communication/include/reduce.h"
+#include "oneflow/user/kernels/collective_communication/include/broadcast.h"
+
+#include <cstring>
+#include <memory>
+#include <thread>
+#include <utility>
+
+namespace oneflow {
+
+namespace boxing {
+
+namespace collective {
+
+namespace {
+
+ccl::ReduceType GetCclReduceType(ReduceMethod reduce_method) {
+  if (reduce_method == kReduceMethodSum) {
+    return ccl::kSum;
+  } else {
+    UNIMPLEMENTED();
+    return ccl::kInvalidReduceFunctorType;
+  }
+}
+
+Symbol<ParallelDesc> GetCpuParallelDesc(const DeviceSet& device_set) {
+  ParallelConf parallel_conf;
+  parallel_conf.set_device_tag("cpu");
+  for (const DeviceDesc& device : device_set.device()) {
+    CHECK_EQ(device.device_type(), DeviceType::kCPU);
+    const int64_t machine_id = device.machine_id();
+    parallel_conf.add_device_name("@" + std::to_string(machine_id) + ":"
+                                  + std::to_string(GlobalProcessCtx::LocalRank(machine_id)));
+  }
+  Symbol<ParallelDesc> parallel_desc = SymbolOf(ParallelDesc(parallel_conf));
+  // Roots and shards of a request are addressed by their index in the device set, so the
+  // placement has to enumerate the ranks in the same order.
+  CHECK_EQ(parallel_desc->parallel_num(), device_set.device_size());
+  for (int64_t i = 0; i < device_set.device_size(); ++i) {
+    CHECK_EQ(CHECK_JUST(parallel_desc->MachineId4ParallelId(i)),
+             device_set.device(i).machine_id());
+  }
+  return parallel_desc;
+}
+
+class CommThread final {
+ public:
+  OF_DISALLOW_COPY_AND_MOVE(CommThread);
+  explicit CommThread(int64_t thread_global_id) {
+    thread_ = std::thread([this, thread_global_id]() {
+      // Transport tokens of the collective primitives are keyed by the thread global id, so
+      // every comm thread needs its own one, assigned identically on all ranks.
+      ThreadGlobalIdGuard guard(thread_global_id);
+      std::function<void()> work;
+      while (work_chan_.Receive(&work) == kChannelStatusSuccess) { work(); }
+    });
+  }
+  ~CommThread() {
+    work_chan_.Close();
+    thread_.join();
+  }
+
+  void Enqueue(std::function<void()>&& work) {
+    CHECK_EQ(work_chan_.Send(std::move(work)), kChannelStatusSuccess);
+  }
+
+  // Only touched from the comm thread itself.
+  std::vector<char>* mut_fusion_buffer() { return &fusion_buffer_; }
+
+ private:
+  Channel<std::function<void()>> work_chan_;
+  std::vector<char> fusion_buffer_;
+  std::thread thread_;
+};
+
+void LaunchRequest(const RequestEntry* request_entry, const RuntimeRequestInfo& runtime_info,
+                   const std::shared_ptr<ccl::CommunicationContext>& comm_ctx) {
+  const OpDesc& op_desc = request_entry->desc().op_desc();
+  const DeviceSet& device_set = request_entry->desc().device_set();
+  const OpType op_type = op_desc.op_type();
+  const DataType data_type = op_desc.data_type();
+  const int64_t elem_cnt = request_entry->elem_cnt();
+  const int64_t num_ranks = op_desc.num_ranks();
+  if (op_type == OpType::kOpTypeAllReduce) {
+    std::unique_ptr<ccl::AllReduce> all_reduce = ccl::NewCollectiveCommunication<ccl::AllReduce>(
+        DeviceType::kCPU, data_type, GetCclReduceType(op_desc.reduce_method()));
+    all_reduce->Launch(nullptr, runtime_info.send_buff, runtime_info.recv_buff, elem_cnt,
+                       comm_ctx);
+  } else if (op_type == OpType::kOpTypeAllGather) {
+    CHECK_EQ(elem_cnt % num_ranks, 0);
+    std::unique_ptr<ccl::AllGather> all_gather =
+        ccl::NewCollectiveCommunication<ccl::AllGather>(DeviceType::kCPU, data_type);
+    all_gather->Launch(nullptr, runtime_info.send_buff, runtime_info.recv_buff,
+                       elem_cnt / num_ranks, comm_ctx);
+  } else if (op_type == OpType::kOpTypeReduceScatter) {
+    CHECK_EQ(elem_cnt % num_ranks, 0);
+    std::unique_ptr<ccl::ReduceScatter> reduce_scatter =
+        ccl::NewCollectiveCommunication<ccl::ReduceScatter>(
+            DeviceType::kCPU, data_type, GetCclReduceType(op_desc.reduce_method()));
+    reduce_scatter->Launch(nullptr, runtime_info.send_buff, runtime_info.recv_buff,
+                           elem_cnt / num_ranks, comm_ctx);
+  } else if (op_type == OpType::kOpTypeReduce) {
+    const int64_t root = device_set.device(op_desc.root()).machine_id();
+    std::unique_ptr<ccl::Reduce> reduce = ccl::NewCollectiveCommunication<ccl::Reduce>(
+        DeviceType::kCPU, data_type, GetCclReduceType(op_desc.reduce_method()));
+    reduce->Launch(nullptr, runtime_info.send_buff, runtime_info.recv_buff, elem_cnt, root,
+                   comm_ctx);
+  } else if (op_type == OpType::kOpTypeBroadcast) {
+    const int64_t root = device_set.device(op_desc.root()).machine_id();
+    std::unique_ptr<ccl::Broadcast> broadcast =
+        ccl::NewCollectiveCommunication<ccl::Broadcast>(DeviceType::kCPU, data_type);
+    broadcast->Launch(nullptr, runtime_info.send_buff, runtime_info.recv_buff, elem_cnt, root,
+                      comm_ctx);
+  } else {
+    UNIMPLEMENTED() << OpType_Name(op_type) << " is not supported by the cpu backend";
+  }
+}
+
+void LaunchFusedAllReduce(const std::vector<const RequestEntry*>& request_entries,
+                          const std::vector<std::shared_ptr<const RuntimeRequestInfo>>& infos,
+                          const std::shared_ptr<ccl::CommunicationContext>& comm_ctx,
+                          std::vector<char>* fusion_buffer) {
+  const OpDesc& first_op_desc = request_entries.front()->desc().op_desc();
+  int64_t total_size = 0;
+  int64_t total_elem_cnt = 0;
+  for (const RequestEntry* request_entry : request_entries) {
+    total_size += request_entry->size_in_bytes();
+    total_elem_cnt += request_entry->elem_cnt();
+  }
+  if (fusion_buffer->size() < total_size) { fusion_buffer->resize(total_size); }
+  char* buffer = fusion_buffer->data();
+  int64_t offset = 0;
+  for (int64_t i = 0; i < request_entries.size(); ++i) {
+    const int64_t size = request_entries.at(i)->size_in_bytes();
+    std::memcpy(buffer + offset, infos.at(i)->send_buff, size);
+    offset += size;
+  }
+  std::unique_ptr<ccl::AllReduce> all_reduce = ccl::NewCollectiveCommunication<ccl::AllReduce>(
+      DeviceType::kCPU, first_op_desc.data_type(),
+      GetCclReduceType(first_op_desc.reduce_method()));
+  all_reduce->Launch(nullptr, buffer, buffer, total_elem_cnt, comm_ctx);
+  offset = 0;
+  for (int64_t i = 0; i < request_entries.size(); ++i) {
+    const int64_t size = request_entries.at(i)->size_in_bytes();
+    std::memcpy(infos.at(i)->recv_buff, buffer + offset, size);
+    offset += size;
+  }
+}
+
+}  // namespace
+
+struct CpuExecutorBackend::Impl {
+  Impl(const CollectiveBoxingConf& conf, std::shared_ptr<RequestStore> request_store)
+      : conf(conf), request_store(std::move(request_store)) {
+    CHECK_GT(conf.cpu_num_threads(), 0);
+    CHECK_GE(conf.cpu_fusion_threshold_mb(), 0);
+    CHECK_GT(conf.cpu_fusion_max_ops(), 0);
+    fusion_threshold = conf.cpu_fusion_threshold_mb() * 1024 * 1024;
+    const int64_t num_threads = std::min<int64_t>(
+        conf.cpu_num_threads(),
+        kThreadGlobalIdGradientCompression - kThreadGlobalIdCpuCollectiveBoxingBegin);
+    for (int64_t i = 0; i < num_threads; ++i) {
+      comm_threads.emplace_back(
+          std::make_unique<CommThread>(kThreadGlobalIdCpuCollectiveBoxingBegin + i));
+    }
+  }
+  ~Impl() {
+    comm_threads.clear();
+    device_set2comm_ctx.clear();
+  }
+
+  void InitCommCtx(int64_t job_id) {
+    request_store->ForEachMutRequestEntryInJob(
+        job_id, [&](RequestEntry* request_entry, int32_t i, const RequestId& request_id) {
+          const auto& request = request_entry->desc();
+          if (request.op_desc().backend() != Backend::kBackendCPU) { return; }
+          if (!request_entry->HasRankOnThisNode()) { return; }
+          CHECK_EQ(request_entry->LocalRankCount(), 1)
+              << "the cpu backend expects one rank per process in a device set";
+          const DeviceSet& device_set = request.device_set();
+          if (device_set2comm_ctx.count(device_set) > 0) { return; }
+          device_set2comm_ctx.emplace(
+              device_set,
+              ccl::NewCommunicationContext(DeviceType::kCPU, GetCpuParallelDesc(device_set)));
+        });
+  }
+
+  bool CanRequestEntryFuse(const RequestEntry* lhs, const RequestEntry* rhs) const {
+    if (!conf.cpu_fusion_all_reduce()) { return false; }
+    if (lhs->device_set_symbol() != rhs->device_set_symbol()) { return false; }
+    const OpDesc& lhs_op_desc = lhs->desc().op_desc();
+    const OpDesc& rhs_op_desc = rhs->desc().op_desc();
+    if (lhs_op_desc.op_type() != OpType::kOpTypeAllReduce
+        || rhs_op_desc.op_type() != OpType::kOpTypeAllReduce) {
+      return false;
+    }
+    CHECK(lhs_op_desc.has_reduce_method());
+    CHECK(rhs_op_desc.has_reduce_method());
+    return lhs_op_desc.reduce_method() == rhs_op_desc.reduce_method()
+           && lhs_op_desc.data_type() == rhs_op_desc.data_type();
+  }
+
+  void GroupRequests(const std::vector<RequestId>& request_ids,
+                     const std::function<void(std::vector<RequestId>&&, void*)>& Handler) {
+    std::vector<RequestId> group;
+    int64_t group_size = 0;
+    const int64_t fusion_max_ops = conf.cpu_fusion_max_ops();
+    request_store->ForEachMutRequestEntryForIdsInJob(
+        request_ids, [&](RequestEntry* request_entry, int32_t i, const RequestId& request_id) {
+          const int64_t size = request_entry->size_in_bytes();
+          if (group.empty()
+              || !CanRequestEntryFuse(request_store->MutRequestEntry(group.back()), request_entry)
+              || group_size + size > fusion_threshold || group.size() >= fusion_max_ops) {
+            if (!group.empty()) {
+              void* token = CreateGroupToken(group);
+              Handler(std::move(group), token);
+              group.clear();
+              group_size = 0;
+            }
+          }
+          group.emplace_back(request_id);
+          group_size += size;
+        });
+    if (!group.empty()) {
+      void* token = CreateGroupToken(group);
+      Handler(std::move(group), token);
+    }
+  }
+
+  struct GroupToken {
+    GroupToken(const std::vector<RequestId>& group,
+               std::shared_ptr<ccl::CommunicationContext> comm_ctx, CommThread* comm_thread)
+        : request_ids(group), comm_ctx(std::move(comm_ctx)), comm_thread(comm_thread) {}
+    std::vector<RequestId> request_ids;
+    std::shared_ptr<ccl::CommunicationContext> comm_ctx;
+    CommThread* comm_thread;
+  };
+
+  void* CreateGroupToken(const std::vector<RequestId>& group) {
+    CHECK_GT(group.size(), 0);
+    const DeviceSet& first_device_set =
+        request_store->MutRequestEntry(group.front())->desc().device_set();
+    auto it = device_set2comm_ctx.find(first_device_set);
+    CHECK(it != device_set2comm_ctx.end());
+    request_store->ForEachMutRequestEntryForIdsInJob(
+        group, [&](RequestEntry* request_entry, int32_t i, const RequestId& request_id) {
+          CHECK(first_device_set == request_entry->desc().device_set());
+        });
+    // Groups of one device set always go to the same comm thread: the shared memory arena and
+    // the transport tokens are keyed by the thread global id of the comm thread, so they are
+    // never shared with eager collectives or other comm threads, but they still require the
+    // collectives on them to be issued in the same order on every rank, which the static
+    // coordinator guarantees only as long as they are not reordered across threads.
+    const size_t thread_idx = std::hash<DeviceSet>()(first_device_set) % comm_threads.size();
+    return new GroupToken(group, it->second, comm_threads.at(thread_idx).get());
+  }
+
+  void DestroyGroupToken(void* group_token) {
+    GroupToken* token = static_cast<GroupToken*>(group_token);
+    delete token;
+  }
+
+  void ExecuteGroup(void* group_token) {
+    GroupToken* token = static_cast<GroupToken*>(group_token);
+    const std::vector<RequestId>& request_ids = token->request_ids;
+    if (request_ids.empty()) { return; }
+    std::vector<const RequestEntry*> request_entries(request_ids.size());
+    std::vector<std::shared_ptr<const RuntimeRequestInfo>> infos(request_ids.size());
+    request_store->ForEachMutRequestEntryForIdsInJob(
+        request_ids, [&](RequestEntry* request_entry, int32_t i, const RequestId& request_id) {
+          request_entries.at(i) = request_entry;
+          infos.at(i) = std::move(request_entry->ResetRuntimeRequest().at(0));
+        });
+    CommThread* comm_thread = token->comm_thread;
+    std::shared_ptr<ccl::CommunicationContext> comm_ctx = token->comm_ctx;
+    comm_thread->Enqueue([comm_thread, comm_ctx, request_entries = std::move(request_entries),
+                          infos = std::move(infos)]() {
+      if (request_entries.size() > 1) {
+        LaunchFusedAllReduce(request_entries, infos, comm_ctx, comm_thread->mut_fusion_buffer());
+      } else {
+        LaunchRequest(request_entries.front(), *infos.front(), comm_ctx);
+      }
+      for (const auto& runtime_request_info : infos) {
+        runtime_request_info->callback(Maybe<void>::Ok());
+      }
+    });
+  }
+
+  CollectiveBoxingConf conf;
+  int64_t fusion_threshold;
+  std::shared_ptr<RequestStore> request_store;
+  HashMap<DeviceSet, std::shared_ptr<ccl::CommunicationContext>> device_set2comm_ctx;
+  std::vector<std::unique_ptr<CommThread>> comm_threads;
+};
+
+CpuExecutorBackend::CpuExecutorBackend() = default;
+
+CpuExecutorBackend::~CpuExecutorBackend() = default;
+
+void CpuExecutorBackend::Init(std::shared_ptr<RequestStore> request_store) {
+  impl_ = std::make_unique<Impl>(
+      Singleton<ResourceDesc, ForSession>::Get()->collective_boxing_conf(), request_store);
+}
+
+void CpuExecutorBackend::InitJob(int64_t job_id) { impl_->InitCommCtx(job_id); }
+
+void CpuExecutorBackend::DeinitJob(int64_t job_id) {}
+
+void CpuExecutorBackend::GroupRequests(
+    const std::vector<RequestId>& request_ids,
+    const std::function<void(std::vector<RequestId>&&, void*)>& Handler) {
+  impl_->GroupRequests(request_ids, Handler);
+}
+
+void* CpuExecutorBackend::CreateGroupToken(const std::vector<RequestId>& group) {
+  return impl_->CreateGroupToken(group);
+}
+
+void CpuExecutorBackend::DestroyGroupToken(void* group_token) {
+  return impl_->DestroyGroupToken(group_token);
+}
+
+void CpuExecutorBackend::ExecuteGroup(void* group_token) { impl_->ExecuteGroup(group_token); }
+
+}  // namespace collective
+
+}  // namespace boxing
+
+}  // namespace oneflow
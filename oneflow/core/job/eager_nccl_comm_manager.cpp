@@ -21,6 +21,7 @@ limitations under the License.
 #include "oneflow/core/device/nccl_util.h"
 #include "oneflow/core/job/id_manager.h"
 #include "oneflow/core/job/parallel_desc.h"
+#include "oneflow/core/job/plan_util.h"
 #include "oneflow/core/operator/op_conf.pb.h"
 #include "oneflow/core/vm/vm_util.h"
 
@@ -164,7 +165,8 @@ void EagerNcclCommMgr::CreateCommFromPlan(const Plan& plan) {
   for (const auto& task_proto : plan.task()) {
     if (task_proto.machine_id() != rank) { continue; }
     if (task_proto.exec_sequence().exec_node_size() != 1) { continue; }
-    const auto& kernel_conf = task_proto.exec_sequence().exec_node(0).kernel_conf();
+    const auto& kernel_conf =
+        PlanUtil::GetKernelConf(plan, task_proto.exec_sequence().exec_node(0));
     const OpAttribute* op_attr = nullptr;
     if (kernel_conf.has_op_attribute()) {
       op_attr = &kernel_conf.op_attribute();
@@ -1004,6 +1004,7 @@ Maybe<void> LazyJobBuildAndInferCtx::Complete() {
     JUST(DoPass("AutoTrainStep"));
     JUST(DoPass("AutoLearningRate"));
     JUST(DoPass("QuantAwareTraining"));
+    JUST(DoPass("QuantizedLinearRewritePass"));
     JUST(DoPass("GenerateOptimizerOpConfs"));
     // pinned identity can be pruned since GenerateOptimizerOpConfs pass has
     // already construct a complete computational graph
@@ -159,10 +159,25 @@ void PullPlan(const std::string& plan_name, Plan* plan) {
   auto thrd_ids_it = machine_id2thrd_ids.find(machine_id);
   CHECK(thrd_ids_it != machine_id2thrd_ids.end());
   std::vector<int64_t> thrd_id_vec = PbRf2StdVec(thrd_ids_it->second.thrd_id());
+  std::vector<std::string> sub_plan_keys;
+  sub_plan_keys.reserve(thrd_id_vec.size());
   for (auto thrd_id : thrd_id_vec) {
-    SubPlan sub_plan;
-    Singleton<CtrlClient>::Get()->PullKV(sub_plan_key(plan_name, machine_id, thrd_id), &sub_plan);
-    plan->mutable_task()->MergeFrom(sub_plan.task());
+    sub_plan_keys.emplace_back(sub_plan_key(plan_name, machine_id, thrd_id));
+  }
+  // NOTE: A PullKVs response carries all the values of its keys on one server in one protobuf
+  // message, which must stay below 2GB, so the sub-plans are pulled a few at a time.
+  const size_t kSubPlanPullBatchSize = 8;
+  for (size_t begin = 0; begin < sub_plan_keys.size(); begin += kSubPlanPullBatchSize) {
+    const size_t end = std::min(begin + kSubPlanPullBatchSize, sub_plan_keys.size());
+    std::vector<std::string> serialized_sub_plans;
+    Singleton<CtrlClient>::Get()->PullKVs(
+        std::vector<std::string>(sub_plan_keys.begin() + begin, sub_plan_keys.begin() + end),
+        &serialized_sub_plans);
+    for (const std::string& serialized_sub_plan : serialized_sub_plans) {
+      SubPlan sub_plan;
+      CHECK(sub_plan.ParseFromString(serialized_sub_plan));
+      plan->mutable_task()->MergeFrom(sub_plan.task());
+    }
   }
   CtrlRegstDescInfo ctrl_regst_desc_info;
   Singleton<CtrlClient>::Get()->PullKV(ctrl_regst_desc_info_key(plan_name), &ctrl_regst_desc_info);
@@ -13,6 +13,11 @@ WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
 See the License for the specific language governing permissions and
 limitations under the License.
 */
+#ifdef WITH_ZLIB
+#include <zlib.h>
+#endif  // WITH_ZLIB
+#include <google/protobuf/io/coded_stream.h>
+#include <google/protobuf/io/zero_copy_stream_impl_lite.h>
 #include "oneflow/core/common/constant.h"
 #include "oneflow/core/common/str_util.h"
 #include "oneflow/core/common/env_var/debug_mode.h"
@@ -1377,6 +1382,143 @@ void PlanUtil::PopulateOpAttribute(
   }
 }
 
+const KernelConf& PlanUtil::GetKernelConf(const Plan& plan, const ExecNodeProto& exec_node) {
+  if (exec_node.has_kernel_conf_ref()) {
+    CHECK_LT(exec_node.kernel_conf_ref(), plan.kernel_conf_table_size());
+    return plan.kernel_conf_table(exec_node.kernel_conf_ref());
+  }
+  return exec_node.kernel_conf();
+}
+
+namespace {
+
+// Map fields are serialized in a random order by default
+std::string DeterministicSerialize(const PbMessage& msg) {
+  std::string serialized;
+  {
+    google::protobuf::io::StringOutputStream string_stream(&serialized);
+    google::protobuf::io::CodedOutputStream coded_stream(&string_stream);
+    coded_stream.SetSerializationDeterministic(true);
+    CHECK(msg.SerializeToCodedStream(&coded_stream));
+  }
+  return serialized;
+}
+
+}  // namespace
+
+void PlanUtil::GenCompactPlan4Rank(const Plan& plan, int64_t rank, Plan* compact_plan) {
+  compact_plan->Clear();
+  *compact_plan->mutable_job_confs() = plan.job_confs();
+  *compact_plan->mutable_collective_boxing_plan() = plan.collective_boxing_plan();
+  *compact_plan->mutable_ctrl_regst_desc_info() = plan.ctrl_regst_desc_info();
+  auto* block_chunk_list = compact_plan->mutable_block_chunk_list();
+  for (const MemBlockProto& mem_block : plan.block_chunk_list().mem_block()) {
+    if (mem_block.machine_id() == rank) { *block_chunk_list->add_mem_block() = mem_block; }
+  }
+  for (const ChunkProto& chunk : plan.block_chunk_list().chunk()) {
+    if (chunk.machine_id() == rank) { *block_chunk_list->add_chunk() = chunk; }
+  }
+  // The tasks of an op on different devices only differ in the parallel context
+  HashMap<std::string, int64_t> serialized_kernel_conf2ref;
+  HashMap<int64_t, HashSet<std::string>> job_id2op_names;
+  for (const TaskProto& task : plan.task()) {
+    if (task.machine_id() != rank) { continue; }
+    TaskProto* compact_task = compact_plan->add_task();
+    *compact_task = task;
+    for (ExecNodeProto& exec_node : *compact_task->mutable_exec_sequence()->mutable_exec_node()) {
+      CHECK(exec_node.has_kernel_conf()) << "plan is already compact";
+      KernelConf* kernel_conf = exec_node.mutable_kernel_conf();
+      if (kernel_conf->has_op_attribute_ref()) {
+        job_id2op_names[task.job_id()].insert(kernel_conf->op_attribute_ref());
+      }
+      if (kernel_conf->has_parallel_ctx()) {
+        exec_node.mutable_parallel_ctx()->Swap(kernel_conf->mutable_parallel_ctx());
+        kernel_conf->clear_parallel_ctx();
+      }
+      std::string serialized_kernel_conf = DeterministicSerialize(*kernel_conf);
+      auto it = serialized_kernel_conf2ref.find(serialized_kernel_conf);
+      if (it == serialized_kernel_conf2ref.end()) {
+        it = serialized_kernel_conf2ref
+                 .emplace(std::move(serialized_kernel_conf), compact_plan->kernel_conf_table_size())
+                 .first;
+        compact_plan->add_kernel_conf_table()->Swap(kernel_conf);
+      }
+      exec_node.clear_kernel_conf();
+      exec_node.set_kernel_conf_ref(it->second);
+    }
+  }
+  for (const auto& pair : plan.job_id2op_attribute_ref_table()) {
+    const auto& op_names = job_id2op_names[pair.first];
+    auto* op_name2op_attribute =
+        (*compact_plan->mutable_job_id2op_attribute_ref_table())[pair.first]
+            .mutable_op_name2op_attribute();
+    for (const auto& name7op_attribute : pair.second.op_name2op_attribute()) {
+      // NOTE: every rank looks up the variables in the table to create their tensors.
+      if (op_names.count(name7op_attribute.first) > 0
+          || name7op_attribute.second.op_conf().has_variable_conf()) {
+        (*op_name2op_attribute)[name7op_attribute.first] = name7op_attribute.second;
+      }
+    }
+  }
+}
+
+void PlanUtil::MaterializeTask(const Plan& plan, const TaskProto& task, TaskProto* materialized) {
+  *materialized = task;
+  for (ExecNodeProto& exec_node : *materialized->mutable_exec_sequence()->mutable_exec_node()) {
+    KernelConf* kernel_conf = exec_node.mutable_kernel_conf();
+    if (exec_node.has_kernel_conf_ref()) {
+      *kernel_conf = GetKernelConf(plan, exec_node);
+      if (exec_node.has_parallel_ctx()) {
+        kernel_conf->mutable_parallel_ctx()->Swap(exec_node.mutable_parallel_ctx());
+      }
+      exec_node.clear_kernel_conf_ref();
+      exec_node.clear_parallel_ctx();
+    }
+    if (kernel_conf->has_op_attribute_ref()) {
+      *kernel_conf->mutable_op_attribute() =
+          GetOpAttribute(&plan, materialized->job_id(), *kernel_conf);
+      kernel_conf->clear_op_attribute_ref();
+    }
+  }
+}
+
+void PlanUtil::CompressPlan(const Plan& plan, std::string* compressed_plan) {
+#ifdef WITH_ZLIB
+  std::string serialized_plan = plan.SerializeAsString();
+  // The compressed plan starts with the size of the serialized plan
+  const uint64_t serialized_size = serialized_plan.size();
+  uLongf compressed_size = compressBound(serialized_size);
+  compressed_plan->resize(sizeof(serialized_size) + compressed_size);
+  std::memcpy(&compressed_plan->at(0), &serialized_size, sizeof(serialized_size));
+  CHECK_EQ(compress2(reinterpret_cast<Bytef*>(&compressed_plan->at(sizeof(serialized_size))),
+                     &compressed_size, reinterpret_cast<const Bytef*>(serialized_plan.data()),
+                     serialized_size, Z_BEST_SPEED),
+           Z_OK);
+  compressed_plan->resize(sizeof(serialized_size) + compressed_size);
+#else
+  CHECK(plan.SerializeToString(compressed_plan));
+#endif  // WITH_ZLIB
+}
+
+void PlanUtil::DecompressPlan(const std::string& compressed_plan, Plan* plan) {
+#ifdef WITH_ZLIB
+  uint64_t serialized_size = 0;
+  CHECK_GE(compressed_plan.size(), sizeof(serialized_size));
+  std::memcpy(&serialized_size, compressed_plan.data(), sizeof(serialized_size));
+  std::string serialized_plan(serialized_size, '\0');
+  uLongf uncompressed_size = serialized_size;
+  const char* compressed_data = compressed_plan.data() + sizeof(serialized_size);
+  CHECK_EQ(uncompress(reinterpret_cast<Bytef*>(&serialized_plan.at(0)), &uncompressed_size,
+                      reinterpret_cast<const Bytef*>(compressed_data),
+                      compressed_plan.size() - sizeof(serialized_size)),
+           Z_OK);
+  CHECK_EQ(uncompressed_size, serialized_size);
+  CHECK(plan->ParseFromString(serialized_plan));
+#else
+  CHECK(plan->ParseFromString(compressed_plan));
+#endif  // WITH_ZLIB
+}
+
 /*static*/ StreamId PlanUtil::GetStreamId(const TaskProto& task) {
   return DecodeStreamIdFromInt64(task.thrd_id());
 }
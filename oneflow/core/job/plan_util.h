@@ -48,6 +48,16 @@ struct PlanUtil {
   static void PopulateOpAttribute(
       Plan* plan,
       const PbMap<int64_t, ::oneflow::OpAttributeRefTable>& job_id2op_attribute_ref_table);
+  // Get the kernel conf of an exec node, which may refer to the kernel_conf_table of a compact
+  // plan. NOTE: the parallel context is kept by the exec node in the latter case.
+  static const KernelConf& GetKernelConf(const Plan& plan, const ExecNodeProto& exec_node);
+  // Keep the tasks and memory of rank, and move the kernel confs of the tasks into the
+  // kernel_conf_table, where the same kernel confs are stored only once.
+  static void GenCompactPlan4Rank(const Plan& plan, int64_t rank, Plan* compact_plan);
+  // Expand the kernel conf and op attribute references of a task
+  static void MaterializeTask(const Plan& plan, const TaskProto& task, TaskProto* materialized);
+  static void CompressPlan(const Plan& plan, std::string* compressed_plan);
+  static void DecompressPlan(const std::string& compressed_plan, Plan* plan);
   static StreamId GetStreamId(const TaskProto& task);
   static int64_t GetDeviceIndex(const TaskProto& task);
 };
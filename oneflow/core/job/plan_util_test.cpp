@@ -0,0 +1,112 @@
+/*
+Copyright 2020 The OneFlow Authors. All rights reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+#include "gtest/gtest.h"
+#include "oneflow/core/job/plan_util.h"
+
+namespace oneflow {
+
+namespace test {
+
+namespace {
+
+void AddTask(Plan* plan, int64_t task_id, int64_t machine_id, int64_t parallel_id,
+             const std::string& op_name) {
+  TaskProto* task = plan->add_task();
+  task->set_task_type(TaskType::kNormalForward);
+  task->set_machine_id(machine_id);
+  task->set_thrd_id(0);
+  task->set_task_id(task_id);
+  task->set_job_id(0);
+  task->mutable_task_set_info()->set_chain_id(0);
+  task->mutable_task_set_info()->set_order_in_graph(task_id);
+  KernelConf* kernel_conf = task->mutable_exec_sequence()->add_exec_node()->mutable_kernel_conf();
+  kernel_conf->set_data_type(DataType::kFloat);
+  kernel_conf->set_all_blobs_are_static(true);
+  kernel_conf->mutable_dtype_signature();
+  kernel_conf->mutable_parallel_ctx()->set_parallel_id(parallel_id);
+  kernel_conf->mutable_parallel_ctx()->set_parallel_num(4);
+  kernel_conf->set_op_attribute_ref(op_name);
+}
+
+void AddOpAttribute(Plan* plan, const std::string& op_name) {
+  OpAttribute op_attribute;
+  op_attribute.mutable_op_conf()->set_name(op_name);
+  op_attribute.mutable_arg_signature();
+  op_attribute.mutable_arg_modifier_signature();
+  (*(*plan->mutable_job_id2op_attribute_ref_table())[0].mutable_op_name2op_attribute())[op_name] =
+      op_attribute;
+}
+
+Plan NewPlan() {
+  Plan plan;
+  plan.mutable_block_chunk_list();
+  plan.mutable_job_confs();
+  plan.mutable_collective_boxing_plan();
+  plan.mutable_ctrl_regst_desc_info();
+  AddOpAttribute(&plan, "relu");
+  AddOpAttribute(&plan, "matmul");
+  // Two ranks with two devices per rank
+  for (int64_t parallel_id = 0; parallel_id < 4; ++parallel_id) {
+    AddTask(&plan, 2 * parallel_id, parallel_id / 2, parallel_id, "relu");
+    AddTask(&plan, 2 * parallel_id + 1, parallel_id / 2, parallel_id, "matmul");
+  }
+  return plan;
+}
+
+}  // namespace
+
+TEST(PlanUtil, compact_plan_dedup_kernel_conf) {
+  Plan plan = NewPlan();
+  Plan compact_plan;
+  PlanUtil::GenCompactPlan4Rank(plan, 1, &compact_plan);
+  ASSERT_EQ(compact_plan.task_size(), 4);
+  ASSERT_EQ(compact_plan.kernel_conf_table_size(), 2);
+  for (const TaskProto& task : compact_plan.task()) {
+    ASSERT_EQ(task.machine_id(), 1);
+    ASSERT_FALSE(task.exec_sequence().exec_node(0).has_kernel_conf());
+    ASSERT_TRUE(task.exec_sequence().exec_node(0).has_kernel_conf_ref());
+  }
+}
+
+TEST(PlanUtil, materialize_compact_task) {
+  Plan plan = NewPlan();
+  Plan compact_plan;
+  PlanUtil::GenCompactPlan4Rank(plan, 1, &compact_plan);
+  for (const TaskProto& task : compact_plan.task()) {
+    TaskProto materialized;
+    PlanUtil::MaterializeTask(compact_plan, task, &materialized);
+    const TaskProto& original = plan.task(materialized.task_id());
+    const KernelConf& kernel_conf = materialized.exec_sequence().exec_node(0).kernel_conf();
+    const KernelConf& original_kernel_conf = original.exec_sequence().exec_node(0).kernel_conf();
+    ASSERT_EQ(kernel_conf.parallel_ctx().parallel_id(),
+              original_kernel_conf.parallel_ctx().parallel_id());
+    ASSERT_FALSE(kernel_conf.has_op_attribute_ref());
+    ASSERT_EQ(kernel_conf.op_attribute().op_conf().name(), original_kernel_conf.op_attribute_ref());
+  }
+}
+
+TEST(PlanUtil, compress_plan) {
+  Plan plan = NewPlan();
+  std::string compressed_plan;
+  PlanUtil::CompressPlan(plan, &compressed_plan);
+  Plan decompressed_plan;
+  PlanUtil::DecompressPlan(compressed_plan, &decompressed_plan);
+  ASSERT_TRUE(google::protobuf::util::MessageDifferencer::Equals(decompressed_plan, plan));
+}
+
+}  // namespace test
+
+}  // namespace oneflow
@@ -70,6 +70,14 @@ CollectiveBoxingConf ResourceDesc::collective_boxing_conf() const {
   }
 }
 
+NumaAffinityConf ResourceDesc::numa_affinity_conf() const {
+  if (resource_.has_numa_affinity_conf()) {
+    return resource_.numa_affinity_conf();
+  } else {
+    return NumaAffinityConf();
+  }
+}
+
 bool ResourceDesc::nccl_use_compute_stream() const {
 #if defined(WITH_CUDA) && NCCL_VERSION_CODE > 2700
   return resource_.nccl_use_compute_stream();
@@ -46,6 +46,7 @@ class ResourceDesc final {
   int32_t ComputeThreadPoolSize() const;
   bool enable_debug_mode() const;
   CollectiveBoxingConf collective_boxing_conf() const;
+  NumaAffinityConf numa_affinity_conf() const;
   bool nccl_use_compute_stream() const;
 
   void SetMachineNum(int32_t val) { resource_.set_machine_num(val); }
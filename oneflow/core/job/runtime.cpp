@@ -25,6 +25,7 @@ limitations under the License.
 #include "oneflow/core/job/runtime_job_descs.h"
 #include "oneflow/core/job/eager_nccl_comm_manager.h"
 #include "oneflow/core/thread/thread_manager.h"
+#include "oneflow/core/thread/numa_affinity.h"
 #include "oneflow/core/graph/task_node.h"
 #include "oneflow/core/device/cuda_util.h"
 #include "oneflow/core/memory/memory_allocator.h"
@@ -42,9 +43,9 @@ void SendCmdMsg(const std::vector<const TaskProto*>& tasks, ActorCmd cmd) {
   }
 }
 
-void HandoutTasks(const std::vector<const TaskProto*>& tasks) {
+void HandoutTasks(const std::vector<const TaskProto*>& tasks, const Plan& plan) {
   for (const TaskProto* task : tasks) {
-    Singleton<ThreadMgr>::Get()->GetThrd(task->thrd_id())->AddTask(*task);
+    Singleton<ThreadMgr>::Get()->GetThrd(task->thrd_id())->AddTask(*task, plan);
   }
   SendCmdMsg(tasks, ActorCmd::kConstructActor);
 }
@@ -62,6 +63,9 @@ bool HasNonCtrlConsumedRegstDescId(const TaskProto& task) {
 Runtime::Runtime(
     const Plan& plan,
     const HashMap<std::string, vm::EagerBlobObject*>& variable_op_name2eager_blob_object) {
+  if (IsNumaMemoryStatEnabled()) {
+    numa_memory_stat_.reset(new NumaMemoryStat(NumaMemoryStat::Query()));
+  }
   DumpThreadIdsFromPlan(plan);
   {
     // NOTE(chengcheng): All runtime global(singleton) objects AddPlan
@@ -97,8 +101,8 @@ Runtime::Runtime(
   }
   RuntimeCtx* runtime_ctx = Singleton<RuntimeCtx>::Get();
   runtime_ctx->NewCounter("constructing_actor_cnt", this_machine_task_num);
-  HandoutTasks(source_tasks);
-  HandoutTasks(other_tasks);
+  HandoutTasks(source_tasks, plan);
+  HandoutTasks(other_tasks, plan);
   runtime_ctx->WaitUntilCntEqualZero("constructing_actor_cnt");
   VLOG(3) << "Actors on this machine constructed";
   OF_SESSION_BARRIER();
@@ -117,6 +121,10 @@ Runtime::~Runtime() {
   Singleton<ThreadMgr>::Get()->DeleteThreads(independent_thread_ids_);
   Singleton<boxing::collective::Scheduler>::Get()->DeletePlan(
       collective_boxing_scheduler_plan_token_);
+  if (numa_memory_stat_ && !numa_memory_stat_->empty()) {
+    LOG(INFO) << "Numa memory stat of rank " << GlobalProcessCtx::Rank() << " during runtime: "
+              << NumaMemoryStat::Query().DeltaToString(*numa_memory_stat_);
+  }
 }
 
 void Runtime::DumpThreadIdsFromPlan(const Plan& plan) {
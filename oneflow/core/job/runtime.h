@@ -27,6 +27,8 @@ namespace vm {
 class EagerBlobObject;
 }
 
+class NumaMemoryStat;
+
 class Runtime final {
  public:
   OF_DISALLOW_COPY_AND_MOVE(Runtime);
@@ -45,6 +47,7 @@ class Runtime final {
   HashSet<int64_t> independent_thread_ids_;
 
   boxing::collective::SchedulerPlanToken* collective_boxing_scheduler_plan_token_;
+  std::unique_ptr<NumaMemoryStat> numa_memory_stat_;
 };
 
 }  // namespace oneflow
@@ -27,6 +27,7 @@ limitations under the License.
 #include "oneflow/core/framework/scope_util.h"
 #include "oneflow/core/job_rewriter/clip_by_global_norm_job_pass_state.h"
 #include "oneflow/core/job_rewriter/pass_util.h"
+#include "oneflow/user/kernels/gradient_compression_util.h"
 
 namespace oneflow {
 
@@ -993,6 +994,90 @@ void AddDiffParallelCast(const OpGraph& op_graph, JobBuilder* job_builder,
   }
 }
 
+namespace {
+
+OperatorConf GenGradientCompressionStateVariable(const VariableOp& var_op, const std::string& name,
+                                                 const Shape& shape, const std::string& sbp) {
+  OperatorConf state_var(var_op.op_conf());
+  state_var.set_name(name);
+  VariableOpConf* variable_conf = state_var.mutable_variable_conf();
+  variable_conf->set_out("out");
+  shape.ToProto(variable_conf->mutable_shape());
+  variable_conf->set_data_type(DataType::kFloat);
+  variable_conf->mutable_initializer()->mutable_constant_conf()->set_value(0.f);
+  variable_conf->clear_regularizer();
+  variable_conf->set_trainable(false);
+  variable_conf->clear_nd_sbp();
+  variable_conf->add_nd_sbp(sbp);
+  return state_var;
+}
+
+}  // namespace
+
+Maybe<void> AddDiffCompressedAllReduce(const OpGraph& op_graph, JobBuilder* job_builder,
+                                       HashMap<LogicalBlobId, LogicalBlobId>* lbi2diff_lbi) {
+  // The compressed all-reduce ops communicate in their kernels, so they are chained to make every
+  // rank run them in the same order.
+  std::string prev_op_name;
+  for (const auto& optimizer_conf : job_builder->job().job_conf().train_conf().optimizer_conf()) {
+    if (!optimizer_conf.has_gradient_compression()) { continue; }
+    const GradientCompressionConf& compression_conf = optimizer_conf.gradient_compression();
+    const GradientCompressionMethod method =
+        JUST(ParseGradientCompressionMethod(compression_conf.method()));
+    for (const std::string& var_op_name : optimizer_conf.variable_op_names()) {
+      const LogicalBlobId lbi = GenLogicalBlobId(var_op_name + "/out");
+      auto it = lbi2diff_lbi->find(lbi);
+      if (it == lbi2diff_lbi->end()) { continue; }
+      LogicalBlobId& diff_lbi = it->second;
+      const OpNode* var_op_node = op_graph.OpNode4OpName(var_op_name);
+      const ParallelDesc& parallel_desc = var_op_node->parallel_desc();
+      const NdSbp& var_nd_sbp = var_op_node->NdSbp4BnInOp(var_op_node->op().SoleObn());
+      if (parallel_desc.device_type() != DeviceType::kCPU || parallel_desc.parallel_num() <= 1
+          || parallel_desc.hierarchy()->NumAxes() != 1
+          || !var_nd_sbp.sbp_parallel(0).has_broadcast_parallel()
+          || op_graph.GetLogicalBlobDesc(diff_lbi).data_type() != DataType::kFloat) {
+        VLOG(3) << "gradient of " << var_op_name << " is not compressed";
+        continue;
+      }
+      const VariableOp* var_op = dynamic_cast<const VariableOp*>(&var_op_node->op());
+      CHECK_NOTNULL_OR_RETURN(var_op);
+      const Shape& shape = op_graph.GetLogicalBlobDesc(lbi).shape();
+      const int64_t scope_symbol_id = var_op->op_conf().scope_symbol_id();
+      user_op::UserOpConfWrapperBuilder builder("System-AutoGrad-CompressedAllReduce-"
+                                                + NewUniqueId());
+      builder.Op("gradient_compressed_all_reduce")
+          .Input("in", GenLogicalBlobName(diff_lbi))
+          .Output("out")
+          .Attr<std::string>("method", compression_conf.method())
+          .Attr<float>("top_k_ratio", compression_conf.top_k_ratio())
+          .ScopeSymbolId(scope_symbol_id);
+      std::vector<OperatorConf> state_vars;
+      if (compression_conf.error_feedback()) {
+        DimVector error_dim_vec{parallel_desc.parallel_num()};
+        error_dim_vec.insert(error_dim_vec.end(), shape.dim_vec().begin(), shape.dim_vec().end());
+        state_vars.emplace_back(GenGradientCompressionStateVariable(
+            *var_op, var_op_name + "-compression_error", Shape(error_dim_vec), "S(0)"));
+        builder.Input("error", GenLogicalBlobName(state_vars.back().name(), "out"));
+      }
+      Shape factor_shape;
+      if (method == GradientCompressionMethod::kPowerSgd
+          && GetPowerSgdFactorShape(shape, compression_conf.power_sgd_rank(), &factor_shape)) {
+        state_vars.emplace_back(GenGradientCompressionStateVariable(
+            *var_op, var_op_name + "-compression_q", factor_shape, "B"));
+        builder.Input("q", GenLogicalBlobName(state_vars.back().name(), "out"));
+      }
+      if (!state_vars.empty()) { job_builder->AddOps(parallel_desc.parallel_conf(), state_vars); }
+      const user_op::UserOpConfWrapper compressed_all_reduce_op = builder.Build();
+      OperatorConf op_conf = compressed_all_reduce_op.op_conf();
+      if (!prev_op_name.empty()) { op_conf.add_ctrl_in_op_name(prev_op_name); }
+      prev_op_name = op_conf.name();
+      job_builder->AddOps(parallel_desc.parallel_conf(), {op_conf});
+      diff_lbi = GenLogicalBlobId(compressed_all_reduce_op.output("out", 0));
+    }
+  }
+  return Maybe<void>::Ok();
+}
+
 void AddDiffHalf2FloatCast(const OpGraph& op_graph, JobBuilder* job_builder,
                            HashMap<LogicalBlobId, LogicalBlobId>* lbi2diff_lbi) {
   for (auto& pair : *lbi2diff_lbi) {
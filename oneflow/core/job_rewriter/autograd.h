@@ -28,6 +28,8 @@ void AddDiffHalf2FloatCast(const OpGraph& op_graph, JobBuilder* job_builder,
                            HashMap<LogicalBlobId, LogicalBlobId>* lbi2diff_lbi);
 void AddDiffParallelCast(const OpGraph& op_graph, JobBuilder* job_builder,
                          HashMap<LogicalBlobId, LogicalBlobId>* lbi2diff_lbi);
+Maybe<void> AddDiffCompressedAllReduce(const OpGraph& op_graph, JobBuilder* job_builder,
+                                       HashMap<LogicalBlobId, LogicalBlobId>* lbi2diff_lbi);
 void AddDiffStaticShapeCast(const OpGraph& op_graph, JobBuilder* job_builder,
                             HashMap<LogicalBlobId, LogicalBlobId>* lbi2diff_lbi);
 Maybe<void> CountNotFiniteIfNeeded(JobPassCtx* ctx, const OpGraph& op_graph,
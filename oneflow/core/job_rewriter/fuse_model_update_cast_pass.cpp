@@ -57,13 +57,21 @@ Maybe<void> FuseModelUpdateCastOpsPass::Apply(const OpGraph& op_graph,
           != DataType::kFloat) {
         continue;
       }
-      if (find_cast_node->LogicalBlobDesc4Lbi(GenLogicalBlobId(cast_user_conf.output("out", 0)))
-              .data_type()
-          != DataType::kFloat16) {
+      const DataType model_copy_data_type =
+          find_cast_node->LogicalBlobDesc4Lbi(GenLogicalBlobId(cast_user_conf.output("out", 0)))
+              .data_type();
+      const DeviceType device_type = find_cast_node->parallel_desc().device_type();
+      // The fused updates write a float16 model_copy on cuda, and a float16 or bfloat16 one on cpu.
+      if (device_type == DeviceType::kCUDA) {
+        if (model_copy_data_type != DataType::kFloat16) { continue; }
+      } else if (device_type == DeviceType::kCPU) {
+        if (model_copy_data_type != DataType::kFloat16
+            && model_copy_data_type != DataType::kBFloat16) {
+          continue;
+        }
+      } else {
         continue;
       }
-      // Currently only support for cuda, maybe remove this limit.
-      if (find_cast_node->parallel_desc().device_type() != DeviceType::kCUDA) { continue; }
 
       for (OpEdge* find_model_update_edge : op_node->out_edges()) {
         OpNode* find_model_update_update_node = find_model_update_edge->dst_node();
@@ -73,8 +81,7 @@ Maybe<void> FuseModelUpdateCastOpsPass::Apply(const OpGraph& op_graph,
           continue;
         }
 
-        // Currently only support for cuda, maybe remove this limit.
-        if (find_model_update_update_node->parallel_desc().device_type() != DeviceType::kCUDA) {
+        if (find_model_update_update_node->parallel_desc().device_type() != device_type) {
           continue;
         }
 
@@ -0,0 +1,125 @@
+/*
+Copyright 2020 The OneFlow Authors. All rights reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+#include "oneflow/core/job_rewriter/job_pass.h"
+#include "oneflow/core/job_rewriter/pass_util.h"
+#include "oneflow/core/framework/framework.h"
+
+namespace oneflow {
+
+namespace {
+
+// Rewrites the fake quantized linear layers of quantization aware inference jobs on CPU into
+// integer matmuls. A matmul whose weight is a variable fake quantized with per-channel symmetric
+// 8 bit scales from a min_max_observer of the same variable,
+//
+//   matmul(x, fake_quantization(w, min_max_observer(w)), transpose_b=true)
+//
+// is replaced by
+//
+//   dynamic_int8_linear(x, w)
+//
+// which quantizes w the same way and x per tensor on every run, so updates of the variable are
+// seen, and multiplies them with int32 accumulation. The fake_quantization and min_max_observer
+// that only fed the matmul are deleted.
+class QuantizedLinearRewritePass final : public JobPass {
+ public:
+  QuantizedLinearRewritePass() = default;
+  ~QuantizedLinearRewritePass() override = default;
+
+  bool IsEnabled(const JobPassCtx& ctx) const {
+    return ctx.job_desc().job_conf().enable_cpu_int8_linear() && !ctx.job_desc().IsTrain();
+  }
+  Maybe<void> Apply(const OpGraph& op_graph, JobBuilder* job_builder) const;
+
+  Maybe<void> Apply(Job* job, JobPassCtx* ctx) const override {
+    if (!IsEnabled(*ctx)) { return Maybe<void>::Ok(); }
+    const OpGraph op_graph(*job);
+    JobBuilder job_builder(job);
+    return Apply(op_graph, &job_builder);
+  }
+};
+
+Maybe<void> QuantizedLinearRewritePass::Apply(const OpGraph& op_graph,
+                                              JobBuilder* job_builder) const {
+  const auto IsSafeToDelete = MakePredicatorIsSafeToDelete(op_graph);
+  std::vector<OperatorConf> delete_ops;
+  op_graph.ForEachNode([&](const OpNode* op_node) {
+    if (!IsUserOpWithTypeName(op_node->op().op_conf(), "matmul")) { return; }
+    if (op_node->parallel_desc().device_type() != DeviceType::kCPU) { return; }
+    const user_op::UserOpConfWrapper matmul_conf(op_node->op().op_conf());
+    if (matmul_conf.attr<bool>("transpose_a") || !matmul_conf.attr<bool>("transpose_b")) { return; }
+    if (matmul_conf.attr<double>("alpha") != 1.0) { return; }
+    if (matmul_conf.has_input("_add_to_output", 0)) { return; }
+
+    const LogicalBlobId w_lbi = GenLogicalBlobId(matmul_conf.input("b", 0));
+    const OpNode* fake_quant_node = op_graph.OpNode4OpName(w_lbi.op_name());
+    if (!IsUserOpWithTypeName(fake_quant_node->op().op_conf(), "fake_quantization")) { return; }
+    const user_op::UserOpConfWrapper fake_quant_conf(fake_quant_node->op().op_conf());
+    if (fake_quant_conf.attr<std::string>("quantization_formula") != "google"
+        || fake_quant_conf.attr<std::string>("quantization_scheme") != "symmetric"
+        || fake_quant_conf.attr<int32_t>("quantization_bit") != 8) {
+      return;
+    }
+    const LogicalBlobId variable_lbi = GenLogicalBlobId(fake_quant_conf.input("in", 0));
+    if (!op_graph.OpNode4OpName(variable_lbi.op_name())->op().op_conf().has_variable_conf()) {
+      return;
+    }
+    const LogicalBlobId scale_lbi = GenLogicalBlobId(fake_quant_conf.input("scale", 0));
+    const OpNode* observer_node = op_graph.OpNode4OpName(scale_lbi.op_name());
+    if (!IsUserOpWithTypeName(observer_node->op().op_conf(), "min_max_observer")) { return; }
+    const user_op::UserOpConfWrapper observer_conf(observer_node->op().op_conf());
+    if (observer_conf.attr<bool>("per_layer_quantization")
+        || observer_conf.attr<std::string>("quantization_formula") != "google"
+        || observer_conf.attr<std::string>("quantization_scheme") != "symmetric"
+        || observer_conf.attr<int32_t>("quantization_bit") != 8
+        || GenLogicalBlobId(observer_conf.input("in", 0)) != variable_lbi) {
+      return;
+    }
+    const BlobDesc& w_desc = op_node->LogicalBlobDesc4Lbi(w_lbi);
+    if (w_desc.data_type() != DataType::kFloat || w_desc.shape().NumAxes() != 2) { return; }
+    const LogicalBlobId x_lbi = GenLogicalBlobId(matmul_conf.input("a", 0));
+    if (op_node->LogicalBlobDesc4Lbi(x_lbi).data_type() != DataType::kFloat) { return; }
+
+    user_op::UserOpConfWrapperBuilder linear_op_builder(op_node->op().op_name());
+    linear_op_builder.OpTypeName("dynamic_int8_linear")
+        .Input("x", matmul_conf.input("a", 0))
+        .Input("w", fake_quant_conf.input("in", 0))
+        .Output("out");
+    OperatorConf new_op_conf = op_node->op().op_conf();
+    *new_op_conf.mutable_user_conf() = linear_op_builder.Build().op_conf().user_conf();
+    job_builder->MutOpsOnlyOnce({new_op_conf});
+
+    if (fake_quant_node->out_edges().size() == 1 && IsSafeToDelete(fake_quant_node)) {
+      delete_ops.emplace_back(fake_quant_node->op().op_conf());
+      // The observer feeds the scale and zero_point of the fake_quantization, it goes with it
+      // unless something else reads its outputs.
+      const bool observer_only_feeds_fake_quant = std::all_of(
+          observer_node->out_edges().begin(), observer_node->out_edges().end(),
+          [&](const OpEdge* edge) { return edge->dst_node() == fake_quant_node; });
+      if (observer_only_feeds_fake_quant && IsSafeToDelete(observer_node)) {
+        delete_ops.emplace_back(observer_node->op().op_conf());
+      }
+    }
+  });
+  job_builder->DelOps(delete_ops);
+  return Maybe<void>::Ok();
+}
+
+}  // namespace
+
+REGISTER_JOB_PASS("QuantizedLinearRewritePass", QuantizedLinearRewritePass);
+
+}  // namespace oneflow
@@ -763,11 +763,9 @@ void Actor::AsyncSendQueuedMsg() {
     sync_msg_queue_.clear();
   }
   if (!async_msg_queue_.empty()) {
-    std::deque<ActorMsg> msgs;
+    std::vector<ActorMsg> msgs;
     msgs.swap(async_msg_queue_);
-    AddCallback([msgs]() {
-      for (const ActorMsg& msg : msgs) { Singleton<ActorMsgBus>::Get()->SendMsg(msg); }
-    });
+    AddCallback([msgs]() { Singleton<ActorMsgBus>::Get()->SendMsgs(msgs.data(), msgs.size()); });
   }
 }
 
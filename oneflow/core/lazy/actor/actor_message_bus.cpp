@@ -46,6 +46,34 @@ void ActorMsgBus::SendMsg(const ActorMsg& msg) {
   }
 }
 
+void ActorMsgBus::SendMsgs(const ActorMsg* msgs, size_t n) {
+  if (n == 1) {
+    SendMsg(msgs[0]);
+    return;
+  }
+  // NOTE: the outbox is per sending thread, so no lock is needed to fill it.
+  thread_local HashMap<int64_t, std::vector<ActorMsg>> thrd_id2outbox;
+  thread_local std::vector<int64_t> outbox_thrd_ids;
+  const int64_t this_rank = GlobalProcessCtx::Rank();
+  for (size_t i = 0; i < n; ++i) {
+    const ActorMsg& msg = msgs[i];
+    if (MachineId4ActorId(msg.dst_actor_id()) != this_rank) {
+      SendMsg(msg);
+      continue;
+    }
+    const int64_t thrd_id = ThrdId4ActorId(msg.dst_actor_id());
+    std::vector<ActorMsg>* outbox = &thrd_id2outbox[thrd_id];
+    if (outbox->empty()) { outbox_thrd_ids.emplace_back(thrd_id); }
+    outbox->emplace_back(msg);
+  }
+  for (int64_t thrd_id : outbox_thrd_ids) {
+    std::vector<ActorMsg>* outbox = &thrd_id2outbox[thrd_id];
+    SendMsgsWithoutCommNet(outbox->data(), outbox->size(), thrd_id);
+    outbox->clear();
+  }
+  outbox_thrd_ids.clear();
+}
+
 void ActorMsgBus::SendMsgWithoutCommNet(const ActorMsg& msg) {
   CHECK_EQ(MachineId4ActorId(msg.dst_actor_id()), GlobalProcessCtx::Rank());
   int64_t thrd_id = ThrdId4ActorId(msg.dst_actor_id());
@@ -27,6 +27,9 @@ class ActorMsgBus final {
   ~ActorMsgBus() = default;
 
   void SendMsg(const ActorMsg& msg);
+  // Sends msgs to local threads as one batch per destination thread, keeping the order of msgs
+  // with the same destination thread.
+  void SendMsgs(const ActorMsg* msgs, size_t n);
   void SendMsgWithoutCommNet(const ActorMsg& msg);
   void SendMsgsWithoutCommNet(const ActorMsg* msgs, size_t n, int64_t thrd_id);
 
@@ -48,19 +48,24 @@ void ChunkMgr::AddChunkProto(const ChunkProto& chunk) {
 
 char* ChunkMgr::FindOrCreateChunk(const ChunkProto& chunk) {
   CHECK_EQ(GlobalProcessCtx::Rank(), chunk.machine_id());
-  auto it = chunk_id2chunk_.find(chunk.chunk_id());
-  if (it == chunk_id2chunk_.end()) {
-    char* chunk_ptr =
-        Singleton<MemoryAllocator>::Get()->Allocate(chunk.mem_case(), chunk.mem_size());
-    it = chunk_id2chunk_.emplace(chunk.chunk_id(), ChunkWithPtr(chunk_ptr, chunk)).first;
-  } else {
-    const ChunkProto& store_proto = it->second.chunk_proto;
-    CHECK_EQ(chunk.chunk_id(), store_proto.chunk_id());
-    CHECK_EQ(chunk.machine_id(), store_proto.machine_id());
-    CHECK(chunk.mem_case() == store_proto.mem_case());
-    CHECK_EQ(chunk.mem_size(), store_proto.mem_size());
+  {
+    std::unique_lock<std::mutex> lock(mutex_);
+    auto it = chunk_id2chunk_.find(chunk.chunk_id());
+    if (it != chunk_id2chunk_.end()) {
+      const ChunkProto& store_proto = it->second.chunk_proto;
+      CHECK_EQ(chunk.chunk_id(), store_proto.chunk_id());
+      CHECK_EQ(chunk.machine_id(), store_proto.machine_id());
+      CHECK(chunk.mem_case() == store_proto.mem_case());
+      CHECK_EQ(chunk.mem_size(), store_proto.mem_size());
+      return it->second.ptr;
+    }
   }
-  return it->second.ptr;
+  // NOTE: allocate outside the lock so that chunks of different memory zones are created in
+  // parallel, a chunk id is created by exactly one caller.
+  char* chunk_ptr = Singleton<MemoryAllocator>::Get()->Allocate(chunk.mem_case(), chunk.mem_size());
+  std::unique_lock<std::mutex> lock(mutex_);
+  CHECK(chunk_id2chunk_.emplace(chunk.chunk_id(), ChunkWithPtr(chunk_ptr, chunk)).second);
+  return chunk_ptr;
 }
 
 }  // namespace oneflow
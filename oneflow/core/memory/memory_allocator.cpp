@@ -21,6 +21,7 @@ limitations under the License.
 #include "oneflow/core/common/tensor_buffer.h"
 #include "oneflow/core/record/record.pb.h"
 #include "oneflow/core/ep/include/device_manager_registry.h"
+#include "oneflow/core/thread/numa_affinity.h"
 
 namespace oneflow {
 
@@ -37,6 +38,9 @@ ep::AllocationOptions GetAllocationOptions(const MemoryCase& mem_case) {
   ep::AllocationOptions options{};
   if (mem_case.has_pinned_device_type() && mem_case.has_pinned_device_id()) {
     options.SetPinnedDevice(mem_case.pinned_device_type(), mem_case.pinned_device_id());
+  } else if (memory::IsHostMem(mem_case)) {
+    const int64_t numa_node = GetHostRegisterMemoryNumaNode();
+    if (numa_node >= 0) { options.SetNumaNodeAffinity(numa_node); }
   }
   return options;
 }
@@ -51,6 +55,19 @@ void* MemoryAllocatorImpl::Allocate(const MemoryCase& mem_case, size_t size) {
   return ptr;
 }
 
+void* MemoryAllocatorImpl::AllocateUntouchedHostMem(const MemoryCase& mem_case, size_t size,
+                                                    bool huge_page) {
+  void* ptr = nullptr;
+  std::shared_ptr<ep::Device> device = GetAllocationDevice(mem_case);
+  ep::AllocationOptions options = GetAllocationOptions(mem_case);
+  CHECK(memory::IsHostMem(mem_case));
+  CHECK(!options.HasPinnedDevice());
+  options.SetFirstTouchDeferred();
+  if (huge_page) { options.SetHugePageHint(); }
+  CHECK_JUST(device->Alloc(options, &ptr, size));
+  return ptr;
+}
+
 void MemoryAllocatorImpl::Deallocate(void* ptr, const MemoryCase& mem_case) {
   std::shared_ptr<ep::Device> device = GetAllocationDevice(mem_case);
   ep::AllocationOptions options = GetAllocationOptions(mem_case);
@@ -73,6 +90,16 @@ MemoryAllocator::~MemoryAllocator() {
 
 char* MemoryAllocator::Allocate(const MemoryCase& mem_case, std::size_t size) {
   char* dptr = static_cast<char*>(MemoryAllocatorImpl::Allocate(mem_case, size));
+  std::unique_lock<std::mutex> lock(deleters_mutex_);
+  deleters_.push_front(std::bind(&MemoryAllocator::Deallocate, this, dptr, mem_case));
+  return dptr;
+}
+
+char* MemoryAllocator::AllocateUntouchedHostMem(const MemoryCase& mem_case, std::size_t size,
+                                                bool huge_page) {
+  char* dptr =
+      static_cast<char*>(MemoryAllocatorImpl::AllocateUntouchedHostMem(mem_case, size, huge_page));
+  std::unique_lock<std::mutex> lock(deleters_mutex_);
   deleters_.push_front(std::bind(&MemoryAllocator::Deallocate, this, dptr, mem_case));
   return dptr;
 }
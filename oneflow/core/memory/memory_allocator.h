@@ -32,6 +32,9 @@ class MemoryAllocator final {
   ~MemoryAllocator();
 
   char* Allocate(const MemoryCase& mem_case, std::size_t size);
+  // Allocates unpinned host memory without touching or zero filling it, so that its pages are
+  // placed by whichever thread touches them first.
+  char* AllocateUntouchedHostMem(const MemoryCase& mem_case, std::size_t size, bool huge_page);
   template<typename T>
   T* PlacementNew(T* mem_ptr);
 
@@ -60,6 +63,7 @@ T* MemoryAllocator::PlacementNew(T* mem_ptr) {
 
 struct MemoryAllocatorImpl final {
   static void* Allocate(const MemoryCase& mem_case, size_t size);
+  static void* AllocateUntouchedHostMem(const MemoryCase& mem_case, size_t size, bool huge_page);
   static void Deallocate(void* ptr, const MemoryCase& mem_case);
   static void* AllocateUnPinnedHostMem(size_t size);
   static void DeallocateUnPinnedHostMem(void* ptr);
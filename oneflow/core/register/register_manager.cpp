@@ -25,6 +25,8 @@ limitations under the License.
 #include "oneflow/core/memory/memory_allocator.h"
 #include "oneflow/core/memory/chunk_manager.h"
 #include "oneflow/core/ep/include/device_manager_registry.h"
+#include "oneflow/core/common/cost_util.h"
+#include "oneflow/core/thread/thread_manager.h"
 
 namespace oneflow {
 
@@ -81,9 +83,33 @@ void InitDataRegst(Regst* regst, char* main_mem_ptr, char* separated_header_mem_
 
 }  // namespace
 
-RegstMgr::RegstMgr() : stream_ordered_memory_allocation_enabled_(false) {
+RegstMgr::RegstMgr()
+    : stream_ordered_memory_allocation_enabled_(false),
+      host_mem_actor_first_touch_enabled_(false),
+      host_mem_huge_page_enabled_(false) {
   stream_ordered_memory_allocation_enabled_ =
       ParseBooleanFromEnv("ONEFLOW_GRAPH_ENABLE_STREAM_ORDERED_MEMORY_ALLOCATION", false);
+  host_mem_actor_first_touch_enabled_ =
+      ParseBooleanFromEnv("ONEFLOW_REGST_HOST_MEM_ACTOR_FIRST_TOUCH", false);
+  host_mem_huge_page_enabled_ = ParseBooleanFromEnv("ONEFLOW_REGST_HOST_MEM_HUGE_PAGE", false);
+}
+
+bool RegstMgr::IsActorFirstTouchCase(const MemoryCase& mem_case) const {
+  // NOTE: huge pages only pay off when nothing touches the memory before the advice, so the huge
+  // page mode implies the actor first touch mode. Pinned memory is faulted in by the device.
+  if (!host_mem_actor_first_touch_enabled_ && !host_mem_huge_page_enabled_) { return false; }
+  return memory::IsHostMem(mem_case) && !mem_case.has_pinned_device_type();
+}
+
+void RegstMgr::FirstTouchMemBlockIfNeed(int64_t mem_block_id) {
+  if (mem_block_id == -1) { return; }
+  auto it = untouched_mem_block_id2first_touch_.find(mem_block_id);
+  if (it == untouched_mem_block_id2first_touch_.end()) { return; }
+  char* ptr = mem_block_id2ptr_.at(mem_block_id);
+  const int64_t size = it->second.first;
+  // NOTE: the whole block is zero filled once by the first actor thread creating a regst in it,
+  // other actors sharing the block wait here until its pages are placed.
+  std::call_once(*it->second.second, [ptr, size]() { memset(ptr, 0, size); });
 }
 
 bool RegstMgr::IsStreamOrderedMemoryAllocationCase(const MemoryCase& mem_case) const {
@@ -96,15 +122,33 @@ void RegstMgr::AddPlan(
     const Plan& plan,
     const HashMap<std::string, vm::EagerBlobObject*>& variable_op_name2eager_blob_object) {
   int64_t this_machine_id = GlobalProcessCtx::Rank();
+  auto phase_tc = std::make_unique<CostCounter<std::chrono::milliseconds>>(true, false);
 
-  HashMap<int64_t, char*> chunk_id2ptr;
+  // chunks of different memory zones are created in parallel
+  HashMap<int64_t, std::vector<const ChunkProto*>> zone_id2chunks;
   for (const ChunkProto& chunk : plan.block_chunk_list().chunk()) {
     if (chunk.machine_id() != this_machine_id) { continue; }
     if (chunk.mem_size() == 0) { continue; }
     if (IsStreamOrderedMemoryAllocationCase(chunk.mem_case())) { continue; }
-    char* chunk_ptr = Singleton<ChunkMgr>::Get()->FindOrCreateChunk(chunk);
-    CHECK(chunk_id2ptr.emplace(chunk.chunk_id(), chunk_ptr).second);
+    zone_id2chunks[memory::GetMemCaseId(chunk.mem_case())].emplace_back(&chunk);
+  }
+  std::vector<std::vector<const ChunkProto*>*> zone_chunks;
+  zone_chunks.reserve(zone_id2chunks.size());
+  for (auto& pair : zone_id2chunks) { zone_chunks.emplace_back(&pair.second); }
+  std::vector<std::vector<char*>> zone_chunk_ptrs(zone_chunks.size());
+  MultiThreadLoop(zone_chunks.size(), [&](size_t i) {
+    for (const ChunkProto* chunk : *zone_chunks.at(i)) {
+      zone_chunk_ptrs.at(i).emplace_back(Singleton<ChunkMgr>::Get()->FindOrCreateChunk(*chunk));
+    }
+  });
+  HashMap<int64_t, char*> chunk_id2ptr;
+  for (size_t i = 0; i < zone_chunks.size(); ++i) {
+    for (size_t j = 0; j < zone_chunks.at(i)->size(); ++j) {
+      CHECK(chunk_id2ptr.emplace(zone_chunks.at(i)->at(j)->chunk_id(), zone_chunk_ptrs.at(i).at(j))
+                .second);
+    }
   }
+  phase_tc->Count("RegstMgr::AddPlan create chunks", 1);
 
   HashSet<int64_t> all_block_ids;
   HashMap<int64_t, PackedChunkInfo> zone_id2packed_chunk;
@@ -169,11 +213,22 @@ void RegstMgr::AddPlan(
       CHECK(packed_chunk->mem_case == mem_block.mem_case());
     }
   }
+  phase_tc->Count("RegstMgr::AddPlan bind mem blocks", 1);
 
-  for (auto& pair : zone_id2packed_chunk) {
-    PackedChunkInfo* packed_chunk = &pair.second;
-    char* ptr =
-        Singleton<MemoryAllocator>::Get()->Allocate(packed_chunk->mem_case, packed_chunk->size);
+  // packed chunks of different memory zones are allocated in parallel
+  std::vector<PackedChunkInfo*> packed_chunks;
+  packed_chunks.reserve(zone_id2packed_chunk.size());
+  for (auto& pair : zone_id2packed_chunk) { packed_chunks.emplace_back(&pair.second); }
+  std::vector<char*> packed_chunk_ptrs(packed_chunks.size());
+  MultiThreadLoop(packed_chunks.size(), [&](size_t i) {
+    PackedChunkInfo* packed_chunk = packed_chunks.at(i);
+    if (IsActorFirstTouchCase(packed_chunk->mem_case)) {
+      packed_chunk_ptrs.at(i) = Singleton<MemoryAllocator>::Get()->AllocateUntouchedHostMem(
+          packed_chunk->mem_case, packed_chunk->size, host_mem_huge_page_enabled_);
+    } else {
+      packed_chunk_ptrs.at(i) =
+          Singleton<MemoryAllocator>::Get()->Allocate(packed_chunk->mem_case, packed_chunk->size);
+    }
     // sort blocks as thrd id
     std::vector<const MemBlockProto*>* blocks = &(packed_chunk->blocks);
     std::sort(blocks->begin(), blocks->end(),
@@ -183,13 +238,25 @@ void RegstMgr::AddPlan(
                 }
                 return lhs->thrd_id_hint() < rhs->thrd_id_hint();
               });
+  });
+  for (size_t i = 0; i < packed_chunks.size(); ++i) {
+    PackedChunkInfo* packed_chunk = packed_chunks.at(i);
+    const bool first_touch_by_actor = IsActorFirstTouchCase(packed_chunk->mem_case);
+    char* ptr = packed_chunk_ptrs.at(i);
     int64_t offset = 0;
     for (const MemBlockProto* block : packed_chunk->blocks) {
       CHECK(mem_block_id2ptr_.emplace(block->mem_block_id(), ptr + offset).second);
+      if (first_touch_by_actor) {
+        CHECK(untouched_mem_block_id2first_touch_
+                  .emplace(block->mem_block_id(),
+                           std::make_pair(block->mem_size(), std::make_unique<std::once_flag>()))
+                  .second);
+      }
       offset += block->mem_size();
     }
     CHECK_EQ(offset, packed_chunk->size);
   }
+  phase_tc->Count("RegstMgr::AddPlan allocate packed chunks", 1);
 
   for (int64_t mem_block_id : all_block_ids) {
     if (mem_block_id2ptr_.find(mem_block_id) != mem_block_id2ptr_.end()) {
@@ -201,19 +268,24 @@ void RegstMgr::AddPlan(
     }
   }
 
+  std::vector<const RegstDescProto*> regst_descs;
   for (const TaskProto& task : plan.task()) {
     if (task.machine_id() != this_machine_id) { continue; }
-    for (const auto& pair : task.produced_regst_desc()) {
-      const RegstDescProto& regst_desc = pair.second;
-      const int64_t regst_desc_id = regst_desc.regst_desc_id();
-      CHECK(regst_desc_id2rt_regst_desc_
-                .emplace(regst_desc_id, std::make_unique<const RtRegstDesc>(regst_desc))
-                .second);
-    }
+    for (const auto& pair : task.produced_regst_desc()) { regst_descs.emplace_back(&pair.second); }
+  }
+  std::vector<std::unique_ptr<const RtRegstDesc>> rt_regst_descs(regst_descs.size());
+  MultiThreadLoop(regst_descs.size(), [&](size_t i) {
+    rt_regst_descs.at(i) = std::make_unique<const RtRegstDesc>(*regst_descs.at(i));
+  });
+  for (size_t i = 0; i < regst_descs.size(); ++i) {
+    const int64_t regst_desc_id = regst_descs.at(i)->regst_desc_id();
+    CHECK(regst_desc_id2rt_regst_desc_.emplace(regst_desc_id, std::move(rt_regst_descs.at(i)))
+              .second);
   }
   for (const auto& pair : plan.ctrl_regst_desc_info().ctrl_regst_desc_id2producer_task_id()) {
     CHECK(ctrl_regst_desc_id2producer_task_id_.emplace(pair.first, pair.second).second);
   }
+  phase_tc->Count("RegstMgr::AddPlan create regst descs", 1);
 }
 
 void RegstMgr::AddPlan(const Plan& plan) {
@@ -240,6 +312,8 @@ void RegstMgr::NewRegsts(const RegstDescProto& regst_desc_proto,
                                                 == stream_ordered_allocation_mem_block_ids_.end()
                                             ? RegstAllocationType::kStatic
                                             : RegstAllocationType::kStreamOrdered;
+  FirstTouchMemBlockIfNeed(mem_block_id);
+  FirstTouchMemBlockIfNeed(header_block_id);
   for (int64_t i = 0; i < rt_regst_desc->register_num(); ++i) {
     Regst* regst = new Regst(rt_regst_desc, allocation_type);
     if (regst_desc_type.has_data_regst_desc()) {
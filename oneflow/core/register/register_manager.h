@@ -51,13 +51,21 @@ class RegstMgr final {
 
  private:
   bool IsStreamOrderedMemoryAllocationCase(const MemoryCase& mem_case) const;
+  bool IsActorFirstTouchCase(const MemoryCase& mem_case) const;
+  void FirstTouchMemBlockIfNeed(int64_t mem_block_id);
 
   HashMap<int64_t, std::unique_ptr<const RtRegstDesc>> regst_desc_id2rt_regst_desc_;
   HashMap<int64_t, char*> mem_block_id2ptr_;
   HashSet<int64_t> stream_ordered_allocation_mem_block_ids_;
+  // host mem blocks left untouched at allocation, first touched by the actor thread that creates
+  // the first regst in them so that their pages land on the numa node of that thread
+  HashMap<int64_t, std::pair<int64_t, std::unique_ptr<std::once_flag>>>
+      untouched_mem_block_id2first_touch_;
   HashMap<int64_t, int64_t> ctrl_regst_desc_id2producer_task_id_;
   std::mutex mutex_;
   bool stream_ordered_memory_allocation_enabled_;
+  bool host_mem_actor_first_touch_enabled_;
+  bool host_mem_huge_page_enabled_;
 };
 
 }  // namespace oneflow
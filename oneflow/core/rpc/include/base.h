@@ -35,7 +35,9 @@ namespace oneflow {
   OF_PP_MAKE_TUPLE_SEQ(PullKV)        \
   OF_PP_MAKE_TUPLE_SEQ(Clear)         \
   OF_PP_MAKE_TUPLE_SEQ(IncreaseCount) \
-  OF_PP_MAKE_TUPLE_SEQ(EraseCount)
+  OF_PP_MAKE_TUPLE_SEQ(EraseCount)    \
+  OF_PP_MAKE_TUPLE_SEQ(PushKVs)       \
+  OF_PP_MAKE_TUPLE_SEQ(PullKVs)
 
 #define CatRequest(method) method##Request,
 #define CatReqponse(method) method##Response,
@@ -86,6 +88,11 @@ class CtrlClient {
     PushKV(k, std::to_string(v));
   }
 
+  // Batched PushKV/PullKV, one request per responsible server instead of one per key.
+  virtual void PushKVs(const std::vector<std::string>& keys,
+                       const std::vector<std::string>& vals) = 0;
+  virtual void PullKVs(const std::vector<std::string>& keys, std::vector<std::string>* vals) = 0;
+
   virtual void ClearKV(const std::string& k) = 0;
   virtual void ClearMasterKV(const std::string& k) = 0;
 
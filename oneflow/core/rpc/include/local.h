@@ -43,6 +43,10 @@ class LocalCtrlClient : public CtrlClient {
   void PushKV(const std::string& k, const PbMessage& msg) override;
   void PushMasterKV(const std::string& k, const PbMessage& msg) override;
 
+  void PushKVs(const std::vector<std::string>& keys,
+               const std::vector<std::string>& vals) override;
+  void PullKVs(const std::vector<std::string>& keys, std::vector<std::string>* vals) override;
+
   void ClearKV(const std::string& k) override;
   void ClearMasterKV(const std::string& k) override;
 
@@ -98,6 +98,32 @@ void LocalCtrlClient::PushMasterKV(const std::string& k, const PbMessage& msg) {
   PushKV(k, [&](std::string* o) { msg.SerializeToString(o); });
 }
 
+void LocalCtrlClient::PushKVs(const std::vector<std::string>& keys,
+                              const std::vector<std::string>& vals) {
+  CHECK_EQ(keys.size(), vals.size());
+  std::unique_lock<std::mutex> lck(kv_mtx_);
+  for (size_t i = 0; i < keys.size(); ++i) { kv_[keys[i]] = vals[i]; }
+  kv_cv_.notify_all();
+}
+
+void LocalCtrlClient::PullKVs(const std::vector<std::string>& keys,
+                              std::vector<std::string>* vals) {
+  vals->resize(keys.size());
+  std::unique_lock<std::mutex> lck(kv_mtx_);
+  for (size_t i = 0; i < keys.size(); ++i) {
+    while (true) {
+      auto it = kv_.find(keys[i]);
+      if (it == kv_.end()) {
+        VLOG(3) << "waiting for key: " << keys[i];
+        kv_cv_.wait(lck);
+      } else {
+        vals->at(i) = it->second;
+        break;
+      }
+    }
+  }
+}
+
 void LocalCtrlClient::ClearKV(const std::string& k) {
   std::unique_lock<std::mutex> lck(kv_mtx_);
   kv_.erase(k);
@@ -200,6 +226,14 @@ class DryRunCtrlClient : public CtrlClient {
     local_ctrl_client_->PushMasterKV(k, msg);
   }
 
+  void PushKVs(const std::vector<std::string>& keys,
+               const std::vector<std::string>& vals) override {
+    local_ctrl_client_->PushKVs(keys, vals);
+  }
+  void PullKVs(const std::vector<std::string>& keys, std::vector<std::string>* vals) override {
+    local_ctrl_client_->PullKVs(keys, vals);
+  }
+
   void ClearKV(const std::string& k) override { local_ctrl_client_->ClearKV(k); }
   void ClearMasterKV(const std::string& k) override { local_ctrl_client_->ClearMasterKV(k); }
 
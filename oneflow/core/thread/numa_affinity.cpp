@@ -0,0 +1,151 @@
+/*
+Copyright 2020 The OneFlow Authors. All rights reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+#include "oneflow/core/thread/numa_affinity.h"
+#include <fstream>
+#ifdef __linux__
+#include <dirent.h>
+#endif  // __linux__
+#include "oneflow/core/control/global_process_ctx.h"
+#include "oneflow/core/hardware/node_device_descriptor.h"
+#include "oneflow/core/hardware/node_device_descriptor_manager.h"
+#include "oneflow/core/job/global_for.h"
+#include "oneflow/core/job/resource_desc.h"
+
+namespace oneflow {
+
+namespace {
+
+std::shared_ptr<const hardware::TopologyDescriptor> GetLocalTopology() {
+  auto* node_device_desc_mgr = Singleton<hardware::NodeDeviceDescriptorManager>::Get();
+  if (node_device_desc_mgr == nullptr) { return nullptr; }
+  return node_device_desc_mgr->GetLocalNodeDeviceDescriptor()->Topology();
+}
+
+bool TryGetEnabledNumaAffinityConf(NumaAffinityConf* conf) {
+  const auto* resource_desc = Singleton<ResourceDesc, ForSession>::Get();
+  if (resource_desc == nullptr) { return false; }
+  *conf = resource_desc->numa_affinity_conf();
+  return conf->enable_numa_affinity();
+}
+
+int64_t GetThisProcessNumaNode(const NumaAffinityConf& conf) {
+  const auto topology = GetLocalTopology();
+  if (!topology) { return -1; }
+  const int64_t numa_node_count = topology->NumaNodeCount();
+  // NOTE: nothing to place on single node machines.
+  if (numa_node_count <= 1) { return -1; }
+  const int64_t local_rank = GlobalProcessCtx::LocalRank();
+  if (local_rank < conf.local_rank2numa_node_size()) {
+    const int64_t numa_node = conf.local_rank2numa_node(local_rank);
+    CHECK_GE(numa_node, 0);
+    CHECK_LT(numa_node, numa_node_count)
+        << "numa node " << numa_node << " of local rank " << local_rank << " does not exist";
+    return numa_node;
+  }
+  // NOTE: Queried once, before any actor thread binds itself, so that it reflects the affinity and
+  // cgroup cpuset the launcher gave this process.
+  static const std::vector<int64_t> allowed_numa_nodes =
+      topology->GetNumaNodesOfProcessCPUBinding();
+  // A launcher that already restricted the process to one node decides for us.
+  if (allowed_numa_nodes.size() == 1) { return allowed_numa_nodes.front(); }
+  // Otherwise the local ranks are assumed to be started with the same affinity and are spread
+  // round robin over the nodes they are allowed on.
+  if (!allowed_numa_nodes.empty()) {
+    return allowed_numa_nodes.at(local_rank % allowed_numa_nodes.size());
+  }
+  return local_rank % numa_node_count;
+}
+
+}  // namespace
+
+int64_t GetActorThreadNumaNode(const StreamId& stream_id) {
+  NumaAffinityConf conf;
+  if (!TryGetEnabledNumaAffinityConf(&conf)) { return -1; }
+  if (stream_id.device_type() != DeviceType::kCPU) { return -1; }
+  return GetThisProcessNumaNode(conf);
+}
+
+int64_t GetHostRegisterMemoryNumaNode() {
+  NumaAffinityConf conf;
+  if (!TryGetEnabledNumaAffinityConf(&conf)) { return -1; }
+  if (!conf.bind_host_register_memory()) { return -1; }
+  return GetThisProcessNumaNode(conf);
+}
+
+void BindThisThreadToNumaNode(int64_t numa_node) {
+  if (numa_node < 0) { return; }
+  const auto topology = GetLocalTopology();
+  if (!topology) { return; }
+  topology->SetCPUAffinityByNumaNode(numa_node);
+  topology->SetMemoryAffinityByNumaNode(numa_node);
+}
+
+NumaMemoryStat NumaMemoryStat::Query() {
+  NumaMemoryStat stat;
+#ifdef __linux__
+  const std::string node_dir = "/sys/devices/system/node/";
+  DIR* dir = opendir(node_dir.c_str());
+  if (dir == nullptr) { return stat; }
+  while (dirent* f = readdir(dir)) {
+    const std::string name = f->d_name;
+    if (name.size() <= 4 || name.compare(0, 4, "node") != 0) { continue; }
+    if (!std::all_of(name.begin() + 4, name.end(), ::isdigit)) { continue; }
+    std::ifstream in(node_dir + name + "/numastat");
+    if (!in.is_open()) { continue; }
+    NumaNodeMemoryStat* node_stat = &stat.node2stat_[std::stoll(name.substr(4))];
+    std::string key;
+    int64_t value = 0;
+    while (in >> key >> value) {
+      if (key == "numa_hit") {
+        node_stat->numa_hit = value;
+      } else if (key == "numa_miss") {
+        node_stat->numa_miss = value;
+      } else if (key == "numa_foreign") {
+        node_stat->numa_foreign = value;
+      } else if (key == "local_node") {
+        node_stat->local_node = value;
+      } else if (key == "other_node") {
+        node_stat->other_node = value;
+      }
+    }
+  }
+  closedir(dir);
+#endif  // __linux__
+  return stat;
+}
+
+std::string NumaMemoryStat::DeltaToString(const NumaMemoryStat& since) const {
+  std::stringstream ss;
+  for (const auto& pair : node2stat_) {
+    NumaNodeMemoryStat base;
+    const auto it = since.node2stat_.find(pair.first);
+    if (it != since.node2stat_.end()) { base = it->second; }
+    const NumaNodeMemoryStat& cur = pair.second;
+    ss << "node" << pair.first << ": numa_hit=" << cur.numa_hit - base.numa_hit
+       << " numa_miss=" << cur.numa_miss - base.numa_miss
+       << " numa_foreign=" << cur.numa_foreign - base.numa_foreign
+       << " local_node=" << cur.local_node - base.local_node
+       << " other_node=" << cur.other_node - base.other_node << "; ";
+  }
+  return ss.str();
+}
+
+bool IsNumaMemoryStatEnabled() {
+  NumaAffinityConf conf;
+  return TryGetEnabledNumaAffinityConf(&conf) && conf.enable_numa_memory_stat();
+}
+
+}  // namespace oneflow
@@ -0,0 +1,61 @@
+/*
+Copyright 2020 The OneFlow Authors. All rights reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+#ifndef ONEFLOW_CORE_THREAD_NUMA_AFFINITY_H_
+#define ONEFLOW_CORE_THREAD_NUMA_AFFINITY_H_
+
+#include "oneflow/core/common/util.h"
+#include "oneflow/core/graph/stream_id.h"
+
+namespace oneflow {
+
+// Returns the numa node the actor thread of stream_id should be pinned to, or -1 if it should
+// float. Cuda streams are excluded because they already follow the numa node of their gpu.
+int64_t GetActorThreadNumaNode(const StreamId& stream_id);
+
+// Returns the numa node the host register memory of this process should be bound to, or -1.
+int64_t GetHostRegisterMemoryNumaNode();
+
+void BindThisThreadToNumaNode(int64_t numa_node);
+
+bool IsNumaMemoryStatEnabled();
+
+struct NumaNodeMemoryStat {
+  int64_t numa_hit = 0;
+  int64_t numa_miss = 0;
+  int64_t numa_foreign = 0;
+  int64_t local_node = 0;
+  int64_t other_node = 0;
+};
+
+// Snapshot of the per node counters in /sys/devices/system/node/node*/numastat, empty if the
+// kernel does not expose them.
+class NumaMemoryStat final {
+ public:
+  NumaMemoryStat() = default;
+  ~NumaMemoryStat() = default;
+
+  static NumaMemoryStat Query();
+
+  bool empty() const { return node2stat_.empty(); }
+  std::string DeltaToString(const NumaMemoryStat& since) const;
+
+ private:
+  std::map<int64_t, NumaNodeMemoryStat> node2stat_;
+};
+
+}  // namespace oneflow
+
+#endif  // ONEFLOW_CORE_THREAD_NUMA_AFFINITY_H_
@@ -16,6 +16,7 @@ limitations under the License.
 #include "oneflow/core/thread/thread.h"
 #include "oneflow/core/job/runtime_context.h"
 #include "oneflow/core/job/global_for.h"
+#include "oneflow/core/job/plan_util.h"
 #include "oneflow/core/lazy/actor/actor.h"
 #include "oneflow/core/lazy/actor/light_actor.h"
 #include "oneflow/core/profiler/profiler.h"
@@ -23,6 +24,7 @@ limitations under the License.
 #include "oneflow/core/framework/to_string.h"
 #include "oneflow/core/lazy/stream_context/include/generic_stream_context.h"
 #include "oneflow/core/job/lazy_mode.h"
+#include "oneflow/core/thread/numa_affinity.h"
 
 namespace oneflow {
 
@@ -37,7 +39,9 @@ Thread::Thread(const StreamId& stream_id) : thrd_id_(EncodeStreamIdToInt64(strea
     stream_ctx_.reset(new GenericStreamContext(stream_id));
   }
 
-  actor_thread_ = std::thread([this, stream_id]() {
+  const int64_t numa_node = GetActorThreadNumaNode(stream_id);
+  actor_thread_ = std::thread([this, stream_id, numa_node]() {
+    BindThisThreadToNumaNode(numa_node);
     LazyMode::Guard guard(true);
     OF_PROFILER_NAME_THIS_HOST_THREAD("_" + ToString(stream_id.device_id().device_type())
                                       + std::to_string(stream_id.device_id().device_index())
@@ -54,9 +58,9 @@ Thread::~Thread() {
   msg_channel_.Close();
 }
 
-void Thread::AddTask(const TaskProto& task) {
+void Thread::AddTask(const TaskProto& task, const Plan& plan) {
   std::unique_lock<std::mutex> lck(id2task_mtx_);
-  CHECK(id2task_.emplace(task.task_id(), task).second);
+  CHECK(id2task_.emplace(task.task_id(), std::make_pair(&task, &plan)).second);
 }
 
 void Thread::PollMsgChannel() {
@@ -99,7 +103,8 @@ void Thread::PollMsgChannel() {
 void Thread::ConstructActor(int64_t actor_id) {
   std::unique_lock<std::mutex> lck(id2task_mtx_);
   auto task_it = id2task_.find(actor_id);
-  const TaskProto& task = task_it->second;
+  TaskProto task;
+  PlanUtil::MaterializeTask(*task_it->second.second, *task_it->second.first, &task);
   std::unique_ptr<ActorContext> actor_ctx = NewActorContext(task, stream_ctx_.get());
   CHECK(actor_ctx);
   std::unique_ptr<ActorBase> actor_ptr;
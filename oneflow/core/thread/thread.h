@@ -20,6 +20,7 @@ limitations under the License.
 #include "oneflow/core/common/channel.h"
 #include "oneflow/core/common/util.h"
 #include "oneflow/core/job/task.pb.h"
+#include "oneflow/core/job/plan.pb.h"
 #include "oneflow/core/lazy/actor/actor.h"
 #include "oneflow/core/lazy/actor/actor_context.h"
 
@@ -33,7 +34,9 @@ class Thread {
   explicit Thread(const StreamId& stream_id);
   virtual ~Thread();
 
-  void AddTask(const TaskProto&);
+  // The task is materialized with the kernel confs in plan when constructing the actor, so both
+  // of them must outlive the construction.
+  void AddTask(const TaskProto& task, const Plan& plan);
 
   Channel<ActorMsg>* GetMsgChannelPtr() { return &msg_channel_; }
 
@@ -50,7 +53,7 @@ class Thread {
     if (UseLocalMsgQueue()) {
       for (auto it = first; it != last; ++it) { local_msg_queue_.push(*it); }
     } else {
-      for (auto it = first; it != last; ++it) { msg_channel_.Send(*it); }
+      msg_channel_.SendMany(first, last);
     }
   }
 
@@ -64,7 +67,7 @@ class Thread {
     return local_msg_queue_enabled_ && std::this_thread::get_id() == actor_thread_.get_id();
   }
 
-  HashMap<int64_t, TaskProto> id2task_;
+  HashMap<int64_t, std::pair<const TaskProto*, const Plan*>> id2task_;
   std::mutex id2task_mtx_;
 
   std::thread actor_thread_;
@@ -24,6 +24,11 @@ namespace oneflow {
 
 const static int kThreadGlobalIdDefaultWorker = 0;
 const static int kThreadGlobalIdMain = 7;
+// Ids in [kThreadGlobalIdCpuCollectiveBoxingBegin, kThreadGlobalIdGradientCompression) belong to
+// the comm threads of the CPU collective boxing executor.
+const static int kThreadGlobalIdCpuCollectiveBoxingBegin = 1;
+// Taken by lazy gradient_compressed_all_reduce kernels while they communicate.
+const static int kThreadGlobalIdGradientCompression = 6;
 
 int64_t GetThisThreadGlobalId();
 
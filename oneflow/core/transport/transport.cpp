@@ -17,13 +17,90 @@ limitations under the License.
 
 #include "oneflow/core/control/global_process_ctx.h"
 #include "oneflow/core/transport/transport.h"
+#include "oneflow/core/common/env_var/comm_net.h"
 
 namespace oneflow {
 
+namespace {
+
+// A coalesced buffer is a sequence of entries, each made of this header and the data of one send
+// padded to kCoalescedEntryAlignment bytes.
+struct CoalescedEntryHeader {
+  uint64_t token;
+  uint64_t size;
+};
+
+constexpr std::size_t kCoalescedEntryAlignment = alignof(CoalescedEntryHeader);
+
+void AppendCoalescedEntry(std::vector<char>* buffer, uint64_t token, const void* ptr,
+                          std::size_t size) {
+  const std::size_t offset = buffer->size();
+  const std::size_t padded_size = RoundUp(size, kCoalescedEntryAlignment);
+  buffer->resize(offset + sizeof(CoalescedEntryHeader) + padded_size);
+  CoalescedEntryHeader header{token, size};
+  std::memcpy(buffer->data() + offset, &header, sizeof(header));
+  if (size > 0) { std::memcpy(buffer->data() + offset + sizeof(header), ptr, size); }
+}
+
+template<typename F>
+void ForEachCoalescedEntry(const std::vector<char>& buffer, const F& Handler) {
+  std::size_t offset = 0;
+  while (offset < buffer.size()) {
+    CoalescedEntryHeader header{};
+    CHECK_LE(offset + sizeof(header), buffer.size());
+    std::memcpy(&header, buffer.data() + offset, sizeof(header));
+    offset += sizeof(header);
+    CHECK_LE(offset + header.size, buffer.size());
+    Handler(header.token, buffer.data() + offset, header.size);
+    offset += RoundUp(header.size, kCoalescedEntryAlignment);
+  }
+}
+
+}  // namespace
+
+std::string TransportStats::ToString() const {
+  const double seconds = std::max(elapsed_seconds, 1e-9);
+  std::ostringstream ss;
+  ss << "elapsed: " << elapsed_seconds << "s"
+     << ", send: " << send_num << " msgs, " << send_bytes << " bytes, "
+     << send_num / seconds << " msgs/s, avg latency " << avg_send_latency_us << "us"
+     << ", in flight " << in_flight_send_num << " (max " << max_in_flight_send_num << ")"
+     << ", recv: " << recv_num << " msgs, " << recv_bytes << " bytes, "
+     << recv_num / seconds << " msgs/s, avg latency " << avg_recv_latency_us << "us"
+     << ", in flight " << in_flight_recv_num << " (max " << max_in_flight_recv_num << ")"
+     << ", coalesced: " << coalesced_send_num << " sends in " << coalesced_buffer_num
+     << " buffers";
+  return ss.str();
+}
+
+std::function<void()> Transport::Counter::Track(std::size_t size,
+                                                std::function<void()> callback) {
+  const int64_t cur_in_flight_num = in_flight_num.fetch_add(1, std::memory_order_relaxed) + 1;
+  int64_t cur_max = max_in_flight_num.load(std::memory_order_relaxed);
+  while (cur_in_flight_num > cur_max
+         && !max_in_flight_num.compare_exchange_weak(cur_max, cur_in_flight_num,
+                                                     std::memory_order_relaxed)) {}
+  const auto start = std::chrono::steady_clock::now();
+  return [this, size, start, callback]() {
+    const auto latency = std::chrono::steady_clock::now() - start;
+    latency_us.fetch_add(std::chrono::duration_cast<std::chrono::microseconds>(latency).count(),
+                         std::memory_order_relaxed);
+    bytes.fetch_add(size, std::memory_order_relaxed);
+    num.fetch_add(1, std::memory_order_relaxed);
+    in_flight_num.fetch_sub(1, std::memory_order_relaxed);
+    if (callback) { callback(); }
+  };
+}
+
 Transport::Transport() {
   comm_net_ = Singleton<EpollCommNet>::Get();  // NOLINT
   this_machine_id_ = GlobalProcessCtx::Rank();
   CHECK(comm_net_ != nullptr);
+  coalesce_max_msg_size_ =
+      std::max<int64_t>(EnvInteger<ONEFLOW_TRANSPORT_COALESCE_MAX_MSG_SIZE>(), 0);
+  dst_machine_id2coalescing_queue_.resize(GlobalProcessCtx::WorldSize());
+  for (auto& queue : dst_machine_id2coalescing_queue_) { queue.reset(new CoalescingQueue); }
+  start_time_ = std::chrono::steady_clock::now();
   // maybe need new read id for each dst machine id, maybe need 2 * machine num read ids
   read_id_ = comm_net_->NewActorReadId();
   msg_poller_ = std::thread([this]() { PollMsgChannel(); });
@@ -33,6 +110,33 @@ Transport::~Transport() {
   msg_channel_.Close();
   msg_poller_.join();
   comm_net_->DeleteActorReadId(read_id_);
+  VLOG(1) << "Transport stats of machine " << this_machine_id_ << ": " << GetStats().ToString();
+}
+
+TransportStats Transport::GetStats() const {
+  TransportStats stats{};
+  stats.elapsed_seconds =
+      std::chrono::duration<double>(std::chrono::steady_clock::now() - start_time_).count();
+  stats.send_num = send_counter_.num.load();
+  stats.send_bytes = send_counter_.bytes.load();
+  stats.recv_num = recv_counter_.num.load();
+  stats.recv_bytes = recv_counter_.bytes.load();
+  stats.avg_send_latency_us =
+      static_cast<double>(send_counter_.latency_us.load()) / std::max<int64_t>(stats.send_num, 1);
+  stats.avg_recv_latency_us =
+      static_cast<double>(recv_counter_.latency_us.load()) / std::max<int64_t>(stats.recv_num, 1);
+  stats.in_flight_send_num = send_counter_.in_flight_num.load();
+  stats.max_in_flight_send_num = send_counter_.max_in_flight_num.load();
+  stats.in_flight_recv_num = recv_counter_.in_flight_num.load();
+  stats.max_in_flight_recv_num = recv_counter_.max_in_flight_num.load();
+  stats.coalesced_send_num = coalesced_send_num_.load();
+  stats.coalesced_buffer_num = coalesced_buffer_num_.load();
+  return stats;
+}
+
+Transport::TokenStripe* Transport::GetTokenStripe(uint64_t token) {
+  // Tokens differ mostly in a few bit fields, so mix them before picking a stripe.
+  return &token_stripes_[((token * 0x9E3779B97F4A7C15ULL) >> 32) % kTokenStripeNum];
 }
 
 void Transport::EnqueueTransportMsg(const TransportMsg& msg) {
@@ -56,6 +160,14 @@ void Transport::PollMsgChannel() {
         HandlerAchievedTransportAckMsgFromDstMachine(msg);
         break;
       }
+      case TransportMsgType::kCoalescedSend: {
+        HandlerAchievedCoalescedSendMsgFromSrcMachine(msg);
+        break;
+      }
+      case TransportMsgType::kCoalescedAck: {
+        HandlerAchievedCoalescedAckMsgFromDstMachine(msg);
+        break;
+      }
       default: UNIMPLEMENTED(); break;
     }
   }
@@ -74,8 +186,8 @@ void Transport::HandlerAchievedTransportSendMsgFromSrcMachine(const TransportMsg
   // There are two ways to trigger the creation of TransportStatus:
   //   1. The time (T_A) when the dst machine receives SendMsg from src machine
   //   2. The time (T_B) when method Receive() called by the dst machine.
-  // Because of T_ A and t_ B are both protected by the lock(status_mutex_), so the creation of
-  // TransportStatus will NOT trigger at the same time.
+  // Because of T_ A and t_ B are both protected by the lock of the token stripe, so the creation
+  // of TransportStatus will NOT trigger at the same time.
   //
   // T_ A maybe earlier than t_ B, maybe later.
   //
@@ -85,15 +197,16 @@ void Transport::HandlerAchievedTransportSendMsgFromSrcMachine(const TransportMsg
   // prepare transport status for this token.
   // store callback.
   TransportStatus* stat = nullptr;
+  TokenStripe* stripe = GetTokenStripe(token);
 
   // if recv_before_send is true, it means the Receive() method has been called before this handler
   bool recv_before_send = false;
   {
-    std::unique_lock<std::mutex> lock(status_mutex_);
-    auto it = token2status_.find(token);
-    if (it == token2status_.end()) {
-      token2status_.emplace(token, TransportStatus(token));
-      stat = &(token2status_.at(token));
+    std::unique_lock<std::mutex> lock(stripe->mutex);
+    auto it = stripe->token2status.find(token);
+    if (it == stripe->token2status.end()) {
+      stripe->token2status.emplace(token, TransportStatus(token));
+      stat = &(stripe->token2status.at(token));
 
       // init stat
       // These three members must be initialized in the block protected by lock
@@ -134,12 +247,13 @@ void Transport::HandlerAchievedTransportAckMsgFromDstMachine(const TransportMsg&
   uint64_t token = msg.token;
   CHECK(token != -1);
   std::function<void()> callback;
+  TokenStripe* stripe = GetTokenStripe(token);
 
   // get status from map
   {
-    std::unique_lock<std::mutex> lock(status_mutex_);
-    auto it = token2status_.find(token);
-    CHECK(it != token2status_.end());
+    std::unique_lock<std::mutex> lock(stripe->mutex);
+    auto it = stripe->token2status.find(token);
+    CHECK(it != stripe->token2status.end());
     TransportStatus* stat = &(it->second);
 
     // check msg == stat
@@ -152,7 +266,7 @@ void Transport::HandlerAchievedTransportAckMsgFromDstMachine(const TransportMsg&
     callback = stat->callback;
 
     // Recovery status
-    token2status_.erase(it);
+    stripe->token2status.erase(it);
   }
 
   // UnRegisterMemory
@@ -165,6 +279,7 @@ void Transport::HandlerAchievedTransportAckMsgFromDstMachine(const TransportMsg&
 void Transport::Send(uint64_t token, int64_t dst_machine_id, const void* ptr, std::size_t size,
                      std::function<void()> callback) {
   void* mut_ptr = const_cast<void*>(ptr);
+  callback = send_counter_.Track(size, std::move(callback));
 
   // handler for send to local machine
   if (dst_machine_id == this_machine_id_) {
@@ -172,15 +287,22 @@ void Transport::Send(uint64_t token, int64_t dst_machine_id, const void* ptr, st
     return;
   }
 
+  if (coalesce_max_msg_size_ > 0 && size <= coalesce_max_msg_size_) {
+    SendCoalesced(token, dst_machine_id, ptr, size);
+    callback();
+    return;
+  }
+
   // prepare transport status for this token.
   // store callback.
   TransportStatus* stat = nullptr;
+  TokenStripe* stripe = GetTokenStripe(token);
   {
-    std::unique_lock<std::mutex> lock(status_mutex_);
-    CHECK(token2status_.find(token)
-          == token2status_.end());  // this token must be first add to status
-    token2status_.emplace(token, TransportStatus(token));
-    stat = &(token2status_.at(token));
+    std::unique_lock<std::mutex> lock(stripe->mutex);
+    CHECK(stripe->token2status.find(token)
+          == stripe->token2status.end());  // this token must be first add to status
+    stripe->token2status.emplace(token, TransportStatus(token));
+    stat = &(stripe->token2status.at(token));
   }
   stat->callback = callback;
   stat->is_send_ready = true;
@@ -205,6 +327,7 @@ void Transport::Send(uint64_t token, int64_t dst_machine_id, const void* ptr, st
 
 void Transport::Receive(uint64_t token, int64_t src_machine_id, void* ptr, std::size_t max_size,
                         std::function<void()> callback) {
+  callback = recv_counter_.Track(max_size, std::move(callback));
   // handler for receive from local machine
   if (src_machine_id == this_machine_id_) {
     RecvFromLocalMachine(token, ptr, max_size, callback);
@@ -215,14 +338,28 @@ void Transport::Receive(uint64_t token, int64_t src_machine_id, void* ptr, std::
   // store callback.
   TransportStatus* stat = nullptr;
 
+  TokenStripe* stripe = GetTokenStripe(token);
+
   // if recv_before_send is true, it means the SendMsg has been handled before this Receive called.
   bool send_before_recv = false;
   {
-    std::unique_lock<std::mutex> lock(status_mutex_);
-    auto it = token2status_.find(token);
-    if (it == token2status_.end()) {
-      token2status_.emplace(token, TransportStatus(token));
-      stat = &(token2status_.at(token));
+    std::unique_lock<std::mutex> lock(stripe->mutex);
+    auto payload_it = stripe->token2coalesced_payload.find(token);
+    if (payload_it != stripe->token2coalesced_payload.end()) {
+      // The coalesced send of this token has arrived before this Receive called.
+      CoalescedPayload payload = std::move(payload_it->second);
+      stripe->token2coalesced_payload.erase(payload_it);
+      lock.unlock();
+      CHECK_EQ(payload.src_machine_id, src_machine_id);
+      CHECK_LE(payload.data.size(), max_size);
+      if (!payload.data.empty()) { std::memcpy(ptr, payload.data.data(), payload.data.size()); }
+      callback();
+      return;
+    }
+    auto it = stripe->token2status.find(token);
+    if (it == stripe->token2status.end()) {
+      stripe->token2status.emplace(token, TransportStatus(token));
+      stat = &(stripe->token2status.at(token));
 
       // init stat
       // These three members must be initialized in the block protected by lock
@@ -256,10 +393,11 @@ void Transport::Receive(uint64_t token, int64_t src_machine_id, void* ptr, std::
 
 void Transport::DoRead(uint64_t token) {
   TransportStatus* stat = nullptr;
+  TokenStripe* stripe = GetTokenStripe(token);
   {
-    std::unique_lock<std::mutex> lock(status_mutex_);
-    auto it = token2status_.find(token);
-    CHECK(it != token2status_.end());
+    std::unique_lock<std::mutex> lock(stripe->mutex);
+    auto it = stripe->token2status.find(token);
+    CHECK(it != stripe->token2status.end());
     stat = &(it->second);
 
     // dst_mem_token MUST init in the block protected by lock
@@ -275,7 +413,7 @@ void Transport::DoRead(uint64_t token) {
   CHECK(stat->size != -1);
   CHECK(stat->callback);
   comm_net_->Read(read_id_, stat->src_machine_id, stat->src_mem_token, stat->dst_mem_token);
-  comm_net_->AddReadCallBack(read_id_, [stat, this]() {
+  comm_net_->AddReadCallBack(read_id_, [stat, stripe, this]() {
     // Send ack message to source machine
     TransportMsg msg;
     msg.token = stat->token;
@@ -295,10 +433,10 @@ void Transport::DoRead(uint64_t token) {
 
     // Recovery status
     {
-      std::unique_lock<std::mutex> lock(status_mutex_);
-      auto it = token2status_.find(stat->token);
-      CHECK(it != token2status_.end());
-      token2status_.erase(it);
+      std::unique_lock<std::mutex> lock(stripe->mutex);
+      auto it = stripe->token2status.find(stat->token);
+      CHECK(it != stripe->token2status.end());
+      stripe->token2status.erase(it);
     }
   });
 }
@@ -309,12 +447,14 @@ void Transport::SendToLocalMachine(uint64_t token, void* ptr, std::size_t size,
   bool need_do_callback = false;
   std::function<void()> receive_callback;
   void* dst_ptr = nullptr;
+  TokenStripe* stripe = GetTokenStripe(token);
   {
-    std::unique_lock<std::mutex> lock(local_copy_lock_);
-    auto it = token2local_copy_status_.find(token);
-    if (it == token2local_copy_status_.end()) {
+    std::unique_lock<std::mutex> lock(stripe->mutex);
+    auto it = stripe->token2local_copy_status.find(token);
+    if (it == stripe->token2local_copy_status.end()) {
       // init local copy status
-      token2local_copy_status_.emplace(token, CopyStatusOnLocalMachine(token, ptr, size, callback));
+      stripe->token2local_copy_status.emplace(token,
+                                              CopyStatusOnLocalMachine(token, ptr, size, callback));
     } else {
       need_do_callback = true;
       receive_callback = std::move(it->second.callback);
@@ -325,7 +465,7 @@ void Transport::SendToLocalMachine(uint64_t token, void* ptr, std::size_t size,
       if (ptr != dst_ptr) { need_do_copy = true; }
 
       // erase local copy status
-      token2local_copy_status_.erase(it);
+      stripe->token2local_copy_status.erase(it);
     }
   }
 
@@ -344,13 +484,14 @@ void Transport::RecvFromLocalMachine(uint64_t token, void* ptr, std::size_t max_
   std::function<void()> send_callback;
   void* src_ptr = nullptr;
   std::size_t size = -1;
+  TokenStripe* stripe = GetTokenStripe(token);
   {
-    std::unique_lock<std::mutex> lock(local_copy_lock_);
-    auto it = token2local_copy_status_.find(token);
-    if (it == token2local_copy_status_.end()) {
+    std::unique_lock<std::mutex> lock(stripe->mutex);
+    auto it = stripe->token2local_copy_status.find(token);
+    if (it == stripe->token2local_copy_status.end()) {
       // init local copy status
-      token2local_copy_status_.emplace(token,
-                                       CopyStatusOnLocalMachine(token, ptr, max_size, callback));
+      stripe->token2local_copy_status.emplace(
+          token, CopyStatusOnLocalMachine(token, ptr, max_size, callback));
     } else {
       need_do_callback = true;
       send_callback = std::move(it->second.callback);
@@ -362,7 +503,7 @@ void Transport::RecvFromLocalMachine(uint64_t token, void* ptr, std::size_t max_
       if (ptr != src_ptr) { need_do_copy = true; }
 
       // erase local copy status
-      token2local_copy_status_.erase(it);
+      stripe->token2local_copy_status.erase(it);
     }
   }
 
@@ -374,6 +515,115 @@ void Transport::RecvFromLocalMachine(uint64_t token, void* ptr, std::size_t max_
   }
 }
 
+void Transport::SendCoalesced(uint64_t token, int64_t dst_machine_id, const void* ptr,
+                              std::size_t size) {
+  CoalescingQueue* queue = dst_machine_id2coalescing_queue_.at(dst_machine_id).get();
+  bool need_flush = false;
+  {
+    std::unique_lock<std::mutex> lock(queue->mutex);
+    AppendCoalescedEntry(&queue->pending, token, ptr, size);
+    queue->pending_num += 1;
+    if (!queue->is_in_flight) {
+      queue->is_in_flight = true;
+      need_flush = true;
+    }
+  }
+  if (need_flush) { FlushCoalescedSends(dst_machine_id); }
+}
+
+void Transport::FlushCoalescedSends(int64_t dst_machine_id) {
+  CoalescingQueue* queue = dst_machine_id2coalescing_queue_.at(dst_machine_id).get();
+  TransportMsg msg;
+  {
+    std::unique_lock<std::mutex> lock(queue->mutex);
+    CHECK(queue->is_in_flight);
+    CHECK(!queue->pending.empty());
+    CHECK(queue->in_flight.empty());
+    queue->in_flight.swap(queue->pending);
+    coalesced_send_num_.fetch_add(queue->pending_num, std::memory_order_relaxed);
+    queue->pending_num = 0;
+    queue->in_flight_mem_token =
+        comm_net_->RegisterMemory(queue->in_flight.data(), queue->in_flight.size());
+    msg.token = -1;
+    msg.src_machine_id = this_machine_id_;
+    msg.dst_machine_id = dst_machine_id;
+    msg.size = queue->in_flight.size();
+    msg.src_mem_token = queue->in_flight_mem_token;
+    msg.dst_mem_token = nullptr;
+    msg.type = TransportMsgType::kCoalescedSend;
+  }
+  coalesced_buffer_num_.fetch_add(1, std::memory_order_relaxed);
+  comm_net_->SendTransportMsg(dst_machine_id, msg);
+}
+
+void Transport::HandlerAchievedCoalescedSendMsgFromSrcMachine(const TransportMsg& msg) {
+  // This machine is dst machine. Read the whole buffer, ack it so that the src machine can send
+  // the next one, then hand every entry over to its Receive().
+  CHECK_EQ(msg.type, TransportMsgType::kCoalescedSend);
+  CHECK(msg.src_mem_token != nullptr);
+  CHECK_EQ(msg.dst_machine_id, this_machine_id_);
+  auto* buffer = new std::vector<char>(msg.size);
+  void* dst_mem_token = comm_net_->RegisterMemory(buffer->data(), buffer->size());
+  comm_net_->Read(read_id_, msg.src_machine_id, msg.src_mem_token, dst_mem_token);
+  comm_net_->AddReadCallBack(read_id_, [msg, buffer, dst_mem_token, this]() {
+    TransportMsg ack_msg = msg;
+    ack_msg.dst_mem_token = dst_mem_token;
+    ack_msg.type = TransportMsgType::kCoalescedAck;
+    comm_net_->SendTransportMsg(msg.src_machine_id, ack_msg);
+    comm_net_->UnRegisterMemory(dst_mem_token);
+    ForEachCoalescedEntry(*buffer, [&](uint64_t token, const char* data, std::size_t size) {
+      DeliverCoalescedSend(token, msg.src_machine_id, data, size);
+    });
+    delete buffer;
+  });
+}
+
+void Transport::HandlerAchievedCoalescedAckMsgFromDstMachine(const TransportMsg& msg) {
+  CHECK_EQ(msg.type, TransportMsgType::kCoalescedAck);
+  CHECK_EQ(msg.src_machine_id, this_machine_id_);
+  CoalescingQueue* queue = dst_machine_id2coalescing_queue_.at(msg.dst_machine_id).get();
+  bool need_flush = false;
+  {
+    std::unique_lock<std::mutex> lock(queue->mutex);
+    CHECK(queue->is_in_flight);
+    CHECK_EQ(queue->in_flight_mem_token, msg.src_mem_token);
+    comm_net_->UnRegisterMemory(queue->in_flight_mem_token);
+    queue->in_flight_mem_token = nullptr;
+    queue->in_flight.clear();
+    if (queue->pending.empty()) {
+      queue->is_in_flight = false;
+    } else {
+      need_flush = true;
+    }
+  }
+  if (need_flush) { FlushCoalescedSends(msg.dst_machine_id); }
+}
+
+void Transport::DeliverCoalescedSend(uint64_t token, int64_t src_machine_id, const char* data,
+                                     std::size_t size) {
+  std::function<void()> callback;
+  TokenStripe* stripe = GetTokenStripe(token);
+  {
+    std::unique_lock<std::mutex> lock(stripe->mutex);
+    auto it = stripe->token2status.find(token);
+    if (it == stripe->token2status.end()) {
+      // Receive() has not been called yet, keep the data until it is.
+      CoalescedPayload payload{src_machine_id, std::vector<char>(data, data + size)};
+      CHECK(stripe->token2coalesced_payload.emplace(token, std::move(payload)).second);
+      return;
+    }
+    TransportStatus* stat = &(it->second);
+    CHECK(stat->is_recv_ready);
+    CHECK(!stat->is_send_ready);
+    CHECK_EQ(stat->src_machine_id, src_machine_id);
+    CHECK_LE(size, stat->size);  // NOTE(chengcheng): Recv size may larger than Send size.
+    if (size > 0) { std::memcpy(stat->dst_ptr, data, size); }
+    callback = std::move(stat->callback);
+    stripe->token2status.erase(it);
+  }
+  callback();
+}
+
 }  // namespace oneflow
 
 #endif  // __linux__
@@ -45,6 +45,31 @@ namespace oneflow {
 //
 // Transport supports send and receive data on local machine.
 //
+// Sends of at most ONEFLOW_TRANSPORT_COALESCE_MAX_MSG_SIZE bytes to a remote machine skip the
+// per-token handshake: the data is copied into a buffer of the dst machine, and all small sends
+// queued for that machine while its previous buffer is in flight leave as one CommNet transfer.
+// The send callback runs once the data is copied.
+//
+struct TransportStats {
+  double elapsed_seconds;
+  int64_t send_num;
+  int64_t send_bytes;
+  int64_t recv_num;
+  // Receive() only knows the max size of its buffer.
+  int64_t recv_bytes;
+  // From Send() / Receive() until the callback runs.
+  double avg_send_latency_us;
+  double avg_recv_latency_us;
+  int64_t in_flight_send_num;
+  int64_t max_in_flight_send_num;
+  int64_t in_flight_recv_num;
+  int64_t max_in_flight_recv_num;
+  int64_t coalesced_send_num;
+  int64_t coalesced_buffer_num;
+
+  std::string ToString() const;
+};
+
 class Transport {
  public:
   OF_DISALLOW_COPY_AND_MOVE(Transport);
@@ -56,6 +81,8 @@ class Transport {
                std::function<void()> callback);
   void EnqueueTransportMsg(const TransportMsg& msg);
 
+  TransportStats GetStats() const;
+
  private:
   void PollMsgChannel();
   void HandlerAchievedTransportSendMsgFromSrcMachine(const TransportMsg& msg);
@@ -65,6 +92,12 @@ class Transport {
                           std::function<void()> callback);
   void RecvFromLocalMachine(uint64_t token, void* ptr, std::size_t max_size,
                             std::function<void()> callback);
+  void SendCoalesced(uint64_t token, int64_t dst_machine_id, const void* ptr, std::size_t size);
+  void FlushCoalescedSends(int64_t dst_machine_id);
+  void HandlerAchievedCoalescedSendMsgFromSrcMachine(const TransportMsg& msg);
+  void HandlerAchievedCoalescedAckMsgFromDstMachine(const TransportMsg& msg);
+  void DeliverCoalescedSend(uint64_t token, int64_t src_machine_id, const char* data,
+                            std::size_t size);
 
   // TODO(chengcheng)
   // Singleton<Transport> has a dependency on Singleton<CommNet> which should be initialized first.
@@ -120,14 +153,56 @@ class Transport {
         : token(tk), ptr(p), size(s), callback(std::move(cb)) {}
   };
 
-  // Store the TransportStatus for each token (Send/Receive pair).
-  // The map token2status_ should be protected by status_mutex_ when you want to change it.
-  std::mutex status_mutex_;
-  HashMap<uint64_t, TransportStatus> token2status_;
+  // The data of a coalesced send that arrived before the matching Receive() was called.
+  struct CoalescedPayload {
+    int64_t src_machine_id;
+    std::vector<char> data;
+  };
+
+  // The token tables are striped by token so that unrelated transfers do not contend for one
+  // lock. All maps of a stripe are protected by its mutex.
+  struct alignas(64) TokenStripe {
+    std::mutex mutex;
+    // Store the TransportStatus for each token (Send/Receive pair).
+    HashMap<uint64_t, TransportStatus> token2status;
+    // for local copy
+    HashMap<uint64_t, CopyStatusOnLocalMachine> token2local_copy_status;
+    HashMap<uint64_t, CoalescedPayload> token2coalesced_payload;
+  };
+  static constexpr size_t kTokenStripeNum = 64;
+  TokenStripe* GetTokenStripe(uint64_t token);
+
+  // Small sends to one dst machine. At most one buffer per dst machine is in flight, the sends
+  // issued meanwhile accumulate in `pending` and leave together once the in-flight one is acked.
+  struct CoalescingQueue {
+    std::mutex mutex;
+    std::vector<char> pending;
+    int64_t pending_num = 0;
+    std::vector<char> in_flight;
+    void* in_flight_mem_token = nullptr;
+    bool is_in_flight = false;
+  };
+
+  // Counts Send()s or Receive()s and times each of them until its callback runs.
+  struct Counter {
+    std::function<void()> Track(std::size_t size, std::function<void()> callback);
+
+    std::atomic<int64_t> num{0};
+    std::atomic<int64_t> bytes{0};
+    std::atomic<int64_t> latency_us{0};
+    std::atomic<int64_t> in_flight_num{0};
+    std::atomic<int64_t> max_in_flight_num{0};
+  };
+
+  std::array<TokenStripe, kTokenStripeNum> token_stripes_;
+  std::vector<std::unique_ptr<CoalescingQueue>> dst_machine_id2coalescing_queue_;
+  std::size_t coalesce_max_msg_size_;
 
-  // for local copy
-  std::mutex local_copy_lock_;
-  HashMap<uint64_t, CopyStatusOnLocalMachine> token2local_copy_status_;
+  std::chrono::steady_clock::time_point start_time_;
+  Counter send_counter_;
+  Counter recv_counter_;
+  std::atomic<int64_t> coalesced_send_num_{0};
+  std::atomic<int64_t> coalesced_buffer_num_{0};
 
   int64_t this_machine_id_;
   void* read_id_;
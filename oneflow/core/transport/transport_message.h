@@ -27,6 +27,10 @@ enum class TransportMsgType {
   kInvalid = 0,
   kSend = 1,  // send msg from local to remote transport
   kAck = 2,   // this token transmission task is down
+  // A buffer of small sends coalesced for one dst machine; token is unused, size is the buffer
+  // size and src_mem_token the registered buffer.
+  kCoalescedSend = 3,
+  kCoalescedAck = 4,  // the dst machine has read the coalesced buffer
 };
 
 struct TransportMsg {
@@ -0,0 +1,174 @@
+/*
+Copyright 2020 The OneFlow Authors. All rights reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+#if defined(RPC_BACKEND_GRPC) && defined(__linux__)
+
+#include <gtest/gtest.h>
+#include "oneflow/core/common/blocking_counter.h"
+#include "oneflow/core/control/ctrl_client.h"
+#include "oneflow/core/control/multi_process_test_util.h"
+#include "oneflow/core/transport/transport.h"
+
+namespace oneflow {
+
+namespace test {
+
+namespace {
+
+constexpr size_t kCoalesceMaxMsgSize = 1024;
+
+// Tokens of different directions must differ, or a machine would mix up the status of its own
+// send with that of a receive of the same token.
+uint64_t TestToken(int64_t src_rank, int64_t dst_rank, int64_t idx) {
+  return (static_cast<uint64_t>(src_rank) << 48) | (static_cast<uint64_t>(dst_rank) << 32)
+         | static_cast<uint64_t>(idx);
+}
+
+char ByteAt(uint64_t token, size_t size, size_t offset) {
+  return static_cast<char>(token * 131 + size * 31 + offset * 7 + 3);
+}
+
+// Every rank sends a message of each of `sizes` to every rank including itself, and receives
+// the ones of every rank into buffers a bit larger than needed, all in flight at once. Checks
+// that every callback runs exactly once and the bytes. The message `i` goes with token index
+// `idx_offset + i`. Returns the number of sends of this rank that should have been coalesced.
+int64_t ExchangeMessages(int64_t rank, int64_t world_size, const std::vector<size_t>& sizes,
+                         int64_t idx_offset, size_t coalesce_max_msg_size) {
+  auto* transport = Singleton<Transport>::Get();
+  const size_t msg_num = sizes.size() * world_size;
+  std::vector<std::vector<char>> src_buffers;
+  std::vector<std::vector<char>> dst_buffers;
+  std::vector<std::atomic<int64_t>> send_done_cnts(msg_num);
+  std::vector<std::atomic<int64_t>> recv_done_cnts(msg_num);
+  BlockingCounter done_cnt(2 * msg_num);
+  int64_t coalesced_num = 0;
+  FOR_RANGE(int64_t, peer, 0, world_size) {
+    FOR_RANGE(size_t, i, 0, sizes.size()) {
+      const uint64_t token = TestToken(rank, peer, idx_offset + i);
+      src_buffers.emplace_back(sizes.at(i));
+      auto& src = src_buffers.back();
+      FOR_RANGE(size_t, j, 0, src.size()) { src[j] = ByteAt(token, src.size(), j); }
+      dst_buffers.emplace_back(sizes.at(i) + 16, 0);
+      if (peer != rank && sizes.at(i) <= coalesce_max_msg_size) { ++coalesced_num; }
+    }
+  }
+  // Post the sends and receives of the peers in turn, so that coalesced and regular messages
+  // to one machine interleave, and a receive meets its message both before and after arrival.
+  FOR_RANGE(int64_t, peer, 0, world_size) {
+    FOR_RANGE(size_t, i, 0, sizes.size()) {
+      const size_t msg_idx = peer * sizes.size() + i;
+      send_done_cnts.at(msg_idx) = 0;
+      recv_done_cnts.at(msg_idx) = 0;
+      const auto& src = src_buffers.at(msg_idx);
+      auto& dst = dst_buffers.at(msg_idx);
+      const auto Send = [&, msg_idx]() {
+        transport->Send(TestToken(rank, peer, idx_offset + i), peer, src.data(), src.size(),
+                        [&, msg_idx]() {
+                          send_done_cnts.at(msg_idx).fetch_add(1);
+                          done_cnt.Decrease();
+                        });
+      };
+      const auto Receive = [&, msg_idx]() {
+        transport->Receive(TestToken(peer, rank, idx_offset + i), peer, dst.data(), dst.size(),
+                           [&, msg_idx]() {
+                             recv_done_cnts.at(msg_idx).fetch_add(1);
+                             done_cnt.Decrease();
+                           });
+      };
+      if (i % 2 == 0) {
+        Send();
+        Receive();
+      } else {
+        Receive();
+        Send();
+      }
+    }
+  }
+  done_cnt.WaitForeverUntilCntEqualZero();
+  FOR_RANGE(int64_t, peer, 0, world_size) {
+    FOR_RANGE(size_t, i, 0, sizes.size()) {
+      const size_t msg_idx = peer * sizes.size() + i;
+      EXPECT_EQ(send_done_cnts.at(msg_idx).load(), 1);
+      EXPECT_EQ(recv_done_cnts.at(msg_idx).load(), 1);
+      const uint64_t token = TestToken(peer, rank, idx_offset + i);
+      const auto& dst = dst_buffers.at(msg_idx);
+      size_t mismatch_cnt = 0;
+      FOR_RANGE(size_t, j, 0, sizes.at(i)) {
+        if (dst[j] != ByteAt(token, sizes.at(i), j)) { ++mismatch_cnt; }
+      }
+      FOR_RANGE(size_t, j, sizes.at(i), dst.size()) {
+        if (dst[j] != 0) { ++mismatch_cnt; }
+      }
+      EXPECT_EQ(mismatch_cnt, 0) << "message of " << sizes.at(i) << " bytes from rank " << peer;
+    }
+  }
+  // A peer may still be reading the source buffers of the regular sends.
+  OF_ENV_BARRIER();
+  return coalesced_num;
+}
+
+void TestCoalescedSends(int64_t rank, int64_t world_size, size_t coalesce_max_msg_size) {
+  const auto* transport = Singleton<Transport>::Get();
+  const TransportStats stats_before = transport->GetStats();
+  int64_t coalesced_num = 0;
+  int64_t idx_offset = 0;
+  // Sizes around the threshold, and many small messages so that some of them queue up behind
+  // the buffer in flight and leave only after it is acked.
+  std::vector<size_t> sizes{1, kCoalesceMaxMsgSize - 1, kCoalesceMaxMsgSize,
+                            kCoalesceMaxMsgSize + 1, 4 * 1024 * 1024 + 5};
+  // Only a coalesced message may be empty.
+  if (coalesce_max_msg_size > 0) { sizes.push_back(0); }
+  FOR_RANGE(size_t, i, 0, 512) { sizes.push_back(i % 3 == 0 ? 4 * kCoalesceMaxMsgSize : i); }
+  // Sends of the same sizes again and again, each round after the acks of the previous one.
+  const int64_t round_num = 4;
+  FOR_RANGE(int64_t, round, 0, round_num) {
+    coalesced_num += ExchangeMessages(rank, world_size, sizes, idx_offset, coalesce_max_msg_size);
+    idx_offset += sizes.size();
+  }
+  // One token carries a coalesced and a regular message in turn.
+  FOR_RANGE(int64_t, round, 0, round_num) {
+    const size_t size = round % 2 == 0 ? kCoalesceMaxMsgSize : kCoalesceMaxMsgSize + 1;
+    coalesced_num += ExchangeMessages(rank, world_size, {size}, idx_offset, coalesce_max_msg_size);
+  }
+  const TransportStats stats = transport->GetStats();
+  EXPECT_EQ(stats.coalesced_send_num - stats_before.coalesced_send_num, coalesced_num);
+  if (coalesced_num == 0) {
+    EXPECT_EQ(stats.coalesced_buffer_num, stats_before.coalesced_buffer_num);
+  } else {
+    EXPECT_GT(stats.coalesced_buffer_num, stats_before.coalesced_buffer_num);
+    EXPECT_LE(stats.coalesced_buffer_num - stats_before.coalesced_buffer_num, coalesced_num);
+  }
+  EXPECT_EQ(stats.in_flight_send_num, 0);
+  EXPECT_EQ(stats.in_flight_recv_num, 0);
+}
+
+}  // namespace
+
+TEST(Transport, coalesced_and_regular_sends) {
+  ScopedEnvs envs({{"ONEFLOW_TRANSPORT_COALESCE_MAX_MSG_SIZE",
+                    std::to_string(kCoalesceMaxMsgSize)}});
+  RunInMultiProcessEnv(3, [](int64_t rank) { TestCoalescedSends(rank, 3, kCoalesceMaxMsgSize); });
+}
+
+TEST(Transport, regular_sends_only) {
+  ScopedEnvs envs({{"ONEFLOW_TRANSPORT_COALESCE_MAX_MSG_SIZE", "0"}});
+  RunInMultiProcessEnv(2, [](int64_t rank) { TestCoalescedSends(rank, 2, 0); });
+}
+
+}  // namespace test
+
+}  // namespace oneflow
+
+#endif  // RPC_BACKEND_GRPC && __linux__
@@ -14,6 +14,7 @@ See the License for the specific language governing permissions and
 limitations under the License.
 */
 #include "oneflow/user/kernels/adaptive_pool_kernel_util.h"
+#include "oneflow/user/kernels/pool_cpu_kernel_util.h"
 
 namespace oneflow {
 
@@ -31,48 +32,9 @@ void AvgForwardCompute(user_op::KernelComputeContext* ctx, const int32_t& dim) {
   const Shape& in = GetShape5D(x_shape, data_format, dim);
   const Shape& out = GetShape5D(y_shape, data_format, dim);
 
-  const T* in_ptr = in_tensor->dptr<T>();
-  T* out_ptr = out_tensor->mut_dptr<T>();
-
-  const int64_t input_width = in.Count(4);
-  const int64_t output_width = out.Count(4);
-  const int64_t input_image_size = in.Count(3);
-  const int64_t output_image_size = out.Count(3);
-  const int64_t input_size = in.Count(2);
-  const int64_t output_size = out.Count(2);
-
-  FOR_RANGE(int64_t, n, 0, in.At(0)) {
-    FOR_RANGE(int64_t, c, 0, in.At(1)) {
-      FOR_RANGE(int64_t, od, 0, out.At(2)) {
-        int64_t id0 = start_index(od, out.At(2), in.At(2));
-        int64_t id1 = end_index(od, out.At(2), in.At(2));
-        int64_t kd = id1 - id0;
-        FOR_RANGE(int64_t, oh, 0, out.At(3)) {
-          int64_t ih0 = start_index(oh, out.At(3), in.At(3));
-          int64_t ih1 = end_index(oh, out.At(3), in.At(3));
-          int64_t kh = ih1 - ih0;
-          FOR_RANGE(int64_t, ow, 0, out.At(4)) {
-            int64_t iw0 = start_index(ow, out.At(4), in.At(4));
-            int64_t iw1 = end_index(ow, out.At(4), in.At(4));
-            int64_t kw = iw1 - iw0;
-
-            // Compute local average
-            T sum = static_cast<T>(0);
-            FOR_RANGE(int64_t, id, id0, id1) {
-              FOR_RANGE(int64_t, ih, ih0, ih1) {
-                FOR_RANGE(int64_t, iw, iw0, iw1) {
-                  sum += in_ptr[id * input_image_size + ih * input_width + iw];
-                }
-              }
-            }
-            out_ptr[od * output_image_size + oh * output_width + ow] = sum / kd / kh / kw;
-          }
-        }
-      }
-      in_ptr += input_size;
-      out_ptr += output_size;
-    }
-  }
+  PoolCpuKernelUtil<T>::AvgForward(ctx->stream()->As<ep::CpuStream>(),
+                                   MakeAdaptivePoolCpuProblem(in, out), false, 0,
+                                   in_tensor->dptr<T>(), out_tensor->mut_dptr<T>());
 }
 
 template<typename T>
@@ -87,49 +49,13 @@ void AvgBackwardCompute(user_op::KernelComputeContext* ctx, const int32_t& dim)
   const Shape& in = GetShape5D(dx_shape, data_format, dim);
   const Shape& out = GetShape5D(dy_shape, data_format, dim);
 
-  const T* out_ptr = grad_output->dptr<T>();
   T* in_ptr = grad_input->mut_dptr<T>();
-
   std::fill(in_ptr, in_ptr + grad_input->shape_view().elem_cnt(), static_cast<T>(0));
-
-  const int64_t input_width = in.Count(4);
-  const int64_t output_width = out.Count(4);
-  const int64_t input_image_size = in.Count(3);
-  const int64_t output_image_size = out.Count(3);
-  const int64_t input_size = in.Count(2);
-  const int64_t output_size = out.Count(2);
-
-  FOR_RANGE(int64_t, n, 0, in.At(0)) {
-    FOR_RANGE(int64_t, c, 0, in.At(1)) {
-      FOR_RANGE(int64_t, od, 0, out.At(2)) {
-        int64_t id0 = start_index(od, out.At(2), in.At(2));
-        int64_t id1 = end_index(od, out.At(2), in.At(2));
-        int64_t kd = id1 - id0;
-        FOR_RANGE(int64_t, oh, 0, out.At(3)) {
-          int64_t ih0 = start_index(oh, out.At(3), in.At(3));
-          int64_t ih1 = end_index(oh, out.At(3), in.At(3));
-          int64_t kh = ih1 - ih0;
-          FOR_RANGE(int64_t, ow, 0, out.At(4)) {
-            int64_t iw0 = start_index(ow, out.At(4), in.At(4));
-            int64_t iw1 = end_index(ow, out.At(4), in.At(4));
-            int64_t kw = iw1 - iw0;
-
-            T grad_delta = out_ptr[od * output_image_size + oh * output_width + ow] / kd / kh / kw;
-            FOR_RANGE(int64_t, id, id0, id1) {
-              FOR_RANGE(int64_t, ih, ih0, ih1) {
-                FOR_RANGE(int64_t, iw, iw0, iw1) {
-                  in_ptr[id * input_image_size + ih * input_width + iw] += grad_delta;
-                }
-              }
-            }
-          }
-        }
-      }
-      in_ptr += input_size;
-      out_ptr += output_size;
-    }
-  }
+  PoolCpuKernelUtil<T>::AvgBackward(ctx->stream()->As<ep::CpuStream>(),
+                                    MakeAdaptivePoolCpuProblem(in, out), false, 0,
+                                    grad_output->dptr<T>(), in_ptr);
 }
+
 }  // namespace
 
 template<DeviceType device_type, typename T>
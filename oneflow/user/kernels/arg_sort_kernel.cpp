@@ -14,7 +14,7 @@ See the License for the specific language governing permissions and
 limitations under the License.
 */
 #include "oneflow/core/framework/framework.h"
-#include "oneflow/core/kernel/new_kernel_util.h"
+#include "oneflow/user/kernels/sort_cpu_kernel_util.h"
 
 namespace oneflow {
 
@@ -28,36 +28,21 @@ class CpuArgSortKernel final : public user_op::OpKernel {
   void Compute(user_op::KernelComputeContext* ctx) const override {
     const user_op::Tensor* in = ctx->Tensor4ArgNameAndIndex("in", 0);
     user_op::Tensor* out = ctx->Tensor4ArgNameAndIndex("out", 0);
+    if (in->shape_view().elem_cnt() == 0) { return; }
 
-    const int32_t instance_size = in->shape_view().At(in->shape_view().NumAxes() - 1);
-    const int32_t instance_num = in->shape_view().elem_cnt() / instance_size;
+    const int64_t instance_size = in->shape_view().At(in->shape_view().NumAxes() - 1);
+    const int64_t instance_num = in->shape_view().elem_cnt() / instance_size;
     const std::string& direction = ctx->Attr<std::string>("direction");
     const bool is_ascending = direction == "ASCENDING";
     const bool is_descending = direction == "DESCENDING";
-    FOR_RANGE(int32_t, i, 0, instance_num) {
-      const T* in_ptr_i = in->dptr<T>() + i * instance_size;
-      int32_t* out_ptr_i = out->mut_dptr<int32_t>() + i * instance_size;
-      std::iota(out_ptr_i, out_ptr_i + instance_size, 0);
-      auto comp = [&](const int32_t lhs, const int32_t rhs) {
-        const T l = in_ptr_i[lhs];
-        const T r = in_ptr_i[rhs];
-        if (l == r) {
-          return lhs < rhs;
-        } else {
-          if (is_ascending) {
-            return l < r;
-          } else if (is_descending) {
-            return l > r;
-          } else {
-            LOG(FATAL) << "expected the input direction parameter value is \"ASCENDING\" or "
-                          "\"DESCENDING\", "
-                       << "but found the value is "
-                       << "\"" << direction << "\"";
-          }
-        }
-      };
-      std::sort(out_ptr_i, out_ptr_i + instance_size, comp);
+    if (!is_ascending && !is_descending) {
+      LOG(FATAL) << "expected the input direction parameter value is \"ASCENDING\" or "
+                    "\"DESCENDING\", "
+                 << "but found the value is "
+                 << "\"" << direction << "\"";
     }
+    SortCpuKernelUtil<T>::ArgSort(ctx->stream()->As<ep::CpuStream>(), in->dptr<T>(), instance_num,
+                                  instance_size, is_descending, out->mut_dptr<int32_t>());
   }
   bool AlwaysComputeWhenAllOutputsEmpty() const override { return false; }
 };
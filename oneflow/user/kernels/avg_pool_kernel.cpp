@@ -14,6 +14,7 @@ See the License for the specific language governing permissions and
 limitations under the License.
 */
 #include "oneflow/user/kernels/avg_pool_kernel_util.h"
+#include "oneflow/user/kernels/pool_cpu_kernel_util.h"
 
 namespace oneflow {
 
@@ -41,70 +42,71 @@ std::shared_ptr<AvgPoolOpKernelCache> CreateAvgOpKernelCache(user_op::KernelCach
   return cache;
 }
 
+namespace {
+
+PoolCpuProblem MakeAvgPoolCpuProblem(const AvgPoolParams3D& params_3d) {
+  return MakePoolCpuProblem(params_3d.data_format() == "channels_last", params_3d.GetXShape5D(),
+                            params_3d.GetYShape5D(), params_3d.pool_size_3d().data(),
+                            params_3d.stride_3d().data(), nullptr, params_3d.padding().data());
+}
+
+template<typename T>
+void AvgPoolCpuForward(ep::Stream* stream, const T* src, T* dest,
+                       const AvgPoolParams3D& params_3d) {
+  PoolCpuKernelUtil<T>::AvgForward(stream->As<ep::CpuStream>(), MakeAvgPoolCpuProblem(params_3d),
+                                   params_3d.count_include_pad(), params_3d.divisor_override(),
+                                   src, dest);
+}
+
+template<typename T>
+void AvgPoolCpuBackward(ep::Stream* stream, const T* src, T* dest,
+                        const AvgPoolParams3D& params_3d) {
+  PoolCpuKernelUtil<T>::AvgBackward(stream->As<ep::CpuStream>(),
+                                    MakeAvgPoolCpuProblem(params_3d),
+                                    params_3d.count_include_pad(), params_3d.divisor_override(),
+                                    src, dest);
+}
+
+}  // namespace
+
+// The cpu kernels run the pooling engine of pool_cpu_kernel_util.h, which does not need the index
+// helpers.
 template<typename T, typename IDX>
 struct AvgPoolKernelUtil<DeviceType::kCPU, T, IDX> {
   static void Avgpool1dForward(ep::Stream* stream, const NdIndexOffsetHelper<IDX, 2>& index_helper,
                                const IDX elem_num, const T* src, T* dest,
                                const AvgPoolParams3D& params_3d) {
-    Avgpool1dForwardCompute<T, IDX>(
-        index_helper, elem_num, src, dest, params_3d.padding()[2], params_3d.num_batch(),
-        params_3d.num_channel(), params_3d.GetXShape5D().At(4), params_3d.pool_size_3d()[2],
-        params_3d.stride_3d()[2], params_3d.count_include_pad(), params_3d.divisor_override());
+    AvgPoolCpuForward<T>(stream, src, dest, params_3d);
   }
 
   static void Avgpool1dBackward(ep::Stream* stream, const NdIndexOffsetHelper<IDX, 2>& index_helper,
                                 const IDX elem_num, const T* src, T* dest,
                                 const AvgPoolParams3D& params_3d) {
-    Avgpool1dBackwardCompute<T, IDX>(
-        index_helper, elem_num, src, dest, params_3d.padding()[2], params_3d.num_batch(),
-        params_3d.num_channel(), params_3d.GetXShape5D().At(4), params_3d.pool_size_3d()[2],
-        params_3d.stride_3d()[2], params_3d.count_include_pad(), params_3d.divisor_override());
+    AvgPoolCpuBackward<T>(stream, src, dest, params_3d);
   }
 
   static void Avgpool2dForward(ep::Stream* stream, const NdIndexOffsetHelper<IDX, 3>& index_helper,
                                const IDX elem_num, const T* src, T* dest,
                                const AvgPoolParams3D& params_3d) {
-    Avgpool2dForwardCompute<T, IDX>(
-        index_helper, elem_num, src, dest, params_3d.padding()[1], params_3d.padding()[2],
-        params_3d.num_batch(), params_3d.num_channel(), params_3d.GetXShape5D().At(3),
-        params_3d.GetXShape5D().At(4), params_3d.pool_size_3d()[1], params_3d.pool_size_3d()[2],
-        params_3d.stride_3d()[1], params_3d.stride_3d()[2], params_3d.count_include_pad(),
-        params_3d.divisor_override());
+    AvgPoolCpuForward<T>(stream, src, dest, params_3d);
   }
 
   static void Avgpool2dBackward(ep::Stream* stream, const NdIndexOffsetHelper<IDX, 3>& index_helper,
                                 const IDX elem_num, const T* src, T* dest,
                                 const AvgPoolParams3D& params_3d) {
-    Avgpool2dBackwardCompute<T, IDX>(
-        index_helper, elem_num, src, dest, params_3d.padding()[1], params_3d.padding()[2],
-        params_3d.num_batch(), params_3d.num_channel(), params_3d.GetXShape5D().At(3),
-        params_3d.GetXShape5D().At(4), params_3d.pool_size_3d()[1], params_3d.pool_size_3d()[2],
-        params_3d.stride_3d()[1], params_3d.stride_3d()[2], params_3d.count_include_pad(),
-        params_3d.divisor_override());
+    AvgPoolCpuBackward<T>(stream, src, dest, params_3d);
   }
 
   static void Avgpool3dForward(ep::Stream* stream, const NdIndexOffsetHelper<IDX, 4>& index_helper,
                                const IDX elem_num, const T* src, T* dest,
                                const AvgPoolParams3D& params_3d) {
-    Avgpool3dForwardCompute<T, IDX>(
-        index_helper, elem_num, src, dest, params_3d.padding()[0], params_3d.padding()[1],
-        params_3d.padding()[2], params_3d.num_batch(), params_3d.num_channel(),
-        params_3d.GetXShape5D().At(2), params_3d.GetXShape5D().At(3), params_3d.GetXShape5D().At(4),
-        params_3d.pool_size_3d()[0], params_3d.pool_size_3d()[1], params_3d.pool_size_3d()[2],
-        params_3d.stride_3d()[0], params_3d.stride_3d()[1], params_3d.stride_3d()[2],
-        params_3d.count_include_pad(), params_3d.divisor_override());
+    AvgPoolCpuForward<T>(stream, src, dest, params_3d);
   }
 
   static void Avgpool3dBackward(ep::Stream* stream, const NdIndexOffsetHelper<IDX, 4>& index_helper,
-                                const int64_t elem_num, const T* src, T* dest,
+                                const IDX elem_num, const T* src, T* dest,
                                 const AvgPoolParams3D& params_3d) {
-    Avgpool3dBackwardCompute<T, IDX>(
-        index_helper, elem_num, src, dest, params_3d.padding()[0], params_3d.padding()[1],
-        params_3d.padding()[2], params_3d.num_batch(), params_3d.num_channel(),
-        params_3d.GetXShape5D().At(2), params_3d.GetXShape5D().At(3), params_3d.GetXShape5D().At(4),
-        params_3d.pool_size_3d()[0], params_3d.pool_size_3d()[1], params_3d.pool_size_3d()[2],
-        params_3d.stride_3d()[0], params_3d.stride_3d()[1], params_3d.stride_3d()[2],
-        params_3d.count_include_pad(), params_3d.divisor_override());
+    AvgPoolCpuBackward<T>(stream, src, dest, params_3d);
   }
 };
 
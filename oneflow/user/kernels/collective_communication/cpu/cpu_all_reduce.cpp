@@ -14,11 +14,13 @@ See the License for the specific language governing permissions and
 limitations under the License.
 */
 #include "oneflow/core/common/data_type.h"
+#include "oneflow/core/control/global_process_ctx.h"
 #include "oneflow/core/job/rank_group.h"
 #include "oneflow/core/framework/transport_util.h"
 #include "oneflow/user/kernels/collective_communication/cpu/cpu_communication_context.h"
 #include "oneflow/user/kernels/collective_communication/include/all_reduce.h"
 #include "oneflow/user/kernels/collective_communication/cpu/cpu_collective_communication_util.h"
+#include "oneflow/user/kernels/collective_communication/cpu/cpu_shm_communicator.h"
 
 namespace oneflow {
 
@@ -26,6 +28,327 @@ namespace ccl {
 
 namespace {
 
+enum class AllReduceAlgo {
+  kRing,
+  kHalvingDoubling,
+  kTree,
+};
+
+// Rough figures for the socket transport; only their ratios steer the choice.
+constexpr double kLatencyPerStep = 30e-6;
+constexpr double kTimePerTransferredByte = 1.0 / 1e9;
+constexpr double kTimePerReducedByte = 1.0 / 4e9;
+// Ring parts are streamed in sub-chunks of about this size so that reducing one sub-chunk
+// overlaps with the transfer of the next.
+constexpr size_t kRingPipelineChunkSize = 256 * 1024;
+constexpr int64_t kMaxRingPipelineDepth = 16;
+
+int64_t FloorLog2(int64_t n) {
+  int64_t log2 = 0;
+  while ((int64_t{2} << log2) <= n) { ++log2; }
+  return log2;
+}
+
+AllReduceAlgo SelectAllReduceAlgo(size_t size, int64_t parallel_num) {
+  const std::string& algo = GetStringFromEnv("ONEFLOW_CPU_ALL_REDUCE_ALGO", "auto");
+  if (algo == "ring") { return AllReduceAlgo::kRing; }
+  if (algo == "halving_doubling") { return AllReduceAlgo::kHalvingDoubling; }
+  if (algo == "tree") { return AllReduceAlgo::kTree; }
+  const double n = parallel_num;
+  const double bytes = size;
+  // Pipelining hides the reduction behind the transfers.
+  const double ring_cost =
+      2 * (n - 1) * kLatencyPerStep + 2 * (n - 1) / n * bytes * kTimePerTransferredByte;
+  const int64_t log2 = FloorLog2(parallel_num);
+  const double p = int64_t{1} << log2;
+  double halving_doubling_cost = 2 * log2 * kLatencyPerStep
+                                 + 2 * (p - 1) / p * bytes * kTimePerTransferredByte
+                                 + (p - 1) / p * bytes * kTimePerReducedByte;
+  if (p < n) {
+    halving_doubling_cost += 2 * (kLatencyPerStep + bytes * kTimePerTransferredByte)
+                             + bytes * kTimePerReducedByte;
+  }
+  // Every level receives from two children on the way up and sends to two on the way down.
+  const double tree_cost =
+      log2 * (2 * kLatencyPerStep + 4 * bytes * kTimePerTransferredByte
+              + 2 * bytes * kTimePerReducedByte);
+  if (tree_cost <= halving_doubling_cost && tree_cost <= ring_cost) { return AllReduceAlgo::kTree; }
+  if (halving_doubling_cost <= ring_cost) { return AllReduceAlgo::kHalvingDoubling; }
+  return AllReduceAlgo::kRing;
+}
+
+std::unique_ptr<NaiveAsyncTransportCtx> NewTransportCtx(const TransportToken& transport_token,
+                                                        void* buffer, size_t size) {
+  const auto& Prepare = [buffer, size](void** out_buffer, std::size_t* out_size,
+                                       std::function<void()>* Cb) -> Maybe<void> {
+    *out_buffer = buffer;
+    *out_size = size;
+    *Cb = [] {};
+    return Maybe<void>::Ok();
+  };
+  return std::make_unique<NaiveAsyncTransportCtx>(transport_token, Prepare, Prepare);
+}
+
+// Transfers posted to the same peer are matched in posting order, so several of them can be in
+// flight at once. Each one is waited for at most once, either by Wait() or by WaitAll().
+class AsyncTransfers final {
+ public:
+  OF_DISALLOW_COPY_AND_MOVE(AsyncTransfers);
+  explicit AsyncTransfers(const TransportToken& transport_token)
+      : transport_token_(transport_token) {}
+  ~AsyncTransfers() = default;
+
+  Maybe<size_t> Send(int64_t rank, const void* buffer, size_t size) {
+    AsyncTransportCtx* ctx = Add(const_cast<void*>(buffer), size);
+    if (size > 0) { JUST(TransportUtil::SendDataToRank(rank, transport_token_, ctx)); }
+    return ctxs_.size() - 1;
+  }
+
+  Maybe<size_t> Recv(int64_t rank, void* buffer, size_t size) {
+    AsyncTransportCtx* ctx = Add(buffer, size);
+    if (size > 0) { JUST(TransportUtil::ReceiveDataFromRank(rank, transport_token_, ctx)); }
+    return ctxs_.size() - 1;
+  }
+
+  Maybe<void> Wait(size_t transfer_id) {
+    auto& ctx = ctxs_.at(transfer_id);
+    CHECK_OR_RETURN(ctx) << kOfBugIssueUploadPrompt;
+    JUST(ctx->WaitDone());
+    ctx.reset();
+    return Maybe<void>::Ok();
+  }
+
+  Maybe<void> WaitAll() {
+    for (auto& ctx : ctxs_) {
+      if (ctx) { JUST(ctx->WaitDone()); }
+    }
+    ctxs_.clear();
+    return Maybe<void>::Ok();
+  }
+
+ private:
+  AsyncTransportCtx* Add(void* buffer, size_t size) {
+    ctxs_.emplace_back(NewTransportCtx(transport_token_, buffer, size));
+    return ctxs_.back().get();
+  }
+
+  TransportToken transport_token_;
+  std::vector<std::unique_ptr<NaiveAsyncTransportCtx>> ctxs_;
+};
+
+template<typename T, ReduceType reduce_type>
+class TransportAllReduce final {
+ public:
+  OF_DISALLOW_COPY_AND_MOVE(TransportAllReduce);
+  TransportAllReduce(Symbol<RankGroup> rank_group, const TransportToken& transport_token)
+      : transport_token_(transport_token) {
+    CHECK_JUST(rank_group->ForEachRank([&](int64_t rank) -> Maybe<void> {
+      if (rank == GlobalProcessCtx::Rank()) { id_ = ranks_.size(); }
+      ranks_.emplace_back(rank);
+      return Maybe<void>::Ok();
+    }));
+  }
+  ~TransportAllReduce() = default;
+
+  Maybe<void> Call(const T* in, T* out, size_t elem_cnt) {
+    if (ranks_.size() == 1 || elem_cnt == 0) {
+      if (in != out) { std::memcpy(out, in, elem_cnt * sizeof(T)); }
+      return Maybe<void>::Ok();
+    }
+    switch (SelectAllReduceAlgo(elem_cnt * sizeof(T), ranks_.size())) {
+      case AllReduceAlgo::kRing: return PipelinedRing(in, out, elem_cnt);
+      case AllReduceAlgo::kHalvingDoubling: return HalvingDoubling(in, out, elem_cnt);
+      case AllReduceAlgo::kTree: return Tree(in, out, elem_cnt);
+    }
+    UNIMPLEMENTED_THEN_RETURN();
+  }
+
+ private:
+  int64_t num() const { return ranks_.size(); }
+
+  // Reduce-scatter followed by all-gather around the ring. Every part travels in sub-chunks:
+  // once a sub-chunk has arrived and been reduced it is forwarded right away, while the
+  // following sub-chunks are still on the wire.
+  Maybe<void> PipelinedRing(const T* in, T* out, size_t elem_cnt) {
+    const int64_t n = num();
+    const int64_t next = ranks_.at((id_ + 1) % n);
+    const int64_t prev = ranks_.at((id_ + n - 1) % n);
+    BalancedSplitter bs(elem_cnt, n);
+    const size_t max_part_elem_cnt = bs.At(0).size();
+    const int64_t sub_num = std::max<int64_t>(
+        1, std::min<int64_t>(kMaxRingPipelineDepth,
+                             max_part_elem_cnt * sizeof(T) / kRingPipelineChunkSize));
+    const auto& SubRange = [&](int64_t part_id, int64_t sub_id) -> Range {
+      const Range sub = BalancedSplitter(bs.At(part_id).size(), sub_num).At(sub_id);
+      return Range(bs.At(part_id).begin() + sub.begin(), bs.At(part_id).begin() + sub.end());
+    };
+    // Step `i` of the reduce-scatter sends part `id - i` and receives part `id - i - 1`.
+    auto recv_buffer = std::make_unique<T[]>(2 * max_part_elem_cnt);
+    AsyncTransfers sends(transport_token_);
+    AsyncTransfers recvs(transport_token_);
+    std::vector<std::vector<size_t>> pending(2, std::vector<size_t>(sub_num));
+    const auto& PostReduceScatterRecvs = [&](int64_t step) -> Maybe<void> {
+      const int64_t part_id = ((id_ - step - 1) % n + n) % n;
+      T* buffer = recv_buffer.get() + (step % 2) * max_part_elem_cnt;
+      for (int64_t j = 0; j < sub_num; ++j) {
+        const Range range = SubRange(part_id, j);
+        T* sub_buffer = buffer + range.begin() - bs.At(part_id).begin();
+        pending[step % 2][j] = JUST(recvs.Recv(prev, sub_buffer, range.size() * sizeof(T)));
+      }
+      return Maybe<void>::Ok();
+    };
+    JUST(PostReduceScatterRecvs(0));
+    for (int64_t j = 0; j < sub_num; ++j) {
+      const Range range = SubRange(id_, j);
+      JUST(sends.Send(next, in + range.begin(), range.size() * sizeof(T)));
+    }
+    for (int64_t step = 0; step < n - 1; ++step) {
+      if (step + 1 < n - 1) { JUST(PostReduceScatterRecvs(step + 1)); }
+      const int64_t part_id = ((id_ - step - 1) % n + n) % n;
+      const T* buffer = recv_buffer.get() + (step % 2) * max_part_elem_cnt;
+      for (int64_t j = 0; j < sub_num; ++j) {
+        JUST(recvs.Wait(pending[step % 2][j]));
+        const Range range = SubRange(part_id, j);
+        if (range.size() > 0) {
+          ReduceFunctor<T, reduce_type>::Call(range.size(), out + range.begin(), in + range.begin(),
+                                              buffer + range.begin() - bs.At(part_id).begin());
+        }
+        if (step + 1 < n - 1) {
+          JUST(sends.Send(next, out + range.begin(), range.size() * sizeof(T)));
+        }
+      }
+    }
+    JUST(sends.WaitAll());
+    JUST(recvs.WaitAll());
+    // Now this rank owns the reduced part `id + 1`. Step `i` of the all-gather sends part
+    // `id + 1 - i` and receives part `id - i` straight into `out`.
+    const auto& PostAllGatherRecvs = [&](int64_t step) -> Maybe<void> {
+      const int64_t part_id = ((id_ - step) % n + n) % n;
+      for (int64_t j = 0; j < sub_num; ++j) {
+        const Range range = SubRange(part_id, j);
+        pending[step % 2][j] =
+            JUST(recvs.Recv(prev, out + range.begin(), range.size() * sizeof(T)));
+      }
+      return Maybe<void>::Ok();
+    };
+    JUST(PostAllGatherRecvs(0));
+    for (int64_t j = 0; j < sub_num; ++j) {
+      const Range range = SubRange((id_ + 1) % n, j);
+      JUST(sends.Send(next, out + range.begin(), range.size() * sizeof(T)));
+    }
+    for (int64_t step = 0; step < n - 1; ++step) {
+      if (step + 1 < n - 1) { JUST(PostAllGatherRecvs(step + 1)); }
+      const int64_t part_id = ((id_ - step) % n + n) % n;
+      for (int64_t j = 0; j < sub_num; ++j) {
+        JUST(recvs.Wait(pending[step % 2][j]));
+        if (step + 1 < n - 1) {
+          const Range range = SubRange(part_id, j);
+          JUST(sends.Send(next, out + range.begin(), range.size() * sizeof(T)));
+        }
+      }
+    }
+    JUST(sends.WaitAll());
+    JUST(recvs.WaitAll());
+    return Maybe<void>::Ok();
+  }
+
+  // Recursive halving reduce-scatter and recursive doubling all-gather over the largest power
+  // of two ranks. The first 2 * (n - p) ranks are paired up beforehand: the even one of each
+  // pair hands its data to the odd one and gets the result back at the end.
+  Maybe<void> HalvingDoubling(const T* in, T* out, size_t elem_cnt) {
+    const int64_t n = num();
+    const int64_t p = int64_t{1} << FloorLog2(n);
+    const int64_t rem = n - p;
+    if (in != out) { std::memcpy(out, in, elem_cnt * sizeof(T)); }
+    auto tmp = std::make_unique<T[]>(elem_cnt);
+    AsyncTransfers transfers(transport_token_);
+    if (id_ < 2 * rem && id_ % 2 == 0) {
+      JUST(transfers.Send(ranks_.at(id_ + 1), out, elem_cnt * sizeof(T)));
+      JUST(transfers.WaitAll());
+      JUST(transfers.Recv(ranks_.at(id_ + 1), out, elem_cnt * sizeof(T)));
+      return transfers.WaitAll();
+    }
+    if (id_ < 2 * rem) {
+      JUST(transfers.Recv(ranks_.at(id_ - 1), tmp.get(), elem_cnt * sizeof(T)));
+      JUST(transfers.WaitAll());
+      ReduceFunctor<T, reduce_type>::Call(elem_cnt, out, tmp.get(), out);
+    }
+    const int64_t vid = id_ < 2 * rem ? id_ / 2 : id_ - rem;
+    const auto& Rank4Vid = [&](int64_t v) { return ranks_.at(v < rem ? 2 * v + 1 : v + rem); };
+    std::vector<Range> kept_ranges;
+    Range range(0, elem_cnt);
+    for (int64_t mask = p / 2; mask > 0; mask /= 2) {
+      const int64_t peer = Rank4Vid(vid ^ mask);
+      const int64_t mid = range.begin() + range.size() / 2;
+      const Range lower(range.begin(), mid);
+      const Range upper(mid, range.end());
+      const Range& keep = (vid & mask) ? upper : lower;
+      const Range& give = (vid & mask) ? lower : upper;
+      JUST(transfers.Send(peer, out + give.begin(), give.size() * sizeof(T)));
+      JUST(transfers.Recv(peer, tmp.get() + keep.begin(), keep.size() * sizeof(T)));
+      JUST(transfers.WaitAll());
+      if (keep.size() > 0) {
+        ReduceFunctor<T, reduce_type>::Call(keep.size(), out + keep.begin(), out + keep.begin(),
+                                            tmp.get() + keep.begin());
+      }
+      kept_ranges.emplace_back(range);
+      range = keep;
+    }
+    for (int64_t mask = 1; mask < p; mask *= 2) {
+      const int64_t peer = Rank4Vid(vid ^ mask);
+      const Range parent = kept_ranges.back();
+      kept_ranges.pop_back();
+      const Range peer_range = range.begin() == parent.begin()
+                                   ? Range(range.end(), parent.end())
+                                   : Range(parent.begin(), range.begin());
+      JUST(transfers.Send(peer, out + range.begin(), range.size() * sizeof(T)));
+      JUST(transfers.Recv(peer, out + peer_range.begin(), peer_range.size() * sizeof(T)));
+      JUST(transfers.WaitAll());
+      range = parent;
+    }
+    if (id_ < 2 * rem) {
+      JUST(transfers.Send(ranks_.at(id_ - 1), out, elem_cnt * sizeof(T)));
+      JUST(transfers.WaitAll());
+    }
+    return Maybe<void>::Ok();
+  }
+
+  // Reduce up a binary heap onto its root, then broadcast down; for latency bound sizes.
+  Maybe<void> Tree(const T* in, T* out, size_t elem_cnt) {
+    const int64_t n = num();
+    const size_t size = elem_cnt * sizeof(T);
+    std::vector<int64_t> children;
+    for (int64_t child = 2 * id_ + 1; child <= 2 * id_ + 2 && child < n; ++child) {
+      children.emplace_back(ranks_.at(child));
+    }
+    if (in != out) { std::memcpy(out, in, size); }
+    AsyncTransfers transfers(transport_token_);
+    auto tmp = std::make_unique<T[]>(children.size() * elem_cnt);
+    std::vector<size_t> child_transfer_ids;
+    for (int64_t i = 0; i < children.size(); ++i) {
+      child_transfer_ids.emplace_back(
+          JUST(transfers.Recv(children.at(i), tmp.get() + i * elem_cnt, size)));
+    }
+    for (int64_t i = 0; i < children.size(); ++i) {
+      JUST(transfers.Wait(child_transfer_ids.at(i)));
+      ReduceFunctor<T, reduce_type>::Call(elem_cnt, out, out, tmp.get() + i * elem_cnt);
+    }
+    JUST(transfers.WaitAll());
+    if (id_ > 0) {
+      const int64_t parent = ranks_.at((id_ - 1) / 2);
+      JUST(transfers.Send(parent, out, size));
+      JUST(transfers.Recv(parent, out, size));
+      JUST(transfers.WaitAll());
+    }
+    for (int64_t child : children) { JUST(transfers.Send(child, out, size)); }
+    return transfers.WaitAll();
+  }
+
+  std::vector<int64_t> ranks_;
+  int64_t id_;
+  TransportToken transport_token_;
+};
+
 template<typename T, ReduceType reduce_type>
 struct AllReduceImpl final {
   static Maybe<void> Call(const void* void_in, void* void_out, size_t elem_cnt,
@@ -37,92 +360,34 @@ struct AllReduceImpl final {
     }
     const T* in = reinterpret_cast<const T*>(void_in);
     T* out = reinterpret_cast<T*>(void_out);
-    BalancedSplitter bs(elem_cnt, parallel_num);
-    auto recv_buffer = std::make_unique<T[]>(bs.At(0).size());
-    Optional<int64_t> parallel_id;
-    JUST(GetTensorDevice4CurrentProcessCtx(parallel_desc, &parallel_id));
-    const auto& rank_group = JUST(RankGroup::New(parallel_desc));
     TransportToken transport_token =
         JUST(TransportToken::NewTransportToken(kTransportTokenTypeData));
-    for (int64_t i = 0, part_id = JUST(parallel_id); i < parallel_num - 1;
-         ++i, part_id = RingDecrease(part_id, parallel_num)) {
-      int64_t send_part_id = part_id;
-      const T* send_ptr = nullptr;
-      if (i == 0) {
-        send_ptr = &in[bs.At(send_part_id).begin()];
-      } else {
-        send_ptr = &out[bs.At(send_part_id).begin()];
-      }
-      size_t send_size = bs.At(send_part_id).size();
-      int64_t recv_part_id = RingDecrease(part_id, parallel_num);
-      T* recv_ptr = recv_buffer.get();
-      size_t recv_size = bs.At(recv_part_id).size();
-      NaiveAsyncTransportCtx ctx(
-          transport_token,
-          [&](void** buffer, std::size_t* size, std::function<void()>* Cb) -> Maybe<void> {
-            *buffer = const_cast<T*>(send_ptr);
-            *size = send_size * sizeof(T);
-            *Cb = [] {};
-            return Maybe<void>::Ok();
-          },
-          [&](void** buffer, std::size_t* size, std::function<void()>* Cb) -> Maybe<void> {
-            *buffer = recv_ptr;
-            *size = recv_size * sizeof(T);
-            *Cb = [] {};
-            return Maybe<void>::Ok();
-          });
-      if (send_size > 0) {
-        JUST(TransportUtil::SendToNextRankInRing(rank_group, transport_token, &ctx));
-      }
-      if (recv_size > 0) {
-        JUST(TransportUtil::ReceiveFromPrevRankInRing(rank_group, transport_token, &ctx));
-      }
-      JUST(ctx.WaitDone());
-      const T* cur_in = &in[bs.At(recv_part_id).begin()];
-      T* cur_out = &out[bs.At(recv_part_id).begin()];
-      if (recv_size > 0) {
-        ReduceFunctor<T, reduce_type>::Call(recv_size, cur_out, cur_in, recv_ptr);
-      }
+    CpuShmCommunicator* shm_comm = JUST(CpuShmCommunicator::Get(parallel_desc));
+    if (shm_comm == nullptr) {
+      return TransportAllReduce<T, reduce_type>(JUST(RankGroup::New(parallel_desc)),
+                                                transport_token)
+          .Call(in, out, elem_cnt);
     }
-    for (int64_t i = 0, part_id = RingIncrease(JUST(parallel_id), parallel_num);
-         i < parallel_num - 1; ++i, part_id = RingDecrease(part_id, parallel_num)) {
-      int64_t send_part_id = part_id;
-      const T* send_ptr = &out[bs.At(send_part_id).begin()];
-      size_t send_size = bs.At(send_part_id).size();
-      int64_t recv_part_id = RingDecrease(part_id, parallel_num);
-      T* recv_ptr = &out[bs.At(recv_part_id).begin()];
-      size_t recv_size = bs.At(recv_part_id).size();
-      NaiveAsyncTransportCtx ctx(
-          transport_token,
-          [&](void** buffer, std::size_t* size, std::function<void()>* Cb) -> Maybe<void> {
-            *buffer = const_cast<T*>(send_ptr);
-            *size = send_size * sizeof(T);
-            *Cb = [] {};
-            return Maybe<void>::Ok();
-          },
-          [&](void** buffer, std::size_t* size, std::function<void()>* Cb) -> Maybe<void> {
-            *buffer = recv_ptr;
-            *size = recv_size * sizeof(T);
-            *Cb = [] {};
-            return Maybe<void>::Ok();
-          });
-      if (send_size > 0) {
-        JUST(TransportUtil::SendToNextRankInRing(rank_group, transport_token, &ctx));
-      }
-      if (recv_size > 0) {
-        JUST(TransportUtil::ReceiveFromPrevRankInRing(rank_group, transport_token, &ctx));
-      }
-      JUST(ctx.WaitDone());
+    std::unique_lock<std::mutex> lock(*shm_comm->mutex());
+    if (!shm_comm->is_multi_node()) {
+      return ShmReduce<T, reduce_type>(shm_comm, in, out, elem_cnt, /*all_ranks_receive=*/true);
     }
-    return Maybe<void>::Ok();
+    // Reduce onto the leader of each node, all-reduce among the leaders and broadcast back, so
+    // that only one rank per node talks over the network.
+    JUST(ShmReduce<T, reduce_type>(shm_comm, in, out, elem_cnt, /*all_ranks_receive=*/false));
+    if (shm_comm->is_leader()) {
+      JUST(TransportAllReduce<T, reduce_type>(shm_comm->leader_rank_group(), transport_token)
+               .Call(out, out, elem_cnt));
+    }
+    return ShmBroadcast(shm_comm, out, out, elem_cnt * sizeof(T), /*root_local_id=*/0);
   }
 };
 
 #define MAKE_ALL_REDUCE_ENTRY(func_name, T, reduce_type) func_name<T, reduce_type>::Call
 
-DEFINE_STATIC_SWITCH_FUNC(Maybe<void>, AllReduceImpl, MAKE_ALL_REDUCE_ENTRY,  // NOLINT
-                          MAKE_DATA_TYPE_CTRV_SEQ(POD_DATA_TYPE_SEQ),         // NOLINT
-                          REDUCE_TYPE_CTRV_SEQ);                              // NOLINT
+DEFINE_STATIC_SWITCH_FUNC(Maybe<void>, AllReduceImpl, MAKE_ALL_REDUCE_ENTRY,   // NOLINT
+                          MAKE_DATA_TYPE_CTRV_SEQ(POD_AND_HALF_DATA_TYPE_SEQ),  // NOLINT
+                          REDUCE_TYPE_CTRV_SEQ);                               // NOLINT
 
 #undef MAKE_ALL_REDUCE_ENTRY
 
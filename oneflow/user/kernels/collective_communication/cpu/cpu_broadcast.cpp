@@ -16,14 +16,40 @@ limitations under the License.
 #include "oneflow/core/common/data_type.h"
 #include "oneflow/core/ccl/ccl.h"
 #include "oneflow/core/job/rank_group.h"
+#include "oneflow/core/control/global_process_ctx.h"
 #include "oneflow/core/framework/transport_util.h"
 #include "oneflow/user/kernels/collective_communication/cpu/cpu_communication_context.h"
+#include "oneflow/user/kernels/collective_communication/cpu/cpu_shm_communicator.h"
 #include "oneflow/user/kernels/collective_communication/include/broadcast.h"
 
 namespace oneflow {
 
 namespace ccl {
 
+namespace {
+
+Maybe<void> ShmHierarchicalBroadcast(CpuShmCommunicator* shm_comm, const void* in, void* out,
+                                     size_t buffer_size, int64_t root,
+                                     const TransportToken& transport_token) {
+  std::unique_lock<std::mutex> lock(*shm_comm->mutex());
+  int64_t root_local_id = shm_comm->LocalId4Rank(root);
+  if (!shm_comm->is_multi_node()) {
+    return ShmBroadcast(shm_comm, in, out, buffer_size, root_local_id);
+  }
+  // Send the data to one rank per node first, the root standing for its own node, then fan it
+  // out through shared memory.
+  const bool is_node_root =
+      root_local_id >= 0 ? GlobalProcessCtx::Rank() == root : shm_comm->is_leader();
+  if (root_local_id < 0) { root_local_id = 0; }
+  if (is_node_root) {
+    JUST(CpuBroadcast(in, out, buffer_size, root, JUST(shm_comm->InterNodeParallelDesc4Root(root)),
+                      transport_token));
+  }
+  return ShmBroadcast(shm_comm, out, out, buffer_size, root_local_id);
+}
+
+}  // namespace
+
 // Use CpuBroadcastImpl to avoid name conflict
 class CpuBroadcastImpl final : public Broadcast {
  public:
@@ -44,8 +70,14 @@ class CpuBroadcastImpl final : public Broadcast {
     size_t buffer_size = elem_cnt * size_of_dtype_;
     const auto& transport_token =
         CHECK_JUST(TransportToken::NewTransportToken(kTransportTokenTypeData));
-    CHECK_JUST(CpuBroadcast(in, out, buffer_size, root, cpu_communication_ctx->parallel_desc(),
-                            transport_token));
+    CpuShmCommunicator* shm_comm =
+        CHECK_JUST(CpuShmCommunicator::Get(cpu_communication_ctx->parallel_desc()));
+    if (shm_comm != nullptr) {
+      CHECK_JUST(ShmHierarchicalBroadcast(shm_comm, in, out, buffer_size, root, transport_token));
+    } else {
+      CHECK_JUST(CpuBroadcast(in, out, buffer_size, root, cpu_communication_ctx->parallel_desc(),
+                              transport_token));
+    }
   }
 
  private:
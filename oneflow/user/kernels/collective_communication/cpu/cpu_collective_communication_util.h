@@ -32,6 +32,8 @@ struct ReduceFunctor;
 
 template<typename T>
 struct ReduceFunctor<T, kSum> {
+  static T Apply(T a, T b) { return a + b; }
+
   static void Call(size_t size, T* out, const T* in0, const T* in1) {
     size_t thread_num = Singleton<ThreadPool>::Get()->thread_num();
     BalancedSplitter bs(size, thread_num);
@@ -44,18 +46,40 @@ struct ReduceFunctor<T, kSum> {
 
 template<typename T>
 struct ReduceFunctor<T, kMax> {
+  static T Apply(T a, T b) { return a < b ? b : a; }
+
   static void Call(size_t size, T* out, const T* in0, const T* in1) {
     size_t thread_num = Singleton<ThreadPool>::Get()->thread_num();
     BalancedSplitter bs(size, thread_num);
     MultiThreadLoop(thread_num, [&](size_t thread_idx) {
       size_t end = bs.At(thread_idx).end();
-      for (size_t i = bs.At(thread_idx).begin(); i < end; ++i) {
-        out[i] = std::max(in0[i], in1[i]);
-      }
+      for (size_t i = bs.At(thread_idx).begin(); i < end; ++i) { out[i] = Apply(in0[i], in1[i]); }
     });
   }
 };
 
+// Reduces `num_ins` inputs in index order, so every caller produces the same bits. `out` may
+// alias ins[0].
+template<typename T, ReduceType reduce_type>
+void MultiReduce(size_t size, T* out, const T* const* ins, size_t num_ins) {
+  constexpr size_t kBlockSize = 1024;
+  size_t thread_num = Singleton<ThreadPool>::Get()->thread_num();
+  BalancedSplitter bs(size, thread_num);
+  MultiThreadLoop(thread_num, [&](size_t thread_idx) {
+    const size_t end = bs.At(thread_idx).end();
+    for (size_t begin = bs.At(thread_idx).begin(); begin < end; begin += kBlockSize) {
+      const size_t block_end = std::min(begin + kBlockSize, end);
+      if (out != ins[0]) { std::copy(ins[0] + begin, ins[0] + block_end, out + begin); }
+      for (size_t j = 1; j < num_ins; ++j) {
+        const T* in = ins[j];
+        for (size_t i = begin; i < block_end; ++i) {
+          out[i] = ReduceFunctor<T, reduce_type>::Apply(out[i], in[i]);
+        }
+      }
+    }
+  });
+}
+
 }  // namespace ccl
 
 }  // namespace oneflow
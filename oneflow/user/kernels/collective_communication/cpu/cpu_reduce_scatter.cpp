@@ -19,6 +19,7 @@ limitations under the License.
 #include "oneflow/user/kernels/collective_communication/cpu/cpu_communication_context.h"
 #include "oneflow/user/kernels/collective_communication/include/reduce_scatter.h"
 #include "oneflow/user/kernels/collective_communication/cpu/cpu_collective_communication_util.h"
+#include "oneflow/user/kernels/collective_communication/cpu/cpu_shm_communicator.h"
 
 namespace oneflow {
 
@@ -39,6 +40,12 @@ struct ReduceScatterImpl final {
     const T* in = reinterpret_cast<const T*>(void_in);
     T* out = reinterpret_cast<T*>(void_out);
 
+    CpuShmCommunicator* shm_comm = JUST(CpuShmCommunicator::Get(parallel_desc));
+    if (shm_comm != nullptr && !shm_comm->is_multi_node()) {
+      std::unique_lock<std::mutex> lock(*shm_comm->mutex());
+      return ShmReduceScatter<T, reduce_type>(shm_comm, in, out, elem_cnt);
+    }
+
     BalancedSplitter bs(elem_cnt * parallel_num, parallel_num);
     const auto& opt_parallel_id = JUST(GetParallelId4CurrentProcessCtx(parallel_desc));
     CHECK_OR_RETURN(opt_parallel_id->has_value()) << kOfBugIssueUploadPrompt;
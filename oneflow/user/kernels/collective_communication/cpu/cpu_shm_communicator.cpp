@@ -0,0 +1,185 @@
+/*
+Copyright 2020 The OneFlow Authors. All rights reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+#include <chrono>
+#include <thread>
+#include "oneflow/user/kernels/collective_communication/cpu/cpu_shm_communicator.h"
+#include "oneflow/core/common/env_var/env_var.h"
+#include "oneflow/core/control/ctrl_client.h"
+#include "oneflow/core/control/global_process_ctx.h"
+#include "oneflow/core/job/parallel_desc.h"
+#include "oneflow/core/thread/thread_global_id.h"
+
+namespace oneflow {
+
+DEFINE_ENV_BOOL(ONEFLOW_CPU_ENABLE_SHM_COLLECTIVE, true);
+DEFINE_ENV_INTEGER(ONEFLOW_CPU_SHM_COLLECTIVE_BUFFER_SIZE, 2 * 1024 * 1024);
+
+namespace ccl {
+
+namespace {
+
+constexpr size_t kCacheLineSize = 64;
+constexpr size_t kMinBufferSize = 64 * 1024;
+constexpr size_t kSpinCntBeforeYield = 1024;
+constexpr size_t kSpinCntPerTimeoutCheck = 64 * 1024;
+
+static_assert(std::atomic<uint64_t>::is_always_lock_free,
+              "the barrier counter is shared between processes");
+
+std::string GetShmNameRpcKey(const std::vector<int64_t>& ranks, int64_t thread_global_id,
+                             int64_t leader_rank) {
+  std::ostringstream oss;
+  oss << "cpu_shm_communicator_rpc_key";
+  for (int64_t rank : ranks) { oss << "," << rank; }
+  oss << "#" << thread_global_id << ":" << leader_rank;
+  return oss.str();
+}
+
+}  // namespace
+
+/*static*/ Maybe<CpuShmCommunicator*> CpuShmCommunicator::Get(
+    Symbol<ParallelDesc> parallel_desc) {
+  if (!EnvBool<ONEFLOW_CPU_ENABLE_SHM_COLLECTIVE>()) { return nullptr; }
+  const auto& ranks = parallel_desc->sorted_machine_ids();
+  if (parallel_desc->parallel_num() != ranks.size()) { return nullptr; }
+  // Collectives of one arena have to be issued in the same order on every rank. Only the
+  // collectives of one thread global id are ordered that way (the eager vm workers, each comm
+  // thread of the cpu collective boxing executor and the lazy gradient compression kernels
+  // communicate under different ids), so every id gets its own arena, like its own transport
+  // tokens.
+  using Key = std::pair<Symbol<RankGroup>, int64_t>;
+  struct Entry {
+    std::mutex mutex;
+    bool inited = false;
+    std::unique_ptr<CpuShmCommunicator> comm;
+  };
+  static std::mutex mutex;
+  static HashMap<Key, std::unique_ptr<Entry>> key2entry;
+  const int64_t thread_global_id = GetThisThreadGlobalId();
+  const Key key(JUST(RankGroup::New(parallel_desc)), thread_global_id);
+  Entry* entry = nullptr;
+  {
+    std::unique_lock<std::mutex> lock(mutex);
+    auto& ptr = key2entry[key];
+    if (!ptr) { ptr.reset(new Entry()); }
+    entry = ptr.get();
+  }
+  // Init waits for the other local ranks, so only this key is locked across it; holding the
+  // global lock would let two threads that take it in opposite orders on two ranks deadlock.
+  std::unique_lock<std::mutex> lock(entry->mutex);
+  if (!entry->inited) {
+    std::set<int64_t> node_ids;
+    for (int64_t rank : ranks) { node_ids.insert(GlobalProcessCtx::NodeId(rank)); }
+    if (node_ids.size() < ranks.size()) {
+      std::unique_ptr<CpuShmCommunicator> comm(new CpuShmCommunicator());
+      JUST(comm->Init(ranks, thread_global_id));
+      entry->comm = std::move(comm);
+    }
+    entry->inited = true;
+  }
+  return entry->comm.get();
+}
+
+Maybe<void> CpuShmCommunicator::Init(const std::vector<int64_t>& ranks,
+                                     int64_t thread_global_id) {
+  std::map<int64_t, std::vector<int64_t>> node_id2ranks;
+  for (int64_t rank : ranks) { node_id2ranks[GlobalProcessCtx::NodeId(rank)].push_back(rank); }
+  for (auto& pair : node_id2ranks) { node2ranks_.emplace_back(std::move(pair.second)); }
+  // Order nodes by their leaders so that leader_id_ is the position in leader_rank_group_.
+  std::sort(node2ranks_.begin(), node2ranks_.end(),
+            [](const std::vector<int64_t>& a, const std::vector<int64_t>& b) {
+              return a.front() < b.front();
+            });
+  const int64_t this_rank = GlobalProcessCtx::Rank();
+  std::set<int64_t> leaders;
+  for (int64_t i = 0; i < node2ranks_.size(); ++i) {
+    const auto& node_ranks = node2ranks_.at(i);
+    leaders.insert(node_ranks.front());
+    auto it = std::find(node_ranks.begin(), node_ranks.end(), this_rank);
+    if (it != node_ranks.end()) {
+      local_ranks_ = node_ranks;
+      local_id_ = std::distance(node_ranks.begin(), it);
+      leader_id_ = i;
+    }
+  }
+  CHECK_OR_RETURN(!local_ranks_.empty()) << kOfBugIssueUploadPrompt;
+  leader_rank_group_ = JUST(RankGroup::New(leaders));
+
+  buffer_size_ = RoundUp(
+      std::max<size_t>(EnvInteger<ONEFLOW_CPU_SHM_COLLECTIVE_BUFFER_SIZE>(), kMinBufferSize),
+      kCacheLineSize);
+  const size_t shm_size = kCacheLineSize + 2 * local_ranks_.size() * buffer_size_;
+  const std::string key = GetShmNameRpcKey(ranks, thread_global_id, local_ranks_.front());
+  if (is_leader()) {
+    shm_ = JUST(ipc::SharedMemory::Open(shm_size, /*create=*/true));
+    if (local_ranks_.size() > 1) { Singleton<CtrlClient>::Get()->PushKV(key, shm_->name()); }
+  } else {
+    std::string shm_name;
+    Singleton<CtrlClient>::Get()->PullKV(key, &shm_name);
+    shm_ = JUST(ipc::SharedMemory::Open(shm_name, /*create=*/false));
+    CHECK_EQ_OR_RETURN(shm_->size(), shm_size) << kOfBugIssueUploadPrompt;
+  }
+  barrier_counter_ = reinterpret_cast<std::atomic<uint64_t>*>(shm_->mut_buf());
+  buffers_ = shm_->mut_buf() + kCacheLineSize;
+  barrier_generation_ = 0;
+  round_ = 0;
+  // Every local rank has mapped the arena past this barrier, so the name is no longer needed.
+  JUST(Barrier());
+  if (is_leader()) { JUST(shm_->Unlink()); }
+  return Maybe<void>::Ok();
+}
+
+int64_t CpuShmCommunicator::LocalId4Rank(int64_t rank) const {
+  auto it = std::find(local_ranks_.begin(), local_ranks_.end(), rank);
+  return it == local_ranks_.end() ? -1 : std::distance(local_ranks_.begin(), it);
+}
+
+Maybe<Symbol<ParallelDesc>> CpuShmCommunicator::InterNodeParallelDesc4Root(int64_t root) const {
+  std::set<int64_t> ranks;
+  for (const auto& node_ranks : node2ranks_) {
+    const bool has_root = std::find(node_ranks.begin(), node_ranks.end(), root) != node_ranks.end();
+    ranks.insert(has_root ? root : node_ranks.front());
+  }
+  return RankGroup::GetDefaultParallelDesc(DeviceType::kCPU, JUST(RankGroup::New(ranks)));
+}
+
+char* CpuShmCommunicator::buffer(int64_t local_id, uint64_t round) const {
+  return buffers_ + ((round & 1) * local_ranks_.size() + local_id) * buffer_size_;
+}
+
+Maybe<void> CpuShmCommunicator::Barrier() {
+  const uint64_t target = (++barrier_generation_) * local_ranks_.size();
+  if (barrier_counter_->fetch_add(1, std::memory_order_acq_rel) + 1 >= target) {
+    return Maybe<void>::Ok();
+  }
+  const auto start = std::chrono::steady_clock::now();
+  const std::chrono::seconds timeout(EnvInteger<ONEFLOW_TIMEOUT_SECONDS>());
+  for (size_t spin_cnt = 1; barrier_counter_->load(std::memory_order_acquire) < target;
+       ++spin_cnt) {
+    if (spin_cnt < kSpinCntBeforeYield) { continue; }
+    std::this_thread::yield();
+    if (spin_cnt % kSpinCntPerTimeoutCheck == 0) {
+      CHECK_OR_RETURN(std::chrono::steady_clock::now() - start < timeout)
+          << Error::TimeoutError() << "shared memory barrier of ranks on node "
+          << GlobalProcessCtx::ThisNodeId() << " timed out";
+    }
+  }
+  return Maybe<void>::Ok();
+}
+
+}  // namespace ccl
+
+}  // namespace oneflow
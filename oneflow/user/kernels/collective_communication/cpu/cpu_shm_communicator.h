@@ -0,0 +1,185 @@
+/*
+Copyright 2020 The OneFlow Authors. All rights reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+#ifndef ONEFLOW_USER_KERNELS_COLLECTIVE_COMMUNICATION_CPU_CPU_SHM_COMMUNICATOR_H_
+#define ONEFLOW_USER_KERNELS_COLLECTIVE_COMMUNICATION_CPU_CPU_SHM_COMMUNICATOR_H_
+
+#include <atomic>
+#include <mutex>
+#include "oneflow/core/common/maybe.h"
+#include "oneflow/core/common/symbol.h"
+#include "oneflow/core/ipc/shared_memory.h"
+#include "oneflow/core/job/rank_group.h"
+#include "oneflow/user/kernels/collective_communication/include/collective_communication.h"
+#include "oneflow/user/kernels/collective_communication/cpu/cpu_collective_communication_util.h"
+
+namespace oneflow {
+
+class ParallelDesc;
+
+namespace ccl {
+
+// The ranks of a cpu placement that live on the same node map one shared arena holding two
+// staging buffers per rank. Collectives stream their data through the buffers round by round;
+// within a round every local rank copies or reduces its own share, and rounds alternate buffers
+// so that a single barrier separates the writers of a round from its readers.
+class CpuShmCommunicator final {
+ public:
+  OF_DISALLOW_COPY_AND_MOVE(CpuShmCommunicator);
+  ~CpuShmCommunicator() = default;
+
+  // The communicator of the placement for the thread global id of the calling thread. Returns
+  // nullptr when the backend is disabled, the placement has more than one device per rank, or
+  // no two of its ranks share a node.
+  static Maybe<CpuShmCommunicator*> Get(Symbol<ParallelDesc> parallel_desc);
+
+  int64_t local_rank_num() const { return local_ranks_.size(); }
+  int64_t local_id() const { return local_id_; }
+  bool is_leader() const { return local_id_ == 0; }
+  // Local id of `rank`, or -1 if it lives on another node.
+  int64_t LocalId4Rank(int64_t rank) const;
+
+  bool is_multi_node() const { return node2ranks_.size() > 1; }
+  // Ring over the lowest rank of every node.
+  Symbol<RankGroup> leader_rank_group() const { return leader_rank_group_; }
+  int64_t leader_id() const { return leader_id_; }
+  int64_t leader_num() const { return node2ranks_.size(); }
+  // One rank per node: `root` on its own node and the leader elsewhere.
+  Maybe<Symbol<ParallelDesc>> InterNodeParallelDesc4Root(int64_t root) const;
+
+  size_t buffer_size() const { return buffer_size_; }
+  char* buffer(int64_t local_id, uint64_t round) const;
+  uint64_t NextRound() { return round_++; }
+  Maybe<void> Barrier();
+
+  std::mutex* mutex() { return &mutex_; }
+
+ private:
+  CpuShmCommunicator() = default;
+  Maybe<void> Init(const std::vector<int64_t>& ranks, int64_t thread_global_id);
+
+  std::vector<std::vector<int64_t>> node2ranks_;
+  std::vector<int64_t> local_ranks_;
+  int64_t local_id_;
+  Symbol<RankGroup> leader_rank_group_;
+  int64_t leader_id_;
+  std::shared_ptr<ipc::SharedMemory> shm_;
+  std::atomic<uint64_t>* barrier_counter_;
+  char* buffers_;
+  size_t buffer_size_;
+  uint64_t barrier_generation_;
+  uint64_t round_;
+  std::mutex mutex_;
+};
+
+template<typename T, ReduceType reduce_type>
+Maybe<void> ShmReduce(CpuShmCommunicator* comm, const T* in, T* out, size_t elem_cnt,
+                      bool all_ranks_receive) {
+  const int64_t local_num = comm->local_rank_num();
+  const int64_t local_id = comm->local_id();
+  const size_t round_elem_cnt = comm->buffer_size() / sizeof(T);
+  std::vector<const T*> ins(local_num);
+  for (size_t offset = 0; offset < elem_cnt; offset += round_elem_cnt) {
+    const size_t cnt = std::min(round_elem_cnt, elem_cnt - offset);
+    const uint64_t round = comm->NextRound();
+    T* result = reinterpret_cast<T*>(comm->buffer(0, round));
+    std::memcpy(comm->buffer(local_id, round), in + offset, cnt * sizeof(T));
+    JUST(comm->Barrier());
+    // Each local rank reduces its own slice of the round into the buffer of local rank 0.
+    const Range range = BalancedSplitter(cnt, local_num).At(local_id);
+    if (range.size() > 0) {
+      for (int64_t i = 0; i < local_num; ++i) {
+        ins[i] = reinterpret_cast<const T*>(comm->buffer(i, round)) + range.begin();
+      }
+      MultiReduce<T, reduce_type>(range.size(), result + range.begin(), ins.data(), local_num);
+    }
+    JUST(comm->Barrier());
+    if (all_ranks_receive || comm->is_leader()) {
+      std::memcpy(out + offset, result, cnt * sizeof(T));
+    }
+  }
+  return Maybe<void>::Ok();
+}
+
+// Copies `size` bytes from `in` of local rank `root_local_id` to `out` of every local rank.
+inline Maybe<void> ShmBroadcast(CpuShmCommunicator* comm, const void* in, void* out, size_t size,
+                                int64_t root_local_id) {
+  const bool is_root = comm->local_id() == root_local_id;
+  const char* char_in = reinterpret_cast<const char*>(in);
+  char* char_out = reinterpret_cast<char*>(out);
+  for (size_t offset = 0; offset < size; offset += comm->buffer_size()) {
+    const size_t cnt = std::min(comm->buffer_size(), size - offset);
+    const uint64_t round = comm->NextRound();
+    char* staged = comm->buffer(root_local_id, round);
+    if (is_root) { std::memcpy(staged, char_in + offset, cnt); }
+    JUST(comm->Barrier());
+    if (!is_root) { std::memcpy(char_out + offset, staged, cnt); }
+  }
+  if (is_root && in != out) { std::memcpy(out, in, size); }
+  return Maybe<void>::Ok();
+}
+
+// `out` holds the `size` bytes of every local rank in local id order.
+inline Maybe<void> ShmAllGather(CpuShmCommunicator* comm, const void* in, void* out,
+                                size_t size) {
+  const int64_t local_num = comm->local_rank_num();
+  const int64_t local_id = comm->local_id();
+  const char* char_in = reinterpret_cast<const char*>(in);
+  char* char_out = reinterpret_cast<char*>(out);
+  for (size_t offset = 0; offset < size; offset += comm->buffer_size()) {
+    const size_t cnt = std::min(comm->buffer_size(), size - offset);
+    const uint64_t round = comm->NextRound();
+    std::memcpy(comm->buffer(local_id, round), char_in + offset, cnt);
+    JUST(comm->Barrier());
+    for (int64_t i = 0; i < local_num; ++i) {
+      if (i == local_id) { continue; }
+      std::memcpy(char_out + i * size + offset, comm->buffer(i, round), cnt);
+    }
+  }
+  // In-place operation will happen if in == out + local_id * size
+  if (in != char_out + local_id * size) { std::memcpy(char_out + local_id * size, in, size); }
+  return Maybe<void>::Ok();
+}
+
+// `in` holds local_rank_num() blocks of `elem_cnt` elements; local rank i receives the
+// reduction of block i.
+template<typename T, ReduceType reduce_type>
+Maybe<void> ShmReduceScatter(CpuShmCommunicator* comm, const T* in, T* out, size_t elem_cnt) {
+  const int64_t local_num = comm->local_rank_num();
+  const int64_t local_id = comm->local_id();
+  const size_t block_elem_cnt = comm->buffer_size() / sizeof(T) / local_num;
+  CHECK_GT_OR_RETURN(block_elem_cnt, 0) << kOfBugIssueUploadPrompt;
+  std::vector<const T*> ins(local_num);
+  for (size_t offset = 0; offset < elem_cnt; offset += block_elem_cnt) {
+    const size_t cnt = std::min(block_elem_cnt, elem_cnt - offset);
+    const uint64_t round = comm->NextRound();
+    T* staged = reinterpret_cast<T*>(comm->buffer(local_id, round));
+    for (int64_t i = 0; i < local_num; ++i) {
+      std::memcpy(staged + i * cnt, in + i * elem_cnt + offset, cnt * sizeof(T));
+    }
+    JUST(comm->Barrier());
+    for (int64_t i = 0; i < local_num; ++i) {
+      ins[i] = reinterpret_cast<const T*>(comm->buffer(i, round)) + local_id * cnt;
+    }
+    MultiReduce<T, reduce_type>(cnt, out + offset, ins.data(), local_num);
+  }
+  return Maybe<void>::Ok();
+}
+
+}  // namespace ccl
+
+}  // namespace oneflow
+
+#endif  // ONEFLOW_USER_KERNELS_COLLECTIVE_COMMUNICATION_CPU_CPU_SHM_COMMUNICATOR_H_
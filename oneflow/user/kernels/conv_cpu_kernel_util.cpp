@@ -0,0 +1,686 @@
+/*
+Copyright 2020 The OneFlow Authors. All rights reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+#include "oneflow/user/kernels/conv_cpu_kernel_util.h"
+#include "oneflow/core/common/blas.h"
+#include <chrono>
+#include <limits>
+
+namespace oneflow {
+
+namespace {
+
+// Packed column panels are sized to stay in the L2 cache of a core.
+constexpr int64_t kPanelBytes = 256 * 1024;
+constexpr int64_t kMinTileSize = 16;
+constexpr int64_t kMaxTileSize = 1024;
+// Output channels are only split into tiles when batch x groups x position tiles can not feed
+// all the threads, a tile is never smaller than this.
+constexpr int64_t kMinChannelTileSize = 16;
+
+int64_t CeilDiv(int64_t a, int64_t b) { return (a + b - 1) / b; }
+
+template<typename T>
+int64_t DefaultTileSize(const ConvCpuProblem& problem) {
+  const int64_t reduce_size = std::max<int64_t>(problem.ReduceSize(), 1);
+  int64_t tile_size = kPanelBytes / static_cast<int64_t>(sizeof(T)) / reduce_size;
+  tile_size = tile_size / kMinTileSize * kMinTileSize;
+  tile_size = std::min(std::max(tile_size, kMinTileSize), kMaxTileSize);
+  return std::min(tile_size, std::max<int64_t>(problem.OutSpatialSize(), 1));
+}
+
+// Walks the output positions [begin, begin + n) of the forward conv in (od, oh, ow) order.
+class OutPosIter final {
+ public:
+  OutPosIter(const ConvCpuProblem& problem, int64_t begin) : out_size_(problem.out_size) {
+    ow_ = begin % out_size_[2];
+    oh_ = begin / out_size_[2] % out_size_[1];
+    od_ = begin / out_size_[2] / out_size_[1];
+  }
+  int64_t od() const { return od_; }
+  int64_t oh() const { return oh_; }
+  int64_t ow() const { return ow_; }
+  void Next() {
+    if (++ow_ == out_size_[2]) {
+      ow_ = 0;
+      if (++oh_ == out_size_[1]) {
+        oh_ = 0;
+        ++od_;
+      }
+    }
+  }
+
+ private:
+  const int64_t* out_size_;
+  int64_t od_;
+  int64_t oh_;
+  int64_t ow_;
+};
+
+// Returns the offset of the input position read by kernel tap (kd, kh, kw) at the output position
+// of iter, in units of positions, or -1 if it falls into the padding.
+int64_t InPosOffset(const ConvCpuProblem& p, const OutPosIter& iter, int64_t kd, int64_t kh,
+                    int64_t kw) {
+  const int64_t id = iter.od() * p.strides[0] - p.padding_before[0] + kd * p.dilation_rate[0];
+  if (id < 0 || id >= p.in_size[0]) { return -1; }
+  const int64_t ih = iter.oh() * p.strides[1] - p.padding_before[1] + kh * p.dilation_rate[1];
+  if (ih < 0 || ih >= p.in_size[1]) { return -1; }
+  const int64_t iw = iter.ow() * p.strides[2] - p.padding_before[2] + kw * p.dilation_rate[2];
+  if (iw < 0 || iw >= p.in_size[2]) { return -1; }
+  return (id * p.in_size[1] + ih) * p.in_size[2] + iw;
+}
+
+// Channels first columns are laid out as [(c, kd, kh, kw), position], only the rows of channels
+// [channel_begin, channel_end) are visited. image points to the first channel of the group.
+template<typename T, typename F>
+void ForEachColumnChannelsFirst(const ConvCpuProblem& p, int64_t channel_begin,
+                                int64_t channel_end, int64_t pos_begin, int64_t tile_size,
+                                const F& f) {
+  const int64_t in_spatial_size = p.InSpatialSize();
+  int64_t row = 0;
+  for (int64_t c = channel_begin; c < channel_end; ++c) {
+    for (int64_t kd = 0; kd < p.kernel_size[0]; ++kd) {
+      for (int64_t kh = 0; kh < p.kernel_size[1]; ++kh) {
+        for (int64_t kw = 0; kw < p.kernel_size[2]; ++kw) {
+          OutPosIter iter(p, pos_begin);
+          for (int64_t j = 0; j < tile_size; ++j) {
+            const int64_t offset = InPosOffset(p, iter, kd, kh, kw);
+            f(row * tile_size + j, offset < 0 ? -1 : c * in_spatial_size + offset);
+            iter.Next();
+          }
+          row += 1;
+        }
+      }
+    }
+  }
+}
+
+template<typename T>
+void PackColumnsChannelsFirst(const ConvCpuProblem& p, const T* image, int64_t pos_begin,
+                              int64_t tile_size, T* panel) {
+  ForEachColumnChannelsFirst<T>(p, 0, p.in_channels / p.groups, pos_begin, tile_size,
+                                [&](int64_t col, int64_t offset) {
+                                  panel[col] = offset < 0 ? static_cast<T>(0) : image[offset];
+                                });
+}
+
+template<typename T>
+void ScatterColumnsChannelsFirst(const ConvCpuProblem& p, const T* panel, int64_t channel_begin,
+                                 int64_t channel_end, int64_t pos_begin, int64_t tile_size,
+                                 T* image) {
+  ForEachColumnChannelsFirst<T>(p, channel_begin, channel_end, pos_begin, tile_size,
+                                [&](int64_t col, int64_t offset) {
+                                  if (offset >= 0) { image[offset] += panel[col]; }
+                                });
+}
+
+// Channels last columns are laid out as [position, (kd, kh, kw, c)], so every kernel tap copies a
+// contiguous run of channels. image points to the first channel of the group.
+template<typename T, typename F>
+void ForEachColumnChannelsLast(const ConvCpuProblem& p, int64_t pos_begin, int64_t tile_size,
+                               const F& f) {
+  const int64_t group_channels = p.in_channels / p.groups;
+  const int64_t reduce_size = p.ReduceSize();
+  OutPosIter iter(p, pos_begin);
+  for (int64_t j = 0; j < tile_size; ++j) {
+    int64_t col = j * reduce_size;
+    for (int64_t kd = 0; kd < p.kernel_size[0]; ++kd) {
+      for (int64_t kh = 0; kh < p.kernel_size[1]; ++kh) {
+        for (int64_t kw = 0; kw < p.kernel_size[2]; ++kw) {
+          const int64_t offset = InPosOffset(p, iter, kd, kh, kw);
+          f(col, offset < 0 ? -1 : offset * p.in_channels, group_channels);
+          col += group_channels;
+        }
+      }
+    }
+    iter.Next();
+  }
+}
+
+template<typename T>
+void PackColumnsChannelsLast(const ConvCpuProblem& p, const T* image, int64_t pos_begin,
+                             int64_t tile_size, T* panel) {
+  ForEachColumnChannelsLast<T>(p, pos_begin, tile_size,
+                               [&](int64_t col, int64_t offset, int64_t n) {
+                                 if (offset < 0) {
+                                   std::fill(panel + col, panel + col + n, static_cast<T>(0));
+                                 } else {
+                                   std::copy(image + offset, image + offset + n, panel + col);
+                                 }
+                               });
+}
+
+template<typename T>
+void ScatterColumnsChannelsLast(const ConvCpuProblem& p, const T* panel, int64_t pos_begin,
+                                int64_t tile_size, T* image) {
+  ForEachColumnChannelsLast<T>(p, pos_begin, tile_size,
+                               [&](int64_t col, int64_t offset, int64_t n) {
+                                 if (offset < 0) { return; }
+                                 for (int64_t c = 0; c < n; ++c) {
+                                   image[offset + c] += panel[col + c];
+                                 }
+                               });
+}
+
+// cblas takes int sizes. The rows of c are independent, so a taller m (the positions of a large
+// pointwise conv) is split into blocks; the other sizes and leading dims must fit an int.
+template<typename T>
+void Gemm(CBLAS_TRANSPOSE trans_a, CBLAS_TRANSPOSE trans_b, int64_t m, int64_t n, int64_t k,
+          const T* a, int64_t lda, const T* b, int64_t ldb, T beta, T* c, int64_t ldc) {
+  constexpr int64_t kMaxBlasInt = std::numeric_limits<int>::max();
+  CHECK_LE(n, kMaxBlasInt);
+  CHECK_LE(k, kMaxBlasInt);
+  CHECK_LE(lda, kMaxBlasInt);
+  CHECK_LE(ldb, kMaxBlasInt);
+  CHECK_LE(ldc, kMaxBlasInt);
+  for (int64_t m_begin = 0; m_begin < m; m_begin += kMaxBlasInt) {
+    const int64_t m_size = std::min(kMaxBlasInt, m - m_begin);
+    const T* a_block = trans_a == CblasNoTrans ? a + m_begin * lda : a + m_begin;
+    cblas_gemm<T>(CblasRowMajor, trans_a, trans_b, static_cast<int>(m_size), static_cast<int>(n),
+                  static_cast<int>(k), static_cast<T>(1), a_block, static_cast<int>(lda), b,
+                  static_cast<int>(ldb), beta, c + m_begin * ldc, static_cast<int>(ldc));
+  }
+}
+
+template<typename T>
+void GemmForward(ep::CpuStream* stream, const ConvCpuProblem& p, const ConvCpuConfig& config,
+                 const T* in, const T* weight, const T* bias, bool accumulate, T* out) {
+  const bool pointwise = config.algorithm == ConvCpuAlgorithm::kPointwise;
+  if (pointwise) { CHECK(p.IsPointwise()); }
+  const int64_t in_spatial_size = p.InSpatialSize();
+  const int64_t out_spatial_size = p.OutSpatialSize();
+  const int64_t group_in_channels = p.in_channels / p.groups;
+  const int64_t group_out_channels = p.out_channels / p.groups;
+  const int64_t reduce_size = p.ReduceSize();
+  const int64_t tile_size = std::min(config.tile_size, out_spatial_size);
+  const int64_t num_pos_tiles = CeilDiv(out_spatial_size, tile_size);
+  const int64_t num_outer_tasks = p.batch_size * p.groups * num_pos_tiles;
+  int64_t channel_tile_size = group_out_channels;
+  const int64_t num_threads = stream->device()->GetNumThreads();
+  if (num_outer_tasks < num_threads) {
+    const int64_t num_channel_tiles = CeilDiv(num_threads, num_outer_tasks);
+    channel_tile_size = std::max(CeilDiv(group_out_channels, num_channel_tiles),
+                                 std::min(kMinChannelTileSize, group_out_channels));
+  }
+  const int64_t num_channel_tiles = CeilDiv(group_out_channels, channel_tile_size);
+  const T beta = accumulate ? static_cast<T>(1) : static_cast<T>(0);
+  stream->ParallelFor(
+      0, num_outer_tasks * num_channel_tiles,
+      [&](int64_t begin, int64_t end) {
+        std::vector<T> panel(pointwise ? 0 : reduce_size * tile_size);
+        int64_t packed_outer_task = -1;
+        for (int64_t task = begin; task < end; ++task) {
+          const int64_t outer_task = task / num_channel_tiles;
+          const int64_t channel_begin = task % num_channel_tiles * channel_tile_size;
+          const int64_t num_channels =
+              std::min(channel_tile_size, group_out_channels - channel_begin);
+          const int64_t pos_tile = outer_task % num_pos_tiles;
+          const int64_t group = outer_task / num_pos_tiles % p.groups;
+          const int64_t n = outer_task / num_pos_tiles / p.groups;
+          const int64_t pos_begin = pos_tile * tile_size;
+          const int64_t num_pos = std::min(tile_size, out_spatial_size - pos_begin);
+          const int64_t out_channel_begin = group * group_out_channels + channel_begin;
+          const T* group_weight = weight + out_channel_begin * reduce_size;
+          T* out_tile = nullptr;
+          if (p.channels_last) {
+            const T* image = in + n * in_spatial_size * p.in_channels + group * group_in_channels;
+            const T* a = nullptr;
+            int64_t lda = 0;
+            if (pointwise) {
+              a = image + pos_begin * p.in_channels;
+              lda = p.in_channels;
+            } else {
+              if (packed_outer_task != outer_task) {
+                PackColumnsChannelsLast<T>(p, image, pos_begin, num_pos, panel.data());
+                packed_outer_task = outer_task;
+              }
+              a = panel.data();
+              lda = reduce_size;
+            }
+            // out[pos, oc] = columns[pos, :] * weight[oc, :](T)
+            out_tile =
+                out + (n * out_spatial_size + pos_begin) * p.out_channels + out_channel_begin;
+            Gemm<T>(CblasNoTrans, CblasTrans, num_pos, num_channels, reduce_size, a, lda,
+                    group_weight, reduce_size, beta, out_tile, p.out_channels);
+            if (bias != nullptr) {
+              for (int64_t j = 0; j < num_pos; ++j) {
+                T* out_row = out_tile + j * p.out_channels;
+                for (int64_t c = 0; c < num_channels; ++c) {
+                  out_row[c] += bias[out_channel_begin + c];
+                }
+              }
+            }
+          } else {
+            const T* image = in + (n * p.in_channels + group * group_in_channels) * in_spatial_size;
+            const T* b = nullptr;
+            int64_t ldb = 0;
+            if (pointwise) {
+              b = image + pos_begin;
+              ldb = in_spatial_size;
+            } else {
+              if (packed_outer_task != outer_task) {
+                PackColumnsChannelsFirst<T>(p, image, pos_begin, num_pos, panel.data());
+                packed_outer_task = outer_task;
+              }
+              b = panel.data();
+              ldb = num_pos;
+            }
+            // out[oc, pos] = weight[oc, :] * columns[:, pos]
+            out_tile =
+                out + (n * p.out_channels + out_channel_begin) * out_spatial_size + pos_begin;
+            Gemm<T>(CblasNoTrans, CblasNoTrans, num_channels, num_pos, reduce_size, group_weight,
+                    reduce_size, b, ldb, beta, out_tile, out_spatial_size);
+            if (bias != nullptr) {
+              for (int64_t c = 0; c < num_channels; ++c) {
+                T* out_row = out_tile + c * out_spatial_size;
+                const T bias_value = bias[out_channel_begin + c];
+                for (int64_t j = 0; j < num_pos; ++j) { out_row[j] += bias_value; }
+              }
+            }
+          }
+        }
+      },
+      1);
+}
+
+template<typename T>
+void DepthwiseForwardChannelsFirst(ep::CpuStream* stream, const ConvCpuProblem& p, const T* in,
+                                   const T* weight, const T* bias, bool accumulate, T* out) {
+  const int64_t multiplier = p.out_channels / p.groups;
+  const int64_t in_spatial_size = p.InSpatialSize();
+  const int64_t out_spatial_size = p.OutSpatialSize();
+  const int64_t kernel_spatial_size = p.KernelSpatialSize();
+  stream->ParallelFor(
+      0, p.batch_size * p.out_channels,
+      [&](int64_t begin, int64_t end) {
+        for (int64_t task = begin; task < end; ++task) {
+          const int64_t oc = task % p.out_channels;
+          const int64_t n = task / p.out_channels;
+          const T* image = in + (n * p.in_channels + oc / multiplier) * in_spatial_size;
+          const T* kernel = weight + oc * kernel_spatial_size;
+          T* plane = out + task * out_spatial_size;
+          if (!accumulate) { std::fill(plane, plane + out_spatial_size, static_cast<T>(0)); }
+          for (int64_t od = 0; od < p.out_size[0]; ++od) {
+            for (int64_t oh = 0; oh < p.out_size[1]; ++oh) {
+              T* out_row = plane + (od * p.out_size[1] + oh) * p.out_size[2];
+              for (int64_t kd = 0; kd < p.kernel_size[0]; ++kd) {
+                const int64_t id =
+                    od * p.strides[0] - p.padding_before[0] + kd * p.dilation_rate[0];
+                if (id < 0 || id >= p.in_size[0]) { continue; }
+                for (int64_t kh = 0; kh < p.kernel_size[1]; ++kh) {
+                  const int64_t ih =
+                      oh * p.strides[1] - p.padding_before[1] + kh * p.dilation_rate[1];
+                  if (ih < 0 || ih >= p.in_size[1]) { continue; }
+                  const T* in_row = image + (id * p.in_size[1] + ih) * p.in_size[2];
+                  for (int64_t kw = 0; kw < p.kernel_size[2]; ++kw) {
+                    const T w = kernel[(kd * p.kernel_size[1] + kh) * p.kernel_size[2] + kw];
+                    // iw = ow * stride + offset, clip ow so that iw stays in [0, in_size).
+                    const int64_t offset = kw * p.dilation_rate[2] - p.padding_before[2];
+                    const int64_t ow_begin = offset < 0 ? CeilDiv(-offset, p.strides[2]) : 0;
+                    const int64_t ow_end =
+                        p.in_size[2] > offset
+                            ? std::min(p.out_size[2], CeilDiv(p.in_size[2] - offset, p.strides[2]))
+                            : 0;
+                    if (p.strides[2] == 1) {
+                      for (int64_t ow = ow_begin; ow < ow_end; ++ow) {
+                        out_row[ow] += w * in_row[ow + offset];
+                      }
+                    } else {
+                      for (int64_t ow = ow_begin; ow < ow_end; ++ow) {
+                        out_row[ow] += w * in_row[ow * p.strides[2] + offset];
+                      }
+                    }
+                  }
+                }
+              }
+            }
+          }
+          if (bias != nullptr) {
+            const T bias_value = bias[oc];
+            for (int64_t j = 0; j < out_spatial_size; ++j) { plane[j] += bias_value; }
+          }
+        }
+      },
+      1);
+}
+
+template<typename T>
+void DepthwiseForwardChannelsLast(ep::CpuStream* stream, const ConvCpuProblem& p,
+                                  const ConvCpuConfig& config, const T* in, const T* weight,
+                                  const T* bias, bool accumulate, T* out) {
+  const int64_t multiplier = p.out_channels / p.groups;
+  const int64_t in_spatial_size = p.InSpatialSize();
+  const int64_t out_spatial_size = p.OutSpatialSize();
+  const int64_t kernel_spatial_size = p.KernelSpatialSize();
+  // [out_channels, taps] -> [taps, out_channels], so that every tap is applied to a contiguous
+  // run of channels.
+  std::vector<T> transposed_weight(kernel_spatial_size * p.out_channels);
+  for (int64_t oc = 0; oc < p.out_channels; ++oc) {
+    for (int64_t tap = 0; tap < kernel_spatial_size; ++tap) {
+      transposed_weight[tap * p.out_channels + oc] = weight[oc * kernel_spatial_size + tap];
+    }
+  }
+  const int64_t tile_size = std::min(config.tile_size, out_spatial_size);
+  const int64_t num_pos_tiles = CeilDiv(out_spatial_size, tile_size);
+  stream->ParallelFor(
+      0, p.batch_size * num_pos_tiles,
+      [&](int64_t begin, int64_t end) {
+        for (int64_t task = begin; task < end; ++task) {
+          const int64_t n = task / num_pos_tiles;
+          const int64_t pos_begin = task % num_pos_tiles * tile_size;
+          const int64_t num_pos = std::min(tile_size, out_spatial_size - pos_begin);
+          const T* image = in + n * in_spatial_size * p.in_channels;
+          OutPosIter iter(p, pos_begin);
+          for (int64_t j = 0; j < num_pos; ++j) {
+            T* out_row = out + (n * out_spatial_size + pos_begin + j) * p.out_channels;
+            if (!accumulate) { std::fill(out_row, out_row + p.out_channels, static_cast<T>(0)); }
+            int64_t tap = 0;
+            for (int64_t kd = 0; kd < p.kernel_size[0]; ++kd) {
+              for (int64_t kh = 0; kh < p.kernel_size[1]; ++kh) {
+                for (int64_t kw = 0; kw < p.kernel_size[2]; ++kw, ++tap) {
+                  const int64_t offset = InPosOffset(p, iter, kd, kh, kw);
+                  if (offset < 0) { continue; }
+                  const T* in_row = image + offset * p.in_channels;
+                  const T* w_row = transposed_weight.data() + tap * p.out_channels;
+                  if (multiplier == 1) {
+                    for (int64_t c = 0; c < p.out_channels; ++c) {
+                      out_row[c] += in_row[c] * w_row[c];
+                    }
+                  } else {
+                    for (int64_t c = 0; c < p.out_channels; ++c) {
+                      out_row[c] += in_row[c / multiplier] * w_row[c];
+                    }
+                  }
+                }
+              }
+            }
+            if (bias != nullptr) {
+              for (int64_t c = 0; c < p.out_channels; ++c) { out_row[c] += bias[c]; }
+            }
+            iter.Next();
+          }
+        }
+      },
+      1);
+}
+
+template<typename T>
+std::vector<ConvCpuConfig> GetForwardCandidates(const ConvCpuProblem& problem) {
+  const int64_t out_spatial_size = std::max<int64_t>(problem.OutSpatialSize(), 1);
+  const int64_t tile_size = DefaultTileSize<T>(problem);
+  std::vector<ConvCpuConfig> candidates;
+  auto AddCandidate = [&](ConvCpuAlgorithm algorithm, int64_t candidate_tile_size) {
+    candidate_tile_size = std::min(std::max(candidate_tile_size, kMinTileSize), out_spatial_size);
+    for (const auto& candidate : candidates) {
+      if (candidate.algorithm == algorithm && candidate.tile_size == candidate_tile_size) {
+        return;
+      }
+    }
+    ConvCpuConfig config;
+    config.algorithm = algorithm;
+    config.tile_size = candidate_tile_size;
+    candidates.push_back(config);
+  };
+  // The first candidate is the one used when tuning is disabled.
+  if (problem.IsDepthwise()) { AddCandidate(ConvCpuAlgorithm::kDepthwise, tile_size); }
+  if (problem.IsPointwise()) {
+    AddCandidate(ConvCpuAlgorithm::kPointwise, tile_size);
+    AddCandidate(ConvCpuAlgorithm::kPointwise, tile_size / 2);
+  }
+  AddCandidate(ConvCpuAlgorithm::kBlockedGemm, tile_size);
+  AddCandidate(ConvCpuAlgorithm::kBlockedGemm, tile_size / 2);
+  AddCandidate(ConvCpuAlgorithm::kBlockedGemm, tile_size * 2);
+  return candidates;
+}
+
+}  // namespace
+
+bool ConvCpuProblem::IsPointwise() const {
+  for (int i = 0; i < 3; ++i) {
+    if (kernel_size[i] != 1 || strides[i] != 1 || padding_before[i] != 0) { return false; }
+    if (in_size[i] != out_size[i]) { return false; }
+  }
+  return true;
+}
+
+bool ConvCpuProblem::IsDepthwise() const {
+  return groups > 1 && groups == in_channels && out_channels % groups == 0;
+}
+
+std::string ConvCpuProblem::ToString() const {
+  std::string str = channels_last ? "channels_last" : "channels_first";
+  auto Append = [&](int64_t value) { str += "," + std::to_string(value); };
+  Append(batch_size);
+  Append(groups);
+  Append(in_channels);
+  Append(out_channels);
+  for (int i = 0; i < 3; ++i) {
+    Append(in_size[i]);
+    Append(out_size[i]);
+    Append(kernel_size[i]);
+    Append(strides[i]);
+    Append(dilation_rate[i]);
+    Append(padding_before[i]);
+  }
+  return str;
+}
+
+ConvCpuProblem MakeConvCpuProblem(bool channels_last, int64_t groups, const ShapeView& in_5d_shape,
+                                  const ShapeView& weight_5d_shape, const ShapeView& out_5d_shape,
+                                  const int32_t* strides, const int32_t* dilation_rate,
+                                  const int32_t* padding_before) {
+  CHECK_EQ(in_5d_shape.NumAxes(), 5);
+  CHECK_EQ(weight_5d_shape.NumAxes(), 5);
+  CHECK_EQ(out_5d_shape.NumAxes(), 5);
+  ConvCpuProblem problem;
+  problem.channels_last = channels_last;
+  problem.batch_size = in_5d_shape.At(0);
+  problem.groups = groups;
+  const int32_t spatial_offset = channels_last ? 1 : 2;
+  problem.in_channels = channels_last ? in_5d_shape.At(4) : in_5d_shape.At(1);
+  problem.out_channels = channels_last ? out_5d_shape.At(4) : out_5d_shape.At(1);
+  for (int i = 0; i < 3; ++i) {
+    problem.in_size[i] = in_5d_shape.At(spatial_offset + i);
+    problem.out_size[i] = out_5d_shape.At(spatial_offset + i);
+    problem.kernel_size[i] = weight_5d_shape.At(spatial_offset + i);
+    problem.strides[i] = strides[i];
+    problem.dilation_rate[i] = dilation_rate[i];
+    problem.padding_before[i] = padding_before[i];
+  }
+  CHECK_EQ(out_5d_shape.At(0), problem.batch_size);
+  CHECK_EQ(problem.in_channels % groups, 0);
+  CHECK_EQ(problem.out_channels % groups, 0);
+  CHECK_EQ(weight_5d_shape.At(0), problem.out_channels);
+  CHECK_EQ(weight_5d_shape.Count(1), problem.ReduceSize());
+  return problem;
+}
+
+struct ConvCpuTuner::Impl {
+  std::mutex mutex;
+  HashMap<std::string, ConvCpuConfig> cache;
+};
+
+ConvCpuTuner::ConvCpuTuner() : impl_(new Impl()) {}
+
+ConvCpuTuner::~ConvCpuTuner() = default;
+
+const ConvCpuTuner& ConvCpuTuner::Get() {
+  static ConvCpuTuner instance;
+  return instance;
+}
+
+template<typename T>
+ConvCpuConfig ConvCpuTuner::FindForwardConfig(ep::CpuStream* stream, const ConvCpuProblem& problem,
+                                              const T* in, const T* weight) const {
+  const std::vector<ConvCpuConfig> candidates = GetForwardCandidates<T>(problem);
+  static const bool enable_tuning =
+      ParseBooleanFromEnv("ONEFLOW_KERNEL_CONV_CPU_ENABLE_TUNING", true);
+  if (!enable_tuning || candidates.size() == 1 || problem.OutSpatialSize() == 0) {
+    return candidates.front();
+  }
+  const std::string key = problem.ToString() + "," + DataType_Name(GetDataType<T>::value);
+  {
+    std::lock_guard<std::mutex> lock(impl_->mutex);
+    const auto it = impl_->cache.find(key);
+    if (it != impl_->cache.end()) { return it->second; }
+  }
+  // Only as many samples as there are threads are timed, which keeps every candidate fully
+  // parallel while bounding the tuning cost of large batches.
+  ConvCpuProblem benchmark_problem = problem;
+  benchmark_problem.batch_size = std::min<int64_t>(
+      problem.batch_size, std::max<int64_t>(stream->device()->GetNumThreads(), 1));
+  std::vector<T> benchmark_out(benchmark_problem.batch_size * problem.out_channels
+                               * problem.OutSpatialSize());
+  ConvCpuConfig fastest_config = candidates.front();
+  double fastest_time = 0;
+  for (size_t i = 0; i < candidates.size(); ++i) {
+    auto Run = [&]() {
+      ConvCpuKernelUtil<T>::Forward(stream, benchmark_problem, candidates.at(i), in, weight,
+                                    nullptr, false, benchmark_out.data());
+    };
+    Run();
+    const auto start = std::chrono::steady_clock::now();
+    Run();
+    const double time =
+        std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    VLOG(3) << "conv cpu config " << static_cast<int>(candidates.at(i).algorithm) << " "
+            << candidates.at(i).tile_size << " " << time;
+    if (i == 0 || time < fastest_time) {
+      fastest_config = candidates.at(i);
+      fastest_time = time;
+    }
+  }
+  {
+    std::lock_guard<std::mutex> lock(impl_->mutex);
+    impl_->cache.emplace(key, fastest_config);
+  }
+  return fastest_config;
+}
+
+template<typename T>
+void ConvCpuKernelUtil<T>::Forward(ep::CpuStream* stream, const ConvCpuProblem& problem,
+                                   const ConvCpuConfig& config, const T* in, const T* weight,
+                                   const T* bias, bool accumulate, T* out) {
+  if (problem.batch_size == 0 || problem.OutSpatialSize() == 0) { return; }
+  if (config.algorithm == ConvCpuAlgorithm::kDepthwise) {
+    CHECK(problem.IsDepthwise());
+    if (problem.channels_last) {
+      DepthwiseForwardChannelsLast<T>(stream, problem, config, in, weight, bias, accumulate, out);
+    } else {
+      DepthwiseForwardChannelsFirst<T>(stream, problem, in, weight, bias, accumulate, out);
+    }
+  } else {
+    GemmForward<T>(stream, problem, config, in, weight, bias, accumulate, out);
+  }
+}
+
+template<typename T>
+void ConvCpuKernelUtil<T>::BackwardData(ep::CpuStream* stream, const ConvCpuProblem& p,
+                                        const T* out, const T* weight, T* in) {
+  const int64_t in_spatial_size = p.InSpatialSize();
+  const int64_t out_spatial_size = p.OutSpatialSize();
+  const int64_t group_in_channels = p.in_channels / p.groups;
+  const int64_t group_out_channels = p.out_channels / p.groups;
+  const int64_t kernel_spatial_size = p.KernelSpatialSize();
+  const int64_t reduce_size = p.ReduceSize();
+  const bool pointwise = p.IsPointwise();
+  const int64_t tile_size = DefaultTileSize<T>(p);
+  // Scattering the columns of different channels touches disjoint parts of the image, so channels
+  // first images are also split by channels when batch x groups can not feed all the threads.
+  int64_t channel_tile_size = group_in_channels;
+  const int64_t num_outer_tasks = p.batch_size * p.groups;
+  const int64_t num_threads = stream->device()->GetNumThreads();
+  if (!p.channels_last && num_outer_tasks < num_threads) {
+    channel_tile_size = CeilDiv(group_in_channels, CeilDiv(num_threads, num_outer_tasks));
+  }
+  const int64_t num_channel_tiles = CeilDiv(group_in_channels, channel_tile_size);
+  stream->ParallelFor(
+      0, num_outer_tasks * num_channel_tiles,
+      [&](int64_t begin, int64_t end) {
+        std::vector<T> panel(pointwise ? 0 : reduce_size * tile_size);
+        for (int64_t task = begin; task < end; ++task) {
+          const int64_t channel_begin = task % num_channel_tiles * channel_tile_size;
+          const int64_t num_channels =
+              std::min(channel_tile_size, group_in_channels - channel_begin);
+          const int64_t group = task / num_channel_tiles % p.groups;
+          const int64_t n = task / num_channel_tiles / p.groups;
+          const T* group_weight = weight + group * group_out_channels * reduce_size;
+          if (p.channels_last) {
+            T* image = in + n * in_spatial_size * p.in_channels + group * group_in_channels;
+            const T* grad = out + n * out_spatial_size * p.out_channels
+                            + group * group_out_channels;
+            if (pointwise) {
+              // in[pos, c] = out[pos, :] * weight[:, c]
+              Gemm<T>(CblasNoTrans, CblasNoTrans, out_spatial_size, group_in_channels,
+                      group_out_channels, grad, p.out_channels, group_weight, reduce_size,
+                      static_cast<T>(0), image, p.in_channels);
+              continue;
+            }
+            for (int64_t pos = 0; pos < in_spatial_size; ++pos) {
+              T* image_row = image + pos * p.in_channels;
+              std::fill(image_row, image_row + group_in_channels, static_cast<T>(0));
+            }
+            for (int64_t pos_begin = 0; pos_begin < out_spatial_size; pos_begin += tile_size) {
+              const int64_t num_pos = std::min(tile_size, out_spatial_size - pos_begin);
+              // columns[pos, :] = out[pos, :] * weight
+              Gemm<T>(CblasNoTrans, CblasNoTrans, num_pos, reduce_size, group_out_channels,
+                      grad + pos_begin * p.out_channels, p.out_channels, group_weight,
+                      reduce_size, static_cast<T>(0), panel.data(), reduce_size);
+              ScatterColumnsChannelsLast<T>(p, panel.data(), pos_begin, num_pos, image);
+            }
+          } else {
+            T* image = in + (n * p.in_channels + group * group_in_channels) * in_spatial_size;
+            const T* grad = out + (n * p.out_channels + group * group_out_channels)
+                                      * out_spatial_size;
+            const int64_t num_rows = num_channels * kernel_spatial_size;
+            const T* tile_weight = group_weight + channel_begin * kernel_spatial_size;
+            if (pointwise) {
+              // in[c, pos] = weight[:, c](T) * out[:, pos]
+              Gemm<T>(CblasTrans, CblasNoTrans, num_channels, out_spatial_size,
+                      group_out_channels, tile_weight, reduce_size, grad, out_spatial_size,
+                      static_cast<T>(0), image + channel_begin * in_spatial_size,
+                      in_spatial_size);
+              continue;
+            }
+            std::fill(image + channel_begin * in_spatial_size,
+                      image + (channel_begin + num_channels) * in_spatial_size, static_cast<T>(0));
+            for (int64_t pos_begin = 0; pos_begin < out_spatial_size; pos_begin += tile_size) {
+              const int64_t num_pos = std::min(tile_size, out_spatial_size - pos_begin);
+              // columns[rows, pos] = weight[:, rows](T) * out[:, pos]
+              Gemm<T>(CblasTrans, CblasNoTrans, num_rows, num_pos, group_out_channels,
+                      tile_weight, reduce_size, grad + pos_begin, out_spatial_size,
+                      static_cast<T>(0), panel.data(), num_pos);
+              ScatterColumnsChannelsFirst<T>(p, panel.data(), channel_begin,
+                                             channel_begin + num_channels, pos_begin, num_pos,
+                                             image);
+            }
+          }
+        }
+      },
+      1);
+}
+
+template ConvCpuConfig ConvCpuTuner::FindForwardConfig<float>(ep::CpuStream* stream,
+                                                              const ConvCpuProblem& problem,
+                                                              const float* in,
+                                                              const float* weight) const;
+template ConvCpuConfig ConvCpuTuner::FindForwardConfig<double>(ep::CpuStream* stream,
+                                                               const ConvCpuProblem& problem,
+                                                               const double* in,
+                                                               const double* weight) const;
+template struct ConvCpuKernelUtil<float>;
+template struct ConvCpuKernelUtil<double>;
+
+}  // namespace oneflow
@@ -0,0 +1,107 @@
+/*
+Copyright 2020 The OneFlow Authors. All rights reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+#ifndef ONEFLOW_USER_KERNELS_CONV_CPU_KERNEL_UTIL_H_
+#define ONEFLOW_USER_KERNELS_CONV_CPU_KERNEL_UTIL_H_
+
+#include "oneflow/core/framework/framework.h"
+#include "oneflow/core/ep/cpu/cpu_stream.h"
+
+namespace oneflow {
+
+// Describes a convolution in terms of its forward direction: `in` is the image that is convolved
+// and `out` is the result, whatever op (conv, conv_data_grad, deconv) the kernel implements. All
+// spatial fields are padded to 3 dims the same way as the 5d shapes of the cpu conv kernels.
+struct ConvCpuProblem {
+  bool channels_last = false;
+  int64_t batch_size = 0;
+  int64_t groups = 1;
+  int64_t in_channels = 0;
+  int64_t out_channels = 0;
+  int64_t in_size[3] = {1, 1, 1};
+  int64_t out_size[3] = {1, 1, 1};
+  int64_t kernel_size[3] = {1, 1, 1};
+  int32_t strides[3] = {1, 1, 1};
+  int32_t dilation_rate[3] = {1, 1, 1};
+  int32_t padding_before[3] = {0, 0, 0};
+
+  int64_t InSpatialSize() const { return in_size[0] * in_size[1] * in_size[2]; }
+  int64_t OutSpatialSize() const { return out_size[0] * out_size[1] * out_size[2]; }
+  int64_t KernelSpatialSize() const { return kernel_size[0] * kernel_size[1] * kernel_size[2]; }
+  // Reduction size of one output element, i.e. the row size of the weight.
+  int64_t ReduceSize() const { return in_channels / groups * KernelSpatialSize(); }
+  bool IsPointwise() const;
+  bool IsDepthwise() const;
+  std::string ToString() const;
+};
+
+ConvCpuProblem MakeConvCpuProblem(bool channels_last, int64_t groups, const ShapeView& in_5d_shape,
+                                  const ShapeView& weight_5d_shape, const ShapeView& out_5d_shape,
+                                  const int32_t* strides, const int32_t* dilation_rate,
+                                  const int32_t* padding_before);
+
+enum class ConvCpuAlgorithm {
+  // im2col is fused into the packing of a column panel per tile of output positions, the panel is
+  // consumed by a gemm right away so that the full column matrix is never materialized.
+  kBlockedGemm,
+  // 1x1 kernel with unit strides and no padding, the image is used as the gemm operand directly.
+  kPointwise,
+  // Direct convolution for groups == in_channels.
+  kDepthwise,
+};
+
+struct ConvCpuConfig {
+  ConvCpuAlgorithm algorithm = ConvCpuAlgorithm::kBlockedGemm;
+  // Number of output positions handled by one task.
+  int64_t tile_size = 0;
+};
+
+// Picks the config of a forward convolution. Unless disabled by
+// ONEFLOW_KERNEL_CONV_CPU_ENABLE_TUNING, all the configs applicable to the problem are timed once
+// on the real inputs the first time a problem is seen and the fastest one is cached.
+class ConvCpuTuner {
+ public:
+  OF_DISALLOW_COPY_AND_MOVE(ConvCpuTuner);
+  ~ConvCpuTuner();
+
+  template<typename T>
+  ConvCpuConfig FindForwardConfig(ep::CpuStream* stream, const ConvCpuProblem& problem,
+                                  const T* in, const T* weight) const;
+
+  static const ConvCpuTuner& Get();
+
+ private:
+  ConvCpuTuner();
+  struct Impl;
+  std::unique_ptr<Impl> impl_;
+};
+
+template<typename T>
+struct ConvCpuKernelUtil {
+  // out = conv(in, weight) + bias, or out += conv(in, weight) + bias if accumulate is set. bias may
+  // be nullptr. The batch, the groups, the output positions and if needed the output channels are
+  // all spread over the threads of the stream.
+  static void Forward(ep::CpuStream* stream, const ConvCpuProblem& problem,
+                      const ConvCpuConfig& config, const T* in, const T* weight, const T* bias,
+                      bool accumulate, T* out);
+  // in = conv_transpose(out, weight), i.e. the data grad of Forward. Used by conv_data_grad and
+  // deconv, `in` is overwritten.
+  static void BackwardData(ep::CpuStream* stream, const ConvCpuProblem& problem, const T* out,
+                           const T* weight, T* in);
+};
+
+}  // namespace oneflow
+
+#endif  // ONEFLOW_USER_KERNELS_CONV_CPU_KERNEL_UTIL_H_
@@ -0,0 +1,227 @@
+/*
+Copyright 2020 The OneFlow Authors. All rights reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+#include "oneflow/core/framework/framework.h"
+#include "oneflow/core/ep/cpu/cpu_stream.h"
+#include "oneflow/core/ep/common/onednn.h"
+
+namespace oneflow {
+
+namespace {
+
+// Elements of x handed to one task of ParallelFor when it is scanned or quantized.
+constexpr int64_t kParallelGrainElemCnt = 32768;
+// Rows of x and rows of the weight multiplied by one task of the integer GEMM, the weight block
+// stays in cache while every row of the x block is multiplied with it.
+constexpr int64_t kGemmBlockRows = 16;
+constexpr int64_t kGemmBlockCols = 16;
+// Products of two int8 values are at most 2^14 in magnitude, so a dot product of this many of
+// them fits the int32 accumulator. Longer rows are summed chunk by chunk in int64.
+constexpr int64_t kMaxInt32DotSize = 65536;
+
+// Symmetric 8 bit quantization of the google formula, the same as fake_quantization with the
+// scale of min_max_observer: q = clamp(round(x / scale), lower, 127).
+void QuantizeRange(const float* in, int64_t size, float scale, int32_t lower, int8_t* out) {
+  if (scale == 0) {
+    std::fill(out, out + size, 0);
+    return;
+  }
+  for (int64_t i = 0; i < size; ++i) {
+    const float q = std::nearbyint(in[i] / scale);
+    out[i] = static_cast<int8_t>(std::min(std::max(q, static_cast<float>(lower)), 127.0f));
+  }
+}
+
+float AbsMax(const float* in, int64_t size) {
+  float abs_max = 0;
+  for (int64_t i = 0; i < size; ++i) { abs_max = std::max(abs_max, std::abs(in[i])); }
+  return abs_max;
+}
+
+// Widened to int32 before the multiply so the loop vectorizes to pmaddwd, or to the vnni dot
+// product instructions when the target has them.
+int64_t Int8Dot(const int8_t* a, const int8_t* b, int64_t size) {
+  int64_t sum = 0;
+  for (int64_t begin = 0; begin < size; begin += kMaxInt32DotSize) {
+    const int64_t end = std::min(size, begin + kMaxInt32DotSize);
+    int32_t chunk_sum = 0;
+    for (int64_t i = begin; i < end; ++i) {
+      chunk_sum += static_cast<int32_t>(a[i]) * static_cast<int32_t>(b[i]);
+    }
+    sum += chunk_sum;
+  }
+  return sum;
+}
+
+// out(m, n) = x_scale * w_scale[j] * (qx(m, k) * qw(n, k)^T) with int32 accumulation.
+void Int8Gemm(ep::CpuStream* stream, int64_t m, int64_t n, int64_t k, const int8_t* qx,
+              float x_scale, const int8_t* qw, const float* w_scale, float* out) {
+  const int64_t row_blocks = (m + kGemmBlockRows - 1) / kGemmBlockRows;
+  const int64_t col_blocks = (n + kGemmBlockCols - 1) / kGemmBlockCols;
+  stream->ParallelFor(
+      0, row_blocks * col_blocks,
+      [&](int64_t begin, int64_t end) {
+        for (int64_t task = begin; task < end; ++task) {
+          const int64_t row_begin = task / col_blocks * kGemmBlockRows;
+          const int64_t row_end = std::min(m, row_begin + kGemmBlockRows);
+          const int64_t col_begin = task % col_blocks * kGemmBlockCols;
+          const int64_t col_end = std::min(n, col_begin + kGemmBlockCols);
+          for (int64_t i = row_begin; i < row_end; ++i) {
+            for (int64_t j = col_begin; j < col_end; ++j) {
+              out[i * n + j] =
+                  static_cast<float>(Int8Dot(qx + i * k, qw + j * k, k)) * x_scale * w_scale[j];
+            }
+          }
+        }
+      },
+      1);
+}
+
+#ifdef WITH_ONEDNN
+
+void OneDnnInt8Gemm(ep::CpuStream* stream, int64_t m, int64_t n, int64_t k, const int8_t* qx,
+                    float x_scale, const int8_t* qw, const float* w_scale, float* out) {
+  stream->onednn_executor()->Launch(
+      [&](dnnl::engine* onednn_engine, dnnl::stream* onednn_stream) {
+        const dnnl::memory::dim dm = m;
+        const dnnl::memory::dim dn = n;
+        const dnnl::memory::dim dk = k;
+        auto src_md = dnnl::memory::desc({dm, dk}, dnnl::memory::data_type::s8,
+                                         dnnl::memory::format_tag::ab);
+        // The (n, k) weight is the (k, n) operand in column major order.
+        auto weights_md = dnnl::memory::desc({dk, dn}, dnnl::memory::data_type::s8,
+                                             dnnl::memory::format_tag::ba);
+        auto dst_md = dnnl::memory::desc({dm, dn}, dnnl::memory::data_type::f32,
+                                         dnnl::memory::format_tag::ab);
+        std::vector<float> output_scales(n);
+        for (int64_t j = 0; j < n; ++j) { output_scales[j] = x_scale * w_scale[j]; }
+        dnnl::primitive_attr attr;
+        attr.set_output_scales(1 << 1, output_scales);
+        auto matmul_d = dnnl::matmul::desc(src_md, weights_md, dst_md);
+        auto matmul_pd = dnnl::matmul::primitive_desc(matmul_d, attr, *onednn_engine);
+        auto src_mem = dnnl::memory(src_md, *onednn_engine, const_cast<int8_t*>(qx));
+        auto weights_mem = dnnl::memory(weights_md, *onednn_engine, const_cast<int8_t*>(qw));
+        auto dst_mem = dnnl::memory(dst_md, *onednn_engine, out);
+        dnnl::matmul(matmul_pd).execute(
+            *onednn_stream,
+            {{DNNL_ARG_SRC, src_mem}, {DNNL_ARG_WEIGHTS, weights_mem}, {DNNL_ARG_DST, dst_mem}});
+      });
+}
+
+#endif  // WITH_ONEDNN
+
+// Symmetric per-channel quantization of the (n, k) weight, scale[j] = max|w[j, :]| / 127.
+void QuantizeWeight(ep::CpuStream* stream, int64_t n, int64_t k, const float* w, int8_t* qw,
+                    float* scale) {
+  stream->ParallelFor(
+      0, n,
+      [&](int64_t begin, int64_t end) {
+        for (int64_t j = begin; j < end; ++j) {
+          scale[j] = AbsMax(w + j * k, k) / 127;
+          QuantizeRange(w + j * k, k, scale[j], -128, qw + j * k);
+        }
+      },
+      std::max<int64_t>(kParallelGrainElemCnt / k, 1));
+}
+
+// tmp_buffer holds the weight scales, the int8 weight and the int8 x, in that order.
+size_t WeightScaleBufferSize(int64_t n) { return GetCudaAlignedSize(n * sizeof(float)); }
+size_t Int8WeightBufferSize(int64_t n, int64_t k) { return GetCudaAlignedSize(n * k); }
+
+// Multiplies float x by the transposed (n, k) weight with 8 bit integer arithmetic. The weight is
+// quantized per channel, symmetric with the google formula, exactly as fake_quantization with
+// per-channel min_max_observer scales does it, and x with one symmetric scale for the whole
+// tensor. Both are quantized on every call, so updates of the weight variable are always seen;
+// quantizing the weight is O(nk) against the O(mnk) product. The products are accumulated in
+// int32 and scaled back to float.
+class DynamicInt8LinearKernel final : public user_op::OpKernel {
+ public:
+  DynamicInt8LinearKernel() = default;
+  ~DynamicInt8LinearKernel() override = default;
+
+ private:
+  void Compute(user_op::KernelComputeContext* ctx) const override {
+    const user_op::Tensor* x = ctx->Tensor4ArgNameAndIndex("x", 0);
+    const user_op::Tensor* w = ctx->Tensor4ArgNameAndIndex("w", 0);
+    user_op::Tensor* out = ctx->Tensor4ArgNameAndIndex("out", 0);
+    user_op::Tensor* tmp_buffer = ctx->Tensor4ArgNameAndIndex("tmp_buffer", 0);
+    const int64_t k = x->shape_view().At(x->shape_view().NumAxes() - 1);
+    if (k == 0) {
+      std::fill_n(out->mut_dptr<float>(), out->shape_view().elem_cnt(), 0.0f);
+      return;
+    }
+    const int64_t m = x->shape_view().elem_cnt() / k;
+    const int64_t n = w->shape_view().At(0);
+    CHECK_GE(tmp_buffer->shape_view().elem_cnt(),
+             WeightScaleBufferSize(n) + Int8WeightBufferSize(n, k) + m * k);
+    auto* stream = ctx->stream()->As<ep::CpuStream>();
+    float* w_scale = tmp_buffer->mut_dptr<float>();
+    int8_t* qw = tmp_buffer->mut_dptr<int8_t>() + WeightScaleBufferSize(n);
+    int8_t* qx = qw + Int8WeightBufferSize(n, k);
+    QuantizeWeight(stream, n, k, w->dptr<float>(), qw, w_scale);
+
+    const int64_t x_elem_cnt = m * k;
+    const float* x_ptr = x->dptr<float>();
+    const int64_t num_blocks = (x_elem_cnt + kParallelGrainElemCnt - 1) / kParallelGrainElemCnt;
+    std::vector<float> block_abs_max(num_blocks);
+    stream->ParallelFor(
+        0, num_blocks,
+        [&](int64_t begin, int64_t end) {
+          for (int64_t i = begin; i < end; ++i) {
+            const int64_t offset = i * kParallelGrainElemCnt;
+            block_abs_max[i] =
+                AbsMax(x_ptr + offset, std::min(kParallelGrainElemCnt, x_elem_cnt - offset));
+          }
+        },
+        1);
+    const float x_scale = *std::max_element(block_abs_max.begin(), block_abs_max.end()) / 127;
+    stream->ParallelFor(
+        0, num_blocks,
+        [&](int64_t begin, int64_t end) {
+          for (int64_t i = begin; i < end; ++i) {
+            const int64_t offset = i * kParallelGrainElemCnt;
+            // -127 keeps the activation range symmetric, so -128 * -128 never enters the sums.
+            QuantizeRange(x_ptr + offset, std::min(kParallelGrainElemCnt, x_elem_cnt - offset),
+                          x_scale, -127, qx + offset);
+          }
+        },
+        1);
+
+#ifdef WITH_ONEDNN
+    if (ep::primitive::OneDnnIsEnabled()) {
+      OneDnnInt8Gemm(stream, m, n, k, qx, x_scale, qw, w_scale, out->mut_dptr<float>());
+      return;
+    }
+#endif  // WITH_ONEDNN
+    Int8Gemm(stream, m, n, k, qx, x_scale, qw, w_scale, out->mut_dptr<float>());
+  }
+
+  bool AlwaysComputeWhenAllOutputsEmpty() const override { return false; }
+};
+
+REGISTER_USER_KERNEL("dynamic_int8_linear")
+    .SetCreateFn<DynamicInt8LinearKernel>()
+    .SetIsMatchedHob((user_op::HobDeviceType() == DeviceType::kCPU)
+                     && (user_op::HobDataType("out", 0) == DataType::kFloat))
+    .SetInferTmpSizeFn([](user_op::InferContext* ctx) -> size_t {
+      const Shape& w_shape = ctx->InputShape("w", 0);
+      const int64_t n = w_shape.At(0);
+      return WeightScaleBufferSize(n) + Int8WeightBufferSize(n, w_shape.At(1))
+             + ctx->InputShape("x", 0).elem_cnt() * sizeof(int8_t);
+    });
+
+}  // namespace
+
+}  // namespace oneflow
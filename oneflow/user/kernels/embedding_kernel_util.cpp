@@ -15,6 +15,7 @@ limitations under the License.
 */
 
 #include "oneflow/user/kernels/embedding_kernel_util.h"
+#include "oneflow/user/kernels/sparse_access_cpu_kernel_util.h"
 
 namespace oneflow {
 
@@ -49,13 +50,14 @@ struct EmbeddingFunctor<DeviceType::kCPU, T, IndexType> final {
   void operator()(ep::Stream* stream, const T* weight_buf, const IndexType* indices_buf, T* out_buf,
                   const int64_t padding_idx, const bool scale_grad_by_freq,
                   const int64_t num_indices, const int64_t emb_size, const int64_t emb_dim) {
-    for (int64_t i = 0; i < num_indices; i++) {
-      IndexType indice = indices_buf[i];
-      CHECK(indice >= 0 && indice < emb_size);
-      const T* from = weight_buf + indice * emb_dim;
-      T* to = out_buf + i * emb_dim;
-      std::copy(from, from + emb_dim, to);
-    }
+    sparse_access_cpu::GatherRows(
+        stream->As<ep::CpuStream>(), weight_buf, 1, emb_size, num_indices, emb_dim,
+        [&](int64_t i) -> int64_t {
+          const IndexType indice = indices_buf[i];
+          CHECK(indice >= 0 && indice < emb_size);
+          return indice;
+        },
+        out_buf);
   }
 };
 
@@ -65,26 +67,20 @@ struct EmbeddingGradFunctor<DeviceType::kCPU, T, IndexType> final {
                   const int64_t padding_idx, const bool scale_grad_by_freq,
                   const int64_t num_indices, const int64_t emb_size, const int64_t emb_dim,
                   int32_t* tmp_buf) {
-    for (int64_t i = 0; i < num_indices; i++) {
-      IndexType indice = indices_buf[i];
-      if (indice != padding_idx) {
-        const T* from = dy_buf + i * emb_dim;
-        T* to = dx_buf + indice * emb_dim;
-        std::transform(from, from + emb_dim, to, to, std::plus<T>());
-      }
-    }
-
-    if (scale_grad_by_freq) {
-      std::vector<IndexType> indice_freq(emb_size, 0);
-      for (int64_t i = 0; i < num_indices; i++) { indice_freq[indices_buf[i]]++; }
-
-      for (int64_t i = 0; i < emb_size; i++) {
-        if (indice_freq[i] > 1) {
-          T* from = dx_buf + i * emb_dim;
-          for (int64_t j = 0; j < emb_dim; j++) { from[j] /= indice_freq[i]; }
-        }
-      }
-    }
+    sparse_access_cpu::SegmentSum(
+        stream->As<ep::CpuStream>(), dy_buf, 1, num_indices, emb_size, emb_dim,
+        [&](int64_t i) -> int64_t {
+          const IndexType indice = indices_buf[i];
+          CHECK(indice >= 0 && indice < emb_size);
+          return indice == padding_idx ? -1 : indice;
+        },
+        [&](int64_t indice, int64_t freq, T* dx_row) {
+          if (scale_grad_by_freq && freq > 1) {
+            const IndexType indice_freq = freq;
+            for (int64_t j = 0; j < emb_dim; j++) { dx_row[j] /= indice_freq; }
+          }
+        },
+        dx_buf);
   }
 };
 
@@ -0,0 +1,463 @@
+/*
+Copyright 2020 The OneFlow Authors. All rights reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+#include "oneflow/core/framework/framework.h"
+#include "oneflow/core/ep/cpu/cpu_stream.h"
+#include "oneflow/user/kernels/fused_attention_util.h"
+#include "oneflow/user/kernels/row_reduce_cpu_kernel_util.h"
+
+namespace oneflow {
+
+namespace user_op {
+
+namespace {
+
+// The kernel below follows the flash attention scheme: every task owns a block of queries of one
+// (batch, head) pair and streams the keys/values through in blocks, so that the Q*K^T tile, the
+// softmax statistics and the output accumulator stay in cache and the full score matrix is never
+// materialized.
+constexpr int64_t kQueriesPerBlock = 32;
+constexpr int64_t kKeysPerBlock = 64;
+
+enum class AttnMaskType {
+  kNone,
+  kCausalFromTopLeft,
+  kCausalFromBottomRight,
+};
+
+template<typename T>
+struct Params {
+  int64_t num_batches;
+  int64_t num_heads;
+  int64_t query_seq_len;
+  int64_t kv_seq_len;
+  int64_t head_size;
+  int64_t value_head_size;
+  float scale;
+  int64_t q_stride_b;
+  int64_t q_stride_m;
+  int64_t q_stride_h;
+  int64_t k_stride_b;
+  int64_t k_stride_m;
+  int64_t k_stride_h;
+  int64_t v_stride_b;
+  int64_t v_stride_m;
+  int64_t v_stride_h;
+  int64_t attn_bias_stride_b;
+  int64_t attn_bias_stride_m;
+  int64_t attn_bias_stride_h;
+  const T* query_ptr;
+  const T* key_ptr;
+  const T* value_ptr;
+  const T* attn_bias_ptr;
+  const int32_t* query_seq_start_ptr;
+  const int32_t* key_seq_start_ptr;
+  const int32_t* key_seq_len_ptr;
+  T* out_ptr;
+  AttnMaskType attn_mask_type;
+  int64_t causal_diagonal_offset;
+};
+
+float Dot(const float* a, const float* b, int64_t n) {
+  return row_reduce::LaneSum<float>(n, [&](int64_t i) { return a[i] * b[i]; });
+}
+
+template<typename T>
+void LoadTile(const T* src, int64_t stride, int64_t rows, int64_t cols, float scale, float* dst) {
+  for (int64_t i = 0; i < rows; ++i) {
+    const T* src_row = src + i * stride;
+    float* dst_row = dst + i * cols;
+    for (int64_t j = 0; j < cols; ++j) { dst_row[j] = static_cast<float>(src_row[j]) * scale; }
+  }
+}
+
+struct Workspace {
+  explicit Workspace(int64_t head_size, int64_t value_head_size)
+      : query(kQueriesPerBlock * head_size),
+        key(kKeysPerBlock * head_size),
+        value(kKeysPerBlock * value_head_size),
+        score(kQueriesPerBlock * kKeysPerBlock),
+        acc(kQueriesPerBlock * value_head_size),
+        row_max(kQueriesPerBlock),
+        row_sum(kQueriesPerBlock) {}
+  std::vector<float> query;
+  std::vector<float> key;
+  std::vector<float> value;
+  std::vector<float> score;
+  std::vector<float> acc;
+  std::vector<float> row_max;
+  std::vector<float> row_sum;
+};
+
+template<typename T>
+void ComputeQueryBlock(const Params<T>& p, int64_t batch, int64_t head, int64_t query_block,
+                       Workspace* ws) {
+  int64_t num_queries = p.query_seq_len;
+  int64_t num_keys = p.kv_seq_len;
+  const T* query_ptr = p.query_ptr + head * p.q_stride_h;
+  const T* key_ptr = p.key_ptr + head * p.k_stride_h;
+  const T* value_ptr = p.value_ptr + head * p.v_stride_h;
+  int64_t out_row_offset = 0;
+  if (p.query_seq_start_ptr != nullptr) {
+    const int64_t query_start = p.query_seq_start_ptr[batch];
+    const int64_t key_start = p.key_seq_start_ptr[batch];
+    num_queries = p.query_seq_start_ptr[batch + 1] - query_start;
+    if (p.key_seq_len_ptr != nullptr) {
+      num_keys = p.key_seq_len_ptr[batch];
+    } else {
+      num_keys = p.key_seq_start_ptr[batch + 1] - key_start;
+    }
+    query_ptr += query_start * p.q_stride_m;
+    key_ptr += key_start * p.k_stride_m;
+    value_ptr += key_start * p.v_stride_m;
+    out_row_offset = query_start;
+  } else {
+    query_ptr += batch * p.q_stride_b;
+    key_ptr += batch * p.k_stride_b;
+    value_ptr += batch * p.v_stride_b;
+    out_row_offset = batch * num_queries;
+  }
+  const int64_t query_begin = query_block * kQueriesPerBlock;
+  if (query_begin >= num_queries) { return; }
+  const int64_t query_end = std::min(num_queries, query_begin + kQueriesPerBlock);
+  const int64_t block_num_queries = query_end - query_begin;
+  const int64_t head_size = p.head_size;
+  const int64_t value_head_size = p.value_head_size;
+  const int64_t out_stride_m = p.num_heads * value_head_size;
+  T* out_ptr = p.out_ptr + (out_row_offset + query_begin) * out_stride_m + head * value_head_size;
+
+  // Key j is visible to query i iff j <= i + diagonal_offset, keys beyond the last visible key of
+  // the last query in the block are never loaded.
+  const bool is_causal = p.attn_mask_type != AttnMaskType::kNone;
+  int64_t diagonal_offset = p.causal_diagonal_offset;
+  if (p.attn_mask_type == AttnMaskType::kCausalFromBottomRight) {
+    diagonal_offset += num_keys - num_queries;
+  }
+  int64_t key_end = num_keys;
+  if (is_causal) {
+    key_end = std::max<int64_t>(0, std::min(key_end, query_end + diagonal_offset));
+  }
+
+  const T* attn_bias_ptr = nullptr;
+  if (p.attn_bias_ptr != nullptr) {
+    attn_bias_ptr = p.attn_bias_ptr + batch * p.attn_bias_stride_b + head * p.attn_bias_stride_h;
+  }
+
+  float* query_tile = ws->query.data();
+  float* key_tile = ws->key.data();
+  float* value_tile = ws->value.data();
+  float* score = ws->score.data();
+  float* acc = ws->acc.data();
+  float* row_max = ws->row_max.data();
+  float* row_sum = ws->row_sum.data();
+  // The softmax scale is folded into the query tile.
+  LoadTile(query_ptr + query_begin * p.q_stride_m, p.q_stride_m, block_num_queries, head_size,
+           p.scale, query_tile);
+  std::fill(acc, acc + block_num_queries * value_head_size, 0.F);
+  std::fill(row_max, row_max + block_num_queries, -std::numeric_limits<float>::infinity());
+  std::fill(row_sum, row_sum + block_num_queries, 0.F);
+
+  for (int64_t key_begin = 0; key_begin < key_end; key_begin += kKeysPerBlock) {
+    const int64_t block_num_keys = std::min(key_end - key_begin, kKeysPerBlock);
+    LoadTile(key_ptr + key_begin * p.k_stride_m, p.k_stride_m, block_num_keys, head_size, 1.F,
+             key_tile);
+    LoadTile(value_ptr + key_begin * p.v_stride_m, p.v_stride_m, block_num_keys, value_head_size,
+             1.F, value_tile);
+    for (int64_t i = 0; i < block_num_queries; ++i) {
+      const int64_t query_idx = query_begin + i;
+      float* score_row = score + i * kKeysPerBlock;
+      const float* query_row = query_tile + i * head_size;
+      int64_t row_num_keys = block_num_keys;
+      if (is_causal) {
+        row_num_keys = std::min(row_num_keys, query_idx + diagonal_offset + 1 - key_begin);
+        // All the keys of this block are masked for this query.
+        if (row_num_keys <= 0) { continue; }
+      }
+      float block_max = -std::numeric_limits<float>::infinity();
+      for (int64_t j = 0; j < row_num_keys; ++j) {
+        float s = Dot(query_row, key_tile + j * head_size, head_size);
+        if (attn_bias_ptr != nullptr) {
+          s += static_cast<float>(attn_bias_ptr[query_idx * p.attn_bias_stride_m + key_begin + j]);
+        }
+        score_row[j] = s;
+        block_max = std::max(block_max, s);
+      }
+      if (block_max == -std::numeric_limits<float>::infinity()) { continue; }
+      const float new_max = std::max(row_max[i], block_max);
+      const float correction = std::exp(row_max[i] - new_max);
+      float* acc_row = acc + i * value_head_size;
+      if (correction != 1.F) {
+        for (int64_t d = 0; d < value_head_size; ++d) { acc_row[d] *= correction; }
+      }
+      float block_sum = 0;
+      for (int64_t j = 0; j < row_num_keys; ++j) {
+        const float prob = std::exp(score_row[j] - new_max);
+        block_sum += prob;
+        const float* value_row = value_tile + j * value_head_size;
+        for (int64_t d = 0; d < value_head_size; ++d) { acc_row[d] += prob * value_row[d]; }
+      }
+      row_sum[i] = row_sum[i] * correction + block_sum;
+      row_max[i] = new_max;
+    }
+  }
+
+  for (int64_t i = 0; i < block_num_queries; ++i) {
+    // Queries that can not see any key produce zeros, the same as the cuda kernel.
+    const float inv_sum = row_sum[i] > 0 ? 1.F / row_sum[i] : 0.F;
+    const float* acc_row = acc + i * value_head_size;
+    T* out_row = out_ptr + i * out_stride_m;
+    for (int64_t d = 0; d < value_head_size; ++d) {
+      out_row[d] = static_cast<T>(acc_row[d] * inv_sum);
+    }
+  }
+}
+
+template<typename T>
+void LaunchFusedMultiHeadAttentionCpu(ep::CpuStream* stream, const Params<T>& p) {
+  const int64_t num_query_blocks = (p.query_seq_len + kQueriesPerBlock - 1) / kQueriesPerBlock;
+  const int64_t num_tasks = p.num_batches * p.num_heads * num_query_blocks;
+  stream->ParallelFor(
+      0, num_tasks,
+      [&](int64_t begin, int64_t end) {
+        Workspace ws(p.head_size, p.value_head_size);
+        for (int64_t task = begin; task < end; ++task) {
+          const int64_t query_block = task % num_query_blocks;
+          const int64_t head = task / num_query_blocks % p.num_heads;
+          const int64_t batch = task / num_query_blocks / p.num_heads;
+          ComputeQueryBlock<T>(p, batch, head, query_block, &ws);
+        }
+      },
+      1);
+}
+
+template<typename T>
+class FusedMultiHeadAttentionInferenceCpuKernel final : public user_op::OpKernel {
+ public:
+  FusedMultiHeadAttentionInferenceCpuKernel() = default;
+  ~FusedMultiHeadAttentionInferenceCpuKernel() override = default;
+
+ private:
+  using user_op::OpKernel::Compute;
+  void Compute(user_op::KernelComputeContext* ctx) const override {
+    const Tensor* query = ctx->Tensor4ArgNameAndIndex("query", 0);
+    const Tensor* key = ctx->Tensor4ArgNameAndIndex("key", 0);
+    const Tensor* value = ctx->Tensor4ArgNameAndIndex("value", 0);
+    const Tensor* attn_bias = nullptr;
+    if (ctx->has_input("attn_bias", 0)) { attn_bias = ctx->Tensor4ArgNameAndIndex("attn_bias", 0); }
+    const Tensor* query_seq_start = nullptr;
+    const Tensor* key_seq_start = nullptr;
+    const Tensor* key_seq_len = nullptr;
+    const float scale = ctx->Attr<double>("scale");
+    if (ctx->has_input("query_seq_start", 0)) {
+      CHECK(ctx->has_input("key_seq_start", 0));
+      query_seq_start = ctx->Tensor4ArgNameAndIndex("query_seq_start", 0);
+      key_seq_start = ctx->Tensor4ArgNameAndIndex("key_seq_start", 0);
+      CHECK(query_seq_start->data_type() == DataType::kInt32);
+      CHECK(key_seq_start->data_type() == DataType::kInt32);
+      CHECK_EQ(query_seq_start->shape_view().NumAxes(), 1);
+      CHECK_GT(query_seq_start->shape_view().At(0), 1);
+      CHECK(query_seq_start->shape_view() == key_seq_start->shape_view());
+      if (ctx->has_input("key_seq_len", 0)) {
+        key_seq_len = ctx->Tensor4ArgNameAndIndex("key_seq_len", 0);
+        CHECK(key_seq_len->data_type() == DataType::kInt32);
+        CHECK_EQ(key_seq_len->shape_view().NumAxes(), 1);
+        CHECK_EQ(key_seq_len->shape_view().At(0), query_seq_start->shape_view().At(0) - 1);
+      }
+    } else {
+      CHECK(!ctx->has_input("key_seq_start", 0));
+      CHECK(!ctx->has_input("key_seq_len", 0));
+    }
+    Tensor* out = ctx->Tensor4ArgNameAndIndex("out", 0);
+    const DataType data_type = query->data_type();
+    CHECK_EQ(key->data_type(), data_type);
+    CHECK_EQ(value->data_type(), data_type);
+    CHECK_EQ(out->data_type(), data_type);
+    const int64_t query_head_size = ctx->Attr<int64_t>("query_head_size");
+    const std::string& attn_mask_type = ctx->Attr<std::string>("attn_mask_type");
+    const int64_t causal_diagonal_offset = ctx->Attr<int64_t>("causal_diagonal_offset");
+    CHECK_GE(causal_diagonal_offset, 0);
+    const std::string& query_layout = ctx->Attr<std::string>("query_layout");
+    const std::string& key_layout = ctx->Attr<std::string>("key_layout");
+    const std::string& value_layout = ctx->Attr<std::string>("value_layout");
+    const std::string& output_layout = ctx->Attr<std::string>("output_layout");
+
+    Optional<int64_t> batch_size;
+    if (query_seq_start != nullptr) { batch_size = query_seq_start->shape_view().At(0) - 1; }
+    Optional<int64_t> query_max_seq_len;
+    const int64_t attr_query_max_seq_len = ctx->Attr<int64_t>("query_max_seq_len");
+    if (attr_query_max_seq_len != 0) { query_max_seq_len = attr_query_max_seq_len; }
+    Optional<int64_t> key_max_seq_len;
+    const int64_t attr_key_max_seq_len = ctx->Attr<int64_t>("key_max_seq_len");
+    if (attr_key_max_seq_len != 0) { key_max_seq_len = attr_key_max_seq_len; }
+
+    int64_t q_b = 0;
+    int64_t q_m = 0;
+    int64_t q_h = 0;
+    int64_t q_k = 0;
+    int64_t q_b_stride = 0;
+    int64_t q_m_stride = 0;
+    int64_t q_h_stride = 0;
+    int64_t q_offset = 0;
+    bool q_bm_packed = false;
+    ParseDims(query->shape_view(), query_layout, batch_size, query_max_seq_len, Optional<int64_t>(),
+              query_head_size, 0, &q_b, &q_m, &q_h, &q_k, &q_b_stride, &q_m_stride, &q_h_stride,
+              &q_offset, &q_bm_packed);
+    if (q_bm_packed) { CHECK(query_seq_start != nullptr); }
+
+    int64_t k_b = 0;
+    int64_t k_m = 0;
+    int64_t k_h = 0;
+    int64_t k_k = 0;
+    int64_t k_b_stride = 0;
+    int64_t k_m_stride = 0;
+    int64_t k_h_stride = 0;
+    int64_t k_offset = 0;
+    bool k_bm_packed = false;
+    ParseDims(key->shape_view(), key_layout, q_b, key_max_seq_len, Optional<int64_t>(),
+              query_head_size, 1, &k_b, &k_m, &k_h, &k_k, &k_b_stride, &k_m_stride, &k_h_stride,
+              &k_offset, &k_bm_packed);
+    CHECK_EQ(k_b, q_b);
+    CHECK_EQ(k_h, q_h);
+    CHECK_EQ(k_bm_packed, q_bm_packed);
+
+    int64_t v_b = 0;
+    int64_t v_m = 0;
+    int64_t v_h = 0;
+    int64_t v_k = 0;
+    int64_t v_b_stride = 0;
+    int64_t v_m_stride = 0;
+    int64_t v_h_stride = 0;
+    int64_t v_offset = 0;
+    bool v_bm_packed = false;
+    ParseDims(value->shape_view(), value_layout, q_b, k_m, q_h, Optional<int64_t>(), 2, &v_b, &v_m,
+              &v_h, &v_k, &v_b_stride, &v_m_stride, &v_h_stride, &v_offset, &v_bm_packed);
+    CHECK_EQ(v_b, q_b);
+    CHECK_EQ(v_m, k_m);
+    CHECK_EQ(v_bm_packed, k_bm_packed);
+    if (output_layout == "BM(HK)") {
+      CHECK(!q_bm_packed);
+      CHECK_EQ(out->shape_view().NumAxes(), 3);
+      CHECK_EQ(out->shape_view().At(0), q_b);
+      CHECK_EQ(out->shape_view().At(1), q_m);
+      CHECK_EQ(out->shape_view().At(2), q_h * v_k);
+    } else if (output_layout == "MB(HK)") {
+      CHECK(!q_bm_packed);
+      CHECK_EQ(out->shape_view().NumAxes(), 3);
+      CHECK_EQ(q_b, 1);
+      CHECK_EQ(out->shape_view().At(0), q_m);
+      CHECK_EQ(out->shape_view().At(1), q_b);
+      CHECK_EQ(out->shape_view().At(2), q_h * v_k);
+    } else if (output_layout == "(BM)(HK)") {
+      CHECK(q_bm_packed);
+      CHECK_EQ(out->shape_view().NumAxes(), 2);
+      CHECK_EQ(out->shape_view().At(0), query->shape_view().At(0));
+      CHECK_EQ(out->shape_view().At(1), q_h * v_k);
+    } else {
+      UNIMPLEMENTED();
+    }
+
+    Params<T> params{};
+    params.num_batches = q_b;
+    params.num_heads = q_h;
+    params.query_seq_len = q_m;
+    params.kv_seq_len = k_m;
+    params.head_size = q_k;
+    params.value_head_size = v_k;
+    params.scale = scale;
+    params.q_stride_b = q_b_stride;
+    params.q_stride_m = q_m_stride;
+    params.q_stride_h = q_h_stride;
+    params.k_stride_b = k_b_stride;
+    params.k_stride_m = k_m_stride;
+    params.k_stride_h = k_h_stride;
+    params.v_stride_b = v_b_stride;
+    params.v_stride_m = v_m_stride;
+    params.v_stride_h = v_h_stride;
+    params.query_ptr = query->dptr<T>() + q_offset;
+    params.key_ptr = key->dptr<T>() + k_offset;
+    params.value_ptr = value->dptr<T>() + v_offset;
+    params.query_seq_start_ptr =
+        query_seq_start == nullptr ? nullptr : query_seq_start->dptr<int32_t>();
+    params.key_seq_start_ptr = key_seq_start == nullptr ? nullptr : key_seq_start->dptr<int32_t>();
+    params.key_seq_len_ptr = key_seq_len == nullptr ? nullptr : key_seq_len->dptr<int32_t>();
+    params.out_ptr = out->mut_dptr<T>();
+    if (attn_mask_type == "none") {
+      params.attn_mask_type = AttnMaskType::kNone;
+    } else if (attn_mask_type == "causal_from_top_left") {
+      params.attn_mask_type = AttnMaskType::kCausalFromTopLeft;
+    } else if (attn_mask_type == "causal_from_bottom_right") {
+      params.attn_mask_type = AttnMaskType::kCausalFromBottomRight;
+    } else {
+      UNIMPLEMENTED();
+    }
+    params.causal_diagonal_offset = causal_diagonal_offset;
+    if (attn_bias != nullptr) {
+      CHECK_EQ(attn_bias->data_type(), data_type);
+      const int64_t num_attn_bias_axes = attn_bias->shape_view().NumAxes();
+      CHECK_GE(num_attn_bias_axes, 1);
+      CHECK_LE(num_attn_bias_axes, 4);
+      DimVector padded_attn_bias_shape;
+      for (int i = 0; i < 4 - num_attn_bias_axes; ++i) { padded_attn_bias_shape.push_back(1); }
+      for (int i = 0; i < num_attn_bias_axes; ++i) {
+        padded_attn_bias_shape.push_back(attn_bias->shape_view().At(i));
+      }
+      CHECK_GE(padded_attn_bias_shape.at(3), k_m);
+      int64_t bias_stride = padded_attn_bias_shape.at(3);
+      if (padded_attn_bias_shape.at(2) == 1) {
+        params.attn_bias_stride_m = 0;
+      } else {
+        CHECK_GE(padded_attn_bias_shape.at(2), q_m);
+        params.attn_bias_stride_m = bias_stride;
+        bias_stride *= padded_attn_bias_shape.at(2);
+      }
+      if (padded_attn_bias_shape.at(1) == 1) {
+        params.attn_bias_stride_h = 0;
+      } else {
+        CHECK_EQ(padded_attn_bias_shape.at(1), q_h);
+        params.attn_bias_stride_h = bias_stride;
+        bias_stride *= q_h;
+      }
+      if (padded_attn_bias_shape.at(0) == 1) {
+        params.attn_bias_stride_b = 0;
+      } else {
+        CHECK_EQ(padded_attn_bias_shape.at(0), q_b);
+        params.attn_bias_stride_b = bias_stride;
+      }
+      params.attn_bias_ptr = attn_bias->dptr<T>();
+    } else {
+      params.attn_bias_ptr = nullptr;
+      params.attn_bias_stride_m = 0;
+      params.attn_bias_stride_h = 0;
+      params.attn_bias_stride_b = 0;
+    }
+    LaunchFusedMultiHeadAttentionCpu<T>(ctx->stream()->As<ep::CpuStream>(), params);
+  }
+  bool AlwaysComputeWhenAllOutputsEmpty() const override { return false; }
+};
+
+#define REGISTER_FUSED_MULTI_HEAD_ATTENTION_INFERENCE_CPU_KERNEL(dtype) \
+  REGISTER_USER_KERNEL("fused_multi_head_attention_inference")          \
+      .SetCreateFn<FusedMultiHeadAttentionInferenceCpuKernel<dtype>>()  \
+      .SetIsMatchedHob((user_op::HobDeviceType() == DeviceType::kCPU)   \
+                       && (user_op::HobDataType("out", 0) == GetDataType<dtype>::value));
+
+REGISTER_FUSED_MULTI_HEAD_ATTENTION_INFERENCE_CPU_KERNEL(float)
+REGISTER_FUSED_MULTI_HEAD_ATTENTION_INFERENCE_CPU_KERNEL(bfloat16)
+
+}  // namespace
+
+}  // namespace user_op
+
+}  // namespace oneflow
@@ -17,6 +17,7 @@ limitations under the License.
 #ifdef WITH_CUTLASS
 
 #include "oneflow/core/framework/framework.h"
+#include "oneflow/user/kernels/fused_attention_util.h"
 #include "oneflow/core/ep/cuda/cuda_stream.h"
 #include "oneflow/core/ep/include/primitive/permute.h"
 #include "cutlass/arch/mma.h"
@@ -32,197 +33,6 @@ namespace user_op {
 
 namespace {
 
-void ParseDims(const ShapeView& shape, const std::string& layout,
-               const Optional<int64_t>& batch_size, const Optional<int64_t>& seq_len,
-               const Optional<int64_t>& num_heads, const Optional<int64_t>& head_size,
-               int64_t tensor_index, int64_t* b, int64_t* m, int64_t* h, int64_t* k,
-               int64_t* b_stride, int64_t* m_stride, int64_t* h_stride, int64_t* offset,
-               bool* bm_packed) {
-  if (shape.NumAxes() == 2) {
-    if (layout == "(BM)(HK)" || layout == "(BM)(H2K)" || layout == "(BM)(H3K)") {
-      *bm_packed = true;
-      CHECK(batch_size);
-      CHECK(seq_len);
-      *b = CHECK_JUST(batch_size);
-      *m = CHECK_JUST(seq_len);
-      int64_t packed_n = 0;
-      if (layout == "(BM)(HK)") {
-        packed_n = 1;
-      } else if (layout == "(BM)(H2K)") {
-        packed_n = 2;
-      } else if (layout == "(BM)(H3K)") {
-        packed_n = 3;
-      } else {
-        UNIMPLEMENTED();
-      }
-      const int64_t hidden_size = shape.At(1);
-      if (num_heads) {
-        const int64_t expected_h = CHECK_JUST(num_heads);
-        const int64_t packed_h = packed_n * expected_h;
-        CHECK_EQ(hidden_size % packed_h, 0);
-        *h = expected_h;
-        *k = hidden_size / packed_h;
-      } else if (head_size) {
-        const int64_t expected_k = CHECK_JUST(head_size);
-        const int64_t packed_k = packed_n * expected_k;
-        CHECK_EQ(hidden_size % packed_k, 0);
-        *h = hidden_size / packed_k;
-        *k = expected_k;
-      } else {
-        UNIMPLEMENTED();
-      }
-      *h_stride = *k * packed_n;
-      *m_stride = *h_stride * *h;
-      *b_stride = 0;
-      if (packed_n == 1) {
-        *offset = 0;
-      } else if (packed_n == 2) {
-        CHECK_GE(tensor_index, 1);
-        *offset = (tensor_index - 1) * *k;
-      } else if (packed_n == 3) {
-        *offset = tensor_index * *k;
-      } else {
-        UNIMPLEMENTED();
-      }
-    } else {
-      UNIMPLEMENTED();
-    }
-  } else if (shape.NumAxes() == 3) {
-    if (layout == "BM(HK)" || layout == "BM(H2K)" || layout == "BM(H3K)" || layout == "MB(HK)"
-        || layout == "MB(H2K)" || layout == "MB(H3K)") {
-      *bm_packed = false;
-      bool batch_first = false;
-      int64_t packed_n = 0;
-      const std::string layout_bm = layout.substr(0, 2);
-      const std::string layout_hk = layout.substr(2);
-      if (layout_bm == "BM") {
-        *b = shape.At(0);
-        *m = shape.At(1);
-        batch_first = true;
-      } else if (layout_bm == "MB") {
-        *b = shape.At(1);
-        *m = shape.At(0);
-        batch_first = false;
-      } else {
-        UNIMPLEMENTED();
-      }
-      if (layout_hk == "(HK)") {
-        packed_n = 1;
-      } else if (layout_hk == "(H2K)") {
-        packed_n = 2;
-      } else if (layout_hk == "(H3K)") {
-        packed_n = 3;
-      } else {
-        UNIMPLEMENTED();
-      }
-      const int64_t hidden_size = shape.At(2);
-      if (num_heads) {
-        const int64_t expected_h = CHECK_JUST(num_heads);
-        const int64_t packed_h = packed_n * expected_h;
-        CHECK_EQ(hidden_size % packed_h, 0);
-        *h = expected_h;
-        *k = hidden_size / packed_h;
-      } else if (head_size) {
-        const int64_t expected_k = CHECK_JUST(head_size);
-        const int64_t packed_k = packed_n * expected_k;
-        CHECK_EQ(hidden_size % packed_k, 0);
-        *h = hidden_size / packed_k;
-        *k = expected_k;
-      } else {
-        UNIMPLEMENTED();
-      }
-      *h_stride = *k * packed_n;
-      if (batch_first) {
-        *m_stride = *h_stride * *h;
-        *b_stride = *m_stride * *m;
-      } else {
-        *b_stride = *h_stride * *h;
-        *m_stride = *b_stride * *b;
-      }
-      if (packed_n == 1) {
-        *offset = 0;
-      } else if (packed_n == 2) {
-        CHECK_GE(tensor_index, 1);
-        *offset = (tensor_index - 1) * *k;
-      } else if (packed_n == 3) {
-        *offset = tensor_index * *k;
-      } else {
-        UNIMPLEMENTED();
-      }
-    } else if (layout == "(BM)HK") {
-      *bm_packed = true;
-      CHECK(batch_size);
-      CHECK(seq_len);
-      *b = CHECK_JUST(batch_size);
-      *m = CHECK_JUST(seq_len);
-      *h = shape.At(1);
-      *k = shape.At(2);
-      *h_stride = *k;
-      *m_stride = *h_stride * *h;
-      *b_stride = 0;
-    } else {
-      UNIMPLEMENTED();
-    }
-  } else if (shape.NumAxes() == 4) {
-    *bm_packed = false;
-    if (layout == "BMHK") {
-      *b = shape.At(0);
-      *m = shape.At(1);
-      *h = shape.At(2);
-      *k = shape.At(3);
-      *h_stride = *k;
-      *m_stride = *h_stride * *h;
-      *b_stride = *m_stride * *m;
-    } else if (layout == "BHMK") {
-      *b = shape.At(0);
-      *m = shape.At(2);
-      *h = shape.At(1);
-      *k = shape.At(3);
-      *m_stride = *k;
-      *h_stride = *m_stride * *m;
-      *b_stride = *h_stride * *h;
-    } else if (layout == "MBHK") {
-      *b = shape.At(1);
-      *m = shape.At(0);
-      *h = shape.At(2);
-      *k = shape.At(3);
-      *h_stride = *k;
-      *b_stride = *h_stride * *h;
-      *m_stride = *b_stride * *b;
-    } else {
-      UNIMPLEMENTED();
-    }
-    *offset = 0;
-  } else {
-    UNIMPLEMENTED();
-  };
-  if (batch_size) {
-    const int64_t expected_b = CHECK_JUST(batch_size);
-    CHECK_EQ(*b, expected_b);
-  }
-  if (seq_len) {
-    const int64_t expected_m = CHECK_JUST(seq_len);
-    CHECK_EQ(*m, expected_m);
-  }
-  if (num_heads) {
-    const int64_t expected_h = CHECK_JUST(num_heads);
-    CHECK_EQ(*h, expected_h);
-  }
-  if (head_size) {
-    const int64_t expected_k = CHECK_JUST(head_size);
-    CHECK_EQ(*k, expected_k);
-  }
-}
-
-void ParseDims(const ShapeView& shape, const std::string& layout,
-               const Optional<int64_t>& num_heads, const Optional<int64_t>& head_size,
-               int64_t tensor_index, int64_t* b, int64_t* m, int64_t* h, int64_t* k,
-               int64_t* b_stride, int64_t* m_stride, int64_t* h_stride, int64_t* offset) {
-  bool bm_packed{};
-  ParseDims(shape, layout, Optional<int64_t>(), Optional<int64_t>(), num_heads, head_size,
-            tensor_index, b, m, h, k, b_stride, m_stride, h_stride, offset, &bm_packed);
-}
-
 template<typename T, int pack_size>
 struct alignas(pack_size * sizeof(T)) Pack {
   T elem[pack_size];
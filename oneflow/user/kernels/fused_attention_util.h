@@ -0,0 +1,43 @@
+/*
+Copyright 2020 The OneFlow Authors. All rights reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+#ifndef ONEFLOW_USER_KERNELS_FUSED_ATTENTION_UTIL_H_
+#define ONEFLOW_USER_KERNELS_FUSED_ATTENTION_UTIL_H_
+
+#include "oneflow/core/framework/framework.h"
+
+namespace oneflow {
+
+namespace user_op {
+
+// Parses the batch/seq/head/head_size dims of a query, key or value tensor in the given layout,
+// tensor_index selects the slice of a packed (H2K)/(H3K) layout.
+void ParseDims(const ShapeView& shape, const std::string& layout,
+               const Optional<int64_t>& batch_size, const Optional<int64_t>& seq_len,
+               const Optional<int64_t>& num_heads, const Optional<int64_t>& head_size,
+               int64_t tensor_index, int64_t* b, int64_t* m, int64_t* h, int64_t* k,
+               int64_t* b_stride, int64_t* m_stride, int64_t* h_stride, int64_t* offset,
+               bool* bm_packed);
+
+void ParseDims(const ShapeView& shape, const std::string& layout,
+               const Optional<int64_t>& num_heads, const Optional<int64_t>& head_size,
+               int64_t tensor_index, int64_t* b, int64_t* m, int64_t* h, int64_t* k,
+               int64_t* b_stride, int64_t* m_stride, int64_t* h_stride, int64_t* offset);
+
+}  // namespace user_op
+
+}  // namespace oneflow
+
+#endif  // ONEFLOW_USER_KERNELS_FUSED_ATTENTION_UTIL_H_
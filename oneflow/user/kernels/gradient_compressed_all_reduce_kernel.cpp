@@ -0,0 +1,141 @@
+/*
+Copyright 2020 The OneFlow Authors. All rights reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+#include "oneflow/core/framework/framework.h"
+#include "oneflow/core/job/parallel_desc.h"
+#include "oneflow/core/thread/thread_global_id.h"
+#include "oneflow/user/kernels/collective_communication/include/communication_context.h"
+#include "oneflow/user/kernels/gradient_compression_util.h"
+
+namespace oneflow {
+
+namespace {
+
+// Eager ops carry their placement in the parallel_conf attr, lazy ops run on the placement of the
+// op itself.
+Symbol<ParallelDesc> GetCommParallelDesc(const std::string& parallel_conf_txt,
+                                         const ParallelDesc& op_parallel_desc) {
+  if (parallel_conf_txt.empty()) { return SymbolOf(op_parallel_desc); }
+  ParallelConf parallel_conf;
+  CHECK(TxtString2PbMessage(parallel_conf_txt, &parallel_conf));
+  return SymbolOf(ParallelDesc(parallel_conf));
+}
+
+class GradientCompressedAllReduceKernelCache final : public user_op::OpKernelCache {
+ public:
+  explicit GradientCompressedAllReduceKernelCache(user_op::KernelCacheContext* ctx)
+      : is_lazy_(ctx->Attr<std::string>("parallel_conf").empty()) {
+    Symbol<ParallelDesc> parallel_desc =
+        GetCommParallelDesc(ctx->Attr<std::string>("parallel_conf"), ctx->parallel_desc());
+    num_ranks_ = parallel_desc->parallel_num();
+    communication_ctx_ = ccl::NewCommunicationContext(parallel_desc->device_type(), parallel_desc);
+  }
+  ~GradientCompressedAllReduceKernelCache() override = default;
+
+  bool is_lazy() const { return is_lazy_; }
+  int64_t num_ranks() const { return num_ranks_; }
+  const std::shared_ptr<ccl::CommunicationContext>& communication_ctx() const {
+    return communication_ctx_;
+  }
+
+ private:
+  bool is_lazy_;
+  int64_t num_ranks_;
+  std::shared_ptr<ccl::CommunicationContext> communication_ctx_;
+};
+
+template<typename Context>
+GradientCompressionArgs GetGradientCompressionArgs(Context* ctx, const Shape& in_shape,
+                                                   const Shape* q_shape) {
+  GradientCompressionArgs args{};
+  args.method =
+      CHECK_JUST(ParseGradientCompressionMethod(ctx->template Attr<std::string>("method")));
+  args.elem_cnt = in_shape.elem_cnt();
+  args.top_k_ratio = ctx->template Attr<float>("top_k_ratio");
+  if (q_shape != nullptr) {
+    args.power_sgd_cols = q_shape->At(0);
+    args.power_sgd_rank = q_shape->At(1);
+  }
+  return args;
+}
+
+size_t InferGradientCompressedAllReduceTmpSize(user_op::InferContext* ctx) {
+  const Shape& in_shape = ctx->InputShape("in", 0);
+  const Shape* q_shape = ctx->has_input("q", 0) ? &ctx->InputShape("q", 0) : nullptr;
+  const GradientCompressionArgs args = GetGradientCompressionArgs(ctx, in_shape, q_shape);
+  const std::string& parallel_conf_txt = ctx->Attr<std::string>("parallel_conf");
+  int64_t num_ranks = ctx->parallel_num();
+  if (!parallel_conf_txt.empty()) {
+    num_ranks = GetCommParallelDesc(parallel_conf_txt, ctx->parallel_desc())->parallel_num();
+  }
+  return GetGradientCompressionTmpBufferSize(args, num_ranks);
+}
+
+}  // namespace
+
+class GradientCompressedAllReduceKernel final : public user_op::OpKernel {
+ public:
+  GradientCompressedAllReduceKernel() = default;
+  ~GradientCompressedAllReduceKernel() override = default;
+
+  void InitOpKernelCacheWithFlags(
+      user_op::KernelCacheContext* ctx, int8_t flag,
+      std::shared_ptr<user_op::OpKernelCache>* cache_ptr) const override {
+    if (*cache_ptr == nullptr) {
+      *cache_ptr = std::make_shared<GradientCompressedAllReduceKernelCache>(ctx);
+    }
+  }
+
+ private:
+  void Compute(user_op::KernelComputeContext* ctx, user_op::OpKernelState*,
+               const user_op::OpKernelCache* cache) const override {
+    const auto* kernel_cache = dynamic_cast<const GradientCompressedAllReduceKernelCache*>(cache);
+    CHECK(kernel_cache != nullptr);
+    const user_op::Tensor* in = ctx->Tensor4ArgNameAndIndex("in", 0);
+    user_op::Tensor* out = ctx->Tensor4ArgNameAndIndex("out", 0);
+    user_op::Tensor* error =
+        ctx->has_input("error", 0) ? ctx->Tensor4ArgNameAndIndex("error", 0) : nullptr;
+    user_op::Tensor* q = ctx->has_input("q", 0) ? ctx->Tensor4ArgNameAndIndex("q", 0) : nullptr;
+    user_op::Tensor* tmp_buffer = ctx->Tensor4ArgNameAndIndex("tmp_buffer", 0);
+    const Shape in_shape(in->shape_view());
+    const Shape q_shape = q == nullptr ? Shape() : Shape(q->shape_view());
+    const GradientCompressionArgs args =
+        GetGradientCompressionArgs(ctx, in_shape, q == nullptr ? nullptr : &q_shape);
+    std::unique_ptr<GradientCompressionComm> comm =
+        NewCclGradientCompressionComm(ctx->device_type(), ctx->stream(),
+                                      kernel_cache->communication_ctx(), kernel_cache->num_ranks());
+    // Actor threads have no thread global id of their own; the pass that inserts the lazy op
+    // chains all of them, so at most one communicates under this id at a time. The id also keys
+    // the shared memory arena of the cpu collectives, so the lazy op never shares one with the
+    // eager collectives or the collective boxing comm threads.
+    std::unique_ptr<ThreadGlobalIdGuard> guard;
+    if (kernel_cache->is_lazy()) {
+      guard = std::make_unique<ThreadGlobalIdGuard>(kThreadGlobalIdGradientCompression);
+    }
+    GradientCompressedAllReduce(args, comm.get(), in->dptr<float>(), out->mut_dptr<float>(),
+                                error == nullptr ? nullptr : error->mut_dptr<float>(),
+                                q == nullptr ? nullptr : q->mut_dptr<float>(),
+                                tmp_buffer->mut_dptr());
+  }
+  bool AlwaysComputeWhenAllOutputsEmpty() const override { return false; }
+};
+
+REGISTER_USER_KERNEL("gradient_compressed_all_reduce")
+    .SetCreateFn<GradientCompressedAllReduceKernel>()
+    .SetIsMatchedHob((user_op::HobDeviceType() == DeviceType::kCPU)
+                     && (user_op::HobDataType("in", 0) == DataType::kFloat))
+    .SetInferTmpSizeFn(InferGradientCompressedAllReduceTmpSize);
+
+}  // namespace oneflow
@@ -0,0 +1,314 @@
+/*
+Copyright 2020 The OneFlow Authors. All rights reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+#include "oneflow/user/kernels/gradient_compression_util.h"
+#include "oneflow/core/common/data_type.h"
+#include "oneflow/user/kernels/collective_communication/include/all_reduce.h"
+#include "oneflow/user/kernels/collective_communication/include/all_gather.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <limits>
+#include <numeric>
+#include <random>
+
+namespace oneflow {
+
+namespace {
+
+constexpr size_t kTmpAlignSize = 64;
+// Every rank draws the initial PowerSGD factor from the same sequence, so the factors agree
+// without being communicated.
+constexpr uint32_t kPowerSgdInitSeed = 0x5EED;
+constexpr float kPowerSgdOrthogonalizeEpsilon = 1e-8;
+
+size_t AlignTmpSize(size_t size) {
+  return (size + kTmpAlignSize - 1) / kTmpAlignSize * kTmpAlignSize;
+}
+
+int64_t GetTopKCount(const GradientCompressionArgs& args) {
+  const int64_t k = static_cast<int64_t>(std::ceil(args.elem_cnt * args.top_k_ratio));
+  return std::min(std::max<int64_t>(k, 1), args.elem_cnt);
+}
+
+bool UsePowerSgd(const GradientCompressionArgs& args) {
+  return args.method == GradientCompressionMethod::kPowerSgd && args.power_sgd_cols > 0;
+}
+
+class CclGradientCompressionComm final : public GradientCompressionComm {
+ public:
+  OF_DISALLOW_COPY_AND_MOVE(CclGradientCompressionComm);
+  CclGradientCompressionComm(DeviceType device_type, ep::Stream* stream,
+                             const std::shared_ptr<ccl::CommunicationContext>& communication_ctx,
+                             int64_t num_ranks)
+      : device_type_(device_type),
+        stream_(stream),
+        communication_ctx_(communication_ctx),
+        num_ranks_(num_ranks) {}
+  ~CclGradientCompressionComm() override = default;
+
+  int64_t num_ranks() const override { return num_ranks_; }
+
+  void AllReduce(DataType data_type, const void* in, void* out, int64_t elem_cnt) override {
+    std::unique_ptr<ccl::AllReduce> all_reduce =
+        ccl::NewCollectiveCommunication<ccl::AllReduce>(device_type_, data_type, ccl::kSum);
+    all_reduce->Launch(stream_, in, out, elem_cnt, communication_ctx_);
+  }
+
+  void AllGather(DataType data_type, const void* in, void* out, int64_t elem_cnt) override {
+    std::unique_ptr<ccl::AllGather> all_gather =
+        ccl::NewCollectiveCommunication<ccl::AllGather>(device_type_, data_type);
+    all_gather->Launch(stream_, in, out, elem_cnt, communication_ctx_);
+  }
+
+ private:
+  DeviceType device_type_;
+  ep::Stream* stream_;
+  std::shared_ptr<ccl::CommunicationContext> communication_ctx_;
+  int64_t num_ranks_;
+};
+
+template<typename T>
+void HalfCompressedAllReduce(const GradientCompressionArgs& args, GradientCompressionComm* comm,
+                             const float* acc, float* out, float* error, void* tmp) {
+  T* half = reinterpret_cast<T*>(tmp);
+  for (int64_t i = 0; i < args.elem_cnt; ++i) {
+    half[i] = static_cast<T>(acc[i]);
+    if (error != nullptr) { error[i] = acc[i] - static_cast<float>(half[i]); }
+  }
+  comm->AllReduce(GetDataType<T>::value, half, half, args.elem_cnt);
+  for (int64_t i = 0; i < args.elem_cnt; ++i) { out[i] = static_cast<float>(half[i]); }
+}
+
+// Gram-Schmidt on the columns of the row-major rows x cols matrix `m`.
+void OrthonormalizeColumns(float* m, int64_t rows, int64_t cols) {
+  for (int64_t j = 0; j < cols; ++j) {
+    for (int64_t k = 0; k < j; ++k) {
+      double dot = 0;
+      for (int64_t i = 0; i < rows; ++i) { dot += m[i * cols + j] * m[i * cols + k]; }
+      for (int64_t i = 0; i < rows; ++i) { m[i * cols + j] -= dot * m[i * cols + k]; }
+    }
+    double norm = 0;
+    for (int64_t i = 0; i < rows; ++i) { norm += m[i * cols + j] * m[i * cols + j]; }
+    const float scale = 1.0 / (std::sqrt(norm) + kPowerSgdOrthogonalizeEpsilon);
+    for (int64_t i = 0; i < rows; ++i) { m[i * cols + j] *= scale; }
+  }
+}
+
+// Views the gradient as M (rows x cols) and sends P = M Q and Q' = M^T P instead of M, see
+// "PowerSGD: Practical Low-Rank Gradient Compression for Distributed Optimization".
+void PowerSgdCompressedAllReduce(const GradientCompressionArgs& args,
+                                 GradientCompressionComm* comm, const float* m, float* out,
+                                 float* error, float* q, void* tmp) {
+  const int64_t cols = args.power_sgd_cols;
+  const int64_t rows = args.elem_cnt / cols;
+  const int64_t rank = args.power_sgd_rank;
+  float* p = reinterpret_cast<float*>(tmp);
+  float* local_q = p + rows * rank;
+  if (std::all_of(q, q + cols * rank, [](float x) { return x == 0; })) {
+    std::mt19937 generator(kPowerSgdInitSeed);
+    std::normal_distribution<float> distribution;
+    for (int64_t i = 0; i < cols * rank; ++i) { q[i] = distribution(generator); }
+  }
+  std::fill(p, p + rows * rank, 0.f);
+  for (int64_t i = 0; i < rows; ++i) {
+    const float* m_row = m + i * cols;
+    float* p_row = p + i * rank;
+    for (int64_t c = 0; c < cols; ++c) {
+      const float* q_row = q + c * rank;
+      for (int64_t r = 0; r < rank; ++r) { p_row[r] += m_row[c] * q_row[r]; }
+    }
+  }
+  comm->AllReduce(DataType::kFloat, p, p, rows * rank);
+  OrthonormalizeColumns(p, rows, rank);
+  std::fill(local_q, local_q + cols * rank, 0.f);
+  for (int64_t i = 0; i < rows; ++i) {
+    const float* m_row = m + i * cols;
+    const float* p_row = p + i * rank;
+    for (int64_t c = 0; c < cols; ++c) {
+      float* q_row = local_q + c * rank;
+      for (int64_t r = 0; r < rank; ++r) { q_row[r] += m_row[c] * p_row[r]; }
+    }
+  }
+  if (error != nullptr) {
+    // This rank's share of the approximation is P local_q^T.
+    for (int64_t i = 0; i < rows; ++i) {
+      const float* p_row = p + i * rank;
+      for (int64_t c = 0; c < cols; ++c) {
+        const float* q_row = local_q + c * rank;
+        float approx = 0;
+        for (int64_t r = 0; r < rank; ++r) { approx += p_row[r] * q_row[r]; }
+        error[i * cols + c] = m[i * cols + c] - approx;
+      }
+    }
+  }
+  comm->AllReduce(DataType::kFloat, local_q, q, cols * rank);
+  for (int64_t i = 0; i < rows; ++i) {
+    const float* p_row = p + i * rank;
+    for (int64_t c = 0; c < cols; ++c) {
+      const float* q_row = q + c * rank;
+      float sum = 0;
+      for (int64_t r = 0; r < rank; ++r) { sum += p_row[r] * q_row[r]; }
+      out[i * cols + c] = sum;
+    }
+  }
+}
+
+// Every rank contributes its k largest-magnitude entries as (value, index) pairs, which are
+// all-gathered and scatter-added in rank order, so all ranks produce the same sum.
+void TopKCompressedAllReduce(const GradientCompressionArgs& args, GradientCompressionComm* comm,
+                             const float* acc, float* out, float* error, void* tmp) {
+  const int64_t n = args.elem_cnt;
+  const int64_t k = GetTopKCount(args);
+  int32_t* indices = reinterpret_cast<int32_t*>(tmp);
+  int32_t* send = reinterpret_cast<int32_t*>(reinterpret_cast<char*>(tmp)
+                                             + AlignTmpSize(n * sizeof(int32_t)));
+  int32_t* recv = reinterpret_cast<int32_t*>(reinterpret_cast<char*>(send)
+                                             + AlignTmpSize(2 * k * sizeof(int32_t)));
+  std::iota(indices, indices + n, 0);
+  std::nth_element(indices, indices + k - 1, indices + n, [&](int32_t lhs, int32_t rhs) {
+    const float lhs_abs = std::abs(acc[lhs]);
+    const float rhs_abs = std::abs(acc[rhs]);
+    return lhs_abs > rhs_abs || (lhs_abs == rhs_abs && lhs < rhs);
+  });
+  std::sort(indices, indices + k);
+  float* send_values = reinterpret_cast<float*>(send);
+  for (int64_t j = 0; j < k; ++j) {
+    send_values[j] = acc[indices[j]];
+    send[k + j] = indices[j];
+  }
+  if (error != nullptr) {
+    std::copy(acc, acc + n, error);
+    for (int64_t j = 0; j < k; ++j) { error[indices[j]] = 0; }
+  }
+  static_assert(sizeof(float) == sizeof(int32_t), "");
+  comm->AllGather(DataType::kInt32, send, recv, 2 * k);
+  std::fill(out, out + n, 0.f);
+  for (int64_t rank = 0; rank < comm->num_ranks(); ++rank) {
+    const int32_t* rank_recv = recv + rank * 2 * k;
+    const float* values = reinterpret_cast<const float*>(rank_recv);
+    for (int64_t j = 0; j < k; ++j) { out[rank_recv[k + j]] += values[j]; }
+  }
+}
+
+}  // namespace
+
+Maybe<GradientCompressionMethod> ParseGradientCompressionMethod(const std::string& method) {
+  if (method == "fp16") {
+    return GradientCompressionMethod::kFp16;
+  } else if (method == "bf16") {
+    return GradientCompressionMethod::kBf16;
+  } else if (method == "power_sgd") {
+    return GradientCompressionMethod::kPowerSgd;
+  } else if (method == "top_k") {
+    return GradientCompressionMethod::kTopK;
+  } else {
+    return Error::InvalidValueError()
+           << "gradient compression method should be one of fp16, bf16, power_sgd and top_k, but "
+              "got "
+           << method;
+  }
+}
+
+bool GetPowerSgdFactorShape(const Shape& shape, int64_t rank, Shape* factor_shape) {
+  if (shape.NumAxes() < 2 || shape.elem_cnt() == 0 || rank <= 0) { return false; }
+  const int64_t rows = shape.At(0);
+  const int64_t cols = shape.elem_cnt() / rows;
+  const int64_t factor_rank = std::min(rank, std::min(rows, cols));
+  if ((rows + cols) * factor_rank >= rows * cols) { return false; }
+  *factor_shape = Shape({cols, factor_rank});
+  return true;
+}
+
+std::unique_ptr<GradientCompressionComm> NewCclGradientCompressionComm(
+    DeviceType device_type, ep::Stream* stream,
+    const std::shared_ptr<ccl::CommunicationContext>& communication_ctx, int64_t num_ranks) {
+  return std::make_unique<CclGradientCompressionComm>(device_type, stream, communication_ctx,
+                                                      num_ranks);
+}
+
+size_t GetGradientCompressionTmpBufferSize(const GradientCompressionArgs& args,
+                                           int64_t num_ranks) {
+  const size_t acc_size = AlignTmpSize(args.elem_cnt * sizeof(float));
+  switch (args.method) {
+    case GradientCompressionMethod::kFp16:
+    case GradientCompressionMethod::kBf16: return acc_size + AlignTmpSize(args.elem_cnt * 2);
+    case GradientCompressionMethod::kPowerSgd: {
+      if (!UsePowerSgd(args)) { return acc_size; }
+      const int64_t rows = args.elem_cnt / args.power_sgd_cols;
+      return acc_size
+             + AlignTmpSize((rows + args.power_sgd_cols) * args.power_sgd_rank * sizeof(float));
+    }
+    case GradientCompressionMethod::kTopK: {
+      const int64_t k = GetTopKCount(args);
+      return acc_size + AlignTmpSize(args.elem_cnt * sizeof(int32_t))
+             + AlignTmpSize(2 * k * sizeof(int32_t))
+             + AlignTmpSize(num_ranks * 2 * k * sizeof(int32_t));
+    }
+    default: UNIMPLEMENTED(); return 0;
+  }
+}
+
+int64_t GetGradientCompressionPayloadSize(const GradientCompressionArgs& args) {
+  switch (args.method) {
+    case GradientCompressionMethod::kFp16:
+    case GradientCompressionMethod::kBf16: return args.elem_cnt * 2;
+    case GradientCompressionMethod::kPowerSgd: {
+      if (!UsePowerSgd(args)) { return args.elem_cnt * sizeof(float); }
+      const int64_t rows = args.elem_cnt / args.power_sgd_cols;
+      return (rows + args.power_sgd_cols) * args.power_sgd_rank * sizeof(float);
+    }
+    case GradientCompressionMethod::kTopK:
+      return GetTopKCount(args) * (sizeof(float) + sizeof(int32_t));
+    default: UNIMPLEMENTED(); return 0;
+  }
+}
+
+void GradientCompressedAllReduce(const GradientCompressionArgs& args,
+                                 GradientCompressionComm* comm, const float* in, float* out,
+                                 float* error, float* q, void* tmp) {
+  if (args.elem_cnt == 0) { return; }
+  CHECK_LE(args.elem_cnt, std::numeric_limits<int32_t>::max());
+  float* acc = reinterpret_cast<float*>(tmp);
+  void* method_tmp = reinterpret_cast<char*>(tmp) + AlignTmpSize(args.elem_cnt * sizeof(float));
+  for (int64_t i = 0; i < args.elem_cnt; ++i) {
+    acc[i] = error == nullptr ? in[i] : in[i] + error[i];
+  }
+  switch (args.method) {
+    case GradientCompressionMethod::kFp16:
+      HalfCompressedAllReduce<float16>(args, comm, acc, out, error, method_tmp);
+      break;
+    case GradientCompressionMethod::kBf16:
+      HalfCompressedAllReduce<bfloat16>(args, comm, acc, out, error, method_tmp);
+      break;
+    case GradientCompressionMethod::kPowerSgd:
+      if (UsePowerSgd(args)) {
+        CHECK_NOTNULL(q);
+        CHECK_EQ(args.elem_cnt % args.power_sgd_cols, 0);
+        PowerSgdCompressedAllReduce(args, comm, acc, out, error, q, method_tmp);
+      } else {
+        comm->AllReduce(DataType::kFloat, acc, out, args.elem_cnt);
+        if (error != nullptr) { std::fill(error, error + args.elem_cnt, 0.f); }
+      }
+      break;
+    case GradientCompressionMethod::kTopK:
+      TopKCompressedAllReduce(args, comm, acc, out, error, method_tmp);
+      break;
+    default: UNIMPLEMENTED();
+  }
+}
+
+}  // namespace oneflow
@@ -0,0 +1,95 @@
+/*
+Copyright 2020 The OneFlow Authors. All rights reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+#ifndef ONEFLOW_USER_KERNELS_GRADIENT_COMPRESSION_UTIL_H_
+#define ONEFLOW_USER_KERNELS_GRADIENT_COMPRESSION_UTIL_H_
+
+#include "oneflow/core/common/maybe.h"
+#include "oneflow/core/common/data_type.pb.h"
+#include "oneflow/core/common/device_type.pb.h"
+#include "oneflow/core/common/shape.h"
+
+namespace oneflow {
+
+namespace ep {
+
+class Stream;
+
+}  // namespace ep
+
+namespace ccl {
+
+class CommunicationContext;
+
+}  // namespace ccl
+
+enum class GradientCompressionMethod {
+  kFp16,
+  kBf16,
+  kPowerSgd,
+  kTopK,
+};
+
+Maybe<GradientCompressionMethod> ParseGradientCompressionMethod(const std::string& method);
+
+// Shape of the PowerSGD right factor of a gradient of `shape`, i.e. {cols, rank} where the
+// gradient is viewed as a shape.At(0) x cols matrix. Returns false if low-rank compression would
+// not send fewer bytes than the gradient itself, in which case the gradient is all-reduced as is.
+bool GetPowerSgdFactorShape(const Shape& shape, int64_t rank, Shape* factor_shape);
+
+// The collectives a compressed all-reduce communicates through. Every rank issues the same
+// sequence of calls.
+class GradientCompressionComm {
+ public:
+  GradientCompressionComm() = default;
+  virtual ~GradientCompressionComm() = default;
+
+  virtual int64_t num_ranks() const = 0;
+  // Sums `elem_cnt` elements over all ranks.
+  virtual void AllReduce(DataType data_type, const void* in, void* out, int64_t elem_cnt) = 0;
+  // Concatenates `elem_cnt` elements of every rank in rank order.
+  virtual void AllGather(DataType data_type, const void* in, void* out, int64_t elem_cnt) = 0;
+};
+
+std::unique_ptr<GradientCompressionComm> NewCclGradientCompressionComm(
+    DeviceType device_type, ep::Stream* stream,
+    const std::shared_ptr<ccl::CommunicationContext>& communication_ctx, int64_t num_ranks);
+
+struct GradientCompressionArgs {
+  GradientCompressionMethod method;
+  int64_t elem_cnt;
+  float top_k_ratio;
+  // The PowerSGD factor is cols x rank. Zero cols means there is no factor and the gradient is
+  // all-reduced uncompressed.
+  int64_t power_sgd_cols;
+  int64_t power_sgd_rank;
+};
+
+size_t GetGradientCompressionTmpBufferSize(const GradientCompressionArgs& args, int64_t num_ranks);
+
+// Bytes every rank puts into the collectives for one gradient.
+int64_t GetGradientCompressionPayloadSize(const GradientCompressionArgs& args);
+
+// Sums the float gradients `in` of all ranks into `out`, which may alias `in`, through a lossy
+// encoding. If `error` is not null it carries the part of this rank's gradient that the encoding
+// dropped over to the next step (error feedback). `q` is the PowerSGD right factor; it is warm
+// started from its previous value and must be zero-initialized before the first step.
+void GradientCompressedAllReduce(const GradientCompressionArgs& args,
+                                 GradientCompressionComm* comm, const float* in, float* out,
+                                 float* error, float* q, void* tmp);
+
+}  // namespace oneflow
+
+#endif  // ONEFLOW_USER_KERNELS_GRADIENT_COMPRESSION_UTIL_H_
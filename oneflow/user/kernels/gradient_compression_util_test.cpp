@@ -0,0 +1,276 @@
+/*
+Copyright 2020 The OneFlow Authors. All rights reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+#include "oneflow/user/kernels/gradient_compression_util.h"
+#include "oneflow/core/common/data_type.h"
+
+#include <gtest/gtest.h>
+#include <algorithm>
+#include <cmath>
+#include <condition_variable>
+#include <cstring>
+#include <mutex>
+#include <random>
+#include <thread>
+
+namespace oneflow {
+namespace test {
+
+namespace {
+
+// Stands in for a communicator with one thread per rank.
+class InProcessGroup final {
+ public:
+  explicit InProcessGroup(int64_t num_ranks)
+      : num_ranks_(num_ranks), buffers_(num_ranks), num_arrived_(0), generation_(0) {}
+
+  int64_t num_ranks() const { return num_ranks_; }
+
+  void SetBuffer(int64_t rank, const void* buffer) { buffers_.at(rank) = buffer; }
+  const void* GetBuffer(int64_t rank) const { return buffers_.at(rank); }
+
+  void Barrier() {
+    std::unique_lock<std::mutex> lock(mutex_);
+    const int64_t generation = generation_;
+    if (++num_arrived_ == num_ranks_) {
+      num_arrived_ = 0;
+      ++generation_;
+      cond_.notify_all();
+    } else {
+      cond_.wait(lock, [&]() { return generation_ != generation; });
+    }
+  }
+
+ private:
+  int64_t num_ranks_;
+  std::vector<const void*> buffers_;
+  std::mutex mutex_;
+  std::condition_variable cond_;
+  int64_t num_arrived_;
+  int64_t generation_;
+};
+
+template<typename T>
+void SumInRankOrder(const InProcessGroup& group, void* out, int64_t elem_cnt) {
+  T* sum = reinterpret_cast<T*>(out);
+  std::memcpy(sum, group.GetBuffer(0), elem_cnt * sizeof(T));
+  for (int64_t rank = 1; rank < group.num_ranks(); ++rank) {
+    const T* in = reinterpret_cast<const T*>(group.GetBuffer(rank));
+    for (int64_t i = 0; i < elem_cnt; ++i) { sum[i] = sum[i] + in[i]; }
+  }
+}
+
+class InProcessComm final : public GradientCompressionComm {
+ public:
+  InProcessComm(InProcessGroup* group, int64_t rank) : group_(group), rank_(rank), sent_bytes_(0) {}
+  ~InProcessComm() override = default;
+
+  int64_t num_ranks() const override { return group_->num_ranks(); }
+
+  void AllReduce(DataType data_type, const void* in, void* out, int64_t elem_cnt) override {
+    const size_t size = elem_cnt * GetSizeOfDataType(data_type);
+    std::vector<char> result(size);
+    group_->SetBuffer(rank_, in);
+    group_->Barrier();
+    switch (data_type) {
+      case DataType::kFloat: SumInRankOrder<float>(*group_, result.data(), elem_cnt); break;
+      case DataType::kFloat16: SumInRankOrder<float16>(*group_, result.data(), elem_cnt); break;
+      case DataType::kBFloat16: SumInRankOrder<bfloat16>(*group_, result.data(), elem_cnt); break;
+      default: UNIMPLEMENTED();
+    }
+    // `out` may alias `in`, so nobody writes before everybody has read.
+    group_->Barrier();
+    std::memcpy(out, result.data(), size);
+    sent_bytes_ += size;
+  }
+
+  void AllGather(DataType data_type, const void* in, void* out, int64_t elem_cnt) override {
+    const size_t size = elem_cnt * GetSizeOfDataType(data_type);
+    group_->SetBuffer(rank_, in);
+    group_->Barrier();
+    for (int64_t rank = 0; rank < num_ranks(); ++rank) {
+      std::memcpy(reinterpret_cast<char*>(out) + rank * size, group_->GetBuffer(rank), size);
+    }
+    group_->Barrier();
+    sent_bytes_ += size;
+  }
+
+  int64_t sent_bytes() const { return sent_bytes_; }
+
+ private:
+  InProcessGroup* group_;
+  int64_t rank_;
+  int64_t sent_bytes_;
+};
+
+struct SimulationResult {
+  // Per rank.
+  std::vector<std::vector<float>> first_out;
+  std::vector<std::vector<float>> out_sum;
+  std::vector<std::vector<float>> error;
+  std::vector<int64_t> sent_bytes;
+};
+
+// Every rank all-reduces the same gradient `grads[rank]` in each of `num_steps` steps.
+SimulationResult Simulate(const GradientCompressionArgs& args,
+                          const std::vector<std::vector<float>>& grads, int64_t num_steps) {
+  const int64_t num_ranks = grads.size();
+  InProcessGroup group(num_ranks);
+  SimulationResult result;
+  result.first_out.resize(num_ranks);
+  result.out_sum.resize(num_ranks, std::vector<float>(args.elem_cnt, 0.f));
+  result.error.resize(num_ranks, std::vector<float>(args.elem_cnt, 0.f));
+  result.sent_bytes.resize(num_ranks);
+  std::vector<std::thread> threads;
+  for (int64_t rank = 0; rank < num_ranks; ++rank) {
+    threads.emplace_back([&, rank]() {
+      InProcessComm comm(&group, rank);
+      std::vector<float> out(args.elem_cnt);
+      std::vector<float> q(args.power_sgd_cols * args.power_sgd_rank, 0.f);
+      std::vector<char> tmp(GetGradientCompressionTmpBufferSize(args, num_ranks));
+      for (int64_t step = 0; step < num_steps; ++step) {
+        GradientCompressedAllReduce(args, &comm, grads.at(rank).data(), out.data(),
+                                    result.error.at(rank).data(), q.data(), tmp.data());
+        if (step == 0) { result.first_out.at(rank) = out; }
+        for (int64_t i = 0; i < args.elem_cnt; ++i) { result.out_sum.at(rank).at(i) += out.at(i); }
+      }
+      result.sent_bytes.at(rank) = comm.sent_bytes();
+    });
+  }
+  for (auto& thread : threads) { thread.join(); }
+  return result;
+}
+
+std::vector<std::vector<float>> RandomGradients(int64_t num_ranks, int64_t elem_cnt) {
+  std::mt19937 generator(2023);
+  std::normal_distribution<float> distribution;
+  std::vector<std::vector<float>> grads(num_ranks, std::vector<float>(elem_cnt));
+  for (auto& grad : grads) {
+    for (float& x : grad) { x = distribution(generator); }
+  }
+  return grads;
+}
+
+double RelativeError(const std::vector<float>& actual, const std::vector<double>& expected) {
+  double diff = 0;
+  double norm = 0;
+  for (size_t i = 0; i < expected.size(); ++i) {
+    diff += (actual.at(i) - expected.at(i)) * (actual.at(i) - expected.at(i));
+    norm += expected.at(i) * expected.at(i);
+  }
+  return std::sqrt(diff / norm);
+}
+
+// `tolerance` bounds the error that feedback can not see, i.e. the rounding of the sum itself.
+void TestErrorFeedbackConverges(const GradientCompressionArgs& args, int64_t num_ranks,
+                                double tolerance) {
+  constexpr int64_t kNumSteps = 64;
+  const auto grads = RandomGradients(num_ranks, args.elem_cnt);
+  std::vector<double> exact(args.elem_cnt, 0);
+  for (const auto& grad : grads) {
+    for (int64_t i = 0; i < args.elem_cnt; ++i) { exact.at(i) += grad.at(i); }
+  }
+  const SimulationResult result = Simulate(args, grads, kNumSteps);
+  for (int64_t rank = 1; rank < num_ranks; ++rank) {
+    ASSERT_EQ(result.out_sum.at(rank), result.out_sum.at(0));
+  }
+  // Nothing is lost: what was not delivered yet is still held in the error buffers.
+  std::vector<float> delivered_and_pending = result.out_sum.at(0);
+  for (const auto& error : result.error) {
+    for (int64_t i = 0; i < args.elem_cnt; ++i) { delivered_and_pending.at(i) += error.at(i); }
+  }
+  std::vector<double> exact_total(exact);
+  for (double& x : exact_total) { x *= kNumSteps; }
+  ASSERT_LT(RelativeError(delivered_and_pending, exact_total), tolerance);
+  // So the average over steps approaches the exact sum much closer than a single step does.
+  std::vector<float> average = result.out_sum.at(0);
+  for (float& x : average) { x /= kNumSteps; }
+  ASSERT_LT(RelativeError(average, exact),
+            std::max(RelativeError(result.first_out.at(0), exact) / 4, tolerance));
+}
+
+GradientCompressionArgs MakeArgs(GradientCompressionMethod method, int64_t elem_cnt) {
+  GradientCompressionArgs args{};
+  args.method = method;
+  args.elem_cnt = elem_cnt;
+  args.top_k_ratio = 0.1;
+  return args;
+}
+
+}  // namespace
+
+TEST(GradientCompression, Fp16ErrorFeedbackConverges) {
+  TestErrorFeedbackConverges(MakeArgs(GradientCompressionMethod::kFp16, 1000), 4, 1e-3);
+}
+
+TEST(GradientCompression, Bf16ErrorFeedbackConverges) {
+  TestErrorFeedbackConverges(MakeArgs(GradientCompressionMethod::kBf16, 1000), 4, 8e-3);
+}
+
+TEST(GradientCompression, PowerSgdErrorFeedbackConverges) {
+  GradientCompressionArgs args = MakeArgs(GradientCompressionMethod::kPowerSgd, 32 * 24);
+  Shape factor_shape;
+  ASSERT_TRUE(GetPowerSgdFactorShape(Shape({32, 4, 6}), 4, &factor_shape));
+  ASSERT_EQ(factor_shape, Shape({24, 4}));
+  args.power_sgd_cols = factor_shape.At(0);
+  args.power_sgd_rank = factor_shape.At(1);
+  TestErrorFeedbackConverges(args, 3, 1e-4);
+}
+
+TEST(GradientCompression, TopKErrorFeedbackConverges) {
+  TestErrorFeedbackConverges(MakeArgs(GradientCompressionMethod::kTopK, 1000), 4, 1e-4);
+}
+
+TEST(GradientCompression, PowerSgdSkipsSmallMatrices) {
+  Shape factor_shape;
+  ASSERT_FALSE(GetPowerSgdFactorShape(Shape({1024}), 4, &factor_shape));
+  ASSERT_FALSE(GetPowerSgdFactorShape(Shape({4, 4}), 4, &factor_shape));
+  // 64 x 9 at rank 8 would send 584 floats instead of 576.
+  ASSERT_FALSE(GetPowerSgdFactorShape(Shape({64, 3, 3}), 8, &factor_shape));
+  ASSERT_TRUE(GetPowerSgdFactorShape(Shape({64, 4, 4}), 8, &factor_shape));
+  ASSERT_EQ(factor_shape, Shape({16, 8}));
+}
+
+TEST(GradientCompression, PayloadSize) {
+  constexpr int64_t kNumRanks = 4;
+  constexpr int64_t kRows = 256;
+  constexpr int64_t kCols = 128;
+  constexpr int64_t kElemCnt = kRows * kCols;
+  const int64_t uncompressed_bytes = kElemCnt * sizeof(float);
+  const auto grads = RandomGradients(kNumRanks, kElemCnt);
+
+  GradientCompressionArgs fp16 = MakeArgs(GradientCompressionMethod::kFp16, kElemCnt);
+  GradientCompressionArgs bf16 = MakeArgs(GradientCompressionMethod::kBf16, kElemCnt);
+  GradientCompressionArgs power_sgd = MakeArgs(GradientCompressionMethod::kPowerSgd, kElemCnt);
+  power_sgd.power_sgd_cols = kCols;
+  power_sgd.power_sgd_rank = 4;
+  GradientCompressionArgs top_k = MakeArgs(GradientCompressionMethod::kTopK, kElemCnt);
+  top_k.top_k_ratio = 0.01;
+
+  ASSERT_EQ(GetGradientCompressionPayloadSize(fp16) * 2, uncompressed_bytes);
+  ASSERT_EQ(GetGradientCompressionPayloadSize(bf16) * 2, uncompressed_bytes);
+  ASSERT_EQ(GetGradientCompressionPayloadSize(power_sgd), (kRows + kCols) * 4 * sizeof(float));
+  ASSERT_EQ(GetGradientCompressionPayloadSize(top_k),
+            static_cast<int64_t>(std::ceil(kElemCnt * 0.01)) * 8);
+  for (const auto& args : {fp16, bf16, power_sgd, top_k}) {
+    const SimulationResult result = Simulate(args, grads, 1);
+    for (int64_t sent_bytes : result.sent_bytes) {
+      ASSERT_EQ(sent_bytes, GetGradientCompressionPayloadSize(args));
+    }
+  }
+}
+
+}  // namespace test
+}  // namespace oneflow
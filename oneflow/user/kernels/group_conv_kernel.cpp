@@ -18,6 +18,7 @@ limitations under the License.
 #include "oneflow/core/kernel/kernel_util.h"
 #include "oneflow/core/ep/include/primitive/add.h"
 #include "oneflow/core/ep/include/primitive/matmul.h"
+#include "oneflow/user/kernels/conv_cpu_kernel_util.h"
 
 namespace oneflow {
 
@@ -36,62 +37,6 @@ std::unique_ptr<ep::primitive::Matmul> NewMatmulPrimitive(DeviceType device_type
                                                                    trans_b);
 }
 
-template<typename Context>
-std::unique_ptr<ep::primitive::Matmul> NewChannelsFirstMatmulPrimitive(Context* ctx) {
-  const DataType data_type = ctx->TensorDesc4ArgNameAndIndex("in", 0)->data_type();
-  return NewMatmulPrimitive(ctx->device_type(), data_type, /*transpose_a=*/false,
-                            /*transpose_b=*/false);
-}
-
-auto ChannelsFirstMatmulPrimitiveExists() {
-  return hob::make_custom("ChannelsFirstMatmulPrimitiveExists",
-                          [](const user_op::KernelRegContext& ctx) {
-                            return NewChannelsFirstMatmulPrimitive(&ctx).operator bool();
-                          });
-}
-
-template<typename Context>
-std::unique_ptr<ep::primitive::Matmul> NewChannelsLastMatmulPrimitive(Context* ctx) {
-  const DataType data_type = ctx->TensorDesc4ArgNameAndIndex("in", 0)->data_type();
-  return NewMatmulPrimitive(ctx->device_type(), data_type, /*transpose_a=*/true,
-                            /*transpose_b=*/true);
-}
-
-auto ChannelsLastMatmulPrimitiveExists() {
-  return hob::make_custom("ChannelsLastMatmulPrimitiveExists",
-                          [](const user_op::KernelRegContext& ctx) {
-                            return NewChannelsLastMatmulPrimitive(&ctx).operator bool();
-                          });
-}
-
-template<typename Context>
-std::unique_ptr<ep::primitive::Matmul> NewConvDataGradTransATransBMatmulPrimitive(Context* ctx) {
-  const DataType data_type = ctx->TensorDesc4ArgNameAndIndex("dy", 0)->data_type();
-  return NewMatmulPrimitive(ctx->device_type(), data_type, /*transpose_a=*/true,
-                            /*transpose_b=*/true);
-}
-
-auto ConvDataGradTransATransBMatmulPrimitiveExists() {
-  return hob::make_custom("ConvDataGradTransATransBMatmulPrimitiveExists",
-                          [](const user_op::KernelRegContext& ctx) {
-                            return NewConvDataGradTransATransBMatmulPrimitive(&ctx).operator bool();
-                          });
-}
-
-template<typename Context>
-std::unique_ptr<ep::primitive::Matmul> NewConvDataGradTransANoTransBMatmulPrimitive(Context* ctx) {
-  const DataType data_type = ctx->TensorDesc4ArgNameAndIndex("dy", 0)->data_type();
-  return NewMatmulPrimitive(ctx->device_type(), data_type, /*transpose_a=*/true,
-                            /*transpose_b=*/false);
-}
-
-auto ConvDataGradTransANoTransBMatmulPrimitiveExists() {
-  return hob::make_custom(
-      "ConvDataGradTransANoTransBMatmulPrimitiveExists", [](const user_op::KernelRegContext& ctx) {
-        return NewConvDataGradTransANoTransBMatmulPrimitive(&ctx).operator bool();
-      });
-}
-
 template<typename Context>
 std::unique_ptr<ep::primitive::Matmul> NewConvWeightGradTransATransBMatmulPrimitive(Context* ctx) {
   const DataType data_type = ctx->TensorDesc4ArgNameAndIndex("dy", 0)->data_type();
@@ -128,17 +73,6 @@ using Im2ColFunc = void (*)(const T* in_dptr, const ShapeView& in_shape,
                             const int32_t* strides, const int32_t* dilation_rate,
                             const int32_t* padding_before, T* col_buf);
 
-template<typename T>
-using Col2ImFunc = void (*)(const T* col_buf, const ShapeView& in_shape,
-                            const ShapeView& weight_shape, const ShapeView& out_shape,
-                            const int32_t* strides, const int32_t* dilation_rate,
-                            const int32_t* padding_before, T* in_diff_ptr);
-
-template<typename T>
-T* GetImgMutDptr(user_op::Tensor* tensor, int64_t idx) {
-  return tensor->mut_dptr<T>() + tensor->shape_view().Count(1) * idx;
-}
-
 template<typename T>
 const T* GetImgDptr(const user_op::Tensor* tensor, int64_t idx) {
   return tensor->dptr<T>() + tensor->shape_view().Count(1) * idx;
@@ -215,27 +149,6 @@ class Im2ColWriter final : public ColBufWriter<T> {
   void NextImCSize() override { this->src_ptr_ += this->c_size_; }
 };
 
-template<typename T>
-class Col2ImWriter final : public ColBufWriter<T> {
- public:
-  Col2ImWriter(const T* src_ptr, T* dst_ptr, int64_t c_size, int64_t id_size, int64_t ih_size,
-               int64_t iw_size, int64_t od_size, int64_t oh_size, int64_t ow_size)
-      : ColBufWriter<T>::ColBufWriter(src_ptr, dst_ptr, c_size, id_size, ih_size, iw_size, od_size,
-                                      oh_size, ow_size) {}
-  ~Col2ImWriter() = default;
-  void DHWCWrite(int64_t c, int64_t id, int64_t ih, int64_t iw) override {
-    this->dst_ptr_[id * this->id_size_ + ih * this->ih_size_ + iw * this->iw_size_ + c] +=
-        *(this->src_ptr_++);
-  }
-  void CDHWWrite(int64_t c, int64_t id, int64_t ih, int64_t iw) override {
-    this->dst_ptr_[id * this->id_size_ + ih * this->ih_size_ + iw] += *(this->src_ptr_++);
-  }
-  void InvalidDFunc() override { this->src_ptr_ += this->od_size_; }
-  void InvalidHFunc() override { this->src_ptr_ += this->oh_size_; }
-  void InvalidWFunc() override { this->src_ptr_ += this->ow_size_; }
-  void NextImCSize() override { this->dst_ptr_ += this->c_size_; }
-};
-
 template<typename T>
 using DHWValidFunc = void (ColBufWriter<T>::*)(int64_t c, int64_t kd, int64_t kh, int64_t kw);
 
@@ -330,31 +243,6 @@ struct ConvKernelUtil final {
     DoNDWHCFunc(weight_shape, col_buf_util, &col_buf_writer);
   }
 
-  static void NCDHWCol2Im(const T* col_buf_ptr, const ShapeView& in_shape,
-                          const ShapeView& weight_shape, const ShapeView& out_shape,
-                          const int32_t* strides, const int32_t* dilation_rate,
-                          const int32_t* padding_before, T* in_diff_ptr) {
-    ColBufUtil<T> col_buf_util(in_shape, out_shape, 2, strides, dilation_rate, padding_before,
-                               in_shape.At(2), in_shape.At(3), in_shape.At(4), out_shape.At(2),
-                               out_shape.At(3), out_shape.At(4));
-    Col2ImWriter<T> col_buf_writer(col_buf_ptr, in_diff_ptr, in_shape.Count(2), in_shape.Count(3),
-                                   in_shape.Count(4), 1, out_shape.Count(3), out_shape.Count(4), 1);
-    DoNCDWHFunc(weight_shape, col_buf_util, &col_buf_writer);
-  }
-
-  static void NDHWCCol2Im(const T* col_buf_ptr, const ShapeView& in_shape,
-                          const ShapeView& weight_shape, const ShapeView& out_shape,
-                          const int32_t* strides, const int32_t* dilation_rate,
-                          const int32_t* padding_before, T* in_diff_ptr) {
-    ColBufUtil<T> col_buf_util(in_shape, out_shape, 1, strides, dilation_rate, padding_before,
-                               in_shape.At(1), in_shape.At(2), in_shape.At(3), out_shape.At(1),
-                               out_shape.At(2), out_shape.At(3));
-    Col2ImWriter<T> col_buf_writer(col_buf_ptr, in_diff_ptr, in_shape.Count(2), in_shape.Count(2),
-                                   in_shape.Count(3), in_shape.Count(4), out_shape.Count(2, 4),
-                                   out_shape.Count(3, 4), 1);
-    DoNDWHCFunc(weight_shape, col_buf_util, &col_buf_writer);
-  }
-
  private:
   static void DoNCDWHFunc(const ShapeView& weight_shape, ColBufUtil<T>& col_buf_util,
                           ColBufWriter<T>* col_buf_writer) {
@@ -386,7 +274,6 @@ struct ConvKernelUtil final {
 template<typename T>
 struct ConvOpKernelCache final : public user_op::OpKernelCache {
   Im2ColFunc<T> im2col_func_ = ConvKernelUtil<T>::NCDHWIm2Col;
-  Col2ImFunc<T> col2im_func_ = ConvKernelUtil<T>::NCDHWCol2Im;
 
   Shape in_5d_shape_;
   Shape out_5d_shape_;
@@ -412,12 +299,10 @@ std::shared_ptr<ConvOpKernelCache<T>> CreateConvOpKernelCache(user_op::KernelCac
   std::shared_ptr<ConvOpKernelCache<T>> state(new ConvOpKernelCache<T>());
   if (data_format == "channels_first") {
     state->im2col_func_ = ConvKernelUtil<T>::NCDHWIm2Col;
-    state->col2im_func_ = ConvKernelUtil<T>::NCDHWCol2Im;
     state->is_out_diff_need_trans_ = false;
     state->idx_offset_ = 2;
   } else {
     state->im2col_func_ = ConvKernelUtil<T>::NDHWCIm2Col;
-    state->col2im_func_ = ConvKernelUtil<T>::NDHWCCol2Im;
     state->is_out_diff_need_trans_ = true;
     state->idx_offset_ = 1;
   }
@@ -457,10 +342,6 @@ std::shared_ptr<ConvOpKernelCache<T>> CreateConvOpKernelCache(user_op::KernelCac
   return state;
 }
 
-template<typename T>
-void InitBiasMulBuf(T* dptr, int64_t num) {
-  for (int64_t i = 0; i < num; ++i) { dptr[i] = 1; }
-}
 template<typename T, size_t NDims>
 class ConvCpuKernel final : public user_op::OpKernel {
  public:
@@ -482,77 +363,31 @@ class ConvCpuKernel final : public user_op::OpKernel {
 
     const user_op::Tensor* in = ctx->Tensor4ArgNameAndIndex("in", 0);
     const user_op::Tensor* weight = ctx->Tensor4ArgNameAndIndex("weight", 0);
-    user_op::Tensor* tmp_buffer = ctx->Tensor4ArgNameAndIndex("tmp_buffer", 0);
+    const user_op::Tensor* bias = ctx->Tensor4ArgNameAndIndex("bias", 0);
     user_op::Tensor* out = ctx->Tensor4ArgNameAndIndex("out", 0);
 
-    T* col_buf_dptr = tmp_buffer->mut_dptr<T>();
-    int32_t idx_offset = conv_cache->idx_offset_;
-    const int32_t input_group_interval = in->shape_view().At(1) / conv_cache->groups;
-    const int32_t weight_group_interval = weight->shape_view().At(0) / conv_cache->groups;
-    const int32_t output_group_interval = out->shape_view().At(1) / conv_cache->groups;
-    const int32_t input_step = input_group_interval * in->shape_view().Count(2);
-    const int32_t weight_step = weight_group_interval * weight->shape_view().Count(1);
-    const int32_t output_step = output_group_interval * out->shape_view().Count(2);
-    const int32_t m = conv_cache->weight_5d_shape_.At(0) / conv_cache->groups;
-    const int32_t n = conv_cache->out_5d_shape_.Count(idx_offset, idx_offset + 3);
-    const int32_t k = conv_cache->weight_5d_shape_.Count(1);
-    bool is_bias_mul_inited = false;
-
-    const auto& data_format = ctx->Attr<std::string>("data_format");
-    std::unique_ptr<ep::primitive::Matmul> matmul;
-    if (data_format == "channels_first") {
-      matmul = NewChannelsFirstMatmulPrimitive(ctx);
-    } else {
-      matmul = NewChannelsLastMatmulPrimitive(ctx);
+    bool accumulate = false;
+    if (ctx->has_input("_add_to_output", 0)) {
+      const user_op::Tensor* add_to_output = ctx->Tensor4ArgNameAndIndex("_add_to_output", 0);
+      CHECK_EQ(add_to_output->data_type(), out->data_type());
+      CHECK_EQ(add_to_output->shape_view(), out->shape_view());
+      Memcpy<DeviceType::kCPU>(
+          ctx->stream(), out->mut_dptr(), add_to_output->dptr(),
+          add_to_output->shape_view().elem_cnt() * GetSizeOfDataType(add_to_output->data_type()));
+      accumulate = true;
     }
-    CHECK(matmul);
 
-    for (int64_t i = 0; i < in->shape_view().At(0); ++i) {
-      const T* input_ptr = GetImgDptr<T>(in, i);
-      const T* weight_ptr = weight->dptr<T>();
-      T* output_ptr = GetImgMutDptr<T>(out, i);
-      for (int64_t g = 0; g < conv_cache->groups; g++) {
-        conv_cache->im2col_func_(
-            input_ptr, ShapeView(conv_cache->in_5d_shape_), ShapeView(conv_cache->weight_5d_shape_),
-            ShapeView(conv_cache->out_5d_shape_), conv_cache->strides_3d_.data(),
-            conv_cache->dilation_rate_3d_.data(), conv_cache->padding_before_3d_.data(),
-            col_buf_dptr);
-
-        // channels first: out = weight * col_buf
-        // channels last:  out = (weight * col_buf)(T)
-        matmul->Launch(ctx->stream(),
-                       m,  // filter / groups
-                       n,  // od * oh * ow
-                       k,  // ci * kd * kh * kw / groups
-                       static_cast<T>(1), weight_ptr, col_buf_dptr, static_cast<T>(0), output_ptr);
-        input_ptr += input_step;
-        weight_ptr += weight_step;
-        output_ptr += output_step;
-      }
-
-      const user_op::Tensor* bias = ctx->Tensor4ArgNameAndIndex("bias", 0);
-      if (bias != nullptr) {
-        int64_t num_of_col_buf =
-            CalcElemNumOfColBuf(out->shape_view(), weight->shape_view(), idx_offset);
-        int64_t num_of_bias_mul =
-            (tmp_buffer->shape_view().elem_cnt() - num_of_col_buf * sizeof(T)) / sizeof(T);
-        CHECK_GT(num_of_bias_mul, 0);
-        T* bias_mul_dptr = col_buf_dptr + num_of_col_buf;
-        if (!is_bias_mul_inited) {
-          InitBiasMulBuf(bias_mul_dptr, num_of_bias_mul);
-          is_bias_mul_inited = true;
-        }
-
-        // channels first:  out += bias * bias_mul
-        // channels last:   out += (bias * bias_mul)(T)
-        matmul->Launch(ctx->stream(),
-                       conv_cache->weight_5d_shape_.At(0),                           // filter
-                       conv_cache->out_5d_shape_.Count(idx_offset, idx_offset + 3),  // od * oh * ow
-                       1,                                                            // 1
-                       static_cast<T>(1), bias->dptr<T>(), bias_mul_dptr, static_cast<T>(1),
-                       GetImgMutDptr<T>(out, i));
-      }
-    }
+    const ConvCpuProblem problem = MakeConvCpuProblem(
+        conv_cache->idx_offset_ == 1, conv_cache->groups, ShapeView(conv_cache->in_5d_shape_),
+        ShapeView(conv_cache->weight_5d_shape_), ShapeView(conv_cache->out_5d_shape_),
+        conv_cache->strides_3d_.data(), conv_cache->dilation_rate_3d_.data(),
+        conv_cache->padding_before_3d_.data());
+    auto* stream = ctx->stream()->As<ep::CpuStream>();
+    const ConvCpuConfig config =
+        ConvCpuTuner::Get().FindForwardConfig<T>(stream, problem, in->dptr<T>(), weight->dptr<T>());
+    ConvCpuKernelUtil<T>::Forward(stream, problem, config, in->dptr<T>(), weight->dptr<T>(),
+                                  bias == nullptr ? nullptr : bias->dptr<T>(), accumulate,
+                                  out->mut_dptr<T>());
   }
 };
 
@@ -561,25 +396,15 @@ class ConvCpuKernel final : public user_op::OpKernel {
       .SetCreateFn<ConvCpuKernel<dtype, ndims>>()                                           \
       .SetIsMatchedHob((user_op::HobDeviceType() == DeviceType::kCPU)                       \
                        && (user_op::HobAttr<int32_t>("groups") > 1)                         \
-                       && (user_op::HobDataType("in", 0) == GetDataType<dtype>::value)      \
-                       && ChannelsFirstMatmulPrimitiveExists()                              \
-                       && ChannelsLastMatmulPrimitiveExists())                              \
-      .SetInferTmpSizeFn([](user_op::InferContext* ctx) -> size_t {                         \
-        size_t tmp_buffer_size = 0;                                                         \
-        const auto& out_shape = ctx->OutputTensorDesc("out", 0).shape();                    \
-        const auto& weight_shape = ctx->InputTensorDesc("weight", 0).shape();               \
-                                                                                            \
-        int64_t idx_offset = IdxOffset(ctx->Attr<std::string>("data_format"));              \
-        tmp_buffer_size +=                                                                  \
-            CalcElemNumOfColBuf(out_shape, weight_shape, idx_offset) * sizeof(dtype);       \
-        bool has_bias = ctx->has_input("bias", 0);                                          \
-        if (has_bias) {                                                                     \
-          int64_t bias_mul_cnt = 1;                                                         \
-          for (int i = 0; i < ndims; ++i) { bias_mul_cnt *= out_shape.At(idx_offset + i); } \
-          tmp_buffer_size += bias_mul_cnt * sizeof(dtype);                                  \
-        }                                                                                   \
-        return tmp_buffer_size;                                                             \
-      })
+                       && (user_op::HobDataType("in", 0) == GetDataType<dtype>::value))     \
+      .SetInplaceProposalFn(                                                                \
+          [](const user_op::InferContext& ctx,                                              \
+             const user_op::AddInplaceArgPair& AddInplaceArgPairFn) -> Maybe<void> {        \
+            if (ctx.has_input("_add_to_output", 0)) {                                       \
+              OF_RETURN_IF_ERROR(AddInplaceArgPairFn("out", 0, "_add_to_output", 0, true)); \
+            }                                                                               \
+            return Maybe<void>::Ok();                                                       \
+          });
 
 REGISTER_CONV_KERNEL(conv1d, float, 1);
 REGISTER_CONV_KERNEL(conv2d, float, 2);
@@ -611,55 +436,14 @@ class ConvDataGradCpuKernel final : public user_op::OpKernel {
     const user_op::Tensor* dy = ctx->Tensor4ArgNameAndIndex("dy", 0);
     const user_op::Tensor* filter = ctx->Tensor4ArgNameAndIndex("filter", 0);
     user_op::Tensor* dx = ctx->Tensor4ArgNameAndIndex("dx", 0);
-    user_op::Tensor* col_buf = ctx->Tensor4ArgNameAndIndex("tmp_buffer", 0);
 
-    int32_t idx_offset = conv_cache->idx_offset_;
-    const int32_t dy_group_interval = dy->shape_view().At(1) / conv_cache->groups;
-    const int32_t filter_group_interval = filter->shape_view().At(0) / conv_cache->groups;
-    const int32_t dx_group_interval = dx->shape_view().At(1) / conv_cache->groups;
-    const int32_t dx_step = dx_group_interval * dx->shape_view().Count(2);
-    const int32_t filter_step = filter_group_interval * filter->shape_view().Count(1);
-    const int32_t dy_step = dy_group_interval * dy->shape_view().Count(2);
-    const int32_t m = conv_cache->weight_5d_shape_.Count(1);
-    const int32_t n = conv_cache->out_5d_shape_.Count(idx_offset, idx_offset + 3);
-    const int32_t k = conv_cache->weight_5d_shape_.At(0) / conv_cache->groups;
-
-    Memset<DeviceType::kCPU>(ctx->stream(), dx->mut_dptr<T>(), 0,
-                             dx->shape_view().elem_cnt() * sizeof(T));
-
-    std::unique_ptr<ep::primitive::Matmul> matmul;
-    if (conv_cache->is_out_diff_need_trans_) {
-      matmul = NewConvDataGradTransATransBMatmulPrimitive(ctx);
-    } else {
-      matmul = NewConvDataGradTransANoTransBMatmulPrimitive(ctx);
-    }
-    CHECK(matmul);
-
-    FOR_RANGE(int64_t, i, 0, dy->shape_view().At(0)) {
-      const T* filter_ptr = filter->dptr<T>();
-      const T* dy_ptr = GetImgDptr<T>(dy, i);
-      T* dx_ptr = GetImgMutDptr<T>(dx, i);
-      FOR_RANGE(int64_t, g, 0, conv_cache->groups) {
-        // channels first:  col_buf' = weight(T) * out[i]'
-        // channels last :  col_buf' = weight(T) * out[i]'(T)
-        matmul->Launch(ctx->stream(),
-                       m,  //  ci * kd * kh * kw / groups
-                       n,  //  od * oh * ow
-                       k,  //  filter / groups
-                       static_cast<T>(1), filter_ptr, dy_ptr, static_cast<T>(0),
-                       col_buf->mut_dptr<T>());
-
-        // in' = col2im(col_buf')
-        conv_cache->col2im_func_(
-            col_buf->dptr<T>(), ShapeView(conv_cache->in_5d_shape_),
-            ShapeView(conv_cache->weight_5d_shape_), ShapeView(conv_cache->out_5d_shape_),
-            conv_cache->strides_3d_.data(), conv_cache->dilation_rate_3d_.data(),
-            conv_cache->padding_before_3d_.data(), dx_ptr);
-        filter_ptr += filter_step;
-        dy_ptr += dy_step;
-        dx_ptr += dx_step;
-      }
-    }
+    const ConvCpuProblem problem = MakeConvCpuProblem(
+        conv_cache->idx_offset_ == 1, conv_cache->groups, ShapeView(conv_cache->in_5d_shape_),
+        ShapeView(conv_cache->weight_5d_shape_), ShapeView(conv_cache->out_5d_shape_),
+        conv_cache->strides_3d_.data(), conv_cache->dilation_rate_3d_.data(),
+        conv_cache->padding_before_3d_.data());
+    ConvCpuKernelUtil<T>::BackwardData(ctx->stream()->As<ep::CpuStream>(), problem,
+                                       dy->dptr<T>(), filter->dptr<T>(), dx->mut_dptr<T>());
     if (ctx->has_input("_add_to_output", 0)) {
       const user_op::Tensor* add_to_output = ctx->Tensor4ArgNameAndIndex("_add_to_output", 0);
       CHECK_EQ(add_to_output->data_type(), dx->data_type());
@@ -674,24 +458,12 @@ class ConvDataGradCpuKernel final : public user_op::OpKernel {
   }
 };
 
-#define REGISTER_CONV_DATA_GRAD_KERNEL(op_name, dtype)                                     \
-  REGISTER_USER_KERNEL(#op_name)                                                           \
-      .SetCreateFn<ConvDataGradCpuKernel<dtype>>()                                         \
-      .SetIsMatchedHob((user_op::HobDeviceType() == DeviceType::kCPU)                      \
-                       && (user_op::HobAttr<int32_t>("groups") > 1)                        \
-                       && (user_op::HobDataType("dy", 0) == GetDataType<dtype>::value)     \
-                       && ConvDataGradTransATransBMatmulPrimitiveExists()                  \
-                       && ConvDataGradTransANoTransBMatmulPrimitiveExists())               \
-      .SetInferTmpSizeFn([](user_op::InferContext* ctx) -> size_t {                        \
-        size_t tmp_buffer_size = 0;                                                        \
-        const auto& out_diff_shape = ctx->InputTensorDesc("dy", 0).shape();                \
-        const auto& weight_shape = ctx->InputTensorDesc("filter", 0).shape();              \
-                                                                                           \
-        int64_t idx_offset = IdxOffset(ctx->Attr<std::string>("data_format"));             \
-        tmp_buffer_size +=                                                                 \
-            CalcElemNumOfColBuf(out_diff_shape, weight_shape, idx_offset) * sizeof(dtype); \
-        return tmp_buffer_size;                                                            \
-      })
+#define REGISTER_CONV_DATA_GRAD_KERNEL(op_name, dtype)                                  \
+  REGISTER_USER_KERNEL(#op_name)                                                        \
+      .SetCreateFn<ConvDataGradCpuKernel<dtype>>()                                      \
+      .SetIsMatchedHob((user_op::HobDeviceType() == DeviceType::kCPU)                   \
+                       && (user_op::HobAttr<int32_t>("groups") > 1)                     \
+                       && (user_op::HobDataType("dy", 0) == GetDataType<dtype>::value))
 
 REGISTER_CONV_DATA_GRAD_KERNEL(conv_data_grad, float);
 REGISTER_CONV_DATA_GRAD_KERNEL(conv_data_grad, double);
@@ -0,0 +1,353 @@
+/*
+Copyright 2020 The OneFlow Authors. All rights reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+#include "oneflow/core/framework/framework.h"
+#include "oneflow/core/ep/cpu/cpu_stream.h"
+#include "oneflow/core/ep/include/primitive/matmul.h"
+
+namespace oneflow {
+
+namespace {
+
+// Number of elements handed to one task of ParallelFor.
+constexpr int64_t kParallelGrainElemCnt = 32768;
+// Weight rows widened together, every element of x loaded feeds this many dot products.
+constexpr int64_t kPanelRows = 4;
+// Independent partial sums of a dot product, keeps the k loop vectorizable.
+constexpr int64_t kLanes = 8;
+// From this many rows of x on, the weight is dequantized once and multiplied by the blas matmul.
+// Below it the weight stays quantized in memory and is widened panel by panel in cache.
+constexpr int64_t kBlasMinRows = 16;
+
+template<typename U, int num_bits>
+int32_t QuantizedValue(const U* in, int64_t offset) {
+  if (num_bits == 8) { return in[offset]; }
+  // Two values per byte, the high nibble comes first.
+  const U q = in[offset >> 1];
+  if (offset & 1) {
+    if (std::is_same<U, int8_t>::value) { return static_cast<int8_t>(q << 4) >> 4; }
+    return q & 0xF;
+  }
+  return q >> 4;
+}
+
+template<typename T, typename U, int num_bits, bool symmetric>
+T Zero(T scale, const T* zero, int64_t offset) {
+  if (!symmetric) { return zero[offset]; }
+  // Unsigned symmetric values are stored with an offset of half the range.
+  if (std::is_same<U, uint8_t>::value) {
+    return -static_cast<T>((1 << (num_bits - 1)) - 1) * scale;
+  }
+  return 0;
+}
+
+// Dequantizes the elements [begin, end) of the (outer_size, group_size, inner_size) view of the
+// quantized tensor into out[0, end - begin). scale and zero are (outer_size, inner_size).
+template<typename T, typename U, int num_bits, bool symmetric>
+void DequantizeRange(int64_t begin, int64_t end, int64_t group_size, int64_t inner_size,
+                     const U* in, const T* scale, const T* zero, T* out) {
+  const int64_t group_inner_size = group_size * inner_size;
+  int64_t offset = begin;
+  while (offset < end) {
+    if (inner_size == 1) {
+      // One scale per group, constant over a run of group_size elements.
+      const int64_t outer_idx = offset / group_size;
+      const int64_t run_end = std::min(end, (outer_idx + 1) * group_size);
+      const T s = scale[outer_idx];
+      const T z = Zero<T, U, num_bits, symmetric>(s, zero, outer_idx);
+      for (int64_t i = offset; i < run_end; ++i) {
+        out[i - begin] = static_cast<T>(QuantizedValue<U, num_bits>(in, i)) * s + z;
+      }
+      offset = run_end;
+    } else {
+      const int64_t outer_idx = offset / group_inner_size;
+      const int64_t inner_idx = offset % inner_size;
+      const int64_t run_end = std::min(end, offset + inner_size - inner_idx);
+      const int64_t scale_offset = outer_idx * inner_size + inner_idx - offset;
+      for (int64_t i = offset; i < run_end; ++i) {
+        const T s = scale[scale_offset + i];
+        const T z = Zero<T, U, num_bits, symmetric>(s, zero, scale_offset + i);
+        out[i - begin] = static_cast<T>(QuantizedValue<U, num_bits>(in, i)) * s + z;
+      }
+      offset = run_end;
+    }
+  }
+}
+
+template<typename T, typename U, int num_bits, bool symmetric>
+void Dequantize(ep::CpuStream* stream, int64_t outer_size, int64_t group_size, int64_t inner_size,
+                const U* in, const T* scale, const T* zero, T* out) {
+  stream->ParallelFor(
+      0, outer_size * group_size * inner_size,
+      [&](int64_t begin, int64_t end) {
+        DequantizeRange<T, U, num_bits, symmetric>(begin, end, group_size, inner_size, in, scale,
+                                                   zero, out + begin);
+      },
+      kParallelGrainElemCnt);
+}
+
+// out = x * dequantize(w)^T + bias, w is (n, k) quantized with groups along group_dim.
+template<typename T, typename U, int num_bits, bool symmetric>
+void QuantizedLinear(ep::CpuStream* stream, int64_t m, int64_t n, int64_t k, int64_t group_dim,
+                     int64_t group_size, const T* x, const U* w, const T* scale, const T* zero,
+                     const T* bias, T* tmp, T* out) {
+  // Row r of w is the elements [r * k, (r + 1) * k) of the dequantize view below.
+  const int64_t outer_size = group_dim == 0 ? n / group_size : n * (k / group_size);
+  const int64_t inner_size = group_dim == 0 ? k : 1;
+  if (m >= kBlasMinRows) {
+    Dequantize<T, U, num_bits, symmetric>(stream, outer_size, group_size, inner_size, w, scale,
+                                          zero, tmp);
+    if (bias != nullptr) {
+      stream->ParallelFor(
+          0, m,
+          [&](int64_t begin, int64_t end) {
+            for (int64_t i = begin; i < end; ++i) { std::copy(bias, bias + n, out + i * n); }
+          },
+          std::max<int64_t>(kParallelGrainElemCnt / n, 1));
+    }
+    auto matmul = ep::primitive::NewPrimitive<ep::primitive::MatmulFactory>(
+        DeviceType::kCPU, GetDataType<T>::value, ep::primitive::BlasTransposeType::N,
+        ep::primitive::BlasTransposeType::T);
+    CHECK(matmul);
+    matmul->Launch(stream, m, n, k, 1.0, x, tmp, bias != nullptr ? 1.0 : 0.0, out);
+    return;
+  }
+  const int64_t num_panels = (n + kPanelRows - 1) / kPanelRows;
+  stream->ParallelFor(
+      0, num_panels,
+      [&](int64_t begin, int64_t end) {
+        std::vector<T> panel(kPanelRows * k, 0);
+        for (int64_t p = begin; p < end; ++p) {
+          const int64_t row_begin = p * kPanelRows;
+          const int64_t num_rows = std::min(kPanelRows, n - row_begin);
+          DequantizeRange<T, U, num_bits, symmetric>(row_begin * k, (row_begin + num_rows) * k,
+                                                     group_size, inner_size, w, scale, zero,
+                                                     panel.data());
+          for (int64_t i = 0; i < m; ++i) {
+            const T* x_row = x + i * k;
+            T sum[kPanelRows][kLanes] = {};
+            int64_t col = 0;
+            for (; col + kLanes <= k; col += kLanes) {
+              for (int64_t r = 0; r < kPanelRows; ++r) {
+                const T* panel_row = panel.data() + r * k + col;
+                for (int64_t l = 0; l < kLanes; ++l) { sum[r][l] += x_row[col + l] * panel_row[l]; }
+              }
+            }
+            for (; col < k; ++col) {
+              for (int64_t r = 0; r < kPanelRows; ++r) {
+                sum[r][0] += x_row[col] * panel[r * k + col];
+              }
+            }
+            for (int64_t r = 0; r < num_rows; ++r) {
+              T y = bias != nullptr ? bias[row_begin + r] : 0;
+              for (int64_t l = 0; l < kLanes; ++l) { y += sum[r][l]; }
+              out[i * n + row_begin + r] = y;
+            }
+          }
+        }
+      },
+      std::max<int64_t>(kParallelGrainElemCnt / (kPanelRows * m * k), 1));
+}
+
+template<typename T, typename U>
+void DispatchDequantize(ep::CpuStream* stream, int num_bits, bool symmetric, int64_t outer_size,
+                        int64_t group_size, int64_t inner_size, const U* in, const T* scale,
+                        const T* zero, T* out) {
+  if (num_bits == 4) {
+    if (symmetric) {
+      Dequantize<T, U, 4, true>(stream, outer_size, group_size, inner_size, in, scale, zero, out);
+    } else {
+      Dequantize<T, U, 4, false>(stream, outer_size, group_size, inner_size, in, scale, zero, out);
+    }
+  } else if (num_bits == 8) {
+    if (symmetric) {
+      Dequantize<T, U, 8, true>(stream, outer_size, group_size, inner_size, in, scale, zero, out);
+    } else {
+      Dequantize<T, U, 8, false>(stream, outer_size, group_size, inner_size, in, scale, zero, out);
+    }
+  } else {
+    UNIMPLEMENTED();
+  }
+}
+
+template<typename T, typename U>
+void DispatchQuantizedLinear(ep::CpuStream* stream, int num_bits, bool symmetric, int64_t m,
+                             int64_t n, int64_t k, int64_t group_dim, int64_t group_size,
+                             const T* x, const U* w, const T* scale, const T* zero, const T* bias,
+                             T* tmp, T* out) {
+  if (num_bits == 4) {
+    if (symmetric) {
+      QuantizedLinear<T, U, 4, true>(stream, m, n, k, group_dim, group_size, x, w, scale, zero,
+                                     bias, tmp, out);
+    } else {
+      QuantizedLinear<T, U, 4, false>(stream, m, n, k, group_dim, group_size, x, w, scale, zero,
+                                      bias, tmp, out);
+    }
+  } else if (num_bits == 8) {
+    if (symmetric) {
+      QuantizedLinear<T, U, 8, true>(stream, m, n, k, group_dim, group_size, x, w, scale, zero,
+                                     bias, tmp, out);
+    } else {
+      QuantizedLinear<T, U, 8, false>(stream, m, n, k, group_dim, group_size, x, w, scale, zero,
+                                      bias, tmp, out);
+    }
+  } else {
+    UNIMPLEMENTED();
+  }
+}
+
+template<typename T>
+class GroupwiseDequantizeKernel final : public user_op::OpKernel {
+ public:
+  GroupwiseDequantizeKernel() = default;
+  ~GroupwiseDequantizeKernel() override = default;
+
+ private:
+  using user_op::OpKernel::Compute;
+  void Compute(user_op::KernelComputeContext* ctx) const override {
+    const user_op::Tensor* in = ctx->Tensor4ArgNameAndIndex("in", 0);
+    const user_op::Tensor* scale = ctx->Tensor4ArgNameAndIndex("scale", 0);
+    const user_op::Tensor* zero = nullptr;
+    if (ctx->has_input("zero", 0)) { zero = ctx->Tensor4ArgNameAndIndex("zero", 0); }
+    user_op::Tensor* out = ctx->Tensor4ArgNameAndIndex("out", 0);
+    const int64_t group_size = ctx->Attr<int64_t>("group_size");
+    const int64_t group_dim = ctx->Attr<int64_t>("group_dim");
+    const int32_t num_bits = ctx->Attr<int32_t>("num_bits");
+    const bool symmetric = ctx->Attr<bool>("symmetric");
+    const int64_t num_in_axes = in->shape_view().NumAxes();
+    CHECK_GE(num_in_axes, 1);
+    CHECK_GE(group_dim, 0);
+    CHECK_LT(group_dim, num_in_axes);
+    const int64_t group_dim_size = out->shape_view().At(group_dim);
+    CHECK_GT(group_size, 0);
+    CHECK_EQ(group_dim_size % group_size, 0);
+    const int64_t num_groups = group_dim_size / group_size;
+    const int64_t outer_size = out->shape_view().Count(0, group_dim) * num_groups;
+    const int64_t inner_size = out->shape_view().Count(group_dim + 1);
+    if (symmetric) {
+      CHECK(zero == nullptr);
+    } else {
+      CHECK(zero != nullptr);
+    }
+    auto* stream = ctx->stream()->As<ep::CpuStream>();
+    if (in->data_type() == DataType::kUInt8) {
+      DispatchDequantize<T, uint8_t>(stream, num_bits, symmetric, outer_size, group_size,
+                                     inner_size, in->dptr<uint8_t>(), scale->dptr<T>(),
+                                     zero == nullptr ? nullptr : zero->dptr<T>(),
+                                     out->mut_dptr<T>());
+    } else if (in->data_type() == DataType::kInt8) {
+      DispatchDequantize<T, int8_t>(stream, num_bits, symmetric, outer_size, group_size,
+                                    inner_size, in->dptr<int8_t>(), scale->dptr<T>(),
+                                    zero == nullptr ? nullptr : zero->dptr<T>(),
+                                    out->mut_dptr<T>());
+    } else {
+      UNIMPLEMENTED();
+    }
+  }
+
+  bool AlwaysComputeWhenAllOutputsEmpty() const override { return false; }
+};
+
+#define REGISTER_GROUPWISE_DEQUANTIZE_KERNEL_CPU(dtype)               \
+  REGISTER_USER_KERNEL("groupwise_dequantize")                        \
+      .SetCreateFn<GroupwiseDequantizeKernel<dtype>>()                \
+      .SetIsMatchedHob((user_op::HobDeviceType() == DeviceType::kCPU) \
+                       && (user_op::HobDataType("scale", 0) == GetDataType<dtype>::value))
+
+REGISTER_GROUPWISE_DEQUANTIZE_KERNEL_CPU(float);
+REGISTER_GROUPWISE_DEQUANTIZE_KERNEL_CPU(double);
+
+template<typename T>
+class FusedLinearWithGroupwiseQuantizedWeightKernel final : public user_op::OpKernel {
+ public:
+  FusedLinearWithGroupwiseQuantizedWeightKernel() = default;
+  ~FusedLinearWithGroupwiseQuantizedWeightKernel() override = default;
+
+ private:
+  using user_op::OpKernel::Compute;
+  void Compute(user_op::KernelComputeContext* ctx, user_op::OpKernelState*,
+               const user_op::OpKernelCache* cache) const override {
+    const user_op::Tensor* x = ctx->Tensor4ArgNameAndIndex("x", 0);
+    const user_op::Tensor* w = ctx->Tensor4ArgNameAndIndex("w", 0);
+    const user_op::Tensor* w_scale = ctx->Tensor4ArgNameAndIndex("w_scale", 0);
+    const user_op::Tensor* b =
+        (ctx->has_input("b", 0)) ? ctx->Tensor4ArgNameAndIndex("b", 0) : nullptr;
+    const user_op::Tensor* w_zero =
+        (ctx->has_input("w_zero", 0)) ? ctx->Tensor4ArgNameAndIndex("w_zero", 0) : nullptr;
+    user_op::Tensor* out = ctx->Tensor4ArgNameAndIndex("out", 0);
+    const int64_t group_size = ctx->Attr<int64_t>("group_size");
+    const int64_t group_dim = ctx->Attr<int64_t>("group_dim");
+    CHECK(group_dim == 0 || group_dim == 1);
+    const int32_t num_bits = ctx->Attr<int32_t>("num_bits");
+    const bool symmetric = ctx->Attr<bool>("symmetric");
+    const int64_t k = x->shape_view().At(x->shape_view().NumAxes() - 1);
+    const int64_t m = x->shape_view().elem_cnt() / k;
+    const int64_t n = w->shape_view().At(0);
+    const int64_t group_dim_size = group_dim == 0 ? n : k;
+    CHECK_GT(group_size, 0);
+    CHECK_EQ(group_dim_size % group_size, 0);
+    if (symmetric) {
+      CHECK(w_zero == nullptr);
+    } else {
+      CHECK(w_zero != nullptr);
+    }
+    T* tmp = nullptr;
+    if (m >= kBlasMinRows) {
+      user_op::Tensor* tmp_buffer = ctx->Tensor4ArgNameAndIndex("tmp_buffer", 0);
+      CHECK_GE(tmp_buffer->shape_view().elem_cnt(), n * k * sizeof(T));
+      tmp = tmp_buffer->mut_dptr<T>();
+    }
+    auto* stream = ctx->stream()->As<ep::CpuStream>();
+    const DataType quant_type = w->data_type();
+    if (quant_type == DataType::kUInt8) {
+      DispatchQuantizedLinear<T, uint8_t>(
+          stream, num_bits, symmetric, m, n, k, group_dim, group_size, x->dptr<T>(),
+          w->dptr<uint8_t>(), w_scale->dptr<T>(), w_zero == nullptr ? nullptr : w_zero->dptr<T>(),
+          b == nullptr ? nullptr : b->dptr<T>(), tmp, out->mut_dptr<T>());
+    } else if (quant_type == DataType::kInt8) {
+      DispatchQuantizedLinear<T, int8_t>(
+          stream, num_bits, symmetric, m, n, k, group_dim, group_size, x->dptr<T>(),
+          w->dptr<int8_t>(), w_scale->dptr<T>(), w_zero == nullptr ? nullptr : w_zero->dptr<T>(),
+          b == nullptr ? nullptr : b->dptr<T>(), tmp, out->mut_dptr<T>());
+    } else {
+      UNIMPLEMENTED();
+    }
+  }
+
+  bool AlwaysComputeWhenAllOutputsEmpty() const override { return false; }
+};
+
+template<typename T>
+size_t InferFusedLinearTmpSize(user_op::InferContext* ctx) {
+  const Shape& x_shape = ctx->InputShape("x", 0);
+  const int64_t k = x_shape.At(x_shape.NumAxes() - 1);
+  const int64_t m = k == 0 ? 0 : x_shape.elem_cnt() / k;
+  if (m < kBlasMinRows) { return 0; }
+  return ctx->InputShape("w", 0).At(0) * k * sizeof(T);
+}
+
+#define REGISTER_FUSED_MATMUL_BIAS_KERNEL_CPU(data_type, cpp_type)            \
+  REGISTER_USER_KERNEL("fused_linear_with_groupwise_quantized_weight")        \
+      .SetCreateFn<FusedLinearWithGroupwiseQuantizedWeightKernel<cpp_type>>() \
+      .SetIsMatchedHob((user_op::HobDeviceType() == DeviceType::kCPU)         \
+                       && (user_op::HobDataType("out", 0) == data_type))      \
+      .SetInferTmpSizeFn(InferFusedLinearTmpSize<cpp_type>);
+
+REGISTER_FUSED_MATMUL_BIAS_KERNEL_CPU(DataType::kFloat, float);
+REGISTER_FUSED_MATMUL_BIAS_KERNEL_CPU(DataType::kDouble, double);
+
+}  // namespace
+
+}  // namespace oneflow
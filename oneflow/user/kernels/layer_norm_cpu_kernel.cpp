@@ -14,9 +14,259 @@ See the License for the specific language governing permissions and
 limitations under the License.
 */
 #include "oneflow/core/framework/framework.h"
+#include "oneflow/core/ep/cpu/cpu_stream.h"
+#include "oneflow/core/ep/cpu/cpu_device.h"
+#include "oneflow/user/kernels/row_reduce_cpu_kernel_util.h"
 
 namespace oneflow {
 
+namespace {
+
+using row_reduce::GetRowGrainSize;
+using row_reduce::kLanes;
+
+template<typename T>
+using LayerNormComputeType = row_reduce::ComputeType<T>;
+
+// One pass Welford over a row, each lane accumulates every kLanes-th element and the lanes are
+// merged with the parallel variance update of Chan et al. Returns the biased variance.
+template<typename T, typename ComputeType>
+void WelfordRowMeanAndVariance(const T* x, int64_t cols, ComputeType* mean,
+                               ComputeType* variance) {
+  ComputeType lane_mean[kLanes] = {0};
+  ComputeType lane_m2[kLanes] = {0};
+  const int64_t packed_cols = cols / kLanes * kLanes;
+  ComputeType lane_count = 0;
+  for (int64_t col = 0; col < packed_cols; col += kLanes) {
+    lane_count += 1;
+    const ComputeType inv_count = static_cast<ComputeType>(1) / lane_count;
+    for (int32_t i = 0; i < kLanes; ++i) {
+      const ComputeType val = static_cast<ComputeType>(x[col + i]);
+      const ComputeType delta = val - lane_mean[i];
+      lane_mean[i] += delta * inv_count;
+      lane_m2[i] += delta * (val - lane_mean[i]);
+    }
+  }
+  ComputeType row_mean = 0;
+  ComputeType row_m2 = 0;
+  ComputeType row_count = 0;
+  if (lane_count > 0) {
+    row_mean = lane_mean[0];
+    row_m2 = lane_m2[0];
+    row_count = lane_count;
+    for (int32_t i = 1; i < kLanes; ++i) {
+      const ComputeType new_count = row_count + lane_count;
+      const ComputeType delta = lane_mean[i] - row_mean;
+      row_mean += delta * lane_count / new_count;
+      row_m2 += lane_m2[i] + delta * delta * row_count * lane_count / new_count;
+      row_count = new_count;
+    }
+  }
+  for (int64_t col = packed_cols; col < cols; ++col) {
+    const ComputeType val = static_cast<ComputeType>(x[col]);
+    row_count += 1;
+    const ComputeType delta = val - row_mean;
+    row_mean += delta / row_count;
+    row_m2 += delta * (val - row_mean);
+  }
+  *mean = row_mean;
+  *variance = cols > 0 ? row_m2 / static_cast<ComputeType>(cols) : static_cast<ComputeType>(0);
+}
+
+template<typename T, typename ComputeType, bool do_scale, bool do_center>
+void LayerNormForwardRow(const T* x, const T* gamma, const T* beta, int64_t cols,
+                         ComputeType epsilon, T* y, ComputeType* mean, ComputeType* inv_variance) {
+  ComputeType row_mean = 0;
+  ComputeType row_variance = 0;
+  WelfordRowMeanAndVariance<T, ComputeType>(x, cols, &row_mean, &row_variance);
+  const ComputeType row_inv_variance =
+      static_cast<ComputeType>(1) / std::sqrt(row_variance + epsilon);
+  for (int64_t col = 0; col < cols; ++col) {
+    ComputeType normalized = (static_cast<ComputeType>(x[col]) - row_mean) * row_inv_variance;
+    if (do_scale) { normalized *= static_cast<ComputeType>(gamma[col]); }
+    if (do_center) { normalized += static_cast<ComputeType>(beta[col]); }
+    y[col] = static_cast<T>(normalized);
+  }
+  *mean = row_mean;
+  *inv_variance = row_inv_variance;
+}
+
+template<typename T, typename ComputeType, bool do_scale, bool do_center>
+void LayerNormForwardCpu(ep::CpuStream* stream, int64_t num_instances, int64_t norm_size,
+                         double epsilon, const T* x, const T* gamma, const T* beta, T* y,
+                         ComputeType* mean, ComputeType* inv_variance) {
+  const ComputeType eps = static_cast<ComputeType>(epsilon);
+  stream->ParallelFor(
+      0, num_instances,
+      [&](int64_t begin, int64_t end) {
+        for (int64_t row = begin; row < end; ++row) {
+          const int64_t offset = row * norm_size;
+          LayerNormForwardRow<T, ComputeType, do_scale, do_center>(
+              x + offset, gamma, beta, norm_size, eps, y + offset, mean + row, inv_variance + row);
+        }
+      },
+      GetRowGrainSize(norm_size));
+}
+
+template<typename T>
+void DispatchLayerNormForwardCpu(ep::CpuStream* stream, int64_t num_instances, int64_t norm_size,
+                                 double epsilon, const T* x, const T* gamma, const T* beta, T* y,
+                                 typename LayerNormComputeType<T>::type* mean,
+                                 typename LayerNormComputeType<T>::type* inv_variance) {
+  using ComputeType = typename LayerNormComputeType<T>::type;
+  if (gamma != nullptr && beta != nullptr) {
+    LayerNormForwardCpu<T, ComputeType, true, true>(stream, num_instances, norm_size, epsilon, x,
+                                                    gamma, beta, y, mean, inv_variance);
+  } else if (gamma != nullptr && beta == nullptr) {
+    LayerNormForwardCpu<T, ComputeType, true, false>(stream, num_instances, norm_size, epsilon, x,
+                                                     gamma, beta, y, mean, inv_variance);
+  } else if (gamma == nullptr && beta != nullptr) {
+    LayerNormForwardCpu<T, ComputeType, false, true>(stream, num_instances, norm_size, epsilon, x,
+                                                     gamma, beta, y, mean, inv_variance);
+  } else {
+    LayerNormForwardCpu<T, ComputeType, false, false>(stream, num_instances, norm_size, epsilon,
+                                                      x, gamma, beta, y, mean, inv_variance);
+  }
+}
+
+// dx = inv_variance * (dy * gamma - mean(dy * gamma) - x_hat * mean(dy * gamma * x_hat))
+template<typename T, typename ComputeType, bool do_scale, bool do_add>
+void LayerNormBackwardRow(const T* dy, const T* x, const T* gamma, const T* add_to_output,
+                          int64_t cols, ComputeType mean, ComputeType inv_variance, T* dx) {
+  ComputeType lane_sum_dy[kLanes] = {0};
+  ComputeType lane_sum_dy_x_hat[kLanes] = {0};
+  const int64_t packed_cols = cols / kLanes * kLanes;
+  for (int64_t col = 0; col < packed_cols; col += kLanes) {
+    for (int32_t i = 0; i < kLanes; ++i) {
+      ComputeType scaled_dy = static_cast<ComputeType>(dy[col + i]);
+      if (do_scale) { scaled_dy *= static_cast<ComputeType>(gamma[col + i]); }
+      const ComputeType x_hat = (static_cast<ComputeType>(x[col + i]) - mean) * inv_variance;
+      lane_sum_dy[i] += scaled_dy;
+      lane_sum_dy_x_hat[i] += scaled_dy * x_hat;
+    }
+  }
+  ComputeType sum_dy = 0;
+  ComputeType sum_dy_x_hat = 0;
+  for (int32_t i = 0; i < kLanes; ++i) {
+    sum_dy += lane_sum_dy[i];
+    sum_dy_x_hat += lane_sum_dy_x_hat[i];
+  }
+  for (int64_t col = packed_cols; col < cols; ++col) {
+    ComputeType scaled_dy = static_cast<ComputeType>(dy[col]);
+    if (do_scale) { scaled_dy *= static_cast<ComputeType>(gamma[col]); }
+    sum_dy += scaled_dy;
+    sum_dy_x_hat += scaled_dy * (static_cast<ComputeType>(x[col]) - mean) * inv_variance;
+  }
+  const ComputeType inv_cols = static_cast<ComputeType>(1) / static_cast<ComputeType>(cols);
+  const ComputeType mean_dy = sum_dy * inv_cols;
+  const ComputeType mean_dy_x_hat = sum_dy_x_hat * inv_cols;
+  for (int64_t col = 0; col < cols; ++col) {
+    ComputeType scaled_dy = static_cast<ComputeType>(dy[col]);
+    if (do_scale) { scaled_dy *= static_cast<ComputeType>(gamma[col]); }
+    const ComputeType x_hat = (static_cast<ComputeType>(x[col]) - mean) * inv_variance;
+    ComputeType dx_val = (scaled_dy - mean_dy - x_hat * mean_dy_x_hat) * inv_variance;
+    if (do_add) { dx_val += static_cast<ComputeType>(add_to_output[col]); }
+    dx[col] = static_cast<T>(dx_val);
+  }
+}
+
+template<typename T, typename ComputeType, bool do_scale, bool do_add>
+void LayerNormBackwardCpu(ep::CpuStream* stream, int64_t num_instances, int64_t norm_size,
+                          const T* dy, const T* x, const ComputeType* mean,
+                          const ComputeType* inv_variance, const T* gamma, const T* add_to_output,
+                          T* dx) {
+  stream->ParallelFor(
+      0, num_instances,
+      [&](int64_t begin, int64_t end) {
+        for (int64_t row = begin; row < end; ++row) {
+          const int64_t offset = row * norm_size;
+          LayerNormBackwardRow<T, ComputeType, do_scale, do_add>(
+              dy + offset, x + offset, gamma, do_add ? add_to_output + offset : nullptr,
+              norm_size, mean[row], inv_variance[row], dx + offset);
+        }
+      },
+      GetRowGrainSize(norm_size));
+}
+
+template<typename T>
+void DispatchLayerNormBackwardCpu(ep::CpuStream* stream, int64_t num_instances, int64_t norm_size,
+                                  const T* dy, const T* x,
+                                  const typename LayerNormComputeType<T>::type* mean,
+                                  const typename LayerNormComputeType<T>::type* inv_variance,
+                                  const T* gamma, const T* add_to_output, T* dx) {
+  using ComputeType = typename LayerNormComputeType<T>::type;
+  if (gamma != nullptr && add_to_output != nullptr) {
+    LayerNormBackwardCpu<T, ComputeType, true, true>(stream, num_instances, norm_size, dy, x, mean,
+                                                     inv_variance, gamma, add_to_output, dx);
+  } else if (gamma != nullptr && add_to_output == nullptr) {
+    LayerNormBackwardCpu<T, ComputeType, true, false>(stream, num_instances, norm_size, dy, x, mean,
+                                                      inv_variance, gamma, add_to_output, dx);
+  } else if (gamma == nullptr && add_to_output != nullptr) {
+    LayerNormBackwardCpu<T, ComputeType, false, true>(stream, num_instances, norm_size, dy, x, mean,
+                                                      inv_variance, gamma, add_to_output, dx);
+  } else {
+    LayerNormBackwardCpu<T, ComputeType, false, false>(stream, num_instances, norm_size, dy, x,
+                                                       mean, inv_variance, gamma, add_to_output,
+                                                       dx);
+  }
+}
+
+// Each task reduces dgamma and dbeta over a contiguous range of rows into its own partial buffer,
+// the partials are summed afterwards in parallel over columns.
+template<typename T>
+void LayerNormParamBackwardCpu(ep::CpuStream* stream, int64_t num_instances, int64_t norm_size,
+                               const T* dy, const T* x,
+                               const typename LayerNormComputeType<T>::type* mean,
+                               const typename LayerNormComputeType<T>::type* inv_variance,
+                               T* gamma_diff, T* beta_diff) {
+  using ComputeType = typename LayerNormComputeType<T>::type;
+  const int64_t num_tasks = std::max<int64_t>(
+      1, std::min<int64_t>(num_instances, stream->device()->GetNumThreads()));
+  std::vector<ComputeType> partial_gamma_diff(num_tasks * norm_size, 0);
+  std::vector<ComputeType> partial_beta_diff(num_tasks * norm_size, 0);
+  stream->ParallelFor(
+      0, num_tasks,
+      [&](int64_t begin, int64_t end) {
+        for (int64_t task = begin; task < end; ++task) {
+          ComputeType* task_gamma_diff = partial_gamma_diff.data() + task * norm_size;
+          ComputeType* task_beta_diff = partial_beta_diff.data() + task * norm_size;
+          const int64_t row_begin = num_instances * task / num_tasks;
+          const int64_t row_end = num_instances * (task + 1) / num_tasks;
+          for (int64_t row = row_begin; row < row_end; ++row) {
+            const T* row_dy = dy + row * norm_size;
+            const T* row_x = x + row * norm_size;
+            const ComputeType row_mean = mean[row];
+            const ComputeType row_inv_variance = inv_variance[row];
+            for (int64_t col = 0; col < norm_size; ++col) {
+              const ComputeType dy_val = static_cast<ComputeType>(row_dy[col]);
+              const ComputeType x_hat =
+                  (static_cast<ComputeType>(row_x[col]) - row_mean) * row_inv_variance;
+              task_gamma_diff[col] += dy_val * x_hat;
+              task_beta_diff[col] += dy_val;
+            }
+          }
+        }
+      },
+      1);
+  stream->ParallelFor(
+      0, norm_size,
+      [&](int64_t begin, int64_t end) {
+        for (int64_t col = begin; col < end; ++col) {
+          ComputeType sum_gamma_diff = 0;
+          ComputeType sum_beta_diff = 0;
+          for (int64_t task = 0; task < num_tasks; ++task) {
+            sum_gamma_diff += partial_gamma_diff[task * norm_size + col];
+            sum_beta_diff += partial_beta_diff[task * norm_size + col];
+          }
+          if (gamma_diff != nullptr) { gamma_diff[col] = static_cast<T>(sum_gamma_diff); }
+          if (beta_diff != nullptr) { beta_diff[col] = static_cast<T>(sum_beta_diff); }
+        }
+      },
+      GetRowGrainSize(num_tasks));
+}
+
+}  // namespace
+
 template<typename T>
 class LayerNormCpuKernel final : public user_op::OpKernel {
  public:
@@ -24,8 +274,31 @@ class LayerNormCpuKernel final : public user_op::OpKernel {
   ~LayerNormCpuKernel() = default;
 
  private:
+  using user_op::OpKernel::Compute;
   bool AlwaysComputeWhenAllOutputsEmpty() const override { return false; }
-  void Compute(user_op::KernelComputeContext* ctx) const override { TODO(); };
+  void Compute(user_op::KernelComputeContext* ctx) const override {
+    using ComputeType = typename LayerNormComputeType<T>::type;
+    const user_op::Tensor* x = ctx->Tensor4ArgNameAndIndex("x", 0);
+    user_op::Tensor* y = ctx->Tensor4ArgNameAndIndex("y", 0);
+    user_op::Tensor* mean = ctx->Tensor4ArgNameAndIndex("mean", 0);
+    user_op::Tensor* inv_variance = ctx->Tensor4ArgNameAndIndex("inv_variance", 0);
+    const double epsilon = ctx->Attr<double>("epsilon");
+    const int64_t num_instances = mean->shape_view().elem_cnt();
+    if (num_instances == 0) { return; }
+    const int64_t norm_size = x->shape_view().elem_cnt() / num_instances;
+    const T* gamma_ptr = nullptr;
+    const T* beta_ptr = nullptr;
+    if (ctx->has_input("gamma", 0)) {
+      const user_op::Tensor* gamma = ctx->Tensor4ArgNameAndIndex("gamma", 0);
+      gamma_ptr = gamma->dptr<T>();
+      CHECK_EQ(gamma->shape_view().elem_cnt(), norm_size);
+    }
+    if (ctx->has_input("beta", 0)) { beta_ptr = ctx->Tensor4ArgNameAndIndex("beta", 0)->dptr<T>(); }
+    DispatchLayerNormForwardCpu<T>(ctx->stream()->As<ep::CpuStream>(), num_instances, norm_size,
+                                   epsilon, x->dptr<T>(), gamma_ptr, beta_ptr, y->mut_dptr<T>(),
+                                   mean->mut_dptr<ComputeType>(),
+                                   inv_variance->mut_dptr<ComputeType>());
+  };
 };
 
 #define REGISTER_LAYER_NORM_CPU_KERNEL(dtype)                         \
@@ -36,6 +309,7 @@ class LayerNormCpuKernel final : public user_op::OpKernel {
 
 REGISTER_LAYER_NORM_CPU_KERNEL(float)
 REGISTER_LAYER_NORM_CPU_KERNEL(double)
+REGISTER_LAYER_NORM_CPU_KERNEL(bfloat16)
 
 template<typename T>
 class LayerNormGradCpuKernel final : public user_op::OpKernel {
@@ -44,18 +318,53 @@ class LayerNormGradCpuKernel final : public user_op::OpKernel {
   ~LayerNormGradCpuKernel() = default;
 
  private:
+  using user_op::OpKernel::Compute;
   bool AlwaysComputeWhenAllOutputsEmpty() const override { return false; }
-  void Compute(user_op::KernelComputeContext* ctx) const override { TODO(); };
+  void Compute(user_op::KernelComputeContext* ctx) const override {
+    using ComputeType = typename LayerNormComputeType<T>::type;
+    const user_op::Tensor* dy = ctx->Tensor4ArgNameAndIndex("dy", 0);
+    const user_op::Tensor* x = ctx->Tensor4ArgNameAndIndex("x", 0);
+    const user_op::Tensor* mean = ctx->Tensor4ArgNameAndIndex("mean", 0);
+    const user_op::Tensor* inv_variance = ctx->Tensor4ArgNameAndIndex("inv_variance", 0);
+    user_op::Tensor* dx = ctx->Tensor4ArgNameAndIndex("dx", 0);
+    const int64_t num_instances = mean->shape_view().elem_cnt();
+    if (num_instances == 0) { return; }
+    const int64_t norm_size = x->shape_view().elem_cnt() / num_instances;
+    const T* gamma_ptr = nullptr;
+    if (ctx->has_input("gamma", 0)) {
+      gamma_ptr = ctx->Tensor4ArgNameAndIndex("gamma", 0)->dptr<T>();
+    }
+    const T* add_to_output_ptr = nullptr;
+    if (ctx->has_input("_add_to_output", 0)) {
+      const user_op::Tensor* add_to_output = ctx->Tensor4ArgNameAndIndex("_add_to_output", 0);
+      CHECK_EQ(add_to_output->data_type(), dx->data_type());
+      CHECK_EQ(add_to_output->shape_view(), dx->shape_view());
+      add_to_output_ptr = add_to_output->dptr<T>();
+    }
+    DispatchLayerNormBackwardCpu<T>(ctx->stream()->As<ep::CpuStream>(), num_instances, norm_size,
+                                    dy->dptr<T>(), x->dptr<T>(), mean->dptr<ComputeType>(),
+                                    inv_variance->dptr<ComputeType>(), gamma_ptr,
+                                    add_to_output_ptr, dx->mut_dptr<T>());
+  };
 };
 
-#define REGISTER_LAYER_NORM_GRAD_CPU_KERNEL(dtype)                    \
-  REGISTER_USER_KERNEL("layer_norm_grad")                             \
-      .SetCreateFn<LayerNormGradCpuKernel<dtype>>()                   \
-      .SetIsMatchedHob((user_op::HobDeviceType() == DeviceType::kCPU) \
-                       && (user_op::HobDataType("dy", 0) == GetDataType<dtype>::value));
+#define REGISTER_LAYER_NORM_GRAD_CPU_KERNEL(dtype)                                         \
+  REGISTER_USER_KERNEL("layer_norm_grad")                                                  \
+      .SetCreateFn<LayerNormGradCpuKernel<dtype>>()                                        \
+      .SetIsMatchedHob((user_op::HobDeviceType() == DeviceType::kCPU)                      \
+                       && (user_op::HobDataType("dy", 0) == GetDataType<dtype>::value))    \
+      .SetInplaceProposalFn(                                                               \
+          [](const user_op::InferContext& ctx,                                             \
+             const user_op::AddInplaceArgPair& AddInplaceArgPairFn) -> Maybe<void> {       \
+            if (ctx.has_input("_add_to_output", 0)) {                                      \
+              OF_RETURN_IF_ERROR(AddInplaceArgPairFn("dx", 0, "_add_to_output", 0, true)); \
+            }                                                                              \
+            return Maybe<void>::Ok();                                                      \
+          });
 
 REGISTER_LAYER_NORM_GRAD_CPU_KERNEL(float)
 REGISTER_LAYER_NORM_GRAD_CPU_KERNEL(double)
+REGISTER_LAYER_NORM_GRAD_CPU_KERNEL(bfloat16)
 
 template<typename T>
 class LayerNormParamGradCpuKernel final : public user_op::OpKernel {
@@ -64,8 +373,28 @@ class LayerNormParamGradCpuKernel final : public user_op::OpKernel {
   ~LayerNormParamGradCpuKernel() = default;
 
  private:
+  using user_op::OpKernel::Compute;
   bool AlwaysComputeWhenAllOutputsEmpty() const override { return false; }
-  void Compute(user_op::KernelComputeContext* ctx) const override { TODO(); };
+  void Compute(user_op::KernelComputeContext* ctx) const override {
+    using ComputeType = typename LayerNormComputeType<T>::type;
+    const user_op::Tensor* dy = ctx->Tensor4ArgNameAndIndex("dy", 0);
+    const user_op::Tensor* x = ctx->Tensor4ArgNameAndIndex("x", 0);
+    const user_op::Tensor* mean = ctx->Tensor4ArgNameAndIndex("mean", 0);
+    const user_op::Tensor* inv_variance = ctx->Tensor4ArgNameAndIndex("inv_variance", 0);
+    const int64_t num_instances = mean->shape_view().elem_cnt();
+    const int64_t norm_size = dy->shape_view().Count(ctx->Attr<int64_t>("begin_params_axis"));
+    T* gamma_diff_ptr = nullptr;
+    T* beta_diff_ptr = nullptr;
+    if (ctx->has_output("gamma_diff", 0)) {
+      gamma_diff_ptr = ctx->Tensor4ArgNameAndIndex("gamma_diff", 0)->mut_dptr<T>();
+    }
+    if (ctx->has_output("beta_diff", 0)) {
+      beta_diff_ptr = ctx->Tensor4ArgNameAndIndex("beta_diff", 0)->mut_dptr<T>();
+    }
+    LayerNormParamBackwardCpu<T>(ctx->stream()->As<ep::CpuStream>(), num_instances, norm_size,
+                                 dy->dptr<T>(), x->dptr<T>(), mean->dptr<ComputeType>(),
+                                 inv_variance->dptr<ComputeType>(), gamma_diff_ptr, beta_diff_ptr);
+  };
 };
 
 #define REGISTER_LAYER_NORM_PARAM_GRAD_CPU_KERNEL(dtype)              \
@@ -76,5 +405,6 @@ class LayerNormParamGradCpuKernel final : public user_op::OpKernel {
 
 REGISTER_LAYER_NORM_PARAM_GRAD_CPU_KERNEL(float)
 REGISTER_LAYER_NORM_PARAM_GRAD_CPU_KERNEL(double)
+REGISTER_LAYER_NORM_PARAM_GRAD_CPU_KERNEL(bfloat16)
 
 }  // namespace oneflow
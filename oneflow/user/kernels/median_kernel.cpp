@@ -14,7 +14,7 @@ See the License for the specific language governing permissions and
 limitations under the License.
 */
 #include "oneflow/core/framework/framework.h"
-#include "oneflow/core/kernel/kernel_util.h"
+#include "oneflow/user/kernels/sort_cpu_kernel_util.h"
 
 namespace oneflow {
 
@@ -28,28 +28,19 @@ class CpuMedianKernel final : public user_op::OpKernel {
   void Compute(user_op::KernelComputeContext* ctx) const override {
     const user_op::Tensor* in = ctx->Tensor4ArgNameAndIndex("input", 0);
     const int64_t size = in->shape_view().elem_cnt();
+    if (size == 0) { return; }
     user_op::Tensor* out = ctx->Tensor4ArgNameAndIndex("output", 0);
-    user_op::Tensor* tmp_buffer = ctx->Tensor4ArgNameAndIndex("tmp_buffer", 0);
-    T* out_ptr = out->mut_dptr<T>();
-    Memcpy<DeviceType::kCPU>(ctx->stream(), tmp_buffer->mut_dptr<void>(), in->dptr<void>(),
-                             size * sizeof(T));
-    T* first = tmp_buffer->mut_dptr<T>();
-    T* last = first + size;
-    T* median = first + (size - 1) / 2;
-    std::nth_element(first, median, last);
-    *out_ptr = *median;
+    SortCpuKernelUtil<T>::Median(ctx->stream()->As<ep::CpuStream>(), in->dptr<T>(), 1, size,
+                                 out->mut_dptr<T>(), nullptr);
   }
   bool AlwaysComputeWhenAllOutputsEmpty() const override { return false; }
 };
 
-#define REGISTER_CPU_MEDIAN_KERNEL(dtype)                                                  \
-  REGISTER_USER_KERNEL("median")                                                           \
-      .SetCreateFn<CpuMedianKernel<dtype>>()                                               \
-      .SetIsMatchedHob((user_op::HobDeviceType() == DeviceType::kCPU)                      \
-                       && (user_op::HobDataType("input", 0) == GetDataType<dtype>::value)) \
-      .SetInferTmpSizeFn([](user_op::InferContext* ctx) -> size_t {                        \
-        return ctx->InputShape("input", 0).elem_cnt() * sizeof(dtype);                     \
-      });
+#define REGISTER_CPU_MEDIAN_KERNEL(dtype)                             \
+  REGISTER_USER_KERNEL("median")                                      \
+      .SetCreateFn<CpuMedianKernel<dtype>>()                          \
+      .SetIsMatchedHob((user_op::HobDeviceType() == DeviceType::kCPU) \
+                       && (user_op::HobDataType("input", 0) == GetDataType<dtype>::value));
 
 REGISTER_CPU_MEDIAN_KERNEL(float)
 REGISTER_CPU_MEDIAN_KERNEL(double)
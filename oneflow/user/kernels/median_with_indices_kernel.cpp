@@ -14,8 +14,7 @@ See the License for the specific language governing permissions and
 limitations under the License.
 */
 #include "oneflow/core/framework/framework.h"
-#include "oneflow/core/kernel/kernel_util.h"
-#include "oneflow/core/thread/thread_manager.h"
+#include "oneflow/user/kernels/sort_cpu_kernel_util.h"
 
 namespace oneflow {
 
@@ -35,48 +34,17 @@ class CpuMedianWithIndicesKernel final : public user_op::OpKernel {
     const int64_t instance_num = size / stride;
     user_op::Tensor* values = ctx->Tensor4ArgNameAndIndex("values", 0);
     user_op::Tensor* indices = ctx->Tensor4ArgNameAndIndex("indices", 0);
-    user_op::Tensor* tmp_buffer = ctx->Tensor4ArgNameAndIndex("tmp_buffer", 0);
-    Memcpy<DeviceType::kCPU>(ctx->stream(), tmp_buffer->mut_dptr<void>(), in->dptr<void>(),
-                             size * sizeof(T));
-    const int64_t thread_num =
-        std::min(instance_num, (int64_t)Singleton<ThreadPool>::Get()->thread_num());
-    const BalancedSplitter bs(instance_num, thread_num);
-    BlockingCounter bc(thread_num);
-    FOR_RANGE(int64_t, thread_id, 0, thread_num) {
-      const Range range = bs.At(thread_id);
-      Singleton<ThreadPool>::Get()->AddWork([=, &bc]() {
-        FOR_RANGE(int64_t, i, range.begin(), range.end()) {
-          T* in_ptr = tmp_buffer->mut_dptr<T>() + i * stride;
-          T* val_ptr = values->mut_dptr<T>() + i;
-          int64_t* ind_ptr = indices->mut_dptr<int64_t>() + i;
-          std::vector<int64_t> idx(stride);
-          auto first = idx.begin();
-          auto last = idx.end();
-          std::iota(first, last, 0);
-          auto nth = first;
-          nth += (stride - 1) / 2;
-          std::nth_element(first, nth, last, [&in_ptr](int64_t i, int64_t j) {
-            return in_ptr[i] < in_ptr[j] || (in_ptr[i] == in_ptr[j] && i < j);
-          });
-          *val_ptr = in_ptr[*nth];
-          *ind_ptr = *nth;
-        }
-        bc.Decrease();
-      });
-    }
-    bc.WaitForeverUntilCntEqualZero();
+    SortCpuKernelUtil<T>::Median(ctx->stream()->As<ep::CpuStream>(), in->dptr<T>(), instance_num,
+                                 stride, values->mut_dptr<T>(), indices->mut_dptr<int64_t>());
   }
   bool AlwaysComputeWhenAllOutputsEmpty() const override { return false; }
 };
 
-#define REGISTER_CPU_MEDIAN_WITH_INDICES_KERNEL(dtype)                                     \
-  REGISTER_USER_KERNEL("median_with_indices")                                              \
-      .SetCreateFn<CpuMedianWithIndicesKernel<dtype>>()                                    \
-      .SetIsMatchedHob((user_op::HobDeviceType() == DeviceType::kCPU)                      \
-                       && (user_op::HobDataType("input", 0) == GetDataType<dtype>::value)) \
-      .SetInferTmpSizeFn([](user_op::InferContext* ctx) -> size_t {                        \
-        return ctx->InputShape("input", 0).elem_cnt() * sizeof(dtype);                     \
-      });
+#define REGISTER_CPU_MEDIAN_WITH_INDICES_KERNEL(dtype)                \
+  REGISTER_USER_KERNEL("median_with_indices")                         \
+      .SetCreateFn<CpuMedianWithIndicesKernel<dtype>>()               \
+      .SetIsMatchedHob((user_op::HobDeviceType() == DeviceType::kCPU) \
+                       && (user_op::HobDataType("input", 0) == GetDataType<dtype>::value));
 
 REGISTER_CPU_MEDIAN_WITH_INDICES_KERNEL(float)
 REGISTER_CPU_MEDIAN_WITH_INDICES_KERNEL(double)
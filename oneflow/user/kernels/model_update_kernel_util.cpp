@@ -69,6 +69,7 @@ void SGDUpdateKernelUtil<DeviceType::kCPU, T, G, C>::Update(
 }
 
 template struct SGDUpdateKernelUtil<DeviceType::kCPU, float, float, float16>;
+template struct SGDUpdateKernelUtil<DeviceType::kCPU, float, float, bfloat16>;
 template struct SGDUpdateKernelUtil<DeviceType::kCPU, double, double, float16>;
 
 template<typename T, typename K, typename IDX>
@@ -216,6 +217,7 @@ void AdamUpdateKernelUtil<DeviceType::kCPU, T, G, C>::Update(
 }
 
 template struct AdamUpdateKernelUtil<DeviceType::kCPU, float, float, float16>;
+template struct AdamUpdateKernelUtil<DeviceType::kCPU, float, float, bfloat16>;
 template struct AdamUpdateKernelUtil<DeviceType::kCPU, double, double, float16>;
 
 template<typename T, typename K, typename IDX>
@@ -23,6 +23,18 @@ namespace oneflow {
 
 namespace {
 
+// model_copy is optional, the kernels registered with a float16 model_copy also serve the updates
+// without one.
+template<typename C>
+auto ModelCopyDataTypeMatched() {
+  return hob::make_custom("ModelCopyDataTypeMatched", [](const user_op::KernelRegContext& ctx) {
+    if (!ctx.user_op_conf().has_input("model_copy", 0)) {
+      return std::is_same<C, float16>::value;
+    }
+    return ctx.TensorDesc4ArgNameAndIndex("model_copy", 0)->data_type() == GetDataType<C>::value;
+  });
+}
+
 template<DeviceType device_type, typename T, typename K>
 class TmpBufferManager final {
  public:
@@ -157,14 +169,16 @@ class SGDUpdateKernel final : public user_op::OpKernel, public user_op::CudaGrap
   bool AlwaysComputeWhenAllOutputsEmpty() const override { return true; }
 };
 
-#define REGISTER_SGD_UPDATE_KERNEL(device, dtype, gtype, ctype)                           \
-  REGISTER_USER_KERNEL("sgd_update")                                                      \
-      .SetCreateFn<SGDUpdateKernel<device, dtype, gtype, ctype>>()                        \
-      .SetIsMatchedHob((user_op::HobDeviceType() == device)                               \
-                       && (user_op::HobDataType("model", 0) == GetDataType<dtype>::value) \
-                       && (user_op::HobDataType("model_diff", 0) == GetDataType<gtype>::value));
+#define REGISTER_SGD_UPDATE_KERNEL(device, dtype, gtype, ctype)                                \
+  REGISTER_USER_KERNEL("sgd_update")                                                           \
+      .SetCreateFn<SGDUpdateKernel<device, dtype, gtype, ctype>>()                             \
+      .SetIsMatchedHob((user_op::HobDeviceType() == device)                                    \
+                       && (user_op::HobDataType("model", 0) == GetDataType<dtype>::value)      \
+                       && (user_op::HobDataType("model_diff", 0) == GetDataType<gtype>::value) \
+                       && (ModelCopyDataTypeMatched<ctype>() == true));
 
 REGISTER_SGD_UPDATE_KERNEL(DeviceType::kCPU, float, float, float16);
+REGISTER_SGD_UPDATE_KERNEL(DeviceType::kCPU, float, float, bfloat16);
 REGISTER_SGD_UPDATE_KERNEL(DeviceType::kCPU, double, double, float16);
 #ifdef WITH_CUDA
 REGISTER_SGD_UPDATE_KERNEL(DeviceType::kCUDA, float, float16, float16);
@@ -483,14 +497,16 @@ class AdamUpdateKernel final : public user_op::OpKernel, public user_op::CudaGra
   bool AlwaysComputeWhenAllOutputsEmpty() const override { return true; }
 };
 
-#define REGISTER_ADAM_UPDATE_KERNEL(device, dtype, gtype, ctype)                          \
-  REGISTER_USER_KERNEL("adam_update")                                                     \
-      .SetCreateFn<AdamUpdateKernel<device, dtype, gtype, ctype>>()                       \
-      .SetIsMatchedHob((user_op::HobDeviceType() == device)                               \
-                       && (user_op::HobDataType("model", 0) == GetDataType<dtype>::value) \
-                       && (user_op::HobDataType("model_diff", 0) == GetDataType<gtype>::value));
+#define REGISTER_ADAM_UPDATE_KERNEL(device, dtype, gtype, ctype)                               \
+  REGISTER_USER_KERNEL("adam_update")                                                          \
+      .SetCreateFn<AdamUpdateKernel<device, dtype, gtype, ctype>>()                            \
+      .SetIsMatchedHob((user_op::HobDeviceType() == device)                                    \
+                       && (user_op::HobDataType("model", 0) == GetDataType<dtype>::value)      \
+                       && (user_op::HobDataType("model_diff", 0) == GetDataType<gtype>::value) \
+                       && (ModelCopyDataTypeMatched<ctype>() == true));
 
 REGISTER_ADAM_UPDATE_KERNEL(DeviceType::kCPU, float, float, float16);
+REGISTER_ADAM_UPDATE_KERNEL(DeviceType::kCPU, float, float, bfloat16);
 REGISTER_ADAM_UPDATE_KERNEL(DeviceType::kCPU, double, double, float16);
 #ifdef WITH_CUDA
 REGISTER_ADAM_UPDATE_KERNEL(DeviceType::kCUDA, float, float16, float16);
@@ -93,6 +93,8 @@ class MultiTensorSGDUpdateKernel final : public user_op::OpKernel,
                        && (user_op::HobDataType("model", 0) == GetDataType<dtype>::value) \
                        && (user_op::HobDataType("model_diff", 0) == GetDataType<gtype>::value));
 
+REGISTER_MULTI_TENSOR_UPDATE_SGD_UPDATE_KERNEL(DeviceType::kCPU, float, float);
+REGISTER_MULTI_TENSOR_UPDATE_SGD_UPDATE_KERNEL(DeviceType::kCPU, double, double);
 #ifdef WITH_CUDA
 REGISTER_MULTI_TENSOR_UPDATE_SGD_UPDATE_KERNEL(DeviceType::kCUDA, float, float16);
 REGISTER_MULTI_TENSOR_UPDATE_SGD_UPDATE_KERNEL(DeviceType::kCUDA, float, float);
@@ -178,6 +180,8 @@ class MultiTensorMomentumUpdateKernel final : public user_op::OpKernel,
                        && (user_op::HobDataType("model_diff", 0) == GetDataType<gtype>::value) \
                        && (user_op::HobDataType("momentum_buf", 0) == GetDataType<gtype>::value));
 
+REGISTER_MULTI_TENSOR_UPDATE_MOMENTUM_UPDATE_KERNEL(DeviceType::kCPU, float, float);
+REGISTER_MULTI_TENSOR_UPDATE_MOMENTUM_UPDATE_KERNEL(DeviceType::kCPU, double, double);
 #ifdef WITH_CUDA
 REGISTER_MULTI_TENSOR_UPDATE_MOMENTUM_UPDATE_KERNEL(DeviceType::kCUDA, float, float16);
 REGISTER_MULTI_TENSOR_UPDATE_MOMENTUM_UPDATE_KERNEL(DeviceType::kCUDA, float, float);
@@ -288,13 +292,15 @@ class MultiTensorAdamUpdateKernel final : public user_op::OpKernel,
                        && (user_op::HobDataType("model", 0) == GetDataType<dtype>::value) \
                        && (user_op::HobDataType("model_diff", 0) == GetDataType<gtype>::value));
 
+REGISTER_MULTI_TENSOR_UPDATE_ADAM_UPDATE_KERNEL(DeviceType::kCPU, float, float);
+REGISTER_MULTI_TENSOR_UPDATE_ADAM_UPDATE_KERNEL(DeviceType::kCPU, double, double);
 #ifdef WITH_CUDA
 REGISTER_MULTI_TENSOR_UPDATE_ADAM_UPDATE_KERNEL(DeviceType::kCUDA, float, float16);
 REGISTER_MULTI_TENSOR_UPDATE_ADAM_UPDATE_KERNEL(DeviceType::kCUDA, float, float);
 REGISTER_MULTI_TENSOR_UPDATE_ADAM_UPDATE_KERNEL(DeviceType::kCUDA, double, double);
 #endif
 
-template<DeviceType device_type, typename T, typename G>
+template<DeviceType device_type, typename T, typename G, typename C>
 class MultiTensorSGDUpdateWithCastKernel final : public user_op::OpKernel,
                                                  public user_op::CudaGraphSupport {
  public:
@@ -349,7 +355,7 @@ class MultiTensorSGDUpdateWithCastKernel final : public user_op::OpKernel,
       count += 1;
       total_elem_cnt += tensor_elem_cnt;
       if (count == kMaxTuples || tensor_idx == n_tensor - 1) {
-        MultiTensorSGDUpdateWithCastKernelUtil<device_type, T, G>::Update(
+        MultiTensorSGDUpdateWithCastKernelUtil<device_type, T, G, C>::Update(
             ctx->stream(), total_elem_cnt, count, static_cast<T>(scale), l1, l2, weight_decay,
             learning_rate_val, lr_scale, learning_rate_ptr, scale_by_ptr, skip_if_ptr,
             tensor_tuple_params);
@@ -361,20 +367,23 @@ class MultiTensorSGDUpdateWithCastKernel final : public user_op::OpKernel,
   bool AlwaysComputeWhenAllOutputsEmpty() const override { return true; }
 };
 
-#define REGISTER_MULTI_TENSOR_UPDATE_SGD_UPDATE_WITH_CAST_KERNEL(device, dtype, gtype)         \
+#define REGISTER_MULTI_TENSOR_UPDATE_SGD_UPDATE_WITH_CAST_KERNEL(device, dtype, gtype, ctype)  \
   REGISTER_USER_KERNEL("multi_tensor_sgd_update_with_cast")                                    \
-      .SetCreateFn<MultiTensorSGDUpdateWithCastKernel<device, dtype, gtype>>()                 \
+      .SetCreateFn<MultiTensorSGDUpdateWithCastKernel<device, dtype, gtype, ctype>>()          \
       .SetIsMatchedHob((user_op::HobDeviceType() == device)                                    \
                        && (user_op::HobDataType("model", 0) == GetDataType<dtype>::value)      \
                        && (user_op::HobDataType("model_diff", 0) == GetDataType<gtype>::value) \
-                       && (user_op::HobDataType("model_copy", 0) == GetDataType<float16>::value));
+                       && (user_op::HobDataType("model_copy", 0) == GetDataType<ctype>::value));
 
+REGISTER_MULTI_TENSOR_UPDATE_SGD_UPDATE_WITH_CAST_KERNEL(DeviceType::kCPU, float, float, float16);
+REGISTER_MULTI_TENSOR_UPDATE_SGD_UPDATE_WITH_CAST_KERNEL(DeviceType::kCPU, float, float, bfloat16);
 #ifdef WITH_CUDA
-REGISTER_MULTI_TENSOR_UPDATE_SGD_UPDATE_WITH_CAST_KERNEL(DeviceType::kCUDA, float, float);
-REGISTER_MULTI_TENSOR_UPDATE_SGD_UPDATE_WITH_CAST_KERNEL(DeviceType::kCUDA, float, float16);
+REGISTER_MULTI_TENSOR_UPDATE_SGD_UPDATE_WITH_CAST_KERNEL(DeviceType::kCUDA, float, float, float16);
+REGISTER_MULTI_TENSOR_UPDATE_SGD_UPDATE_WITH_CAST_KERNEL(DeviceType::kCUDA, float, float16,
+                                                         float16);
 #endif
 
-template<DeviceType device_type, typename T, typename G>
+template<DeviceType device_type, typename T, typename G, typename C>
 class MultiTensorMomentumUpdateWithCastKernel final : public user_op::OpKernel,
                                                       public user_op::CudaGraphSupport {
  public:
@@ -435,7 +444,7 @@ class MultiTensorMomentumUpdateWithCastKernel final : public user_op::OpKernel,
       count += 1;
       total_elem_cnt += tensor_elem_cnt;
       if (count == kMaxTuples || tensor_idx == n_tensor - 1) {
-        MultiTensorMomentumUpdateWithCastKernelUtil<device_type, T, G>::Update(
+        MultiTensorMomentumUpdateWithCastKernelUtil<device_type, T, G, C>::Update(
             ctx->stream(), total_elem_cnt, count, static_cast<T>(scale), l1, l2, weight_decay,
             learning_rate_val, lr_scale, learning_rate_ptr, scale_by_ptr, skip_if_ptr, momentum,
             dampening, nesterov, maximize, tensor_tuple_params);
@@ -447,21 +456,27 @@ class MultiTensorMomentumUpdateWithCastKernel final : public user_op::OpKernel,
   bool AlwaysComputeWhenAllOutputsEmpty() const override { return true; }
 };
 
-#define REGISTER_MULTI_TENSOR_UPDATE_MOMENTUM_UPDATE_WITH_CAST_KERNEL(device, dtype, gtype)      \
-  REGISTER_USER_KERNEL("multi_tensor_momentum_update_with_cast")                                 \
-      .SetCreateFn<MultiTensorMomentumUpdateWithCastKernel<device, dtype, gtype>>()              \
-      .SetIsMatchedHob((user_op::HobDeviceType() == device)                                      \
-                       && (user_op::HobDataType("model", 0) == GetDataType<dtype>::value)        \
-                       && (user_op::HobDataType("model_diff", 0) == GetDataType<gtype>::value)   \
-                       && (user_op::HobDataType("momentum_buf", 0) == GetDataType<gtype>::value) \
-                       && (user_op::HobDataType("model_copy", 0) == GetDataType<float16>::value));
-
+#define REGISTER_MULTI_TENSOR_UPDATE_MOMENTUM_UPDATE_WITH_CAST_KERNEL(device, dtype, gtype, ctype) \
+  REGISTER_USER_KERNEL("multi_tensor_momentum_update_with_cast")                                   \
+      .SetCreateFn<MultiTensorMomentumUpdateWithCastKernel<device, dtype, gtype, ctype>>()         \
+      .SetIsMatchedHob((user_op::HobDeviceType() == device)                                        \
+                       && (user_op::HobDataType("model", 0) == GetDataType<dtype>::value)          \
+                       && (user_op::HobDataType("model_diff", 0) == GetDataType<gtype>::value)     \
+                       && (user_op::HobDataType("momentum_buf", 0) == GetDataType<gtype>::value)   \
+                       && (user_op::HobDataType("model_copy", 0) == GetDataType<ctype>::value));
+
+REGISTER_MULTI_TENSOR_UPDATE_MOMENTUM_UPDATE_WITH_CAST_KERNEL(DeviceType::kCPU, float, float,
+                                                              float16);
+REGISTER_MULTI_TENSOR_UPDATE_MOMENTUM_UPDATE_WITH_CAST_KERNEL(DeviceType::kCPU, float, float,
+                                                              bfloat16);
 #ifdef WITH_CUDA
-REGISTER_MULTI_TENSOR_UPDATE_MOMENTUM_UPDATE_WITH_CAST_KERNEL(DeviceType::kCUDA, float, float);
-REGISTER_MULTI_TENSOR_UPDATE_MOMENTUM_UPDATE_WITH_CAST_KERNEL(DeviceType::kCUDA, float, float16);
+REGISTER_MULTI_TENSOR_UPDATE_MOMENTUM_UPDATE_WITH_CAST_KERNEL(DeviceType::kCUDA, float, float,
+                                                              float16);
+REGISTER_MULTI_TENSOR_UPDATE_MOMENTUM_UPDATE_WITH_CAST_KERNEL(DeviceType::kCUDA, float, float16,
+                                                              float16);
 #endif
 
-template<DeviceType device_type, typename T, typename G>
+template<DeviceType device_type, typename T, typename G, typename C>
 class MultiTensorAdamUpdateWithCastKernel final : public user_op::OpKernel,
                                                   public user_op::CudaGraphSupport {
  public:
@@ -547,7 +562,7 @@ class MultiTensorAdamUpdateWithCastKernel final : public user_op::OpKernel,
       count += 1;
       total_elem_cnt += tensor_elem_cnt;
       if (count == kMaxTuples || tensor_idx == n_tensor - 1) {
-        MultiTensorAdamUpdateWithCastKernelUtil<device_type, T, G>::Update(
+        MultiTensorAdamUpdateWithCastKernelUtil<device_type, T, G, C>::Update(
             ctx->stream(), total_elem_cnt, count, static_cast<T>(scale), l1, l2, beta1, beta2,
             epsilon, weight_decay, amsgrad, do_bias_correction, learning_rate_val,
             bias_correction1_val, bias_correction2_val, lr_scale, learning_rate_ptr, scale_by_ptr,
@@ -560,17 +575,20 @@ class MultiTensorAdamUpdateWithCastKernel final : public user_op::OpKernel,
   bool AlwaysComputeWhenAllOutputsEmpty() const override { return true; }
 };
 
-#define REGISTER_MULTI_TENSOR_UPDATE_ADAM_UPDATE_WITH_CAST_KERNEL(device, dtype, gtype)        \
+#define REGISTER_MULTI_TENSOR_UPDATE_ADAM_UPDATE_WITH_CAST_KERNEL(device, dtype, gtype, ctype) \
   REGISTER_USER_KERNEL("multi_tensor_adam_update_with_cast")                                   \
-      .SetCreateFn<MultiTensorAdamUpdateWithCastKernel<device, dtype, gtype>>()                \
+      .SetCreateFn<MultiTensorAdamUpdateWithCastKernel<device, dtype, gtype, ctype>>()         \
       .SetIsMatchedHob((user_op::HobDeviceType() == device)                                    \
                        && (user_op::HobDataType("model", 0) == GetDataType<dtype>::value)      \
                        && (user_op::HobDataType("model_diff", 0) == GetDataType<gtype>::value) \
-                       && (user_op::HobDataType("model_copy", 0) == GetDataType<float16>::value));
+                       && (user_op::HobDataType("model_copy", 0) == GetDataType<ctype>::value));
 
+REGISTER_MULTI_TENSOR_UPDATE_ADAM_UPDATE_WITH_CAST_KERNEL(DeviceType::kCPU, float, float, float16);
+REGISTER_MULTI_TENSOR_UPDATE_ADAM_UPDATE_WITH_CAST_KERNEL(DeviceType::kCPU, float, float, bfloat16);
 #ifdef WITH_CUDA
-REGISTER_MULTI_TENSOR_UPDATE_ADAM_UPDATE_WITH_CAST_KERNEL(DeviceType::kCUDA, float, float);
-REGISTER_MULTI_TENSOR_UPDATE_ADAM_UPDATE_WITH_CAST_KERNEL(DeviceType::kCUDA, float, float16);
+REGISTER_MULTI_TENSOR_UPDATE_ADAM_UPDATE_WITH_CAST_KERNEL(DeviceType::kCUDA, float, float, float16);
+REGISTER_MULTI_TENSOR_UPDATE_ADAM_UPDATE_WITH_CAST_KERNEL(DeviceType::kCUDA, float, float16,
+                                                          float16);
 #endif
 
 template<DeviceType device_type, typename T>
@@ -617,6 +635,7 @@ class MultiTensorYoloV5WeightUpdateKernel final : public user_op::OpKernel,
       .SetIsMatchedHob((user_op::HobDeviceType() == device)              \
                        && (user_op::HobDataType("model", 0) == GetDataType<dtype>::value));
 
+REGISTER_MULTI_TENSOR_YOLOV5_WEIGHT_UPDATE_KERNEL(DeviceType::kCPU, float);
 #ifdef WITH_CUDA
 REGISTER_MULTI_TENSOR_YOLOV5_WEIGHT_UPDATE_KERNEL(DeviceType::kCUDA, float);
 #endif
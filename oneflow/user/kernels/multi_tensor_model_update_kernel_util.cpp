@@ -0,0 +1,376 @@
+/*
+Copyright 2020 The OneFlow Authors. All rights reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+#include "oneflow/core/framework/framework.h"
+#include "oneflow/user/kernels/model_update_kernel_util.h"
+#include "oneflow/user/kernels/multi_tensor_model_update_kernel_util.h"
+#include "oneflow/core/ep/cpu/cpu_stream.h"
+
+namespace oneflow {
+
+namespace {
+
+// The elements of all the tensors of one launch are viewed as one flat range which is split
+// evenly across the threads, in grains of this many elements. The operands of a grain stay in L2,
+// small tensors are batched into the task of one thread and big tensors are spread over all of
+// them.
+constexpr size_t kGrainSize = 16384;
+
+template<int N, typename F>
+void ParallelForEachTensorRange(ep::Stream* stream, int64_t n_tensor,
+                                const TensorTupleParams<N>& tensor_tuple_params, const F& fn) {
+  int64_t offsets[kMaxTuples + 1];
+  offsets[0] = 0;
+  for (int64_t i = 0; i < n_tensor; ++i) {
+    offsets[i + 1] = offsets[i] + tensor_tuple_params.sizes[i];
+  }
+  stream->As<ep::CpuStream>()->ParallelFor(
+      0, offsets[n_tensor],
+      [&](int64_t begin, int64_t end) {
+        int64_t tensor_idx =
+            std::upper_bound(offsets, offsets + n_tensor + 1, begin) - offsets - 1;
+        while (begin < end) {
+          const int64_t tensor_end = std::min(end, offsets[tensor_idx + 1]);
+          fn(tensor_idx, begin - offsets[tensor_idx], tensor_end - offsets[tensor_idx]);
+          begin = tensor_end;
+          tensor_idx += 1;
+        }
+      },
+      kGrainSize);
+}
+
+// The loops below only touch restrict qualified unit stride pointers and keep every branch out of
+// the element loop, so that the compiler turns them into simd code.
+
+template<typename T, typename G, typename C>
+void SGDUpdateRange(int64_t n, T scale, float l1, float l2, float weight_decay,
+                    float learning_rate, T* __restrict__ model, const G* __restrict__ model_diff,
+                    C* __restrict__ model_copy) {
+  const auto Update = [&](int64_t i) -> T {
+    const T model_val = model[i];
+    const T model_diff_t =
+        CastScaleRegularizeGradientFunctor<T, G>()(model_diff[i], model_val, scale, l1, l2);
+    const T next_model = model_val - learning_rate * (model_diff_t + weight_decay * model_val);
+    model[i] = next_model;
+    return next_model;
+  };
+  if (model_copy == nullptr) {
+    for (int64_t i = 0; i < n; ++i) { Update(i); }
+  } else {
+    for (int64_t i = 0; i < n; ++i) { model_copy[i] = static_cast<C>(Update(i)); }
+  }
+}
+
+template<typename T, typename G, typename C>
+void MomentumUpdateRange(int64_t n, T scale, float l1, float l2, float weight_decay,
+                         float learning_rate, float momentum, float dampening, bool nesterov,
+                         bool maximize, T* __restrict__ model, const G* __restrict__ model_diff,
+                         T* __restrict__ momentum_buf, C* __restrict__ model_copy) {
+  const T alpha = maximize ? learning_rate : -learning_rate;
+  const auto Update = [&](int64_t i) -> T {
+    const T model_val = model[i];
+    const T model_diff_t =
+        CastScaleRegularizeGradientFunctor<T, G>()(model_diff[i], model_val, scale, l1, l2)
+        + weight_decay * model_val;
+    const T next_buf = momentum * momentum_buf[i] + (1.f - dampening) * model_diff_t;
+    momentum_buf[i] = next_buf;
+    const T step = nesterov ? model_diff_t + momentum * next_buf : next_buf;
+    const T next_model = model_val + alpha * step;
+    model[i] = next_model;
+    return next_model;
+  };
+  if (model_copy == nullptr) {
+    for (int64_t i = 0; i < n; ++i) { Update(i); }
+  } else {
+    for (int64_t i = 0; i < n; ++i) { model_copy[i] = static_cast<C>(Update(i)); }
+  }
+}
+
+template<typename T, typename G, typename C>
+void AdamUpdateRange(int64_t n, T scale, float l1, float l2, float beta1, float beta2,
+                     float epsilon, float weight_decay, float learning_rate,
+                     float bias_correction1, float bias_correction2, T* __restrict__ model,
+                     const G* __restrict__ model_diff, T* __restrict__ m, T* __restrict__ v,
+                     C* __restrict__ model_copy) {
+  const T step_size = learning_rate / bias_correction1;
+  const T sqrt_bias_correction2 = std::sqrt(static_cast<T>(bias_correction2));
+  const T decay = learning_rate * weight_decay;
+  const auto Update = [&](int64_t i) -> T {
+    const T model_val = model[i];
+    const T model_diff_t =
+        CastScaleRegularizeGradientFunctor<T, G>()(model_diff[i], model_val, scale, l1, l2);
+    const T next_m = beta1 * m[i] + (1 - beta1) * model_diff_t;
+    const T next_v = beta2 * v[i] + (1 - beta2) * model_diff_t * model_diff_t;
+    m[i] = next_m;
+    v[i] = next_v;
+    const T denom = std::sqrt(next_v) / sqrt_bias_correction2 + epsilon;
+    const T next_model = model_val - step_size * (next_m / denom) - decay * model_val;
+    model[i] = next_model;
+    return next_model;
+  };
+  if (model_copy == nullptr) {
+    for (int64_t i = 0; i < n; ++i) { Update(i); }
+  } else {
+    for (int64_t i = 0; i < n; ++i) { model_copy[i] = static_cast<C>(Update(i)); }
+  }
+}
+
+template<typename T, typename G, typename C, int N>
+void LaunchSGDUpdate(ep::Stream* stream, int64_t n_tensor, T scale, float l1, float l2,
+                     float weight_decay, float learning_rate_val, float lr_scale,
+                     const float* learning_rate, const T* scale_by_ptr, const int64_t* skip_if,
+                     const TensorTupleParams<N>& tensor_tuple_params) {
+  if (skip_if != nullptr && *skip_if != 0) { return; }
+  if (learning_rate != nullptr) { learning_rate_val = *learning_rate; }
+  if (scale_by_ptr != nullptr) { scale *= *scale_by_ptr; }
+  learning_rate_val *= lr_scale;
+  ParallelForEachTensorRange<N>(
+      stream, n_tensor, tensor_tuple_params, [&](int64_t tensor_idx, int64_t begin, int64_t end) {
+        C* model_copy = nullptr;
+        if (N == 3) { model_copy = static_cast<C*>(tensor_tuple_params.ptr[N - 1][tensor_idx]); }
+        SGDUpdateRange<T, G, C>(
+            end - begin, scale, l1, l2, weight_decay, learning_rate_val,
+            static_cast<T*>(tensor_tuple_params.ptr[0][tensor_idx]) + begin,
+            static_cast<const G*>(tensor_tuple_params.ptr[1][tensor_idx]) + begin,
+            model_copy == nullptr ? nullptr : model_copy + begin);
+      });
+}
+
+template<typename T, typename G, typename C, int N>
+void LaunchMomentumUpdate(ep::Stream* stream, int64_t n_tensor, T scale, float l1, float l2,
+                          float weight_decay, float learning_rate_val, float lr_scale,
+                          const float* learning_rate, const T* scale_by_ptr,
+                          const int64_t* skip_if, float momentum, float dampening, bool nesterov,
+                          bool maximize, const TensorTupleParams<N>& tensor_tuple_params) {
+  if (skip_if != nullptr && *skip_if != 0) { return; }
+  if (learning_rate != nullptr) { learning_rate_val = *learning_rate; }
+  if (scale_by_ptr != nullptr) { scale *= *scale_by_ptr; }
+  learning_rate_val *= lr_scale;
+  ParallelForEachTensorRange<N>(
+      stream, n_tensor, tensor_tuple_params, [&](int64_t tensor_idx, int64_t begin, int64_t end) {
+        C* model_copy = nullptr;
+        if (N == 4) { model_copy = static_cast<C*>(tensor_tuple_params.ptr[N - 1][tensor_idx]); }
+        MomentumUpdateRange<T, G, C>(
+            end - begin, scale, l1, l2, weight_decay, learning_rate_val, momentum, dampening,
+            nesterov, maximize, static_cast<T*>(tensor_tuple_params.ptr[0][tensor_idx]) + begin,
+            static_cast<const G*>(tensor_tuple_params.ptr[1][tensor_idx]) + begin,
+            static_cast<T*>(tensor_tuple_params.ptr[2][tensor_idx]) + begin,
+            model_copy == nullptr ? nullptr : model_copy + begin);
+      });
+}
+
+template<typename T, typename G, typename C, int N>
+void LaunchAdamUpdate(ep::Stream* stream, int64_t n_tensor, T scale, float l1, float l2,
+                      float beta1, float beta2, float epsilon, float weight_decay,
+                      float learning_rate_val, float bias_correction1_val,
+                      float bias_correction2_val, float lr_scale, const float* learning_rate,
+                      const T* scale_by_ptr, const int64_t* skip_if,
+                      const float* bias_correction1_ptr, const float* bias_correction2_ptr,
+                      const TensorTupleParams<N>& tensor_tuple_params) {
+  if (skip_if != nullptr && *skip_if != 0) { return; }
+  if (learning_rate != nullptr) { learning_rate_val = *learning_rate; }
+  if (scale_by_ptr != nullptr) { scale *= *scale_by_ptr; }
+  if (bias_correction1_ptr != nullptr) { bias_correction1_val = *bias_correction1_ptr; }
+  if (bias_correction2_ptr != nullptr) { bias_correction2_val = *bias_correction2_ptr; }
+  learning_rate_val *= lr_scale;
+  ParallelForEachTensorRange<N>(
+      stream, n_tensor, tensor_tuple_params, [&](int64_t tensor_idx, int64_t begin, int64_t end) {
+        C* model_copy = nullptr;
+        if (N == 5) { model_copy = static_cast<C*>(tensor_tuple_params.ptr[N - 1][tensor_idx]); }
+        AdamUpdateRange<T, G, C>(
+            end - begin, scale, l1, l2, beta1, beta2, epsilon, weight_decay, learning_rate_val,
+            bias_correction1_val, bias_correction2_val,
+            static_cast<T*>(tensor_tuple_params.ptr[0][tensor_idx]) + begin,
+            static_cast<const G*>(tensor_tuple_params.ptr[1][tensor_idx]) + begin,
+            static_cast<T*>(tensor_tuple_params.ptr[2][tensor_idx]) + begin,
+            static_cast<T*>(tensor_tuple_params.ptr[3][tensor_idx]) + begin,
+            model_copy == nullptr ? nullptr : model_copy + begin);
+      });
+}
+
+}  // namespace
+
+template<typename T, typename G>
+struct MultiTensorSGDUpdateKernelUtil<DeviceType::kCPU, T, G> {
+  static void Update(ep::Stream* stream, const int64_t elem_cnt, const int64_t n_tensor, T scale,
+                     float l1, float l2, float weight_decay, float learning_rate_val,
+                     float lr_scale, const float* learning_rate, const T* scale_by_ptr,
+                     const int64_t* skip_if, TensorTupleParams<2> tensor_tuple_params);
+};
+
+template<typename T, typename G>
+void MultiTensorSGDUpdateKernelUtil<DeviceType::kCPU, T, G>::Update(
+    ep::Stream* stream, const int64_t elem_cnt, const int64_t n_tensor, T scale, float l1, float l2,
+    float weight_decay, float learning_rate_val, float lr_scale, const float* learning_rate,
+    const T* scale_by_ptr, const int64_t* skip_if, TensorTupleParams<2> tensor_tuple_params) {
+  LaunchSGDUpdate<T, G, T, 2>(stream, n_tensor, scale, l1, l2, weight_decay, learning_rate_val,
+                              lr_scale, learning_rate, scale_by_ptr, skip_if, tensor_tuple_params);
+}
+
+template struct MultiTensorSGDUpdateKernelUtil<DeviceType::kCPU, float, float>;
+template struct MultiTensorSGDUpdateKernelUtil<DeviceType::kCPU, double, double>;
+
+template<typename T, typename G>
+struct MultiTensorMomentumUpdateKernelUtil<DeviceType::kCPU, T, G> {
+  static void Update(ep::Stream* stream, const int64_t elem_cnt, const int64_t n_tensor, T scale,
+                     float l1, float l2, float weight_decay, float learning_rate_val,
+                     float lr_scale, const float* learning_rate, const T* scale_by_ptr,
+                     const int64_t* skip_if, const float momentum, const float dampening,
+                     const bool nesterov, const bool maximize,
+                     TensorTupleParams<3> tensor_tuple_params);
+};
+
+template<typename T, typename G>
+void MultiTensorMomentumUpdateKernelUtil<DeviceType::kCPU, T, G>::Update(
+    ep::Stream* stream, const int64_t elem_cnt, const int64_t n_tensor, T scale, float l1, float l2,
+    float weight_decay, float learning_rate_val, float lr_scale, const float* learning_rate,
+    const T* scale_by_ptr, const int64_t* skip_if, const float momentum, const float dampening,
+    const bool nesterov, const bool maximize, TensorTupleParams<3> tensor_tuple_params) {
+  LaunchMomentumUpdate<T, G, T, 3>(stream, n_tensor, scale, l1, l2, weight_decay,
+                                   learning_rate_val, lr_scale, learning_rate, scale_by_ptr,
+                                   skip_if, momentum, dampening, nesterov, maximize,
+                                   tensor_tuple_params);
+}
+
+template struct MultiTensorMomentumUpdateKernelUtil<DeviceType::kCPU, float, float>;
+template struct MultiTensorMomentumUpdateKernelUtil<DeviceType::kCPU, double, double>;
+
+template<typename T, typename G>
+struct MultiTensorAdamUpdateKernelUtil<DeviceType::kCPU, T, G> {
+  static void Update(ep::Stream* stream, const int64_t elem_cnt, const int64_t n_tensor, T scale,
+                     float l1, float l2, float beta1, float beta2, float epsilon,
+                     float weight_decay, bool amsgrad, bool do_bias_correction,
+                     float learning_rate_val, float bias_correction1_val,
+                     float bias_correction2_val, float lr_scale, const float* learning_rate,
+                     const T* scale_by_ptr, const int64_t* skip_if, const float* bias_correction1,
+                     const float* bias_correction2, TensorTupleParams<4> tensor_tuple_params);
+};
+
+template<typename T, typename G>
+void MultiTensorAdamUpdateKernelUtil<DeviceType::kCPU, T, G>::Update(
+    ep::Stream* stream, const int64_t elem_cnt, const int64_t n_tensor, T scale, float l1, float l2,
+    float beta1, float beta2, float epsilon, float weight_decay, bool amsgrad,
+    bool do_bias_correction, float learning_rate_val, float bias_correction1_val,
+    float bias_correction2_val, float lr_scale, const float* learning_rate, const T* scale_by_ptr,
+    const int64_t* skip_if, const float* bias_correction1, const float* bias_correction2,
+    TensorTupleParams<4> tensor_tuple_params) {
+  LaunchAdamUpdate<T, G, T, 4>(stream, n_tensor, scale, l1, l2, beta1, beta2, epsilon,
+                               weight_decay, learning_rate_val, bias_correction1_val,
+                               bias_correction2_val, lr_scale, learning_rate, scale_by_ptr,
+                               skip_if, bias_correction1, bias_correction2, tensor_tuple_params);
+}
+
+template struct MultiTensorAdamUpdateKernelUtil<DeviceType::kCPU, float, float>;
+template struct MultiTensorAdamUpdateKernelUtil<DeviceType::kCPU, double, double>;
+
+template<typename T, typename G, typename C>
+struct MultiTensorSGDUpdateWithCastKernelUtil<DeviceType::kCPU, T, G, C> {
+  static void Update(ep::Stream* stream, const int64_t elem_cnt, const int64_t n_tensor, T scale,
+                     float l1, float l2, float weight_decay, float learning_rate_val,
+                     float lr_scale, const float* learning_rate, const T* scale_by_ptr,
+                     const int64_t* skip_if, TensorTupleParams<3> tensor_tuple_params);
+};
+
+template<typename T, typename G, typename C>
+void MultiTensorSGDUpdateWithCastKernelUtil<DeviceType::kCPU, T, G, C>::Update(
+    ep::Stream* stream, const int64_t elem_cnt, const int64_t n_tensor, T scale, float l1, float l2,
+    float weight_decay, float learning_rate_val, float lr_scale, const float* learning_rate,
+    const T* scale_by_ptr, const int64_t* skip_if, TensorTupleParams<3> tensor_tuple_params) {
+  LaunchSGDUpdate<T, G, C, 3>(stream, n_tensor, scale, l1, l2, weight_decay, learning_rate_val,
+                              lr_scale, learning_rate, scale_by_ptr, skip_if, tensor_tuple_params);
+}
+
+template struct MultiTensorSGDUpdateWithCastKernelUtil<DeviceType::kCPU, float, float, float16>;
+template struct MultiTensorSGDUpdateWithCastKernelUtil<DeviceType::kCPU, float, float, bfloat16>;
+
+template<typename T, typename G, typename C>
+struct MultiTensorMomentumUpdateWithCastKernelUtil<DeviceType::kCPU, T, G, C> {
+  static void Update(ep::Stream* stream, const int64_t elem_cnt, const int64_t n_tensor, T scale,
+                     float l1, float l2, float weight_decay, float learning_rate_val,
+                     float lr_scale, const float* learning_rate, const T* scale_by_ptr,
+                     const int64_t* skip_if, const float momentum, const float dampening,
+                     const bool nesterov, const bool maximize,
+                     TensorTupleParams<4> tensor_tuple_params);
+};
+
+template<typename T, typename G, typename C>
+void MultiTensorMomentumUpdateWithCastKernelUtil<DeviceType::kCPU, T, G, C>::Update(
+    ep::Stream* stream, const int64_t elem_cnt, const int64_t n_tensor, T scale, float l1, float l2,
+    float weight_decay, float learning_rate_val, float lr_scale, const float* learning_rate,
+    const T* scale_by_ptr, const int64_t* skip_if, const float momentum, const float dampening,
+    const bool nesterov, const bool maximize, TensorTupleParams<4> tensor_tuple_params) {
+  LaunchMomentumUpdate<T, G, C, 4>(stream, n_tensor, scale, l1, l2, weight_decay,
+                                   learning_rate_val, lr_scale, learning_rate, scale_by_ptr,
+                                   skip_if, momentum, dampening, nesterov, maximize,
+                                   tensor_tuple_params);
+}
+
+template struct MultiTensorMomentumUpdateWithCastKernelUtil<DeviceType::kCPU, float, float,
+                                                            float16>;
+template struct MultiTensorMomentumUpdateWithCastKernelUtil<DeviceType::kCPU, float, float,
+                                                            bfloat16>;
+
+template<typename T, typename G, typename C>
+struct MultiTensorAdamUpdateWithCastKernelUtil<DeviceType::kCPU, T, G, C> {
+  static void Update(ep::Stream* stream, const int64_t elem_cnt, const int64_t n_tensor, T scale,
+                     float l1, float l2, float beta1, float beta2, float epsilon,
+                     float weight_decay, bool amsgrad, bool do_bias_correction,
+                     float learning_rate_val, float bias_correction1_val,
+                     float bias_correction2_val, float lr_scale, const float* learning_rate,
+                     const T* scale_by_ptr, const int64_t* skip_if, const float* bias_correction1,
+                     const float* bias_correction2, TensorTupleParams<5> tensor_tuple_params);
+};
+
+template<typename T, typename G, typename C>
+void MultiTensorAdamUpdateWithCastKernelUtil<DeviceType::kCPU, T, G, C>::Update(
+    ep::Stream* stream, const int64_t elem_cnt, const int64_t n_tensor, T scale, float l1, float l2,
+    float beta1, float beta2, float epsilon, float weight_decay, bool amsgrad,
+    bool do_bias_correction, float learning_rate_val, float bias_correction1_val,
+    float bias_correction2_val, float lr_scale, const float* learning_rate, const T* scale_by_ptr,
+    const int64_t* skip_if, const float* bias_correction1, const float* bias_correction2,
+    TensorTupleParams<5> tensor_tuple_params) {
+  LaunchAdamUpdate<T, G, C, 5>(stream, n_tensor, scale, l1, l2, beta1, beta2, epsilon,
+                               weight_decay, learning_rate_val, bias_correction1_val,
+                               bias_correction2_val, lr_scale, learning_rate, scale_by_ptr,
+                               skip_if, bias_correction1, bias_correction2, tensor_tuple_params);
+}
+
+template struct MultiTensorAdamUpdateWithCastKernelUtil<DeviceType::kCPU, float, float, float16>;
+template struct MultiTensorAdamUpdateWithCastKernelUtil<DeviceType::kCPU, float, float, bfloat16>;
+
+template<typename T>
+struct MultiTensorYoloV5WeightUpdateKernelUtil<DeviceType::kCPU, T> {
+  static void Update(ep::Stream* stream, const int64_t elem_cnt, const int64_t n_tensor, float d,
+                     TensorTupleParams<2> tensor_tuple_params);
+};
+
+template<typename T>
+void MultiTensorYoloV5WeightUpdateKernelUtil<DeviceType::kCPU, T>::Update(
+    ep::Stream* stream, const int64_t elem_cnt, const int64_t n_tensor, float d,
+    TensorTupleParams<2> tensor_tuple_params) {
+  ParallelForEachTensorRange<2>(
+      stream, n_tensor, tensor_tuple_params, [&](int64_t tensor_idx, int64_t begin, int64_t end) {
+        T* __restrict__ model = static_cast<T*>(tensor_tuple_params.ptr[0][tensor_idx]);
+        const T* __restrict__ model_update =
+            static_cast<const T*>(tensor_tuple_params.ptr[1][tensor_idx]);
+        for (int64_t i = begin; i < end; ++i) {
+          model[i] = d * model[i] + (1 - d) * model_update[i];
+        }
+      });
+}
+
+template struct MultiTensorYoloV5WeightUpdateKernelUtil<DeviceType::kCPU, float>;
+
+}  // namespace oneflow
@@ -60,7 +60,8 @@ struct MultiTensorAdamUpdateKernelUtil {
                      const float* bias_correction2, TensorTupleParams<4> tensor_tuple_params);
 };
 
-template<DeviceType device_type, typename T, typename G>
+// C is the data type of model_copy, the low precision copy of the model written by the update.
+template<DeviceType device_type, typename T, typename G, typename C = float16>
 struct MultiTensorSGDUpdateWithCastKernelUtil {
   static void Update(ep::Stream* stream, const int64_t elem_cnt, const int64_t n_tensor, T scale,
                      float l1, float l2, float weight_decay, float learning_rate_val,
@@ -68,7 +69,7 @@ struct MultiTensorSGDUpdateWithCastKernelUtil {
                      const int64_t* skip_if, TensorTupleParams<3> tensor_tuple_params);
 };
 
-template<DeviceType device_type, typename T, typename G>
+template<DeviceType device_type, typename T, typename G, typename C = float16>
 struct MultiTensorMomentumUpdateWithCastKernelUtil {
   static void Update(ep::Stream* stream, const int64_t elem_cnt, const int64_t n_tensor, T scale,
                      float l1, float l2, float weight_decay, float learning_rate_val,
@@ -78,7 +79,7 @@ struct MultiTensorMomentumUpdateWithCastKernelUtil {
                      TensorTupleParams<4> tensor_tuple_params);
 };
 
-template<DeviceType device_type, typename T, typename G>
+template<DeviceType device_type, typename T, typename G, typename C = float16>
 struct MultiTensorAdamUpdateWithCastKernelUtil {
   static void Update(ep::Stream* stream, const int64_t elem_cnt, const int64_t n_tensor, T scale,
                      float l1, float l2, float beta1, float beta2, float epsilon,
@@ -14,260 +14,370 @@ See the License for the specific language governing permissions and
 limitations under the License.
 */
 #include "oneflow/core/framework/framework.h"
+#include "oneflow/core/ep/cpu/cpu_stream.h"
+#include "oneflow/core/ep/cpu/cpu_device.h"
 
 namespace oneflow {
 
-template<typename T>
-static void ComputeMeanAndVar(const T* input_ptr, T* mean_ptr, T* inv_variance_ptr,
-                              T* moving_mean_ptr, T* moving_variance_ptr, const int64_t batch_size,
-                              const int64_t channel_size, const int64_t spatial_size,
-                              const float epsilon, const float momentum) {
-  // NOTE(Liang Depeng): the following parameters were used to compute mean and var
-  const int64_t jump_step = spatial_size * channel_size;
-  const int64_t reduce_count = batch_size * spatial_size;
-  const int64_t unbias_reduce_count = reduce_count - 1;
-  const T reduce_scale_factor = static_cast<T>(1) / reduce_count;
-  const T unbias_reduce_scale_factor = static_cast<T>(1) / unbias_reduce_count;
-  const T unbias_reduce_scale_factor_m2 = unbias_reduce_scale_factor * -static_cast<T>(2);
-  const T unbias_reduce_scale_factor_mn = reduce_count * unbias_reduce_scale_factor;
-
-  const T exponential_average_factor = 1.0f - momentum;
-
-  for (int64_t channel = 0; channel < channel_size; ++channel) {
-    const T* temp_input_ptr = input_ptr + channel * spatial_size;
-    T sum = 0;
-    T sum_square = 0;
-    for (int64_t batch = 0; batch < batch_size; ++batch) {
-      for (int64_t s = 0; s < spatial_size; ++s) {
-        const T x = temp_input_ptr[s];
-        sum += x;
-        sum_square += x * x;
-      }
-      temp_input_ptr += jump_step;
-    }
+namespace {
 
-    const T temp_mean = sum * reduce_scale_factor;
-    mean_ptr[channel] = temp_mean;
+// Elementwise passes are handed out to threads in tasks of at least this many elements.
+constexpr int64_t kParallelGrainElemCnt = 32768;
 
-    const T temp_mean_square = temp_mean * temp_mean;
-    const T temp_variance = sum_square * reduce_scale_factor - temp_mean_square;
+// The relu mask of normalization_add_relu keeps one bit per element in int32 words.
+constexpr int64_t kMaskWordBits = 32;
 
-    const T temp_unbias_variance = sum_square * unbias_reduce_scale_factor
-                                   + unbias_reduce_scale_factor_m2 * temp_mean * sum
-                                   + unbias_reduce_scale_factor_mn * temp_mean_square;
+// Elements normalized before their relu mask words are packed, small enough to stay in L1.
+constexpr int64_t kMaskChunkElemCnt = 64 * kMaskWordBits;
 
-    inv_variance_ptr[channel] = static_cast<T>(1) / std::sqrt(temp_variance + epsilon);
+// Independent accumulators per channel plane so that the reduction is not a serial chain.
+constexpr int32_t kLanes = 8;
 
-    if (moving_mean_ptr != nullptr && moving_variance_ptr != nullptr) {
-      moving_mean_ptr[channel] =
-          moving_mean_ptr[channel] * momentum + temp_mean * exponential_average_factor;
-      moving_variance_ptr[channel] = moving_variance_ptr[channel] * momentum
-                                     + temp_unbias_variance * exponential_average_factor;
-    }
+// Channel statistics are accumulated in double, a batch of activations easily has millions of
+// elements per channel.
+using StatType = double;
+
+// x is viewed as (outer, channels, inner) around the normalized axis, NCHW has inner = H * W and
+// NHWC has inner = 1. Every (outer, channel) pair addresses a contiguous plane of inner elements.
+struct ChannelLayout {
+  int64_t outer;
+  int64_t channels;
+  int64_t inner;
+  int64_t ElemCnt() const { return outer * channels * inner; }
+};
+
+ChannelLayout MakeChannelLayout(const ShapeView& shape, int32_t axis) {
+  CHECK_GE(axis, 0);
+  CHECK_LT(axis, shape.NumAxes());
+  ChannelLayout layout{};
+  layout.outer = shape.Count(0, axis);
+  layout.channels = shape.At(axis);
+  layout.inner = shape.Count(axis + 1);
+  return layout;
+}
+
+int64_t CeilDiv(int64_t n, int64_t d) { return (n + d - 1) / d; }
+
+// Calls fn(offset, count, channel) for runs of elements in [begin, end). Channels first runs share
+// one channel, channels last runs walk the channels starting from channel.
+template<bool channels_last, typename SpanFn>
+void ForEachChannelSpan(const ChannelLayout& layout, int64_t begin, int64_t end, SpanFn fn) {
+  const int64_t span_size = channels_last ? layout.channels : layout.inner;
+  int64_t offset = begin;
+  while (offset < end) {
+    const int64_t span_index = offset / span_size;
+    const int64_t span_end = std::min(end, (span_index + 1) * span_size);
+    const int64_t channel =
+        channels_last ? offset - span_index * span_size : span_index % layout.channels;
+    fn(offset, span_end - offset, channel);
+    offset = span_end;
   }
 }
 
-template<typename T>
-static void Normalize(const T* input_ptr, const T* mean_ptr, const T* variance_ptr,
-                      const T* gamma_ptr, const T* beta_ptr, T* output_ptr,
-                      const int64_t batch_size, const int64_t channel_size,
-                      const int64_t spatial_size, const float epsilon, const bool training) {
-  const T* temp_input_ptr = input_ptr;
-  T* temp_output_ptr = output_ptr;
-  const int64_t all_channels = batch_size * channel_size;
-  int64_t channel = -1;
-  for (int64_t ac = 0; ac < all_channels; ++ac) {
-    channel += 1;
-    if (channel >= channel_size) { channel = 0; }
-    T inv_variance = variance_ptr[channel];
-    if (!training) { inv_variance = 1.0f / std::sqrt(inv_variance + epsilon); }
-    const T gamma = gamma_ptr[channel] * inv_variance;
-    const T beta = beta_ptr[channel];
-    const T mean = mean_ptr[channel];
-    for (int64_t s = 0; s < spatial_size; ++s) {
-      temp_output_ptr[s] = (temp_input_ptr[s] - mean) * gamma + beta;
-    }
-    temp_input_ptr += spatial_size;
-    temp_output_ptr += spatial_size;
+// Two level reduction of two per channel sums. elem_fn(offset, channel, &first, &second) adds the
+// contribution of one element. The first level splits the outer dim into blocks and every task
+// owns the partial sums of one (block, channel) plane set, or of one block of channels last rows.
+// The second level sums the partials of each channel in parallel and calls
+// finish_fn(channel, first, second).
+template<bool channels_last, typename ElemFn, typename FinishFn>
+void ReduceChannelPairs(ep::CpuStream* stream, const ChannelLayout& layout, ElemFn elem_fn,
+                        FinishFn finish_fn) {
+  const int64_t channels = layout.channels;
+  const int64_t num_threads = stream->device()->GetNumThreads();
+  const int64_t num_blocks = std::max<int64_t>(
+      1, std::min<int64_t>(layout.outer, channels_last ? num_threads
+                                                       : CeilDiv(num_threads, channels)));
+  std::vector<StatType> partial_first(num_blocks * channels, 0);
+  std::vector<StatType> partial_second(num_blocks * channels, 0);
+  if (channels_last) {
+    stream->ParallelFor(
+        0, num_blocks,
+        [&](int64_t begin, int64_t end) {
+          for (int64_t block = begin; block < end; ++block) {
+            StatType* block_first = partial_first.data() + block * channels;
+            StatType* block_second = partial_second.data() + block * channels;
+            const int64_t row_begin = layout.outer * block / num_blocks;
+            const int64_t row_end = layout.outer * (block + 1) / num_blocks;
+            for (int64_t row = row_begin; row < row_end; ++row) {
+              const int64_t offset = row * channels;
+              for (int64_t c = 0; c < channels; ++c) {
+                elem_fn(offset + c, c, block_first + c, block_second + c);
+              }
+            }
+          }
+        },
+        1);
+  } else {
+    const int64_t plane_grain = std::max<int64_t>(
+        1, kParallelGrainElemCnt / std::max<int64_t>(layout.inner * layout.outer / num_blocks, 1));
+    stream->ParallelFor(
+        0, num_blocks * channels,
+        [&](int64_t begin, int64_t end) {
+          for (int64_t task = begin; task < end; ++task) {
+            const int64_t block = task / channels;
+            const int64_t c = task - block * channels;
+            const int64_t outer_begin = layout.outer * block / num_blocks;
+            const int64_t outer_end = layout.outer * (block + 1) / num_blocks;
+            const int64_t packed_inner = layout.inner / kLanes * kLanes;
+            StatType lane_first[kLanes] = {0};
+            StatType lane_second[kLanes] = {0};
+            for (int64_t o = outer_begin; o < outer_end; ++o) {
+              const int64_t offset = (o * channels + c) * layout.inner;
+              for (int64_t i = 0; i < packed_inner; i += kLanes) {
+                for (int32_t lane = 0; lane < kLanes; ++lane) {
+                  elem_fn(offset + i + lane, c, lane_first + lane, lane_second + lane);
+                }
+              }
+              for (int64_t i = packed_inner; i < layout.inner; ++i) {
+                elem_fn(offset + i, c, lane_first, lane_second);
+              }
+            }
+            for (int32_t lane = 0; lane < kLanes; ++lane) {
+              partial_first[task] += lane_first[lane];
+              partial_second[task] += lane_second[lane];
+            }
+          }
+        },
+        plane_grain);
   }
+  stream->ParallelFor(
+      0, channels,
+      [&](int64_t begin, int64_t end) {
+        for (int64_t c = begin; c < end; ++c) {
+          StatType first = 0;
+          StatType second = 0;
+          for (int64_t block = 0; block < num_blocks; ++block) {
+            first += partial_first[block * channels + c];
+            second += partial_second[block * channels + c];
+          }
+          finish_fn(c, first, second);
+        }
+      },
+      std::max<int64_t>(1, kParallelGrainElemCnt / num_blocks));
 }
 
-template<typename T>
-static void AddToOutput(const T* add_to_output_ptr, T* output_ptr, const int64_t elem_count) {
-  for (int64_t i = 0; i < elem_count; ++i) { output_ptr[i] += add_to_output_ptr[i]; }
+inline bool MaskBit(const int32_t* mask, int64_t offset) {
+  return (static_cast<uint32_t>(mask[offset / kMaskWordBits]) >> (offset % kMaskWordBits)) & 1U;
 }
 
-template<typename T>
-static void AddRelu(const T* addend_ptr, int32_t* mask_ptr, T* output_ptr, const int64_t elem_cnt) {
-  const int32_t step = 32;
-  const int64_t outer_loop = elem_cnt / step;
-  const int64_t remain_loop_start_idx = outer_loop * step;
-
-  T* temp_output_ptr = output_ptr;
-  for (int64_t outer = 0; outer < outer_loop; ++outer) {
-    int32_t mask = 0;
-    for (int32_t s = 0; s < step; ++s) {
-      const T sum = temp_output_ptr[s] + addend_ptr[s];
-      const bool is_positive = (sum > 0);
-      mask = mask | (static_cast<int32_t>(is_positive) << s);
-      temp_output_ptr[s] = is_positive ? sum : 0;
-    }
-    mask_ptr[outer] = mask;
-    addend_ptr += step;
-    temp_output_ptr += step;
-  }
-  if (remain_loop_start_idx < elem_cnt) {
-    int32_t mask_val = 0;
-    const int32_t remain = elem_cnt - remain_loop_start_idx;
-    for (int32_t i = 0; i < remain; ++i) {
-      const T sum = temp_output_ptr[i] + addend_ptr[i];
-      const bool is_positive = (sum > 0);
-      mask_val = mask_val | (static_cast<int32_t>(is_positive) << i);
-      temp_output_ptr[i] = is_positive ? sum : 0;
-    }
-    mask_ptr[outer_loop] = mask_val;
+// y = x * scale[c] + shift[c], optionally plus addend and followed by relu.
+template<typename T, bool channels_last, bool has_addend, bool fuse_relu>
+void AffineSpan(const T* x, const T* addend, const T* scale, const T* shift, int64_t offset,
+                int64_t count, int64_t channel, T* y) {
+  // NOTE: addend may alias y when _add_to_output is inplace, so the pointers are not restrict.
+  for (int64_t i = 0; i < count; ++i) {
+    const int64_t c = channels_last ? channel + i : channel;
+    T out = x[offset + i] * scale[c] + shift[c];
+    if (has_addend) { out += addend[offset + i]; }
+    if (fuse_relu) { out = out > 0 ? out : static_cast<T>(0); }
+    y[offset + i] = out;
   }
 }
 
-template<typename T>
-static void Relu(int32_t* mask_ptr, T* output_ptr, const int64_t elem_cnt) {
-  const int32_t step = 32;
-  const int64_t outer_loop = elem_cnt / step;
-  const int64_t remain_loop_start_idx = outer_loop * step;
-
-  T* temp_output_ptr = output_ptr;
-  for (int64_t outer = 0; outer < outer_loop; ++outer) {
-    int32_t mask_val = 0;
-    for (int32_t s = 0; s < step; ++s) {
-      const T output = temp_output_ptr[s];
-      const bool is_positive = (output > 0);
-      mask_val = mask_val | (static_cast<int32_t>(is_positive) << s);
-      temp_output_ptr[s] = is_positive ? output : 0;
-    }
-    mask_ptr[outer] = mask_val;
-    temp_output_ptr += step;
-  }
-  if (remain_loop_start_idx < elem_cnt) {
-    int32_t mask_val = 0;
-    const int32_t remain = elem_cnt - remain_loop_start_idx;
-    for (int32_t i = 0; i < remain; ++i) {
-      const T output = temp_output_ptr[i];
-      const bool is_positive = (output > 0);
-      mask_val = mask_val | (static_cast<int32_t>(is_positive) << i);
-      temp_output_ptr[i] = is_positive ? output : 0;
-    }
-    mask_ptr[outer_loop] = mask_val;
-  }
+// Normalizes, adds and rectifies in a single pass over x. The work is split at mask word
+// boundaries so that every mask word is written by exactly one task, and the words of a chunk are
+// packed from y while it is still in cache. y > 0 holds exactly when the sum before the relu is
+// positive, which is the bit the grad kernel expects.
+template<typename T, bool channels_last, bool has_addend, bool fuse_relu>
+void AffineForward(ep::CpuStream* stream, const ChannelLayout& layout, const T* x,
+                   const T* addend, const T* scale, const T* shift, T* y, int32_t* mask) {
+  const int64_t elem_cnt = layout.ElemCnt();
+  const int64_t num_words = CeilDiv(elem_cnt, kMaskWordBits);
+  const int64_t chunk_words = kMaskChunkElemCnt / kMaskWordBits;
+  stream->ParallelFor(
+      0, num_words,
+      [&](int64_t word_begin, int64_t word_end) {
+        for (int64_t chunk_begin = word_begin; chunk_begin < word_end;
+             chunk_begin += chunk_words) {
+          const int64_t chunk_end = std::min(word_end, chunk_begin + chunk_words);
+          const int64_t elem_begin = chunk_begin * kMaskWordBits;
+          const int64_t elem_end = std::min(elem_cnt, chunk_end * kMaskWordBits);
+          ForEachChannelSpan<channels_last>(
+              layout, elem_begin, elem_end, [&](int64_t offset, int64_t count, int64_t channel) {
+                AffineSpan<T, channels_last, has_addend, fuse_relu>(x, addend, scale, shift,
+                                                                    offset, count, channel, y);
+              });
+          if (fuse_relu) {
+            for (int64_t word = chunk_begin; word < chunk_end; ++word) {
+              const int64_t offset = word * kMaskWordBits;
+              const int64_t bits = std::min(kMaskWordBits, elem_cnt - offset);
+              uint32_t mask_val = 0;
+              for (int64_t bit = 0; bit < bits; ++bit) {
+                mask_val |= static_cast<uint32_t>(y[offset + bit] > 0) << bit;
+              }
+              mask[word] = static_cast<int32_t>(mask_val);
+            }
+          }
+        }
+      },
+      std::max<int64_t>(1, kParallelGrainElemCnt / kMaskWordBits));
 }
 
-template<typename T>
-static void AddReluGrad(const T* dy_ptr, const int32_t* mask_ptr, T* addend_diff_ptr,
-                        const int64_t elem_cnt) {
-  const int32_t step = 32;
-  const int64_t outer_loop = elem_cnt / step;
-  const int64_t remain_loop_start_idx = outer_loop * step;
-
-  for (int64_t outer = 0; outer < outer_loop; ++outer) {
-    const int32_t mask_val = mask_ptr[outer];
-    for (int32_t s = 0; s < step; ++s) {
-      bool is_positive = mask_val & (1 << s);
-      addend_diff_ptr[s] = static_cast<T>(is_positive) * dy_ptr[s];
+template<typename T, bool channels_last>
+void DispatchAffineForward(ep::CpuStream* stream, const ChannelLayout& layout, const T* x,
+                           const T* addend, const T* scale, const T* shift, T* y, int32_t* mask) {
+  if (mask != nullptr) {
+    if (addend != nullptr) {
+      AffineForward<T, channels_last, true, true>(stream, layout, x, addend, scale, shift, y,
+                                                  mask);
+    } else {
+      AffineForward<T, channels_last, false, true>(stream, layout, x, addend, scale, shift, y,
+                                                   mask);
     }
-    addend_diff_ptr += step;
-    dy_ptr += step;
-  }
-
-  if (remain_loop_start_idx < elem_cnt) {
-    const int32_t mask_val = mask_ptr[outer_loop];
-    const int32_t remain = elem_cnt - remain_loop_start_idx;
-    for (int32_t i = 0; i < remain; ++i) {
-      bool is_positive = mask_val & (1 << i);
-      addend_diff_ptr[i] = static_cast<T>(is_positive) * dy_ptr[i];
+  } else {
+    if (addend != nullptr) {
+      AffineForward<T, channels_last, true, false>(stream, layout, x, addend, scale, shift, y,
+                                                   mask);
+    } else {
+      AffineForward<T, channels_last, false, false>(stream, layout, x, addend, scale, shift, y,
+                                                    mask);
     }
   }
 }
 
+// Writes y = relu?(x * scale + shift + addend?) with per channel scale and shift, the mask is
+// produced only for normalization_add_relu.
 template<typename T>
-static void ReluGrad(const T* dy_ptr, const int32_t* mask_ptr, T* relu_dx_ptr,
-                     const int64_t elem_cnt) {
-  const int32_t step = 32;
-  const int64_t outer_loop = elem_cnt / step;
-  const int64_t remain_loop_start_idx = outer_loop * step;
-
-  for (int64_t outer = 0; outer < outer_loop; ++outer) {
-    const int32_t mask_val = mask_ptr[outer];
-    for (int32_t s = 0; s < step; ++s) {
-      bool is_positive = mask_val & (1 << s);
-      relu_dx_ptr[s] = static_cast<T>(is_positive) * dy_ptr[s];
-    }
-    relu_dx_ptr += step;
-    dy_ptr += step;
+void NormalizeCpu(ep::CpuStream* stream, const ChannelLayout& layout, const T* x, const T* addend,
+                  const T* scale, const T* shift, T* y, int32_t* mask) {
+  if (layout.inner == 1) {
+    DispatchAffineForward<T, true>(stream, layout, x, addend, scale, shift, y, mask);
+  } else {
+    DispatchAffineForward<T, false>(stream, layout, x, addend, scale, shift, y, mask);
   }
+}
 
-  if (remain_loop_start_idx < elem_cnt) {
-    const int32_t mask_val = mask_ptr[outer_loop];
-    const int32_t remain = elem_cnt - remain_loop_start_idx;
-    for (int32_t i = 0; i < remain; ++i) {
-      bool is_positive = mask_val & (1 << i);
-      relu_dx_ptr[i] = static_cast<T>(is_positive) * dy_ptr[i];
-    }
-  }
+// Computes mean and inv_variance of every channel and updates the moving statistics.
+template<typename T, bool channels_last>
+void ComputeMeanAndVar(ep::CpuStream* stream, const ChannelLayout& layout, const T* x, T* mean,
+                       T* inv_variance, T* moving_mean, T* moving_variance, float epsilon,
+                       float momentum) {
+  const int64_t reduce_count = layout.outer * layout.inner;
+  const StatType reduce_scale_factor = static_cast<StatType>(1) / reduce_count;
+  const StatType unbias_factor =
+      reduce_count > 1 ? static_cast<StatType>(reduce_count) / (reduce_count - 1) : 1;
+  const StatType exponential_average_factor = 1.0 - momentum;
+  ReduceChannelPairs<channels_last>(
+      stream, layout,
+      [x](int64_t offset, int64_t c, StatType* sum, StatType* sum_square) {
+        const StatType val = static_cast<StatType>(x[offset]);
+        *sum += val;
+        *sum_square += val * val;
+      },
+      [&](int64_t c, StatType sum, StatType sum_square) {
+        const StatType channel_mean = sum * reduce_scale_factor;
+        const StatType channel_variance =
+            std::max<StatType>(sum_square * reduce_scale_factor - channel_mean * channel_mean, 0);
+        mean[c] = static_cast<T>(channel_mean);
+        inv_variance[c] = static_cast<T>(1 / std::sqrt(channel_variance + epsilon));
+        if (moving_mean != nullptr && moving_variance != nullptr) {
+          moving_mean[c] = static_cast<T>(moving_mean[c] * momentum
+                                          + channel_mean * exponential_average_factor);
+          moving_variance[c] =
+              static_cast<T>(moving_variance[c] * momentum
+                             + channel_variance * unbias_factor * exponential_average_factor);
+        }
+      });
 }
 
-static size_t InferGradTmpSizeForCpuKernel(user_op::InferContext* ctx) {
-  const auto& dy = ctx->InputTensorDesc("dy", 0);
-  size_t tmp_size = 0;
-  if (ctx->op_type_name() == "normalization_add_relu_grad" && !ctx->has_output("addend_diff", 0)) {
-    tmp_size += dy.shape().elem_cnt() * GetSizeOfDataType(dy.data_type());
+// dx = dy' * iw[c] + x * x_scale[c] + bias[c] with dy' the dy passed through the relu mask, the
+// expansion of (dy' - mean(dy') - (x - mean) * k) * iw of the MXNet batch norm backward.
+template<typename T, bool channels_last, bool fuse_relu, bool has_addend_diff>
+void NormalizationGradSpan(const T* x, const T* dy, const int32_t* mask, const T* iw,
+                           const T* x_scale, const T* bias, int64_t offset, int64_t count,
+                           int64_t channel, T* dx, T* addend_diff) {
+  for (int64_t i = 0; i < count; ++i) {
+    const int64_t c = channels_last ? channel + i : channel;
+    T dy_val = dy[offset + i];
+    if (fuse_relu) { dy_val = MaskBit(mask, offset + i) ? dy_val : static_cast<T>(0); }
+    if (has_addend_diff) { addend_diff[offset + i] = dy_val; }
+    dx[offset + i] = dy_val * iw[c] + x[offset + i] * x_scale[c] + bias[c];
   }
-  return tmp_size;
 }
 
-// NOTE(Liang Depeng): helper functions to process datas for specific channel over all samples.
-template<typename T, typename DataProcessor>
-static inline void ForEachFast(const T* data, const int64_t batch_size, const int64_t spatial_size,
-                               const int64_t jump_step, const int64_t channel_idx,
-                               DataProcessor data_processor) {
-  const int64_t start_offset = channel_idx * spatial_size;
-  const T* tmp_data = data + start_offset;
-  for (int64_t outer = 0; outer < batch_size; ++outer) {
-    for (int64_t i = 0; i < spatial_size; ++i) { data_processor(&tmp_data[i]); }
-    tmp_data += jump_step;
-  }
+template<typename T, bool channels_last, bool fuse_relu, bool has_addend_diff>
+void NormalizationGradCpu(ep::CpuStream* stream, const ChannelLayout& layout, const T* x,
+                          const T* dy, const int32_t* mask, const T* gamma, const T* mean,
+                          const T* inv_variance, T* dx, T* addend_diff, T* gamma_diff,
+                          T* beta_diff) {
+  const int64_t channels = layout.channels;
+  const int64_t reduce_count = layout.outer * layout.inner;
+  std::vector<T> iw(channels);
+  std::vector<T> x_scale(channels);
+  std::vector<T> bias(channels);
+  // NOTE(Liang Depeng):
+  // Borrow the MXNet implementation to compute dx, gamma_diff and beta_diff.
+  // For more details pls refers to:
+  // https://github.com/apache/incubator-mxnet/blob/master/src/operator/nn/batch_norm.cc
+  ReduceChannelPairs<channels_last>(
+      stream, layout,
+      [=](int64_t offset, int64_t c, StatType* sum_dy, StatType* dotp) {
+        T dy_val = dy[offset];
+        if (fuse_relu) { dy_val = MaskBit(mask, offset) ? dy_val : static_cast<T>(0); }
+        *sum_dy += static_cast<StatType>(dy_val);
+        *dotp += static_cast<StatType>((x[offset] - mean[c]) * dy_val);
+      },
+      [&](int64_t c, StatType sum_dy, StatType dotp) {
+        const StatType inv_variance_c = static_cast<StatType>(inv_variance[c]);
+        const StatType mean_c = static_cast<StatType>(mean[c]);
+        // NOTE(Liang Depeng): projection of dy on to output scaled by std
+        const StatType k = dotp * inv_variance_c * inv_variance_c / reduce_count;
+        const StatType iw_c = inv_variance_c * static_cast<StatType>(gamma[c]);
+        const StatType grad_mean_c = sum_dy / reduce_count;
+        iw[c] = static_cast<T>(iw_c);
+        x_scale[c] = static_cast<T>(-k * iw_c);
+        bias[c] = static_cast<T>((mean_c * k - grad_mean_c) * iw_c);
+        gamma_diff[c] = static_cast<T>(dotp * inv_variance_c);
+        beta_diff[c] = static_cast<T>(sum_dy);
+      });
+  stream->ParallelFor(
+      0, layout.ElemCnt(),
+      [&](int64_t begin, int64_t end) {
+        ForEachChannelSpan<channels_last>(
+            layout, begin, end, [&](int64_t offset, int64_t count, int64_t channel) {
+              NormalizationGradSpan<T, channels_last, fuse_relu, has_addend_diff>(
+                  x, dy, mask, iw.data(), x_scale.data(), bias.data(), offset, count, channel, dx,
+                  addend_diff);
+            });
+      },
+      kParallelGrainElemCnt);
 }
 
-template<typename T, typename DataProcessor>
-static inline void ForEachFast(const T* in_data1, const T* in_data2, const int64_t batch_size,
-                               const int64_t spatial_size, const int64_t jump_step,
-                               const int64_t channel_idx, DataProcessor data_processor) {
-  const int64_t start_offset = channel_idx * spatial_size;
-  const T* tmp_in_data1 = in_data1 + start_offset;
-  const T* tmp_in_data2 = in_data2 + start_offset;
-  for (int64_t outer = 0; outer < batch_size; ++outer) {
-    for (int64_t i = 0; i < spatial_size; ++i) {
-      data_processor(&tmp_in_data1[i], &tmp_in_data2[i]);
-    }
-    tmp_in_data1 += jump_step;
-    tmp_in_data2 += jump_step;
+template<typename T, bool channels_last>
+void DispatchNormalizationGradCpu(ep::CpuStream* stream, const ChannelLayout& layout, const T* x,
+                                  const T* dy, const int32_t* mask, const T* gamma, const T* mean,
+                                  const T* inv_variance, T* dx, T* addend_diff, T* gamma_diff,
+                                  T* beta_diff) {
+  if (mask == nullptr) {
+    NormalizationGradCpu<T, channels_last, false, false>(stream, layout, x, dy, mask, gamma, mean,
+                                                         inv_variance, dx, addend_diff,
+                                                         gamma_diff, beta_diff);
+  } else if (addend_diff == nullptr) {
+    NormalizationGradCpu<T, channels_last, true, false>(stream, layout, x, dy, mask, gamma, mean,
+                                                        inv_variance, dx, addend_diff, gamma_diff,
+                                                        beta_diff);
+  } else {
+    NormalizationGradCpu<T, channels_last, true, true>(stream, layout, x, dy, mask, gamma, mean,
+                                                       inv_variance, dx, addend_diff, gamma_diff,
+                                                       beta_diff);
   }
 }
 
-template<typename T, typename DataProcessor>
-static inline void ForEachFast(const T* in_data, T* out_data, const int64_t batch_size,
-                               const int64_t spatial_size, const int64_t jump_step,
-                               const int64_t channel_idx, DataProcessor data_processor) {
-  const int64_t start_offset = channel_idx * spatial_size;
-  const T* tmp_in_data = in_data + start_offset;
-  T* tmp_out_data = out_data + start_offset;
-  for (int64_t outer = 0; outer < batch_size; ++outer) {
-    for (int64_t i = 0; i < spatial_size; ++i) {
-      data_processor(&tmp_in_data[i], &tmp_out_data[i]);
-    }
-    tmp_in_data += jump_step;
-    tmp_out_data += jump_step;
+template<typename T>
+void ComputeMeanAndVarCpu(ep::CpuStream* stream, const ChannelLayout& layout, const T* x, T* mean,
+                          T* inv_variance, T* moving_mean, T* moving_variance, float epsilon,
+                          float momentum) {
+  if (layout.inner == 1) {
+    ComputeMeanAndVar<T, true>(stream, layout, x, mean, inv_variance, moving_mean,
+                               moving_variance, epsilon, momentum);
+  } else {
+    ComputeMeanAndVar<T, false>(stream, layout, x, mean, inv_variance, moving_mean,
+                                moving_variance, epsilon, momentum);
   }
 }
 
+}  // namespace
+
 template<typename T>
 class NormalizationInferenceCpuKernel final : public user_op::OpKernel {
  public:
@@ -291,37 +401,30 @@ class NormalizationInferenceCpuKernel final : public user_op::OpKernel {
     const DataType data_type = x->data_type();
     CHECK_EQ(x->shape_view(), y->shape_view());
     CHECK_EQ(y->data_type(), data_type);
-    CHECK_GE(axis, 0);
-    CHECK_LT(axis, x->shape_view().NumAxes());
-
-    if (axis == 1) {  // NOTE(Liang Depeng): NCHW format
-      const T* input_ptr = x->dptr<T>();
-      const T* gamma_ptr = gamma->dptr<T>();
-      const T* beta_ptr = beta->dptr<T>();
-
-      T* output_ptr = y->mut_dptr<T>();
-      T* moving_mean_ptr = moving_mean->mut_dptr<T>();
-      T* moving_variance_ptr = moving_variance->mut_dptr<T>();
-
-      const int64_t batch_size = x->shape_view().At(0);
-      const int64_t channel_size = x->shape_view().At(axis);
-      const int64_t spatial_size = x->shape_view().Count(axis + 1);
-
-      // NOTE(Liang Depeng):
-      // compute the normalization result
-      Normalize(input_ptr, moving_mean_ptr, moving_variance_ptr, gamma_ptr, beta_ptr, output_ptr,
-                batch_size, channel_size, spatial_size, epsilon, false);
-
-      if (ctx->has_input("_add_to_output", 0)) {
-        const user_op::Tensor* add_to_output = ctx->Tensor4ArgNameAndIndex("_add_to_output", 0);
-        CHECK_EQ(add_to_output->data_type(), y->data_type());
-        CHECK_EQ(add_to_output->shape_view(), y->shape_view());
-        AddToOutput(add_to_output->dptr<T>(), output_ptr, x->shape_view().elem_cnt());
-      }
+    const ChannelLayout layout = MakeChannelLayout(x->shape_view(), axis);
+
+    const T* addend_ptr = nullptr;
+    if (ctx->has_input("_add_to_output", 0)) {
+      const user_op::Tensor* add_to_output = ctx->Tensor4ArgNameAndIndex("_add_to_output", 0);
+      CHECK_EQ(add_to_output->data_type(), y->data_type());
+      CHECK_EQ(add_to_output->shape_view(), y->shape_view());
+      addend_ptr = add_to_output->dptr<T>();
+    }
 
-    } else {  // TODO(Liang Depeng): NHWC format
-      UNIMPLEMENTED() << "cpu normalization op only support nchw data_format now!";
+    // NOTE: inference folds the moving statistics into a per channel scale and shift, the
+    // normalization is then a single fused pass over x.
+    const T* gamma_ptr = gamma->dptr<T>();
+    const T* beta_ptr = beta->dptr<T>();
+    const T* moving_mean_ptr = moving_mean->dptr<T>();
+    const T* moving_variance_ptr = moving_variance->dptr<T>();
+    std::vector<T> scale(layout.channels);
+    std::vector<T> shift(layout.channels);
+    for (int64_t c = 0; c < layout.channels; ++c) {
+      scale[c] = gamma_ptr[c] / std::sqrt(moving_variance_ptr[c] + static_cast<T>(epsilon));
+      shift[c] = beta_ptr[c] - moving_mean_ptr[c] * scale[c];
     }
+    NormalizeCpu<T>(ctx->stream()->As<ep::CpuStream>(), layout, x->dptr<T>(), addend_ptr,
+                    scale.data(), shift.data(), y->mut_dptr<T>(), nullptr);
   }
 
   bool AlwaysComputeWhenAllOutputsEmpty() const override { return false; }
@@ -367,73 +470,57 @@ class NormalizationTrainCpuKernel final : public user_op::OpKernel {
     const DataType data_type = x->data_type();
     CHECK_EQ(x->shape_view(), y->shape_view());
     CHECK_EQ(y->data_type(), data_type);
-    CHECK_GE(axis, 0);
-    CHECK_LT(axis, x->shape_view().NumAxes());
+    const ChannelLayout layout = MakeChannelLayout(x->shape_view(), axis);
 
     const auto* gamma = ctx->Tensor4ArgNameAndIndex("gamma", 0);
     const auto* beta = ctx->Tensor4ArgNameAndIndex("beta", 0);
     auto* mean = ctx->Tensor4ArgNameAndIndex("mean", 0);
     auto* inv_variance = ctx->Tensor4ArgNameAndIndex("inv_variance", 0);
 
-    user_op::Tensor* moving_mean = nullptr;
-    user_op::Tensor* moving_variance = nullptr;
+    T* moving_mean_ptr = nullptr;
+    T* moving_variance_ptr = nullptr;
     if (ctx->has_input("moving_mean", 0)) {
       CHECK(ctx->has_input("moving_variance", 0));
-      moving_mean = ctx->Tensor4ArgNameAndIndex("moving_mean", 0);
-      moving_variance = ctx->Tensor4ArgNameAndIndex("moving_variance", 0);
+      moving_mean_ptr = ctx->Tensor4ArgNameAndIndex("moving_mean", 0)->mut_dptr<T>();
+      moving_variance_ptr = ctx->Tensor4ArgNameAndIndex("moving_variance", 0)->mut_dptr<T>();
     }
 
-    if (axis == 1) {  // NOTE(Liang Depeng): NCHW format
-      const T* input_ptr = x->dptr<T>();
-      const T* gamma_ptr = gamma->dptr<T>();
-      const T* beta_ptr = beta->dptr<T>();
-
-      T* output_ptr = y->mut_dptr<T>();
-      T* mean_ptr = mean->mut_dptr<T>();
-      T* inv_variance_ptr = inv_variance->mut_dptr<T>();
-
-      T* moving_mean_ptr = nullptr;
-      T* moving_variance_ptr = nullptr;
-      if (moving_mean != nullptr && moving_variance != nullptr) {
-        moving_mean_ptr = moving_mean->mut_dptr<T>();
-        moving_variance_ptr = moving_variance->mut_dptr<T>();
-      }
-
-      const int64_t batch_size = x->shape_view().At(0);
-      const int64_t channel_size = x->shape_view().At(axis);
-      const int64_t spatial_size = x->shape_view().Count(axis + 1);
-
-      // NOTE(Liang Depeng):
-      // Compute mean & inv_variance and update moving_mean & moving_variance for each channel.
-      ComputeMeanAndVar(input_ptr, mean_ptr, inv_variance_ptr, moving_mean_ptr, moving_variance_ptr,
-                        batch_size, channel_size, spatial_size, epsilon, momentum);
-
-      // NOTE(Liang Depeng):
-      // compute the normalization result
-      Normalize(input_ptr, mean_ptr, inv_variance_ptr, gamma_ptr, beta_ptr, output_ptr, batch_size,
-                channel_size, spatial_size, epsilon, true);
-
-      if (ctx->has_input("_add_to_output", 0)) {
-        const user_op::Tensor* add_to_output = ctx->Tensor4ArgNameAndIndex("_add_to_output", 0);
-        CHECK_EQ(add_to_output->data_type(), y->data_type());
-        CHECK_EQ(add_to_output->shape_view(), y->shape_view());
-        AddToOutput(add_to_output->dptr<T>(), output_ptr, x->shape_view().elem_cnt());
+    const T* addend_ptr = nullptr;
+    if (ctx->has_input("_add_to_output", 0)) {
+      const user_op::Tensor* add_to_output = ctx->Tensor4ArgNameAndIndex("_add_to_output", 0);
+      CHECK_EQ(add_to_output->data_type(), y->data_type());
+      CHECK_EQ(add_to_output->shape_view(), y->shape_view());
+      addend_ptr = add_to_output->dptr<T>();
+    }
+    int32_t* mask_ptr = nullptr;
+    if (ctx->op_type_name() == "normalization_add_relu") {
+      CHECK(!ctx->has_input("_add_to_output", 0));
+      mask_ptr = ctx->Tensor4ArgNameAndIndex("reserve_space", 0)->mut_dptr<int32_t>();
+      if (ctx->has_input("addend", 0)) {
+        addend_ptr = ctx->Tensor4ArgNameAndIndex("addend", 0)->dptr<T>();
       }
+    }
 
-      if (ctx->op_type_name() == "normalization_add_relu") {
-        CHECK(!ctx->has_input("_add_to_output", 0));
-        auto* mask = ctx->Tensor4ArgNameAndIndex("reserve_space", 0);
-
-        if (ctx->has_input("addend", 0)) {
-          const auto* addend = ctx->Tensor4ArgNameAndIndex("addend", 0);
-          AddRelu(addend->dptr<T>(), mask->mut_dptr<int32_t>(), output_ptr,
-                  x->shape_view().elem_cnt());
-        } else {
-          Relu(mask->mut_dptr<int32_t>(), output_ptr, x->shape_view().elem_cnt());
-        }
-      }
-    } else {  // TODO(Liang Depeng): NHWC format
+    auto* stream = ctx->stream()->As<ep::CpuStream>();
+    T* mean_ptr = mean->mut_dptr<T>();
+    T* inv_variance_ptr = inv_variance->mut_dptr<T>();
+    // NOTE(Liang Depeng):
+    // Compute mean & inv_variance and update moving_mean & moving_variance for each channel.
+    ComputeMeanAndVarCpu<T>(stream, layout, x->dptr<T>(), mean_ptr, inv_variance_ptr,
+                            moving_mean_ptr, moving_variance_ptr, epsilon, momentum);
+
+    // NOTE(Liang Depeng):
+    // compute the normalization result, the addend and the relu are fused into the same pass
+    const T* gamma_ptr = gamma->dptr<T>();
+    const T* beta_ptr = beta->dptr<T>();
+    std::vector<T> scale(layout.channels);
+    std::vector<T> shift(layout.channels);
+    for (int64_t c = 0; c < layout.channels; ++c) {
+      scale[c] = gamma_ptr[c] * inv_variance_ptr[c];
+      shift[c] = beta_ptr[c] - mean_ptr[c] * scale[c];
     }
+    NormalizeCpu<T>(stream, layout, x->dptr<T>(), addend_ptr, scale.data(), shift.data(),
+                    y->mut_dptr<T>(), mask_ptr);
   }
 
   bool AlwaysComputeWhenAllOutputsEmpty() const override { return false; }
@@ -487,7 +574,6 @@ class NormalizationGradCpuKernel final : public user_op::OpKernel {
     auto* beta_diff = ctx->Tensor4ArgNameAndIndex("beta_diff", 0);
     const auto* mean = ctx->Tensor4ArgNameAndIndex("mean", 0);
     const auto* inv_variance = ctx->Tensor4ArgNameAndIndex("inv_variance", 0);
-    auto* tmp_buffer = ctx->Tensor4ArgNameAndIndex("tmp_buffer", 0);
     const auto axis = ctx->Attr<int32_t>("axis");
 
     const DataType data_type = x->data_type();
@@ -495,84 +581,32 @@ class NormalizationGradCpuKernel final : public user_op::OpKernel {
     CHECK_EQ(dy->data_type(), data_type);
     CHECK_EQ(dx->shape_view(), x->shape_view());
     CHECK_EQ(dx->data_type(), data_type);
-    CHECK_GE(axis, 0);
-    CHECK_LT(axis, x->shape_view().NumAxes());
-
-    const T* dy_ptr = nullptr;
-    if (ctx->op_type_name() == "normalization_grad") {
-      dy_ptr = dy->dptr<T>();
-    } else if (ctx->op_type_name() == "normalization_add_relu_grad") {
-      const auto* mask = ctx->Tensor4ArgNameAndIndex("reserve_space", 0);
+    const ChannelLayout layout = MakeChannelLayout(x->shape_view(), axis);
+
+    // NOTE: the relu grad of normalization_add_relu is applied on the fly from the mask bits, dy
+    // is never materialized after the relu.
+    const int32_t* mask_ptr = nullptr;
+    T* addend_diff_ptr = nullptr;
+    if (ctx->op_type_name() == "normalization_add_relu_grad") {
+      mask_ptr = ctx->Tensor4ArgNameAndIndex("reserve_space", 0)->dptr<int32_t>();
       if (ctx->has_output("addend_diff", 0)) {
-        user_op::Tensor* addend_diff = ctx->Tensor4ArgNameAndIndex("addend_diff", 0);
-        AddReluGrad(dy->dptr<T>(), mask->dptr<int32_t>(), addend_diff->mut_dptr<T>(),
-                    dy->shape_view().elem_cnt());
-        dy_ptr = addend_diff->dptr<T>();
-      } else {
-        ReluGrad(dy->dptr<T>(), mask->dptr<int32_t>(), tmp_buffer->mut_dptr<T>(),
-                 dy->shape_view().elem_cnt());
-        dy_ptr = tmp_buffer->dptr<T>();
+        addend_diff_ptr = ctx->Tensor4ArgNameAndIndex("addend_diff", 0)->mut_dptr<T>();
       }
-
     } else {
-      UNIMPLEMENTED();
+      CHECK_EQ(ctx->op_type_name(), "normalization_grad");
     }
 
-    if (axis == 1) {  // NOTE(Liang Depeng): NCHW format
-      const T* x_ptr = x->dptr<T>();
-      const T* gamma_ptr = gamma->dptr<T>();
-      const T* mean_ptr = mean->dptr<T>();
-      const T* inv_variance_ptr = inv_variance->dptr<T>();
-
-      T* dx_ptr = dx->mut_dptr<T>();
-      T* gamma_diff_ptr = gamma_diff->mut_dptr<T>();
-      T* beta_diff_ptr = beta_diff->mut_dptr<T>();
-
-      const int64_t batch_size = x->shape_view().At(0);
-      const int64_t channel_size = x->shape_view().At(axis);
-      const int64_t spatial_size = x->shape_view().Count(axis + 1);
-      const int64_t jump_step = spatial_size * channel_size;
-      const int64_t reduce_count = batch_size * spatial_size;
-
-      // NOTE(Liang Depeng):
-      // Borrow the MXNet implementation to compute dx, gamma_diff and beta_diff.
-      // For more details pls refers to:
-      // https://github.com/apache/incubator-mxnet/blob/master/src/operator/nn/batch_norm.cc
-      for (int64_t channel = 0; channel < channel_size; ++channel) {
-        const T gamma_c = gamma_ptr[channel];
-        const T mean_c = mean_ptr[channel];
-        const T inv_variance_c = inv_variance_ptr[channel];
-
-        // NOTE(Liang Depeng): sum dy for specific channel over all samples
-        T sum_dy_out = 0;
-        ForEachFast(dy_ptr, batch_size, spatial_size, jump_step, channel,
-                    [&sum_dy_out](const T* dy_data) { sum_dy_out += *dy_data; });
-
-        // NOTE(Liang Depeng): dot product of the x and dy
-        T dotp = 0;
-        ForEachFast(x_ptr, dy_ptr, batch_size, spatial_size, jump_step, channel,
-                    [&dotp, mean_c](const T* x_data, const T* dy_data) {
-                      dotp += (*x_data - mean_c) * (*dy_data);
-                    });
-
-        // NOTE(Liang Depeng): projection of dy on to output scaled by std
-        const T k = dotp * inv_variance_c * inv_variance_c / reduce_count;
-        const T iw = inv_variance_c * gamma_c;
-        const T grad_mean_c = sum_dy_out / reduce_count;
-        ForEachFast(
-            x_ptr, dx_ptr, batch_size, spatial_size, jump_step, channel,
-            [&mean_c, &k](const T* x_data, T* dx_data) { *dx_data = (*x_data - mean_c) * k; });
-
-        ForEachFast(dy_ptr, dx_ptr, batch_size, spatial_size, jump_step, channel,
-                    [iw, grad_mean_c](const T* dy_data, T* dx_data) {
-                      *dx_data = (*dy_data - grad_mean_c - *dx_data) * iw;
-                    });
-
-        gamma_diff_ptr[channel] = dotp * inv_variance_c;
-        beta_diff_ptr[channel] = sum_dy_out;
-      }
-
-    } else {  // TODO(Liang Depeng): NHWC format
+    auto* stream = ctx->stream()->As<ep::CpuStream>();
+    if (layout.inner == 1) {
+      DispatchNormalizationGradCpu<T, true>(
+          stream, layout, x->dptr<T>(), dy->dptr<T>(), mask_ptr, gamma->dptr<T>(),
+          mean->dptr<T>(), inv_variance->dptr<T>(), dx->mut_dptr<T>(), addend_diff_ptr,
+          gamma_diff->mut_dptr<T>(), beta_diff->mut_dptr<T>());
+    } else {
+      DispatchNormalizationGradCpu<T, false>(
+          stream, layout, x->dptr<T>(), dy->dptr<T>(), mask_ptr, gamma->dptr<T>(),
+          mean->dptr<T>(), inv_variance->dptr<T>(), dx->mut_dptr<T>(), addend_diff_ptr,
+          gamma_diff->mut_dptr<T>(), beta_diff->mut_dptr<T>());
     }
   }
 
@@ -590,12 +624,11 @@ REGISTER_BN_GRAD_CPU_KERNEL(double)
 
 #undef REGISTER_BN_GRAD_CPU_KERNEL
 
-#define REGISTER_BN_ADD_RELU_GRAD_CPU_KERNEL(dtype)                                     \
-  REGISTER_USER_KERNEL("normalization_add_relu_grad")                                   \
-      .SetCreateFn<NormalizationGradCpuKernel<dtype>>()                                 \
-      .SetIsMatchedHob((user_op::HobDeviceType() == DeviceType::kCPU)                   \
-                       && (user_op::HobDataType("dx", 0) == GetDataType<dtype>::value)) \
-      .SetInferTmpSizeFn(InferGradTmpSizeForCpuKernel);
+#define REGISTER_BN_ADD_RELU_GRAD_CPU_KERNEL(dtype)                   \
+  REGISTER_USER_KERNEL("normalization_add_relu_grad")                 \
+      .SetCreateFn<NormalizationGradCpuKernel<dtype>>()               \
+      .SetIsMatchedHob((user_op::HobDeviceType() == DeviceType::kCPU) \
+                       && (user_op::HobDataType("dx", 0) == GetDataType<dtype>::value));
 
 REGISTER_BN_ADD_RELU_GRAD_CPU_KERNEL(float)
 REGISTER_BN_ADD_RELU_GRAD_CPU_KERNEL(double)
@@ -0,0 +1,370 @@
+/*
+Copyright 2020 The OneFlow Authors. All rights reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+#include "oneflow/user/kernels/pool_cpu_kernel_util.h"
+#include "oneflow/core/kernel/util/numerics.cuh"
+#include "oneflow/core/kernel/util/numeric_limits.cuh"
+
+namespace oneflow {
+
+namespace {
+
+// Number of window reads handed to one task of ParallelFor.
+constexpr int64_t kWorkPerTask = 32768;
+// Number of channels owned by one task of the channels last backward kernels.
+constexpr int64_t kChannelBlockSize = 64;
+
+int64_t CeilDiv(int64_t a, int64_t b) { return (a + b - 1) / b; }
+
+int64_t GrainSize(int64_t work_per_item) {
+  return std::max<int64_t>(kWorkPerTask / std::max<int64_t>(work_per_item, 1), 1);
+}
+
+int64_t WindowVolume(const PoolCpuProblem& p) {
+  int64_t volume = 1;
+  for (int d = 0; d < 3; ++d) {
+    volume *= p.adaptive ? CeilDiv(p.in_size[d], p.out_size[d]) + 1 : p.kernel_size[d];
+  }
+  return volume;
+}
+
+// [begin, end) with a stride of the dilation rate is the part of the window of an output position
+// that falls into the image along one dim, padded_size is the window size counting the padding.
+struct PoolWindow {
+  int64_t begin;
+  int64_t end;
+  int64_t padded_size;
+};
+
+// The windows of all the output positions along each dim, computed once per launch so that the
+// inner loops only do lookups.
+class PoolWindows final {
+ public:
+  OF_DISALLOW_COPY_AND_MOVE(PoolWindows);
+  explicit PoolWindows(const PoolCpuProblem& p) : problem_(p) {
+    for (int d = 0; d < 3; ++d) {
+      step_[d] = p.adaptive ? 1 : p.dilation_rate[d];
+      windows_[d].resize(p.out_size[d]);
+      for (int64_t o = 0; o < p.out_size[d]; ++o) {
+        PoolWindow* window = &windows_[d][o];
+        if (p.adaptive) {
+          // Same rounding as start_index and end_index of adaptive_pool_kernel_util.h.
+          window->begin = static_cast<int64_t>(
+              std::floor(static_cast<float>(o * p.in_size[d]) / p.out_size[d]));
+          window->end = static_cast<int64_t>(
+              std::ceil(static_cast<float>((o + 1) * p.in_size[d]) / p.out_size[d]));
+          window->padded_size = window->end - window->begin;
+        } else {
+          const int64_t start = o * p.strides[d] - p.padding_before[d];
+          const int64_t stop = start + (p.kernel_size[d] - 1) * step_[d] + 1;
+          window->padded_size = std::min<int64_t>(stop, p.in_size[d] + p.padding_before[d]) - start;
+          window->begin = start < 0 ? start + CeilDiv(-start, step_[d]) * step_[d] : start;
+          window->end = std::min<int64_t>(stop, p.in_size[d]);
+        }
+      }
+    }
+  }
+  ~PoolWindows() = default;
+
+  // Offset in the image of the first position of the window at (od, oh, ow).
+  int64_t FirstPos(int64_t od, int64_t oh, int64_t ow) const {
+    return (windows_[0][od].begin * problem_.in_size[1] + windows_[1][oh].begin)
+               * problem_.in_size[2]
+           + windows_[2][ow].begin;
+  }
+
+  int64_t AvgDivisor(int64_t od, int64_t oh, int64_t ow, bool count_include_pad,
+                     int32_t divisor_override) const {
+    if (divisor_override != 0) { return divisor_override; }
+    const PoolWindow& wd = windows_[0][od];
+    const PoolWindow& wh = windows_[1][oh];
+    const PoolWindow& ww = windows_[2][ow];
+    if (count_include_pad) { return wd.padded_size * wh.padded_size * ww.padded_size; }
+    return (wd.end - wd.begin) * (wh.end - wh.begin) * (ww.end - ww.begin);
+  }
+
+  // Calls fn with the offset in the image of every position of the window at (od, oh, ow).
+  template<typename F>
+  void ForEachPos(int64_t od, int64_t oh, int64_t ow, const F& fn) const {
+    const PoolWindow& wd = windows_[0][od];
+    const PoolWindow& wh = windows_[1][oh];
+    const PoolWindow& ww = windows_[2][ow];
+    for (int64_t id = wd.begin; id < wd.end; id += step_[0]) {
+      for (int64_t ih = wh.begin; ih < wh.end; ih += step_[1]) {
+        const int64_t row = (id * problem_.in_size[1] + ih) * problem_.in_size[2];
+        for (int64_t iw = ww.begin; iw < ww.end; iw += step_[2]) { fn(row + iw); }
+      }
+    }
+  }
+
+  // Calls fn(od, oh, ow, out_pos) for every output position of an image.
+  template<typename F>
+  void ForEachOutPos(const F& fn) const {
+    int64_t out_pos = 0;
+    for (int64_t od = 0; od < problem_.out_size[0]; ++od) {
+      for (int64_t oh = 0; oh < problem_.out_size[1]; ++oh) {
+        for (int64_t ow = 0; ow < problem_.out_size[2]; ++ow) { fn(od, oh, ow, out_pos++); }
+      }
+    }
+  }
+
+ private:
+  const PoolCpuProblem& problem_;
+  std::vector<PoolWindow> windows_[3];
+  int64_t step_[3];
+};
+
+template<typename T>
+bool TakeAsMax(T val, T max_value) {
+  return val > max_value || detail::numerics<T>::isnan(val);
+}
+
+// Calls fn(od, oh, x_image_offset, y_row_offset) for the (n, od, oh) output rows of the channels
+// last forward kernels, the offsets are in units of elements.
+template<typename F>
+void ParallelForEachOutRow(ep::CpuStream* stream, const PoolCpuProblem& p, const F& fn) {
+  const int64_t num_rows = p.batch_size * p.out_size[0] * p.out_size[1];
+  stream->ParallelFor(
+      0, num_rows,
+      [&](int64_t begin, int64_t end) {
+        for (int64_t row = begin; row < end; ++row) {
+          const int64_t oh = row % p.out_size[1];
+          const int64_t od = row / p.out_size[1] % p.out_size[0];
+          const int64_t n = row / p.out_size[1] / p.out_size[0];
+          fn(od, oh, n * p.InSpatialSize() * p.channels, row * p.out_size[2] * p.channels);
+        }
+      },
+      GrainSize(p.out_size[2] * p.channels * WindowVolume(p)));
+}
+
+// Calls fn(n, c_begin, c_end) for the (n, channel block) pairs of the channels last backward
+// kernels.
+template<typename F>
+void ParallelForEachChannelBlock(ep::CpuStream* stream, const PoolCpuProblem& p, const F& fn) {
+  const int64_t num_blocks = CeilDiv(p.channels, kChannelBlockSize);
+  stream->ParallelFor(
+      0, p.batch_size * num_blocks,
+      [&](int64_t begin, int64_t end) {
+        for (int64_t i = begin; i < end; ++i) {
+          const int64_t c_begin = i % num_blocks * kChannelBlockSize;
+          fn(i / num_blocks, c_begin, std::min(c_begin + kChannelBlockSize, p.channels));
+        }
+      },
+      GrainSize(p.OutSpatialSize() * std::min(p.channels, kChannelBlockSize) * WindowVolume(p)));
+}
+
+// Calls fn(x_image_offset, y_image_offset) for the (n, c) images of the channels first kernels, in
+// units of elements.
+template<typename F>
+void ParallelForEachImage(ep::CpuStream* stream, const PoolCpuProblem& p, const F& fn) {
+  stream->ParallelFor(
+      0, p.batch_size * p.channels,
+      [&](int64_t begin, int64_t end) {
+        for (int64_t i = begin; i < end; ++i) {
+          fn(i * p.InSpatialSize(), i * p.OutSpatialSize());
+        }
+      },
+      GrainSize(p.OutSpatialSize() * WindowVolume(p)));
+}
+
+}  // namespace
+
+PoolCpuProblem MakePoolCpuProblem(bool channels_last, const ShapeView& in_5d_shape,
+                                  const ShapeView& out_5d_shape, const int32_t* kernel_size,
+                                  const int32_t* strides, const int32_t* dilation_rate,
+                                  const int32_t* padding_before) {
+  CHECK_EQ(in_5d_shape.NumAxes(), 5);
+  CHECK_EQ(out_5d_shape.NumAxes(), 5);
+  PoolCpuProblem problem;
+  problem.channels_last = channels_last;
+  problem.batch_size = in_5d_shape.At(0);
+  problem.channels = in_5d_shape.At(1);
+  for (int d = 0; d < 3; ++d) {
+    problem.in_size[d] = in_5d_shape.At(2 + d);
+    problem.out_size[d] = out_5d_shape.At(2 + d);
+    problem.kernel_size[d] = kernel_size[d];
+    problem.strides[d] = strides[d];
+    problem.dilation_rate[d] = dilation_rate == nullptr ? 1 : dilation_rate[d];
+    problem.padding_before[d] = padding_before[d];
+  }
+  return problem;
+}
+
+PoolCpuProblem MakeAdaptivePoolCpuProblem(const ShapeView& in_5d_shape,
+                                          const ShapeView& out_5d_shape) {
+  CHECK_EQ(in_5d_shape.NumAxes(), 5);
+  CHECK_EQ(out_5d_shape.NumAxes(), 5);
+  PoolCpuProblem problem;
+  problem.adaptive = true;
+  problem.batch_size = in_5d_shape.At(0);
+  problem.channels = in_5d_shape.At(1);
+  for (int d = 0; d < 3; ++d) {
+    problem.in_size[d] = in_5d_shape.At(2 + d);
+    problem.out_size[d] = out_5d_shape.At(2 + d);
+  }
+  return problem;
+}
+
+template<typename T>
+void PoolCpuKernelUtil<T>::MaxForward(ep::CpuStream* stream, const PoolCpuProblem& problem,
+                                      const T* x, T* y, int64_t* indice) {
+  const PoolWindows windows(problem);
+  if (problem.channels_last) {
+    const int64_t channels = problem.channels;
+    ParallelForEachOutRow(stream, problem, [&](int64_t od, int64_t oh, int64_t x_offset,
+                                               int64_t y_offset) {
+      const T* x_image = x + x_offset;
+      for (int64_t ow = 0; ow < problem.out_size[2]; ++ow) {
+        T* __restrict__ y_pos = y + y_offset + ow * channels;
+        int64_t* __restrict__ indice_pos = indice + y_offset + ow * channels;
+        const int64_t first_offset = windows.FirstPos(od, oh, ow) * channels;
+        for (int64_t c = 0; c < channels; ++c) {
+          y_pos[c] = detail::numeric_limits<T>::lower_bound();
+          indice_pos[c] = first_offset + c;
+        }
+        windows.ForEachPos(od, oh, ow, [&](int64_t pos) {
+          const int64_t pos_offset = pos * channels;
+          const T* __restrict__ x_pos = x_image + pos_offset;
+          for (int64_t c = 0; c < channels; ++c) {
+            const T val = x_pos[c];
+            const bool take = TakeAsMax(val, y_pos[c]);
+            y_pos[c] = take ? val : y_pos[c];
+            indice_pos[c] = take ? pos_offset + c : indice_pos[c];
+          }
+        });
+      }
+    });
+  } else {
+    ParallelForEachImage(stream, problem, [&](int64_t x_offset, int64_t y_offset) {
+      const T* x_image = x + x_offset;
+      windows.ForEachOutPos([&](int64_t od, int64_t oh, int64_t ow, int64_t out_pos) {
+        T max_value = detail::numeric_limits<T>::lower_bound();
+        int64_t max_index = windows.FirstPos(od, oh, ow);
+        windows.ForEachPos(od, oh, ow, [&](int64_t pos) {
+          const T val = x_image[pos];
+          if (TakeAsMax(val, max_value)) {
+            max_value = val;
+            max_index = pos;
+          }
+        });
+        y[y_offset + out_pos] = max_value;
+        indice[y_offset + out_pos] = max_index;
+      });
+    });
+  }
+}
+
+template<typename T>
+void PoolCpuKernelUtil<T>::MaxBackward(ep::CpuStream* stream, const PoolCpuProblem& problem,
+                                       const T* dy, const int64_t* indice, T* dx) {
+  const int64_t out_image_size = problem.OutSpatialSize();
+  if (problem.channels_last) {
+    const int64_t channels = problem.channels;
+    ParallelForEachChannelBlock(stream, problem, [&](int64_t n, int64_t c_begin, int64_t c_end) {
+      T* dx_image = dx + n * problem.InSpatialSize() * channels;
+      for (int64_t out_pos = 0; out_pos < out_image_size; ++out_pos) {
+        const int64_t offset = (n * out_image_size + out_pos) * channels;
+        for (int64_t c = c_begin; c < c_end; ++c) {
+          dx_image[indice[offset + c]] += dy[offset + c];
+        }
+      }
+    });
+  } else {
+    ParallelForEachImage(stream, problem, [&](int64_t dx_offset, int64_t dy_offset) {
+      T* dx_image = dx + dx_offset;
+      for (int64_t out_pos = 0; out_pos < out_image_size; ++out_pos) {
+        dx_image[indice[dy_offset + out_pos]] += dy[dy_offset + out_pos];
+      }
+    });
+  }
+}
+
+template<typename T>
+void PoolCpuKernelUtil<T>::AvgForward(ep::CpuStream* stream, const PoolCpuProblem& problem,
+                                      bool count_include_pad, int32_t divisor_override,
+                                      const T* x, T* y) {
+  const PoolWindows windows(problem);
+  if (problem.channels_last) {
+    const int64_t channels = problem.channels;
+    ParallelForEachOutRow(stream, problem, [&](int64_t od, int64_t oh, int64_t x_offset,
+                                               int64_t y_offset) {
+      const T* x_image = x + x_offset;
+      for (int64_t ow = 0; ow < problem.out_size[2]; ++ow) {
+        T* __restrict__ y_pos = y + y_offset + ow * channels;
+        std::fill(y_pos, y_pos + channels, static_cast<T>(0));
+        windows.ForEachPos(od, oh, ow, [&](int64_t pos) {
+          const T* __restrict__ x_pos = x_image + pos * channels;
+          for (int64_t c = 0; c < channels; ++c) { y_pos[c] += x_pos[c]; }
+        });
+        const T divisor =
+            static_cast<T>(windows.AvgDivisor(od, oh, ow, count_include_pad, divisor_override));
+        for (int64_t c = 0; c < channels; ++c) { y_pos[c] = y_pos[c] / divisor; }
+      }
+    });
+  } else {
+    ParallelForEachImage(stream, problem, [&](int64_t x_offset, int64_t y_offset) {
+      const T* x_image = x + x_offset;
+      windows.ForEachOutPos([&](int64_t od, int64_t oh, int64_t ow, int64_t out_pos) {
+        T sum = 0;
+        windows.ForEachPos(od, oh, ow, [&](int64_t pos) { sum += x_image[pos]; });
+        const T divisor =
+            static_cast<T>(windows.AvgDivisor(od, oh, ow, count_include_pad, divisor_override));
+        y[y_offset + out_pos] = sum / divisor;
+      });
+    });
+  }
+}
+
+template<typename T>
+void PoolCpuKernelUtil<T>::AvgBackward(ep::CpuStream* stream, const PoolCpuProblem& problem,
+                                       bool count_include_pad, int32_t divisor_override,
+                                       const T* dy, T* dx) {
+  const PoolWindows windows(problem);
+  const int64_t out_image_size = problem.OutSpatialSize();
+  if (problem.channels_last) {
+    const int64_t channels = problem.channels;
+    ParallelForEachChannelBlock(stream, problem, [&](int64_t n, int64_t c_begin, int64_t c_end) {
+      T* dx_image = dx + n * problem.InSpatialSize() * channels + c_begin;
+      const int64_t block_size = c_end - c_begin;
+      T grad[kChannelBlockSize];
+      windows.ForEachOutPos([&](int64_t od, int64_t oh, int64_t ow, int64_t out_pos) {
+        const T* dy_pos = dy + (n * out_image_size + out_pos) * channels + c_begin;
+        const T divisor =
+            static_cast<T>(windows.AvgDivisor(od, oh, ow, count_include_pad, divisor_override));
+        for (int64_t c = 0; c < block_size; ++c) { grad[c] = dy_pos[c] / divisor; }
+        windows.ForEachPos(od, oh, ow, [&](int64_t pos) {
+          T* __restrict__ dx_pos = dx_image + pos * channels;
+          for (int64_t c = 0; c < block_size; ++c) { dx_pos[c] += grad[c]; }
+        });
+      });
+    });
+  } else {
+    ParallelForEachImage(stream, problem, [&](int64_t dx_offset, int64_t dy_offset) {
+      T* dx_image = dx + dx_offset;
+      windows.ForEachOutPos([&](int64_t od, int64_t oh, int64_t ow, int64_t out_pos) {
+        const T divisor =
+            static_cast<T>(windows.AvgDivisor(od, oh, ow, count_include_pad, divisor_override));
+        const T grad = dy[dy_offset + out_pos] / divisor;
+        windows.ForEachPos(od, oh, ow, [&](int64_t pos) { dx_image[pos] += grad; });
+      });
+    });
+  }
+}
+
+template struct PoolCpuKernelUtil<int32_t>;
+template struct PoolCpuKernelUtil<float>;
+template struct PoolCpuKernelUtil<double>;
+
+}  // namespace oneflow
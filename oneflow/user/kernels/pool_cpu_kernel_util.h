@@ -0,0 +1,78 @@
+/*
+Copyright 2020 The OneFlow Authors. All rights reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+#ifndef ONEFLOW_USER_KERNELS_POOL_CPU_KERNEL_UTIL_H_
+#define ONEFLOW_USER_KERNELS_POOL_CPU_KERNEL_UTIL_H_
+
+#include "oneflow/core/framework/framework.h"
+#include "oneflow/core/ep/cpu/cpu_stream.h"
+
+namespace oneflow {
+
+// Describes a pooling from `in` to `out`. All spatial fields are padded to 3 dims the same way as
+// the 5d shapes of the pool kernels.
+struct PoolCpuProblem {
+  bool channels_last = false;
+  // The window of an output position only depends on in_size and out_size, the other window
+  // fields are ignored.
+  bool adaptive = false;
+  int64_t batch_size = 0;
+  int64_t channels = 0;
+  int64_t in_size[3] = {1, 1, 1};
+  int64_t out_size[3] = {1, 1, 1};
+  int32_t kernel_size[3] = {1, 1, 1};
+  int32_t strides[3] = {1, 1, 1};
+  int32_t dilation_rate[3] = {1, 1, 1};
+  int32_t padding_before[3] = {0, 0, 0};
+
+  int64_t InSpatialSize() const { return in_size[0] * in_size[1] * in_size[2]; }
+  int64_t OutSpatialSize() const { return out_size[0] * out_size[1] * out_size[2]; }
+};
+
+// in_5d_shape and out_5d_shape are (N, C, D, H, W) whatever the layout. dilation_rate may be
+// nullptr for the poolings without dilation.
+PoolCpuProblem MakePoolCpuProblem(bool channels_last, const ShapeView& in_5d_shape,
+                                  const ShapeView& out_5d_shape, const int32_t* kernel_size,
+                                  const int32_t* strides, const int32_t* dilation_rate,
+                                  const int32_t* padding_before);
+
+PoolCpuProblem MakeAdaptivePoolCpuProblem(const ShapeView& in_5d_shape,
+                                          const ShapeView& out_5d_shape);
+
+// The channels first kernels spread the (n, c) images over the threads of the stream. The
+// channels last forward kernels spread the (n, d, h) output rows and process the channels of a
+// position in a unit stride loop, their backward spreads (n, channel block) pairs. Each task owns
+// the part of the output it writes, so the backward scatters need no atomics.
+template<typename T>
+struct PoolCpuKernelUtil {
+  // indice is the offset of the max in the (n, c) image for channels first, and the offset of the
+  // position in the n image times channels plus c for channels last, as the cuda kernels.
+  static void MaxForward(ep::CpuStream* stream, const PoolCpuProblem& problem, const T* x, T* y,
+                         int64_t* indice);
+  // dx += the scatter of dy to indice.
+  static void MaxBackward(ep::CpuStream* stream, const PoolCpuProblem& problem, const T* dy,
+                          const int64_t* indice, T* dx);
+  // A non zero divisor_override replaces the window size, count_include_pad counts the padded
+  // positions of the window.
+  static void AvgForward(ep::CpuStream* stream, const PoolCpuProblem& problem,
+                         bool count_include_pad, int32_t divisor_override, const T* x, T* y);
+  // dx += the data grad of AvgForward.
+  static void AvgBackward(ep::CpuStream* stream, const PoolCpuProblem& problem,
+                          bool count_include_pad, int32_t divisor_override, const T* dy, T* dx);
+};
+
+}  // namespace oneflow
+
+#endif  // ONEFLOW_USER_KERNELS_POOL_CPU_KERNEL_UTIL_H_
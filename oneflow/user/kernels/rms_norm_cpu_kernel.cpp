@@ -0,0 +1,256 @@
+/*
+Copyright 2020 The OneFlow Authors. All rights reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+#include "oneflow/core/framework/framework.h"
+#include "oneflow/core/ep/cpu/cpu_stream.h"
+#include "oneflow/core/ep/cpu/cpu_device.h"
+#include "oneflow/user/kernels/row_reduce_cpu_kernel_util.h"
+
+namespace oneflow {
+
+namespace {
+
+using row_reduce::GetRowGrainSize;
+
+template<typename T>
+using RmsNormComputeType = row_reduce::ComputeType<T>;
+
+template<typename T, typename ComputeType>
+ComputeType RowSquareSum(const T* x, int64_t ncol) {
+  return row_reduce::LaneSum<ComputeType>(ncol, [&](int64_t col) {
+    const ComputeType val = static_cast<ComputeType>(x[col]);
+    return val * val;
+  });
+}
+
+template<typename T, typename ComputeType, bool affine>
+void RmsNormForwardCpu(ep::CpuStream* stream, int64_t nrow, int64_t ncol, double eps, const T* x,
+                       const T* weight, T* y, ComputeType* inv_rms) {
+  stream->ParallelFor(
+      0, nrow,
+      [&](int64_t begin, int64_t end) {
+        for (int64_t row = begin; row < end; ++row) {
+          const T* row_x = x + row * ncol;
+          T* row_y = y + row * ncol;
+          const ComputeType mean_square =
+              RowSquareSum<T, ComputeType>(row_x, ncol) / static_cast<ComputeType>(ncol);
+          const ComputeType row_inv_rms =
+              static_cast<ComputeType>(1) / std::sqrt(mean_square + static_cast<ComputeType>(eps));
+          for (int64_t col = 0; col < ncol; ++col) {
+            ComputeType normalized = static_cast<ComputeType>(row_x[col]) * row_inv_rms;
+            if (affine) { normalized *= static_cast<ComputeType>(weight[col]); }
+            row_y[col] = static_cast<T>(normalized);
+          }
+          inv_rms[row] = row_inv_rms;
+        }
+      },
+      GetRowGrainSize(ncol));
+}
+
+// dx = inv_rms * (dy * weight - x_hat * mean(dy * weight * x_hat)), x_hat = x * inv_rms
+template<typename T, typename ComputeType, bool affine>
+void RmsNormBackwardCpu(ep::CpuStream* stream, int64_t nrow, int64_t ncol, const T* dy,
+                        const T* x, const T* weight, const ComputeType* inv_rms, T* dx) {
+  stream->ParallelFor(
+      0, nrow,
+      [&](int64_t begin, int64_t end) {
+        for (int64_t row = begin; row < end; ++row) {
+          const T* row_dy = dy + row * ncol;
+          const T* row_x = x + row * ncol;
+          T* row_dx = dx + row * ncol;
+          const ComputeType row_inv_rms = inv_rms[row];
+          const ComputeType sum = row_reduce::LaneSum<ComputeType>(ncol, [&](int64_t col) {
+            ComputeType scaled_dy = static_cast<ComputeType>(row_dy[col]);
+            if (affine) { scaled_dy *= static_cast<ComputeType>(weight[col]); }
+            return scaled_dy * static_cast<ComputeType>(row_x[col]);
+          });
+          // mean(dy * weight * x_hat) * inv_rms, folded so that x_hat is not materialized twice
+          const ComputeType coefficient =
+              sum * row_inv_rms * row_inv_rms / static_cast<ComputeType>(ncol);
+          for (int64_t col = 0; col < ncol; ++col) {
+            ComputeType scaled_dy = static_cast<ComputeType>(row_dy[col]);
+            if (affine) { scaled_dy *= static_cast<ComputeType>(weight[col]); }
+            row_dx[col] = static_cast<T>(
+                (scaled_dy - static_cast<ComputeType>(row_x[col]) * coefficient) * row_inv_rms);
+          }
+        }
+      },
+      GetRowGrainSize(ncol));
+}
+
+// Each task reduces the weight grad over a contiguous range of rows into its own partial buffer,
+// the partials are summed afterwards in parallel over columns.
+template<typename T, typename ComputeType>
+void RmsNormParamBackwardCpu(ep::CpuStream* stream, int64_t nrow, int64_t ncol, const T* dy,
+                             const T* x, const ComputeType* inv_rms, T* weight_grad) {
+  const int64_t num_tasks =
+      std::max<int64_t>(1, std::min<int64_t>(nrow, stream->device()->GetNumThreads()));
+  std::vector<ComputeType> partial_weight_grad(num_tasks * ncol, 0);
+  stream->ParallelFor(
+      0, num_tasks,
+      [&](int64_t begin, int64_t end) {
+        for (int64_t task = begin; task < end; ++task) {
+          ComputeType* task_weight_grad = partial_weight_grad.data() + task * ncol;
+          const int64_t row_begin = nrow * task / num_tasks;
+          const int64_t row_end = nrow * (task + 1) / num_tasks;
+          for (int64_t row = row_begin; row < row_end; ++row) {
+            const T* row_dy = dy + row * ncol;
+            const T* row_x = x + row * ncol;
+            const ComputeType row_inv_rms = inv_rms[row];
+            for (int64_t col = 0; col < ncol; ++col) {
+              task_weight_grad[col] += static_cast<ComputeType>(row_dy[col])
+                                       * static_cast<ComputeType>(row_x[col]) * row_inv_rms;
+            }
+          }
+        }
+      },
+      1);
+  stream->ParallelFor(
+      0, ncol,
+      [&](int64_t begin, int64_t end) {
+        for (int64_t col = begin; col < end; ++col) {
+          ComputeType sum = 0;
+          for (int64_t task = 0; task < num_tasks; ++task) {
+            sum += partial_weight_grad[task * ncol + col];
+          }
+          weight_grad[col] = static_cast<T>(sum);
+        }
+      },
+      GetRowGrainSize(num_tasks));
+}
+
+}  // namespace
+
+template<typename T>
+class RmsNormCpuKernel final : public user_op::OpKernel {
+ public:
+  RmsNormCpuKernel() = default;
+  ~RmsNormCpuKernel() = default;
+
+ private:
+  using user_op::OpKernel::Compute;
+  bool AlwaysComputeWhenAllOutputsEmpty() const override { return false; }
+  void Compute(user_op::KernelComputeContext* ctx) const override {
+    using ComputeType = typename RmsNormComputeType<T>::type;
+    const user_op::Tensor* x = ctx->Tensor4ArgNameAndIndex("x", 0);
+    user_op::Tensor* y = ctx->Tensor4ArgNameAndIndex("y", 0);
+    user_op::Tensor* inv_rms = ctx->Tensor4ArgNameAndIndex("inv_rms", 0);
+    const double eps = ctx->Attr<float>("epsilon");
+    const Shape& normalized_shape = ctx->Attr<Shape>("normalized_shape");
+    const int64_t ncol = normalized_shape.elem_cnt();
+    const int64_t nrow = inv_rms->shape_view().elem_cnt();
+    CHECK_EQ(x->shape_view().elem_cnt(), ncol * nrow);
+    auto* stream = ctx->stream()->As<ep::CpuStream>();
+    if (ctx->has_input("weight", 0)) {
+      const user_op::Tensor* weight = ctx->Tensor4ArgNameAndIndex("weight", 0);
+      CHECK_EQ(weight->shape_view().elem_cnt(), ncol);
+      RmsNormForwardCpu<T, ComputeType, true>(stream, nrow, ncol, eps, x->dptr<T>(),
+                                              weight->dptr<T>(), y->mut_dptr<T>(),
+                                              inv_rms->mut_dptr<ComputeType>());
+    } else {
+      RmsNormForwardCpu<T, ComputeType, false>(stream, nrow, ncol, eps, x->dptr<T>(), nullptr,
+                                               y->mut_dptr<T>(), inv_rms->mut_dptr<ComputeType>());
+    }
+  };
+};
+
+#define REGISTER_RMS_NORM_CPU_KERNEL(dtype)                           \
+  REGISTER_USER_KERNEL("rms_norm")                                    \
+      .SetCreateFn<RmsNormCpuKernel<dtype>>()                         \
+      .SetIsMatchedHob((user_op::HobDeviceType() == DeviceType::kCPU) \
+                       && (user_op::HobDataType("x", 0) == GetDataType<dtype>::value));
+
+REGISTER_RMS_NORM_CPU_KERNEL(float)
+REGISTER_RMS_NORM_CPU_KERNEL(double)
+REGISTER_RMS_NORM_CPU_KERNEL(bfloat16)
+
+template<typename T>
+class RmsNormGradCpuKernel final : public user_op::OpKernel {
+ public:
+  RmsNormGradCpuKernel() = default;
+  ~RmsNormGradCpuKernel() = default;
+
+ private:
+  using user_op::OpKernel::Compute;
+  bool AlwaysComputeWhenAllOutputsEmpty() const override { return false; }
+  void Compute(user_op::KernelComputeContext* ctx) const override {
+    using ComputeType = typename RmsNormComputeType<T>::type;
+    const user_op::Tensor* dy = ctx->Tensor4ArgNameAndIndex("dy", 0);
+    const user_op::Tensor* x = ctx->Tensor4ArgNameAndIndex("x", 0);
+    const user_op::Tensor* inv_rms = ctx->Tensor4ArgNameAndIndex("inv_rms", 0);
+    user_op::Tensor* dx = ctx->Tensor4ArgNameAndIndex("dx", 0);
+    const int64_t nrow = inv_rms->shape_view().elem_cnt();
+    if (nrow == 0) { return; }
+    const int64_t ncol = x->shape_view().elem_cnt() / nrow;
+    auto* stream = ctx->stream()->As<ep::CpuStream>();
+    if (ctx->has_input("weight", 0)) {
+      const user_op::Tensor* weight = ctx->Tensor4ArgNameAndIndex("weight", 0);
+      CHECK_EQ(ncol, weight->shape_view().elem_cnt());
+      RmsNormBackwardCpu<T, ComputeType, true>(stream, nrow, ncol, dy->dptr<T>(), x->dptr<T>(),
+                                               weight->dptr<T>(), inv_rms->dptr<ComputeType>(),
+                                               dx->mut_dptr<T>());
+    } else {
+      RmsNormBackwardCpu<T, ComputeType, false>(stream, nrow, ncol, dy->dptr<T>(), x->dptr<T>(),
+                                                nullptr, inv_rms->dptr<ComputeType>(),
+                                                dx->mut_dptr<T>());
+    }
+  };
+};
+
+#define REGISTER_RMS_NORM_GRAD_CPU_KERNEL(dtype)                      \
+  REGISTER_USER_KERNEL("rms_norm_grad")                               \
+      .SetCreateFn<RmsNormGradCpuKernel<dtype>>()                     \
+      .SetIsMatchedHob((user_op::HobDeviceType() == DeviceType::kCPU) \
+                       && (user_op::HobDataType("dy", 0) == GetDataType<dtype>::value));
+
+REGISTER_RMS_NORM_GRAD_CPU_KERNEL(float)
+REGISTER_RMS_NORM_GRAD_CPU_KERNEL(double)
+REGISTER_RMS_NORM_GRAD_CPU_KERNEL(bfloat16)
+
+template<typename T>
+class RmsNormParamGradCpuKernel final : public user_op::OpKernel {
+ public:
+  RmsNormParamGradCpuKernel() = default;
+  ~RmsNormParamGradCpuKernel() = default;
+
+ private:
+  using user_op::OpKernel::Compute;
+  bool AlwaysComputeWhenAllOutputsEmpty() const override { return false; }
+  void Compute(user_op::KernelComputeContext* ctx) const override {
+    using ComputeType = typename RmsNormComputeType<T>::type;
+    const user_op::Tensor* dy = ctx->Tensor4ArgNameAndIndex("dy", 0);
+    const user_op::Tensor* x = ctx->Tensor4ArgNameAndIndex("x", 0);
+    const user_op::Tensor* inv_rms = ctx->Tensor4ArgNameAndIndex("inv_rms", 0);
+    user_op::Tensor* weight_grad = ctx->Tensor4ArgNameAndIndex("weight_grad", 0);
+    const int64_t nrow = inv_rms->shape_view().elem_cnt();
+    const int64_t ncol = weight_grad->shape_view().elem_cnt();
+    RmsNormParamBackwardCpu<T, ComputeType>(ctx->stream()->As<ep::CpuStream>(), nrow, ncol,
+                                            dy->dptr<T>(), x->dptr<T>(),
+                                            inv_rms->dptr<ComputeType>(),
+                                            weight_grad->mut_dptr<T>());
+  };
+};
+
+#define REGISTER_RMS_NORM_PARAM_GRAD_CPU_KERNEL(dtype)                \
+  REGISTER_USER_KERNEL("rms_norm_param_grad")                         \
+      .SetCreateFn<RmsNormParamGradCpuKernel<dtype>>()                \
+      .SetIsMatchedHob((user_op::HobDeviceType() == DeviceType::kCPU) \
+                       && (user_op::HobDataType("dy", 0) == GetDataType<dtype>::value));
+
+REGISTER_RMS_NORM_PARAM_GRAD_CPU_KERNEL(float)
+REGISTER_RMS_NORM_PARAM_GRAD_CPU_KERNEL(double)
+REGISTER_RMS_NORM_PARAM_GRAD_CPU_KERNEL(bfloat16)
+
+}  // namespace oneflow
@@ -0,0 +1,66 @@
+/*
+Copyright 2020 The OneFlow Authors. All rights reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+#ifndef ONEFLOW_USER_KERNELS_ROW_REDUCE_CPU_KERNEL_UTIL_H_
+#define ONEFLOW_USER_KERNELS_ROW_REDUCE_CPU_KERNEL_UTIL_H_
+
+#include "oneflow/core/framework/framework.h"
+
+namespace oneflow {
+
+// Shared by the cpu kernels that reduce along the rows of a matrix (layer_norm, rms_norm,
+// fused attention) and hand the rows out to threads.
+namespace row_reduce {
+
+// Number of independent accumulators kept per row. Row reductions are split across lanes so that
+// the compiler can keep them in one vector register instead of a serial dependency chain.
+constexpr int32_t kLanes = 8;
+
+// Rows are handed out to threads in tasks of at least this many elements.
+constexpr int64_t kParallelGrainElemCnt = 32768;
+
+template<typename T>
+struct ComputeType {
+  using type = T;
+};
+
+template<>
+struct ComputeType<bfloat16> {
+  using type = float;
+};
+
+inline int64_t GetRowGrainSize(int64_t row_size) {
+  return std::max<int64_t>(1, kParallelGrainElemCnt / std::max<int64_t>(row_size, 1));
+}
+
+// Sums Get(i) for i in [0, n) with kLanes independent accumulators.
+template<typename T, typename GetFn>
+T LaneSum(int64_t n, const GetFn& Get) {
+  T lane_sum[kLanes] = {0};
+  const int64_t packed_n = n / kLanes * kLanes;
+  for (int64_t i = 0; i < packed_n; i += kLanes) {
+    for (int32_t j = 0; j < kLanes; ++j) { lane_sum[j] += Get(i + j); }
+  }
+  T sum = 0;
+  for (int32_t j = 0; j < kLanes; ++j) { sum += lane_sum[j]; }
+  for (int64_t i = packed_n; i < n; ++i) { sum += Get(i); }
+  return sum;
+}
+
+}  // namespace row_reduce
+
+}  // namespace oneflow
+
+#endif  // ONEFLOW_USER_KERNELS_ROW_REDUCE_CPU_KERNEL_UTIL_H_
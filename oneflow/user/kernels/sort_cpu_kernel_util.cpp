@@ -0,0 +1,481 @@
+/*
+Copyright 2020 The OneFlow Authors. All rights reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+#include "oneflow/user/kernels/sort_cpu_kernel_util.h"
+#include "oneflow/core/ep/cpu/cpu_device.h"
+
+namespace oneflow {
+
+namespace {
+
+// Rows are handed out to threads in tasks of at least this many elements.
+constexpr int64_t kParallelGrainElemCnt = 32768;
+
+// Rows at least this long are radix sorted, shorter rows use comparison sorts.
+constexpr int64_t kRadixSortMinRowSize = 1024;
+
+// A row at least this long is split across the threads when there are fewer rows than threads.
+constexpr int64_t kSplitRowMinSize = 65536;
+
+// top_k keeps a heap of the best k elements while scanning a row when k is at most this and small
+// against the row.
+constexpr int64_t kHeapTopKMaxK = 512;
+
+constexpr int32_t kRadixBits = 8;
+constexpr int32_t kRadixBuckets = 1 << kRadixBits;
+
+// Maps a value to an unsigned key with the same order, see the order of SortCpuKernelUtil.
+template<typename T, typename Enable = void>
+struct RadixKey;
+
+template<>
+struct RadixKey<bool> {
+  using type = uint8_t;
+  static type Of(bool val) { return val ? 1 : 0; }
+};
+
+template<typename T>
+struct RadixKey<
+    T, typename std::enable_if<std::is_integral<T>::value && !std::is_same<T, bool>::value>::type> {
+  using type = typename std::make_unsigned<T>::type;
+  static type Of(T val) {
+    constexpr type kSignBit = static_cast<type>(type(1) << (sizeof(type) * 8 - 1));
+    const type bits = static_cast<type>(val);
+    return std::is_signed<T>::value ? static_cast<type>(bits ^ kSignBit) : bits;
+  }
+};
+
+template<typename T>
+struct RadixKey<T, typename std::enable_if<std::is_floating_point<T>::value>::type> {
+  using type = typename std::conditional<sizeof(T) == 4, uint32_t, uint64_t>::type;
+  static type Of(T val) {
+    constexpr type kSignBit = type(1) << (sizeof(type) * 8 - 1);
+    if (std::isnan(val)) { val = std::numeric_limits<T>::quiet_NaN(); }
+    if (val == 0) { val = 0; }
+    type bits = 0;
+    std::memcpy(&bits, &val, sizeof(T));
+    return (bits & kSignBit) ? static_cast<type>(~bits) : static_cast<type>(bits | kSignBit);
+  }
+};
+
+template<typename T>
+typename RadixKey<T>::type SortKey(T val, bool descending) {
+  using Key = typename RadixKey<T>::type;
+  const Key key = RadixKey<T>::Of(val);
+  return descending ? static_cast<Key>(~key) : key;
+}
+
+template<typename Key, typename Index>
+struct KeyIndex {
+  Key key;
+  Index index;
+  bool operator<(const KeyIndex& other) const {
+    return key < other.key || (key == other.key && index < other.index);
+  }
+};
+
+int64_t RowGrainSize(int64_t row_size) {
+  return std::max<int64_t>(1, kParallelGrainElemCnt / std::max<int64_t>(row_size, 1));
+}
+
+// The number of chunks each row is split into, 1 when the rows are spread over the threads.
+int64_t NumRowChunks(ep::CpuStream* stream, int64_t num_rows, int64_t row_size) {
+  const int64_t num_threads = stream->device()->GetNumThreads();
+  if (num_rows >= num_threads || row_size < kSplitRowMinSize) { return 1; }
+  return std::max<int64_t>(1, std::min(num_threads, row_size / kRadixSortMinRowSize));
+}
+
+// Calls fn(chunk, begin, end) for the num_chunks even chunks of [0, n), in parallel when there is
+// more than one.
+template<typename ChunkFn>
+void ForEachChunk(ep::CpuStream* stream, int64_t n, int64_t num_chunks, ChunkFn fn) {
+  auto run = [&](int64_t chunk_begin, int64_t chunk_end) {
+    for (int64_t chunk = chunk_begin; chunk < chunk_end; ++chunk) {
+      fn(chunk, n * chunk / num_chunks, n * (chunk + 1) / num_chunks);
+    }
+  };
+  if (num_chunks == 1) {
+    run(0, 1);
+  } else {
+    stream->ParallelFor(0, num_chunks, run, 1);
+  }
+}
+
+// Stable LSD radix sort of the n items of data by key_fn(item). buffer holds n items, the result is
+// left in data. All digits are counted in one pass and the digits on which every key agrees are
+// skipped, so small ranges of keys only pay for the digits that differ.
+template<typename Item, typename KeyFn>
+void RadixSort(Item* data, Item* buffer, int64_t n, KeyFn key_fn) {
+  if (n <= 1) { return; }
+  using Key = decltype(key_fn(*data));
+  constexpr int32_t kNumDigits = sizeof(Key) * 8 / kRadixBits;
+  std::vector<int64_t> counts(kNumDigits * kRadixBuckets, 0);
+  for (int64_t i = 0; i < n; ++i) {
+    const Key key = key_fn(data[i]);
+    for (int32_t digit = 0; digit < kNumDigits; ++digit) {
+      counts[digit * kRadixBuckets + ((key >> (digit * kRadixBits)) & (kRadixBuckets - 1))] += 1;
+    }
+  }
+  Item* src = data;
+  Item* dst = buffer;
+  for (int32_t digit = 0; digit < kNumDigits; ++digit) {
+    const int32_t shift = digit * kRadixBits;
+    int64_t* offsets = counts.data() + digit * kRadixBuckets;
+    if (offsets[(key_fn(src[0]) >> shift) & (kRadixBuckets - 1)] == n) { continue; }
+    int64_t offset = 0;
+    for (int32_t bucket = 0; bucket < kRadixBuckets; ++bucket) {
+      const int64_t count = offsets[bucket];
+      offsets[bucket] = offset;
+      offset += count;
+    }
+    for (int64_t i = 0; i < n; ++i) {
+      const Item item = src[i];
+      dst[offsets[(key_fn(item) >> shift) & (kRadixBuckets - 1)]++] = item;
+    }
+    std::swap(src, dst);
+  }
+  if (src != data) { std::copy(src, src + n, data); }
+}
+
+// Sorts data in num_chunks chunks with sort_chunk(chunk_data, chunk_buffer, chunk_size), then
+// merges the runs pairwise. std::merge takes the left run first on ties, so the result is stable
+// when the chunk sorts are.
+template<typename Item, typename SortChunkFn, typename Less>
+void ParallelSort(ep::CpuStream* stream, Item* data, Item* buffer, int64_t n, int64_t num_chunks,
+                  SortChunkFn sort_chunk, Less less) {
+  ForEachChunk(stream, n, num_chunks, [&](int64_t chunk, int64_t begin, int64_t end) {
+    sort_chunk(data + begin, buffer + begin, end - begin);
+  });
+  std::vector<int64_t> bounds(num_chunks + 1);
+  for (int64_t chunk = 0; chunk <= num_chunks; ++chunk) { bounds[chunk] = n * chunk / num_chunks; }
+  Item* src = data;
+  Item* dst = buffer;
+  while (bounds.size() > 2) {
+    const int64_t num_runs = bounds.size() - 1;
+    const int64_t num_merges = (num_runs + 1) / 2;
+    stream->ParallelFor(
+        0, num_merges,
+        [&](int64_t merge_begin, int64_t merge_end) {
+          for (int64_t merge = merge_begin; merge < merge_end; ++merge) {
+            const int64_t first = bounds[2 * merge];
+            const int64_t middle = bounds[std::min(2 * merge + 1, num_runs)];
+            const int64_t last = bounds[std::min(2 * merge + 2, num_runs)];
+            std::merge(src + first, src + middle, src + middle, src + last, dst + first, less);
+          }
+        },
+        1);
+    std::vector<int64_t> merged_bounds;
+    for (int64_t run = 0; run < num_runs; run += 2) { merged_bounds.push_back(bounds[run]); }
+    merged_bounds.push_back(n);
+    bounds.swap(merged_bounds);
+    std::swap(src, dst);
+  }
+  if (src != data) { std::copy(src, src + n, data); }
+}
+
+template<typename T>
+void SortValues(T* data, T* buffer, int64_t n, bool descending) {
+  auto key_fn = [descending](T val) { return SortKey(val, descending); };
+  if (n >= kRadixSortMinRowSize) {
+    RadixSort(data, buffer, n, key_fn);
+  } else {
+    std::sort(data, data + n, [&](T lhs, T rhs) { return key_fn(lhs) < key_fn(rhs); });
+  }
+}
+
+// Items are built in index order, so the stable radix sort keeps ties in index order.
+template<typename Item>
+void SortItems(Item* data, Item* buffer, int64_t n) {
+  if (n >= kRadixSortMinRowSize) {
+    RadixSort(data, buffer, n, [](const Item& item) { return item.key; });
+  } else {
+    std::sort(data, data + n);
+  }
+}
+
+// Writes the min(k, end - begin) best items of in[begin, end) to out in order, the best item is
+// the one with the smallest descending key and then the smallest index.
+template<typename T>
+int64_t SelectTopK(const T* in, int64_t begin, int64_t end, int64_t k,
+                   std::vector<KeyIndex<typename RadixKey<T>::type, int64_t>>* scratch,
+                   KeyIndex<typename RadixKey<T>::type, int64_t>* out) {
+  using Item = KeyIndex<typename RadixKey<T>::type, int64_t>;
+  const int64_t n = end - begin;
+  k = std::min(k, n);
+  if (k <= 0) { return 0; }
+  auto item_of = [in](int64_t i) { return Item{SortKey(in[i], true), i}; };
+  if (k == 1) {
+    Item best = item_of(begin);
+    for (int64_t i = begin + 1; i < end; ++i) {
+      const Item item = item_of(i);
+      if (item < best) { best = item; }
+    }
+    out[0] = best;
+  } else if (k <= kHeapTopKMaxK && k * 8 <= n) {
+    // A max heap of the best k items seen so far, its front is the worst of them.
+    scratch->resize(k);
+    for (int64_t i = 0; i < k; ++i) { (*scratch)[i] = item_of(begin + i); }
+    std::make_heap(scratch->begin(), scratch->end());
+    for (int64_t i = begin + k; i < end; ++i) {
+      const Item item = item_of(i);
+      if (item < scratch->front()) {
+        std::pop_heap(scratch->begin(), scratch->end());
+        scratch->back() = item;
+        std::push_heap(scratch->begin(), scratch->end());
+      }
+    }
+    std::sort_heap(scratch->begin(), scratch->end());
+    std::copy(scratch->begin(), scratch->end(), out);
+  } else {
+    scratch->resize(2 * n);
+    Item* items = scratch->data();
+    for (int64_t i = 0; i < n; ++i) { items[i] = item_of(begin + i); }
+    if (n >= kRadixSortMinRowSize && k * 4 >= n) {
+      SortItems(items, items + n, n);
+    } else {
+      std::nth_element(items, items + k - 1, items + n);
+      std::sort(items, items + k - 1);
+    }
+    std::copy(items, items + k, out);
+  }
+  return k;
+}
+
+// Returns the index of the element of rank `rank` in (key, index) order. Each pass counts the
+// next digit of the keys that match the digits selected so far, the chunks of the row are counted
+// in parallel. The final pass finds which of the elements equal to the selected key has the rank.
+template<typename T>
+int64_t RadixSelect(ep::CpuStream* stream, const T* in, int64_t n, int64_t rank,
+                    int64_t num_chunks) {
+  using Key = typename RadixKey<T>::type;
+  constexpr int32_t kNumDigits = sizeof(Key) * 8 / kRadixBits;
+  std::vector<int64_t> counts(num_chunks * kRadixBuckets);
+  Key prefix = 0;
+  Key prefix_mask = 0;
+  for (int32_t digit = kNumDigits - 1; digit >= 0; --digit) {
+    const int32_t shift = digit * kRadixBits;
+    std::fill(counts.begin(), counts.end(), 0);
+    ForEachChunk(stream, n, num_chunks, [&](int64_t chunk, int64_t begin, int64_t end) {
+      int64_t* chunk_counts = counts.data() + chunk * kRadixBuckets;
+      for (int64_t i = begin; i < end; ++i) {
+        const Key key = RadixKey<T>::Of(in[i]);
+        if ((key & prefix_mask) == prefix) {
+          chunk_counts[(key >> shift) & (kRadixBuckets - 1)] += 1;
+        }
+      }
+    });
+    int32_t bucket = 0;
+    for (; bucket < kRadixBuckets - 1; ++bucket) {
+      int64_t count = 0;
+      for (int64_t chunk = 0; chunk < num_chunks; ++chunk) {
+        count += counts[chunk * kRadixBuckets + bucket];
+      }
+      if (rank < count) { break; }
+      rank -= count;
+    }
+    prefix = static_cast<Key>(prefix | (static_cast<Key>(bucket) << shift));
+    prefix_mask = static_cast<Key>(prefix_mask | (static_cast<Key>(kRadixBuckets - 1) << shift));
+  }
+  std::vector<int64_t> equal_counts(num_chunks, 0);
+  ForEachChunk(stream, n, num_chunks, [&](int64_t chunk, int64_t begin, int64_t end) {
+    for (int64_t i = begin; i < end; ++i) {
+      if (RadixKey<T>::Of(in[i]) == prefix) { equal_counts[chunk] += 1; }
+    }
+  });
+  int64_t chunk = 0;
+  while (rank >= equal_counts[chunk]) {
+    rank -= equal_counts[chunk];
+    chunk += 1;
+  }
+  for (int64_t i = n * chunk / num_chunks;; ++i) {
+    if (RadixKey<T>::Of(in[i]) == prefix) {
+      if (rank == 0) { return i; }
+      rank -= 1;
+    }
+  }
+}
+
+// Index of the first NaN of a row or -1. As in torch, the median of a row holding a NaN is that
+// NaN, although the orders above rank NaN above every number.
+template<typename T>
+int64_t FirstNaNIndex(const T* row, int64_t row_size) {
+  if constexpr (std::is_floating_point<T>::value) {
+    for (int64_t i = 0; i < row_size; ++i) {
+      if (std::isnan(row[i])) { return i; }
+    }
+  }
+  return -1;
+}
+
+}  // namespace
+
+template<typename T>
+void SortCpuKernelUtil<T>::Sort(ep::CpuStream* stream, const T* in, int64_t num_rows,
+                                int64_t row_size, bool descending, T* out) {
+  if (in != out) { std::copy(in, in + num_rows * row_size, out); }
+  const int64_t num_chunks = NumRowChunks(stream, num_rows, row_size);
+  if (num_chunks > 1) {
+    // NOTE: not a std::vector, which has no data() for bool.
+    std::unique_ptr<T[]> buffer(new T[row_size]);
+    for (int64_t row = 0; row < num_rows; ++row) {
+      ParallelSort(
+          stream, out + row * row_size, buffer.get(), row_size, num_chunks,
+          [descending](T* data, T* chunk_buffer, int64_t n) {
+            SortValues(data, chunk_buffer, n, descending);
+          },
+          [descending](T lhs, T rhs) {
+            return SortKey(lhs, descending) < SortKey(rhs, descending);
+          });
+    }
+    return;
+  }
+  stream->ParallelFor(
+      0, num_rows,
+      [&](int64_t begin, int64_t end) {
+        std::unique_ptr<T[]> buffer(new T[row_size >= kRadixSortMinRowSize ? row_size : 0]);
+        for (int64_t row = begin; row < end; ++row) {
+          SortValues(out + row * row_size, buffer.get(), row_size, descending);
+        }
+      },
+      RowGrainSize(row_size));
+}
+
+template<typename T>
+void SortCpuKernelUtil<T>::ArgSort(ep::CpuStream* stream, const T* in, int64_t num_rows,
+                                   int64_t row_size, bool descending, int32_t* out) {
+  using Item = KeyIndex<typename RadixKey<T>::type, int32_t>;
+  auto make_items = [descending](const T* row_in, int64_t begin, int64_t end, Item* items) {
+    for (int64_t i = begin; i < end; ++i) {
+      items[i] = Item{SortKey(row_in[i], descending), static_cast<int32_t>(i)};
+    }
+  };
+  auto write_indices = [](const Item* items, int64_t n, int32_t* row_out) {
+    for (int64_t i = 0; i < n; ++i) { row_out[i] = items[i].index; }
+  };
+  const int64_t num_chunks = NumRowChunks(stream, num_rows, row_size);
+  if (num_chunks > 1) {
+    std::vector<Item> items(2 * row_size);
+    for (int64_t row = 0; row < num_rows; ++row) {
+      const T* row_in = in + row * row_size;
+      ForEachChunk(stream, row_size, num_chunks, [&](int64_t chunk, int64_t begin, int64_t end) {
+        make_items(row_in, begin, end, items.data());
+      });
+      ParallelSort(stream, items.data(), items.data() + row_size, row_size, num_chunks,
+                   SortItems<Item>, std::less<Item>());
+      write_indices(items.data(), row_size, out + row * row_size);
+    }
+    return;
+  }
+  stream->ParallelFor(
+      0, num_rows,
+      [&](int64_t begin, int64_t end) {
+        std::vector<Item> items(2 * row_size);
+        for (int64_t row = begin; row < end; ++row) {
+          make_items(in + row * row_size, 0, row_size, items.data());
+          SortItems(items.data(), items.data() + row_size, row_size);
+          write_indices(items.data(), row_size, out + row * row_size);
+        }
+      },
+      RowGrainSize(row_size));
+}
+
+template<typename T>
+void SortCpuKernelUtil<T>::TopK(ep::CpuStream* stream, const T* in, int64_t num_rows,
+                                int64_t row_size, int64_t k, int64_t* out) {
+  using Item = KeyIndex<typename RadixKey<T>::type, int64_t>;
+  k = std::min(k, row_size);
+  if (k <= 0) { return; }
+  const int64_t num_chunks = NumRowChunks(stream, num_rows, row_size);
+  if (num_chunks > 1 && k <= kHeapTopKMaxK) {
+    // The best k of a row are among the best k of its chunks.
+    std::vector<Item> candidates(num_chunks * k);
+    std::vector<int64_t> num_candidates(num_chunks);
+    for (int64_t row = 0; row < num_rows; ++row) {
+      const T* row_in = in + row * row_size;
+      ForEachChunk(stream, row_size, num_chunks, [&](int64_t chunk, int64_t begin, int64_t end) {
+        std::vector<Item> scratch;
+        num_candidates[chunk] =
+            SelectTopK(row_in, begin, end, k, &scratch, candidates.data() + chunk * k);
+      });
+      std::vector<Item> merged;
+      for (int64_t chunk = 0; chunk < num_chunks; ++chunk) {
+        merged.insert(merged.end(), candidates.begin() + chunk * k,
+                      candidates.begin() + chunk * k + num_candidates[chunk]);
+      }
+      std::partial_sort(merged.begin(), merged.begin() + k, merged.end());
+      for (int64_t i = 0; i < k; ++i) { out[row * k + i] = merged[i].index; }
+    }
+    return;
+  }
+  stream->ParallelFor(
+      0, num_rows,
+      [&](int64_t begin, int64_t end) {
+        std::vector<Item> scratch;
+        std::vector<Item> best(k);
+        for (int64_t row = begin; row < end; ++row) {
+          SelectTopK(in + row * row_size, 0, row_size, k, &scratch, best.data());
+          for (int64_t i = 0; i < k; ++i) { out[row * k + i] = best[i].index; }
+        }
+      },
+      RowGrainSize(row_size));
+}
+
+template<typename T>
+void SortCpuKernelUtil<T>::Median(ep::CpuStream* stream, const T* in, int64_t num_rows,
+                                  int64_t row_size, T* values, int64_t* indices) {
+  if (row_size <= 0) { return; }
+  const int64_t rank = (row_size - 1) / 2;
+  const int64_t num_chunks = NumRowChunks(stream, num_rows, row_size);
+  if (num_chunks > 1) {
+    for (int64_t row = 0; row < num_rows; ++row) {
+      const T* row_in = in + row * row_size;
+      int64_t index = FirstNaNIndex(row_in, row_size);
+      if (index < 0) { index = RadixSelect(stream, row_in, row_size, rank, num_chunks); }
+      values[row] = row_in[index];
+      if (indices != nullptr) { indices[row] = index; }
+    }
+    return;
+  }
+  using Item = KeyIndex<typename RadixKey<T>::type, int64_t>;
+  stream->ParallelFor(
+      0, num_rows,
+      [&](int64_t begin, int64_t end) {
+        std::vector<Item> items(row_size);
+        for (int64_t row = begin; row < end; ++row) {
+          const T* row_in = in + row * row_size;
+          int64_t index = FirstNaNIndex(row_in, row_size);
+          if (index < 0) {
+            for (int64_t i = 0; i < row_size; ++i) {
+              items[i] = Item{RadixKey<T>::Of(row_in[i]), i};
+            }
+            std::nth_element(items.begin(), items.begin() + rank, items.end());
+            index = items[rank].index;
+          }
+          values[row] = row_in[index];
+          if (indices != nullptr) { indices[row] = index; }
+        }
+      },
+      RowGrainSize(row_size));
+}
+
+template struct SortCpuKernelUtil<bool>;
+template struct SortCpuKernelUtil<int8_t>;
+template struct SortCpuKernelUtil<uint8_t>;
+template struct SortCpuKernelUtil<int32_t>;
+template struct SortCpuKernelUtil<int64_t>;
+template struct SortCpuKernelUtil<float>;
+template struct SortCpuKernelUtil<double>;
+
+}  // namespace oneflow
@@ -0,0 +1,49 @@
+/*
+Copyright 2020 The OneFlow Authors. All rights reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+#ifndef ONEFLOW_USER_KERNELS_SORT_CPU_KERNEL_UTIL_H_
+#define ONEFLOW_USER_KERNELS_SORT_CPU_KERNEL_UTIL_H_
+
+#include "oneflow/core/framework/framework.h"
+#include "oneflow/core/ep/cpu/cpu_stream.h"
+
+namespace oneflow {
+
+// Sorting and selection over the rows of a (num_rows, row_size) tensor. All orders compare the
+// radix keys of the values, NaN is greater than every number and -0 equals +0. Ties are broken by
+// the lower index, which also makes every result deterministic.
+//
+// Rows are spread over the threads of the stream. When there are fewer rows than threads and the
+// rows are large, each row is split across the threads instead: sorts radix sort the chunks and
+// merge them, top_k merges the candidates of the chunks and median selects with a parallel
+// histogram. Large rows are radix sorted, small rows use comparison sorts.
+template<typename T>
+struct SortCpuKernelUtil {
+  static void Sort(ep::CpuStream* stream, const T* in, int64_t num_rows, int64_t row_size,
+                   bool descending, T* out);
+  static void ArgSort(ep::CpuStream* stream, const T* in, int64_t num_rows, int64_t row_size,
+                      bool descending, int32_t* out);
+  // out is (num_rows, k), the indices of the k largest values of each row in descending order.
+  static void TopK(ep::CpuStream* stream, const T* in, int64_t num_rows, int64_t row_size,
+                   int64_t k, int64_t* out);
+  // The lower median of each row, the value of rank (row_size - 1) / 2, or the first NaN of a row
+  // holding one. indices may be nullptr.
+  static void Median(ep::CpuStream* stream, const T* in, int64_t num_rows, int64_t row_size,
+                     T* values, int64_t* indices);
+};
+
+}  // namespace oneflow
+
+#endif  // ONEFLOW_USER_KERNELS_SORT_CPU_KERNEL_UTIL_H_
@@ -0,0 +1,198 @@
+/*
+Copyright 2020 The OneFlow Authors. All rights reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+#ifndef ONEFLOW_USER_KERNELS_SPARSE_ACCESS_CPU_KERNEL_UTIL_H_
+#define ONEFLOW_USER_KERNELS_SPARSE_ACCESS_CPU_KERNEL_UTIL_H_
+
+#include "oneflow/core/framework/framework.h"
+#include "oneflow/core/ep/cpu/cpu_stream.h"
+#include "oneflow/core/ep/cpu/cpu_device.h"
+
+namespace oneflow {
+
+// Row gathers and scatter-adds over (outer, rows, row_size) tensors on CPU, shared by the gather,
+// embedding and unsorted_segment_sum kernels.
+//
+// Gathers are split over output rows. Each task prefetches the source rows a few indices ahead,
+// the loads of a lookup depend on nothing but the index so they can all be in flight at once.
+// Segment sums bucket the data rows by segment range and sort every bucket by (segment, row), so
+// each task owns whole output rows and no atomics are needed. Rows of one segment are added in
+// ascending order, which gives the same result as the sequential loop on any number of threads.
+namespace sparse_access_cpu {
+
+// Number of elements handed to one task of ParallelFor.
+constexpr int64_t kParallelGrainElemCnt = 32768;
+// Number of rows the gather looks ahead when prefetching.
+constexpr int64_t kPrefetchRowDistance = 8;
+// Bytes of each source row that are prefetched, the hardware prefetcher covers the rest.
+constexpr int64_t kMaxPrefetchRowBytes = 512;
+constexpr int64_t kCacheLineSize = 64;
+// Segment buckets per thread, more buckets balance skewed segment ids better.
+constexpr int64_t kBucketsPerThread = 4;
+
+inline void PrefetchRow(const void* row, int64_t row_bytes) {
+#if defined(__GNUC__)
+  const char* ptr = static_cast<const char*>(row);
+  const int64_t prefetch_bytes = std::min(row_bytes, kMaxPrefetchRowBytes);
+  for (int64_t offset = 0; offset < prefetch_bytes; offset += kCacheLineSize) {
+    __builtin_prefetch(ptr + offset, 0, 3);
+  }
+#endif
+}
+
+// out[o][i] = in[o][row_of(i)] for o < outer_dim_size and i < num_out_rows, rows are row_size
+// elements long. The row is zero filled when row_of(i) is negative. row_of must return a row below
+// num_in_rows otherwise and may be called more than once for the same i.
+template<typename T, typename RowFn>
+void GatherRows(ep::CpuStream* stream, const T* in, int64_t outer_dim_size, int64_t num_in_rows,
+                int64_t num_out_rows, int64_t row_size, const RowFn& row_of, T* out) {
+  if (outer_dim_size == 0 || num_out_rows == 0 || row_size == 0) { return; }
+  const int64_t grain = std::max<int64_t>(kParallelGrainElemCnt / row_size, 1);
+  stream->ParallelFor(
+      0, outer_dim_size * num_out_rows,
+      [&](int64_t begin, int64_t end) {
+        int64_t outer_idx = begin / num_out_rows;
+        int64_t i = begin - outer_idx * num_out_rows;
+        int64_t ahead_outer_idx = outer_idx;
+        int64_t ahead_i = i;
+        const auto Advance = [num_out_rows](int64_t* outer_idx, int64_t* i) {
+          *i += 1;
+          if (*i == num_out_rows) {
+            *i = 0;
+            *outer_idx += 1;
+          }
+        };
+        const auto Prefetch = [&](int64_t outer_idx, int64_t i) {
+          const int64_t row = row_of(i);
+          if (row >= 0) {
+            PrefetchRow(in + (outer_idx * num_in_rows + row) * row_size, row_size * sizeof(T));
+          }
+        };
+        const int64_t warmup_end = std::min(begin + kPrefetchRowDistance, end);
+        for (int64_t r = begin; r < warmup_end; ++r) {
+          Prefetch(ahead_outer_idx, ahead_i);
+          Advance(&ahead_outer_idx, &ahead_i);
+        }
+        for (int64_t r = begin; r < end; ++r) {
+          if (r + kPrefetchRowDistance < end) {
+            Prefetch(ahead_outer_idx, ahead_i);
+            Advance(&ahead_outer_idx, &ahead_i);
+          }
+          const int64_t row = row_of(i);
+          T* to = out + r * row_size;
+          if (row >= 0) {
+            const T* from = in + (outer_idx * num_in_rows + row) * row_size;
+            std::copy(from, from + row_size, to);
+          } else {
+            std::memset(reinterpret_cast<void*>(to), 0, row_size * sizeof(T));
+          }
+          Advance(&outer_idx, &i);
+        }
+      },
+      grain);
+}
+
+// out[o][segment_of(i)] += data[o][i] for o < outer_dim_size and i < num_data_rows, rows are
+// row_size elements long. Data rows with a negative segment are skipped, segment_of must return a
+// segment below num_segments otherwise. Once all rows of a segment have been added,
+// finalize(segment, num_rows_of_segment, out_row) is called on its output row of every outer index.
+template<typename T, typename SegmentFn, typename FinalizeFn>
+void SegmentSum(ep::CpuStream* stream, const T* data, int64_t outer_dim_size, int64_t num_data_rows,
+                int64_t num_segments, int64_t row_size, const SegmentFn& segment_of,
+                const FinalizeFn& finalize, T* out) {
+  if (outer_dim_size == 0 || num_data_rows == 0 || num_segments == 0 || row_size == 0) { return; }
+  std::vector<int64_t> segments(num_data_rows);
+  stream->ParallelFor(
+      0, num_data_rows,
+      [&](int64_t begin, int64_t end) {
+        for (int64_t i = begin; i < end; ++i) { segments[i] = segment_of(i); }
+      },
+      kParallelGrainElemCnt);
+
+  const int64_t work = outer_dim_size * num_data_rows * row_size;
+  const int64_t num_threads = stream->device()->GetNumThreads();
+  const int64_t num_buckets =
+      (work < kParallelGrainElemCnt || num_threads <= 1)
+          ? 1
+          : std::min<int64_t>(num_threads * kBucketsPerThread, num_segments);
+  const auto BucketOf = [&](int64_t segment) { return segment * num_buckets / num_segments; };
+
+  // Counting sort of the data rows by bucket, stable so each bucket keeps ascending rows.
+  std::vector<int64_t> bucket_offsets(num_buckets + 1, 0);
+  for (int64_t i = 0; i < num_data_rows; ++i) {
+    if (segments[i] >= 0) { bucket_offsets[BucketOf(segments[i]) + 1] += 1; }
+  }
+  for (int64_t b = 0; b < num_buckets; ++b) { bucket_offsets[b + 1] += bucket_offsets[b]; }
+  std::vector<int64_t> order(bucket_offsets[num_buckets]);
+  {
+    std::vector<int64_t> cursors(bucket_offsets.begin(), bucket_offsets.end() - 1);
+    for (int64_t i = 0; i < num_data_rows; ++i) {
+      if (segments[i] >= 0) { order[cursors[BucketOf(segments[i])]++] = i; }
+    }
+  }
+  const auto ByRow = [&](int64_t a, int64_t b) {
+    return segments[a] < segments[b] || (segments[a] == segments[b] && a < b);
+  };
+  stream->ParallelFor(
+      0, num_buckets,
+      [&](int64_t begin, int64_t end) {
+        for (int64_t b = begin; b < end; ++b) {
+          std::sort(order.begin() + bucket_offsets[b], order.begin() + bucket_offsets[b + 1],
+                    ByRow);
+        }
+      },
+      1);
+
+  const int64_t rows_per_bucket = std::max<int64_t>(order.size() / num_buckets, 1);
+  const int64_t grain = std::max<int64_t>(kParallelGrainElemCnt / (rows_per_bucket * row_size), 1);
+  stream->ParallelFor(
+      0, outer_dim_size * num_buckets,
+      [&](int64_t begin, int64_t end) {
+        for (int64_t task = begin; task < end; ++task) {
+          const int64_t outer_idx = task / num_buckets;
+          const int64_t bucket = task - outer_idx * num_buckets;
+          const T* outer_data = data + outer_idx * num_data_rows * row_size;
+          T* outer_out = out + outer_idx * num_segments * row_size;
+          int64_t run_begin = bucket_offsets[bucket];
+          const int64_t bucket_end = bucket_offsets[bucket + 1];
+          while (run_begin < bucket_end) {
+            const int64_t segment = segments[order[run_begin]];
+            T* to = outer_out + segment * row_size;
+            int64_t run_end = run_begin;
+            while (run_end < bucket_end && segments[order[run_end]] == segment) {
+              const T* from = outer_data + order[run_end] * row_size;
+              std::transform(from, from + row_size, to, to, std::plus<T>());
+              run_end += 1;
+            }
+            finalize(segment, run_end - run_begin, to);
+            run_begin = run_end;
+          }
+        }
+      },
+      grain);
+}
+
+template<typename T, typename SegmentFn>
+void SegmentSum(ep::CpuStream* stream, const T* data, int64_t outer_dim_size, int64_t num_data_rows,
+                int64_t num_segments, int64_t row_size, const SegmentFn& segment_of, T* out) {
+  SegmentSum(stream, data, outer_dim_size, num_data_rows, num_segments, row_size, segment_of,
+             [](int64_t, int64_t, T*) {}, out);
+}
+
+}  // namespace sparse_access_cpu
+
+}  // namespace oneflow
+
+#endif  // ONEFLOW_USER_KERNELS_SPARSE_ACCESS_CPU_KERNEL_UTIL_H_
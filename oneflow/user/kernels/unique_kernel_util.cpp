@@ -14,9 +14,277 @@ See the License for the specific language governing permissions and
 limitations under the License.
 */
 #include "oneflow/user/kernels/unique_kernel_util.h"
+#include "oneflow/core/ep/cpu/cpu_stream.h"
+#include "oneflow/core/ep/cpu/cpu_device.h"
 
 namespace oneflow {
 
+namespace {
+
+// Inputs at least this long are partitioned by hash and the partitions are built in parallel.
+constexpr int64_t kParallelUniqueMinSize = 65536;
+
+// Elementwise passes are handed out to threads in tasks of at least this many elements.
+constexpr int64_t kParallelGrainElemCnt = 32768;
+
+// The slots of the table are probed in groups of kGroupWidth control bytes, which are loaded as
+// one uint64_t and matched all at once.
+constexpr int64_t kGroupWidth = 8;
+constexpr uint64_t kLowBits = 0x0101010101010101ULL;
+constexpr uint64_t kHighBits = 0x8080808080808080ULL;
+// The control byte of an empty slot, a full slot keeps the low 7 bits of the hash of its key.
+constexpr uint8_t kEmptyCtrl = 0x80;
+
+template<typename KEY>
+uint64_t HashKey(KEY key) {
+  // NOTE: -0.0 and 0.0 compare equal and must hash equal, NaN never finds itself as before.
+  if (key == 0) { key = 0; }
+  uint64_t hash = 0;
+  std::memcpy(&hash, &key, sizeof(KEY));
+  // The finalizer of MurmurHash3, every input bit affects the partition and the control bits.
+  hash ^= hash >> 33;
+  hash *= 0xff51afd7ed558ccdULL;
+  hash ^= hash >> 33;
+  hash *= 0xc4ceb9fe1a85ec53ULL;
+  hash ^= hash >> 33;
+  return hash;
+}
+
+template<typename KEY>
+bool IsNaN(KEY key) {
+  if constexpr (std::is_floating_point<KEY>::value) {
+    return std::isnan(key);
+  } else {
+    return false;
+  }
+}
+
+// An insert only open addressing table from keys to the ids of their first insertion. The table
+// is sized up front for the number of keys it may see and never rehashes. Probing is linear over
+// groups of slots: the control bytes of a group are compared against the 7 hash bits of the key
+// in one SWAR step, and a group with an empty slot ends the probe sequence since nothing is ever
+// erased.
+template<typename KEY>
+class FlatUniqueTable final {
+ public:
+  OF_DISALLOW_COPY_AND_MOVE(FlatUniqueTable);
+  explicit FlatUniqueTable(int64_t max_size) : size_(0) {
+    int64_t num_groups = 1;
+    while (num_groups * kGroupWidth < 2 * max_size) { num_groups *= 2; }
+    group_mask_ = num_groups - 1;
+    ctrl_.resize(num_groups * kGroupWidth, kEmptyCtrl);
+    keys_.resize(num_groups * kGroupWidth);
+    ids_.resize(num_groups * kGroupWidth);
+  }
+  ~FlatUniqueTable() = default;
+
+  int64_t size() const { return size_; }
+
+  // Returns the id of key, a new key gets id size() and sets *inserted.
+  int64_t FindOrInsert(KEY key, uint64_t hash, bool* inserted) {
+    const uint8_t h2 = static_cast<uint8_t>(hash & 0x7f);
+    const uint64_t h2_pattern = kLowBits * h2;
+    int64_t group = static_cast<int64_t>(hash >> 7) & group_mask_;
+    while (true) {
+      uint64_t ctrl = 0;
+      std::memcpy(&ctrl, ctrl_.data() + group * kGroupWidth, kGroupWidth);
+      // Bytes equal to h2 become zero, the classic has-zero-byte test flags them. It may flag a
+      // byte above a real match too, which the key compare sorts out.
+      const uint64_t diff = ctrl ^ h2_pattern;
+      uint64_t matches = (diff - kLowBits) & ~diff & kHighBits;
+      while (matches != 0) {
+        const int64_t slot = group * kGroupWidth + __builtin_ctzll(matches) / 8;
+        if (ctrl_[slot] == h2 && keys_[slot] == key) {
+          *inserted = false;
+          return ids_[slot];
+        }
+        matches &= matches - 1;
+      }
+      const uint64_t empties = ctrl & kHighBits;
+      if (empties != 0) {
+        const int64_t slot = group * kGroupWidth + __builtin_ctzll(empties) / 8;
+        ctrl_[slot] = h2;
+        keys_[slot] = key;
+        ids_[slot] = size_;
+        *inserted = true;
+        return size_++;
+      }
+      group = (group + 1) & group_mask_;
+    }
+  }
+
+ private:
+  int64_t size_;
+  int64_t group_mask_;
+  std::vector<uint8_t> ctrl_;
+  std::vector<KEY> keys_;
+  std::vector<int64_t> ids_;
+};
+
+// Ids are assigned in the order of first occurrence. Large inputs are scattered into hash
+// partitions in input order, so that every partition sees its keys in input order and can be
+// built by one thread without locks. Each element gets the provisional id partition_begin + local
+// id, which is unique across partitions, and a final scan over the first occurrences in input
+// order turns the provisional ids into the final ones.
+template<typename KEY, typename IDX>
+void FlatUnique(ep::CpuStream* stream, int64_t n, const KEY* in, IDX* num_unique, KEY* unique_out,
+                IDX* idx_out, IDX* count, bool sorted) {
+  if (n == 0) {
+    *num_unique = 0;
+    return;
+  }
+  const int64_t num_threads = stream->device()->GetNumThreads();
+  int32_t partition_bits = 0;
+  if (n >= kParallelUniqueMinSize) {
+    while ((int64_t(1) << partition_bits) < 4 * num_threads) { partition_bits += 1; }
+  }
+  const int64_t num_partitions = int64_t(1) << partition_bits;
+  auto partition_of = [partition_bits](uint64_t hash) -> int64_t {
+    return partition_bits == 0 ? 0 : static_cast<int64_t>(hash >> (64 - partition_bits));
+  };
+
+  // order lists the positions of partition p in [partition_begin[p], partition_begin[p + 1]).
+  std::vector<int64_t> partition_begin(num_partitions + 1, 0);
+  std::vector<int64_t> order;
+  if (num_partitions == 1) {
+    partition_begin[1] = n;
+  } else {
+    const int64_t num_chunks = num_threads;
+    auto chunk_begin = [&](int64_t chunk) { return n * chunk / num_chunks; };
+    std::vector<int64_t> offsets(num_chunks * num_partitions, 0);
+    stream->ParallelFor(
+        0, num_chunks,
+        [&](int64_t begin, int64_t end) {
+          for (int64_t chunk = begin; chunk < end; ++chunk) {
+            int64_t* chunk_counts = offsets.data() + chunk * num_partitions;
+            for (int64_t i = chunk_begin(chunk); i < chunk_begin(chunk + 1); ++i) {
+              chunk_counts[partition_of(HashKey(in[i]))] += 1;
+            }
+          }
+        },
+        1);
+    int64_t offset = 0;
+    for (int64_t p = 0; p < num_partitions; ++p) {
+      partition_begin[p] = offset;
+      for (int64_t chunk = 0; chunk < num_chunks; ++chunk) {
+        const int64_t chunk_count = offsets[chunk * num_partitions + p];
+        offsets[chunk * num_partitions + p] = offset;
+        offset += chunk_count;
+      }
+    }
+    partition_begin[num_partitions] = offset;
+    order.resize(n);
+    stream->ParallelFor(
+        0, num_chunks,
+        [&](int64_t begin, int64_t end) {
+          for (int64_t chunk = begin; chunk < end; ++chunk) {
+            int64_t* chunk_offsets = offsets.data() + chunk * num_partitions;
+            for (int64_t i = chunk_begin(chunk); i < chunk_begin(chunk + 1); ++i) {
+              order[chunk_offsets[partition_of(HashKey(in[i]))]++] = i;
+            }
+          }
+        },
+        1);
+  }
+
+  // Builds write the provisional ids to idx_out, mark the first occurrences and count.
+  std::vector<uint8_t> is_first(n, 0);
+  std::vector<int64_t> provisional_count(count != nullptr ? n : 0, 0);
+  stream->ParallelFor(
+      0, num_partitions,
+      [&](int64_t begin, int64_t end) {
+        for (int64_t p = begin; p < end; ++p) {
+          const int64_t base = partition_begin[p];
+          FlatUniqueTable<KEY> table(partition_begin[p + 1] - base);
+          for (int64_t j = base; j < partition_begin[p + 1]; ++j) {
+            const int64_t i = num_partitions == 1 ? j : order[j];
+            bool inserted = false;
+            const int64_t id = base + table.FindOrInsert(in[i], HashKey(in[i]), &inserted);
+            idx_out[i] = static_cast<IDX>(id);
+            if (inserted) { is_first[i] = 1; }
+            if (count != nullptr) { provisional_count[id] += 1; }
+          }
+        }
+      },
+      1);
+
+  // Numbers the first occurrences in input order, chunk by chunk.
+  const int64_t num_chunks = std::max<int64_t>(
+      1, std::min<int64_t>(num_threads, n / kParallelGrainElemCnt));
+  auto chunk_begin = [&](int64_t chunk) { return n * chunk / num_chunks; };
+  std::vector<int64_t> chunk_first_offsets(num_chunks + 1, 0);
+  stream->ParallelFor(
+      0, num_chunks,
+      [&](int64_t begin, int64_t end) {
+        for (int64_t chunk = begin; chunk < end; ++chunk) {
+          int64_t num_firsts = 0;
+          for (int64_t i = chunk_begin(chunk); i < chunk_begin(chunk + 1); ++i) {
+            num_firsts += is_first[i];
+          }
+          chunk_first_offsets[chunk + 1] = num_firsts;
+        }
+      },
+      1);
+  for (int64_t chunk = 0; chunk < num_chunks; ++chunk) {
+    chunk_first_offsets[chunk + 1] += chunk_first_offsets[chunk];
+  }
+  const int64_t unique_size = chunk_first_offsets[num_chunks];
+  std::vector<IDX> final_id(n);
+  stream->ParallelFor(
+      0, num_chunks,
+      [&](int64_t begin, int64_t end) {
+        for (int64_t chunk = begin; chunk < end; ++chunk) {
+          int64_t id = chunk_first_offsets[chunk];
+          for (int64_t i = chunk_begin(chunk); i < chunk_begin(chunk + 1); ++i) {
+            if (!is_first[i]) { continue; }
+            final_id[idx_out[i]] = static_cast<IDX>(id);
+            unique_out[id] = in[i];
+            if (count != nullptr) {
+              count[id] = static_cast<IDX>(provisional_count[idx_out[i]]);
+            }
+            id += 1;
+          }
+        }
+      },
+      1);
+
+  std::vector<IDX> sorted_id;
+  if (sorted) {
+    // Only the unique keys are sorted, their new positions are folded into the final ids.
+    std::vector<int64_t> sorted_idx(unique_size);
+    std::iota(sorted_idx.begin(), sorted_idx.end(), 0);
+    // NaN keys go last as in torch, in the order they were met, so that the order stays strict
+    // and weak (every NaN is a unique key of its own).
+    std::sort(sorted_idx.begin(), sorted_idx.end(), [&](int64_t a, int64_t b) {
+      const bool a_is_nan = IsNaN(unique_out[a]);
+      if (IsNaN(unique_out[b])) { return !a_is_nan || a < b; }
+      return !a_is_nan && unique_out[a] < unique_out[b];
+    });
+    std::vector<KEY> unsorted_keys(unique_out, unique_out + unique_size);
+    std::vector<IDX> unsorted_count(count != nullptr ? unique_size : 0);
+    if (count != nullptr) { std::copy(count, count + unique_size, unsorted_count.begin()); }
+    sorted_id.resize(unique_size);
+    for (int64_t rank = 0; rank < unique_size; ++rank) {
+      const int64_t id = sorted_idx[rank];
+      sorted_id[id] = static_cast<IDX>(rank);
+      unique_out[rank] = unsorted_keys[id];
+      if (count != nullptr) { count[rank] = unsorted_count[id]; }
+    }
+  }
+  stream->ParallelFor(
+      0, n,
+      [&](int64_t begin, int64_t end) {
+        for (int64_t i = begin; i < end; ++i) {
+          const IDX id = final_id[idx_out[i]];
+          idx_out[i] = sorted ? sorted_id[id] : id;
+        }
+      },
+      kParallelGrainElemCnt);
+  *num_unique = static_cast<IDX>(unique_size);
+}
+
+}  // namespace
+
 template<typename KEY, typename IDX>
 struct UniqueKernelUtil<DeviceType::kCPU, KEY, IDX> {
   static void Unique(ep::Stream* stream, int64_t n, const KEY* in, IDX* num_unique, KEY* unique_out,
@@ -28,32 +296,9 @@ struct UniqueKernelUtil<DeviceType::kCPU, KEY, IDX> {
   static void UniqueWithCounts(ep::Stream* stream, int64_t n, const KEY* in, IDX* num_unique,
                                KEY* unique_out, IDX* idx_out, IDX* count, void* workspace,
                                int64_t workspace_size_in_bytes, bool sorted) {
-    std::vector<int64_t> sorted_idx(n);
-    std::iota(sorted_idx.begin(), sorted_idx.end(), 0);
-    if (sorted) {
-      std::sort(sorted_idx.begin(), sorted_idx.end(),
-                [&in](size_t a, size_t b) { return in[a] < in[b]; });
-    }
-
-    HashMap<KEY, IDX> map;
-    for (int64_t i : sorted_idx) {
-      KEY in_i = in[i];
-      auto it = map.find(in_i);
-      if (it == map.end()) {
-        IDX idx = map.size();
-        if (count != nullptr) { count[idx] = 1; }
-        idx_out[i] = idx;
-        unique_out[idx] = in_i;
-        map[in_i] = idx;
-      } else {
-        IDX idx = it->second;
-        if (count != nullptr) { count[idx] += 1; }
-        idx_out[i] = idx;
-      }
-    }
-    *num_unique = map.size();
+    FlatUnique<KEY, IDX>(stream->As<ep::CpuStream>(), n, in, num_unique, unique_out, idx_out,
+                         count, sorted);
   }
-
   static void GetUniqueWorkspaceSizeInBytes(ep::Stream* stream, int64_t n,
                                             int64_t* workspace_size_in_bytes) {
     *workspace_size_in_bytes = 1;
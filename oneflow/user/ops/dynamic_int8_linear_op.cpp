@@ -0,0 +1,67 @@
+/*
+Copyright 2020 The OneFlow Authors. All rights reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+#include "oneflow/core/framework/framework.h"
+#include "oneflow/core/framework/op_generated.h"
+
+namespace oneflow {
+
+/* static */ Maybe<void> DynamicInt8LinearOp::InferLogicalTensorDesc(user_op::InferContext* ctx) {
+  const user_op::TensorDesc& x_desc = ctx->InputTensorDesc("x", 0);
+  CHECK_GE_OR_RETURN(x_desc.shape().NumAxes(), 2);
+  const int64_t k = x_desc.shape().At(x_desc.shape().NumAxes() - 1);
+  const user_op::TensorDesc& w_desc = ctx->InputTensorDesc("w", 0);
+  CHECK_EQ_OR_RETURN(w_desc.shape().NumAxes(), 2);
+  CHECK_EQ_OR_RETURN(w_desc.shape().At(1), k);
+  Shape out_shape = x_desc.shape();
+  out_shape[x_desc.shape().NumAxes() - 1] = w_desc.shape().At(0);
+  ctx->SetOutputShape("out", 0, out_shape);
+  return Maybe<void>::Ok();
+}
+
+/*static*/ Maybe<void> DynamicInt8LinearOp::InferPhysicalTensorDesc(user_op::InferContext* ctx) {
+  return InferLogicalTensorDesc(ctx);
+}
+
+/* static */ Maybe<void> DynamicInt8LinearOp::GetSbp(user_op::SbpContext* ctx) {
+  // (b, m, k) * (n, k). x is quantized with one scale over the whole tensor and w with one scale
+  // per row, so k can not be split: the partial sums would use different scales.
+  const auto& x_shape = ctx->LogicalTensorDesc4InputArgNameAndIndex("x", 0).shape();
+  const int64_t num_axes = x_shape.NumAxes();
+  for (int64_t i = 0; i < num_axes - 1; ++i) {
+    ctx->NewBuilder()
+        .Split(user_op::OpArg("x", 0), i)
+        .Broadcast(user_op::OpArg("w", 0))
+        .Split(user_op::OpArg("out", 0), i)
+        .Build();
+  }
+  ctx->NewBuilder()
+      .Broadcast(user_op::OpArg("x", 0))
+      .Split(user_op::OpArg("w", 0), 0)
+      .Split(user_op::OpArg("out", 0), num_axes - 1)
+      .Build();
+  return Maybe<void>::Ok();
+}
+
+/* static */ Maybe<void> DynamicInt8LinearOp::InferDataType(user_op::InferContext* ctx) {
+  CHECK_EQ_OR_RETURN(ctx->InputDType("x", 0), DataType::kFloat)
+      << "dynamic_int8_linear only supports float32 input";
+  CHECK_EQ_OR_RETURN(ctx->InputDType("w", 0), DataType::kFloat)
+      << "dynamic_int8_linear only supports float32 weight";
+  ctx->SetOutputDType("out", 0, DataType::kFloat);
+  return Maybe<void>::Ok();
+}
+
+}  // namespace oneflow
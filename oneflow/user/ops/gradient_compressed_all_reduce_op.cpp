@@ -0,0 +1,111 @@
+/*
+Copyright 2020 The OneFlow Authors. All rights reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+#include "oneflow/core/framework/framework.h"
+#include "oneflow/core/framework/op_generated.h"
+#include "oneflow/user/kernels/gradient_compression_util.h"
+#include "oneflow/user/ops/comm_net_device_infer_util.h"
+
+namespace oneflow {
+
+namespace {
+
+Maybe<void> SetInputArgModifierMutable(const user_op::GetInputArgModifier& GetInputArgModifierFn,
+                                       const std::string& arg_name, int32_t arg_index) {
+  user_op::InputArgModifier* arg_modifier = GetInputArgModifierFn(arg_name, arg_index);
+  CHECK_NOTNULL_OR_RETURN(arg_modifier);
+  arg_modifier->set_is_mutable(true);
+  return Maybe<void>::Ok();
+}
+
+}  // namespace
+
+/* static */ Maybe<void> GradientCompressedAllReduceOp::InferLogicalTensorDesc(
+    user_op::InferContext* ctx) {
+  ctx->SetOutputShape("out", 0, ctx->InputShape("in", 0));
+  return Maybe<void>::Ok();
+}
+
+/* static */ Maybe<void> GradientCompressedAllReduceOp::InferPhysicalTensorDesc(
+    user_op::InferContext* ctx) {
+  const Shape& in_shape = ctx->InputShape("in", 0);
+  if (ctx->has_input("error", 0)) {
+    CHECK_EQ_OR_RETURN(ctx->InputShape("error", 0).elem_cnt(), in_shape.elem_cnt())
+        << "the error feedback buffer should have as many elements as the gradient";
+  }
+  if (ctx->has_input("q", 0)) {
+    const Shape& q_shape = ctx->InputShape("q", 0);
+    CHECK_EQ_OR_RETURN(q_shape.NumAxes(), 2) << "the PowerSGD factor should be a matrix";
+    CHECK_GT_OR_RETURN(q_shape.At(0), 0);
+    CHECK_EQ_OR_RETURN(in_shape.elem_cnt() % q_shape.At(0), 0)
+        << "the gradient can not be viewed as a matrix with " << q_shape.At(0) << " columns";
+  }
+  ctx->SetOutputShape("out", 0, in_shape);
+  return Maybe<void>::Ok();
+}
+
+/* static */ Maybe<void> GradientCompressedAllReduceOp::GetSbp(user_op::SbpContext* ctx) {
+  // Every rank keeps the error feedback of its own gradient, so the buffer is split over ranks.
+  auto builder = ctx->NewBuilder()
+                     .PartialSum(user_op::OpArg("in", 0))
+                     .Broadcast(user_op::OpArg("out", 0));
+  if (ctx->user_op_conf().has_input("error", 0)) {
+    builder.Split(user_op::OpArg("error", 0), 0);
+  }
+  if (ctx->user_op_conf().has_input("q", 0)) { builder.Broadcast(user_op::OpArg("q", 0)); }
+  builder.Build();
+  return Maybe<void>::Ok();
+}
+
+/* static */ Maybe<void> GradientCompressedAllReduceOp::CheckAttr(
+    const user_op::UserOpDefWrapper&, const user_op::UserOpConfWrapper& conf) {
+  const GradientCompressionMethod method =
+      JUST(ParseGradientCompressionMethod(conf.attr<std::string>("method")));
+  if (method == GradientCompressionMethod::kTopK) {
+    const float top_k_ratio = conf.attr<float>("top_k_ratio");
+    CHECK_OR_RETURN(top_k_ratio > 0 && top_k_ratio <= 1)
+        << "top_k_ratio should be in (0, 1], but got " << top_k_ratio;
+  }
+  return Maybe<void>::Ok();
+}
+
+/* static */ Maybe<void> GradientCompressedAllReduceOp::InferDataType(user_op::InferContext* ctx) {
+  const DataType data_type = ctx->InputDType("in", 0);
+  CHECK_EQ_OR_RETURN(data_type, DataType::kFloat)
+      << "gradient compression only supports float gradients";
+  for (const char* arg_name : {"error", "q"}) {
+    if (ctx->has_input(arg_name, 0)) {
+      CHECK_EQ_OR_RETURN(ctx->InputDType(arg_name, 0), data_type);
+    }
+  }
+  ctx->SetOutputDType("out", 0, data_type);
+  return Maybe<void>::Ok();
+}
+
+/* static */ Maybe<Symbol<Stream>> GradientCompressedAllReduceOp::InferDeviceAndStream(
+    user_op::DeviceAndStreamInferContext* ctx) {
+  return DeviceAndStreamInferFn(ctx);
+}
+
+/* static */ Maybe<void> GradientCompressedAllReduceOp::ModifyInputArg(
+    const GetInputArgModifier& GetInputArgModifierFn, const user_op::UserOpConfWrapper& conf) {
+  if (conf.has_input("error", 0)) {
+    JUST(SetInputArgModifierMutable(GetInputArgModifierFn, "error", 0));
+  }
+  if (conf.has_input("q", 0)) { JUST(SetInputArgModifierMutable(GetInputArgModifierFn, "q", 0)); }
+  return Maybe<void>::Ok();
+}
+
+}  // namespace oneflow
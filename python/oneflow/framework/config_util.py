@@ -95,6 +95,17 @@ def api_numa_aware_cuda_malloc_host(val: bool = True) -> None:
     )
 
 
+def api_enable_numa_affinity(val: bool = True) -> None:
+    """Whether or not pin the actor threads of cpu streams and their host register memory to the numa node of this process.
+
+    Args:
+        val (bool, optional): True or False. Defaults to True.
+    """
+
+    attrs, type_ = api_attrs_and_type[api_enable_numa_affinity]
+    _set_resource_attr(attrs, val, type_)
+
+
 def api_reserved_device_mem_mbyte(val: int) -> None:
     """Set up the memory size of reserved device
     Args:
@@ -281,7 +292,63 @@ def api_nccl_enable_mixed_fusion(val: bool) -> None:
     _set_resource_attr(attrs, val, type_)
 
 
+def api_cpu_enable_collective_boxing(val: bool) -> None:
+    """Whether or not use collective boxing for cpu placements in graph
+
+    Args:
+        val (bool): True or False
+    """
+
+    attrs, type_ = api_attrs_and_type[api_cpu_enable_collective_boxing]
+    _set_resource_attr(attrs, val, type_)
+
+
+def api_cpu_num_threads(val: int) -> None:
+    """Set up the number of cpu collective boxing threads, requests of different placements run on them in parallel
+
+    Args:
+        val (int): number of threads
+    """
+
+    attrs, type_ = api_attrs_and_type[api_cpu_num_threads]
+    _set_resource_attr(attrs, val, type_)
+
+
+def api_cpu_fusion_threshold_mb(val: int) -> None:
+    """Set up threshold for cpu all-reduce fusion
+
+    Args:
+        val (int): int number, e.g. 10(mb)
+    """
+
+    attrs, type_ = api_attrs_and_type[api_cpu_fusion_threshold_mb]
+    _set_resource_attr(attrs, val, type_)
+
+
+def api_cpu_fusion_max_ops(val: int) -> None:
+    """Maximum number of ops for cpu all-reduce fusion.
+
+    Args:
+        val (int): Maximum number of ops
+    """
+
+    attrs, type_ = api_attrs_and_type[api_cpu_fusion_max_ops]
+    _set_resource_attr(attrs, val, type_)
+
+
+def api_cpu_fusion_all_reduce(val: bool) -> None:
+    """Whether or not fuse cpu all-reduce requests
+
+    Args:
+        val (bool): True or False
+    """
+
+    attrs, type_ = api_attrs_and_type[api_cpu_fusion_all_reduce]
+    _set_resource_attr(attrs, val, type_)
+
+
 api_attrs_and_type = {
+    api_enable_numa_affinity: (["numa_affinity_conf", "enable_numa_affinity"], bool),
     api_reserved_device_mem_mbyte: ("reserved_device_mem_mbyte", int),
     api_enable_cudnn_fused_normalization_add_relu: (
         ["cudnn_conf", "enable_cudnn_fused_normalization_add_relu"],
@@ -332,4 +399,18 @@ api_attrs_and_type = {
         ["collective_boxing_conf", "nccl_enable_mixed_fusion"],
         bool,
     ),
+    api_cpu_enable_collective_boxing: (
+        ["collective_boxing_conf", "cpu_enable_collective_boxing"],
+        bool,
+    ),
+    api_cpu_num_threads: (["collective_boxing_conf", "cpu_num_threads"], int),
+    api_cpu_fusion_threshold_mb: (
+        ["collective_boxing_conf", "cpu_fusion_threshold_mb"],
+        int,
+    ),
+    api_cpu_fusion_max_ops: (["collective_boxing_conf", "cpu_fusion_max_ops"], int),
+    api_cpu_fusion_all_reduce: (
+        ["collective_boxing_conf", "cpu_fusion_all_reduce"],
+        bool,
+    ),
 }
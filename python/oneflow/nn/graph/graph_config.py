@@ -216,6 +216,48 @@ class GraphConfig(object):
         """
         self.proto.enable_fuse_cast_scale = mode
 
+    def enable_cpu_int8_linear(self, mode: bool = True):
+        r"""If set to true, run the fake quantized linear layers of an eval graph on CPU with int8
+        matmuls.
+
+        A ``flow.matmul(x, w, transpose_b=True)`` whose weight ``w`` is a parameter fake quantized
+        with per-channel symmetric 8 bit ``MinMaxObserver`` scales (the "google" formula) is
+        rewritten into one ``dynamic_int8_linear`` op. The weight is quantized per channel and
+        ``x`` with one symmetric scale on every run, which differs from the float activations of
+        fake quantization by the activation rounding error.
+
+        For example:
+
+        .. code-block:: python
+
+            import oneflow as flow
+
+            class QuantLinear(flow.nn.Module):
+                def __init__(self):
+                    super().__init__()
+                    self.weight = flow.nn.Parameter(flow.randn(8, 3))
+                    self.observer = flow.nn.MinMaxObserver(per_layer_quantization=False)
+                    self.fake_quant = flow.nn.FakeQuantization()
+                def forward(self, x):
+                    scale, zero_point = self.observer(self.weight)
+                    w = self.fake_quant(self.weight, scale, zero_point)
+                    return flow.matmul(x, w, transpose_b=True)
+
+            class Graph(flow.nn.Graph):
+                def __init__(self):
+                    super().__init__()
+                    self.m = QuantLinear()
+                    self.config.enable_cpu_int8_linear(True)
+                def build(self, x):
+                    return self.m(x)
+
+            graph = Graph()
+
+        Args:
+            mode (bool, optional): The default value is True.
+        """
+        self.proto.enable_cpu_int8_linear = mode
+
     def set_gradient_accumulation_steps(self, value):
         r"""Set num of steps to accumulate gradient.
 
@@ -421,6 +463,20 @@ class GraphConfig(object):
         """
         self.proto.enable_auto_parallel_sbp_collector = mode
 
+    def enable_auto_parallel_scalable_search(self, mode: bool = True):
+        """
+        Split the SBP graph into regions and search the strategy of the regions in parallel,
+        which reduces the compile time of large graphs.
+        """
+        self.proto.enable_auto_parallel_scalable_search = mode
+
+    def set_auto_parallel_search_time_limit(self, seconds: float):
+        """
+        Set the wall-clock budget of the auto-parallel search. The search stops when running out
+        of time and keeps the best strategy found so far. A non-positive value means no limit.
+        """
+        self.proto.auto_parallel_search_time_limit = seconds
+
     def enable_auto_memory(self, mode: str = "AdaptiveMemory"):
         r""" Whether we use a parallelism strategy with less memory
 
@@ -141,6 +141,15 @@ class GroupNorm(Module):
         )
 
 
+def _has_fused_layer_norm_kernel(input):
+    if input.is_cuda:
+        return True
+    device_type = input.placement.type if input.is_global else input.device.type
+    return device_type == "cpu" and input.dtype in (
+        flow.float32, flow.float64, flow.bfloat16
+    )
+
+
 def layer_norm(input, normalized_shape, weight=None, bias=None, eps=1e-05):
     assert len(input.shape) > len(
         normalized_shape
@@ -156,7 +165,7 @@ def layer_norm(input, normalized_shape, weight=None, bias=None, eps=1e-05):
                 f"Given normalized_shape={normalized_shape}, expected input with shape [*, {str(normalized_shape)[1:-1]}], but got input of size {input.shape}"
             )
 
-    if not input.is_cuda:
+    if not _has_fused_layer_norm_kernel(input):
         reduce_axis = []
         for dim in range(len(input.shape)):
             if dim >= begin_norm_axis:
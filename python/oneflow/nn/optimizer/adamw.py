@@ -333,6 +333,9 @@ class AdamW(Optimizer):
             optimizer_conf.weight_decay_conf.weight_decay_rate = weight_decay
 
             self._generate_grad_clip_conf_for_optim_conf(param_group, optimizer_conf)
+            self._generate_gradient_compression_conf_for_optim_conf(
+                param_group, optimizer_conf
+            )
 
             for param in param_group.parameters:
                 if param.requires_grad:
@@ -255,6 +255,9 @@ class LAMB(Optimizer):
             optimizer_conf.lamb_conf.do_bias_correction = do_bias_correction
 
             self._generate_grad_clip_conf_for_optim_conf(param_group, optimizer_conf)
+            self._generate_gradient_compression_conf_for_optim_conf(
+                param_group, optimizer_conf
+            )
 
             if adam_w_mode:
                 optimizer_conf.weight_decay_conf.weight_decay_rate = weight_decay
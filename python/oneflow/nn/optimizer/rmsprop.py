@@ -259,6 +259,9 @@ class RMSprop(Optimizer):
             optimizer_conf.rmsprop_conf.epsilon = epslion
 
             self._generate_grad_clip_conf_for_optim_conf(param_group, optimizer_conf)
+            self._generate_gradient_compression_conf_for_optim_conf(
+                param_group, optimizer_conf
+            )
 
             # Set l2 penalty as weight decay
             for param in param_group.parameters:
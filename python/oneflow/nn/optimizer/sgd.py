@@ -284,6 +284,9 @@ class SGD(Optimizer):
                 optimizer_conf.momentum_conf.maximize = maximize
 
             self._generate_grad_clip_conf_for_optim_conf(param_group, optimizer_conf)
+            self._generate_gradient_compression_conf_for_optim_conf(
+                param_group, optimizer_conf
+            )
 
             for param in param_group.parameters:
                 vars_conf[param].l2 = l2
@@ -36,6 +36,52 @@ def grad_setting_fn(module, param):
     return grad_setting
 
 
+def _power_sgd_factor_shape(shape, rank):
+    # Keep in sync with GetPowerSgdFactorShape in gradient_compression_util.cpp
+    numel = 1
+    for dim in shape:
+        numel *= dim
+    if len(shape) < 2 or numel == 0 or rank <= 0:
+        return None
+    rows = shape[0]
+    cols = numel // rows
+    rank = min(rank, rows, cols)
+    if (rows + cols) * rank >= rows * cols:
+        return None
+    return (cols, rank)
+
+
+class _GradientCompressionState(object):
+    def __init__(self, param, compression):
+        self.method = compression["method"]
+        self.top_k_ratio = float(compression.get("top_k_ratio", 0.01))
+        self.error = None
+        if compression.get("error_feedback", True):
+            self.error = flow.zeros(param.shape, dtype=param.dtype, device=param.device)
+        self.q = None
+        if self.method == "power_sgd":
+            factor_shape = _power_sgd_factor_shape(
+                param.shape, int(compression.get("power_sgd_rank", 4))
+            )
+            if factor_shape is not None:
+                self.q = flow.zeros(
+                    factor_shape, dtype=param.dtype, device=param.device
+                )
+
+    def all_reduce(self, grad):
+        out = flow._C.local_compressed_all_reduce(
+            grad, self.method, self.error, self.q, self.top_k_ratio
+        )
+        grad.copy_(out)
+
+
+def _all_reduce_grad(module, param, grad):
+    if module._gradient_compression_states is None:
+        flow._C.local_all_reduce(grad, True)
+    else:
+        module._gradient_compression_states[param].all_reduce(grad)
+
+
 def allreduce_fn(module, param, use_bucket):
     ddp_state_for_reversed_params = module._ddp_state_for_reversed_params
 
@@ -58,7 +104,12 @@ def allreduce_fn(module, param, use_bucket):
                     ddp_state_for_reversed_params[x][1] = True
                 # NOTE(jianhao)(higher-order-grad):
                 # local allreduce doesn't have gradient function, higher-order grad may be unsupported
-                flow._C.local_all_reduce(bucket_tensors[index], inplace=True)
+                if module._gradient_compression_states is None:
+                    flow._C.local_all_reduce(bucket_tensors[index], inplace=True)
+                else:
+                    # Compression works per parameter, on the views into the bucket
+                    for x in bucket:
+                        _all_reduce_grad(module, x, x.grad)
             else:
                 break
 
@@ -71,9 +122,9 @@ def allreduce_fn(module, param, use_bucket):
                 ddp_state_for_reversed_params[cur_param][1] = True
                 # NOTE(jianhao)(higher-order-grad): local allreduce doesn't have gradient function, higher-order grad may be unsupported
                 if cur_param is param:
-                    flow._C.local_all_reduce(grad, True)
+                    _all_reduce_grad(module, cur_param, grad)
                 else:
-                    flow._C.local_all_reduce(cur_param.grad, True)
+                    _all_reduce_grad(module, cur_param, cur_param.grad)
             else:
                 break
 
@@ -87,6 +138,7 @@ def DistributedDataParallel(
     broadcast_parameters: bool = True,
     bucket_size: int = 10,
     use_bucket: bool = True,
+    gradient_compression=None,
 ):
     assert all(x.dtype == flow.float32 for x in module.parameters())
     if use_bucket and parse_boolean_from_env("ONEFLOW_DISABLE_VIEW", False):
@@ -155,6 +207,18 @@ def DistributedDataParallel(
         reversed([(x, [False, False]) for x in module.parameters() if x.requires_grad])
     )
     module._ddp_state_for_reversed_params = ddp_state_for_reversed_params
+    # gradient_compression is a method name ("fp16", "bf16", "power_sgd" or "top_k") or
+    # a dict with "method" and the optional "error_feedback", "power_sgd_rank" and
+    # "top_k_ratio", like the "gradient_compression" option of optimizer param groups.
+    module._gradient_compression_states = None
+    if gradient_compression is not None:
+        if isinstance(gradient_compression, str):
+            gradient_compression = {"method": gradient_compression}
+        assert gradient_compression["method"] in ("fp16", "bf16", "power_sgd", "top_k")
+        module._gradient_compression_states = {
+            x: _GradientCompressionState(x, gradient_compression)
+            for x in ddp_state_for_reversed_params.keys()
+        }
     # The gradient shoule be averaged by all the nodes, so besides allreduce,
     # a division by world_size is required.
     # Use x * (1 / world_size) instead of x / world_size for two reasons:
@@ -1223,6 +1223,9 @@ class Ftrl(Optimizer):
             optimizer_conf.ftrl_conf.beta = beta
 
             self._generate_grad_clip_conf_for_optim_conf(param_group, optimizer_conf)
+            self._generate_gradient_compression_conf_for_optim_conf(
+                param_group, optimizer_conf
+            )
 
             for param in param_group.parameters:
                 vars_conf[param].l2 = l2
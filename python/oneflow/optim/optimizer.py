@@ -587,6 +587,35 @@ class Optimizer(object):
         clip_grad_norm.max_norm = max_norm
         clip_grad_norm.norm_type = norm_type
 
+    def _generate_gradient_compression_conf_for_optim_conf(
+        self, param_group, optimizer_conf
+    ):
+        if (
+            "gradient_compression" not in param_group
+            or param_group["gradient_compression"] is None
+        ):
+            return
+
+        # "gradient_compression" is a method name or a dict of GradientCompressionConf fields.
+        compression = param_group["gradient_compression"]
+        if isinstance(compression, str):
+            compression = {"method": compression}
+        assert isinstance(compression, dict) and "method" in compression
+        assert compression["method"] in (
+            "fp16",
+            "bf16",
+            "power_sgd",
+            "top_k",
+        ), f"unsupported gradient compression method {compression['method']}"
+        compression_conf = optimizer_conf.gradient_compression
+        compression_conf.method = compression["method"]
+        if "error_feedback" in compression:
+            compression_conf.error_feedback = bool(compression["error_feedback"])
+        if "power_sgd_rank" in compression:
+            compression_conf.power_sgd_rank = int(compression["power_sgd_rank"])
+        if "top_k_ratio" in compression:
+            compression_conf.top_k_ratio = float(compression["top_k_ratio"])
+
     def _generate_lr_scale_for_optim_conf(self, param_group, optimizer_conf):
         if "lr_scale" not in param_group:
             return
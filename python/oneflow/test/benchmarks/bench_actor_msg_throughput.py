@@ -0,0 +1,63 @@
+"""
+Copyright 2020 The OneFlow Authors. All rights reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+"""
+
+import argparse
+
+import numpy as np
+
+import oneflow as flow
+from benchmark_util import report, time_per_iter
+
+
+class _ReluChain(flow.nn.Module):
+    def __init__(self, length):
+        super().__init__()
+        self.length = length
+
+    def forward(self, x):
+        for _ in range(self.length):
+            x = flow.relu(x)
+        return x
+
+
+class _ChainGraph(flow.nn.Graph):
+    def __init__(self, length):
+        super().__init__()
+        self.chain = _ReluChain(length)
+
+    def build(self, x):
+        return self.chain(x)
+
+
+def bench_naive_actor_chain(length):
+    graph = _ChainGraph(length)
+    x = flow.tensor(np.random.randn(4), dtype=flow.float32)
+    # compile before timing and check the chain still computes relu
+    assert np.allclose(graph(x).numpy(), np.maximum(x.numpy(), 0))
+    cost = time_per_iter(lambda: graph(x))
+    # every actor in the chain sends one regst msg to its consumer and one to its producer
+    msgs = 2 * length
+    report(
+        "naive actor chain of length {}".format(length),
+        ms_per_iter="{:.2f}".format(cost * 1000),
+        actor_msgs_per_s="{:.0f}".format(msgs / cost),
+    )
+
+
+if __name__ == "__main__":
+    parser = argparse.ArgumentParser()
+    parser.add_argument("--length", type=int, default=10000)
+    bench_naive_actor_chain(parser.parse_args().length)
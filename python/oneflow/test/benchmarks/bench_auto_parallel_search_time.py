@@ -0,0 +1,92 @@
+"""
+Copyright 2020 The OneFlow Authors. All rights reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+"""
+
+import argparse
+import time
+
+import oneflow as flow
+from benchmark_util import report
+
+
+class _TransformerLayer(flow.nn.Module):
+    def __init__(self, hidden_size, num_heads):
+        super().__init__()
+        self.num_heads = num_heads
+        self.head_size = hidden_size // num_heads
+        self.qkv = flow.nn.Linear(hidden_size, 3 * hidden_size)
+        self.proj = flow.nn.Linear(hidden_size, hidden_size)
+        self.norm1 = flow.nn.LayerNorm(hidden_size)
+        self.fc1 = flow.nn.Linear(hidden_size, 4 * hidden_size)
+        self.fc2 = flow.nn.Linear(4 * hidden_size, hidden_size)
+        self.norm2 = flow.nn.LayerNorm(hidden_size)
+
+    def forward(self, x):
+        batch_size, seq_len, hidden_size = x.shape
+        q, k, v = (
+            self.qkv(x)
+            .reshape(batch_size, seq_len, 3, self.num_heads, self.head_size)
+            .permute(2, 0, 3, 1, 4)
+            .unbind(0)
+        )
+        scores = flow.matmul(q, k.transpose(-2, -1)) / (self.head_size ** 0.5)
+        attn = flow.matmul(scores.softmax(dim=-1), v)
+        attn = attn.permute(0, 2, 1, 3).reshape(batch_size, seq_len, hidden_size)
+        x = self.norm1(x + self.proj(attn))
+        return self.norm2(x + self.fc2(flow.nn.functional.gelu(self.fc1(x))))
+
+
+def bench_compile_time(num_layers, scalable_search, time_limit):
+    placement = flow.placement.all("cpu")
+    model = flow.nn.Sequential(
+        *[_TransformerLayer(hidden_size=64, num_heads=4) for _ in range(num_layers)]
+    )
+    model.to_global(placement, flow.sbp.broadcast)
+    sgd = flow.optim.SGD(model.parameters(), lr=0.01)
+
+    class TransformerGraph(flow.nn.Graph):
+        def __init__(self):
+            super().__init__()
+            self.model = model
+            self.add_optimizer(sgd)
+            self.config.enable_auto_parallel(True)
+            self.config.enable_auto_parallel_ignore_user_sbp_config(True)
+            self.config.enable_auto_parallel_scalable_search(scalable_search)
+            self.config.set_auto_parallel_search_time_limit(time_limit)
+
+        def build(self, x):
+            loss = self.model(x).sum()
+            loss.backward()
+            return loss
+
+    graph = TransformerGraph()
+    x = flow.randn(8, 16, 64, placement=placement, sbp=flow.sbp.broadcast)
+    start = time.perf_counter()
+    # the first call compiles the graph
+    graph(x).numpy()
+    report(
+        "{}-layer transformer, scalable search {}".format(num_layers, scalable_search),
+        compile_s="{:.2f}".format(time.perf_counter() - start),
+    )
+
+
+if __name__ == "__main__":
+    parser = argparse.ArgumentParser()
+    parser.add_argument("--layers", type=int, default=100)
+    # seconds, non-positive means no limit
+    parser.add_argument("--time_limit", type=float, default=0)
+    args = parser.parse_args()
+    for scalable_search in [False, True]:
+        bench_compile_time(args.layers, scalable_search, args.time_limit)
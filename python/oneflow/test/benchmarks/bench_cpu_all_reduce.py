@@ -0,0 +1,61 @@
+"""
+Copyright 2020 The OneFlow Authors. All rights reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+"""
+
+import os
+
+import numpy as np
+
+import oneflow as flow
+from benchmark_util import report, time_per_iter
+
+
+class _TransportAlgo:
+    """Bypasses the shared memory backend and forces an all-reduce algorithm."""
+
+    def __init__(self, algo):
+        self.algo = algo
+
+    def __enter__(self):
+        os.environ["ONEFLOW_CPU_ENABLE_SHM_COLLECTIVE"] = "0"
+        os.environ["ONEFLOW_CPU_ALL_REDUCE_ALGO"] = self.algo
+
+    def __exit__(self, *args):
+        del os.environ["ONEFLOW_CPU_ENABLE_SHM_COLLECTIVE"]
+        del os.environ["ONEFLOW_CPU_ALL_REDUCE_ALGO"]
+
+
+def bench_all_reduce(algo, elem_cnt):
+    placement = flow.placement("cpu", ranks=list(range(flow.env.get_world_size())))
+    x = flow.tensor(np.ones(elem_cnt, dtype=np.float32))
+
+    def all_reduce():
+        y = x.to_global(placement=placement, sbp=flow.sbp.partial_sum)
+        # the kernel reads the algorithm from the environment when it runs, so wait
+        # for it before _TransportAlgo restores the environment
+        return y.to_global(sbp=flow.sbp.broadcast).to_local().numpy()
+
+    with _TransportAlgo(algo):
+        cost = time_per_iter(all_reduce)
+    report(
+        "cpu all_reduce algo={} bytes={}".format(algo, elem_cnt * 4),
+        us="{:.1f}".format(cost * 1e6),
+    )
+
+
+if __name__ == "__main__":
+    for algo in ["ring", "halving_doubling", "tree", "auto"]:
+        for elem_cnt in [256, 64 * 1024, 4 * 1024 * 1024]:
+            bench_all_reduce(algo, elem_cnt)
@@ -0,0 +1,38 @@
+"""
+Copyright 2020 The OneFlow Authors. All rights reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+"""
+
+import oneflow as flow
+from benchmark_util import report, time_per_iter
+
+
+def bench_all_reduce(method, shape):
+    grad = flow.randn(*shape)
+    if method is None:
+        all_reduce = lambda: flow._C.local_all_reduce(grad)
+    else:
+        # the error feedback buffer and the power_sgd q factor
+        error = flow.zeros(shape)
+        q = flow.zeros(shape[1], 4) if method == "power_sgd" else None
+        all_reduce = lambda: flow._C.local_compressed_all_reduce(grad, method, error, q)
+    cost = time_per_iter(all_reduce)
+    report(
+        "cpu all_reduce compression={}".format(method), us="{:.1f}".format(cost * 1e6)
+    )
+
+
+if __name__ == "__main__":
+    for method in [None, "fp16", "bf16", "power_sgd", "top_k"]:
+        bench_all_reduce(method, (1024, 1024))
@@ -0,0 +1,61 @@
+"""
+Copyright 2020 The OneFlow Authors. All rights reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+"""
+
+import oneflow as flow
+from benchmark_util import report, time_per_iter
+
+
+def _unfused_layer_norm(x, weight, bias, eps):
+    mean = x.mean(dim=-1, keepdim=True)
+    variance = x.var(dim=-1, unbiased=False, keepdim=True)
+    return (x - mean) * (variance + eps).rsqrt() * weight + bias
+
+
+def _fused_layer_norm(x, weight, bias, eps):
+    return flow._C.layer_norm_affine(
+        x,
+        weight,
+        bias,
+        begin_norm_axis=x.ndim - 1,
+        begin_params_axis=x.ndim - 1,
+        epsilon=eps,
+    )
+
+
+def bench_layer_norm(shape):
+    x = flow.randn(*shape, requires_grad=True)
+    weight = flow.randn(shape[-1], requires_grad=True)
+    bias = flow.randn(shape[-1], requires_grad=True)
+    dy = flow.randn(*shape)
+
+    def forward_backward(layer_norm):
+        y = layer_norm(x, weight, bias, 1e-5)
+        y.backward(dy)
+        return y
+
+    fused_cost = time_per_iter(lambda: forward_backward(_fused_layer_norm))
+    unfused_cost = time_per_iter(lambda: forward_backward(_unfused_layer_norm))
+    report(
+        "layer_norm forward+backward {}".format(shape),
+        fused_ms="{:.3f}".format(fused_cost * 1000),
+        unfused_ms="{:.3f}".format(unfused_cost * 1000),
+        speedup="{:.2f}x".format(unfused_cost / fused_cost),
+    )
+
+
+if __name__ == "__main__":
+    # bert-base activations: batch 8, sequence 128, hidden 768
+    bench_layer_norm((8, 128, 768))
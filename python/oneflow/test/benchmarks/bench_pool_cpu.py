@@ -0,0 +1,78 @@
+"""
+Copyright 2020 The OneFlow Authors. All rights reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+"""
+
+import numpy as np
+
+import oneflow as flow
+from benchmark_util import report, time_per_iter
+
+
+def _pool_fn(pool, data_format):
+    if pool == "max":
+        return lambda t: flow._C.max_pool2d(
+            t,
+            kernel_size=(3, 3),
+            stride=(2, 2),
+            padding=(1, 1),
+            dilation=(1, 1),
+            return_indices=False,
+            ceil_mode=False,
+            data_format=data_format,
+        )[0]
+    if pool == "avg":
+        return lambda t: flow._C.avg_pool2d(
+            t,
+            kernel_size=(3, 3),
+            stride=(2, 2),
+            padding=(1, 1),
+            ceil_mode=False,
+            count_include_pad=True,
+            divisor_override=0,
+            data_format=data_format,
+        )
+    return lambda t: flow._C.adaptive_avg_pool2d(t, output_size=(7, 7))
+
+
+def bench_pool(pool, data_format, shape):
+    if data_format == "channels_last":
+        shape = (shape[0], shape[2], shape[3], shape[1])
+    x = flow.tensor(
+        np.random.randn(*shape).astype(np.float32), device="cpu", requires_grad=True
+    )
+    fn = _pool_fn(pool, data_format)
+
+    def forward_backward():
+        x.grad = None
+        fn(x).sum().backward()
+        return x.grad
+
+    forward_cost = time_per_iter(lambda: fn(x))
+    backward_cost = time_per_iter(forward_backward) - forward_cost
+    report(
+        "{} pool {} {}".format(pool, data_format, shape),
+        forward_ms="{:.3f}".format(forward_cost * 1000),
+        backward_ms="{:.3f}".format(backward_cost * 1000),
+    )
+
+
+if __name__ == "__main__":
+    # the pooling layers of resnet and vgg style image models
+    for pool in ["max", "avg"]:
+        for data_format in ["channels_first", "channels_last"]:
+            for shape in [(32, 64, 112, 112), (32, 256, 56, 56), (1, 512, 28, 28)]:
+                bench_pool(pool, data_format, shape)
+    for shape in [(32, 512, 14, 14), (32, 2048, 7, 7)]:
+        bench_pool("adaptive_avg", "channels_first", shape)
@@ -0,0 +1,39 @@
+"""
+Copyright 2020 The OneFlow Authors. All rights reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+"""
+
+import numpy as np
+
+import oneflow as flow
+from benchmark_util import report, time_per_iter
+
+
+def bench_unique(n, num_ids, sorted):
+    # sparse ids of recommendation models, a few hot ids and a long tail
+    ids = np.random.zipf(1.2, size=n) % num_ids
+    x = flow.tensor(ids.astype(np.int64), device="cpu")
+    fn = lambda: flow.unique(x, sorted=sorted, return_inverse=True, return_counts=True)
+    cost = time_per_iter(fn)
+    report(
+        "unique n={} sorted={}".format(n, sorted),
+        unique_ids=fn()[0].shape[0],
+        ms="{:.3f}".format(cost * 1000),
+    )
+
+
+if __name__ == "__main__":
+    for n in [1000000, 10000000]:
+        for sorted in [False, True]:
+            bench_unique(n, 100000000, sorted)
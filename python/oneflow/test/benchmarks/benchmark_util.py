@@ -0,0 +1,48 @@
+"""
+Copyright 2020 The OneFlow Authors. All rights reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+"""
+
+import os
+import time
+
+import oneflow as flow
+
+# iterations every benchmark script times, after one warm-up iteration
+ITERS = int(os.getenv("ONEFLOW_BENCHMARK_ITERS", "20"))
+
+
+def sync(out):
+    # kernels run asynchronously, copying the result to host waits for them
+    if isinstance(out, (tuple, list)):
+        for t in out:
+            sync(t)
+    elif isinstance(out, flow.Tensor):
+        out.numpy()
+
+
+def time_per_iter(fn, iters=ITERS):
+    """Returns the seconds one call of fn takes, averaged over iters calls."""
+    sync(fn())
+    start = time.perf_counter()
+    for _ in range(iters):
+        out = fn()
+    sync(out)
+    return (time.perf_counter() - start) / iters
+
+
+def report(name, **fields):
+    if flow.env.get_rank() != 0:
+        return
+    print(name + ": " + ", ".join("{} {}".format(k, v) for k, v in fields.items()))
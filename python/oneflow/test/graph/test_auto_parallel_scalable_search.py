@@ -0,0 +1,98 @@
+"""
+Copyright 2020 The OneFlow Authors. All rights reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+"""
+
+import unittest
+
+import numpy as np
+
+import oneflow as flow
+import oneflow.unittest
+
+
+class _TransformerLayer(flow.nn.Module):
+    def __init__(self, hidden_size, num_heads):
+        super().__init__()
+        self.num_heads = num_heads
+        self.head_size = hidden_size // num_heads
+        self.qkv = flow.nn.Linear(hidden_size, 3 * hidden_size)
+        self.proj = flow.nn.Linear(hidden_size, hidden_size)
+        self.norm1 = flow.nn.LayerNorm(hidden_size)
+        self.fc1 = flow.nn.Linear(hidden_size, 4 * hidden_size)
+        self.fc2 = flow.nn.Linear(4 * hidden_size, hidden_size)
+        self.norm2 = flow.nn.LayerNorm(hidden_size)
+
+    def forward(self, x):
+        batch_size, seq_len, hidden_size = x.shape
+        q, k, v = (
+            self.qkv(x)
+            .reshape(batch_size, seq_len, 3, self.num_heads, self.head_size)
+            .permute(2, 0, 3, 1, 4)
+            .unbind(0)
+        )
+        scores = flow.matmul(q, k.transpose(-2, -1)) / (self.head_size ** 0.5)
+        attn = flow.matmul(scores.softmax(dim=-1), v)
+        attn = attn.permute(0, 2, 1, 3).reshape(batch_size, seq_len, hidden_size)
+        x = self.norm1(x + self.proj(attn))
+        return self.norm2(x + self.fc2(flow.nn.functional.gelu(self.fc1(x))))
+
+
+def _test_scalable_search(test_case, time_limit):
+    placement = flow.placement.all("cpu")
+    model = flow.nn.Sequential(
+        *[_TransformerLayer(hidden_size=32, num_heads=4) for _ in range(6)]
+    )
+    model.to_global(placement, flow.sbp.broadcast)
+    sgd = flow.optim.SGD(model.parameters(), lr=0.1)
+
+    class TransformerGraph(flow.nn.Graph):
+        def __init__(self):
+            super().__init__()
+            self.model = model
+            self.add_optimizer(sgd)
+            self.config.enable_auto_parallel(True)
+            self.config.enable_auto_parallel_ignore_user_sbp_config(True)
+            self.config.enable_auto_parallel_scalable_search(True)
+            self.config.set_auto_parallel_search_time_limit(time_limit)
+
+        def build(self, x, target):
+            loss = (self.model(x) - target).square().mean()
+            loss.backward()
+            return loss
+
+    graph = TransformerGraph()
+    x = flow.randn(8, 16, 32, placement=placement, sbp=flow.sbp.broadcast)
+    target = flow.randn(8, 16, 32, placement=placement, sbp=flow.sbp.broadcast)
+    for _ in range(3):
+        # the graph updates the parameters after its forward pass, so the eager loss
+        # of the current parameters is computed first
+        with flow.no_grad():
+            expected = (model(x) - target).square().mean().numpy()
+        loss = graph(x, target).to_global(sbp=flow.sbp.broadcast).numpy()
+        test_case.assertTrue(np.allclose(loss, expected, rtol=1e-4, atol=1e-4))
+
+
+@flow.unittest.skip_unless_1n2d()
+class TestAutoParallelScalableSearch(oneflow.unittest.TestCase):
+    def test_scalable_search(test_case):
+        _test_scalable_search(test_case, time_limit=0)
+
+    def test_scalable_search_with_time_limit(test_case):
+        # a budget this small stops the search early, the strategy must stay valid
+        _test_scalable_search(test_case, time_limit=1e-3)
+
+
+if __name__ == "__main__":
+    unittest.main()
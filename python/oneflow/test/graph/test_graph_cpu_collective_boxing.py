@@ -0,0 +1,119 @@
+"""
+Copyright 2020 The OneFlow Authors. All rights reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+"""
+import unittest
+import numpy as np
+
+import oneflow as flow
+import oneflow.unittest
+from oneflow.core.graph.boxing import collective_boxing_pb2
+from oneflow.core.job import plan_pb2
+
+
+def _make_partial_sum_tensors(shapes, placement):
+    rank = flow.env.get_rank()
+    locals_np = [
+        np.arange(np.prod(shape)).reshape(shape).astype(np.float32) for shape in shapes
+    ]
+    xs = [
+        flow.tensor(local_np * (rank + 1)).to_global(
+            placement=placement, sbp=flow.sbp.partial_sum()
+        )
+        for local_np in locals_np
+    ]
+    # two ranks contribute 1x and 2x of the local value
+    expected = [local_np * 3 for local_np in locals_np]
+    return xs, expected
+
+
+def _cpu_collective_op_types(graph):
+    # Results alone cannot tell the collective boxing route from the fallback
+    # boxing task nodes, so inspect the requests issued to the cpu backend.
+    plan = plan_pb2.Plan()
+    plan.ParseFromString(graph._c_nn_graph.plan)
+    op_types = []
+    for request_set in plan.collective_boxing_plan.job_id2request_set.values():
+        for request in request_set.request:
+            if request.op_desc.backend == collective_boxing_pb2.kBackendCPU:
+                op_types.append(request.op_desc.op_type)
+    return op_types
+
+
+def _test_cpu_collective_boxing_all_reduce(test_case, fusion):
+    flow.boxing.nccl.enable_use_compute_stream(False)
+    flow.boxing.cpu.allow_fuse_all_reduce(fusion)
+    placement = flow.placement("cpu", ranks=[0, 1])
+    shapes = [(4, 5), (16,), (3, 2, 7), (1024,)]
+    xs, expected = _make_partial_sum_tensors(shapes, placement)
+
+    class AllReduceGraph(flow.nn.Graph):
+        def __init__(self):
+            super().__init__()
+
+        def build(self, *xs):
+            return tuple(x.to_global(sbp=flow.sbp.broadcast()) for x in xs)
+
+    graph = AllReduceGraph()
+    for _ in range(2):
+        ys = graph(*xs)
+        for y, exp in zip(ys, expected):
+            test_case.assertTrue(np.allclose(y.to_local().numpy(), exp))
+    op_types = _cpu_collective_op_types(graph)
+    test_case.assertEqual(
+        op_types, [collective_boxing_pb2.kOpTypeAllReduce] * len(shapes)
+    )
+
+
+def _test_cpu_collective_boxing_scatter_gather(test_case):
+    flow.boxing.nccl.enable_use_compute_stream(False)
+    placement = flow.placement("cpu", ranks=[0, 1])
+    xs, expected = _make_partial_sum_tensors([(8, 3)], placement)
+
+    class ReduceScatterAllGatherGraph(flow.nn.Graph):
+        def __init__(self):
+            super().__init__()
+
+        def build(self, x):
+            s = x.to_global(sbp=flow.sbp.split(0))
+            b = s.to_global(sbp=flow.sbp.broadcast())
+            return s, b
+
+    graph = ReduceScatterAllGatherGraph()
+    s, b = graph(xs[0])
+    rank = flow.env.get_rank()
+    test_case.assertTrue(
+        np.allclose(s.to_local().numpy(), expected[0][rank * 4 : rank * 4 + 4])
+    )
+    test_case.assertTrue(np.allclose(b.to_local().numpy(), expected[0]))
+    op_types = _cpu_collective_op_types(graph)
+    test_case.assertEqual(len(op_types), 2)
+    test_case.assertIn(collective_boxing_pb2.kOpTypeReduceScatter, op_types)
+    test_case.assertIn(collective_boxing_pb2.kOpTypeAllGather, op_types)
+
+
+@flow.unittest.skip_unless_1n2d()
+class TestGraphCpuCollectiveBoxing(flow.unittest.TestCase):
+    def test_all_reduce_fused(test_case):
+        _test_cpu_collective_boxing_all_reduce(test_case, True)
+
+    def test_all_reduce_unfused(test_case):
+        _test_cpu_collective_boxing_all_reduce(test_case, False)
+
+    def test_reduce_scatter_all_gather(test_case):
+        _test_cpu_collective_boxing_scatter_gather(test_case)
+
+
+if __name__ == "__main__":
+    unittest.main()
@@ -0,0 +1,111 @@
+"""
+Copyright 2020 The OneFlow Authors. All rights reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+"""
+import unittest
+
+import numpy as np
+
+import oneflow as flow
+import oneflow.unittest
+
+
+class QuantLinear(flow.nn.Module):
+    def __init__(self, in_features, out_features):
+        super().__init__()
+        self.weight = flow.nn.Parameter(flow.randn(out_features, in_features))
+        self.observer = flow.nn.MinMaxObserver(
+            quantization_formula="google",
+            quantization_bit=8,
+            quantization_scheme="symmetric",
+            per_layer_quantization=False,
+        )
+        self.fake_quant = flow.nn.FakeQuantization(
+            quantization_formula="google",
+            quantization_bit=8,
+            quantization_scheme="symmetric",
+        )
+
+    def forward(self, x):
+        scale, zero_point = self.observer(self.weight)
+        w = self.fake_quant(self.weight, scale, zero_point)
+        return flow.matmul(x, w, transpose_b=True)
+
+
+class QuantLinearGraph(flow.nn.Graph):
+    def __init__(self, module, enable_cpu_int8_linear):
+        super().__init__()
+        self.m = module
+        self.config.enable_cpu_int8_linear(enable_cpu_int8_linear)
+
+    def build(self, x):
+        return self.m(x)
+
+
+def _op_types(graph):
+    return [
+        op.user_conf.op_type_name
+        for op in graph._full_graph_proto.net.op
+        if op.HasField("user_conf")
+    ]
+
+
+def _int8_linear_ref(x, w):
+    # Per-channel weight and per-tensor activation scales, accumulated exactly.
+    w_scale = np.abs(w).max(axis=1) / np.float32(127)
+    qw = np.clip(np.rint(w / w_scale[:, None]), -128, 127).astype(np.int64)
+    x_scale = np.abs(x).max() / np.float32(127)
+    qx = np.clip(np.rint(x / x_scale), -127, 127).astype(np.int64)
+    return np.matmul(qx, qw.T).astype(np.float32) * x_scale * w_scale[None, :]
+
+
+@flow.unittest.skip_unless_1n1d()
+class TestGraphCpuInt8Linear(flow.unittest.TestCase):
+    def test_rewrite(test_case):
+        m = QuantLinear(256, 96)
+        m.eval()
+        graph = QuantLinearGraph(m, True)
+        for rows in [64, 3]:
+            # A new weight loaded between runs has to be picked up by the next run.
+            w = np.random.randn(96, 256).astype(np.float32)
+            m.load_state_dict({"weight": flow.tensor(w)}, strict=False)
+            x = np.random.randn(rows, 256).astype(np.float32)
+            out = graph(flow.tensor(x)).numpy()
+            test_case.assertTrue(
+                np.allclose(out, _int8_linear_ref(x, w), rtol=1e-5, atol=1e-5)
+            )
+            fake_quant_out = m(flow.tensor(x)).numpy()
+            test_case.assertLess(
+                np.linalg.norm(out - fake_quant_out) / np.linalg.norm(fake_quant_out),
+                2e-2,
+            )
+
+        op_types = _op_types(graph)
+        test_case.assertIn("dynamic_int8_linear", op_types)
+        test_case.assertNotIn("matmul", op_types)
+        test_case.assertNotIn("fake_quantization", op_types)
+        test_case.assertNotIn("min_max_observer", op_types)
+
+    def test_disabled(test_case):
+        m = QuantLinear(16, 8)
+        m.eval()
+        graph = QuantLinearGraph(m, False)
+        graph(flow.randn(4, 16))
+        op_types = _op_types(graph)
+        test_case.assertNotIn("dynamic_int8_linear", op_types)
+        test_case.assertIn("fake_quantization", op_types)
+
+
+if __name__ == "__main__":
+    unittest.main()
@@ -0,0 +1,180 @@
+"""
+Copyright 2020 The OneFlow Authors. All rights reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+"""
+
+import unittest
+from collections import OrderedDict
+import copy
+
+import numpy as np
+
+from test_util import GenArgList
+
+import oneflow as flow
+import oneflow.unittest
+
+
+def _round_to_bfloat16(x):
+    # Round to nearest even on the upper 16 bits, as the cast to bfloat16 does.
+    bits = x.astype(np.float32).view(np.uint32).astype(np.uint64)
+    bits = (bits + 0x7FFF + ((bits >> 16) & 1)) & 0xFFFF0000
+    return bits.astype(np.uint32).view(np.float32)
+
+
+_model_copy_rounding = {
+    None: lambda x: x,
+    flow.float16: lambda x: x.astype(np.float16).astype(np.float32),
+    flow.bfloat16: _round_to_bfloat16,
+}
+
+
+class MultiParamModule(flow.nn.Module):
+    def __init__(self, init_values, model_copy_dtype):
+        super().__init__()
+        self.param_num = len(init_values)
+        self.model_copy_dtype = model_copy_dtype
+        for idx, value in enumerate(init_values):
+            param = flow.nn.Parameter(flow.tensor(value))
+            self.register_parameter(f"param_{idx}", param)
+
+    def param(self, idx):
+        return getattr(self, f"param_{idx}")
+
+    def forward(self, mask_list):
+        out = 0
+        for idx in range(self.param_num):
+            param = self.param(idx)
+            if self.model_copy_dtype is not None:
+                # The cast of the variable is fused into the update as its
+                # model_copy; the gradient reaching the update is rounded to
+                # model_copy_dtype.
+                param = param.to(self.model_copy_dtype).to(flow.float32)
+            out += flow.sum(param * mask_list[idx])
+        return out
+
+
+class MultiTensorUpdateGraph(flow.nn.Graph):
+    def __init__(self, module, optimizer, model_copy_dtype):
+        super().__init__()
+        self.m = module
+        self.add_optimizer(optimizer)
+        self.config.enable_multi_tensor_update(True)
+        if model_copy_dtype is not None:
+            self.config.enable_amp(True)
+            self.config.enable_fused_model_update_cast(True)
+
+    def build(self, mask_list):
+        loss = self.m(mask_list)
+        loss.backward()
+        return loss
+
+
+def np_sgd_update(x, grad, state, step, learning_rate, weight_decay):
+    return x - learning_rate * (grad + weight_decay * x)
+
+
+def np_adam_update(x, grad, state, step, learning_rate, weight_decay):
+    beta1, beta2, eps = 0.9, 0.999, 1e-8
+    grad = grad + weight_decay * x
+    m = beta1 * state.get("m", 0) + (1 - beta1) * grad
+    v = beta2 * state.get("v", 0) + (1 - beta2) * grad * grad
+    state["m"], state["v"] = m, v
+    bias_correction1 = 1.0 - np.power(beta1, step)
+    bias_correction2 = 1.0 - np.power(beta2, step)
+    denom = np.sqrt(v) / np.sqrt(bias_correction2) + eps
+    return x - (learning_rate / bias_correction1) * m / denom
+
+
+_optimizers = {
+    "sgd": (flow.optim.SGD, np_sgd_update, "multi_tensor_sgd_update"),
+    "adam": (flow.optim.Adam, np_adam_update, "multi_tensor_adam_update"),
+}
+
+
+def compare_with_numpy(
+    test_case, optimizer, model_copy_dtype, shapes, learning_rate, weight_decay
+):
+    optimizer_cls, np_update, op_type = _optimizers[optimizer]
+    if model_copy_dtype is not None:
+        op_type += "_with_cast"
+    train_iters = 5
+    init_values = [np.random.uniform(size=shape).astype(np.float32) for shape in shapes]
+    mask_seq = [
+        [np.random.uniform(size=shape).astype(np.float32) for shape in shapes]
+        for _ in range(train_iters)
+    ]
+    module = MultiParamModule(init_values, model_copy_dtype)
+    module.train()
+    opt = optimizer_cls(
+        module.parameters(), lr=learning_rate, weight_decay=weight_decay
+    )
+    graph = MultiTensorUpdateGraph(module, opt, model_copy_dtype)
+
+    round_grad = _model_copy_rounding[model_copy_dtype]
+    np_params = copy.deepcopy(init_values)
+    np_states = [dict() for _ in shapes]
+    for step in range(1, train_iters + 1):
+        graph([flow.tensor(mask) for mask in mask_seq[step - 1]])
+        for idx in range(len(shapes)):
+            np_params[idx] = np_update(
+                np_params[idx],
+                round_grad(mask_seq[step - 1][idx]),
+                np_states[idx],
+                step,
+                learning_rate,
+                weight_decay,
+            )
+            test_case.assertTrue(
+                np.allclose(
+                    module.param(idx).numpy(), np_params[idx], rtol=1e-4, atol=1e-4
+                )
+            )
+
+    op_types = [
+        op.user_conf.op_type_name
+        for op in graph._full_graph_proto.net.op
+        if op.HasField("user_conf")
+    ]
+    # One fused update for all parameters of the group.
+    test_case.assertEqual(op_types.count(op_type), 1)
+    test_case.assertNotIn(optimizer + "_update", op_types)
+
+
+@flow.unittest.skip_unless_1n1d()
+class TestGraphMultiTensorUpdateCpu(flow.unittest.TestCase):
+    def test_multi_tensor_update(test_case):
+        arg_dict = OrderedDict()
+        arg_dict["optimizer"] = ["sgd", "adam"]
+        arg_dict["model_copy_dtype"] = [None]
+        # The large tensor is split over the threads, the small ones share one.
+        arg_dict["shapes"] = [[(10,), (4, 5), (40001,)]]
+        arg_dict["learning_rate"] = [1e-3, 1]
+        arg_dict["weight_decay"] = [0.0, 1e-3]
+        for arg in GenArgList(arg_dict):
+            compare_with_numpy(test_case, *arg)
+
+    def test_multi_tensor_update_with_cast(test_case):
+        arg_dict = OrderedDict()
+        arg_dict["optimizer"] = ["sgd", "adam"]
+        arg_dict["model_copy_dtype"] = [flow.float16, flow.bfloat16]
+        arg_dict["shapes"] = [[(10,), (4, 5), (40001,)]]
+        arg_dict["learning_rate"] = [1e-3]
+        arg_dict["weight_decay"] = [0.0, 1e-3]
+        for arg in GenArgList(arg_dict):
+            compare_with_numpy(test_case, *arg)
+
+
+if __name__ == "__main__":
+    unittest.main()
@@ -17,6 +17,7 @@ import unittest
 from collections import OrderedDict
 import numpy as np
 import copy
+import os
 
 from test_util import GenArgList
 from optimizer_test_util import clip_grad_norm_np
@@ -135,6 +136,7 @@ def compare_with_numpy_adam(
     train_by_numpy()
 
     test_case.assertTrue(np.allclose(of_res_list, np_res_list, rtol=0.001, atol=0.001))
+    return adam_graph
 
 
 def compare_with_numpy_adam_clip_grad(
@@ -251,6 +253,18 @@ def compare_with_numpy_adam_clip_grad(
 
     train_by_numpy()
     test_case.assertTrue(np.allclose(of_res_list, np_res_list, rtol=1e-3, atol=1e-3))
+    return adam_graph
+
+
+def _assert_multi_tensor_adam_update(test_case, graph):
+    # The plain adam_update gives the same numbers, so check that the rewrite happened.
+    op_types = [
+        op.user_conf.op_type_name
+        for op in graph._full_graph_proto.net.op
+        if op.HasField("user_conf")
+    ]
+    test_case.assertIn("multi_tensor_adam_update", op_types)
+    test_case.assertNotIn("adam_update", op_types)
 
 
 @flow.unittest.skip_unless_1n1d()
@@ -286,6 +300,30 @@ class TestAdam(flow.unittest.TestCase):
         for arg in GenArgList(arg_dict):
             compare_with_numpy_adam_clip_grad(test_case, *arg)
 
+    def test_adam_multi_tensor_cpu(test_case):
+        os.environ["ONEFLOW_ENABLE_MULTI_TENSOR_MODEL_UPDATE"] = "1"
+        try:
+            arg_dict = OrderedDict()
+            arg_dict["device"] = ["cpu"]
+            arg_dict["x_shape"] = [(10,), (40000,)]
+            arg_dict["learning_rate"] = [1e-3]
+            arg_dict["train_iters"] = [10]
+            arg_dict["betas"] = [(0.99, 0.9)]
+            arg_dict["weight_decay"] = [0.001, 0.0]
+            arg_dict["eps"] = [1e-8]
+            arg_dict["do_bias_correction"] = [True, False]
+            arg_dict["amsgrad"] = [False]
+            for arg in GenArgList(arg_dict):
+                graph = compare_with_numpy_adam(test_case, *arg)
+                _assert_multi_tensor_adam_update(test_case, graph)
+            arg_dict["clip_grad_max_norm"] = [1.0]
+            arg_dict["clip_grad_norm_type"] = [2.0]
+            for arg in GenArgList(arg_dict):
+                graph = compare_with_numpy_adam_clip_grad(test_case, *arg)
+                _assert_multi_tensor_adam_update(test_case, graph)
+        finally:
+            del os.environ["ONEFLOW_ENABLE_MULTI_TENSOR_MODEL_UPDATE"]
+
 
 if __name__ == "__main__":
     unittest.main()
@@ -59,6 +59,14 @@ def _test_tensor_argsort(test_case, data_shape, axis, descending, data_type, dev
     test_case.assertTrue(np.array_equal(of_out.numpy().flatten(), np_out.flatten()))
 
 
+def _test_argsort_stable_with_ties(test_case, data_shape, descending, device):
+    np_input = np.random.randint(0, 50, size=data_shape).astype(np.int32)
+    input = flow.tensor(np_input, device=flow.device(device))
+    of_out = flow.argsort(input, dim=-1, descending=descending)
+    np_out = np.argsort(-np_input if descending else np_input, axis=-1, kind="stable")
+    test_case.assertTrue(np.array_equal(of_out.numpy(), np_out))
+
+
 @flow.unittest.skip_unless_1n1d()
 class TestArgsort(flow.unittest.TestCase):
     def test_argsort(test_case):
@@ -72,6 +80,14 @@ class TestArgsort(flow.unittest.TestCase):
         for arg in GenArgList(arg_dict):
             arg[0](test_case, *arg[1:])
 
+    def test_argsort_stable_with_ties_cpu(test_case):
+        arg_dict = OrderedDict()
+        arg_dict["data_shape"] = [(4, 100), (3, 4096), (1, 70000)]
+        arg_dict["descending"] = [True, False]
+        arg_dict["device"] = ["cpu"]
+        for arg in GenArgList(arg_dict):
+            _test_argsort_stable_with_ties(test_case, *arg)
+
     @autotest(auto_backward=False, check_graph=True)
     def test_argsort_with_random_data(test_case):
         device = random_device()
@@ -14,12 +14,56 @@ See the License for the specific language governing permissions and
 limitations under the License.
 """
 import unittest
+from collections import OrderedDict
+
+import numpy as np
 
 import oneflow as flow
 from oneflow.test_utils.automated_test_util.generators import constant, random_bool
 import oneflow.unittest
 
 from oneflow.test_utils.automated_test_util import *
+from oneflow.test_utils.test_util import GenArgList
+
+
+def _test_avgpool2d_channel_last_cpu(
+    test_case, shape, kernel_size, stride, padding, ceil_mode, count_include_pad
+):
+    arr = np.random.randn(*shape)
+    grad = None
+    results = []
+    for data_format, perm in [
+        ("channels_first", None),
+        ("channels_last", (0, 2, 3, 1)),
+    ]:
+        x = flow.tensor(
+            arr if perm is None else arr.transpose(*perm),
+            dtype=flow.float64,
+            requires_grad=True,
+        )
+        y = flow._C.avg_pool2d(
+            x,
+            kernel_size=kernel_size,
+            stride=stride,
+            padding=padding,
+            ceil_mode=ceil_mode,
+            count_include_pad=count_include_pad,
+            divisor_override=0,
+            data_format=data_format,
+        )
+        if grad is None:
+            grad = np.random.randn(*y.shape)
+        y.backward(
+            flow.tensor(grad if perm is None else grad.transpose(*perm), dtype=y.dtype)
+        )
+        if perm is None:
+            results.append((y.numpy(), x.grad.numpy()))
+        else:
+            results.append(
+                (y.numpy().transpose(0, 3, 1, 2), x.grad.numpy().transpose(0, 3, 1, 2))
+            )
+    test_case.assertTrue(np.allclose(results[0][0], results[1][0], 1e-5, 1e-5))
+    test_case.assertTrue(np.allclose(results[0][1], results[1][1], 1e-5, 1e-5))
 
 
 @flow.unittest.skip_unless_1n1d()
@@ -170,6 +214,17 @@ class TestAvgPoolingFunctional(flow.unittest.TestCase):
             ceil_mode=True,
         )
 
+    def test_avgpool2d_channel_last_cpu(test_case):
+        arg_dict = OrderedDict()
+        arg_dict["shape"] = [(3, 3, 14, 27), (2, 70, 9, 14)]
+        arg_dict["kernel_size"] = [(3, 3), (2, 3)]
+        arg_dict["stride"] = [(1, 1), (1, 2), (2, 2)]
+        arg_dict["padding"] = [(0, 0), (0, 1)]
+        arg_dict["ceil_mode"] = [True, False]
+        arg_dict["count_include_pad"] = [True, False]
+        for arg in GenArgList(arg_dict):
+            _test_avgpool2d_channel_last_cpu(test_case, *arg)
+
 
 if __name__ == "__main__":
     unittest.main()
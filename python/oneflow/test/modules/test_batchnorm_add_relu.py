@@ -447,6 +447,93 @@ def _test_bn_relu_eval(test_case, device, batch, channel, height, width):
     )
 
 
+def _unfused_bn_add_relu(x, addend, weight, bias, epsilon):
+    # training mode batch norm composed of reductions and elementwise ops, channels first
+    reduce_dims = (0, 2, 3)
+    mean = x.mean(dim=reduce_dims, keepdim=True)
+    variance = ((x - mean) ** 2).mean(dim=reduce_dims, keepdim=True)
+    y = (x - mean) / flow.sqrt(variance + epsilon)
+    y = y * weight.reshape(1, -1, 1, 1) + bias.reshape(1, -1, 1, 1)
+    if addend is not None:
+        y = y + addend
+    return flow.relu(y), mean.flatten(), variance.flatten()
+
+
+def _test_bn_add_relu_channels_last_cpu(test_case, has_addend, shape):
+    channel = shape[1]
+    x = np.random.randn(*shape)
+    addend = np.random.randn(*shape)
+    dy = np.random.randn(*shape)
+    weight = np.random.randn(channel)
+    bias = np.random.randn(channel)
+    results = []
+    for axis, perm in [(1, (0, 1, 2, 3)), (3, (0, 2, 3, 1))]:
+        x_tensor = flow.tensor(
+            x.transpose(*perm), dtype=flow.float64, requires_grad=True
+        )
+        addend_tensor = None
+        if has_addend:
+            addend_tensor = flow.tensor(
+                addend.transpose(*perm), dtype=flow.float64, requires_grad=True
+            )
+        weight_tensor = flow.tensor(weight, dtype=flow.float64, requires_grad=True)
+        bias_tensor = flow.tensor(bias, dtype=flow.float64, requires_grad=True)
+        running_mean = flow.zeros(channel, dtype=flow.float64)
+        running_var = flow.ones(channel, dtype=flow.float64)
+        y = flow._C.normalization_add_relu(
+            x_tensor,
+            addend_tensor,
+            running_mean,
+            running_var,
+            weight_tensor,
+            bias_tensor,
+            axis=axis,
+            epsilon=1e-5,
+            momentum=0.9,
+            is_training=True,
+        )
+        y.backward(flow.tensor(dy.transpose(*perm), dtype=flow.float64))
+        inv_perm = np.argsort(perm)
+        result = [
+            y.numpy().transpose(*inv_perm),
+            x_tensor.grad.numpy().transpose(*inv_perm),
+            weight_tensor.grad.numpy(),
+            bias_tensor.grad.numpy(),
+            running_mean.numpy(),
+            running_var.numpy(),
+        ]
+        if has_addend:
+            result.append(addend_tensor.grad.numpy().transpose(*inv_perm))
+        results.append(result)
+
+    x_tensor = flow.tensor(x, dtype=flow.float64, requires_grad=True)
+    addend_tensor = (
+        flow.tensor(addend, dtype=flow.float64, requires_grad=True)
+        if has_addend
+        else None
+    )
+    weight_tensor = flow.tensor(weight, dtype=flow.float64, requires_grad=True)
+    bias_tensor = flow.tensor(bias, dtype=flow.float64, requires_grad=True)
+    y, mean, variance = _unfused_bn_add_relu(
+        x_tensor, addend_tensor, weight_tensor, bias_tensor, 1e-5
+    )
+    y.backward(flow.tensor(dy, dtype=flow.float64))
+    reduce_count = x.size // channel
+    expected = [
+        y.numpy(),
+        x_tensor.grad.numpy(),
+        weight_tensor.grad.numpy(),
+        bias_tensor.grad.numpy(),
+        0.1 * mean.numpy(),
+        0.9 + 0.1 * variance.numpy() * reduce_count / max(reduce_count - 1, 1),
+    ]
+    if has_addend:
+        expected.append(addend_tensor.grad.numpy())
+    for result in results:
+        for fused, unfused in zip(result, expected):
+            test_case.assertTrue(np.allclose(fused, unfused, atol=1e-6, rtol=1e-6))
+
+
 @flow.unittest.skip_unless_1n1d()
 @unittest.skipIf(os.getenv("ONEFLOW_TEST_CPU_ONLY"), "only test gpu cases")
 class TestBnAddRelu(flow.unittest.TestCase):
@@ -471,5 +558,15 @@ class TestBnAddRelu(flow.unittest.TestCase):
             arg[0](test_case, *arg[1:])
 
 
+@flow.unittest.skip_unless_1n1d()
+class TestBnAddReluCpu(flow.unittest.TestCase):
+    def test_bn_add_relu2d_channels_last(test_case):
+        arg_dict = OrderedDict()
+        arg_dict["has_addend"] = [True, False]
+        arg_dict["shape"] = [(2, 6, 5, 7), (3, 40, 3, 3), (1, 3, 1, 33)]
+        for arg in GenArgList(arg_dict):
+            _test_bn_add_relu_channels_last_cpu(test_case, *arg)
+
+
 if __name__ == "__main__":
     unittest.main()
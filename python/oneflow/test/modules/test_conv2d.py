@@ -1882,6 +1882,42 @@ class TestConv2d(flow.unittest.TestCase):
         y = m(x)
         return y
 
+    @autotest(n=5, rtol=1e-2)
+    def test_conv2d_cpu_depthwise_with_random_data(test_case):
+        channels = random(1, 33).to(int)
+        m = torch.nn.Conv2d(
+            in_channels=channels,
+            out_channels=channels,
+            kernel_size=random(1, 6),
+            stride=random(1, 3) | nothing(),
+            padding=random(1, 3).to(int) | nothing(),
+            dilation=random(1, 3) | nothing(),
+            groups=channels,
+            padding_mode=constant("zeros") | nothing(),
+        )
+        m.train(random())
+        m.to("cpu")
+        x = random_tensor(ndim=4, dim0=random(1, 9), dim1=channels).to("cpu")
+        y = m(x)
+        return y
+
+    @autotest(n=5, rtol=1e-2)
+    def test_conv2d_cpu_large_batch_with_random_data(test_case):
+        channels = random(1, 17)
+        m = torch.nn.Conv2d(
+            in_channels=channels,
+            out_channels=random(1, 40),
+            kernel_size=random(1, 4),
+            stride=random() | nothing(),
+            padding=random(1, 3).to(int) | nothing(),
+            groups=random(1, 3) | nothing(),
+        )
+        m.train(random())
+        m.to("cpu")
+        x = random_tensor(ndim=4, dim0=random(16, 33), dim1=channels).to("cpu")
+        y = m(x)
+        return y
+
     @unittest.skipIf(
         version.parse(torch_original.__version__) <= version.parse("1.13.0"),
         "conv module don't support unbatched input in PyTorch before '1.13.0'",
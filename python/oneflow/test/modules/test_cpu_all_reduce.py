@@ -0,0 +1,70 @@
+"""
+Copyright 2020 The OneFlow Authors. All rights reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+"""
+import os
+import unittest
+
+import numpy as np
+
+import oneflow as flow
+import oneflow.unittest
+
+
+_ALGOS = ["ring", "halving_doubling", "tree", "auto"]
+
+
+def _all_reduce(np_arr, ranks):
+    placement = flow.placement("cpu", ranks=ranks)
+    x = flow.tensor(np_arr).to_global(placement=placement, sbp=flow.sbp.partial_sum)
+    # The kernel reads the algorithm from the environment when it runs, so wait for it before
+    # _TransportAlgo restores the environment.
+    return x.to_global(sbp=flow.sbp.broadcast).to_local().numpy()
+
+
+class _TransportAlgo:
+    """Bypasses the shared memory backend and forces an all-reduce algorithm."""
+
+    def __init__(self, algo):
+        self.algo = algo
+
+    def __enter__(self):
+        os.environ["ONEFLOW_CPU_ENABLE_SHM_COLLECTIVE"] = "0"
+        os.environ["ONEFLOW_CPU_ALL_REDUCE_ALGO"] = self.algo
+
+    def __exit__(self, *args):
+        del os.environ["ONEFLOW_CPU_ENABLE_SHM_COLLECTIVE"]
+        del os.environ["ONEFLOW_CPU_ALL_REDUCE_ALGO"]
+
+
+class TestCpuAllReduce(flow.unittest.TestCase):
+    @flow.unittest.skip_unless_1n4d()
+    def test_all_reduce_algos(test_case):
+        rank = flow.env.get_rank()
+        for ranks in [[0, 1, 2, 3], [0, 1, 3]]:
+            if rank not in ranks:
+                continue
+            for algo in _ALGOS:
+                # The last size streams every ring part in at least 8 pipelined sub-chunks.
+                for elem_cnt in [1, 7, 1000, 300000, 4 * 4 * 131072 + 3]:
+                    base = np.arange(elem_cnt, dtype=np.float32) % 97
+                    np_arr = base * (rank + 1)
+                    expected = base * sum(r + 1 for r in ranks)
+                    with _TransportAlgo(algo):
+                        out = _all_reduce(np_arr, ranks)
+                    test_case.assertTrue(np.allclose(out, expected))
+
+
+if __name__ == "__main__":
+    unittest.main()
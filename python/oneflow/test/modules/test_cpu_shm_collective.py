@@ -0,0 +1,93 @@
+"""
+Copyright 2020 The OneFlow Authors. All rights reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+"""
+import unittest
+
+import numpy as np
+
+import oneflow as flow
+import oneflow.unittest
+
+
+# The default staging buffer holds 2MiB per rank, the largest size needs several rounds of it
+# and the odd ones leave partial rounds and uneven slices.
+_ELEM_CNTS = [1, 7, 1001, 700001]
+
+
+def _base(elem_cnt):
+    return np.arange(elem_cnt, dtype=np.float32) % 97
+
+
+@flow.unittest.skip_unless_1n4d()
+class TestCpuShmCollective(flow.unittest.TestCase):
+    def test_all_reduce(test_case):
+        rank = flow.env.get_rank()
+        for ranks in [[0, 1, 2, 3], [0, 1, 3]]:
+            if rank not in ranks:
+                continue
+            placement = flow.placement("cpu", ranks=ranks)
+            for elem_cnt in _ELEM_CNTS:
+                # Several collectives back to back reuse the arena round after round.
+                for step in range(3):
+                    x = flow.tensor(_base(elem_cnt) * (rank + step)).to_global(
+                        placement=placement, sbp=flow.sbp.partial_sum
+                    )
+                    out = x.to_global(sbp=flow.sbp.broadcast).to_local().numpy()
+                    expected = _base(elem_cnt) * sum(r + step for r in ranks)
+                    test_case.assertTrue(np.allclose(out, expected))
+
+    def test_broadcast(test_case):
+        rank = flow.env.get_rank()
+        for src in [0, 3]:
+            for elem_cnt in _ELEM_CNTS:
+                x = flow.tensor(_base(elem_cnt) + rank)
+                flow.comm.broadcast(x, src)
+                test_case.assertTrue(np.array_equal(x.numpy(), _base(elem_cnt) + src))
+
+    def test_all_gather(test_case):
+        rank = flow.env.get_rank()
+        for ranks in [[0, 1, 2, 3], [0, 1, 3]]:
+            if rank not in ranks:
+                continue
+            placement = flow.placement("cpu", ranks=ranks)
+            for elem_cnt in _ELEM_CNTS:
+                x = flow.tensor(_base(elem_cnt) + rank).to_global(
+                    placement=placement, sbp=flow.sbp.split(0)
+                )
+                out = x.to_global(sbp=flow.sbp.broadcast).to_local().numpy()
+                expected = np.concatenate([_base(elem_cnt) + r for r in ranks])
+                test_case.assertTrue(np.array_equal(out, expected))
+
+    def test_reduce_scatter(test_case):
+        rank = flow.env.get_rank()
+        for ranks in [[0, 1, 2, 3], [0, 1, 3]]:
+            if rank not in ranks:
+                continue
+            placement = flow.placement("cpu", ranks=ranks)
+            for elem_cnt in _ELEM_CNTS:
+                total = _base(elem_cnt * len(ranks))
+                x = flow.tensor(total * (rank + 1)).to_global(
+                    placement=placement, sbp=flow.sbp.partial_sum
+                )
+                out = x.to_global(sbp=flow.sbp.split(0)).to_local().numpy()
+                i = ranks.index(rank)
+                expected = total[i * elem_cnt : (i + 1) * elem_cnt] * sum(
+                    r + 1 for r in ranks
+                )
+                test_case.assertTrue(np.allclose(out, expected))
+
+
+if __name__ == "__main__":
+    unittest.main()
@@ -0,0 +1,103 @@
+"""
+Copyright 2020 The OneFlow Authors. All rights reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+"""
+import os
+import unittest
+
+# the stats switch is read once, before the first boxing
+os.environ["ONEFLOW_EAGER_BOXING_ENABLE_STATS"] = "1"
+
+import numpy as np
+import oneflow as flow
+
+import oneflow.unittest
+
+
+class _ScopedEnv:
+    def __init__(self, name, value):
+        self.name = name
+        self.value = value
+
+    def __enter__(self):
+        self.old_value = os.getenv(self.name)
+        os.environ[self.name] = self.value
+
+    def __exit__(self, *args):
+        if self.old_value is None:
+            del os.environ[self.name]
+        else:
+            os.environ[self.name] = self.old_value
+
+
+def _box_and_get_stats(test_case, shape, in_sbp, out_sbp):
+    np_arr = np.random.randn(*shape).astype(np.float32)
+    placement = flow.placement("cpu", ranks=[0, 1])
+    x = flow.tensor(np_arr).to_global(placement, flow.sbp.broadcast)
+    x = x.to_global(placement, in_sbp)
+    flow._oneflow_internal.ResetEagerBoxingStats()
+    y = x.to_global(placement, out_sbp)
+    stats = flow._oneflow_internal.GetEagerBoxingStats()
+    test_case.assertTrue(np.allclose(y.numpy(), np_arr, 1e-5, 1e-5))
+    test_case.assertEqual(len(stats), 1, stats)
+    return stats[0]
+
+
+@flow.unittest.skip_unless_1n2d()
+class TestEagerBoxingStats(flow.unittest.TestCase):
+    def test_stats(test_case):
+        stats = _box_and_get_stats(
+            test_case, (4, 10), flow.sbp.split(0), flow.sbp.broadcast
+        )
+        test_case.assertIn("ccl-s-to-b", stats["boxing_routing"])
+        test_case.assertEqual(stats["hop_num"], 1)
+        test_case.assertEqual(stats["call_num"], 1)
+        test_case.assertEqual(stats["logical_elem_cnt"], 40)
+        test_case.assertGreater(stats["estimated_cost"], 0)
+        test_case.assertGreaterEqual(stats["elapsed_us"], 0)
+        test_case.assertIn("S(0)", stats["nd_sbp_routing"])
+        test_case.assertIn("cpu", stats["placement_routing"])
+        flow._oneflow_internal.ResetEagerBoxingStats()
+        test_case.assertEqual(flow._oneflow_internal.GetEagerBoxingStats(), [])
+
+    def test_cost_model_selects_route(test_case):
+        # The first matching route of S(1) -> B goes through S(0) in two collective
+        # hops. A small tensor is cheaper to gather in one naive hop, a large one is
+        # not. Interpreters are cached per shape, so every case uses its own shape.
+        with _ScopedEnv("ONEFLOW_EAGER_BOXING_ENABLE_COST_MODEL", "0"):
+            stats = _box_and_get_stats(
+                test_case, (4, 6), flow.sbp.split(1), flow.sbp.broadcast
+            )
+        test_case.assertEqual(stats["boxing_routing"], "ccl-s-to-s -> ccl-s-to-b")
+        stats = _box_and_get_stats(
+            test_case, (4, 8), flow.sbp.split(1), flow.sbp.broadcast
+        )
+        test_case.assertEqual(stats["boxing_routing"], "naive-s-to-b")
+        stats = _box_and_get_stats(
+            test_case, (512, 512), flow.sbp.split(1), flow.sbp.broadcast
+        )
+        test_case.assertEqual(stats["boxing_routing"], "ccl-s-to-s -> ccl-s-to-b")
+
+    def test_pipelined_route_recorded_once(test_case):
+        with _ScopedEnv("ONEFLOW_EAGER_BOXING_PIPELINE_CHUNK_ELEM_CNT", "16"):
+            stats = _box_and_get_stats(
+                test_case, (6, 4, 9), flow.sbp.split(0), flow.sbp.broadcast
+            )
+        test_case.assertTrue(stats["boxing_routing"].startswith("pipelined"))
+        test_case.assertEqual(stats["call_num"], 1)
+        test_case.assertEqual(stats["logical_elem_cnt"], 6 * 4 * 9)
+
+
+if __name__ == "__main__":
+    unittest.main()
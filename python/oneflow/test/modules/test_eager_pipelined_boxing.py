@@ -0,0 +1,122 @@
+"""
+Copyright 2020 The OneFlow Authors. All rights reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+"""
+import os
+import unittest
+from collections import OrderedDict
+
+# the stats tell which route a boxing took, they must be on before the first boxing
+os.environ["ONEFLOW_EAGER_BOXING_ENABLE_STATS"] = "1"
+
+import numpy as np
+import oneflow as flow
+
+import oneflow.unittest
+from oneflow.test_utils.test_util import GenArgList
+
+
+def _test_eager_pipelined_boxing(test_case, device, in_sbp, out_sbp, shape, ranks):
+    if not isinstance(in_sbp, tuple):
+        in_sbp = (in_sbp,)
+    if not isinstance(out_sbp, tuple):
+        out_sbp = (out_sbp,)
+    np.random.seed(0)
+    np_arr = np.random.randn(*shape).astype(np.float32)
+    placement = flow.placement(device, ranks=ranks)
+    x = flow.tensor(np_arr).to_global(
+        placement, [flow.sbp.broadcast] * len(placement.ranks.shape)
+    )
+    x = x.to_global(placement, in_sbp)
+    flow._oneflow_internal.ResetEagerBoxingStats()
+    y = x.to_global(placement, out_sbp)
+    routes = [
+        stats["boxing_routing"]
+        for stats in flow._oneflow_internal.GetEagerBoxingStats()
+    ]
+    if in_sbp != out_sbp:
+        # the results are the same when boxing falls back to the whole tensor route,
+        # and only the outermost route is recorded, not those of the chunks
+        test_case.assertEqual(len(routes), 1, routes)
+        test_case.assertTrue(routes[0].startswith("pipelined"), routes)
+    test_case.assertEqual(y.sbp, out_sbp)
+    test_case.assertEqual(y.placement, placement)
+    test_case.assertTrue(np.allclose(y.numpy(), np_arr, 1e-5, 1e-5))
+
+
+def _devices():
+    devices = ["cpu"]
+    if not os.getenv("ONEFLOW_TEST_CPU_ONLY"):
+        devices.append("cuda")
+    return devices
+
+
+class _PipelinedBoxingTestCase(flow.unittest.TestCase):
+    def setUp(test_case):
+        test_case.chunk_elem_cnt = os.getenv(
+            "ONEFLOW_EAGER_BOXING_PIPELINE_CHUNK_ELEM_CNT"
+        )
+        os.environ["ONEFLOW_EAGER_BOXING_PIPELINE_CHUNK_ELEM_CNT"] = "32"
+
+    def tearDown(test_case):
+        if test_case.chunk_elem_cnt is None:
+            del os.environ["ONEFLOW_EAGER_BOXING_PIPELINE_CHUNK_ELEM_CNT"]
+        else:
+            os.environ["ONEFLOW_EAGER_BOXING_PIPELINE_CHUNK_ELEM_CNT"] = (
+                test_case.chunk_elem_cnt
+            )
+
+
+@flow.unittest.skip_unless_1n2d()
+class TestEagerPipelinedBoxing(_PipelinedBoxingTestCase):
+    def test_eager_pipelined_boxing(test_case):
+        arg_dict = OrderedDict()
+        arg_dict["device"] = _devices()
+        arg_dict["in_sbp"] = [
+            flow.sbp.split(0),
+            flow.sbp.broadcast,
+            flow.sbp.partial_sum,
+        ]
+        arg_dict["out_sbp"] = [flow.sbp.split(1), flow.sbp.broadcast]
+        # odd, never reused shapes make uneven chunks and bypass cached interpreters.
+        # The chunk axis is the innermost one of the first shape, and mostly the
+        # outermost or the middle one of the second.
+        arg_dict["shape"] = [(7, 6, 11), (29, 5, 3)]
+        arg_dict["ranks"] = [[0, 1]]
+        for arg in GenArgList(arg_dict):
+            _test_eager_pipelined_boxing(test_case, *arg)
+
+
+@flow.unittest.skip_unless_1n4d()
+class TestEagerPipelinedBoxing2D(_PipelinedBoxingTestCase):
+    def test_eager_pipelined_boxing_2d(test_case):
+        arg_dict = OrderedDict()
+        arg_dict["device"] = _devices()
+        arg_dict["in_sbp"] = [
+            (flow.sbp.split(0), flow.sbp.broadcast),
+            (flow.sbp.broadcast, flow.sbp.split(1)),
+            (flow.sbp.partial_sum, flow.sbp.partial_sum),
+        ]
+        arg_dict["out_sbp"] = [
+            (flow.sbp.broadcast, flow.sbp.broadcast),
+            (flow.sbp.split(1), flow.sbp.split(0)),
+        ]
+        arg_dict["shape"] = [(8, 6, 13)]
+        arg_dict["ranks"] = [[[0, 1], [2, 3]]]
+        for arg in GenArgList(arg_dict):
+            _test_eager_pipelined_boxing(test_case, *arg)
+
+
+if __name__ == "__main__":
+    unittest.main()
@@ -47,7 +47,10 @@ def _ref(
     ):
         causal_mask = flow.triu(
             flow.ones(
-                scores.shape[-2], scores.shape[-1], dtype=flow.bool, device="cuda"
+                scores.shape[-2],
+                scores.shape[-1],
+                dtype=flow.bool,
+                device=scores.device,
             ),
             causal_diagonal_offset + 1,
         )
@@ -226,7 +229,9 @@ def _fused_mha(
         output_layout=output_layout,
         query_seq_start=query_seq_start,
         key_seq_start=key_seq_start,
-        key_seq_len=key_seq_len.to(flow.int32).to("cuda") if use_kv_seq_len else None,
+        key_seq_len=key_seq_len.to(flow.int32).to(query.device)
+        if use_kv_seq_len
+        else None,
         query_max_seq_len=query_max_seq_len,
         key_max_seq_len=key_max_seq_len,
     )
@@ -313,20 +318,21 @@ def _test_fused_multi_head_attention_inference(
     key_layout="BM(HK)",
     value_layout="BM(HK)",
     output_layout="BM(HK)",
+    device="cuda",
 ):
     query = flow.randn(
         (batch_size, query_seq_len, num_heads, query_head_size),
-        device="cuda",
+        device=device,
         dtype=flow.float,
     ).to(dtype)
     key = flow.randn(
         (batch_size, kv_seq_len, num_heads, query_head_size),
-        device="cuda",
+        device=device,
         dtype=flow.float,
     ).to(dtype)
     value = flow.randn(
         (batch_size, kv_seq_len, num_heads, value_head_size),
-        device="cuda",
+        device=device,
         dtype=flow.float,
     ).to(dtype)
 
@@ -341,17 +347,21 @@ def _test_fused_multi_head_attention_inference(
         key_layout=key_layout,
         value_layout=value_layout,
         output_layout=output_layout,
-    ).numpy()
+    )
+    # bfloat16 has no numpy type, the reference runs in float on the same rounded inputs
+    ref_dtype = flow.float if dtype is flow.bfloat16 else dtype
+    fused_out = fused_out.to(ref_dtype).numpy()
     ref_out = _ref(
-        query,
-        key,
-        value,
+        query.to(ref_dtype),
+        key.to(ref_dtype),
+        value.to(ref_dtype),
         num_heads,
         attn_mask_type=attn_mask_type,
         causal_diagonal_offset=causal_diagonal_offset,
     ).numpy()
 
-    test_case.assertTrue(np.allclose(ref_out, fused_out, atol=1e-2, rtol=1e-2))
+    tol = 2e-2 if dtype is flow.bfloat16 else 1e-2
+    test_case.assertTrue(np.allclose(ref_out, fused_out, atol=tol, rtol=tol))
 
 
 def _test_fused_multi_head_attention_inference_with_attn_bias(
@@ -453,20 +463,21 @@ def _test_fused_multi_head_attention_inference_variable_length(
     use_kv_seq_len,
     attn_mask_type="none",
     causal_diagonal_offset=0,
+    device="cuda",
 ):
     query = flow.randn(
         (batch_size, query_seq_len, num_heads, query_head_size),
-        device="cuda",
+        device=device,
         dtype=flow.float,
     ).to(dtype)
     key = flow.randn(
         (batch_size, kv_seq_len, num_heads, query_head_size),
-        device="cuda",
+        device=device,
         dtype=flow.float,
     ).to(dtype)
     value = flow.randn(
         (batch_size, kv_seq_len, num_heads, value_head_size),
-        device="cuda",
+        device=device,
         dtype=flow.float,
     ).to(dtype)
 
@@ -474,11 +485,11 @@ def _test_fused_multi_head_attention_inference_variable_length(
         low=1,
         high=query.shape[1],
         size=(query.shape[0],),
-        device="cuda",
+        device=device,
         dtype=flow.int32,
     )
     key_seq_len_t = flow.randint(
-        low=1, high=key.shape[1], size=(key.shape[0],), device="cuda", dtype=flow.int32
+        low=1, high=key.shape[1], size=(key.shape[0],), device=device, dtype=flow.int32
     )
 
     fused_out = _fused_mha(
@@ -710,6 +721,107 @@ class TestFusedMultiHeadAttentionInference(flow.unittest.TestCase):
             )
 
 
+@flow.unittest.skip_unless_1n1d()
+class TestFusedMultiHeadAttentionInferenceCpu(flow.unittest.TestCase):
+    def test_multi_head_attention_inference_cpu(test_case):
+        # test_case,batch_size, num_heads,query_seq_len, kv_seq_len,query_head_size,value_head_size,dtype
+        _test_fused_multi_head_attention_inference(
+            test_case, 2, 4, 100, 100, 40, 40, flow.float, device="cpu"
+        )
+        _test_fused_multi_head_attention_inference(
+            test_case, 2, 4, 100, 77, 40, 24, flow.float, device="cpu"
+        )
+        for attn_mask_type in ("causal_from_top_left", "causal_from_bottom_right"):
+            _test_fused_multi_head_attention_inference(
+                test_case,
+                2,
+                4,
+                70,
+                130,
+                16,
+                16,
+                flow.float,
+                attn_mask_type=attn_mask_type,
+                device="cpu",
+            )
+        _test_fused_multi_head_attention_inference(
+            test_case,
+            1,
+            8,
+            4,
+            8,
+            16,
+            16,
+            flow.float,
+            attn_mask_type="causal_from_top_left",
+            causal_diagonal_offset=4,
+            device="cpu",
+        )
+
+    def test_multi_head_attention_inference_bfloat16_cpu(test_case):
+        _test_fused_multi_head_attention_inference(
+            test_case, 2, 4, 100, 77, 40, 40, flow.bfloat16, device="cpu"
+        )
+        _test_fused_multi_head_attention_inference(
+            test_case,
+            2,
+            4,
+            70,
+            130,
+            16,
+            16,
+            flow.bfloat16,
+            attn_mask_type="causal_from_bottom_right",
+            device="cpu",
+        )
+
+    def test_multi_head_attention_inference_with_layout_cpu(test_case):
+        layouts = ["BM(HK)", "BMHK", "BHMK", "MB(HK)", "BM(H3K)"]
+        for query_layout, key_layout, value_layout in itertools.product(
+            layouts, layouts, layouts
+        ):
+            for output_layout in ("BM(HK)", "MB(HK)"):
+                _test_fused_multi_head_attention_inference(
+                    test_case,
+                    1,
+                    2,
+                    33,
+                    33,
+                    8,
+                    8,
+                    flow.float,
+                    query_layout=query_layout,
+                    key_layout=key_layout,
+                    value_layout=value_layout,
+                    output_layout=output_layout,
+                    device="cpu",
+                )
+
+    def test_multi_head_attention_inference_variable_length_cpu(test_case):
+        layouts = ["(BM)HK", "(BM)(HK)", "(BM)(H3K)"]
+        for (
+            query_layout,
+            key_layout,
+            value_layout,
+            use_kv_seq_len,
+        ) in itertools.product(layouts, layouts, layouts, (False, True)):
+            _test_fused_multi_head_attention_inference_variable_length(
+                test_case,
+                2,
+                4,
+                40,
+                40,
+                16,
+                16,
+                flow.float,
+                query_layout=query_layout,
+                key_layout=key_layout,
+                value_layout=value_layout,
+                use_kv_seq_len=use_kv_seq_len,
+                device="cpu",
+            )
+
+
 @unittest.skipIf(os.getenv("ONEFLOW_TEST_CPU_ONLY"), "only test cpu cases")
 @flow.unittest.skip_unless_1n1d()
 class TestFusedAttentionConcatPastKeyValue(flow.unittest.TestCase):
@@ -0,0 +1,167 @@
+"""
+Copyright 2020 The OneFlow Authors. All rights reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+"""
+import unittest
+
+import numpy as np
+
+import oneflow as flow
+import oneflow.unittest
+from oneflow.nn.parallel import DistributedDataParallel as ddp
+
+_METHODS = ["fp16", "bf16", "power_sgd", "top_k"]
+# Rounding of the all-reduced sum itself, which error feedback can not see.
+_TOLERANCE = {"fp16": 1e-3, "bf16": 8e-3, "power_sgd": 1e-4, "top_k": 1e-4}
+
+
+def _relative_error(actual, expected):
+    return np.linalg.norm(actual - expected) / np.linalg.norm(expected)
+
+
+def _compressed_all_reduce_states(method, shape):
+    error = flow.zeros(shape)
+    q = flow.zeros(shape[1], 4) if method == "power_sgd" else None
+    return error, q
+
+
+def _test_error_feedback_converges(test_case, method):
+    num_steps = 32
+    shape = (32, 24)
+    rank = flow.env.get_rank()
+    grad = flow.tensor(np.random.RandomState(rank).randn(*shape).astype(np.float32))
+    exact = flow._C.local_all_reduce(grad).numpy()
+    error, q = _compressed_all_reduce_states(method, shape)
+    out_sum = np.zeros(shape)
+    for step in range(num_steps):
+        out = flow._C.local_compressed_all_reduce(
+            grad, method, error, q, top_k_ratio=0.1
+        ).numpy()
+        if step == 0:
+            first_out = out
+        out_sum += out
+    # every rank ends up with the same sum
+    test_case.assertTrue(
+        np.array_equal(
+            flow._C.local_all_reduce(flow.tensor(out_sum)).numpy(), 2 * out_sum
+        )
+    )
+    pending = flow._C.local_all_reduce(error).numpy()
+    test_case.assertLess(
+        _relative_error(out_sum + pending, exact * num_steps), _TOLERANCE[method]
+    )
+    test_case.assertLess(
+        _relative_error(out_sum / num_steps, exact),
+        max(_relative_error(first_out, exact) / 4, _TOLERANCE[method]),
+    )
+
+
+class _Model(flow.nn.Module):
+    def __init__(self):
+        super().__init__()
+        self.fc1 = flow.nn.Linear(32, 64)
+        self.fc2 = flow.nn.Linear(64, 1)
+
+    def forward(self, x):
+        return self.fc2(flow.relu(self.fc1(x)))
+
+
+def _make_data(seed):
+    rng = np.random.RandomState(seed)
+    x = rng.randn(64, 32).astype(np.float32)
+    y = (x[:, :1] * 2 - x[:, 1:2]).astype(np.float32)
+    return flow.tensor(x), flow.tensor(y)
+
+
+def _test_ddp(test_case, method):
+    flow.manual_seed(0)
+    model = ddp(_Model(), gradient_compression=method)
+    optimizer = flow.optim.SGD(model.parameters(), lr=0.05)
+    x, y = _make_data(flow.env.get_rank())
+    losses = []
+    for _ in range(20):
+        loss = flow.nn.functional.mse_loss(model(x), y)
+        loss.backward()
+        optimizer.step()
+        optimizer.zero_grad()
+        losses.append(loss.item())
+    test_case.assertLess(losses[-1], losses[0] / 2)
+    for param in model.parameters():
+        # all ranks apply the same update
+        test_case.assertTrue(
+            np.allclose(
+                flow._C.local_all_reduce(param.detach()).numpy(),
+                2 * param.numpy(),
+                atol=1e-6,
+            )
+        )
+
+
+def _test_graph(test_case, method):
+    flow.manual_seed(0)
+    placement = flow.placement("cpu", ranks=[0, 1])
+    model = _Model().to_global(placement=placement, sbp=flow.sbp.broadcast)
+    optimizer = flow.optim.SGD(
+        [{"params": model.parameters(), "gradient_compression": method}], lr=0.05
+    )
+
+    class TrainGraph(flow.nn.Graph):
+        def __init__(self):
+            super().__init__()
+            self.model = model
+            self.add_optimizer(optimizer)
+
+        def build(self, x, y):
+            loss = flow.nn.functional.mse_loss(self.model(x), y)
+            loss.backward()
+            return loss
+
+    x, y = _make_data(0)
+    x = x.to_global(placement=placement, sbp=flow.sbp.broadcast).to_global(
+        sbp=flow.sbp.split(0)
+    )
+    y = y.to_global(placement=placement, sbp=flow.sbp.broadcast).to_global(
+        sbp=flow.sbp.split(0)
+    )
+    graph = TrainGraph()
+    losses = [graph(x, y).to_local().numpy().item() for _ in range(20)]
+    test_case.assertLess(losses[-1], losses[0] / 2)
+    op_types = [
+        op.user_conf.op_type_name
+        for op in graph._full_graph_proto.net.op
+        if op.HasField("user_conf")
+    ]
+    # the loss also goes down with the plain all-reduce, so check the rewrite
+    test_case.assertEqual(
+        op_types.count("gradient_compressed_all_reduce"), len(list(model.parameters()))
+    )
+
+
+@flow.unittest.skip_unless_1n2d()
+class TestGradientCompression(flow.unittest.TestCase):
+    def test_error_feedback_converges(test_case):
+        for method in _METHODS:
+            _test_error_feedback_converges(test_case, method)
+
+    def test_ddp(test_case):
+        for method in _METHODS:
+            _test_ddp(test_case, method)
+
+    def test_graph(test_case):
+        for method in _METHODS:
+            _test_graph(test_case, method)
+
+
+if __name__ == "__main__":
+    unittest.main()
@@ -61,7 +61,9 @@ def _test_layer_norm(
         np_bias = np.random.randn(*normalized_shape).astype(np.float32)
 
     # torch process
-    torch_dtype = torch.float16 if dtype is flow.float16 else torch.float32
+    torch_dtype = {flow.float16: torch.float16, flow.bfloat16: torch.bfloat16}.get(
+        dtype, torch.float32
+    )
     torch_x = torch.tensor(np_x).to(device=device, dtype=torch_dtype)
     if backward:
         torch_x.requires_grad_(True)
@@ -84,12 +86,12 @@ def _test_layer_norm(
         )
         (torch_y * torch_rand_init_grad).sum().backward()
 
-        torch_x_grad = torch_x.grad.detach().cpu().numpy()
+        torch_x_grad = torch_x.grad.detach().cpu().float().numpy()
         if affine:
-            torch_weight_grad = torch_weight.grad.detach().cpu().numpy()
-            torch_bias_grad = torch_bias.grad.detach().cpu().numpy()
+            torch_weight_grad = torch_weight.grad.detach().cpu().float().numpy()
+            torch_bias_grad = torch_bias.grad.detach().cpu().float().numpy()
 
-    torch_y = torch_y.detach().cpu().numpy()
+    torch_y = torch_y.detach().cpu().float().numpy()
 
     # oneflow process
     x = flow.tensor(np_x).to(device=device, dtype=dtype)
@@ -110,12 +112,12 @@ def _test_layer_norm(
         rand_init_grad = flow.tensor(np_rand_init_grad).to(device=device, dtype=dtype)
         (y * rand_init_grad).sum().backward()
 
-        x_grad = x.grad.detach().cpu().numpy()
+        x_grad = x.grad.detach().cpu().float().numpy()
         if affine:
-            weight_grad = weight.grad.detach().cpu().numpy()
-            bias_grad = bias.grad.detach().cpu().numpy()
+            weight_grad = weight.grad.detach().cpu().float().numpy()
+            bias_grad = bias.grad.detach().cpu().float().numpy()
 
-    y = y.detach().cpu().numpy()
+    y = y.detach().cpu().float().numpy()
 
     def compare(a, b, a_name, b_name, atol=1e-5, rtol=1e-8):
         test_case.assertTrue(
@@ -138,26 +140,23 @@ def _test_layer_norm(
             f"\n{a_name} vs. {b_name} max abs diff: {np.max(np.abs(a - b))}",
         )
 
-    if dtype is flow.float16:
-        compare(y, torch_y, "y", "torch_y", 1e-2, 1e-2)
+    if dtype in (flow.float16, flow.bfloat16):
+        # bfloat16 keeps 8 bits of mantissa, against 11 for float16
+        tol = 1e-2 if dtype is flow.float16 else 5e-2
+        compare(y, torch_y, "y", "torch_y", tol, tol)
         if backward:
-            compare(x_grad, torch_x_grad, "x_grad", "torch_x_grad", 1e-2, 1e-2)
+            compare(x_grad, torch_x_grad, "x_grad", "torch_x_grad", tol, tol)
             if affine:
                 compare(
                     weight_grad,
                     torch_weight_grad,
                     "weight_grad",
                     "torch_weight_grad",
-                    1e-2,
-                    1e-2,
+                    tol,
+                    tol,
                 )
                 compare(
-                    bias_grad,
-                    torch_bias_grad,
-                    "bias_grad",
-                    "torch_bias_grad",
-                    1e-2,
-                    1e-2,
+                    bias_grad, torch_bias_grad, "bias_grad", "torch_bias_grad", tol, tol,
                 )
     else:
         compare(y, torch_y, "y", "torch_y")
@@ -211,5 +210,48 @@ class TestLayerNorm(flow.unittest.TestCase):
         )
 
 
+@flow.unittest.skip_unless_1n1d()
+class TestLayerNormCpu(flow.unittest.TestCase):
+    def test_no_affine(test_case):
+        _test_layer_norm(
+            test_case, shape=[4, 16], normalized_shape=[16], affine=False, device="cpu"
+        )
+
+    def test_affine(test_case):
+        _test_layer_norm(
+            test_case, shape=[16, 512], normalized_shape=[512], device="cpu"
+        )
+        _test_layer_norm(
+            test_case, shape=[13, 499], normalized_shape=[499], device="cpu"
+        )
+        _test_layer_norm(
+            test_case, shape=[2, 3, 7, 5], normalized_shape=[7, 5], device="cpu"
+        )
+        _test_layer_norm(
+            test_case,
+            shape=[8, 1024],
+            normalized_shape=[1024],
+            dtype=flow.double,
+            device="cpu",
+        )
+
+    def test_bfloat16(test_case):
+        _test_layer_norm(
+            test_case,
+            shape=[16, 768],
+            normalized_shape=[768],
+            dtype=flow.bfloat16,
+            device="cpu",
+        )
+        _test_layer_norm(
+            test_case,
+            shape=[5, 3, 37],
+            normalized_shape=[37],
+            affine=False,
+            dtype=flow.bfloat16,
+            device="cpu",
+        )
+
+
 if __name__ == "__main__":
     unittest.main()
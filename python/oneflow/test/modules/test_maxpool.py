@@ -58,6 +58,46 @@ def _test_maxpool2d_channel_last(
     # )
 
 
+def _test_maxpool2d_channel_last_cpu(
+    test_case, shape, kernel_size, stride, padding, dilation, ceil_mode
+):
+    arr = np.random.randn(*shape)
+    grad = None
+    results = []
+    for data_format, perm in [
+        ("channels_first", None),
+        ("channels_last", (0, 2, 3, 1)),
+    ]:
+        x = flow.tensor(
+            arr if perm is None else arr.transpose(*perm),
+            dtype=flow.float64,
+            requires_grad=True,
+        )
+        y = flow._C.max_pool2d(
+            x,
+            kernel_size=kernel_size,
+            stride=stride,
+            padding=padding,
+            dilation=dilation,
+            return_indices=False,
+            ceil_mode=ceil_mode,
+            data_format=data_format,
+        )[0]
+        if grad is None:
+            grad = np.random.randn(*y.shape)
+        y.backward(
+            flow.tensor(grad if perm is None else grad.transpose(*perm), dtype=y.dtype)
+        )
+        if perm is None:
+            results.append((y.numpy(), x.grad.numpy()))
+        else:
+            results.append(
+                (y.numpy().transpose(0, 3, 1, 2), x.grad.numpy().transpose(0, 3, 1, 2))
+            )
+    test_case.assertTrue(np.allclose(results[0][0], results[1][0], 1e-5, 1e-5))
+    test_case.assertTrue(np.allclose(results[0][1], results[1][1], 1e-5, 1e-5))
+
+
 @flow.unittest.skip_unless_1n1d()
 class TestMaxPooling(flow.unittest.TestCase):
     @autotest(n=5, auto_backward=True, check_graph=True)
@@ -183,6 +223,17 @@ class TestMaxPooling(flow.unittest.TestCase):
         for arg in GenArgList(arg_dict):
             arg[0](test_case, *arg[1:])
 
+    def test_maxpool2d_channel_last_cpu(test_case):
+        arg_dict = OrderedDict()
+        arg_dict["shape"] = [(3, 3, 14, 27), (2, 70, 9, 14)]
+        arg_dict["kernel_size"] = [(3, 3), (2, 3)]
+        arg_dict["stride"] = [(1, 1), (1, 2), (2, 2)]
+        arg_dict["padding"] = [(0, 0), (0, 1)]
+        arg_dict["dilation"] = [(1, 1), (1, 2)]
+        arg_dict["ceil_mode"] = [True, False]
+        for arg in GenArgList(arg_dict):
+            _test_maxpool2d_channel_last_cpu(test_case, *arg)
+
 
 @flow.unittest.skip_unless_1n1d()
 class TestMaxPoolingFunctional(flow.unittest.TestCase):
@@ -14,6 +14,9 @@ See the License for the specific language governing permissions and
 limitations under the License.
 """
 import unittest
+
+import numpy as np
+import torch as torch_original
 from oneflow.test_utils.automated_test_util import *
 import oneflow as flow
 import oneflow.unittest
@@ -62,6 +65,22 @@ class TestMedianModule(flow.unittest.TestCase):
         result = x.median(1)
         return result.values, result.indices
 
+    def test_median_nan_cpu(test_case):
+        # NaN propagates like in torch: the median of a row holding a NaN is its first NaN
+        for shape in [(6, 9), (2, 1 << 20)]:
+            np_x = np.random.randn(*shape).astype(np.float32)
+            np_x[0, shape[1] // 3] = np.nan
+            np_x[0, shape[1] // 2] = np.nan
+            x = flow.tensor(np_x)
+            torch_x = torch_original.tensor(np_x)
+            values, indices = flow.median(x, 1)
+            torch_values, torch_indices = torch_original.median(torch_x, 1)
+            test_case.assertTrue(
+                np.array_equal(values.numpy(), torch_values.numpy(), equal_nan=True)
+            )
+            test_case.assertTrue(np.array_equal(indices.numpy(), torch_indices.numpy()))
+            test_case.assertTrue(np.isnan(flow.median(x).numpy()))
+
 
 if __name__ == "__main__":
     unittest.main()
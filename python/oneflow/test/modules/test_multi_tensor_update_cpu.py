@@ -0,0 +1,126 @@
+"""
+Copyright 2020 The OneFlow Authors. All rights reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+"""
+
+import unittest
+from collections import OrderedDict
+
+import numpy as np
+from oneflow.test_utils.test_util import GenArgList
+
+import oneflow as flow
+import oneflow.unittest
+
+
+def _np_momentum_update(
+    x, grad, buf, learning_rate, weight_decay, momentum, dampening, nesterov, maximize
+):
+    grad = grad + weight_decay * x
+    buf = momentum * buf + (1 - dampening) * grad
+    step = grad + momentum * buf if nesterov else buf
+    x = x + learning_rate * step if maximize else x - learning_rate * step
+    return x, buf
+
+
+def _test_multi_tensor_momentum_update(
+    test_case, dtype, weight_decay, dampening, nesterov, maximize
+):
+    shapes = [(10,), (4, 5), (40001,)]
+    learning_rate, momentum, scale = 0.1, 0.9, 0.5
+    np_dtype = np.float64 if dtype == flow.float64 else np.float32
+    np_models = [np.random.uniform(size=shape).astype(np_dtype) for shape in shapes]
+    np_bufs = [np.zeros(shape, dtype=np_dtype) for shape in shapes]
+    models = [flow.tensor(x, dtype=dtype) for x in np_models]
+    bufs = [flow.tensor(buf, dtype=dtype) for buf in np_bufs]
+    for _ in range(3):
+        np_grads = [np.random.uniform(size=shape).astype(np_dtype) for shape in shapes]
+        flow._C.multi_tensor_momentum_update(
+            model=models,
+            model_diff=[flow.tensor(grad, dtype=dtype) for grad in np_grads],
+            momentum_buf=bufs,
+            scale=scale,
+            weight_decay=weight_decay,
+            learning_rate_val=learning_rate,
+            momentum=momentum,
+            dampening=dampening,
+            nesterov=nesterov,
+            maximize=maximize,
+        )
+        for idx in range(len(shapes)):
+            np_models[idx], np_bufs[idx] = _np_momentum_update(
+                np_models[idx],
+                scale * np_grads[idx],
+                np_bufs[idx],
+                learning_rate,
+                weight_decay,
+                momentum,
+                dampening,
+                nesterov,
+                maximize,
+            )
+            test_case.assertTrue(
+                np.allclose(models[idx].numpy(), np_models[idx], rtol=1e-5, atol=1e-5)
+            )
+            test_case.assertTrue(
+                np.allclose(bufs[idx].numpy(), np_bufs[idx], rtol=1e-5, atol=1e-5)
+            )
+
+
+def _test_multi_tensor_sgd_update(test_case, dtype, weight_decay):
+    shapes = [(10,), (4, 5), (40001,)]
+    learning_rate, scale = 0.1, 0.5
+    np_dtype = np.float64 if dtype == flow.float64 else np.float32
+    np_models = [np.random.uniform(size=shape).astype(np_dtype) for shape in shapes]
+    models = [flow.tensor(x, dtype=dtype) for x in np_models]
+    for _ in range(3):
+        np_grads = [np.random.uniform(size=shape).astype(np_dtype) for shape in shapes]
+        flow._C.multi_tensor_sgd_update(
+            model=models,
+            model_diff=[flow.tensor(grad, dtype=dtype) for grad in np_grads],
+            scale=scale,
+            weight_decay=weight_decay,
+            learning_rate_val=learning_rate,
+        )
+        for idx in range(len(shapes)):
+            np_models[idx] = np_models[idx] - learning_rate * (
+                scale * np_grads[idx] + weight_decay * np_models[idx]
+            )
+            test_case.assertTrue(
+                np.allclose(models[idx].numpy(), np_models[idx], rtol=1e-5, atol=1e-5)
+            )
+
+
+@flow.unittest.skip_unless_1n1d()
+class TestMultiTensorUpdateCpu(flow.unittest.TestCase):
+    def test_multi_tensor_momentum_update(test_case):
+        arg_dict = OrderedDict()
+        arg_dict["dtype"] = [flow.float32, flow.float64]
+        arg_dict["weight_decay"] = [0.0, 1e-2]
+        arg_dict["dampening"] = [0.0, 0.1]
+        arg_dict["nesterov"] = [False, True]
+        arg_dict["maximize"] = [False, True]
+        for arg in GenArgList(arg_dict):
+            _test_multi_tensor_momentum_update(test_case, *arg)
+
+    def test_multi_tensor_sgd_update(test_case):
+        arg_dict = OrderedDict()
+        arg_dict["dtype"] = [flow.float32, flow.float64]
+        arg_dict["weight_decay"] = [0.0, 1e-2]
+        for arg in GenArgList(arg_dict):
+            _test_multi_tensor_sgd_update(test_case, *arg)
+
+
+if __name__ == "__main__":
+    unittest.main()
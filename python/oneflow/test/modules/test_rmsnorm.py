@@ -55,6 +55,15 @@ def _test_rmsnorm(
     np_weight = (
         np.random.randn(*normalized_shape).astype(np.float32) if affine else None
     )
+    np_rand_init_grad = np.random.randn(*shape).astype(np.float32)
+    if dtype is flow.bfloat16:
+        # the reference runs in float on the same bfloat16 rounded inputs
+        def _round(a):
+            return torch.tensor(a).bfloat16().float().numpy()
+
+        np_x = _round(np_x)
+        np_weight = _round(np_weight) if affine else None
+        np_rand_init_grad = _round(np_rand_init_grad)
 
     torch_dtype = torch.float16 if dtype is flow.float16 else torch.float32
     torch_x = torch.tensor(np_x).to(device=device, dtype=torch_dtype)
@@ -66,7 +75,6 @@ def _test_rmsnorm(
         torch_weight.requires_grad_(True)
     torch_y = _torch_rmsnorm(torch_x, torch_weight, normalized_shape, eps)
 
-    np_rand_init_grad = np.random.randn(*tuple(torch_y.shape)).astype(np.float32)
     torch_rand_init_grad = torch.tensor(np_rand_init_grad).to(
         device=device, dtype=torch_dtype
     )
@@ -87,10 +95,10 @@ def _test_rmsnorm(
     rand_init_grad = flow.tensor(np_rand_init_grad).to(device=device, dtype=dtype)
     (y * rand_init_grad).sum().backward()
 
-    y = y.detach().cpu().numpy()
-    x_grad = x.grad.detach().cpu().numpy()
+    y = y.detach().cpu().float().numpy()
+    x_grad = x.grad.detach().cpu().float().numpy()
     if affine:
-        weight_grad = weight.grad.detach().cpu().numpy()
+        weight_grad = weight.grad.detach().cpu().float().numpy()
 
     def compare(a, b, a_name, b_name, atol=1e-5, rtol=1e-8):
         test_case.assertTrue(
@@ -113,7 +121,19 @@ def _test_rmsnorm(
             f"\n{a_name} vs. {b_name} max abs diff: {np.max(np.abs(a - b))}",
         )
 
-    if dtype is flow.float16:
+    if dtype is flow.bfloat16:
+        compare(y, torch_y, "y", "torch_y", 2e-2, 2e-2)
+        compare(x_grad, torch_x_grad, "x_grad", "torch_x_grad", 5e-2, 5e-2)
+        if affine:
+            compare(
+                weight_grad,
+                torch_weight_grad,
+                "weight_grad",
+                "torch_weight_grad",
+                0.1,
+                0.1,
+            )
+    elif dtype is flow.float16:
         compare(y, torch_y, "y", "torch_y", 1e-3, 1e-2)
         compare(x_grad, torch_x_grad, "x_grad", "torch_x_grad", 1e-2, 1e-2)
         if affine:
@@ -188,5 +208,58 @@ class TestRMSNorm(flow.unittest.TestCase):
         )
 
 
+@flow.unittest.skip_unless_1n1d()
+class TestRMSNormCpu(flow.unittest.TestCase):
+    def test_rmsnorm_cpu(test_case):
+        for dtype in (flow.float32, flow.double):
+            _test_rmsnorm(
+                test_case,
+                shape=[4, 16],
+                normalized_shape=[16],
+                dtype=dtype,
+                device="cpu",
+            )
+            _test_rmsnorm(
+                test_case,
+                shape=[13, 499],
+                normalized_shape=[499],
+                dtype=dtype,
+                device="cpu",
+            )
+            _test_rmsnorm(
+                test_case,
+                shape=[2, 3, 8, 16],
+                normalized_shape=[8, 16],
+                dtype=dtype,
+                device="cpu",
+            )
+
+    def test_rmsnorm_bfloat16_cpu(test_case):
+        _test_rmsnorm(
+            test_case,
+            shape=[16, 768],
+            normalized_shape=[768],
+            dtype=flow.bfloat16,
+            device="cpu",
+        )
+        _test_rmsnorm(
+            test_case,
+            shape=[5, 3, 37],
+            normalized_shape=[37],
+            affine=False,
+            dtype=flow.bfloat16,
+            device="cpu",
+        )
+
+    def test_no_affine_cpu(test_case):
+        _test_rmsnorm(
+            test_case,
+            shape=[7, 1533],
+            normalized_shape=[1533],
+            affine=False,
+            device="cpu",
+        )
+
+
 if __name__ == "__main__":
     unittest.main()
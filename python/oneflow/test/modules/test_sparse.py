@@ -135,6 +135,36 @@ def _test_embedding_scale_by_freq(test_case, device):
     )
 
 
+def _test_embedding_large_cpu(test_case, padding_idx, scale_grad_by_freq):
+    # Enough indices that the CPU lookup and gradient are split across threads.
+    num_embeddings, embedding_dim = 1000, 16
+    weight = np.random.randn(num_embeddings, embedding_dim).astype(np.float32)
+    indices = np.random.randint(0, num_embeddings, size=(40, 2500)).astype(np.int64)
+    indices[:, :100] = 7
+    m = flow.nn.Embedding(
+        num_embeddings,
+        embedding_dim,
+        padding_idx=padding_idx,
+        scale_grad_by_freq=scale_grad_by_freq,
+        _weight=flow.Tensor(weight),
+    )
+    y = m(flow.tensor(indices))
+    test_case.assertTrue(np.array_equal(y.numpy(), weight[indices]))
+    dy = np.random.randn(*indices.shape, embedding_dim).astype(np.float32)
+    y.backward(flow.tensor(dy))
+    flat_indices = indices.reshape(-1)
+    flat_dy = dy.reshape(-1, embedding_dim)
+    if padding_idx is not None:
+        keep = flat_indices != padding_idx
+        flat_indices, flat_dy = flat_indices[keep], flat_dy[keep]
+    weight_grad = np.zeros_like(weight)
+    np.add.at(weight_grad, flat_indices, flat_dy)
+    if scale_grad_by_freq:
+        freq = np.bincount(indices.reshape(-1), minlength=num_embeddings)
+        weight_grad /= np.maximum(freq, 1)[:, None]
+    test_case.assertTrue(np.allclose(m.weight.grad.numpy(), weight_grad, 1e-05, 1e-05))
+
+
 @flow.unittest.skip_unless_1n1d()
 class TestEmbedding(flow.unittest.TestCase):
     def test_padding_idx(test_case):
@@ -144,6 +174,13 @@ class TestEmbedding(flow.unittest.TestCase):
             _test_embedding_padding_idx(test_case, *arg)
             _test_embedding_scale_by_freq(test_case, *arg)
 
+    def test_embedding_large_cpu(test_case):
+        arg_dict = OrderedDict()
+        arg_dict["padding_idx"] = [None, 7]
+        arg_dict["scale_grad_by_freq"] = [False, True]
+        for arg in GenArgList(arg_dict):
+            _test_embedding_large_cpu(test_case, *arg)
+
     @autotest(n=5, check_graph=True)
     def test_embedding_impl(test_case):
         device = random_device()
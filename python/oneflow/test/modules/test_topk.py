@@ -52,6 +52,15 @@ class TestTopK(flow.unittest.TestCase):
         for arg in GenArgList(arg_dict):
             _test_top_k(test_case, *arg)
 
+    def test_top_k_large_rows_cpu(test_case):
+        arg_dict = OrderedDict()
+        arg_dict["shape"] = [(3, 5000), (2, 70000)]
+        arg_dict["k"] = [1, 17, 600, 3000]
+        arg_dict["dim"] = [1]
+        arg_dict["device"] = ["cpu"]
+        for arg in GenArgList(arg_dict):
+            _test_top_k(test_case, *arg)
+
 
 if __name__ == "__main__":
     unittest.main()
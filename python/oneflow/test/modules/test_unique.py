@@ -131,6 +131,50 @@ def _test_unique_sorted(test_case, device, return_inverse, return_counts):
         test_case.assertEqual(list(oneflow_counts.shape), list(torch_counts.shape))
 
 
+def _test_unique_large_cpu(test_case, n, high, sorted):
+    np_input = np.random.randint(-high, high, size=(n,)).astype(np.int64)
+    unique, inverse, counts = flow.unique(
+        flow.tensor(np_input), sorted=sorted, return_inverse=True, return_counts=True,
+    )
+    np_unique, np_first, np_inverse, np_counts = np.unique(
+        np_input, return_index=True, return_inverse=True, return_counts=True
+    )
+    if not sorted:
+        # the unsorted cpu result lists the keys in order of first occurrence
+        order = np.argsort(np_first)
+        rank = np.empty_like(order)
+        rank[order] = np.arange(order.size)
+        np_unique, np_counts, np_inverse = (
+            np_unique[order],
+            np_counts[order],
+            rank[np_inverse],
+        )
+    test_case.assertTrue(np.array_equal(unique.numpy(), np_unique))
+    test_case.assertTrue(np.array_equal(inverse.numpy(), np_inverse))
+    test_case.assertTrue(np.array_equal(counts.numpy(), np_counts))
+
+
+def _test_unique_nan_cpu(test_case, n, sorted):
+    np_input = np.random.randint(-20, 20, size=(n,)).astype(np.float32)
+    nan_pos = np.random.choice(n, size=n // 10, replace=False)
+    np_input[nan_pos] = np.nan
+    unique, inverse, counts = flow.unique(
+        flow.tensor(np_input), sorted=sorted, return_inverse=True, return_counts=True,
+    )
+    unique, inverse, counts = unique.numpy(), inverse.numpy(), counts.numpy()
+    # NaN never equals itself, so every NaN is a unique key of its own
+    test_case.assertEqual(np.isnan(unique).sum(), nan_pos.size)
+    test_case.assertTrue(np.all(counts[np.isnan(unique)] == 1))
+    test_case.assertTrue(np.array_equal(unique[inverse], np_input, equal_nan=True))
+    if sorted:
+        # and the NaNs go last, like in torch
+        num_numbers = unique.size - nan_pos.size
+        test_case.assertTrue(
+            np.array_equal(unique[:num_numbers], np.unique(np_input[~np.isnan(np_input)]))
+        )
+        test_case.assertTrue(np.all(np.isnan(unique[num_numbers:])))
+
+
 @flow.unittest.skip_unless_1n1d()
 class TestUnique(flow.unittest.TestCase):
     @autotest(n=5)
@@ -143,6 +187,19 @@ class TestUnique(flow.unittest.TestCase):
             _test_unique_unsorted(test_case, *arg)
             _test_unique_sorted(test_case, *arg)
 
+    def test_unique_large_cpu(test_case):
+        arg_dict = OrderedDict()
+        arg_dict["n"] = [1000, 300000]
+        arg_dict["high"] = [10, 50000, 2 ** 40]
+        arg_dict["sorted"] = [False, True]
+        for arg in GenArgList(arg_dict):
+            _test_unique_large_cpu(test_case, *arg)
+
+    def test_unique_nan_cpu(test_case):
+        for n in [1000, 300000]:
+            for sorted in [False, True]:
+                _test_unique_nan_cpu(test_case, n, sorted)
+
     @profile(torch.unique)
     def profile_unique(test_case):
         input = torch.randint(0, 1000, (1000,))